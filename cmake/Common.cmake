@@ -67,6 +67,12 @@ macro(revng_add_private_executable NAME)
 
   add_executable("${NAME}" ${ARGN})
   add_dependencies(revng-all-binaries "${NAME}")
+
+  # Link the allocator directly, so that it comes before libc in the lookup
+  # order and its malloc wins
+  if(REVNG_ALLOCATOR_LIBRARY)
+    target_link_libraries("${NAME}" "${REVNG_ALLOCATOR_LIBRARY}")
+  endif()
   prepend_target_property("${NAME}" BUILD_RPATH "\$ORIGIN/../lib/:\$ORIGIN/../lib/revng/analyses/" ":")
   if(NOT "${CMAKE_INSTALL_RPATH}" STREQUAL "")
     append_target_property("${NAME}" BUILD_RPATH "${CMAKE_INSTALL_RPATH}" ":")
@@ -10,8 +10,6 @@
 #include "revng/ADT/ZipMapIterator.h"
 #include "revng/Support/Debug.h"
 
-using APIntVector = llvm::SmallVector<llvm::APInt, 4>;
-
 struct APIntVectorKeyContainer {
   static int compare(const llvm::APInt &LHS, const llvm::APInt &RHS) {
     if (LHS == RHS)
@@ -29,27 +27,21 @@ struct APIntVectorKeyContainer {
 // * [10,)
 // * [0,10)
 
+class ConstantRangeSet;
+
 class ConstantRangeSetIterator {
 private:
   llvm::APInt Current;
-  const llvm::APInt *NextBound;
-  const llvm::APInt *const End;
+  const ConstantRangeSet *Set;
+  size_t NextBound;
+  const size_t End;
   bool ToLast;
   bool Done;
-  const llvm::APInt Max;
 
 public:
-  ConstantRangeSetIterator(const llvm::APInt *Start, const llvm::APInt *End) :
-    NextBound(Start), End(End), ToLast(false), Done(false) {
-    if (Start != End) {
-      Current = *NextBound;
-      ++NextBound;
-      if (NextBound == End)
-        ToLast = true;
-    } else {
-      Done = true;
-    }
-  }
+  inline ConstantRangeSetIterator(const ConstantRangeSet *Set,
+                                  size_t Start,
+                                  size_t End);
 
   bool operator==(const ConstantRangeSetIterator &Other) const {
     // TODO: implement proper comparison operator
@@ -61,29 +53,7 @@ public:
     return not(*this == Other);
   }
 
-  ConstantRangeSetIterator &operator++() {
-    revng_assert(not Done);
-
-    if (ToLast and Current.isMaxValue()) {
-      Done = true;
-      return *this;
-    }
-
-    ++Current;
-    if (not ToLast and Current == *NextBound) {
-      ++NextBound;
-      if (NextBound != End) {
-        Current = *NextBound;
-        ++NextBound;
-        if (NextBound == End)
-          ToLast = true;
-      } else {
-        Done = true;
-      }
-    }
-
-    return *this;
-  }
+  inline ConstantRangeSetIterator &operator++();
 
   const llvm::APInt &operator*() const {
     revng_assert(not Done);
@@ -98,12 +68,26 @@ public:
 /// This class is effectively an extension of llvm::ConstantRange aiming to
 /// represent multiple disjoint ranges.
 ///
-/// It is implemented as a vector of llvm::APInt. Each one of them represents a
-/// flip in the status of the range (`ON -> OFF` or `OFF -> ON`), starting from
-/// the initial state `OFF`.
+/// It is implemented as a vector of bounds. Each one of them represents a flip
+/// in the status of the range (`ON -> OFF` or `OFF -> ON`), starting from the
+/// initial state `OFF`.
+///
+/// Sets up to 64 bits wide, which are the vast majority, keep their bounds as
+/// plain `uint64_t`, with room for InlineIntervals intervals without any heap
+/// allocation. Wider sets fall back to llvm::APInt bounds.
 class ConstantRangeSet {
+  friend class ConstantRangeSetIterator;
+
+public:
+  static constexpr unsigned InlineIntervals = 2;
+
+private:
+  using NarrowVector = llvm::SmallVector<uint64_t, 2 * InlineIntervals>;
+  using WideVector = llvm::SmallVector<llvm::APInt, 0>;
+
 private:
-  APIntVector Bounds;
+  NarrowVector NarrowBounds;
+  WideVector WideBounds;
   uint32_t BitWidth;
 
 public:
@@ -111,24 +95,24 @@ public:
 
   ConstantRangeSet(uint32_t BitWidth, bool IsFullSet) : BitWidth(BitWidth) {
     if (IsFullSet)
-      Bounds.emplace_back(BitWidth, 0);
+      pushBound(llvm::APInt(BitWidth, 0));
   }
 
   ConstantRangeSet(const llvm::ConstantRange &Range) {
     BitWidth = Range.getBitWidth();
 
     if (Range.isFullSet()) {
-      Bounds.emplace_back(BitWidth, 0);
+      pushBound(llvm::APInt(BitWidth, 0));
     } else if (Range.isEmptySet()) {
       // Nothing to do here
     } else if (Range.isWrappedSet()) {
-      Bounds.emplace_back(BitWidth, 0);
-      Bounds.push_back(Range.getUpper());
-      Bounds.push_back(Range.getLower());
+      pushBound(llvm::APInt(BitWidth, 0));
+      pushBound(Range.getUpper());
+      pushBound(Range.getLower());
     } else {
-      Bounds.push_back(Range.getLower());
+      pushBound(Range.getLower());
       if (Range.getUpper() != llvm::APInt{ BitWidth, 0 })
-        Bounds.push_back(Range.getUpper());
+        pushBound(Range.getUpper());
     }
   }
 
@@ -142,11 +126,48 @@ public:
   }
 
   bool contains(const ConstantRangeSet &Other) const {
-    return intersectWith(Other) == Other;
+    if (not isNarrow() or not Other.isNarrow())
+      return intersectWith(Other) == Other;
+
+    // Other is contained if, after each bound, whenever Other is ON, we are ON
+    // too
+    const uint64_t *Left = NarrowBounds.begin();
+    const uint64_t *LeftEnd = NarrowBounds.end();
+    const uint64_t *Right = Other.NarrowBounds.begin();
+    const uint64_t *RightEnd = Other.NarrowBounds.end();
+    bool LeftActive = false;
+    bool RightActive = false;
+    while (Right != RightEnd or (RightActive and Left != LeftEnd)) {
+      bool MoveLeft = Left != LeftEnd
+                      and (Right == RightEnd or *Left <= *Right);
+      bool MoveRight = Right != RightEnd
+                       and (Left == LeftEnd or *Right <= *Left);
+
+      if (MoveLeft) {
+        LeftActive = not LeftActive;
+        ++Left;
+      }
+
+      if (MoveRight) {
+        RightActive = not RightActive;
+        ++Right;
+      }
+
+      if (RightActive and not LeftActive)
+        return false;
+    }
+
+    return true;
   }
 
   bool operator==(const ConstantRangeSet &Other) const {
-    return Bounds == Other.Bounds;
+    if (isNarrow() != Other.isNarrow())
+      return isEmptySet() and Other.isEmptySet();
+
+    if (isNarrow())
+      return NarrowBounds == Other.NarrowBounds;
+    else
+      return WideBounds == Other.WideBounds;
   }
 
   void setWidth(unsigned NewBitWidth) {
@@ -157,27 +178,33 @@ public:
   }
 
   ConstantRangeSetIterator begin() const {
-    return ConstantRangeSetIterator(&*Bounds.begin(), &*Bounds.end());
+    return ConstantRangeSetIterator(this, 0, boundsCount());
   }
 
   ConstantRangeSetIterator end() const {
-    return ConstantRangeSetIterator(&*Bounds.end(), &*Bounds.end());
+    return ConstantRangeSetIterator(this, boundsCount(), boundsCount());
   }
 
   bool isFullSet() const {
-    return Bounds.size() == 1 and Bounds[0].isNullValue();
+    if (isNarrow())
+      return NarrowBounds.size() == 1 and NarrowBounds[0] == 0;
+    else
+      return WideBounds.size() == 1 and WideBounds[0].isNullValue();
   }
-  bool isEmptySet() const { return Bounds.size() == 0; }
+
+  bool isEmptySet() const { return boundsCount() == 0; }
 
   llvm::APInt size() const {
     using namespace llvm;
 
-    if (Bounds.size() == 0)
-      return APInt(BitWidth, 0);
+    if (not isNarrow())
+      return wideSize();
 
-    APInt Size(BitWidth, 0);
-    const APInt *Last = nullptr;
-    for (const llvm::APInt &N : Bounds) {
+    // Arithmetic modulo 2^BitWidth, as APInt would do
+    uint64_t Mask = APInt::getMaxValue(std::max(BitWidth, 1U)).getZExtValue();
+    uint64_t Size = 0;
+    const uint64_t *Last = nullptr;
+    for (const uint64_t &N : NarrowBounds) {
       if (Last == nullptr) {
         Last = &N;
       } else {
@@ -187,9 +214,9 @@ public:
     }
 
     if (Last != nullptr)
-      Size += (APInt::getMaxValue(BitWidth) - *Last);
+      Size += (Mask - *Last);
 
-    return Size;
+    return APInt(BitWidth, Size & Mask);
   }
 
   void dump() const debug_function { dump(dbg); }
@@ -202,13 +229,13 @@ public:
     }
 
     bool Open = true;
-    for (const llvm::APInt &N : Bounds) {
+    for (size_t I = 0; I < boundsCount(); ++I) {
       if (Open)
         Output << "[";
       else
         Output << ",";
 
-      Output << N.getLimitedValue();
+      Output << bound(I).getLimitedValue();
 
       if (not Open)
         Output << ") ";
@@ -216,7 +243,7 @@ public:
       Open = not Open;
     }
 
-    if (Bounds.size() == 0) {
+    if (boundsCount() == 0) {
       Output << "[)";
     }
     if (not Open) {
@@ -226,32 +253,124 @@ public:
   }
 
 private:
-  template<bool And>
-  ConstantRangeSet merge(const ConstantRangeSet &Other) const {
+  bool isNarrow() const { return BitWidth <= 64; }
+
+  size_t boundsCount() const {
+    return isNarrow() ? NarrowBounds.size() : WideBounds.size();
+  }
+
+  llvm::APInt bound(size_t Index) const {
+    if (isNarrow())
+      return llvm::APInt(BitWidth, NarrowBounds[Index]);
+    else
+      return WideBounds[Index];
+  }
+
+  void pushBound(const llvm::APInt &Bound) {
+    revng_assert(Bound.getBitWidth() == BitWidth);
+    if (isNarrow())
+      NarrowBounds.push_back(Bound.getZExtValue());
+    else
+      WideBounds.push_back(Bound);
+  }
+
+  llvm::APInt wideSize() const {
     using namespace llvm;
 
+    if (WideBounds.size() == 0)
+      return APInt(BitWidth, 0);
+
+    APInt Size(BitWidth, 0);
+    const APInt *Last = nullptr;
+    for (const llvm::APInt &N : WideBounds) {
+      if (Last == nullptr) {
+        Last = &N;
+      } else {
+        Size += (N - *Last);
+        Last = nullptr;
+      }
+    }
+
+    if (Last != nullptr)
+      Size += (APInt::getMaxValue(BitWidth) - *Last);
+
+    return Size;
+  }
+
+  template<bool And>
+  ConstantRangeSet merge(const ConstantRangeSet &Other) const {
     auto ResultBitWidth = std::max(BitWidth, Other.BitWidth);
     ConstantRangeSet Result(ResultBitWidth, false);
     revng_assert(BitWidth == 0 or Other.BitWidth == 0
                  or BitWidth == Other.BitWidth);
 
+    if (Result.isNarrow())
+      mergeNarrow<And>(NarrowBounds, Other.NarrowBounds, Result.NarrowBounds);
+    else
+      mergeWide<And>(Other, Result);
+
+    return Result;
+  }
+
+  template<bool And>
+  static void mergeNarrow(const NarrowVector &LeftBounds,
+                          const NarrowVector &RightBounds,
+                          NarrowVector &Output) {
+    const uint64_t *Left = LeftBounds.begin();
+    const uint64_t *LeftEnd = LeftBounds.end();
+    const uint64_t *Right = RightBounds.begin();
+    const uint64_t *RightEnd = RightBounds.end();
+
     bool LastOutput = false;
     bool LeftActive = false;
     bool RightActive = false;
-    auto zip_APIntVector = zipmap_range<const APIntVector,
-                                        const APIntVector,
+    while (Left != LeftEnd or Right != RightEnd) {
+      uint64_t Value = 0;
+      if (Right == RightEnd or (Left != LeftEnd and *Left < *Right)) {
+        Value = *Left++;
+        LeftActive = not LeftActive;
+      } else if (Left == LeftEnd or *Right < *Left) {
+        Value = *Right++;
+        RightActive = not RightActive;
+      } else {
+        Value = *Left++;
+        ++Right;
+        LeftActive = not LeftActive;
+        RightActive = not RightActive;
+      }
+
+      bool NewOutput = And ? (LeftActive and RightActive) :
+                             (LeftActive or RightActive);
+
+      if (NewOutput != LastOutput)
+        Output.push_back(Value);
+
+      LastOutput = NewOutput;
+    }
+  }
+
+  template<bool And>
+  void
+  mergeWide(const ConstantRangeSet &Other, ConstantRangeSet &Result) const {
+    using namespace llvm;
+
+    bool LastOutput = false;
+    bool LeftActive = false;
+    bool RightActive = false;
+    auto zip_APIntVector = zipmap_range<const WideVector,
+                                        const WideVector,
                                         APIntVectorKeyContainer>;
-    for (auto &P : zip_APIntVector(Bounds, Other.Bounds)) {
+    for (auto &P : zip_APIntVector(WideBounds, Other.WideBounds)) {
       const llvm::APInt *Left = P.first;
       const llvm::APInt *Right = P.second;
 
       if (Left != nullptr) {
-        revng_assert(Left->getBitWidth() == ResultBitWidth);
+        revng_assert(Left->getBitWidth() == Result.BitWidth);
         LeftActive = not LeftActive;
       }
 
       if (Right != nullptr) {
-        revng_assert(Right->getBitWidth() == ResultBitWidth);
+        revng_assert(Right->getBitWidth() == Result.BitWidth);
         RightActive = not RightActive;
       }
 
@@ -262,12 +381,49 @@ private:
                              (LeftActive or RightActive);
 
       if (NewOutput != LastOutput) {
-        Result.Bounds.push_back(*Value);
+        Result.WideBounds.push_back(*Value);
       }
 
       LastOutput = NewOutput;
     }
-
-    return Result;
   }
 };
+
+inline ConstantRangeSetIterator::ConstantRangeSetIterator(const ConstantRangeSet
+                                                            *Set,
+                                                          size_t Start,
+                                                          size_t End) :
+  Set(Set), NextBound(Start), End(End), ToLast(false), Done(false) {
+  if (Start != End) {
+    Current = Set->bound(NextBound);
+    ++NextBound;
+    if (NextBound == End)
+      ToLast = true;
+  } else {
+    Done = true;
+  }
+}
+
+inline ConstantRangeSetIterator &ConstantRangeSetIterator::operator++() {
+  revng_assert(not Done);
+
+  if (ToLast and Current.isMaxValue()) {
+    Done = true;
+    return *this;
+  }
+
+  ++Current;
+  if (not ToLast and Current == Set->bound(NextBound)) {
+    ++NextBound;
+    if (NextBound != End) {
+      Current = Set->bound(NextBound);
+      ++NextBound;
+      if (NextBound == End)
+        ToLast = true;
+    } else {
+      Done = true;
+    }
+  }
+
+  return *this;
+}
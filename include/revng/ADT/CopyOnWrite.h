@@ -0,0 +1,71 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <memory>
+#include <utility>
+
+#include "revng/Support/Assert.h"
+
+/// \brief Wrapper sharing an object among copies until one of them mutates it
+///
+/// Copying a CopyOnWrite object only copies a reference-counted pointer. The
+/// first time a copy is accessed through `mutate`, if the object is shared, it
+/// gets its own private copy of it.
+///
+/// This is useful to implement cheap `copy` methods for elements of a lattice
+/// of a MonotoneFramework: usually, the transfer function changes a small
+/// portion of the state, and the rest can be shared between labels.
+///
+/// \note Read-only access is implicit, write access has to be requested
+///       explicitly through `mutate`.
+template<typename T>
+class CopyOnWrite {
+private:
+  std::shared_ptr<T> Pointer;
+
+public:
+  CopyOnWrite(const T &Object) : Pointer(std::make_shared<T>(Object)) {}
+  CopyOnWrite(T &&Object) : Pointer(std::make_shared<T>(std::move(Object))) {}
+
+  CopyOnWrite(const CopyOnWrite &) = default;
+  CopyOnWrite &operator=(const CopyOnWrite &) = default;
+  CopyOnWrite(CopyOnWrite &&) = default;
+  CopyOnWrite &operator=(CopyOnWrite &&) = default;
+
+public:
+  const T &get() const {
+    revng_assert(Pointer);
+    return *Pointer;
+  }
+
+  operator const T &() const { return get(); }
+  const T &operator*() const { return get(); }
+  const T *operator->() const { return &get(); }
+
+  /// \brief Obtain a mutable reference to the object, unsharing it if needed
+  T &mutate() {
+    revng_assert(Pointer);
+    if (Pointer.use_count() > 1)
+      Pointer = std::make_shared<T>(*Pointer);
+    return *Pointer;
+  }
+
+  /// \brief Is the object shared with some other CopyOnWrite instance?
+  bool isShared() const { return Pointer.use_count() > 1; }
+
+  /// \brief Do this and \p Other refer to the very same object?
+  bool sharesWith(const CopyOnWrite &Other) const {
+    return Pointer == Other.Pointer;
+  }
+
+  bool operator==(const CopyOnWrite &Other) const {
+    return sharesWith(Other) or get() == Other.get();
+  }
+
+  bool operator!=(const CopyOnWrite &Other) const {
+    return not(*this == Other);
+  }
+};
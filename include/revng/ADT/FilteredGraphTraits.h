@@ -4,9 +4,13 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <cstddef>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 // LLVM Includes
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/GraphTraits.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/iterator_range.h"
@@ -357,3 +361,339 @@ using EdgeFilter = bool (*)(const typename llvm::GraphTraits<NodeT>::EdgeRef &);
 
 template<typename NodeT, EdgeFilter<NodeT> F>
 using EdgeFilteredGraph = EdgeFilteredGraphImpl<NodeT, ic<decltype(F), F>>;
+
+//
+// Materialized filtered views on graphs
+//
+
+/// Cache of the children (or child edges) of each node accepted by a filter.
+///
+/// The accepted elements of all the nodes are stored in a single vector, each
+/// node owns a contiguous range of it. Iterators refer to the vector through
+/// an index, so that they stay valid while the children of other nodes are
+/// being computed, which happens all the time during a traversal.
+///
+/// \tparam StoredT the type of the stored elements, either a NodeRef or an
+///         iterator over the edges of the underlying graph.
+/// \tparam ReferenceT what the iterators dereference to.
+template<typename NodeRef, typename StoredT, typename ReferenceT>
+class FilteredChildrenCache {
+private:
+  using Storage = std::vector<StoredT>;
+
+public:
+  class iterator
+    : public llvm::iterator_facade_base<iterator,
+                                        std::forward_iterator_tag,
+                                        std::remove_reference_t<ReferenceT>,
+                                        std::ptrdiff_t,
+                                        std::remove_reference_t<ReferenceT> *,
+                                        ReferenceT> {
+  private:
+    const Storage *Values = nullptr;
+    size_t Index = 0;
+
+  public:
+    iterator() = default;
+    iterator(const Storage *Values, size_t Index) :
+      Values(Values), Index(Index) {}
+
+    bool operator==(const iterator &Other) const {
+      return Values == Other.Values and Index == Other.Index;
+    }
+
+    ReferenceT operator*() const {
+      const StoredT &Value = (*Values)[Index];
+      if constexpr (std::is_same_v<std::decay_t<ReferenceT>, StoredT>)
+        return Value;
+      else
+        return *Value;
+    }
+
+    iterator &operator++() {
+      ++Index;
+      return *this;
+    }
+
+    iterator operator++(int) {
+      iterator Result = *this;
+      ++Index;
+      return Result;
+    }
+  };
+
+private:
+  Storage Values;
+  llvm::DenseMap<NodeRef, std::pair<size_t, size_t>> Ranges;
+
+public:
+  /// Return the cached children of \p N, invoking \p Compute to append them
+  /// to the storage if they are not available yet
+  template<typename ComputeT>
+  llvm::iterator_range<iterator> get(NodeRef N, ComputeT &&Compute) {
+    auto It = Ranges.find(N);
+    if (It == Ranges.end()) {
+      size_t Begin = Values.size();
+      Compute(Values);
+      It = Ranges.insert({ N, { Begin, Values.size() } }).first;
+    }
+
+    auto [Begin, End] = It->second;
+    return llvm::make_range(iterator(&Values, Begin), iterator(&Values, End));
+  }
+
+  /// Forget the children of \p N, they will be computed again on the next
+  /// request
+  void invalidate(NodeRef N) { Ranges.erase(N); }
+
+  void invalidate() {
+    Values.clear();
+    Ranges.clear();
+  }
+};
+
+/// Materialized version of NodePairFilteredGraphImpl: the predicate is
+/// evaluated only the first time the children (or the predecessors, through
+/// Inverse) of a node are requested, after that they are served from a
+/// FilteredChildrenCache.
+///
+/// GraphTraits only offer static accessors, therefore the cache is shared by
+/// all the views with the same GraphType and PredicateType. Call invalidate()
+/// whenever the underlying graph, or anything the predicate depends upon,
+/// changes.
+template<typename GraphType, typename PredicateType>
+struct CachedNodePairFilteredGraphImpl
+  : public NodePairFilteredGraphImpl<GraphType, PredicateType> {
+private:
+  using Base = NodePairFilteredGraphImpl<GraphType, PredicateType>;
+  using BaseGraphTraits = llvm::GraphTraits<GraphType>;
+  using InvGraphTraits = llvm::GraphTraits<llvm::Inverse<GraphType>>;
+
+public:
+  using NodeRef = typename Base::NodeRef;
+  using Cache = FilteredChildrenCache<NodeRef, NodeRef, NodeRef>;
+  using ChildIteratorType = typename Cache::iterator;
+
+public:
+  using Base::Base;
+
+public:
+  static auto children(NodeRef N) {
+    auto Compute = [N](std::vector<NodeRef> &Values) {
+      for (NodeRef Child : llvm::make_range(BaseGraphTraits::child_begin(N),
+                                            BaseGraphTraits::child_end(N)))
+        if (PredicateType::value(N, Child))
+          Values.push_back(Child);
+    };
+    return successorsCache().get(N, Compute);
+  }
+
+  static auto inverseChildren(NodeRef N) {
+    auto Compute = [N](std::vector<NodeRef> &Values) {
+      for (NodeRef Parent : llvm::make_range(InvGraphTraits::child_begin(N),
+                                             InvGraphTraits::child_end(N)))
+        if (PredicateType::value(Parent, N))
+          Values.push_back(Parent);
+    };
+    return predecessorsCache().get(N, Compute);
+  }
+
+  static ChildIteratorType child_begin(NodeRef N) {
+    return children(N).begin();
+  }
+  static ChildIteratorType child_end(NodeRef N) { return children(N).end(); }
+
+  static void invalidate(NodeRef N) {
+    successorsCache().invalidate(N);
+    predecessorsCache().invalidate(N);
+  }
+
+  static void invalidate() {
+    successorsCache().invalidate();
+    predecessorsCache().invalidate();
+  }
+
+private:
+  static Cache &successorsCache() {
+    static Cache Successors;
+    return Successors;
+  }
+
+  static Cache &predecessorsCache() {
+    static Cache Predecessors;
+    return Predecessors;
+  }
+};
+
+template<typename GraphType, typename PredicateType>
+struct llvm::Inverse<CachedNodePairFilteredGraphImpl<GraphType, PredicateType>>
+  : public llvm::Inverse<NodePairFilteredGraphImpl<GraphType, PredicateType>> {
+private:
+  using CNPFGT = CachedNodePairFilteredGraphImpl<GraphType, PredicateType>;
+  using Base = llvm::Inverse<NodePairFilteredGraphImpl<GraphType,
+                                                       PredicateType>>;
+
+public:
+  using NodeRef = typename CNPFGT::NodeRef;
+  using ChildIteratorType = typename CNPFGT::ChildIteratorType;
+
+public:
+  inline explicit Inverse(const GraphType &G) : Base(G) {}
+  inline explicit Inverse(const CNPFGT &FG) :
+    Base(static_cast<const GraphType &>(FG)) {}
+
+public:
+  static ChildIteratorType child_begin(NodeRef N) {
+    return CNPFGT::inverseChildren(N).begin();
+  }
+  static ChildIteratorType child_end(NodeRef N) {
+    return CNPFGT::inverseChildren(N).end();
+  }
+};
+
+template<typename GraphType, typename Pred>
+struct llvm::GraphTraits<CachedNodePairFilteredGraphImpl<GraphType, Pred>>
+  : public CachedNodePairFilteredGraphImpl<GraphType, Pred> {};
+
+template<typename GT, typename Pred>
+struct llvm::GraphTraits<
+  llvm::Inverse<CachedNodePairFilteredGraphImpl<GT, Pred>>>
+  : public llvm::Inverse<CachedNodePairFilteredGraphImpl<GT, Pred>> {};
+
+template<typename NodeT, NodePairFilter<NodeT> F>
+using CachedNodePairFilteredGraph = CachedNodePairFilteredGraphImpl<
+  NodeT,
+  ic<decltype(F), F>>;
+
+/// Materialized version of EdgeFilteredGraphImpl, see
+/// CachedNodePairFilteredGraphImpl. The iterators over the accepted edges of
+/// the underlying graph are cached, so they have to stay valid until the next
+/// invalidation.
+template<typename GraphType, typename PredicateType>
+struct CachedEdgeFilteredGraphImpl
+  : public EdgeFilteredGraphImpl<GraphType, PredicateType> {
+private:
+  using Base = EdgeFilteredGraphImpl<GraphType, PredicateType>;
+  using BaseGraphTraits = llvm::GraphTraits<GraphType>;
+  using InvGraphTraits = llvm::GraphTraits<llvm::Inverse<GraphType>>;
+  using BaseChildEdgeIt = typename BaseGraphTraits::ChildEdgeIteratorType;
+  using InvChildEdgeIt = typename InvGraphTraits::ChildEdgeIteratorType;
+
+public:
+  using NodeRef = typename Base::NodeRef;
+  using EdgeRef = typename Base::EdgeRef;
+  using Cache = FilteredChildrenCache<NodeRef, BaseChildEdgeIt, EdgeRef>;
+  using InverseCache = FilteredChildrenCache<NodeRef, InvChildEdgeIt, EdgeRef>;
+  using ChildEdgeIteratorType = typename Cache::iterator;
+  using InverseChildEdgeIteratorType = typename InverseCache::iterator;
+
+public:
+  using Base::Base;
+
+public:
+  static auto childEdges(NodeRef N) {
+    auto Compute = [N](std::vector<BaseChildEdgeIt> &Values) {
+      auto End = BaseGraphTraits::child_edge_end(N);
+      for (auto It = BaseGraphTraits::child_edge_begin(N); It != End; ++It)
+        if (PredicateType::value(*It))
+          Values.push_back(It);
+    };
+    return successorsCache().get(N, Compute);
+  }
+
+  static auto inverseChildEdges(NodeRef N) {
+    auto Compute = [N](std::vector<InvChildEdgeIt> &Values) {
+      auto End = InvGraphTraits::child_edge_end(N);
+      for (auto It = InvGraphTraits::child_edge_begin(N); It != End; ++It)
+        if (PredicateType::value(*It))
+          Values.push_back(It);
+    };
+    return predecessorsCache().get(N, Compute);
+  }
+
+  static ChildEdgeIteratorType child_edge_begin(NodeRef N) {
+    return childEdges(N).begin();
+  }
+  static ChildEdgeIteratorType child_edge_end(NodeRef N) {
+    return childEdges(N).end();
+  }
+
+  using ChildIteratorType = llvm::mapped_iterator<ChildEdgeIteratorType,
+                                                  NodeRef (*)(EdgeRef)>;
+  static ChildIteratorType child_begin(NodeRef N) {
+    return llvm::map_iterator(child_edge_begin(N), Base::edge_dest);
+  }
+  static ChildIteratorType child_end(NodeRef N) {
+    return llvm::map_iterator(child_edge_end(N), Base::edge_dest);
+  }
+
+  static void invalidate(NodeRef N) {
+    successorsCache().invalidate(N);
+    predecessorsCache().invalidate(N);
+  }
+
+  static void invalidate() {
+    successorsCache().invalidate();
+    predecessorsCache().invalidate();
+  }
+
+private:
+  static Cache &successorsCache() {
+    static Cache Successors;
+    return Successors;
+  }
+
+  static InverseCache &predecessorsCache() {
+    static InverseCache Predecessors;
+    return Predecessors;
+  }
+};
+
+template<typename GraphType, typename PredicateType>
+struct llvm::Inverse<CachedEdgeFilteredGraphImpl<GraphType, PredicateType>>
+  : public llvm::Inverse<EdgeFilteredGraphImpl<GraphType, PredicateType>> {
+private:
+  using CEFGT = CachedEdgeFilteredGraphImpl<GraphType, PredicateType>;
+  using Base = llvm::Inverse<EdgeFilteredGraphImpl<GraphType, PredicateType>>;
+
+public:
+  using NodeRef = typename CEFGT::NodeRef;
+  using EdgeRef = typename CEFGT::EdgeRef;
+  using ChildEdgeIteratorType = typename CEFGT::InverseChildEdgeIteratorType;
+
+public:
+  inline explicit Inverse(const GraphType &G) : Base(G) {}
+  inline explicit Inverse(const CEFGT &FG) :
+    Base(static_cast<const GraphType &>(FG)) {}
+
+public:
+  static ChildEdgeIteratorType child_edge_begin(NodeRef N) {
+    return CEFGT::inverseChildEdges(N).begin();
+  }
+  static ChildEdgeIteratorType child_edge_end(NodeRef N) {
+    return CEFGT::inverseChildEdges(N).end();
+  }
+
+  using ChildIteratorType = llvm::mapped_iterator<ChildEdgeIteratorType,
+                                                  NodeRef (*)(EdgeRef)>;
+  static ChildIteratorType child_begin(NodeRef N) {
+    return llvm::map_iterator(child_edge_begin(N), Base::edge_dest);
+  }
+  static ChildIteratorType child_end(NodeRef N) {
+    return llvm::map_iterator(child_edge_end(N), Base::edge_dest);
+  }
+};
+
+template<typename GraphType, typename Pred>
+struct llvm::GraphTraits<CachedEdgeFilteredGraphImpl<GraphType, Pred>>
+  : public CachedEdgeFilteredGraphImpl<GraphType, Pred> {};
+
+template<typename GraphType, typename Pred>
+struct llvm::GraphTraits<
+  llvm::Inverse<CachedEdgeFilteredGraphImpl<GraphType, Pred>>>
+  : public llvm::Inverse<CachedEdgeFilteredGraphImpl<GraphType, Pred>> {};
+
+template<typename NodeT, EdgeFilter<NodeT> F>
+using CachedEdgeFilteredGraph = CachedEdgeFilteredGraphImpl<NodeT,
+                                                            ic<decltype(F),
+                                                               F>>;
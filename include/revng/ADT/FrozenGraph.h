@@ -0,0 +1,264 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/GraphTraits.h"
+#include "llvm/ADT/STLExtras.h"
+
+#include "revng/ADT/GenericGraph.h"
+
+/// FrozenGraph is an immutable, compressed sparse row copy of a GenericGraph.
+///
+/// The payloads of all the nodes are stored contiguously and the successors
+/// (and predecessors) of all the nodes are stored in two arrays, each node
+/// pointing to its own slice. This makes traversals considerably cheaper than
+/// on the original graph, at the price of forbidding any change of the
+/// topology. Edge labels are not preserved.
+///
+/// Use `freeze(Graph)` to obtain a FrozenGraph. The GraphTraits
+/// specializations below make it a drop-in replacement for the original graph
+/// in read-only algorithms.
+
+template<typename T>
+concept IsFrozenNode = requires {
+  T::is_frozen_node;
+};
+
+template<typename T>
+concept IsFrozenGraph = requires {
+  T::is_frozen_graph;
+  typename T::Node;
+};
+
+template<typename NodeData>
+class FrozenGraph;
+
+/// Node of a FrozenGraph: the original payload plus its neighbors
+template<typename NodeDataT>
+class FrozenNode : public NodeDataT {
+public:
+  static constexpr bool is_frozen_node = true;
+  using NodeData = NodeDataT;
+  using child_iterator = FrozenNode *const *;
+
+private:
+  friend class FrozenGraph<NodeDataT>;
+
+  llvm::ArrayRef<FrozenNode *> Successors;
+  llvm::ArrayRef<FrozenNode *> Predecessors;
+
+public:
+  explicit FrozenNode(const NodeDataT &Data) : NodeDataT(Data) {}
+
+public:
+  // This stuff is needed by the DominatorTree implementation
+  void printAsOperand(llvm::raw_ostream &, bool) const { revng_abort(); }
+
+public:
+  llvm::ArrayRef<FrozenNode *> successors() const { return Successors; }
+  llvm::ArrayRef<FrozenNode *> predecessors() const { return Predecessors; }
+
+  bool hasSuccessors() const { return Successors.size() != 0; }
+  size_t successorCount() const { return Successors.size(); }
+
+  bool hasPredecessors() const { return Predecessors.size() != 0; }
+  size_t predecessorCount() const { return Predecessors.size(); }
+};
+
+template<typename NodeData>
+class FrozenGraph {
+public:
+  static constexpr bool is_frozen_graph = true;
+  using Node = FrozenNode<NodeData>;
+  using NodesContainer = std::vector<Node>;
+
+private:
+  NodesContainer Nodes;
+  std::vector<Node *> Successors;
+  std::vector<Node *> Predecessors;
+  Node *EntryNode = nullptr;
+
+public:
+  FrozenGraph() = default;
+
+  // Nodes point into the neighbors arrays, which are preserved by moves
+  FrozenGraph(const FrozenGraph &) = delete;
+  FrozenGraph &operator=(const FrozenGraph &) = delete;
+  FrozenGraph(FrozenGraph &&) = default;
+  FrozenGraph &operator=(FrozenGraph &&) = default;
+
+public:
+  static Node *getNode(Node &N) { return &N; }
+  static const Node *getConstNode(const Node &N) { return &N; }
+
+private:
+  using nodes_iterator_impl = typename NodesContainer::iterator;
+  using const_nodes_iterator_impl = typename NodesContainer::const_iterator;
+
+public:
+  using nodes_iterator = llvm::mapped_iterator<nodes_iterator_impl,
+                                               decltype(&getNode)>;
+  using const_nodes_iterator = llvm::mapped_iterator<const_nodes_iterator_impl,
+                                                     decltype(&getConstNode)>;
+
+  llvm::iterator_range<nodes_iterator> nodes() {
+    return llvm::map_range(llvm::make_range(Nodes.begin(), Nodes.end()),
+                           getNode);
+  }
+
+  llvm::iterator_range<const_nodes_iterator> nodes() const {
+    return llvm::map_range(llvm::make_range(Nodes.begin(), Nodes.end()),
+                           getConstNode);
+  }
+
+  size_t size() const { return Nodes.size(); }
+  bool hasNodes() const { return Nodes.size() != 0; }
+
+  Node *getEntryNode() const { return EntryNode; }
+
+  /// \brief Position of \p N in nodes(), i.e., in the original graph
+  size_t indexOf(const Node *N) const { return N - Nodes.data(); }
+
+public:
+  /// \brief Build a FrozenGraph out of the GenericGraph \p Graph
+  ///
+  /// Nodes are stored in the same order of Graph.nodes(), successors and
+  /// predecessors in the same order as in the original nodes.
+  template<IsGenericGraph G>
+  static FrozenGraph fromGenericGraph(const G &Graph) {
+    using OriginalNode = typename G::Node;
+    FrozenGraph Result;
+
+    llvm::DenseMap<const OriginalNode *, uint32_t> Indices;
+    Result.Nodes.reserve(Graph.size());
+    for (const OriginalNode *N : Graph.nodes()) {
+      Indices[N] = Result.Nodes.size();
+      Result.Nodes.emplace_back(static_cast<const NodeData &>(*N));
+    }
+
+    // Collect the successors of each node and count the predecessors
+    std::vector<uint32_t> SuccessorsStart;
+    std::vector<uint32_t> PredecessorsStart(Graph.size() + 1, 0);
+    std::vector<uint32_t> SuccessorIndices;
+    SuccessorsStart.reserve(Graph.size() + 1);
+    for (const OriginalNode *N : Graph.nodes()) {
+      SuccessorsStart.push_back(SuccessorIndices.size());
+      for (const auto *Successor : N->successors()) {
+        uint32_t Index = Indices.lookup(Successor);
+        SuccessorIndices.push_back(Index);
+        ++PredecessorsStart[Index + 1];
+      }
+    }
+    SuccessorsStart.push_back(SuccessorIndices.size());
+
+    for (size_t I = 1; I < PredecessorsStart.size(); ++I)
+      PredecessorsStart[I] += PredecessorsStart[I - 1];
+
+    // Fill the neighbors arrays
+    Node *Base = Result.Nodes.data();
+    Result.Successors.resize(SuccessorIndices.size());
+    Result.Predecessors.resize(SuccessorIndices.size());
+    std::vector<uint32_t> NextPredecessor(PredecessorsStart.begin(),
+                                          PredecessorsStart.end() - 1);
+    for (uint32_t I = 0; I < Graph.size(); ++I) {
+      for (uint32_t J = SuccessorsStart[I]; J < SuccessorsStart[I + 1]; ++J) {
+        uint32_t Successor = SuccessorIndices[J];
+        Result.Successors[J] = Base + Successor;
+        Result.Predecessors[NextPredecessor[Successor]++] = Base + I;
+      }
+    }
+
+    // Point each node to its own slices
+    for (uint32_t I = 0; I < Graph.size(); ++I) {
+      Node &N = Result.Nodes[I];
+      N.Successors = llvm::ArrayRef<Node *>(Result.Successors)
+                       .slice(SuccessorsStart[I],
+                              SuccessorsStart[I + 1] - SuccessorsStart[I]);
+      N.Predecessors = llvm::ArrayRef<Node *>(Result.Predecessors)
+                         .slice(PredecessorsStart[I],
+                                PredecessorsStart[I + 1]
+                                  - PredecessorsStart[I]);
+    }
+
+    if constexpr (G::hasEntryNode) {
+      if (Graph.getEntryNode() != nullptr)
+        Result.EntryNode = Base + Indices.lookup(Graph.getEntryNode());
+    }
+
+    return Result;
+  }
+};
+
+/// \brief Produce an immutable, compressed sparse row copy of \p Graph
+template<IsGenericGraph G>
+FrozenGraph<typename G::Node::NodeData> freeze(const G &Graph) {
+  using NodeData = typename G::Node::NodeData;
+  return FrozenGraph<NodeData>::fromGenericGraph(Graph);
+}
+
+//
+// GraphTraits implementation for FrozenGraph
+//
+namespace llvm {
+
+/// Implement GraphTraits<FrozenNode>
+template<IsFrozenNode T>
+struct GraphTraits<T *> {
+public:
+  using NodeRef = T *;
+  using ChildIteratorType = typename T::child_iterator;
+
+public:
+  static ChildIteratorType child_begin(NodeRef N) {
+    return N->successors().begin();
+  }
+
+  static ChildIteratorType child_end(NodeRef N) {
+    return N->successors().end();
+  }
+
+  static NodeRef getEntryNode(NodeRef N) { return N; };
+};
+
+/// Implement GraphTraits<Inverse<FrozenNode>>
+template<IsFrozenNode T>
+struct GraphTraits<llvm::Inverse<T *>> {
+public:
+  using NodeRef = T *;
+  using ChildIteratorType = typename T::child_iterator;
+
+public:
+  static ChildIteratorType child_begin(NodeRef N) {
+    return N->predecessors().begin();
+  }
+
+  static ChildIteratorType child_end(NodeRef N) {
+    return N->predecessors().end();
+  }
+
+  static NodeRef getEntryNode(llvm::Inverse<NodeRef> N) { return N.Graph; };
+};
+
+/// Implement GraphTraits<FrozenGraph>
+template<IsFrozenGraph T>
+struct GraphTraits<T *> : public GraphTraits<typename T::Node *> {
+  using NodeRef = typename T::Node *;
+  using nodes_iterator = typename T::nodes_iterator;
+
+  static NodeRef getEntryNode(T *G) { return G->getEntryNode(); }
+
+  static nodes_iterator nodes_begin(T *G) { return G->nodes().begin(); }
+
+  static nodes_iterator nodes_end(T *G) { return G->nodes().end(); }
+
+  static size_t size(T *G) { return G->size(); }
+};
+
+} // namespace llvm
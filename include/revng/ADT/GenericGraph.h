@@ -9,6 +9,7 @@
 #include "llvm/ADT/GraphTraits.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Allocator.h"
 
 #include "revng/ADT/STLExtras.h"
 #include "revng/Support/Debug.h"
@@ -207,6 +208,8 @@ class ForwardNode
 public:
   static constexpr bool is_forward_node = true;
   static constexpr bool HasParent = NeedsParent;
+  using NodeData = Node;
+  using EdgeLabelData = EdgeLabel;
   using TypeCalc = detail::ForwardNodeBaseTCalc<Node,
                                                 EdgeLabel,
                                                 NeedsParent,
@@ -1149,16 +1152,45 @@ public:
   void setEntryNode(NodeT *EntryNode) { this->EntryNode = EntryNode; }
 };
 
+namespace detail {
+/// Deleter for the nodes of a GenericGraph
+///
+/// Nodes allocated in the arena of the graph are only destroyed, their memory
+/// is released all at once together with the arena. Nodes handed over to the
+/// graph through a std::unique_ptr are deleted as usual.
+template<typename NodeT>
+struct NodeDeleter {
+  bool InArena = false;
+
+  NodeDeleter() = default;
+  explicit NodeDeleter(bool InArena) : InArena(InArena) {}
+  NodeDeleter(std::default_delete<NodeT>) {}
+
+  void operator()(NodeT *N) const {
+    if (InArena)
+      N->~NodeT();
+    else
+      delete N;
+  }
+};
+} // namespace detail
+
 /// Generic graph parametrized in the node type
 ///
 /// This graph owns its nodes (but not the edges).
 /// It can optionally have an elected entry point.
+///
+/// Nodes created by the graph itself are allocated in a bump pointer arena:
+/// they end up next to each other in memory and are released in bulk when
+/// the graph is cleared or destroyed. The memory of removed nodes is not
+/// reused until then.
 template<typename NodeT, size_t SmallSize, bool HasEntryNode>
 class GenericGraph
   : public std::conditional_t<HasEntryNode, EntryNode<NodeT>, Empty> {
 public:
   static const bool is_generic_graph = true;
-  using NodesContainer = llvm::SmallVector<std::unique_ptr<NodeT>, SmallSize>;
+  using NodePointer = std::unique_ptr<NodeT, detail::NodeDeleter<NodeT>>;
+  using NodesContainer = llvm::SmallVector<NodePointer, SmallSize>;
   using Node = NodeT;
   static constexpr bool hasEntryNode = HasEntryNode;
 
@@ -1167,10 +1199,8 @@ private:
   using const_nodes_iterator_impl = typename NodesContainer::const_iterator;
 
 public:
-  static NodeT *getNode(std::unique_ptr<NodeT> &E) { return E.get(); }
-  static const NodeT *getConstNode(const std::unique_ptr<NodeT> &E) {
-    return E.get();
-  }
+  static NodeT *getNode(NodePointer &E) { return E.get(); }
+  static const NodeT *getConstNode(const NodePointer &E) { return E.get(); }
 
   // TODO: these iterators will not work with llvm::filter_iterator,
   //       since the mapped type is not a reference
@@ -1219,7 +1249,7 @@ public:
 
   template<class... Args>
   NodeT *addNode(Args &&...A) {
-    Nodes.push_back(std::make_unique<NodeT>(std::forward<Args>(A)...));
+    Nodes.push_back(makeNode(std::forward<Args>(A)...));
     if constexpr (NodeT::HasParent)
       Nodes.back()->setParent(this);
     return Nodes.back().get();
@@ -1244,16 +1274,30 @@ public:
   }
   template<class... Args>
   nodes_iterator insertNode(nodes_iterator Where, Args &&...A) {
-    auto Pointer = std::make_unique<NodeT>(std::forward<Args>(A)...);
+    auto Pointer = makeNode(std::forward<Args>(A)...);
     auto InternalIt = Nodes.insert(Where.getCurrent(), std::move(Pointer));
     return nodes_iterator(InternalIt, getNode);
   }
 
 public:
   void reserve(size_t Size) { Nodes.reserve(Size); }
-  void clear() { Nodes.clear(); }
+  void clear() {
+    Nodes.clear();
+    Arena.Reset();
+  }
+
+private:
+  template<class... Args>
+  NodePointer makeNode(Args &&...A) {
+    void *Memory = Arena.Allocate(sizeof(NodeT), alignof(NodeT));
+    using Deleter = detail::NodeDeleter<NodeT>;
+    return NodePointer(new (Memory) NodeT(std::forward<Args>(A)...),
+                       Deleter(true));
+  }
 
 private:
+  // The arena must outlive the nodes
+  llvm::BumpPtrAllocator Arena;
   NodesContainer Nodes;
 };
 
@@ -0,0 +1,165 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "llvm/ADT/STLExtras.h"
+
+#include "revng/Support/Assert.h"
+
+/// \brief Immutable index of half-open intervals, each associated to a \p T
+///
+/// The intervals are stored in a flat vector, sorted by start, which is also an
+/// implicit binary search tree: the node at index `I` has level `K` if the `K`
+/// lowest bits of `I` are set and bit `K` is not. Each node records the highest
+/// end in its subtree, which allows to skip the subtrees that cannot overlap
+/// the query.
+///
+/// Queries take O(log n + m), where m is the number of results, and perform no
+/// allocations.
+template<typename T>
+class IntervalIndex {
+public:
+  struct Entry {
+    uint64_t Start;
+    uint64_t End;
+    T Value;
+  };
+
+private:
+  /// Subtrees at this level or below are scanned linearly
+  static constexpr unsigned LinearScanLevel = 3;
+
+private:
+  std::vector<Entry> Entries;
+  std::vector<uint64_t> MaxEnds;
+  unsigned MaxLevel = 0;
+
+public:
+  IntervalIndex() = default;
+
+  /// \note Empty intervals are dropped.
+  explicit IntervalIndex(std::vector<Entry> NewEntries) {
+    auto IsEmpty = [](const Entry &E) { return E.End <= E.Start; };
+    llvm::erase_if(NewEntries, IsEmpty);
+
+    auto Compare = [](const Entry &LHS, const Entry &RHS) {
+      return LHS.Start < RHS.Start;
+    };
+    std::stable_sort(NewEntries.begin(), NewEntries.end(), Compare);
+
+    Entries = std::move(NewEntries);
+    build();
+  }
+
+public:
+  size_t size() const { return Entries.size(); }
+  bool empty() const { return Entries.empty(); }
+
+  /// \brief Invoke \p Callback on each entry containing \p Point
+  template<typename F>
+  void forEachContaining(uint64_t Point, F &&Callback) const {
+    visit(Point, Point, Callback);
+  }
+
+  /// \brief Invoke \p Callback on each entry overlapping [\p Start, \p End)
+  template<typename F>
+  void forEachOverlapping(uint64_t Start, uint64_t End, F &&Callback) const {
+    if (Start < End)
+      visit(Start, End - 1, Callback);
+  }
+
+private:
+  /// \brief Invoke \p Callback on each entry overlapping [\p First, \p Last]
+  template<typename F>
+  void visit(uint64_t First, uint64_t Last, F &Callback) const {
+    struct Visit {
+      size_t Index;
+      unsigned Level;
+      bool LeftDone;
+    };
+
+    size_t Size = Entries.size();
+    if (Size == 0)
+      return;
+
+    // Each level of the tree contributes at most two nodes to the stack
+    Visit Stack[2 * 64];
+    unsigned Top = 0;
+    Stack[Top++] = { (size_t(1) << MaxLevel) - 1, MaxLevel, false };
+
+    while (Top != 0) {
+      Visit Current = Stack[--Top];
+      size_t Index = Current.Index;
+      unsigned Level = Current.Level;
+
+      if (Level <= LinearScanLevel) {
+        // Scan the whole subtree
+        size_t Begin = Index >> Level << Level;
+        size_t End = std::min(Begin + (size_t(1) << (Level + 1)) - 1, Size);
+        for (size_t I = Begin; I < End and Entries[I].Start <= Last; ++I)
+          if (First < Entries[I].End)
+            Callback(Entries[I]);
+      } else if (not Current.LeftDone) {
+        // Visit the left subtree first, then come back to this node
+        size_t Left = Index - (size_t(1) << (Level - 1));
+        Stack[Top++] = { Index, Level, true };
+        if (Left >= Size or MaxEnds[Left] > First)
+          Stack[Top++] = { Left, Level - 1, false };
+      } else if (Index < Size and Entries[Index].Start <= Last) {
+        if (First < Entries[Index].End)
+          Callback(Entries[Index]);
+
+        size_t Right = Index + (size_t(1) << (Level - 1));
+        Stack[Top++] = { Right, Level - 1, false };
+      }
+    }
+  }
+
+  void build() {
+    size_t Size = Entries.size();
+    MaxEnds.resize(Size);
+    if (Size == 0)
+      return;
+
+    // Leaves
+    size_t LastIndex = 0;
+    uint64_t LastMaxEnd = 0;
+    for (size_t I = 0; I < Size; I += 2) {
+      LastIndex = I;
+      LastMaxEnd = MaxEnds[I] = Entries[I].End;
+    }
+
+    // Inner nodes, one level at a time. Nodes whose right subtree is out of
+    // bounds consider the highest end of the last existing node.
+    unsigned Level = 1;
+    for (; (size_t(1) << Level) <= Size; ++Level) {
+      size_t HalfSpan = size_t(1) << (Level - 1);
+      size_t First = (HalfSpan << 1) - 1;
+      size_t Step = HalfSpan << 2;
+      for (size_t I = First; I < Size; I += Step) {
+        uint64_t LeftMaxEnd = MaxEnds[I - HalfSpan];
+        uint64_t RightMaxEnd = LastMaxEnd;
+        if (I + HalfSpan < Size)
+          RightMaxEnd = MaxEnds[I + HalfSpan];
+        MaxEnds[I] = std::max({ Entries[I].End, LeftMaxEnd, RightMaxEnd });
+      }
+
+      // Move to the parent of the last node, which might be out of bounds
+      if (((LastIndex >> Level) & 1) == 1)
+        LastIndex -= HalfSpan;
+      else
+        LastIndex += HalfSpan;
+      if (LastIndex < Size and MaxEnds[LastIndex] > LastMaxEnd)
+        LastMaxEnd = MaxEnds[LastIndex];
+    }
+
+    MaxLevel = Level - 1;
+    revng_assert(MaxLevel < 64);
+  }
+};
@@ -0,0 +1,228 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/LEB128.h"
+#include "llvm/Support/raw_ostream.h"
+
+/// \brief Set of half-open intervals stored in a flat, sorted vector
+///
+/// Overlapping and adjacent intervals are merged, therefore the stored
+/// intervals are disjoint and separated by a gap.
+///
+/// Insertions in ascending order of start take O(1). The others are buffered
+/// and merged in bulk by the next query. Queries take O(log n), but the
+/// interval found by the last query is checked first: runs of queries hitting
+/// the same interval take O(1).
+///
+/// The serialized form is the number of intervals followed, for each
+/// interval, by the distance of its start from the end of the previous one
+/// and by its size, all encoded as ULEB128.
+///
+/// \note Queries update the buffer and the cache: an IntervalSet must not be
+///       accessed by multiple threads at the same time, not even to read it.
+class IntervalSet {
+public:
+  struct Interval {
+    uint64_t Start;
+    uint64_t End;
+
+    bool operator==(const Interval &) const = default;
+  };
+
+private:
+  mutable std::vector<Interval> Intervals;
+  mutable std::vector<Interval> Pending;
+  mutable size_t LastHit = 0;
+
+public:
+  IntervalSet() = default;
+
+  /// \brief Bulk build, \p NewIntervals don't need to be sorted
+  explicit IntervalSet(std::vector<Interval> NewIntervals) :
+    Pending(std::move(NewIntervals)) {
+    flush();
+  }
+
+public:
+  /// \brief Add [\p Start, \p End) to the set, empty intervals are ignored
+  void insert(uint64_t Start, uint64_t End) {
+    if (End <= Start)
+      return;
+
+    // Fast path: extend or follow the last interval
+    if (Pending.empty()
+        and (Intervals.empty() or Start >= Intervals.back().Start)) {
+      if (not Intervals.empty() and Start <= Intervals.back().End)
+        Intervals.back().End = std::max(Intervals.back().End, End);
+      else
+        Intervals.push_back({ Start, End });
+      return;
+    }
+
+    Pending.push_back({ Start, End });
+  }
+
+  /// \brief Get the interval containing \p Point, if any
+  const Interval *find(uint64_t Point) const {
+    flush();
+
+    if (LastHit < Intervals.size() and contains(Intervals[LastHit], Point))
+      return &Intervals[LastHit];
+
+    // Find the last interval starting at or before Point
+    auto IsAfter = [](uint64_t Point, const Interval &I) {
+      return Point < I.Start;
+    };
+    auto It = std::upper_bound(Intervals.begin(),
+                               Intervals.end(),
+                               Point,
+                               IsAfter);
+    if (It == Intervals.begin())
+      return nullptr;
+
+    --It;
+    if (not contains(*It, Point))
+      return nullptr;
+
+    LastHit = It - Intervals.begin();
+    return &*It;
+  }
+
+  bool contains(uint64_t Point) const { return find(Point) != nullptr; }
+
+  /// \brief Check whether any interval overlaps [\p Start, \p End)
+  bool overlaps(uint64_t Start, uint64_t End) const {
+    if (End <= Start)
+      return false;
+
+    flush();
+
+    // The first interval ending after Start is the only candidate
+    auto EndsBefore = [](const Interval &I, uint64_t Point) {
+      return I.End <= Point;
+    };
+    auto It = std::lower_bound(Intervals.begin(),
+                               Intervals.end(),
+                               Start,
+                               EndsBefore);
+    return It != Intervals.end() and It->Start < End;
+  }
+
+  llvm::ArrayRef<Interval> intervals() const {
+    flush();
+    return Intervals;
+  }
+
+  size_t size() const { return intervals().size(); }
+  bool empty() const { return Intervals.empty() and Pending.empty(); }
+
+  bool operator==(const IntervalSet &Other) const {
+    return intervals() == Other.intervals();
+  }
+
+public:
+  void serialize(llvm::raw_ostream &Output) const {
+    flush();
+
+    llvm::encodeULEB128(Intervals.size(), Output);
+    uint64_t PreviousEnd = 0;
+    for (const Interval &I : Intervals) {
+      llvm::encodeULEB128(I.Start - PreviousEnd, Output);
+      llvm::encodeULEB128(I.End - I.Start, Output);
+      PreviousEnd = I.End;
+    }
+  }
+
+  /// \return the deserialized set, or nothing if \p Buffer is malformed
+  static llvm::Optional<IntervalSet> deserialize(llvm::StringRef Buffer) {
+    const auto *Current = Buffer.bytes_begin();
+    const auto *End = Buffer.bytes_end();
+    const char *Error = nullptr;
+    auto Read = [&]() -> uint64_t {
+      if (Error != nullptr)
+        return 0;
+
+      unsigned Size = 0;
+      uint64_t Result = llvm::decodeULEB128(Current, &Size, End, &Error);
+      Current += Size;
+      return Result;
+    };
+
+    IntervalSet Result;
+    uint64_t Count = Read();
+
+    // Each interval takes at least two bytes
+    if (Error != nullptr or Count > Buffer.size() / 2)
+      return llvm::None;
+
+    Result.Intervals.reserve(Count);
+    uint64_t PreviousEnd = 0;
+    for (uint64_t I = 0; I < Count; ++I) {
+      uint64_t Start = PreviousEnd + Read();
+      uint64_t Size = Read();
+      // Intervals must be non-empty and separated by a gap
+      bool Overflow = Start < PreviousEnd or Start + Size < Start;
+      bool Adjacent = I != 0 and Start == PreviousEnd;
+      if (Error != nullptr or Overflow or Adjacent or Size == 0)
+        return llvm::None;
+
+      Result.Intervals.push_back({ Start, Start + Size });
+      PreviousEnd = Start + Size;
+    }
+
+    if (Current != End)
+      return llvm::None;
+
+    return Result;
+  }
+
+private:
+  static bool contains(const Interval &I, uint64_t Point) {
+    return I.Start <= Point and Point < I.End;
+  }
+
+  /// \brief Merge the buffered insertions into Intervals
+  void flush() const {
+    if (Pending.empty())
+      return;
+
+    auto Compare = [](const Interval &LHS, const Interval &RHS) {
+      return LHS.Start < RHS.Start;
+    };
+    llvm::erase_if(Pending, [](const Interval &I) { return I.End <= I.Start; });
+    std::sort(Pending.begin(), Pending.end(), Compare);
+
+    size_t OldSize = Intervals.size();
+    Intervals.insert(Intervals.end(), Pending.begin(), Pending.end());
+    Pending.clear();
+    std::inplace_merge(Intervals.begin(),
+                       Intervals.begin() + OldSize,
+                       Intervals.end(),
+                       Compare);
+
+    // Coalesce overlapping and adjacent intervals
+    size_t Last = 0;
+    for (size_t I = 1; I < Intervals.size(); ++I) {
+      if (Intervals[I].Start <= Intervals[Last].End)
+        Intervals[Last].End = std::max(Intervals[Last].End, Intervals[I].End);
+      else
+        Intervals[++Last] = Intervals[I];
+    }
+
+    if (not Intervals.empty())
+      Intervals.resize(Last + 1);
+
+    LastHit = 0;
+  }
+};
@@ -4,8 +4,10 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <map>
 #include <set>
 
+#include "llvm/ADT/Hashing.h"
 #include "llvm/Support/YAMLTraits.h"
 
 #include "revng/ADT/KeyedObjectTraits.h"
@@ -19,10 +21,22 @@ using KOTKey = decltype(KeyedObjectTraits<T>::key(std::declval<T>()));
 template<HasKeyObjectTraits T>
 using KOTCompare = std::less<const KOTKey<T>>;
 
-template<HasKeyObjectTraits T, class Compare = KOTCompare<T>>
+/// \brief Hash function for the keys of \p T, based on llvm::hash_value
+template<HasKeyObjectTraits T>
+struct KOTHash {
+  size_t operator()(const KOTKey<T> &Key) const {
+    return llvm::hash_value(Key);
+  }
+};
+
+template<HasKeyObjectTraits T,
+         class Compare = KOTCompare<T>,
+         class Map = std::map<KOTKey<T>, T, Compare>>
 class MutableSet;
 
-template<HasKeyObjectTraits T, class Compare = KOTCompare<T>>
+template<HasKeyObjectTraits T,
+         class Compare = KOTCompare<T>,
+         class KeyHash = void>
 class SortedVector;
 
 //
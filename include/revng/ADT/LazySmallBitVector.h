@@ -4,6 +4,7 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <bit>
 #include <climits>
 #include <cstdint>
 #include <cstring>
@@ -128,6 +129,9 @@ private:
       return Storage[Index];
     }
 
+    uintptr_t *data() { return Storage; }
+    const uintptr_t *data() const { return Storage; }
+
     void zero(size_t From, size_t Count) {
       revng_assert(From + Count <= wordCount());
       memset(&at(From), 0, Count * sizeof(uintptr_t));
@@ -141,7 +145,7 @@ private:
 
     LargeStorage &operator=(const LargeStorage &Other) {
       revng_assert(Capacity >= Other.Capacity);
-      memcpy(&at(0), &Other.at(0), Other.Capacity / sizeof(uintptr_t));
+      memcpy(data(), Other.data(), Other.wordCount() * sizeof(uintptr_t));
       return *this;
     }
 
@@ -296,46 +300,25 @@ public:
     if (isSmall() && Other.isSmall())
       return false;
 
-    if (!isSmall() && !Other.isSmall()) {
-      const LargeStorage &OtherLarge = Other.getLarge();
-      const LargeStorage &ThisLarge = getLarge();
-
-      unsigned Max = std::min(ThisLarge.capacity(), OtherLarge.capacity());
-      Max /= BitsPerPointer;
-
-      for (unsigned I = 0; I < Max; I++)
-        if (ThisLarge.at(I) != OtherLarge.at(I))
-          return false;
-
-      if (ThisLarge.capacity() > OtherLarge.capacity()) {
-        for (unsigned I = Max; I < ThisLarge.wordCount(); I++)
-          if (ThisLarge.at(I) != 0)
-            return false;
-      } else {
-        for (unsigned I = Max; I < OtherLarge.wordCount(); I++)
-          if (OtherLarge.at(I) != 0)
-            return false;
-      }
+    if (isSmall())
+      return Other == *this;
 
-    } else if (!isSmall() && Other.isSmall()) {
-      const LargeStorage &ThisLarge = getLarge();
-      if (ThisLarge.at(0) != Other.getSmall())
-        return false;
+    const LargeStorage &ThisLarge = getLarge();
+    const uintptr_t *ThisWords = ThisLarge.data();
+    size_t ThisCount = ThisLarge.wordCount();
 
-      for (unsigned I = 1; I < ThisLarge.wordCount(); I++)
-        if (ThisLarge.at(I) != 0)
-          return false;
-    } else if (isSmall() && !Other.isSmall()) {
-      const LargeStorage &OtherLarge = Other.getLarge();
-      if (OtherLarge.at(0) != getSmall())
-        return false;
+    if (Other.isSmall())
+      return ThisWords[0] == Other.getSmall()
+             and allZeroWords(ThisWords + 1, ThisCount - 1);
 
-      for (unsigned I = 1; I < OtherLarge.wordCount(); I++)
-        if (OtherLarge.at(I) != 0)
-          return false;
-    }
+    const LargeStorage &OtherLarge = Other.getLarge();
+    const uintptr_t *OtherWords = OtherLarge.data();
+    size_t OtherCount = OtherLarge.wordCount();
+    size_t Common = std::min(ThisCount, OtherCount);
 
-    return true;
+    return equalWords(ThisWords, OtherWords, Common)
+           and allZeroWords(ThisWords + Common, ThisCount - Common)
+           and allZeroWords(OtherWords + Common, OtherCount - Common);
   }
 
   bool operator!=(const LazySmallBitVector &Other) const {
@@ -403,10 +386,8 @@ public:
       const LargeStorage &OtherLarge = Other.getLarge();
       LargeStorage &ThisLarge = getLarge();
 
-      unsigned Max = std::min(ThisLarge.capacity(), OtherLarge.capacity());
-      Max /= BitsPerPointer;
-      for (unsigned I = 0; I < Max; I++)
-        ThisLarge.at(I) = ThisLarge.at(I) ^ OtherLarge.at(I);
+      size_t Max = std::min(ThisLarge.wordCount(), OtherLarge.wordCount());
+      xorWords(ThisLarge.data(), OtherLarge.data(), Max);
 
     } else if (!isSmall() && Other.isSmall()) {
       LargeStorage &ThisLarge = getLarge();
@@ -431,11 +412,8 @@ public:
       const LargeStorage &OtherLarge = Other.getLarge();
       LargeStorage &ThisLarge = getLarge();
 
-      unsigned Max = std::min(ThisLarge.capacity(), OtherLarge.capacity());
-      Max /= BitsPerPointer;
-
-      for (unsigned I = 0; I < Max; I++)
-        ThisLarge.at(I) = ThisLarge.at(I) | OtherLarge.at(I);
+      size_t Max = std::min(ThisLarge.wordCount(), OtherLarge.wordCount());
+      orWords(ThisLarge.data(), OtherLarge.data(), Max);
 
     } else if (!isSmall() && Other.isSmall()) {
       LargeStorage &ThisLarge = getLarge();
@@ -476,15 +454,41 @@ public:
                      ThisPointersCount - OtherPointersCount);
         }
 
-        unsigned Max = std::min(OtherPointersCount, ThisPointersCount);
-        for (unsigned I = 0; I < Max; I++)
-          Large.at(I) = Large.at(I) & OtherLarge.at(I);
+        size_t Max = std::min(OtherPointersCount, ThisPointersCount);
+        andWords(Large.data(), OtherLarge.data(), Max);
       }
     }
 
     return *this;
   }
 
+  friend LazySmallBitVector operator^(LazySmallBitVector Left,
+                                       const LazySmallBitVector &Right) {
+    Left ^= Right;
+    return Left;
+  }
+
+  friend LazySmallBitVector operator|(LazySmallBitVector Left,
+                                       const LazySmallBitVector &Right) {
+    Left |= Right;
+    return Left;
+  }
+
+  friend LazySmallBitVector operator&(LazySmallBitVector Left,
+                                       const LazySmallBitVector &Right) {
+    Left &= Right;
+    return Left;
+  }
+
+  /// \brief Number of bits set
+  unsigned count() const {
+    if (isSmall())
+      return std::popcount(getSmall());
+
+    const LargeStorage &Large = getLarge();
+    return countWords(Large.data(), Large.wordCount());
+  }
+
   LazySmallBitVector &operator>>=(unsigned Amount) {
     revng_assert(Amount <= capacity());
 
@@ -587,27 +591,35 @@ public:
   /// \return 0 if no bits are set after \p StartIndex, the 1-based index of the
   ///         next bit set otherwise
   unsigned findNext(unsigned StartIndex) const {
-    if (StartIndex >= requiredBits())
-      return 0;
-
     if (isSmall()) {
-      return StartIndex + findFirstBit(getSmall() >> StartIndex);
+      if (StartIndex >= MaxSmallSize)
+        return 0;
+
+      uintptr_t Value = getSmall() >> StartIndex;
+      if (Value == 0)
+        return 0;
+
+      return StartIndex + findFirstBit(Value);
     } else {
       const LargeStorage &Large = getLarge();
-      unsigned Index = StartIndex / BitsPerPointer;
+      if (StartIndex >= Large.capacity())
+        return 0;
+
+      const uintptr_t *Words = Large.data();
+      size_t WordCount = Large.wordCount();
+      size_t Index = StartIndex / BitsPerPointer;
       unsigned ShiftAmount = StartIndex % BitsPerPointer;
 
-      uintptr_t FirstValue = Large.at(Index) >> ShiftAmount;
+      uintptr_t FirstValue = Words[Index] >> ShiftAmount;
       if (FirstValue != 0)
         return StartIndex + findFirstBit(FirstValue);
 
-      do {
-        Index++;
-        if (Index * BitsPerPointer >= capacity())
-          return 0;
-      } while (Large.at(Index) == 0);
+      // Skip empty words without looking at their bits
+      for (Index++; Index < WordCount; Index++)
+        if (Words[Index] != 0)
+          return Index * BitsPerPointer + findFirstBit(Words[Index]);
 
-      return Index * BitsPerPointer + findFirstBit(Large.at(Index));
+      return 0;
     }
   }
 
@@ -627,6 +639,47 @@ private:
   friend iterator;
   friend const_iterator;
 
+  // The following helpers work on plain arrays of words, without per-word
+  // bounds checks, so that the compiler can vectorize them
+
+  static void
+  orWords(uintptr_t *Destination, const uintptr_t *Source, size_t Count) {
+    for (size_t I = 0; I < Count; I++)
+      Destination[I] |= Source[I];
+  }
+
+  static void
+  andWords(uintptr_t *Destination, const uintptr_t *Source, size_t Count) {
+    for (size_t I = 0; I < Count; I++)
+      Destination[I] &= Source[I];
+  }
+
+  static void
+  xorWords(uintptr_t *Destination, const uintptr_t *Source, size_t Count) {
+    for (size_t I = 0; I < Count; I++)
+      Destination[I] ^= Source[I];
+  }
+
+  static bool
+  equalWords(const uintptr_t *Left, const uintptr_t *Right, size_t Count) {
+    return memcmp(Left, Right, Count * sizeof(uintptr_t)) == 0;
+  }
+
+  static bool allZeroWords(const uintptr_t *Words, size_t Count) {
+    // Accumulate instead of returning early, so the loop has no branches
+    uintptr_t Accumulator = 0;
+    for (size_t I = 0; I < Count; I++)
+      Accumulator |= Words[I];
+    return Accumulator == 0;
+  }
+
+  static unsigned countWords(const uintptr_t *Words, size_t Count) {
+    unsigned Result = 0;
+    for (size_t I = 0; I < Count; I++)
+      Result += std::popcount(Words[I]);
+    return Result;
+  }
+
   uintptr_t getSmall() const {
     revng_assert(isSmall());
     return Storage >> 1;
@@ -710,8 +763,7 @@ inline LSBVI<LSBV>::LSBVI(LSBV *BitVector) :
   BitVector(BitVector), NextBitIndex(0) {
 
   revng_assert(BitVector != nullptr);
-  if (!BitVector->isZero())
-    increment();
+  increment();
 }
 
 template<typename LSBV>
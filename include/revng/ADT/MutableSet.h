@@ -4,11 +4,27 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
+#include <deque>
+#include <map>
+
+#include "boost/container/flat_map.hpp"
+
 #include "llvm/ADT/STLExtras.h"
 
+#include "revng/ADT/KeyedObjectContainer.h"
 #include "revng/ADT/KeyedObjectTraits.h"
-
-template<HasKeyObjectTraits T, class Compare>
+#include "revng/ADT/STLExtras.h"
+
+/// \brief A set of keyed objects, whose elements can be changed in place
+///
+/// By default elements are stored in a std::map: iterators and references to
+/// the elements stay valid upon insertion. \p Map can be a
+/// boost::container::flat_map (see FlatMutableSet) instead: elements are then
+/// stored contiguously, which is faster to traverse and to search, but
+/// insertions invalidate iterators and references and batch insertions are
+/// only visible once the inserter is committed or destroyed.
+template<HasKeyObjectTraits T, class Compare, class Map>
 class MutableSet {
 private:
   using KOT = KeyedObjectTraits<T>;
@@ -18,7 +34,12 @@ public:
   using key_type = const non_const_key_type;
 
 private:
-  using map_type = std::map<non_const_key_type, T, Compare>;
+  using map_type = Map;
+  static_assert(std::is_same_v<typename map_type::key_type, non_const_key_type>
+                and std::is_same_v<typename map_type::mapped_type, T>);
+
+  static constexpr bool
+    IsFlat = is_specialization_v<map_type, boost::container::flat_map>;
 
 public:
   using size_type = typename map_type::size_type;
@@ -43,7 +64,7 @@ private:
   using mapped_iterator = llvm::mapped_iterator<A, B>;
 
 private:
-  using pair = std::pair<key_type, inner_mapped_type>;
+  using pair = typename map_type::value_type;
   static inner_mapped_type &getSecond(pair &Pair) { return Pair.second; }
 
   static const inner_mapped_type &getConstSecond(const pair &Pair) {
@@ -81,11 +102,11 @@ public:
   const T &at(const key_type &Key) const { return TheMap.at(Key); }
 
   T &operator[](const key_type &Key) {
-    return TheMap.insert({ Key, KOT::fromKey(Key) }).first->second;
+    return TheMap.try_emplace(Key, KOT::fromKey(Key)).first->second;
   }
 
   T &operator[](key_type &&Key) {
-    return TheMap.insert({ Key, KOT::fromKey(Key) }).first->second;
+    return TheMap.try_emplace(Key, KOT::fromKey(Key)).first->second;
   }
 
   iterator begin() { return wrapIterator(TheMap.begin()); }
@@ -111,7 +132,7 @@ public:
   void clear() { TheMap.clear(); }
 
   std::pair<iterator, bool> insert(const T &Value) {
-    auto Result = TheMap.insert({ KOT::key(Value), Value });
+    auto Result = TheMap.try_emplace(KOT::key(Value), Value);
     return { wrapIterator(Result.first), Result.second };
   }
 
@@ -155,32 +176,105 @@ public:
   }
 
 public:
-  class BatchInserter {
+  template<bool KeepFirst>
+  class BatchInserterBase {
   private:
-    MutableSet &MS;
+    MutableSet *MS;
+    /// Elements to merge into a flat MutableSet once the batch is over
+    std::deque<T> Pending;
 
   public:
-    BatchInserter(MutableSet &MS) : MS(MS) {}
-    T &insert(const T &Value) { return *MS.insert(Value).first; }
+    BatchInserterBase(MutableSet &MS) : MS(&MS) {}
+
+    BatchInserterBase(const BatchInserterBase &) = delete;
+    BatchInserterBase &operator=(const BatchInserterBase &) = delete;
+
+    BatchInserterBase(BatchInserterBase &&Other) :
+      MS(Other.MS), Pending(std::move(Other.Pending)) {
+      Other.MS = nullptr;
+    }
+
+    BatchInserterBase &operator=(BatchInserterBase &&Other) {
+      commit();
+      MS = Other.MS;
+      Pending = std::move(Other.Pending);
+      Other.MS = nullptr;
+      return *this;
+    }
+
+    ~BatchInserterBase() { commit(); }
+
+    void commit() {
+      if constexpr (IsFlat) {
+        if (MS != nullptr and not Pending.empty())
+          MS->template merge<KeepFirst>(Pending);
+        Pending.clear();
+      }
+    }
+
+  protected:
+    T &insertImpl(const T &Value) {
+      if constexpr (IsFlat)
+        return Pending.emplace_back(Value);
+      else if constexpr (KeepFirst)
+        return *MS->insert(Value).first;
+      else
+        return *MS->insert_or_assign(Value).first;
+    }
   };
 
-  BatchInserter batch_insert() { return BatchInserter(*this); }
+  class BatchInserter : public BatchInserterBase<true> {
+  public:
+    BatchInserter(MutableSet &MS) : BatchInserterBase<true>(MS) {}
+    T &insert(const T &Value) { return this->insertImpl(Value); }
+  };
 
-  class BatchInsertOrAssigner {
-  private:
-    MutableSet &MS;
+  BatchInserter batch_insert() { return BatchInserter(*this); }
 
+  class BatchInsertOrAssigner : public BatchInserterBase<false> {
   public:
-    BatchInsertOrAssigner(MutableSet &MS) : MS(MS) {}
-    T &insert_or_assign(const T &Value) {
-      return *MS.insert_or_assign(Value).first;
-    }
+    BatchInsertOrAssigner(MutableSet &MS) : BatchInserterBase<false>(MS) {}
+    T &insert_or_assign(const T &Value) { return this->insertImpl(Value); }
   };
 
   BatchInsertOrAssigner batch_insert_or_assign() {
     return BatchInsertOrAssigner(*this);
   }
 
+private:
+  /// \brief Merge \p Pending into a flat map, sorting the elements only once
+  template<bool KeepFirst>
+  void merge(std::deque<T> &Pending) {
+    static_assert(IsFlat);
+
+    auto Sequence = TheMap.extract_sequence();
+    auto OldSize = Sequence.size();
+    for (T &Element : Pending)
+      Sequence.emplace_back(KOT::key(Element), std::move(Element));
+
+    auto CompareKeys = [](const auto &LHS, const auto &RHS) {
+      return Compare()(LHS.first, RHS.first);
+    };
+    auto KeysEqual = [&CompareKeys](const auto &LHS, const auto &RHS) {
+      return not CompareKeys(LHS, RHS) and not CompareKeys(RHS, LHS);
+    };
+
+    // Existing elements come first among elements with the same key
+    auto Middle = Sequence.begin() + OldSize;
+    std::stable_sort(Middle, Sequence.end(), CompareKeys);
+    std::inplace_merge(Sequence.begin(), Middle, Sequence.end(), CompareKeys);
+
+    auto NewEnd = Sequence.end();
+    if (KeepFirst)
+      NewEnd = std::unique(Sequence.begin(), Sequence.end(), KeysEqual);
+    else
+      NewEnd = unique_last(Sequence.begin(), Sequence.end(), KeysEqual);
+    Sequence.erase(NewEnd, Sequence.end());
+
+    TheMap.adopt_sequence(boost::container::ordered_unique_range,
+                          std::move(Sequence));
+  }
+
 private:
   static inner_iterator unwrapIterator(iterator It) { return It.getCurrent(); }
 
@@ -204,3 +298,13 @@ private:
     return const_reverse_iterator(It, getConstSecond);
   }
 };
+
+/// \brief A MutableSet storing its elements contiguously
+template<HasKeyObjectTraits T, class Compare = KOTCompare<T>>
+using FlatMutableSet = MutableSet<T,
+                                  Compare,
+                                  boost::container::flat_map<KOTKey<T>,
+                                                             T,
+                                                             Compare>>;
+
+static_assert(IsKeyedObjectContainer<FlatMutableSet<int>>);
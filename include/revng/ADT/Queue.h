@@ -4,9 +4,12 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
 #include <queue>
 #include <set>
 
+#include "llvm/ADT/BitVector.h"
+
 #include "revng/Support/Assert.h"
 
 /// \brief Queue where an element cannot be re-inserted if it's already in the
@@ -55,3 +58,66 @@ using UniquedQueue = QueueImpl<T, false>;
 
 template<typename T>
 using OnceQueue = QueueImpl<T, true>;
+
+/// \brief QueueImpl for elements that can be mapped to small integers
+///
+/// \p IndexOf maps each element to a distinct index, e.g., its position in
+///    reverse post order. Membership is tracked through a bit vector indexed by
+///    it, instead of a std::set, so insert and pop take constant time and do
+///    not allocate, once the bit vector has grown enough. The bit vector grows
+///    on demand, but its size can be set upfront through the constructor.
+template<typename T, typename IndexOf, bool Once>
+class DenseQueueImpl {
+public:
+  explicit DenseQueueImpl(IndexOf Index = IndexOf(), size_t Capacity = 0) :
+    Index(Index), Enqueued(Capacity) {}
+
+public:
+  void insert(T Element) {
+    size_t I = Index(Element);
+    if (I >= Enqueued.size())
+      Enqueued.resize(std::max<size_t>(I + 1, 2 * Enqueued.size()));
+
+    if (not Enqueued.test(I)) {
+      Enqueued.set(I);
+      Queue.push(Element);
+    }
+  }
+
+  bool empty() const { return Queue.empty(); }
+
+  T head() const { return Queue.front(); }
+
+  T pop() {
+    T Result = head();
+    Queue.pop();
+    if (!Once)
+      Enqueued.reset(Index(Result));
+    return Result;
+  }
+
+  size_t size() const { return Queue.size(); }
+
+  /// \return true if \p Element is in the queue or, for OnceQueues, if it has
+  ///         ever been inserted
+  bool contains(T Element) const {
+    size_t I = Index(Element);
+    return I < Enqueued.size() and Enqueued.test(I);
+  }
+
+  void clear() {
+    Enqueued.reset();
+    std::queue<T>().swap(Queue);
+  }
+
+private:
+  IndexOf Index;
+  llvm::BitVector Enqueued;
+  std::queue<T> Queue;
+};
+
+template<typename T, typename IndexOf>
+using DenseUniquedQueue = DenseQueueImpl<T, IndexOf, false>;
+
+template<typename T, typename IndexOf>
+using DenseOnceQueue = DenseQueueImpl<T, IndexOf, true>;
@@ -4,10 +4,15 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <cstddef>
 #include <experimental/coroutine>
+#include <limits>
+#include <memory>
+#include <new>
 #include <optional>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "revng/Support/Assert.h"
 
@@ -16,6 +21,122 @@ struct RecursiveCoroutine;
 
 namespace detail {
 
+/// \brief Per-thread, stack-like allocator for coroutine frames
+///
+/// The frame of a recursive sub-call is allocated after the frame of its
+/// caller and is destroyed before it, so frames can be bump-allocated from a
+/// stack of slabs and released by moving back the top. Frames released out of
+/// order are only marked as such, and are reclaimed once everything above them
+/// has been released too.
+///
+/// Slabs are never returned to the system, they're kept around for reuse.
+/// Frames larger than a slab are allocated on the heap.
+///
+/// \note A frame must be destroyed by the thread that created it.
+class CoroutineFramePool {
+private:
+  static constexpr size_t SlabSize = 256 * 1024;
+  static constexpr size_t Alignment = alignof(std::max_align_t);
+  static constexpr size_t None = std::numeric_limits<size_t>::max();
+
+  struct alignas(Alignment) Header {
+    CoroutineFramePool *Owner;
+    /// Offset of the previous frame in the same slab, or None
+    size_t Previous;
+    bool OnHeap;
+    bool Released;
+  };
+
+  struct Slab {
+    std::unique_ptr<std::byte[]> Memory;
+    /// First free byte
+    size_t Top = 0;
+    /// Offset of the last frame, or None
+    size_t Last = None;
+
+    Header &at(size_t Offset) {
+      return *reinterpret_cast<Header *>(Memory.get() + Offset);
+    }
+  };
+
+private:
+  std::vector<Slab> Slabs;
+  size_t Current = 0;
+
+public:
+  static CoroutineFramePool &get() {
+    thread_local CoroutineFramePool Pool;
+    return Pool;
+  }
+
+  void *allocate(size_t Size) noexcept {
+    size_t Total = sizeof(Header) + alignTo(Size);
+
+    if (Total > SlabSize) {
+      auto *Result = static_cast<Header *>(::operator new(Total,
+                                                          std::nothrow));
+      if (Result == nullptr)
+        return nullptr;
+      *Result = Header{ this, None, true, false };
+      return Result + 1;
+    }
+
+    if (Slabs.empty()) {
+      Slabs.push_back(makeSlab());
+    } else if (Slabs[Current].Top + Total > SlabSize) {
+      Current++;
+      if (Current == Slabs.size())
+        Slabs.push_back(makeSlab());
+      revng_assert(Slabs[Current].Top == 0);
+    }
+
+    Slab &Target = Slabs[Current];
+    size_t Offset = Target.Top;
+    Header &Result = Target.at(Offset);
+    Result = Header{ this, Target.Last, false, false };
+    Target.Last = Offset;
+    Target.Top += Total;
+    return &Result + 1;
+  }
+
+  void deallocate(void *Pointer) noexcept {
+    Header *Frame = static_cast<Header *>(Pointer) - 1;
+    revng_assert(Frame->Owner == this);
+
+    if (Frame->OnHeap) {
+      ::operator delete(Frame);
+      return;
+    }
+
+    revng_assert(not Frame->Released);
+    Frame->Released = true;
+
+    // Pop all the released frames from the top of the stack
+    while (true) {
+      Slab &Top = Slabs[Current];
+
+      while (Top.Last != None and Top.at(Top.Last).Released) {
+        Top.Top = Top.Last;
+        Top.Last = Top.at(Top.Last).Previous;
+      }
+
+      if (Top.Last != None or Current == 0)
+        break;
+
+      Current--;
+    }
+  }
+
+private:
+  static size_t alignTo(size_t Size) {
+    return (Size + Alignment - 1) / Alignment * Alignment;
+  }
+
+  static Slab makeSlab() {
+    return Slab{ std::make_unique<std::byte[]>(SlabSize) };
+  }
+};
+
 template<typename RetT>
 struct ReturnBase {
 
@@ -54,6 +175,16 @@ struct RecursivePromise : public ReturnBase<ReturnT> {
     return RecursiveCoroutine<ReturnT>(coro_handle::from_promise(*this));
   }
 
+  // Coroutine frames are allocated from a per-thread stack-like pool, so a
+  // recursive call doesn't cost a heap allocation
+  static void *operator new(size_t Size) noexcept {
+    return CoroutineFramePool::get().allocate(Size);
+  }
+
+  static void operator delete(void *Pointer) noexcept {
+    CoroutineFramePool::get().deallocate(Pointer);
+  }
+
   [[noreturn]] static RecursiveCoroutine<ReturnT>
   get_return_object_on_allocation_failure() {
     std::terminate();
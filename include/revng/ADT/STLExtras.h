@@ -104,3 +104,26 @@ auto map_range(ContainerTy &&C, FuncTy F) {
   return llvm::make_range(map_iterator(C.begin(), F), map_iterator(C.end(), F));
 }
 } // namespace revng
+
+//
+// unique_last
+//
+
+/// \brief Like std::unique, but keeps the last element of each group
+template<class ForwardIt, class BinaryPredicate>
+ForwardIt
+unique_last(ForwardIt First, ForwardIt Last, BinaryPredicate Predicate) {
+  if (First == Last)
+    return Last;
+
+  ForwardIt Result = First;
+  while (++First != Last) {
+    if (not Predicate(*Result, *First) and ++Result != First) {
+      *Result = std::move(*First);
+    } else {
+      *Result = std::move(*First);
+    }
+  }
+
+  return ++Result;
+}
@@ -4,7 +4,13 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <cstring>
+#include <type_traits>
+
 #include "llvm/ADT/GraphTraits.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
 
 #include "revng/ADT/GenericGraph.h"
 #include "revng/ADT/KeyedObjectTraits.h"
@@ -171,6 +177,296 @@ toSerializable(const G &Graph) {
   return Result;
 }
 
+//
+// Binary serialization
+//
+
+namespace detail {
+
+struct BinaryGraphHeader {
+  static constexpr char ExpectedMagic[8] = { 'r', 'e', 'v', 'n',
+                                             'g', 'C', 'S', 'R' };
+  static constexpr uint32_t CurrentVersion = 1;
+  static constexpr uint32_t HostByteOrder = 0x01020304;
+
+  char Magic[8];
+  uint32_t Version;
+  uint32_t ByteOrder;
+  uint32_t KeySize;
+  uint32_t LabelSize;
+  uint64_t NodeCount;
+  uint64_t EdgeCount;
+};
+
+inline constexpr uint64_t alignToWord(uint64_t Size) {
+  return (Size + 7) & ~uint64_t(7);
+}
+
+} // namespace detail
+
+/// \brief A SerializableGraph in a compact binary form, fit for memory mapping
+///
+/// The nodes are identified by their index in the sorted list of the keys,
+/// the edges are stored in compressed sparse row form:
+///
+///     BinaryGraphHeader Header;
+///     NodeKey EntryNode;
+///     NodeKey Keys[NodeCount];
+///     uint64_t Offsets[NodeCount + 1]; // Index of the first edge of a node
+///     uint64_t Targets[EdgeCount];     // Index of the successor
+///     EdgeLabel Labels[EdgeCount];     // Omitted if EdgeLabel is empty
+///
+/// Each field starts on an 8 bytes boundary, values are in host byte order.
+/// As in toSerializable, only the key of the nodes is preserved, nodes are
+/// rebuilt through KeyedObjectTraits::fromKey.
+///
+/// A BinaryGraph is a view on the buffer (e.g., a memory mapped file) it has
+/// been created from, which must outlive it.
+template<typename NodeType, typename EdgeLabel>
+class BinaryGraph {
+private:
+  using KOC = KeyedObjectTraits<NodeType>;
+  using Header = detail::BinaryGraphHeader;
+
+public:
+  using NodeKey = decltype(KOC::key(std::declval<NodeType>()));
+  using Serializable = SerializableGraph<NodeType, EdgeLabel>;
+
+  static_assert(std::is_trivially_copyable_v<NodeKey>
+                  and std::is_trivially_copyable_v<EdgeLabel>,
+                "Binary serialization requires trivially copyable keys and "
+                "labels");
+
+private:
+  static constexpr bool HasLabels = not std::is_empty_v<EdgeLabel>;
+  static constexpr uint64_t KeySize = detail::alignToWord(sizeof(NodeKey));
+  static constexpr uint64_t
+    LabelSize = HasLabels ? detail::alignToWord(sizeof(EdgeLabel)) : 0;
+
+private:
+  const char *Data = nullptr;
+  uint64_t NodeCount = 0;
+  uint64_t EdgeCount = 0;
+
+private:
+  BinaryGraph() = default;
+
+public:
+  /// \brief Write \p Graph to \p Output in binary form
+  static void write(const Serializable &Graph, llvm::raw_ostream &Output) {
+    Header TheHeader;
+    std::memcpy(TheHeader.Magic, Header::ExpectedMagic, sizeof(Header::Magic));
+    TheHeader.Version = Header::CurrentVersion;
+    TheHeader.ByteOrder = Header::HostByteOrder;
+    TheHeader.KeySize = KeySize;
+    TheHeader.LabelSize = LabelSize;
+    TheHeader.NodeCount = Graph.Nodes.size();
+    TheHeader.EdgeCount = 0;
+    for (const auto &Node : Graph.Nodes)
+      TheHeader.EdgeCount += Node.Successors.size();
+
+    writePadded(Output, TheHeader);
+    writePadded(Output, Graph.EntryNode);
+
+    for (const auto &Node : Graph.Nodes)
+      writePadded(Output, KOC::key(Node.Node));
+
+    uint64_t Offset = 0;
+    for (const auto &Node : Graph.Nodes) {
+      writePadded(Output, Offset);
+      Offset += Node.Successors.size();
+    }
+    writePadded(Output, Offset);
+
+    // Nodes are sorted by key, their index can be found through a lookup
+    for (const auto &Node : Graph.Nodes) {
+      for (const auto &Edge : Node.Successors) {
+        auto It = Graph.Nodes.find(Edge.Neighbor);
+        revng_assert(It != Graph.Nodes.end());
+        writePadded(Output, uint64_t(It - Graph.Nodes.begin()));
+      }
+    }
+
+    if constexpr (HasLabels)
+      for (const auto &Node : Graph.Nodes)
+        for (const auto &Edge : Node.Successors)
+          writePadded(Output, Edge.Label);
+  }
+
+  /// \return a view on \p Buffer or, if \p Buffer does not contain a graph of
+  ///         this type, an empty Optional
+  static llvm::Optional<BinaryGraph> fromBuffer(llvm::StringRef Buffer) {
+    if (Buffer.size() < sizeof(Header))
+      return llvm::None;
+
+    Header TheHeader;
+    std::memcpy(&TheHeader, Buffer.data(), sizeof(Header));
+    if (not isCompatible(TheHeader))
+      return llvm::None;
+
+    // Check the size, taking care of overflows
+    uint64_t Available = Buffer.size() - sizeof(Header);
+    uint64_t MaxCount = Available / 8;
+    if (TheHeader.NodeCount >= MaxCount or TheHeader.EdgeCount >= MaxCount)
+      return llvm::None;
+
+    BinaryGraph Result;
+    Result.Data = Buffer.data();
+    Result.NodeCount = TheHeader.NodeCount;
+    Result.EdgeCount = TheHeader.EdgeCount;
+    if (Result.size() > Buffer.size())
+      return llvm::None;
+
+    // Validate the edges, so that accessing the graph is always safe
+    if (Result.offset(0) != 0
+        or Result.offset(Result.NodeCount) != Result.EdgeCount)
+      return llvm::None;
+
+    for (uint64_t Node = 0; Node < Result.NodeCount; ++Node)
+      if (Result.offset(Node) > Result.offset(Node + 1))
+        return llvm::None;
+
+    for (uint64_t Edge = 0; Edge < Result.EdgeCount; ++Edge)
+      if (Result.target(Edge) >= Result.NodeCount)
+        return llvm::None;
+
+    return Result;
+  }
+
+public:
+  uint64_t nodeCount() const { return NodeCount; }
+  uint64_t edgeCount() const { return EdgeCount; }
+
+  NodeKey entryNode() const { return read<NodeKey>(entryNodeStart()); }
+
+  NodeKey key(uint64_t Node) const {
+    revng_assert(Node < NodeCount);
+    return read<NodeKey>(keysStart() + Node * KeySize);
+  }
+
+  /// \return the index of the node with key \p Key, if any
+  llvm::Optional<uint64_t> indexOf(const NodeKey &Key) const {
+    uint64_t Begin = 0;
+    uint64_t End = NodeCount;
+    while (Begin < End) {
+      uint64_t Middle = Begin + (End - Begin) / 2;
+      if (key(Middle) < Key)
+        Begin = Middle + 1;
+      else
+        End = Middle;
+    }
+
+    if (Begin < NodeCount and key(Begin) == Key)
+      return Begin;
+    return llvm::None;
+  }
+
+  /// \return the index of the first and one past the last edge of \p Node
+  std::pair<uint64_t, uint64_t> edges(uint64_t Node) const {
+    revng_assert(Node < NodeCount);
+    return { offset(Node), offset(Node + 1) };
+  }
+
+  /// \return the index of the node \p Edge leads to
+  uint64_t target(uint64_t Edge) const {
+    revng_assert(Edge < EdgeCount);
+    return read<uint64_t>(targetsStart() + Edge * 8);
+  }
+
+  EdgeLabel label(uint64_t Edge) const {
+    revng_assert(Edge < EdgeCount);
+    if constexpr (HasLabels)
+      return read<EdgeLabel>(labelsStart() + Edge * LabelSize);
+    else
+      return EdgeLabel{};
+  }
+
+public:
+  template<typename GenericGraphNodeType>
+  GenericGraph<GenericGraphNodeType> toGenericGraph() const {
+    GenericGraph<GenericGraphNodeType> Ret;
+
+    std::vector<GenericGraphNodeType *> Nodes;
+    Nodes.reserve(NodeCount);
+    for (uint64_t Node = 0; Node < NodeCount; ++Node)
+      Nodes.push_back(Ret.addNode(KOC::fromKey(key(Node))));
+
+    for (uint64_t Node = 0; Node < NodeCount; ++Node) {
+      auto [Begin, End] = edges(Node);
+      for (uint64_t Edge = Begin; Edge < End; ++Edge)
+        Nodes[Node]->addSuccessor(Nodes[target(Edge)], label(Edge));
+    }
+
+    if constexpr (GenericGraph<GenericGraphNodeType>::hasEntryNode) {
+      if (auto Entry = indexOf(entryNode()))
+        Ret.setEntryNode(Nodes[*Entry]);
+    }
+
+    return Ret;
+  }
+
+  Serializable toSerializable() const {
+    Serializable Result;
+
+    {
+      auto Inserter = Result.Nodes.batch_insert();
+      for (uint64_t Node = 0; Node < NodeCount; ++Node) {
+        SerializableNode<NodeType, EdgeLabel> NewNode{ KOC::fromKey(key(Node)),
+                                                       {} };
+        auto [Begin, End] = edges(Node);
+        auto SuccessorsInserter = NewNode.Successors.batch_insert();
+        for (uint64_t Edge = Begin; Edge < End; ++Edge)
+          SuccessorsInserter.insert({ key(target(Edge)), label(Edge) });
+        SuccessorsInserter.commit();
+        Inserter.insert(std::move(NewNode));
+      }
+    }
+
+    Result.EntryNode = entryNode();
+    return Result;
+  }
+
+private:
+  static bool isCompatible(const Header &TheHeader) {
+    auto Magic = llvm::StringRef(TheHeader.Magic, sizeof(Header::Magic));
+    auto ExpectedMagic = llvm::StringRef(Header::ExpectedMagic,
+                                         sizeof(Header::ExpectedMagic));
+    return Magic == ExpectedMagic
+           and TheHeader.Version == Header::CurrentVersion
+           and TheHeader.ByteOrder == Header::HostByteOrder
+           and TheHeader.KeySize == KeySize
+           and TheHeader.LabelSize == LabelSize;
+  }
+
+  template<typename T>
+  static void writePadded(llvm::raw_ostream &Output, const T &Value) {
+    Output.write(reinterpret_cast<const char *>(&Value), sizeof(T));
+    Output.write_zeros(detail::alignToWord(sizeof(T)) - sizeof(T));
+  }
+
+  template<typename T>
+  T read(uint64_t Position) const {
+    T Result;
+    std::memcpy(&Result, Data + Position, sizeof(T));
+    return Result;
+  }
+
+  uint64_t offset(uint64_t Node) const {
+    return read<uint64_t>(offsetsStart() + Node * 8);
+  }
+
+  static uint64_t entryNodeStart() {
+    return detail::alignToWord(sizeof(Header));
+  }
+  static uint64_t keysStart() { return entryNodeStart() + KeySize; }
+  uint64_t offsetsStart() const { return keysStart() + NodeCount * KeySize; }
+  uint64_t targetsStart() const {
+    return offsetsStart() + (NodeCount + 1) * 8;
+  }
+  uint64_t labelsStart() const { return targetsStart() + EdgeCount * 8; }
+  uint64_t size() const { return labelsStart() + EdgeCount * LabelSize; }
+};
+
 //
 // Make `struct Empty` serialiazible
 //
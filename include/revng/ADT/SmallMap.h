@@ -4,8 +4,10 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
 #include <array>
 #include <map>
+#include <type_traits>
 
 #include "boost/variant.hpp"
 
@@ -35,14 +37,19 @@ private:
   using it = std::iterator_traits<T>;
   using itfirst = it<typename first<Ts...>::type>;
 
+  // Some iterators (e.g., llvm::DenseMap's const_iterator) have a const
+  // value_type
+  template<typename T>
+  using value_of = std::remove_cv_t<typename it<T>::value_type>;
+
   // Assert correct usage
-  static_assert(are_same<typename it<Ts>::value_type...>::value,
+  static_assert(are_same<value_of<Ts>...>::value,
                 "The iterators have different value_type");
   static_assert(are_same<typename it<Ts>::reference...>::value,
                 "The iterators have different reference");
 
 public:
-  using value_type = typename itfirst::value_type;
+  using value_type = value_of<typename first<Ts...>::type>;
   using reference = typename itfirst::reference;
   using pointer = typename itfirst::pointer;
   using difference_type = typename itfirst::difference_type;
@@ -155,25 +162,56 @@ private:
   boost::variant<Ts...> Iterator;
 };
 
+/// \brief Number of elements of a SmallMap<K, V> fitting in \p Lines cache
+///        lines
+///
+/// Use it as the N parameter of SmallMap to keep the inline storage within a
+/// given number of cache lines.
+template<typename K, typename V>
+constexpr unsigned smallMapInlineSize(unsigned Lines = 1) {
+  constexpr size_t CacheLineSize = 64;
+  return std::max<size_t>(1, Lines * CacheLineSize / sizeof(std::pair<K, V>));
+}
+
 /// \brief map that usually contains less than N elements
 ///
 /// SmallMap keeps a std::array of pairs inline which are search linearly if
 /// size() < N.
 ///
+/// For integer, enumeration and pointer keys, a copy of the keys is also kept
+/// in a separate inline array, which is searched with a loop the compiler can
+/// vectorize.
+///
 /// \note Since this data structure internally uses an std::array, expect the
 ///       default constructor to be used.
 ///
 /// \tparam N number of elements to keep inline.
-template<typename K, typename V, unsigned N, typename C = std::less<K>>
+/// \tparam M the map used once more than N elements are stored. Its
+///         value_type must have the same layout of std::pair<K, V>. Using
+///         llvm::DenseMap gives faster lookups, but the iteration order is no
+///         longer sorted once spilled, lower_bound is not available and
+///         inserting invalidates the iterators.
+template<typename K,
+         typename V,
+         unsigned N,
+         typename C = std::less<K>,
+         typename M = std::map<K, V, C>>
 class SmallMap {
 private:
   // Define some helper types
   using NonConstPair = std::pair<K, V>;
   using NonConstContainer = std::array<NonConstPair, N>;
 
-  using Pair = std::pair<const K, V>;
+  using Pair = typename M::value_type;
   using Container = std::array<Pair, N>;
 
+  static_assert(sizeof(Pair) == sizeof(NonConstPair));
+
+  static constexpr bool HasKeyArray = std::is_integral_v<K>
+                                      or std::is_enum_v<K>
+                                      or std::is_pointer_v<K>;
+  using KeyArray = std::array<K, HasKeyArray ? N : 0>;
+
   using VIterator = typename Container::iterator;
   using ConstVIterator = typename Container::const_iterator;
 
@@ -183,11 +221,12 @@ private:
   // the pair with the const key only to provide iterators compatible with
   // std::map.
   mutable NonConstContainer Vector; ///< Container for inline elements
+  mutable KeyArray Keys = {}; ///< Keys of Vector, if HasKeyArray
   mutable bool IsSorted; ///< Is vector sorted?
   unsigned Size; ///< Size of Vector
 
   // Non-inline version of the container
-  std::map<K, V, C> Map;
+  M Map;
 
 private:
   VIterator smallBegin() { return reinterpret_cast<VIterator>(Vector.begin()); }
@@ -205,9 +244,8 @@ public:
   SmallMap &operator=(SmallMap &&Other) = default;
 
 public:
-  using iterator = Iteratall<VIterator, typename std::map<K, V, C>::iterator>;
-  using const_iterator = Iteratall<ConstVIterator,
-                                   typename std::map<K, V, C>::const_iterator>;
+  using iterator = Iteratall<VIterator, typename M::iterator>;
+  using const_iterator = Iteratall<ConstVIterator, typename M::const_iterator>;
   using size_type = size_t;
   using value_type = Pair;
   using pointer = Pair *;
@@ -223,10 +261,15 @@ public:
     if (IsSorted || !isSmall() || Size <= 1)
       return;
 
-    auto Compare = [](const Pair &A, const Pair &B) {
+    auto Compare = [](const NonConstPair &A, const NonConstPair &B) {
       return C()(A.first, B.first);
     };
     std::sort(Vector.begin(), Vector.begin() + Size, Compare);
+
+    if constexpr (HasKeyArray)
+      for (unsigned I = 0; I < Size; I++)
+        Keys[I] = Vector[I].first;
+
     IsSorted = true;
   }
 
@@ -264,7 +307,7 @@ public:
 
   size_type count(const K &Key) const {
     if (isSmall()) {
-      return vfind(Key) == smallBegin() + Size ? 0 : 1;
+      return vindex(Key) == Size ? 0 : 1;
     } else {
       return Map.count(Key);
     }
@@ -283,6 +326,8 @@ public:
 
     if (Size < N) {
       Vector[Size] = P;
+      if constexpr (HasKeyArray)
+        Keys[Size] = P.first;
       Size++;
 
       // Check if we're preserving the ordering
@@ -303,19 +348,16 @@ public:
 
   void erase(const K &Key) {
     if (isSmall()) {
-      auto I = Vector.begin();
-      auto E = Vector.begin() + Size;
-
-      for (; I != E; ++I)
-        if (I->first == Key)
-          break;
-
-      if (I == E)
+      unsigned I = vindex(Key);
+      if (I == Size)
         return;
 
       Size--;
-      for (; I < E - 1; I++)
-        *I = *(I + 1);
+      for (; I < Size; I++) {
+        Vector[I] = Vector[I + 1];
+        if constexpr (HasKeyArray)
+          Keys[I] = Keys[I + 1];
+      }
 
     } else {
       auto It = Map.find(Key);
@@ -361,11 +403,11 @@ public:
   }
 
   V &operator[](K &&Key) {
-    return insert(std::make_pair(std::move(Key), V())).first->second;
+    return insert(Pair(std::move(Key), V())).first->second;
   }
 
   V &operator[](const K &Key) {
-    return insert(std::make_pair(Key, V())).first->second;
+    return insert(Pair(Key, V())).first->second;
   }
 
   V &at(const K &Key) {
@@ -383,19 +425,26 @@ public:
 private:
   bool isSmall() const { return Map.empty(); }
 
-  ConstVIterator vfind(const K &Key) const {
-    for (ConstVIterator I = smallBegin(), E = smallBegin() + Size; I != E; ++I)
-      if (I->first == Key)
-        return I;
-    return smallBegin() + Size;
+  /// \return the index of \p Key in Vector, or Size if it's not there
+  unsigned vindex(const K &Key) const {
+    if constexpr (HasKeyArray) {
+      // Keys are unique, so we can go through all of them without an early
+      // exit: this lets the compiler vectorize the comparisons
+      unsigned Result = Size;
+      for (unsigned I = 0; I < Size; I++)
+        Result = Keys[I] == Key ? I : Result;
+      return Result;
+    } else {
+      for (unsigned I = 0; I < Size; I++)
+        if (Vector[I].first == Key)
+          return I;
+      return Size;
+    }
   }
 
-  VIterator vfind(const K &Key) {
-    for (VIterator I = smallBegin(), E = smallBegin() + Size; I != E; ++I)
-      if (I->first == Key)
-        return I;
-    return smallBegin() + Size;
-  }
+  ConstVIterator vfind(const K &Key) const { return smallBegin() + vindex(Key); }
+
+  VIterator vfind(const K &Key) { return smallBegin() + vindex(Key); }
 
   ConstVIterator vlower_bound(const K &Key) const {
     sort();
@@ -4,31 +4,151 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/STLExtras.h"
 
 #include "revng/ADT/KeyedObjectContainer.h"
 #include "revng/ADT/KeyedObjectTraits.h"
+#include "revng/ADT/STLExtras.h"
 #include "revng/Support/Assert.h"
 
-template<class ForwardIt, class BinaryPredicate>
-ForwardIt
-unique_last(ForwardIt First, ForwardIt Last, BinaryPredicate Predicate) {
-  if (First == Last)
-    return Last;
+/// \brief Stable sort [\p First, \p Last) on up to \p Threads threads
+///
+/// The range is split in chunks which are sorted independently, then adjacent
+/// chunks are merged pairwise, in parallel too. Small ranges are sorted on the
+/// current thread.
+template<class RandomIt, class Compare>
+void parallel_stable_sort(RandomIt First,
+                          RandomIt Last,
+                          Compare Comparator,
+                          unsigned Threads) {
+  constexpr size_t MinimumChunkSize = 4096;
+
+  size_t Size = Last - First;
+  size_t Chunks = std::min<size_t>(Threads, Size / MinimumChunkSize);
+  if (Chunks <= 1) {
+    std::stable_sort(First, Last, Comparator);
+    return;
+  }
+
+  std::vector<RandomIt> Bounds;
+  for (size_t I = 0; I < Chunks; ++I)
+    Bounds.push_back(First + (Size * I) / Chunks);
+  Bounds.push_back(Last);
+
+  {
+    std::vector<std::thread> Workers;
+    for (size_t I = 0; I < Chunks; ++I)
+      Workers.emplace_back([&Bounds, &Comparator, I] {
+        std::stable_sort(Bounds[I], Bounds[I + 1], Comparator);
+      });
+
+    for (std::thread &Worker : Workers)
+      Worker.join();
+  }
+
+  // Merge adjacent pairs of sorted chunks until a single one is left
+  while (Bounds.size() > 2) {
+    std::vector<RandomIt> NewBounds;
+    std::vector<std::thread> Workers;
+    size_t I = 0;
+    for (; I + 2 < Bounds.size(); I += 2) {
+      NewBounds.push_back(Bounds[I]);
+      Workers.emplace_back([&Bounds, &Comparator, I] {
+        std::inplace_merge(Bounds[I], Bounds[I + 1], Bounds[I + 2], Comparator);
+      });
+    }
 
-  ForwardIt Result = First;
-  while (++First != Last) {
-    if (not Predicate(*Result, *First) and ++Result != First) {
-      *Result = std::move(*First);
-    } else {
-      *Result = std::move(*First);
+    // An odd chunk out is left as is
+    for (; I + 1 < Bounds.size(); ++I)
+      NewBounds.push_back(Bounds[I]);
+    NewBounds.push_back(Last);
+
+    for (std::thread &Worker : Workers)
+      Worker.join();
+
+    Bounds = std::move(NewBounds);
+  }
+}
+
+namespace detail {
+
+/// \brief Placeholder for the index of SortedVectors without a KeyHash
+struct NoKeyIndex {
+  bool operator==(const NoKeyIndex &) const = default;
+};
+
+/// \brief Hash table from the keys of a SortedVector to their position
+///
+/// The table is built on the first lookup and dropped by any change moving
+/// the elements around. Concurrent lookups are safe, as long as nobody is
+/// changing the SortedVector, as for the other const methods.
+template<typename KeyT, typename KeyHash>
+class KeyIndex {
+private:
+  mutable std::unordered_map<KeyT, size_t, KeyHash> Positions;
+  mutable std::atomic<bool> Valid = false;
+  mutable std::mutex BuildLock;
+
+public:
+  KeyIndex() = default;
+
+  // Copies rebuild their own index, on demand
+  KeyIndex(const KeyIndex &) {}
+  KeyIndex &operator=(const KeyIndex &) {
+    invalidate();
+    return *this;
+  }
+
+  // The index is not part of the value of the SortedVector
+  bool operator==(const KeyIndex &) const { return true; }
+
+public:
+  void invalidate() {
+    if (Valid.exchange(false, std::memory_order_relaxed))
+      Positions.clear();
+  }
+
+  template<typename VectorT, typename GetKeyT>
+  std::optional<size_t>
+  find(const KeyT &Key, const VectorT &Elements, GetKeyT GetKey) const {
+    if (not Valid.load(std::memory_order_acquire)) {
+      std::lock_guard<std::mutex> Guard(BuildLock);
+      if (not Valid.load(std::memory_order_relaxed)) {
+        Positions.clear();
+        Positions.reserve(Elements.size());
+        for (size_t I = 0; I < Elements.size(); ++I)
+          Positions.emplace(GetKey(Elements[I]), I);
+        Valid.store(true, std::memory_order_release);
+      }
     }
+
+    auto It = Positions.find(Key);
+    if (It == Positions.end())
+      return std::nullopt;
+    return It->second;
   }
+};
 
-  return ++Result;
-}
+} // namespace detail
 
-template<HasKeyObjectTraits T, class Compare>
+/// \brief A vector of keyed objects, sorted by key
+///
+/// If \p KeyHash is not void, `find`, `at` and `count` are served by a hash
+/// table from keys to positions, see detail::KeyIndex. The elements are still
+/// stored, iterated and serialized in order. This pays off for large
+/// containers which are mostly looked up, as it's rebuilt from scratch after
+/// each insertion or removal.
+template<HasKeyObjectTraits T, class Compare, class KeyHash>
 class SortedVector {
 public:
   using KOT = KeyedObjectTraits<T>;
@@ -36,6 +156,11 @@ public:
 
 private:
   using vector_type = std::vector<T>;
+  static constexpr bool HasIndex = not std::is_void_v<KeyHash>;
+  using index_type = std::conditional_t<
+    HasIndex,
+    detail::KeyIndex<std::remove_const_t<key_type>, KeyHash>,
+    detail::NoKeyIndex>;
 
 public:
   using size_type = typename vector_type::size_type;
@@ -56,6 +181,7 @@ public:
 private:
   vector_type TheVector;
   bool BatchInsertInProgress = false;
+  [[no_unique_address]] index_type Index;
 
 public:
   SortedVector() {}
@@ -71,6 +197,8 @@ public:
   void swap(SortedVector &Other) {
     revng_assert(not BatchInsertInProgress);
     TheVector.swap(Other.TheVector);
+    invalidateIndex();
+    Other.invalidateIndex();
   }
 
   bool operator==(const SortedVector &) const = default;
@@ -178,6 +306,7 @@ public:
   void clear() {
     revng_assert(not BatchInsertInProgress);
     TheVector.clear();
+    invalidateIndex();
   }
 
   void reserve(size_type NewSize) {
@@ -196,10 +325,12 @@ public:
     auto It = lower_bound(Key);
     if (It == end()) {
       TheVector.push_back(Value);
+      invalidateIndex();
       return { --end(), true };
     } else if (keysEqual(KeyedObjectTraits<T>::key(*It), Key)) {
       return { It, false };
     } else {
+      invalidateIndex();
       return { TheVector.insert(It, Value), true };
     }
   }
@@ -210,22 +341,98 @@ public:
     auto It = lower_bound(Key);
     if (It == end()) {
       TheVector.push_back(Value);
+      invalidateIndex();
       return { --end(), true };
     } else if (keysEqual(KeyedObjectTraits<T>::key(*It), Key)) {
       *It = Value;
       return { It, false };
     } else {
+      invalidateIndex();
       return { TheVector.insert(It, Value), true };
     }
   }
 
+  /// \brief Insert or assign all of \p Elements, sorted by key, at once
+  ///
+  /// Each key is looked up once, then the new elements are merged in, without
+  /// sorting the whole vector again. Keys in \p Elements must be unique.
+  void insert_or_assign_sorted(std::vector<T> &&Elements) {
+    revng_assert(not BatchInsertInProgress);
+    auto NotIncreasing = [](const T &LHS, const T &RHS) {
+      return not compareElements(LHS, RHS);
+    };
+    revng_assert(std::adjacent_find(Elements.begin(),
+                                    Elements.end(),
+                                    NotIncreasing)
+                 == Elements.end());
+
+    // Keys are sorted: each lookup can start from the previous one
+    size_type OldSize = TheVector.size();
+    size_type Position = 0;
+    TheVector.reserve(OldSize + Elements.size());
+    for (T &Element : Elements) {
+      auto Key = KOT::key(Element);
+      auto OldEnd = TheVector.begin() + OldSize;
+      auto It = std::lower_bound(TheVector.begin() + Position,
+                                 OldEnd,
+                                 Key,
+                                 compareElementAndKey);
+      Position = It - TheVector.begin();
+
+      if (It != OldEnd and keysEqual(KOT::key(*It), Key))
+        *It = std::move(Element);
+      else
+        TheVector.push_back(std::move(Element));
+    }
+
+    auto OldEnd = TheVector.begin() + OldSize;
+    std::inplace_merge(TheVector.begin(),
+                       OldEnd,
+                       TheVector.end(),
+                       compareElements);
+    invalidateIndex();
+  }
+
+  /// \brief Erase the elements with a key in \p Keys, which must be sorted
+  ///
+  /// The vector is compacted in a single pass.
+  size_type erase_sorted(llvm::ArrayRef<std::remove_const_t<key_type>> Keys) {
+    revng_assert(not BatchInsertInProgress);
+    revng_assert(std::is_sorted(Keys.begin(), Keys.end(), compareKeys));
+
+    if (Keys.empty())
+      return 0;
+
+    auto NextKey = Keys.begin();
+    auto Out = lower_bound(Keys.front());
+    for (auto It = Out; It != TheVector.end(); ++It) {
+      auto Key = KOT::key(*It);
+      while (NextKey != Keys.end() and compareKeys(*NextKey, Key))
+        ++NextKey;
+
+      if (NextKey != Keys.end() and keysEqual(*NextKey, Key))
+        continue;
+
+      if (Out != It)
+        *Out = std::move(*It);
+      ++Out;
+    }
+
+    size_type Erased = TheVector.end() - Out;
+    TheVector.erase(Out, TheVector.end());
+    invalidateIndex();
+    return Erased;
+  }
+
   iterator erase(iterator Pos) {
     revng_assert(not BatchInsertInProgress);
+    invalidateIndex();
     return TheVector.erase(Pos);
   }
 
   iterator erase(const_iterator First, const_iterator Last) {
     revng_assert(not BatchInsertInProgress);
+    invalidateIndex();
     return TheVector.erase(First, Last);
   }
 
@@ -247,6 +454,11 @@ public:
 
   iterator find(const key_type &Key) {
     revng_assert(not BatchInsertInProgress);
+    if constexpr (HasIndex) {
+      auto Position = Index.find(Key, TheVector, keyOf);
+      return Position ? begin() + *Position : end();
+    }
+
     auto It = lower_bound(Key);
     auto End = end();
     if (!(It == End) and Compare()(Key, KeyedObjectTraits<T>::key(*It))) {
@@ -258,6 +470,11 @@ public:
 
   const_iterator find(const key_type &Key) const {
     revng_assert(not BatchInsertInProgress);
+    if constexpr (HasIndex) {
+      auto Position = Index.find(Key, TheVector, keyOf);
+      return Position ? begin() + *Position : end();
+    }
+
     auto It = lower_bound(Key);
     auto End = end();
     if (!(It == End) and Compare()(Key, KeyedObjectTraits<T>::key(*It))) {
@@ -288,13 +505,23 @@ public:
   }
 
 public:
+  /// \brief Base class for inserters appending elements in bulk
+  ///
+  /// Elements are appended as is and the vector is sorted once, when the
+  /// inserter is committed or destroyed. Only the appended elements are sorted,
+  /// and then merged with the ones that were already there. If the elements
+  /// have been appended in order, no sorting takes place at all.
   template<bool KeepFirst>
   class BatchInserterBase {
   private:
     SortedVector *SV;
+    /// Number of elements already in the vector when the batch started
+    size_type OldSize;
+    unsigned Threads = 1;
 
   public:
-    BatchInserterBase(SortedVector &SV) : SV(&SV) {
+    BatchInserterBase(SortedVector &SV) :
+      SV(&SV), OldSize(SV.TheVector.size()) {
       revng_assert(not SV.BatchInsertInProgress);
       SV.BatchInsertInProgress = true;
     }
@@ -302,14 +529,14 @@ public:
     BatchInserterBase(const BatchInserterBase &) = delete;
     BatchInserterBase &operator=(const BatchInserterBase &) = delete;
 
-    BatchInserterBase(BatchInserterBase &&Other) {
-      SV = Other.SV;
-      Other.SV = nullptr;
-    }
+    BatchInserterBase(BatchInserterBase &&Other) { *this = std::move(Other); }
 
     BatchInserterBase &operator=(BatchInserterBase &&Other) {
       SV = Other.SV;
+      OldSize = Other.OldSize;
+      Threads = Other.Threads;
       Other.SV = nullptr;
+      return *this;
     }
 
     ~BatchInserterBase() { commit(); }
@@ -317,14 +544,28 @@ public:
     void commit() {
       if (SV != nullptr && SV->BatchInsertInProgress) {
         SV->BatchInsertInProgress = false;
-        SV->sort<KeepFirst>();
+        SV->sort<KeepFirst>(OldSize, Threads);
       }
     }
 
+  public:
+    /// \brief Make room for \p Count more elements
+    void reserve(size_type Count) {
+      revng_assert(SV->BatchInsertInProgress);
+      SV->TheVector.reserve(SV->TheVector.size() + Count);
+    }
+
+    /// \brief Sort the appended elements on up to \p Count threads
+    void setThreads(unsigned Count) {
+      revng_assert(Count != 0);
+      Threads = Count;
+    }
+
   protected:
-    T &insertImpl(const T &Value) {
+    template<typename ValueT>
+    T &insertImpl(ValueT &&Value) {
       revng_assert(SV->BatchInsertInProgress);
-      SV->TheVector.push_back(Value);
+      SV->TheVector.push_back(std::forward<ValueT>(Value));
       return SV->TheVector.back();
     }
   };
@@ -335,6 +576,7 @@ public:
 
   public:
     T &insert(const T &Value) { return this->insertImpl(Value); }
+    T &insert(T &&Value) { return this->insertImpl(std::move(Value)); }
   };
 
   BatchInserter batch_insert() {
@@ -348,6 +590,9 @@ public:
 
   public:
     T &insert_or_assign(const T &Value) { return this->insertImpl(Value); }
+    T &insert_or_assign(T &&Value) {
+      return this->insertImpl(std::move(Value));
+    }
   };
 
   BatchInsertOrAssigner batch_insert_or_assign() {
@@ -356,6 +601,15 @@ public:
   }
 
 private:
+  void invalidateIndex() {
+    if constexpr (HasIndex)
+      Index.invalidate();
+  }
+
+  static std::remove_const_t<key_type> keyOf(const T &Element) {
+    return KOT::key(Element);
+  }
+
   static bool compareElements(const T &LHS, const T &RHS) {
     return compareKeys(KeyedObjectTraits<T>::key(LHS),
                        KeyedObjectTraits<T>::key(RHS));
@@ -365,6 +619,10 @@ private:
     return Compare()(LHS, RHS);
   }
 
+  static bool compareElementAndKey(const T &LHS, const key_type &RHS) {
+    return compareKeys(KeyedObjectTraits<T>::key(LHS), RHS);
+  }
+
   static bool elementsEqual(const T &LHS, const T &RHS) {
     return keysEqual(KeyedObjectTraits<T>::key(LHS),
                      KeyedObjectTraits<T>::key(RHS));
@@ -374,18 +632,39 @@ private:
     return not compareKeys(LHS, RHS) and not compareKeys(RHS, LHS);
   }
 
+  /// \brief Restore the order after a batch insertion
+  ///
+  /// The first \p OldSize elements are sorted and unique, the following ones
+  /// have been appended by the batch.
   template<bool KeepFirst>
-  void sort() {
-    // Sort
-    std::stable_sort(begin(), end(), compareElements);
+  void sort(size_type OldSize, unsigned Threads) {
+    auto Begin = TheVector.begin();
+    auto Middle = Begin + OldSize;
+    auto End = TheVector.end();
+
+    // Sort the appended elements. Elements returned by the inserter might have
+    // been changed after their insertion: check the order only now.
+    if (not std::is_sorted(Middle, End, compareElements))
+      parallel_stable_sort(Middle, End, compareElements, Threads);
+
+    // Merge them with the existing ones, unless they all come after
+    if (Middle != Begin and Middle != End
+        and compareElements(*Middle, *std::prev(Middle)))
+      std::inplace_merge(Begin, Middle, End, compareElements);
 
     // Remove duplicates keeping the last instance of each element
-    auto NewEnd = end();
+    auto NewEnd = End;
     if (KeepFirst) {
-      NewEnd = std::unique(begin(), end(), elementsEqual);
+      NewEnd = std::unique(Begin, End, elementsEqual);
     } else {
-      NewEnd = unique_last(begin(), end(), elementsEqual);
+      NewEnd = unique_last(Begin, End, elementsEqual);
     }
-    TheVector.erase(NewEnd, end());
+    TheVector.erase(NewEnd, End);
+
+    invalidateIndex();
   }
 };
+
+/// \brief SortedVector with O(1) lookups, see the KeyHash parameter
+template<HasKeyObjectTraits T>
+using HashIndexedSortedVector = SortedVector<T, KOTCompare<T>, KOTHash<T>>;
@@ -4,6 +4,10 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
 #include "llvm/ADT/Twine.h"
 
 #include "revng/ADT/STLExtras.h"
@@ -16,8 +20,14 @@ char *typeID() {
 };
 
 class TupleTreeKeyWrapper {
+protected:
+  /// Keys up to this size are stored in the wrapper itself, saving a heap
+  /// allocation for the most common steps (field indexes, integers, type keys)
+  static constexpr size_t InlineSize = 2 * sizeof(uint64_t);
+
 protected:
   void *Pointer;
+  alignas(uint64_t) std::byte Inline[InlineSize];
 
 protected:
   TupleTreeKeyWrapper(void *Pointer) : Pointer(Pointer) {}
@@ -80,21 +90,30 @@ public:
   }
 };
 
-// TODO: optimize integral types
 template<typename T>
 class ConcreteTupleTreeKeyWrapper : public TupleTreeKeyWrapper {
 private:
   static char ID;
+  static constexpr bool IsInline = sizeof(T) <= InlineSize
+                                   and alignof(T) <= alignof(uint64_t);
 
 private:
   T *get() const { return reinterpret_cast<T *>(Pointer); }
 
 public:
   template<typename... Args>
-  ConcreteTupleTreeKeyWrapper(Args... A) : TupleTreeKeyWrapper(new T(A...)) {}
+  ConcreteTupleTreeKeyWrapper(Args... A) {
+    if constexpr (IsInline)
+      Pointer = new (Inline) T(A...);
+    else
+      Pointer = new T(A...);
+  }
 
   ~ConcreteTupleTreeKeyWrapper() override {
-    delete reinterpret_cast<T *>(Pointer);
+    if constexpr (IsInline)
+      get()->~T();
+    else
+      delete get();
   }
 
   bool operator==(const TupleTreeKeyWrapper &Other) const override {
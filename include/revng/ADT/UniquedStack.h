@@ -8,6 +8,8 @@
 #include <set>
 #include <vector>
 
+#include "llvm/ADT/BitVector.h"
+
 #include "revng/Support/Assert.h"
 
 /// \brief Stack where an element cannot be re-inserted in it's already in the
@@ -41,3 +43,51 @@ private:
   std::set<T> Set;
   std::vector<T> Queue;
 };
+
+/// \brief UniquedStack for elements that can be mapped to small integers
+///
+/// See DenseQueueImpl for the requirements on \p IndexOf.
+template<typename T, typename IndexOf>
+class DenseUniquedStack {
+public:
+  explicit DenseUniquedStack(IndexOf Index = IndexOf(), size_t Capacity = 0) :
+    Index(Index), Enqueued(Capacity) {
+    Queue.reserve(Capacity);
+  }
+
+public:
+  void insert(T Element) {
+    size_t I = Index(Element);
+    if (I >= Enqueued.size())
+      Enqueued.resize(std::max<size_t>(I + 1, 2 * Enqueued.size()));
+
+    if (not Enqueued.test(I)) {
+      Enqueued.set(I);
+      Queue.push_back(Element);
+    }
+  }
+
+  bool empty() const { return Queue.empty(); }
+
+  T pop() {
+    T Result = Queue.back();
+    Queue.pop_back();
+    Enqueued.reset(Index(Result));
+    return Result;
+  }
+
+  /// \brief Reverses the stack in its current status
+  void reverse() { std::reverse(Queue.begin(), Queue.end()); }
+
+  size_t size() const { return Queue.size(); }
+
+  bool contains(T Element) const {
+    size_t I = Index(Element);
+    return I < Enqueued.size() and Enqueued.test(I);
+  }
+
+private:
+  IndexOf Index;
+  llvm::BitVector Enqueued;
+  std::vector<T> Queue;
+};
@@ -4,7 +4,11 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
+#include <cstddef>
 #include <memory>
+#include <new>
+#include <tuple>
 #include <type_traits>
 
 #include "llvm/Support/Casting.h"
@@ -190,8 +194,146 @@ private:
   inner_pointer Pointer;
 };
 
+template<typename Tuple>
+struct MaxSizeAndAlignment;
+
+template<typename... Types>
+struct MaxSizeAndAlignment<std::tuple<Types...>> {
+  static constexpr size_t Size = std::max({ sizeof(Types)... });
+  static constexpr size_t Alignment = std::max({ alignof(Types)... });
+};
+
+/// An UpcastablePointer storing the pointee inline
+///
+/// The pointee lives in a buffer large enough for any of the concrete types of
+/// \p T, which saves an allocation and an indirection per object. Unlike with
+/// UpcastablePointer, the pointee moves along with its owner: moving an
+/// InlineUpcastablePointer, e.g., growing the container holding it,
+/// invalidates pointers to the pointee.
+template<Upcastable T>
+class InlineUpcastablePointer {
+private:
+  using concrete_types = concrete_types_traits_t<T>;
+  using Layout = MaxSizeAndAlignment<concrete_types>;
+
+public:
+  using pointer = T *;
+  using element_type = T;
+
+public:
+  template<typename L>
+  void upcast(const L &Callable) {
+    ::upcast(Pointer, Callable);
+  }
+
+  template<typename L>
+  void upcast(const L &Callable) const {
+    T *Upcastable = Pointer;
+    ::upcast(Upcastable, Callable);
+  }
+
+public:
+  constexpr InlineUpcastablePointer() noexcept {}
+  constexpr InlineUpcastablePointer(std::nullptr_t) noexcept {}
+
+  /// \note Takes ownership of \p P, which is moved inline and deleted
+  explicit InlineUpcastablePointer(pointer P) { reset(P); }
+
+  ~InlineUpcastablePointer() { reset(); }
+
+public:
+  template<DerivesFrom<T> Q, typename... Args>
+  static InlineUpcastablePointer<T> make(Args &&...TheArgs) {
+    static_assert(sizeof(Q) <= Layout::Size
+                  and alignof(Q) <= Layout::Alignment);
+    InlineUpcastablePointer<T> Result;
+    Result.Pointer = new (Storage(Result)) Q(std::forward<Args>(TheArgs)...);
+    return Result;
+  }
+
+public:
+  InlineUpcastablePointer &operator=(const InlineUpcastablePointer &Other) {
+    if (&Other != this) {
+      reset();
+      Other.upcast([this](auto &Upcasted) {
+        using type = std::remove_cvref_t<decltype(Upcasted)>;
+        Pointer = new (Storage(*this)) type(Upcasted);
+      });
+    }
+    return *this;
+  }
+
+  InlineUpcastablePointer(const InlineUpcastablePointer &Other) {
+    *this = Other;
+  }
+
+  InlineUpcastablePointer &operator=(InlineUpcastablePointer &&Other) {
+    if (&Other != this) {
+      reset();
+      Other.upcast([this](auto &Upcasted) {
+        using type = std::remove_cvref_t<decltype(Upcasted)>;
+        Pointer = new (Storage(*this)) type(std::move(Upcasted));
+      });
+      Other.reset();
+    }
+    return *this;
+  }
+
+  InlineUpcastablePointer(InlineUpcastablePointer &&Other) noexcept {
+    *this = std::move(Other);
+  }
+
+  bool operator==(const InlineUpcastablePointer &Other) const {
+    bool Result = false;
+    upcast([&](auto &Upcasted) {
+      Other.upcast([&](auto &OtherUpcasted) {
+        using ThisType = std::remove_cvref_t<decltype(Upcasted)>;
+        using OtherType = std::remove_cvref_t<decltype(OtherUpcasted)>;
+        if constexpr (std::is_same_v<ThisType, OtherType>) {
+          Result = Upcasted == OtherUpcasted;
+        }
+      });
+    });
+    return Result;
+  }
+
+  pointer get() const noexcept { return Pointer; }
+  T &operator*() const { return *Pointer; }
+  pointer operator->() const noexcept { return Pointer; }
+
+  void reset(pointer Other = pointer()) {
+    if (Pointer != nullptr) {
+      upcast([](auto &Upcasted) {
+        using type = std::remove_cvref_t<decltype(Upcasted)>;
+        Upcasted.~type();
+      });
+      Pointer = nullptr;
+    }
+
+    if (Other != nullptr) {
+      ::upcast(Other, [this](auto &Upcasted) {
+        using type = std::remove_cvref_t<decltype(Upcasted)>;
+        Pointer = new (Storage(*this)) type(std::move(Upcasted));
+        delete &Upcasted;
+      });
+    }
+  }
+
+private:
+  static void *Storage(InlineUpcastablePointer &This) {
+    return static_cast<void *>(This.Buffer);
+  }
+
+private:
+  /// Points to the object in Buffer, if any
+  T *Pointer = nullptr;
+  alignas(Layout::Alignment) std::byte Buffer[Layout::Size];
+};
+
 template<typename T>
-concept IsUpcastablePointer = is_specialization_v<T, UpcastablePointer>;
+concept IsUpcastablePointer = is_specialization_v<T, UpcastablePointer>
+                              or is_specialization_v<T,
+                                                     InlineUpcastablePointer>;
 
 template<typename T>
 concept IsNotUpcastablePointer = not IsUpcastablePointer<T>;
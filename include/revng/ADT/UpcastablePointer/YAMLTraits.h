@@ -15,7 +15,7 @@ void initializeOwningPointer(llvm::yaml::IO &io, O &Obj) {
   if constexpr (I < std::tuple_size_v<concrete_types>) {
     using type = typename std::tuple_element_t<I, concrete_types>;
     if (io.mapTag(type::Tag)) {
-      Obj.reset(new type);
+      Obj = O::template make<type>();
     } else {
       initializeOwningPointer<O, I + 1>(io, Obj);
     }
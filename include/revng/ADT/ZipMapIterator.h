@@ -4,8 +4,12 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
+#include <atomic>
 #include <iterator>
+#include <optional>
 #include <set>
+#include <thread>
 #include <tuple>
 #include <type_traits>
 #include <vector>
@@ -109,8 +113,29 @@ using zipmap_pair = std::pair<element_pointer_t<LeftMap>,
 namespace detail {
 template<typename A, typename B>
 using fifc = llvm::iterator_facade_base<A, std::forward_iterator_tag, B>;
+
+/// \brief Find the first element in [\p Begin, \p End) not satisfying \p Pred
+///
+/// \p Pred must hold for \p Begin and the elements satisfying it must come
+/// first. The search probes at exponentially increasing distances before
+/// bisecting, so it costs O(log(N)) where N is the distance of the result from
+/// \p Begin, rather than from \p End.
+template<std::random_access_iterator It, typename PredicateT>
+It gallop(It Begin, It End, PredicateT Pred) {
+  using difference_type = typename std::iterator_traits<It>::difference_type;
+  difference_type Step = 1;
+  It Low = Begin;
+  while (Step < End - Low and Pred(*(Low + Step))) {
+    Low += Step;
+    Step *= 2;
+  }
+
+  It High = Step < End - Low ? Low + Step : End;
+  return std::partition_point(Low + 1, High, Pred);
 }
 
+} // namespace detail
+
 template<typename LeftMap,
          typename RightMap,
          typename Comparator = DefaultComparator<LeftMap, RightMap>>
@@ -131,6 +156,11 @@ public:
   using value_type = zipmap_pair<LeftMap, RightMap>;
   using reference = typename ZipMapIterator::reference;
 
+  static constexpr bool CanGallop = std::random_access_iterator<
+                                      left_inner_iterator>
+                                    and std::random_access_iterator<
+                                      right_inner_iterator>;
+
 private:
   value_type Current;
   left_inner_iterator LeftIt;
@@ -138,12 +168,18 @@ private:
   right_inner_iterator RightIt;
   const right_inner_iterator EndRightIt;
 
+  /// Elements up to these iterators are known to be missing on the other side
+  left_inner_iterator LeftRunEnd;
+  right_inner_iterator RightRunEnd;
+
 public:
   ZipMapIterator(left_inner_range LeftRange, right_inner_range RightRange) :
     LeftIt(LeftRange.begin()),
     EndLeftIt(LeftRange.end()),
     RightIt(RightRange.begin()),
-    EndRightIt(RightRange.end()) {
+    EndRightIt(RightRange.end()),
+    LeftRunEnd(LeftIt),
+    RightRunEnd(RightIt) {
 
     next();
   }
@@ -172,6 +208,21 @@ private:
   bool rightIsValid() const { return RightIt != EndRightIt; }
 
   void next() {
+    // Consume the run found by the last gallop without comparing
+    if constexpr (CanGallop) {
+      if (LeftIt < LeftRunEnd) {
+        Current = std::make_pair(&*LeftIt, nullptr);
+        LeftIt++;
+        return;
+      }
+
+      if (RightIt < RightRunEnd) {
+        Current = std::make_pair(nullptr, &*RightIt);
+        RightIt++;
+        return;
+      }
+    }
+
     if (leftIsValid() and rightIsValid()) {
       switch (Comparator::compare(*LeftIt, *RightIt)) {
       case 0:
@@ -182,11 +233,25 @@ private:
 
       case -1:
         Current = std::make_pair(&*LeftIt, nullptr);
+        if constexpr (CanGallop) {
+          // Skip ahead to the first element not preceding *RightIt, so that
+          // lopsided containers cost a logarithmic number of comparisons
+          auto IsBefore = [this](const auto &Left) {
+            return Comparator::compare(Left, *RightIt) < 0;
+          };
+          LeftRunEnd = detail::gallop(LeftIt, EndLeftIt, IsBefore);
+        }
         LeftIt++;
         break;
 
       case 1:
         Current = std::make_pair(nullptr, &*RightIt);
+        if constexpr (CanGallop) {
+          auto IsBefore = [this](const auto &Right) {
+            return Comparator::compare(*LeftIt, Right) > 0;
+          };
+          RightRunEnd = detail::gallop(RightIt, EndRightIt, IsBefore);
+        }
         RightIt++;
         break;
 
@@ -238,3 +303,123 @@ zipmap_range(LeftMap &Left, RightMap &Right) {
                           zipmap_end<LeftMap, RightMap, Comparator>(Left,
                                                                     Right));
 }
+
+/// \brief Split zipmap_range(\p Left, \p Right) in up to \p Count ranges of
+///        similar size
+///
+/// Concatenating the resulting ranges yields exactly the elements of
+/// zipmap_range(\p Left, \p Right), in the same order. Splits happen at keys
+/// of the larger container: the corresponding position in the other container
+/// is found by bisection, so an element is never separated from its
+/// counterpart. Containers without random access iterators are never split.
+template<typename LeftMap,
+         typename RightMap,
+         typename Comparator = DefaultComparator<LeftMap, RightMap>>
+std::vector<llvm::iterator_range<ZipMapIterator<LeftMap, RightMap, Comparator>>>
+zipmap_partitions(LeftMap &Left, RightMap &Right, size_t Count) {
+  using Iterator = ZipMapIterator<LeftMap, RightMap, Comparator>;
+  std::vector<llvm::iterator_range<Iterator>> Result;
+
+  auto AddRange = [&Result](auto LeftBegin,
+                            auto LeftEnd,
+                            auto RightBegin,
+                            auto RightEnd) {
+    if (LeftBegin == LeftEnd and RightBegin == RightEnd)
+      return;
+
+    Iterator Begin(llvm::make_range(LeftBegin, LeftEnd),
+                   llvm::make_range(RightBegin, RightEnd));
+    Iterator End(llvm::make_range(LeftEnd, LeftEnd),
+                 llvm::make_range(RightEnd, RightEnd));
+    Result.push_back(llvm::make_range(Begin, End));
+  };
+
+  auto LeftBegin = Left.begin();
+  auto RightBegin = Right.begin();
+  size_t LeftSize = std::distance(Left.begin(), Left.end());
+  size_t RightSize = std::distance(Right.begin(), Right.end());
+  size_t LargerSize = std::max(LeftSize, RightSize);
+  Count = std::min(Count, LargerSize);
+
+  if constexpr (Iterator::CanGallop) {
+    bool SplitLeft = LeftSize >= RightSize;
+    for (size_t I = 1; I < Count; ++I) {
+      size_t Position = LargerSize * I / Count;
+      decltype(LeftBegin) LeftSplit;
+      decltype(RightBegin) RightSplit;
+      if (SplitLeft) {
+        LeftSplit = Left.begin() + Position;
+        auto IsBefore = [&LeftSplit](const auto &R) {
+          return Comparator::compare(*LeftSplit, R) > 0;
+        };
+        RightSplit = std::partition_point(RightBegin, Right.end(), IsBefore);
+      } else {
+        RightSplit = Right.begin() + Position;
+        auto IsBefore = [&RightSplit](const auto &L) {
+          return Comparator::compare(L, *RightSplit) < 0;
+        };
+        LeftSplit = std::partition_point(LeftBegin, Left.end(), IsBefore);
+      }
+
+      AddRange(LeftBegin, LeftSplit, RightBegin, RightSplit);
+      LeftBegin = LeftSplit;
+      RightBegin = RightSplit;
+    }
+  }
+
+  AddRange(LeftBegin, Left.end(), RightBegin, Right.end());
+  return Result;
+}
+
+/// \brief Visit zipmap_range(\p Left, \p Right) on up to \p ThreadsCount
+///        threads
+///
+/// The elements are split through zipmap_partitions and each range is passed
+/// to \p Visit, which might run concurrently with other invocations and must
+/// only read the containers. The results are returned in the order of the
+/// ranges, independently from the scheduling of the threads, so concatenating
+/// them is equivalent to a single-threaded visit.
+template<typename LeftMap,
+         typename RightMap,
+         typename Comparator = DefaultComparator<LeftMap, RightMap>,
+         typename VisitT>
+auto parallel_zipmap(LeftMap &Left,
+                     RightMap &Right,
+                     unsigned ThreadsCount,
+                     VisitT Visit) {
+  using Iterator = ZipMapIterator<LeftMap, RightMap, Comparator>;
+  using Range = llvm::iterator_range<Iterator>;
+  using ResultT = std::invoke_result_t<VisitT &, Range>;
+
+  // Create more ranges than threads to balance the load
+  constexpr size_t RangesPerThread = 4;
+  size_t RangesCount = ThreadsCount * RangesPerThread;
+  auto Ranges = zipmap_partitions<LeftMap, RightMap, Comparator>(Left,
+                                                                 Right,
+                                                                 RangesCount);
+
+  std::vector<std::optional<ResultT>> Results(Ranges.size());
+  std::atomic<size_t> Next(0);
+  auto Worker = [&]() {
+    for (size_t I = Next++; I < Ranges.size(); I = Next++)
+      Results[I].emplace(Visit(Ranges[I]));
+  };
+
+  size_t Count = std::min<size_t>(ThreadsCount, Ranges.size());
+  if (Count <= 1) {
+    Worker();
+  } else {
+    std::vector<std::thread> Threads;
+    for (size_t I = 0; I < Count; I++)
+      Threads.emplace_back(Worker);
+
+    for (std::thread &Thread : Threads)
+      Thread.join();
+  }
+
+  std::vector<ResultT> Result;
+  Result.reserve(Results.size());
+  for (std::optional<ResultT> &R : Results)
+    Result.push_back(std::move(*R));
+  return Result;
+}
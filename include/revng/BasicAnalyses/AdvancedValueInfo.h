@@ -6,6 +6,9 @@
 
 #include <set>
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallBitVector.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/Analysis/ConstantFolding.h"
 #include "llvm/Analysis/LazyValueInfo.h"
 #include "llvm/Analysis/ScalarEvolution.h"
@@ -19,6 +22,7 @@
 #include "revng/ADT/ConstantRangeSet.h"
 #include "revng/BasicAnalyses/MaterializedValue.h"
 #include "revng/Support/Debug.h"
+#include "revng/Support/Generator.h"
 #include "revng/Support/GraphAlgorithms.h"
 #include "revng/Support/IRHelpers.h"
 #include "revng/Support/MonotoneFramework.h"
@@ -28,6 +32,36 @@ inline Logger<> AVILogger("avi");
 using range_size_t = uint64_t;
 const range_size_t MaxMaterializedValues = (1 << 16);
 
+/// \brief Amount of work an AdvancedValueInfo query is allowed to perform
+///
+/// Materializing a value costs one unit, plus one unit for each operation of
+/// the expression it goes through.
+class AVIBudget {
+private:
+  range_size_t Remaining;
+
+public:
+  explicit AVIBudget(range_size_t Units) : Remaining(Units) {}
+
+public:
+  range_size_t remaining() const { return Remaining; }
+  bool exhausted() const { return Remaining == 0; }
+
+  /// \return false, and exhaust the budget, if less than \p Units are left
+  bool consume(range_size_t Units) {
+    if (Units > Remaining) {
+      Remaining = 0;
+      return false;
+    }
+
+    Remaining -= Units;
+    return true;
+  }
+};
+
+/// Budget of each AdvancedValueInfo::explore query
+const range_size_t DefaultAVIBudget = 64 * MaxMaterializedValues;
+
 inline unsigned getTypeSize(const llvm::DataLayout &DL, llvm::Type *T) {
   using namespace llvm;
   if (auto *IntegerTy = dyn_cast<IntegerType>(T))
@@ -126,6 +160,58 @@ inline llvm::ConstantInt *replaceAllUnknownsWith(llvm::ScalarEvolution &SE,
   return cast<SCEVConstant>(RW.visit(SC))->getValue();
 }
 
+/// \brief Memoize the queries AdvancedValueInfo performs on ScalarEvolution
+///
+/// A single instance serves all the queries of an AdvancedValueInfo instance,
+/// which usually meet the same expressions over and over, e.g., all the
+/// queries going through a jump table compute its index in the same way.
+/// Rewriting a SCEV also creates new SCEVs, which ScalarEvolution keeps until
+/// it's destroyed: evaluating each expression once for each value saves
+/// memory too.
+class SCEVCache {
+private:
+  using EvaluationKey = std::pair<const llvm::SCEV *, llvm::ConstantInt *>;
+
+private:
+  llvm::ScalarEvolution &SE;
+  llvm::DenseMap<const llvm::SCEV *, llvm::Value *> UniqueUnknowns;
+  llvm::DenseMap<EvaluationKey, llvm::ConstantInt *> Evaluations;
+  uint64_t Hits = 0;
+  uint64_t Misses = 0;
+
+public:
+  explicit SCEVCache(llvm::ScalarEvolution &SE) : SE(SE) {}
+
+public:
+  llvm::ScalarEvolution &scalarEvolution() const { return SE; }
+
+  /// \brief Cached version of getUniqueUnknown on the SCEV of \p V
+  llvm::Value *getUniqueUnknown(llvm::Value *V) {
+    const llvm::SCEV *S = SE.getSCEV(V);
+    auto [It, New] = UniqueUnknowns.try_emplace(S, nullptr);
+    if (New)
+      It->second = ::getUniqueUnknown(SE, S);
+    return It->second;
+  }
+
+  /// \brief Cached version of replaceAllUnknownsWith on the SCEV of \p V
+  llvm::ConstantInt *replaceAllUnknownsWith(llvm::Value *V,
+                                            llvm::ConstantInt *C) {
+    const llvm::SCEV *S = SE.getSCEV(V);
+    auto [It, New] = Evaluations.try_emplace({ S, C }, nullptr);
+    if (New) {
+      ++Misses;
+      It->second = ::replaceAllUnknownsWith(SE, S, C);
+    } else {
+      ++Hits;
+    }
+    return It->second;
+  }
+
+  uint64_t hits() const { return Hits; }
+  uint64_t misses() const { return Misses; }
+};
+
 struct Edge {
   llvm::BasicBlock *Start;
   llvm::BasicBlock *End;
@@ -145,10 +231,17 @@ struct Edge {
 /// \brief Monotone framework to collect ConstantRangeSets from LazyValueInfo
 namespace DisjointRanges {
 
+/// \brief Ranges of the tracked instructions, indexed by their number
+///
+/// Analysis numbers the instructions it tracks once, the content of each
+/// Element is then stored in contiguous storage, so that merging two Elements
+/// is a linear walk instead of a merge of two maps.
 class Element {
 private:
-  using Container = std::map<llvm::Instruction *, ConstantRangeSet>;
-  Container Ranges;
+  llvm::SmallVector<ConstantRangeSet, 4> Ranges;
+
+  /// Which entries of Ranges are meaningful
+  llvm::SmallBitVector Present;
 
 public:
   Element() {}
@@ -158,33 +251,50 @@ public:
 
 public:
   void combine(const Element &Other) {
+    grow(Other.Ranges.size());
 
-    // We can't use zipmap_ranges since Other is const
-    for (auto &P : Other.Ranges) {
-      auto It = Ranges.find(P.first);
-      if (It == Ranges.end())
-        Ranges[P.first] = P.second;
-      else
-        It->second = It->second.unionWith(P.second);
+    for (unsigned Index : Other.Present.set_bits()) {
+      if (Present[Index]) {
+        Ranges[Index] = Ranges[Index].unionWith(Other.Ranges[Index]);
+      } else {
+        Ranges[Index] = Other.Ranges[Index];
+        Present.set(Index);
+      }
     }
   }
 
   bool lowerThanOrEqual(const Element &Other) const {
-    for (auto &P : Ranges) {
-      auto It = Other.Ranges.find(P.first);
-      if (It == Other.Ranges.end() or not It->second.contains(P.second))
+    for (unsigned Index : Present.set_bits()) {
+      if (not Other.hasKey(Index)
+          or not Other.Ranges[Index].contains(Ranges[Index]))
         return false;
     }
 
     return true;
   }
 
-  ConstantRangeSet &operator[](llvm::Instruction *I) { return Ranges[I]; }
-  const ConstantRangeSet &operator[](llvm::Instruction *I) const {
-    return Ranges.at(I);
+  ConstantRangeSet &operator[](unsigned Index) {
+    grow(Index + 1);
+    Present.set(Index);
+    return Ranges[Index];
+  }
+
+  const ConstantRangeSet &operator[](unsigned Index) const {
+    revng_assert(hasKey(Index));
+    return Ranges[Index];
+  }
+
+  bool hasKey(unsigned Index) const {
+    return Index < Present.size() and Present[Index];
   }
 
-  bool hasKey(llvm::Instruction *I) const { return Ranges.count(I) != 0; }
+private:
+  void grow(size_t Size) {
+    if (Size > Ranges.size()) {
+      Ranges.resize(Size);
+      Present.resize(Size);
+    }
+  }
 };
 
 class Analysis
@@ -204,7 +314,14 @@ private:
   llvm::BasicBlock *Entry;
   llvm::LazyValueInfo &LVI;
   const llvm::DominatorTree &DT;
-  std::map<llvm::Instruction *, ConstantRangeSet> InstructionRanges;
+
+  /// The tracked instructions, their index is their number in Element
+  std::vector<llvm::Instruction *> Tracked;
+  llvm::DenseMap<llvm::Instruction *, unsigned> TrackedIndex;
+
+  /// Ranges of the tracked instructions on the target edges
+  std::vector<ConstantRangeSet> InstructionRanges;
+
   std::set<Edge> TargetEdges;
   std::set<llvm::BasicBlock *> WhiteList;
 
@@ -220,10 +337,14 @@ public:
     registerExtremal(Entry);
 
     for (Instruction *I : TargetInstructions) {
-      if (auto *Ty = dyn_cast<IntegerType>(I->getType())) {
-        InstructionRanges[I] = { ConstantRange(Ty->getIntegerBitWidth(),
-                                               true) };
-      }
+      auto *Ty = dyn_cast<IntegerType>(I->getType());
+      if (Ty == nullptr or TrackedIndex.count(I) != 0)
+        continue;
+
+      TrackedIndex[I] = Tracked.size();
+      Tracked.push_back(I);
+      InstructionRanges.push_back({ ConstantRange(Ty->getIntegerBitWidth(),
+                                                  true) });
     }
 
     for (const Edge &E : TargetEdges) {
@@ -273,16 +394,18 @@ public:
   }
 
   const ConstantRangeSet &get(llvm::Instruction *I) const {
-    return InstructionRanges.at(I);
+    auto It = TrackedIndex.find(I);
+    revng_assert(It != TrackedIndex.end());
+    return InstructionRanges[It->second];
   }
 
   void dump() const debug_function { dump(dbg); }
 
   template<typename T>
   void dump(T &Output) const {
-    for (auto &P : InstructionRanges) {
-      Output << getName(P.first) << ": ";
-      P.second.dump(Output);
+    for (unsigned Index = 0; Index < Tracked.size(); ++Index) {
+      Output << getName(Tracked[Index]) << ": ";
+      InstructionRanges[Index].dump(Output);
       Output << "\n";
     }
   }
@@ -294,10 +417,10 @@ private:
                                   llvm::BasicBlock *Source,
                                   llvm::BasicBlock *Destination,
                                   bool IsTargetEdge) {
-    Element Result = Original;
-    for (auto &P : InstructionRanges) {
-      llvm::Instruction *I = P.first;
-      ConstantRangeSet &InstructionRangeSet = P.second;
+    Element Result = Original.copy();
+    for (unsigned Index = 0; Index < Tracked.size(); ++Index) {
+      llvm::Instruction *I = Tracked[Index];
+      ConstantRangeSet &InstructionRangeSet = InstructionRanges[Index];
 
       if (not DT.dominates(I->getParent(), Source))
         continue;
@@ -311,8 +434,8 @@ private:
       else
         NewRange = LVI.getConstantRangeOnEdge(I, Source, Destination);
 
-      bool IsNew = not Result.hasKey(I);
-      ConstantRangeSet &RangeSet = Result[I];
+      bool IsNew = not Result.hasKey(Index);
+      ConstantRangeSet &RangeSet = Result[Index];
       if (IsNew) {
         RangeSet = NewRange;
       } else {
@@ -401,7 +524,7 @@ struct Operation {
 class Expression {
 private:
   const llvm::DataLayout &DL;
-  llvm::ScalarEvolution &SE;
+  SCEVCache &SC;
   std::vector<Operation> OperationsStack;
   unsigned SmallestRangeIndex;
   bool PhiIsSmallest;
@@ -412,8 +535,7 @@ public:
   using PhiEdges = std::vector<Edge>;
 
 public:
-  Expression(const llvm::DataLayout &DL, llvm::ScalarEvolution &SE) :
-    DL(DL), SE(SE) {
+  Expression(const llvm::DataLayout &DL, SCEVCache &SC) : DL(DL), SC(SC) {
     reset();
   }
 
@@ -529,7 +651,7 @@ public:
         if (Next == nullptr and I->getNumOperands() > 1) {
           // The instruction has more than one free operand, let's give SCEV a
           // shot
-          Next = getUniqueUnknown(SE, SE.getSCEV(I));
+          Next = SC.getUniqueUnknown(I);
           if (Next == I)
             Next = nullptr;
           NextIndex = Operation::UseSCEV;
@@ -627,12 +749,36 @@ public:
   }
 
   /// \brief Materialize all the values in this expression
+  ///
+  /// \return all the values, or an empty vector if it's not possible to
+  ///         produce all of them
+  template<typename MemoryOracle>
+  MaterializedValues materialize(MemoryOracle &MO, AVIBudget &Budget) {
+    MaterializedValues Result;
+    bool Complete = false;
+    for (MaterializedValue &Value : stream(MO, Budget, Complete))
+      Result.push_back(std::move(Value));
+
+    if (not Complete)
+      return {};
+
+    return Result;
+  }
+
+  /// \brief Materialize the values in this expression one at a time
+  ///
+  /// \p Complete is set to true when all the values have been produced. If the
+  /// generator ends with \p Complete still false, either it was not possible
+  /// to materialize one of the values or \p Budget has been exhausted, and the
+  /// values produced so far are not all the possible values.
   template<typename MemoryOracle>
-  MaterializedValues materialize(MemoryOracle &MO) {
+  cppcoro::generator<MaterializedValue>
+  stream(MemoryOracle &MO, AVIBudget &Budget, bool &Complete) {
     using namespace llvm;
 
     revng_assert(not Materialized);
     Materialized = true;
+    Complete = false;
 
     IntegerType *SmallestType = nullptr;
     for (const Operation &Operation : OperationsStack) {
@@ -644,7 +790,9 @@ public:
       }
     }
 
-    range_size_t WorstCase = MaxMaterializedValues;
+    // Each value costs at least one unit
+    range_size_t WorstCase = std::min(MaxMaterializedValues,
+                                      Budget.remaining());
     if (SmallestType != nullptr)
       WorstCase = std::min(SmallestType->getBitMask(), WorstCase);
 
@@ -657,7 +805,7 @@ public:
         // Materialize all the values, so we can process them one by one
         revng_assert(Values.size() == 0);
         if (SmallestOperation.RangeSize >= WorstCase)
-          return {};
+          co_return;
         Values.resize(SmallestOperation.RangeSize);
 
         auto It = SmallestOperation.Range.begin();
@@ -681,6 +829,9 @@ public:
       using CI = ConstantInt;
       using CE = ConstantExpr;
 
+      if (not Budget.consume(1 + OperationsStack.size()))
+        co_return;
+
       if (AVILogger.isEnabled()) {
         AVILogger << "Now materializing ";
         Entry.dump(AVILogger);
@@ -733,7 +884,7 @@ public:
               and not(I != nullptr
                       and (I->isCast() or I->getOpcode() == Instruction::Add
                            or I->getOpcode() == Instruction::Sub))) {
-            return {};
+            co_return;
           }
 
           if (auto *C = dyn_cast<Constant>(Op.V)) {
@@ -754,7 +905,7 @@ public:
 
             if (not Loaded.isValid()) {
               // Couldn't read memory, bail out
-              return {};
+              co_return;
             }
 
             if (Loaded.hasSymbol())
@@ -780,9 +931,8 @@ public:
           } else if (I != nullptr) {
 
             if (Op.usesSCEV()) {
-              Current = replaceAllUnknownsWith(SE,
-                                               SE.getSCEV(I),
-                                               cast<ConstantInt>(Current));
+              Current = SC.replaceAllUnknownsWith(I,
+                                                  cast<ConstantInt>(Current));
             } else {
               // Build operands list patching the free operand
               SmallVector<Constant *, 4> Operands;
@@ -812,7 +962,7 @@ public:
 
       // Ignore undef
       if (isa<UndefValue>(Current))
-        return {};
+        co_return;
 
       APInt Value(getTypeSize(DL, Current->getType()), 0);
       if (not Current->isNullValue()) {
@@ -828,9 +978,11 @@ public:
         Entry = { *SymbolName, Value };
       else
         Entry = { Value };
+
+      co_yield Entry;
     }
 
-    return std::move(Values);
+    Complete = true;
   }
 
   void setPhiValues(MaterializedValues PhiValues) {
@@ -869,12 +1021,12 @@ public:
 
 public:
   PhiProcess(const llvm::DataLayout &DL,
-             llvm::ScalarEvolution &SE,
+             SCEVCache &SC,
              llvm::Instruction *Phi,
              range_size_t UpperBound) :
     Phi(Phi),
     NextIncomingIndex(0),
-    Expr(DL, SE),
+    Expr(DL, SC),
     Unfinished(false),
     UpperBound(UpperBound),
     TooLarge(false) {
@@ -914,7 +1066,7 @@ template<typename MemoryOracle>
 class AdvancedValueInfo {
 private:
   llvm::LazyValueInfo &LVI;
-  llvm::ScalarEvolution &SE;
+  SCEVCache SC;
   const llvm::DominatorTree &DT;
   MemoryOracle &MO;
   llvm::BasicBlock *StopAt;
@@ -925,16 +1077,55 @@ public:
                     const llvm::DominatorTree &DT,
                     MemoryOracle &MO,
                     llvm::BasicBlock *StopAt) :
-    LVI(LVI), SE(SE), DT(DT), MO(MO), StopAt(StopAt) {}
+    LVI(LVI), SC(SE), DT(DT), MO(MO), StopAt(StopAt) {}
+
+  const SCEVCache &scevCache() const { return SC; }
 
+  /// \brief Collect all the possible values of \p V in \p BB
+  ///
+  /// \return the sorted possible values, or an empty vector if they could not
+  ///         all be identified within DefaultAVIBudget
   MaterializedValues explore(llvm::BasicBlock *BB, llvm::Value *V);
+
+  /// \brief Produce the possible values of \p V in \p BB as they are found
+  ///
+  /// Each value is produced once, in no particular order. The consumer can
+  /// stop at any point, avoiding the work to materialize the remaining values.
+  /// \p Complete is set to true once all the possible values have been
+  /// produced: if the generator ends and \p Complete is still false, the
+  /// produced values are a subset of the possible ones and should usually be
+  /// discarded.
+  cppcoro::generator<MaterializedValue> enumerate(llvm::BasicBlock *BB,
+                                                  llvm::Value *V,
+                                                  AVIBudget &Budget,
+                                                  bool &Complete);
 };
 
 template<class MemoryOracle>
 MaterializedValues
 AdvancedValueInfo<MemoryOracle>::explore(llvm::BasicBlock *BB, llvm::Value *V) {
+  AVIBudget Budget(DefaultAVIBudget);
+  bool Complete = false;
+  MaterializedValues Result;
+  for (MaterializedValue &Value : enumerate(BB, V, Budget, Complete))
+    Result.push_back(std::move(Value));
+
+  if (not Complete)
+    return {};
+
+  std::sort(Result.begin(), Result.end());
+  return Result;
+}
+
+template<class MemoryOracle>
+cppcoro::generator<MaterializedValue>
+AdvancedValueInfo<MemoryOracle>::enumerate(llvm::BasicBlock *BB,
+                                           llvm::Value *V,
+                                           AVIBudget &Budget,
+                                           bool &Complete) {
   using namespace llvm;
   const llvm::DataLayout &DL = getModule(BB)->getDataLayout();
+  Complete = false;
 
   revng_log(AVILogger, "Exploring " << V << " in " << BB);
 
@@ -955,11 +1146,15 @@ AdvancedValueInfo<MemoryOracle>::explore(llvm::BasicBlock *BB, llvm::Value *V) {
 
   std::set<Instruction *> VisitedPhis;
   std::vector<PhiProcess> PendingPhis{
-    { DL, SE, FakePhi, MaxMaterializedValues }
+    { DL, SC, FakePhi, MaxMaterializedValues }
   };
   Expression::PhiEdges Edges;
 
   while (true) {
+    // Give up if materializing the values of the phis took all the budget
+    if (Budget.exhausted())
+      co_return;
+
     PhiProcess &Current = PendingPhis.back();
 
     if (AVILogger.isEnabled()) {
@@ -1004,7 +1199,7 @@ AdvancedValueInfo<MemoryOracle>::explore(llvm::BasicBlock *BB, llvm::Value *V) {
       // The last node of the Expression we just build is a phi node,
       // we have to suspend processing and proceed towards it
       PendingPhis.emplace_back(DL,
-                               SE,
+                               SC,
                                NextPhi,
                                Current.Expr.smallestRangeSize());
     } else {
@@ -1014,13 +1209,30 @@ AdvancedValueInfo<MemoryOracle>::explore(llvm::BasicBlock *BB, llvm::Value *V) {
       // Drop this edge from the list of edges
       Edges.pop_back();
 
-      MaterializedValues Result;
       size_t UpperBound = Current.Expr.smallestRangeSize();
       bool IsSmallerThanUpperBound = UpperBound < Current.UpperBound;
+
+      if (PendingPhis.size() == 1) {
+        // This is the expression of V itself, there's no need to collect all
+        // of its values before producing them
+        if (IsSmallerThanUpperBound) {
+          std::set<MaterializedValue> Produced;
+          bool StreamComplete = false;
+          auto Stream = Current.Expr.stream(MO, Budget, StreamComplete);
+          for (MaterializedValue &Value : Stream)
+            if (Produced.insert(Value).second)
+              co_yield Value;
+          Complete = StreamComplete;
+        }
+
+        co_return;
+      }
+
+      MaterializedValues Result;
       bool PhiDone = not IsSmallerThanUpperBound;
       if (IsSmallerThanUpperBound) {
         // Materialize the current expression
-        Result = std::move(Current.Expr.materialize<MemoryOracle>(MO));
+        Result = Current.Expr.materialize<MemoryOracle>(MO, Budget);
 
         // Reset the unfinished flag
         Current.Unfinished = false;
@@ -1061,9 +1273,6 @@ AdvancedValueInfo<MemoryOracle>::explore(llvm::BasicBlock *BB, llvm::Value *V) {
       }
 
       if (PhiDone) {
-        if (PendingPhis.size() == 1)
-          return Result;
-
         // Pop
         PendingPhis.pop_back();
 
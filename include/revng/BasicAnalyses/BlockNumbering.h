@@ -0,0 +1,169 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/Pass.h"
+
+#include "revng/Support/Assert.h"
+
+namespace llvm {
+class BasicBlock;
+class Function;
+class LoopInfo;
+} // namespace llvm
+
+/// \brief Numbers of the basic blocks of a function reachable from its entry
+///
+/// Each block gets:
+///
+/// * its index in reverse post order, which is dense and can be used to index
+///   vectors and bit vectors, and as the priority of a worklist;
+/// * its pre and post order number in the depth first visit producing such
+///   order, which tell in O(1) whether a block is an ancestor of another in
+///   the DFS spanning tree;
+/// * its loop depth, if LoopInfo was available.
+///
+/// Unreachable blocks have no number. The numbering depends on the CFG only,
+/// so it survives the passes preserving it.
+class BlockNumbering {
+private:
+  struct Numbers {
+    uint32_t PreOrder;
+    uint32_t PostOrder;
+    uint32_t LoopDepth;
+  };
+
+private:
+  std::vector<llvm::BasicBlock *> RPO;
+  std::vector<Numbers> BlockNumbers;
+  llvm::DenseMap<const llvm::BasicBlock *, uint32_t> Indices;
+
+public:
+  /// \brief Maps reachable blocks to their index in reverse post order
+  ///
+  /// Meant to be used as the IndexOf parameter of DenseOnceQueue and similar.
+  struct RPOIndexOf {
+    const BlockNumbering *Numbering = nullptr;
+
+    size_t operator()(const llvm::BasicBlock *BB) const {
+      return Numbering->rpoIndex(BB);
+    }
+  };
+
+public:
+  /// \param LI used to compute the loop depths, if null they are all zero
+  static BlockNumbering compute(llvm::Function &F, const llvm::LoopInfo *LI);
+
+public:
+  size_t size() const { return RPO.size(); }
+
+  /// \return the reachable blocks in reverse post order
+  llvm::ArrayRef<llvm::BasicBlock *> rpo() const { return RPO; }
+
+  bool isReachable(const llvm::BasicBlock *BB) const {
+    return Indices.count(BB) != 0;
+  }
+
+  /// \return the index of \p BB in rpo(), if reachable
+  std::optional<uint32_t> lookup(const llvm::BasicBlock *BB) const {
+    auto It = Indices.find(BB);
+    if (It == Indices.end())
+      return std::nullopt;
+    return It->second;
+  }
+
+  uint32_t rpoIndex(const llvm::BasicBlock *BB) const { return index(BB); }
+
+  RPOIndexOf rpoIndexOf() const { return { this }; }
+
+  uint32_t preOrder(const llvm::BasicBlock *BB) const {
+    return BlockNumbers[index(BB)].PreOrder;
+  }
+
+  uint32_t postOrder(const llvm::BasicBlock *BB) const {
+    return BlockNumbers[index(BB)].PostOrder;
+  }
+
+  uint32_t loopDepth(const llvm::BasicBlock *BB) const {
+    return BlockNumbers[index(BB)].LoopDepth;
+  }
+
+  /// \brief Is \p Ancestor an ancestor of \p BB (or \p BB itself) in the DFS
+  ///        spanning tree?
+  ///
+  /// This is a necessary condition for \p Ancestor to dominate \p BB.
+  bool isDFSAncestor(const llvm::BasicBlock *Ancestor,
+                     const llvm::BasicBlock *BB) const {
+    const Numbers &A = BlockNumbers[index(Ancestor)];
+    const Numbers &B = BlockNumbers[index(BB)];
+    return A.PreOrder <= B.PreOrder and B.PostOrder <= A.PostOrder;
+  }
+
+  /// \brief Does the edge from \p From to \p To go backward in reverse post
+  ///        order?
+  ///
+  /// All the edges closing a cycle do.
+  bool isRetreatingEdge(const llvm::BasicBlock *From,
+                        const llvm::BasicBlock *To) const {
+    return index(To) <= index(From);
+  }
+
+private:
+  uint32_t index(const llvm::BasicBlock *BB) const {
+    auto It = Indices.find(BB);
+    revng_assert(It != Indices.end());
+    return It->second;
+  }
+};
+
+/// \brief Computes the BlockNumbering of a function
+///
+/// The result is invalidated only if the CFG of the function changes.
+class BlockNumberingAnalysis
+  : public llvm::AnalysisInfoMixin<BlockNumberingAnalysis> {
+  friend llvm::AnalysisInfoMixin<BlockNumberingAnalysis>;
+
+private:
+  static llvm::AnalysisKey Key;
+
+public:
+  class Result : public BlockNumbering {
+  public:
+    Result(BlockNumbering &&Numbering) : BlockNumbering(std::move(Numbering)) {}
+
+  public:
+    bool invalidate(llvm::Function &F,
+                    const llvm::PreservedAnalyses &PA,
+                    llvm::FunctionAnalysisManager::Invalidator &);
+  };
+
+public:
+  Result run(llvm::Function &F, llvm::FunctionAnalysisManager &FAM);
+};
+
+/// Legacy pass manager pass to access BlockNumbering, preserved by the passes
+/// calling setPreservesCFG.
+class BlockNumberingWrapperPass : public llvm::FunctionPass {
+private:
+  std::optional<BlockNumbering> Numbering;
+
+public:
+  static char ID;
+
+  BlockNumberingWrapperPass() : llvm::FunctionPass(ID) {}
+
+  const BlockNumbering &getNumbering() const { return *Numbering; }
+
+  bool runOnFunction(llvm::Function &F) override;
+  void releaseMemory() override { Numbering.reset(); }
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override;
+};
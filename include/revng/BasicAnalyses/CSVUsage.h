@@ -0,0 +1,75 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <map>
+#include <set>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/IR/PassManager.h"
+
+namespace llvm {
+class Function;
+class GlobalVariable;
+} // namespace llvm
+
+/// \brief The CSVs a function accesses directly and the functions it calls
+///
+/// The usage is not transitive: the CSVs accessed by the callees are not taken
+/// into account. The code following a call to `abort` is ignored.
+class FunctionCSVUsage {
+public:
+  std::set<llvm::GlobalVariable *> Read;
+  std::set<llvm::GlobalVariable *> Written;
+  std::set<llvm::Function *> Callees;
+
+public:
+  /// \brief Inspect \p F considering the globals in \p CSVs only
+  static FunctionCSVUsage
+  compute(llvm::Function &F, const std::set<llvm::GlobalVariable *> &CSVs);
+};
+
+/// \brief Memoizes the FunctionCSVUsage of the functions of a module
+///
+/// This is meant for passes running in the legacy pass manager, the new one
+/// should use CSVUsageAnalysis. Users modifying a function are responsible for
+/// invalidating it.
+class CSVUsageCache {
+private:
+  std::set<llvm::GlobalVariable *> CSVs;
+  std::map<llvm::Function *, FunctionCSVUsage> Cache;
+
+public:
+  CSVUsageCache(llvm::ArrayRef<llvm::GlobalVariable *> CSVs) :
+    CSVs(CSVs.begin(), CSVs.end()) {}
+
+public:
+  const FunctionCSVUsage &get(llvm::Function *F) {
+    auto It = Cache.find(F);
+    if (It == Cache.end())
+      It = Cache.emplace(F, FunctionCSVUsage::compute(*F, CSVs)).first;
+    return It->second;
+  }
+
+  void invalidate(llvm::Function *F) { Cache.erase(F); }
+};
+
+/// \brief Computes the FunctionCSVUsage of a function
+///
+/// The CSVs are those listed in the revng.csv metadata of the module. Being a
+/// function analysis, the result is invalidated only for the functions that
+/// have been changed.
+class CSVUsageAnalysis : public llvm::AnalysisInfoMixin<CSVUsageAnalysis> {
+  friend llvm::AnalysisInfoMixin<CSVUsageAnalysis>;
+
+private:
+  static llvm::AnalysisKey Key;
+
+public:
+  using Result = FunctionCSVUsage;
+
+public:
+  Result run(llvm::Function &F, llvm::FunctionAnalysisManager &);
+};
@@ -4,10 +4,14 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
 #include <cstdint>
 #include <map>
+#include <memory>
 #include <utility>
+#include <vector>
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/IR/Dominators.h"
 #include "llvm/IR/PassManager.h"
 #include "llvm/Pass.h"
@@ -15,6 +19,7 @@
 
 #include "revng/Support/BlockType.h"
 #include "revng/Support/IRHelpers.h"
+#include "revng/Support/MetaAddressConstants.h"
 #include "revng/Support/ProgramCounterHandler.h"
 #include "revng/Support/revng.h"
 
@@ -56,6 +61,25 @@ public:
 
   void run(llvm::Module &M);
 
+  /// \brief Drop the information cached about \p F
+  ///
+  /// To be called by users modifying the CFG of \p F. The information will be
+  /// recomputed, in bulk, the next time it is requested.
+  void invalidate(llvm::Function *F);
+
+  /// \brief Invalidation hook for the new pass manager
+  ///
+  /// At the module level, the whole result is dropped unless
+  /// GeneratedCodeBasicInfoAnalysis is preserved. At the function level, only
+  /// the information about the function is dropped, while the result remains
+  /// cached.
+  bool invalidate(llvm::Module &,
+                  const llvm::PreservedAnalyses &PA,
+                  llvm::ModuleAnalysisManager::Invalidator &);
+  bool invalidate(llvm::Function &F,
+                  const llvm::PreservedAnalyses &PA,
+                  llvm::FunctionAnalysisManager::Invalidator &);
+
   /// \brief Return the type of basic block, see BlockType.
   static BlockType::Values getType(llvm::BasicBlock *BB) {
     return getType(BB->getTerminator());
@@ -81,8 +105,8 @@ public:
 
     if (MD == nullptr) {
       Instruction *First = &*T->getParent()->begin();
-      if (CallInst *Call = getCallTo(First, "newpc"))
-        if (getLimitedValue(Call->getArgOperand(2)) == 1)
+      if (Value *IsJT = getNewPCArgument(First, 2))
+        if (getLimitedValue(IsJT) == 1)
           return BlockType::JumpTargetBlock;
 
       return BlockType::TranslatedBlock;
@@ -217,12 +241,39 @@ public:
                                                     { IBDHB });
   }
 
+  /// \brief Like buildDispatcher, for a jump site whose targets are all known
+  ///
+  /// \see ProgramCounterHandler::buildJumpSiteDispatcher
+  template<typename T>
+  ProgramCounterHandler::DispatcherInfo
+  buildJumpSiteDispatcher(T &Targets,
+                          llvm::IRBuilder<> &Builder,
+                          llvm::BasicBlock *Default = nullptr) {
+    ProgramCounterHandler::DispatcherTargets TargetsPairs;
+    TargetsPairs.reserve(Targets.size());
+    for (MetaAddress MA : Targets)
+      TargetsPairs.push_back({ MA, getBlockAt(MA) });
+
+    if (Default == nullptr)
+      Default = UnexpectedPC;
+
+    auto IBDHB = BlockType::IndirectBranchDispatcherHelperBlock;
+    auto *PCH = programCounterHandler();
+    return PCH->buildJumpSiteDispatcher(TargetsPairs,
+                                        Builder,
+                                        Default,
+                                        { IBDHB });
+  }
+
   /// \brief Return the basic block associated to \p PC
   ///
   /// Returns nullptr if the PC doesn't have a basic block (yet)
   llvm::BasicBlock *getBlockAt(MetaAddress PC) const {
-    auto It = JumpTargets.find(PC);
-    if (It == JumpTargets.end())
+    auto It = std::lower_bound(JumpTargets.begin(),
+                               JumpTargets.end(),
+                               PC,
+                               CompareAddress());
+    if (It == JumpTargets.end() or It->first != PC)
       return nullptr;
 
     return It->second;
@@ -290,11 +341,12 @@ public:
     if (PCToBlockCache.size() == 0)
       initializePCToBlockCache();
 
-    auto GetSecond = [](PCToBlockMap::value_type &Element) {
-      return Element.second;
-    };
+    auto GetSecond = [](AddressToBlock &Element) { return Element.second; };
 
-    auto [Start, End] = PCToBlockCache.equal_range(PC);
+    auto [Start, End] = std::equal_range(PCToBlockCache.begin(),
+                                         PCToBlockCache.end(),
+                                         PC,
+                                         CompareAddress());
     return llvm::make_range(llvm::map_iterator(Start, GetSecond),
                             llvm::map_iterator(End, GetSecond));
   }
@@ -307,6 +359,9 @@ public:
 
   const llvm::ArrayRef<llvm::GlobalVariable *> csvs() const { return CSVs; }
 
+  /// \brief Collect the CSVs of \p M, as listed in the revng.csv metadata
+  static std::vector<llvm::GlobalVariable *> collectCSVs(const llvm::Module &M);
+
   class CSVsUsage {
   public:
     void sort() {
@@ -351,7 +406,12 @@ public:
   }
   llvm::Constant *toConstant(const MetaAddress &Address) {
     revng_assert(MetaAddressStruct != nullptr);
-    return Address.toConstant(MetaAddressStruct);
+    return MAConstants.toConstant(Address);
+  }
+
+  /// \brief Cached version of MetaAddress::fromConstant
+  MetaAddress fromConstant(llvm::Value *V) {
+    return MAConstants.fromConstant(V);
   }
 
   MetaAddress fromPC(uint64_t PC) const {
@@ -398,8 +458,8 @@ public:
   blocksByPCRange(MetaAddress Start, MetaAddress End);
 
   static MetaAddress getPCFromNewPC(llvm::Instruction *I) {
-    if (llvm::CallInst *NewPCCall = getCallTo(I, "newpc")) {
-      return MetaAddress::fromConstant(NewPCCall->getArgOperand(0));
+    if (llvm::Value *PC = getNewPCArgument(I, 0)) {
+      return MetaAddress::fromConstant(PC);
     } else {
       return MetaAddress::invalid();
     }
@@ -410,6 +470,23 @@ public:
   }
 
 private:
+  using AddressToBlock = std::pair<MetaAddress, llvm::BasicBlock *>;
+
+  /// Sorted array of (address, basic block) pairs, to be built in bulk
+  using AddressToBlockVector = std::vector<AddressToBlock>;
+
+  struct CompareAddress {
+    bool operator()(const AddressToBlock &LHS, const MetaAddress &RHS) const {
+      return LHS.first < RHS;
+    }
+
+    bool operator()(const MetaAddress &LHS, const AddressToBlock &RHS) const {
+      return LHS < RHS.first;
+    }
+  };
+
+private:
+  void initializeJumpTargets();
   void initializePCToBlockCache();
 
 private:
@@ -434,13 +511,10 @@ private:
   }
 
   const llvm::DominatorTree &getDomTree(llvm::Function *F) {
-    auto It = DTMap.find(F);
-    if (It == DTMap.end()) {
-      llvm::DominatorTree &Result = DTMap[F];
-      Result.recalculate(*F);
-      return Result;
-    }
-    return It->second;
+    std::unique_ptr<llvm::DominatorTree> &Result = DTMap[F];
+    if (not Result)
+      Result = std::make_unique<llvm::DominatorTree>(*F);
+    return *Result;
   }
 
 private:
@@ -453,18 +527,18 @@ private:
   llvm::BasicBlock *DispatcherFail;
   llvm::BasicBlock *AnyPC;
   llvm::BasicBlock *UnexpectedPC;
-  std::map<MetaAddress, llvm::BasicBlock *> JumpTargets;
+  AddressToBlockVector JumpTargets;
   unsigned PCRegSize;
   llvm::Function *RootFunction;
   std::vector<llvm::GlobalVariable *> CSVs;
   std::vector<llvm::GlobalVariable *> ABIRegisters;
   std::set<llvm::GlobalVariable *> ABIRegistersSet;
   llvm::StructType *MetaAddressStruct;
+  MetaAddressConstants MAConstants;
   llvm::Function *NewPC;
   std::unique_ptr<ProgramCounterHandler> PCH;
-  using PCToBlockMap = std::multimap<MetaAddress, llvm::BasicBlock *>;
-  PCToBlockMap PCToBlockCache;
-  std::map<llvm::Function *, llvm::DominatorTree> DTMap;
+  AddressToBlockVector PCToBlockCache;
+  llvm::DenseMap<llvm::Function *, std::unique_ptr<llvm::DominatorTree>> DTMap;
 };
 
 template<>
@@ -476,8 +550,9 @@ struct BlackListTrait<const GeneratedCodeBasicInfo &, llvm::BasicBlock *>
   }
 };
 
-/// An analysis pass that computes a \c GCBI result. The result of
-/// this analysis is invalidated each time the analysis is called.
+/// An analysis pass that computes a \c GCBI result. The result is cached by
+/// the analysis manager until a pass fails to preserve it, see
+/// GeneratedCodeBasicInfo::invalidate.
 class GeneratedCodeBasicInfoAnalysis
   : public llvm::AnalysisInfoMixin<GeneratedCodeBasicInfoAnalysis> {
   friend llvm::AnalysisInfoMixin<GeneratedCodeBasicInfoAnalysis>;
@@ -0,0 +1,101 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <memory>
+#include <vector>
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+
+/// \brief A small rewrite performed as part of a ModuleCleanup walk
+///
+/// While the module is being walked, a step can only change the instruction
+/// (or function) it's visiting in place, e.g., by dropping its metadata.
+/// Anything changing the control flow or erasing instructions must be recorded
+/// and performed in finalize.
+class CleanupStep {
+public:
+  virtual ~CleanupStep() = default;
+
+public:
+  /// \return true if the instructions of the function have to be visited
+  virtual bool shouldVisit(llvm::Function &) { return false; }
+
+  /// \brief Called for each visited function, before its instructions
+  virtual void visitFunction(llvm::Function &) {}
+
+  /// \brief Called for each instruction of the visited functions
+  virtual void visitInstruction(llvm::Instruction &) {}
+
+  /// \brief Called once the walk is over
+  ///
+  /// \return true if the module has been changed, either here or during the
+  ///         walk.
+  virtual bool finalize(llvm::Module &) = 0;
+};
+
+/// \brief Run a set of CleanupSteps walking the instructions only once
+///
+/// Each function is visited if at least one step is interested in it, in which
+/// case its instructions are handed, in order, to the interested steps. The
+/// steps are then finalized in the order they have been provided.
+class ModuleCleanup {
+private:
+  std::vector<CleanupStep *> Steps;
+
+public:
+  ModuleCleanup(std::vector<CleanupStep *> Steps) : Steps(std::move(Steps)) {}
+
+public:
+  bool run(llvm::Module &M);
+
+  /// \brief Visit \p F only, then finalize the steps
+  bool run(llvm::Function &F);
+
+private:
+  void visit(llvm::Function &F);
+};
+
+/// \brief Factory for the CleanupSteps that can be used by ModuleCleanupPass
+using CleanupStepFactory = std::unique_ptr<CleanupStep> (*)();
+
+/// \brief Make the CleanupStep created by \p Factory available to
+///        ModuleCleanupPass as \p Name
+void registerCleanupStep(llvm::StringRef Name, CleanupStepFactory Factory);
+
+/// \brief Make \p T available to ModuleCleanupPass as \p Name
+///
+/// Each pass performing a cleanup registers its own step next to its
+/// RegisterPass, using the same name.
+template<typename T>
+struct RegisterCleanupStep {
+  RegisterCleanupStep(llvm::StringRef Name) {
+    registerCleanupStep(Name, []() -> std::unique_ptr<CleanupStep> {
+      return std::make_unique<T>();
+    });
+  }
+};
+
+/// \brief Run the steps selected by `-cleanup-steps` in a single walk
+///
+/// `revng opt --module-cleanup --cleanup-steps=A,B` is equivalent to
+/// `revng opt -A -B`, but visits each instruction once instead of twice.
+class ModuleCleanupPass : public llvm::ModulePass {
+public:
+  static char ID;
+
+public:
+  ModuleCleanupPass() : llvm::ModulePass(ID) {}
+
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
+    AU.setPreservesAll();
+  }
+
+  bool runOnModule(llvm::Module &M) override;
+};
@@ -5,9 +5,9 @@
 //
 
 #include <fstream>
-#include <map>
-#include <set>
+#include <vector>
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Pass.h"
@@ -32,10 +32,12 @@ public:
     AU.setPreservesAll();
   }
 
-  void serialize(std::ostream &Output);
-
-private:
-  bool isNewInstruction(llvm::BasicBlock *BB);
+  /// \brief Write, for each instruction of \p F, the instructions that can be
+  ///        executed right after it, in CSV format
+  ///
+  /// Each edge is emitted once for each CFG edge reaching it from the blocks
+  /// of the instruction. Sources and destinations are sorted by name.
+  void serialize(llvm::Function &F, std::ostream &Output);
 
 private:
   using BasicBlock = llvm::BasicBlock;
@@ -43,7 +45,26 @@ private:
   template<typename T, size_t N>
   using SmallVector = llvm::SmallVector<T, N>;
 
-  using Comparer = CompareByName<BasicBlock>;
-  std::map<BasicBlock *, SmallVector<BasicBlock *, 2>, Comparer> Result;
-  std::set<BasicBlock *> BlackList;
+  /// A strongly connected component of the blocks not starting an instruction
+  struct Component {
+    /// The components reachable from this one, including itself, sorted
+    std::vector<unsigned> Reachable;
+    /// The CFG edges from the component to blocks starting an instruction
+    SmallVector<BasicBlock *, 2> Exits;
+  };
+
+private:
+  static bool isNewInstruction(BasicBlock *BB);
+
+  void condense(llvm::Function &F);
+
+  /// \brief Collect the destinations of the edges leaving \p BB, sorted
+  SmallVector<BasicBlock *, 2> successorsOf(BasicBlock *BB) const;
+
+private:
+  /// Index in Components of the component of each block not starting an
+  /// instruction, except for those preceding the first instruction (i.e., the
+  /// dispatcher), which are never explored
+  llvm::DenseMap<BasicBlock *, unsigned> ComponentOf;
+  std::vector<Component> Components;
 };
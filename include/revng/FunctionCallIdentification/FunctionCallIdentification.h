@@ -4,9 +4,13 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <set>
+#include <vector>
+
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/ValueHandle.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/Casting.h"
 
@@ -24,13 +28,35 @@
 /// terminator instructions identified. The first argument represents the callee
 /// basic block, the second the return basic block and the third the return
 /// address.
+///
+/// The pass can also run incrementally, only inspecting a region of the root
+/// function, e.g., the code translated since the previous run. The markers
+/// emitted by previous runs are preserved.
 class FunctionCallIdentification : public llvm::ModulePass {
 public:
   static char ID;
 
+public:
+  /// \brief State carried across incremental runs
+  struct IncrementalState {
+    /// Fall-through addresses of all the function calls identified so far
+    std::set<MetaAddress> FallthroughAddresses;
+
+    /// Basic blocks looking like function calls, except for their return
+    /// address not having been translated yet. They are inspected again at
+    /// each run.
+    std::vector<llvm::WeakVH> Pending;
+  };
+
 public:
   FunctionCallIdentification() : llvm::ModulePass(ID) {}
 
+  /// \brief Only inspect the basic blocks in \p Region, plus those pending in
+  ///        \p State
+  FunctionCallIdentification(const std::set<llvm::BasicBlock *> &Region,
+                             IncrementalState &State) :
+    llvm::ModulePass(ID), Region(&Region), State(&State) {}
+
   void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
     AU.setPreservesAll();
     AU.addRequired<GeneratedCodeBasicInfoWrapperPass>();
@@ -39,7 +65,7 @@ public:
   bool runOnModule(llvm::Module &M) override;
 
   bool isFallthrough(MetaAddress Address) const {
-    return FallthroughAddresses.count(Address) != 0;
+    return fallthroughAddresses().count(Address) != 0;
   }
 
   bool isFallthrough(llvm::BasicBlock *BB) const {
@@ -54,8 +80,20 @@ public:
 private:
   void buildFilteredCFG(llvm::Function &F);
 
+  std::set<MetaAddress> &fallthroughAddresses() {
+    return State != nullptr ? State->FallthroughAddresses :
+                              FallthroughAddresses;
+  }
+
+  const std::set<MetaAddress> &fallthroughAddresses() const {
+    return State != nullptr ? State->FallthroughAddresses :
+                              FallthroughAddresses;
+  }
+
 private:
   llvm::Function *FunctionCall;
   std::set<MetaAddress> FallthroughAddresses;
   CustomCFG FilteredCFG;
+  const std::set<llvm::BasicBlock *> *Region = nullptr;
+  IncrementalState *State = nullptr;
 };
@@ -25,6 +25,10 @@ public:
   void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
     AU.addRequired<GeneratedCodeBasicInfoWrapperPass>();
     AU.addRequired<FunctionCallIdentification>();
+
+    // GCBI is updated, function calls are untouched
+    AU.addPreserved<GeneratedCodeBasicInfoWrapperPass>();
+    AU.addPreserved<FunctionCallIdentification>();
   }
 
   bool runOnModule(llvm::Module &M) override;
@@ -0,0 +1,36 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/Pass.h"
+
+/// \brief Turn the hot paths of the translated code into superblocks
+///
+/// The branch weights attached by `revng-lift -profile` tell which paths of
+/// the translated code are hot. Along such paths, a basic block often ends
+/// with a jump to a join point, e.g., the jump target following a conditional
+/// jump, that is also reached from colder code. The join point cannot be laid
+/// out, scheduled and register allocated together with its hot predecessor.
+///
+/// This pass copies small hot join points at the end of their hottest
+/// predecessor, provided it jumps there unconditionally and it accounts for
+/// most of their executions. The copy ends with the terminator of the join
+/// point, which is itself a candidate, so that hot paths grow into straight
+/// chains of guest basic blocks. The original join point is kept for the other
+/// predecessors, its branch weights are shared by the copy.
+///
+/// Functions without branch weights are left alone. The growth of each
+/// function is bounded by `-superblock-growth`.
+class FormSuperblocksPass : public llvm::FunctionPass {
+public:
+  static char ID;
+
+public:
+  FormSuperblocksPass();
+
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override;
+
+  bool runOnFunction(llvm::Function &F) override;
+};
@@ -4,16 +4,36 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <map>
+
 #include "llvm/Pass.h"
 
 #include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
 
+/// \brief Inlines the helpers in the `revng_inline` section into the lifted
+///        functions
+///
+/// Each helper is first cloned and its own inlinable callees inlined and
+/// simplified, once. Calls are then inlined from such clones, according to a
+/// cost model taking into account the size of the clone, the estimated
+/// frequency of the call site and how much the caller has already grown.
 class InlineHelpersPass : public llvm::FunctionPass {
 public:
   static char ID;
 
+private:
+  /// Pre-optimized clone of each helper to inline
+  std::map<llvm::Function *, llvm::Function *> Inlinable;
+
+  /// Number of instructions of each pre-optimized clone
+  std::map<llvm::Function *, unsigned> Costs;
+
 public:
   InlineHelpersPass() : FunctionPass(ID) {}
 
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override;
+
+  bool doInitialization(llvm::Module &M) override;
   bool runOnFunction(llvm::Function &F) override;
+  bool doFinalization(llvm::Module &M) override;
 };
@@ -0,0 +1,44 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/Pass.h"
+
+/// \brief Keep a single copy of the isolated functions with identical code
+///
+/// Statically linked binaries often contain several copies of the same
+/// function, e.g., template instantiations or objects linked more than once.
+/// Each one becomes an isolated function, optimized and compiled on its own.
+///
+/// This pass groups the lifted functions by their model prototype and by a
+/// hash of the structure of their code, then compares the candidates
+/// instruction by instruction. Two functions are identical if they only differ
+/// in:
+///
+/// * the arguments of the calls to `newpc`, which only describe the original
+///   instructions;
+/// * the program counter reported in case of an exception;
+/// * the program counter set before jumping to one of their own basic blocks,
+///   provided it has the same offset from the entry of each function.
+///
+/// Any other difference, such as a return address pushed on the stack or the
+/// address of some data, keeps the functions apart: in general, those values
+/// can be observed by the program.
+///
+/// The function with the lowest entry address is kept, the others are replaced
+/// by an alias of it and their model::Function gets the `MergedInto` field
+/// set. As a consequence, the code of a merged function reports the program
+/// counters of the function it has been merged into.
+class MergeIdenticalFunctionsPass : public llvm::ModulePass {
+public:
+  static char ID;
+
+public:
+  MergeIdenticalFunctionsPass() : llvm::ModulePass(ID) {}
+
+  bool runOnModule(llvm::Module &M) override;
+
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override;
+};
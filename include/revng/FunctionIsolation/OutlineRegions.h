@@ -0,0 +1,38 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/Pass.h"
+
+/// \brief Move the translated code of `root` into functions of bounded size
+///
+/// Without function isolation, all the translated code lives in `root`, along
+/// with the dispatcher. Register allocation and scheduling grow super-linearly
+/// with the size of a function, which makes code generation of large binaries
+/// impractical.
+///
+/// This pass computes the strongly connected components of the CFG of `root`
+/// restricted to the translated basic blocks, so that loops are never split,
+/// and packs them in regions of about `-outline-region-size` instructions.
+/// Each region is then given a single entry block, switching on the original
+/// entry that is being reached, and extracted in its own `noinline` function.
+/// The CSVs stay global variables. Edges leaving a region return to `root`,
+/// which takes them, possibly entering another region.
+///
+/// The resulting functions can be handled independently by the code
+/// generator, e.g., in parallel with `-codegen-partitions`.
+///
+/// \note The calls to `function_call` are dropped, since their blockaddresses
+///       would prevent outlining. This pass is therefore meant for the
+///       non-isolated translation only.
+class OutlineRegionsPass : public llvm::ModulePass {
+public:
+  static char ID;
+
+public:
+  OutlineRegionsPass() : llvm::ModulePass(ID) {}
+
+  bool runOnModule(llvm::Module &M) override;
+};
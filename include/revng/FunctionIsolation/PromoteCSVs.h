@@ -19,5 +19,10 @@ public:
 
   void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
     AU.addRequired<GeneratedCodeBasicInfoWrapperPass>();
+
+    // Only the accesses to the CSVs change: the CFG and the type of the basic
+    // blocks are left untouched
+    AU.setPreservesCFG();
+    AU.addPreserved<GeneratedCodeBasicInfoWrapperPass>();
   }
 };
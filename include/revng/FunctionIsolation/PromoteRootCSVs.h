@@ -0,0 +1,37 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/Pass.h"
+
+/// \brief Keep the CSVs of `root` in SSA registers within single-entry regions
+///
+/// Without function isolation, each access to a guest register is a load or a
+/// store of a CSV, since control can reach the dispatcher, and from there any
+/// jump target, at any time. PromoteCSVsPass only handles isolated functions.
+///
+/// This pass splits the translated code of `root` in acyclic single-entry
+/// regions: a translated basic block joins the region of its predecessors
+/// only if all of them are translated and belong to the same region. Jump
+/// targets, loop headers and blocks reached from the dispatcher are therefore
+/// the head of a region.
+///
+/// Within a region, the CSVs are loaded once at its head and kept in SSA
+/// registers. The CSVs written in the region are stored back to the global
+/// variables before each call, e.g., to a helper, and on each edge leaving the
+/// region, e.g., to the dispatcher or to another region. After a call, the
+/// CSVs it might have written are loaded again. A CSV whose address is used in
+/// any other way in a region is left alone in that region.
+class PromoteRootCSVsPass : public llvm::FunctionPass {
+public:
+  static char ID;
+
+public:
+  PromoteRootCSVsPass();
+
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override;
+
+  bool runOnFunction(llvm::Function &F) override;
+};
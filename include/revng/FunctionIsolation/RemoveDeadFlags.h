@@ -0,0 +1,32 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/Pass.h"
+
+/// \brief Remove the stores to the x86 condition code CSVs that are never read
+///
+/// The lifted code updates `cc_op`, `cc_src`, `cc_dst` and `cc_src2` after each
+/// instruction affecting the flags, but most of those values are overwritten
+/// before being read. A liveness analysis on each lifted function detects such
+/// stores and removes them, the computations feeding them can then be removed
+/// by dead code elimination.
+///
+/// As mandated by the x86 ABIs, the flags are considered dead when returning
+/// and when calling another lifted function. Therefore, this pass is meant for
+/// isolated functions, before the CSVs get promoted.
+class RemoveDeadFlagsPass : public llvm::ModulePass {
+public:
+  static char ID;
+
+public:
+  RemoveDeadFlagsPass() : llvm::ModulePass(ID) {}
+
+  bool runOnModule(llvm::Module &M) override;
+
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <memory>
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/IR/Module.h"
+
+/// \brief Split \p M in \p Count shards, that can be optimized independently
+///
+/// The isolated functions are assigned to the shards by call-graph locality:
+/// functions are laid out in depth-first order over the call graph and the
+/// resulting sequence is cut in \p Count pieces of similar size, so that
+/// callers and callees tend to end up in the same shard.
+///
+/// All the local symbols are promoted to hidden external linkage, so that the
+/// shards can be linked together. Global variables, such as the CSVs, belong
+/// to the first shard and are declared by the others. So do the functions
+/// involved with blockaddresses, e.g., root. Small non-isolated functions,
+/// i.e., the helpers, are also imported in each shard as
+/// `available_externally`, so that they can still be inlined.
+///
+/// \note \p M is modified in place and it's not meant to be used afterwards.
+void shardModule(llvm::Module &M,
+                 unsigned Count,
+                 llvm::function_ref<void(std::unique_ptr<llvm::Module>)>
+                   ShardCallback);
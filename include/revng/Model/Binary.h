@@ -223,9 +223,16 @@ struct concrete_types_traits<model::FunctionEdge> {
   using type = std::tuple<model::CallEdge, model::FunctionEdge>;
 };
 
+namespace model {
+
+/// Edges are many and small: store them inline
+using UpcastableFunctionEdge = InlineUpcastablePointer<model::FunctionEdge>;
+
+} // namespace model
+
 template<>
-class llvm::yaml::MappingTraits<UpcastablePointer<model::FunctionEdge>>
-  : public PolymorphicMappingTraits<UpcastablePointer<model::FunctionEdge>> {};
+class llvm::yaml::MappingTraits<model::UpcastableFunctionEdge>
+  : public PolymorphicMappingTraits<model::UpcastableFunctionEdge> {};
 
 template<>
 struct llvm::yaml::MappingTraits<model::FunctionEdge>
@@ -252,18 +259,18 @@ struct KeyedObjectTraits<model::FunctionEdge> {
 };
 
 template<>
-struct KeyedObjectTraits<UpcastablePointer<model::FunctionEdge>> {
+struct KeyedObjectTraits<model::UpcastableFunctionEdge> {
   using Key = model::FunctionEdge::Key;
-  static Key key(const UpcastablePointer<model::FunctionEdge> &Obj) {
+  static Key key(const model::UpcastableFunctionEdge &Obj) {
     return { Obj->Destination, Obj->Type };
   }
 
-  static UpcastablePointer<model::FunctionEdge> fromKey(const Key &Obj) {
-    using ResultType = UpcastablePointer<model::FunctionEdge>;
+  static model::UpcastableFunctionEdge fromKey(const Key &Obj) {
+    using ResultType = model::UpcastableFunctionEdge;
     if (model::FunctionEdgeType::isCall(Obj.second)) {
-      return ResultType(new model::CallEdge(Obj.first, Obj.second));
+      return ResultType::make<model::CallEdge>(Obj.first, Obj.second);
     } else {
-      return ResultType(new model::FunctionEdge(Obj.first, Obj.second));
+      return ResultType::make<model::FunctionEdge>(Obj.first, Obj.second);
     }
   }
 };
@@ -298,7 +305,7 @@ public:
   MetaAddress Start;
   MetaAddress End;
   Identifier CustomName;
-  SortedVector<UpcastablePointer<model::FunctionEdge>> Successors;
+  SortedVector<model::UpcastableFunctionEdge> Successors;
 
 public:
   BasicBlock() : Start(MetaAddress::invalid()) {}
@@ -340,6 +347,9 @@ public:
   FunctionType::Values Type = FunctionType::Invalid;
   SortedVector<model::BasicBlock> CFG;
   TypePath Prototype;
+  /// If valid, the translated code of this function has been merged with the
+  /// identical one of the function at this address
+  MetaAddress MergedInto;
 
 public:
   Function(const MetaAddress &Entry) : Entry(Entry) {}
@@ -356,12 +366,20 @@ public:
 public:
   void dumpCFG() const debug_function;
 };
-INTROSPECTION_NS(model, Function, Entry, CustomName, Type, CFG, Prototype)
+INTROSPECTION_NS(model,
+                 Function,
+                 Entry,
+                 CustomName,
+                 Type,
+                 CFG,
+                 Prototype,
+                 MergedInto)
 
 template<>
 struct llvm::yaml::MappingTraits<model::Function>
   : public TupleLikeMappingTraits<model::Function,
-                                  Fields<model::Function>::CustomName> {};
+                                  Fields<model::Function>::CustomName,
+                                  Fields<model::Function>::MergedInto> {};
 
 template<>
 struct KeyedObjectTraits<model::Function> {
@@ -377,7 +395,12 @@ struct KeyedObjectTraits<model::Function> {
 class model::Binary {
 public:
   SortedVector<model::Function> Functions;
-  SortedVector<UpcastablePointer<model::Type>> Types;
+  HashIndexedSortedVector<UpcastablePointer<model::Type>> Types;
+  /// Set if the lifting ran out of budget before exploring all the code
+  bool PartialLifting = false;
+  /// Fingerprint of the IR and of the options the functions have been
+  /// detected from, empty if unknown
+  std::string AnalysisFingerprint;
 
 public:
   model::TypePath getTypePath(const model::Type *T) {
@@ -399,11 +422,19 @@ public:
   bool verify(bool Assert) const debug_function;
   bool verify(VerifyHelper &VH) const;
 };
-INTROSPECTION_NS(model, Binary, Functions, Types)
+INTROSPECTION_NS(model,
+                 Binary,
+                 Functions,
+                 Types,
+                 PartialLifting,
+                 AnalysisFingerprint)
 
 template<>
 struct llvm::yaml::MappingTraits<model::Binary>
-  : public TupleLikeMappingTraits<model::Binary> {};
+  : public TupleLikeMappingTraits<model::Binary,
+                                  Fields<model::Binary>::PartialLifting,
+                                  Fields<model::Binary>::AnalysisFingerprint> {
+};
 
 static_assert(validateTupleTree<model::Binary>(IsYamlizable),
               "All elements of the model must be YAMLizable");
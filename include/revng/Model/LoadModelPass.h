@@ -8,34 +8,75 @@
 #include "llvm/Pass.h"
 
 #include "revng/Model/Binary.h"
+#include "revng/Model/TupleTreeBinary.h"
 
 inline const char *ModelMetadataName = "revng.model";
 
+/// \brief First operand of the ModelMetadataName tuple when the model is not
+///        embedded in the module, the second one is the path of its file
+inline const char *ModelFileMetadataTag = "revng.model.file";
+
 TupleTree<model::Binary> loadModel(const llvm::Module &M);
 
+class ModelWrapper;
+
+/// \brief Load the model, decoding its functions on demand if possible
+ModelWrapper loadModelWrapper(const llvm::Module &M);
+
 class ModelWrapper {
+public:
+  static constexpr size_t FunctionsIndex = static_cast<size_t>(
+    Fields<model::Binary>::Functions);
+  using LazyFunctions = LazyBinaryField<model::Binary, FunctionsIndex>;
+
 private:
   TupleTree<model::Binary> TheBinary;
   bool HasChanged = false;
 
+  /// If the model has been loaded from its binary encoding, its functions are
+  /// only decoded on demand, until the whole model is requested
+  std::optional<LazyFunctions> Functions;
+  mutable bool FunctionsPending = false;
+
 public:
   ModelWrapper(TupleTree<model::Binary> &&TheBinary) :
     TheBinary(std::move(TheBinary)) {}
 
+  ModelWrapper(TupleTree<model::Binary> &&TheBinary,
+               LazyFunctions &&Functions) :
+    TheBinary(std::move(TheBinary)),
+    Functions(std::move(Functions)),
+    FunctionsPending(true) {}
+
 public:
-  const model::Binary &getReadOnlyModel() const { return *TheBinary; }
+  const model::Binary &getReadOnlyModel() const {
+    materializeFunctions();
+    return *TheBinary;
+  }
 
   TupleTree<model::Binary> &getWriteableModel() {
+    materializeFunctions();
     HasChanged = true;
     return TheBinary;
   }
 
+  /// \brief Get the function at \p Entry, without decoding the others
+  ///
+  /// \return the function, or nullptr if there's no such function.
+  const model::Function *getFunction(const MetaAddress &Entry) const;
+
+  /// \brief Get the entry address of all the functions, without decoding them
+  std::vector<MetaAddress> functionEntries() const;
+
   bool hasChanged() const { return HasChanged; }
 
   template<typename IRUnitT, typename PreservedAnalysesT, typename InvalidatorT>
   bool invalidate(IRUnitT &, const PreservedAnalysesT &, InvalidatorT &) {
     return false;
   }
+
+private:
+  void materializeFunctions() const;
 };
 
 class LoadModelWrapperPass : public llvm::ImmutablePass {
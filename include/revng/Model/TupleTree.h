@@ -5,6 +5,8 @@
 //
 
 #include <array>
+#include <atomic>
+#include <functional>
 #include <set>
 #include <type_traits>
 #include <vector>
@@ -527,6 +529,104 @@ ResultT *getByPath(const TupleTreePath &Path, RootT &M) {
     return GBPV.Result;
 }
 
+//
+// getByPath (with hint)
+//
+namespace tupletree::detail {
+
+template<typename ResultT, typename T>
+ResultT *resolvedAs(T &Element) {
+  if constexpr (std::is_same_v<T, ResultT>)
+    return &Element;
+  else
+    return nullptr;
+}
+
+template<typename ResultT, typename T>
+ResultT *getByPathWithHint(llvm::ArrayRef<TupleTreeKeyWrapper> Path,
+                           T &M,
+                           const void *&Hint);
+
+template<typename ResultT, size_t I = 0, typename T>
+ResultT *getTupleElementWithHint(llvm::ArrayRef<TupleTreeKeyWrapper> Path,
+                                 T &M,
+                                 const void *&Hint) {
+  if constexpr (I < std::tuple_size_v<T>) {
+    if (Path[0].get<size_t>() == I) {
+      auto &Element = get<I>(M);
+      if (Path.size() == 1)
+        return resolvedAs<ResultT>(Element);
+      return getByPathWithHint<ResultT>(Path.slice(1), Element, Hint);
+    } else {
+      return getTupleElementWithHint<ResultT, I + 1>(Path, M, Hint);
+    }
+  } else {
+    return nullptr;
+  }
+}
+
+/// \brief Same as getByPath, but if the last step of \p Path is a lookup in a
+///        SortedVector, try \p Hint before performing a binary search
+///
+/// \p Hint is updated with the element found by the last step. A stale hint is
+/// dereferenced only if it lies within the storage of the container, and it is
+/// used only if its key matches, therefore it's safe to keep it around while
+/// the tree is being mutated.
+template<typename ResultT, typename T>
+ResultT *getByPathWithHint(llvm::ArrayRef<TupleTreeKeyWrapper> Path,
+                           T &M,
+                           const void *&Hint) {
+  if (Path.size() == 0)
+    return nullptr;
+
+  if constexpr (UpcastablePointerLike<T>) {
+    auto Dispatcher = [&](auto &Upcasted) -> ResultT * {
+      return getTupleElementWithHint<ResultT>(Path, Upcasted, Hint);
+    };
+    return upcast(M, Dispatcher, static_cast<ResultT *>(nullptr));
+  } else if constexpr (HasTupleSize<T>) {
+    return getTupleElementWithHint<ResultT>(Path, M, Hint);
+  } else if constexpr (IsKeyedObjectContainer<T>) {
+    using value_type = typename T::value_type;
+    using KOT = KeyedObjectTraits<value_type>;
+    using key_type = decltype(KOT::key(std::declval<value_type>()));
+    const auto &TargetKey = Path[0].get<key_type>();
+    bool IsLast = Path.size() == 1;
+
+    value_type *Matching = nullptr;
+    if constexpr (::detail::IsSortedVector<T>) {
+      if (IsLast and Hint != nullptr and not M.empty()) {
+        value_type *First = &*M.begin();
+        auto *Candidate = static_cast<const value_type *>(Hint);
+        std::less<const value_type *> Less;
+        if (not Less(Candidate, First) and Less(Candidate, First + M.size())
+            and KOT::key(*Candidate) == TargetKey)
+          Matching = First + (Candidate - First);
+      }
+    }
+
+    if (Matching == nullptr) {
+      auto It = M.find(TargetKey);
+      if (It == M.end())
+        return nullptr;
+      Matching = &*It;
+    }
+
+    if (not IsLast)
+      return getByPathWithHint<ResultT>(Path.slice(1), *Matching, Hint);
+
+    Hint = Matching;
+    if constexpr (IsUpcastablePointer<value_type>)
+      return resolvedAs<ResultT>(*Matching->get());
+    else
+      return resolvedAs<ResultT>(*Matching);
+  } else {
+    return nullptr;
+  }
+}
+
+} // namespace tupletree::detail
+
 //
 // pathAsString
 //
@@ -1017,6 +1117,34 @@ public:
   RootT *Root = nullptr;
   TupleTreePath Path;
 
+private:
+  /// The element found by the last lookup, used to skip the binary search of
+  /// the last step of Path. It's validated upon use, see getByPathWithHint.
+  mutable std::atomic<const void *> Hint = nullptr;
+
+public:
+  TupleTreeReference() = default;
+
+  TupleTreeReference(const TupleTreeReference &Other) :
+    Root(Other.Root), Path(Other.Path), Hint(Other.Hint.load()) {}
+
+  TupleTreeReference(TupleTreeReference &&Other) :
+    Root(Other.Root), Path(std::move(Other.Path)), Hint(Other.Hint.load()) {}
+
+  TupleTreeReference &operator=(const TupleTreeReference &Other) {
+    Root = Other.Root;
+    Path = Other.Path;
+    Hint = Other.Hint.load();
+    return *this;
+  }
+
+  TupleTreeReference &operator=(TupleTreeReference &&Other) {
+    Root = Other.Root;
+    Path = std::move(Other.Path);
+    Hint = Other.Hint.load();
+    return *this;
+  }
+
 public:
   static TupleTreeReference fromPath(RootT *Root, const TupleTreePath &Path) {
     TupleTreeReference Result;
@@ -1042,26 +1170,26 @@ public:
 
   const TupleTreePath &path() const { return Path; }
 
-  T *get() {
-    revng_check(Root != nullptr);
+  T *get() { return resolve(); }
 
-    if (Path.size() == 0)
-      return nullptr;
+  const T *get() const { return resolve(); }
 
-    return getByPath<T>(Path, *Root);
+  bool isValid() const {
+    return (*this != TupleTreeReference() and get() != nullptr);
   }
 
-  const T *get() const {
+private:
+  T *resolve() const {
     revng_check(Root != nullptr);
 
     if (Path.size() == 0)
       return nullptr;
 
-    return getByPath<T>(Path, *Root);
-  }
-
-  bool isValid() const {
-    return (*this != TupleTreeReference() and get() != nullptr);
+    const void *LastHint = Hint.load(std::memory_order_relaxed);
+    using tupletree::detail::getByPathWithHint;
+    T *Result = getByPathWithHint<T>(Path.toArrayRef(), *Root, LastHint);
+    Hint.store(LastHint, std::memory_order_relaxed);
+    return Result;
   }
 };
 
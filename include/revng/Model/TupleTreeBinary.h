@@ -0,0 +1,633 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/ErrorOr.h"
+#include "llvm/Support/LEB128.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/ADT/KeyedObjectContainer.h"
+#include "revng/ADT/UpcastablePointer.h"
+#include "revng/Model/TupleTree.h"
+#include "revng/Support/Assert.h"
+#include "revng/Support/YAMLTraits.h"
+
+//
+// Binary encoding of TupleTrees
+//
+// A compact alternative to YAML, driven by the same introspection. YAML remains
+// the human-readable interchange format.
+//
+// The encoding starts with TupleTreeBinaryMagic, followed by a string table
+// (ULEB128 count, then ULEB128 size and bytes of each string) and by the root.
+// Values are encoded as follows:
+//
+// * tuple-likes: ULEB128 number of fields, then, for each field, its ULEB128
+//   index, the ULEB128 size of its encoding and its encoding. Fields with an
+//   unknown index are skipped.
+// * UpcastablePointers: ULEB128 index of the concrete type in
+//   concrete_types_traits plus one (zero for nullptr), then the concrete
+//   tuple-like.
+// * KeyedObjectContainers: ULEB128 number of elements, then, for each element,
+//   the ULEB128 size of the encoding of its key, its key, the ULEB128 size of
+//   its encoding and its encoding. This makes it possible to index the
+//   elements without decoding them (see LazyBinaryField).
+// * other containers: ULEB128 number of elements, then the elements.
+// * integers and enumerations: ULEB128, or SLEB128 if signed.
+// * any other scalar: ULEB128 index in the string table of its YAML scalar
+//   representation.
+//
+
+inline constexpr llvm::StringRef TupleTreeBinaryMagic("\0RTT\1", 5);
+
+/// \brief Does \p Buffer contain a TupleTree in the binary encoding?
+inline bool isBinaryTupleTree(llvm::StringRef Buffer) {
+  return Buffer.startswith(TupleTreeBinaryMagic);
+}
+
+namespace tupletree::detail {
+
+class BinaryWriter {
+private:
+  llvm::StringMap<uint64_t> StringIndices;
+  std::vector<llvm::StringRef> Strings;
+
+public:
+  template<typename T>
+  void writeDocument(llvm::raw_ostream &Stream, const T &Root) {
+    std::string Body;
+    write(Body, Root);
+    writeDocument(Stream, TupleTreeBinaryMagic, Body);
+  }
+
+  /// \brief Emit \p Magic, the string table and \p Body, encoded with write
+  void writeDocument(llvm::raw_ostream &Stream,
+                     llvm::StringRef Magic,
+                     llvm::StringRef Body) {
+    std::string Header = Magic.str();
+    writeULEB(Header, Strings.size());
+    for (llvm::StringRef String : Strings) {
+      writeULEB(Header, String.size());
+      Header.append(String.data(), String.size());
+    }
+
+    Stream << Header << Body;
+  }
+
+public:
+  template<typename T>
+  void write(std::string &Out, const T &Value) {
+    if constexpr (std::is_enum_v<T>) {
+      writeInteger(Out, static_cast<std::underlying_type_t<T>>(Value));
+    } else if constexpr (std::is_integral_v<T>) {
+      writeInteger(Out, Value);
+    } else if constexpr (UpcastablePointerLike<T>) {
+      writeUpcastable(Out, Value);
+    } else if constexpr (IsKeyedObjectContainer<T>) {
+      using KOT = KeyedObjectTraits<typename T::value_type>;
+      writeULEB(Out, Value.size());
+      for (const auto &Element : Value) {
+        writeSized(Out, KOT::key(Element));
+        writeSized(Out, Element);
+      }
+    } else if constexpr (IsContainer<T>) {
+      writeULEB(Out, Value.size());
+      for (const auto &Element : Value)
+        write(Out, Element);
+    } else if constexpr (HasTupleSize<T>) {
+      writeULEB(Out, std::tuple_size_v<T>);
+      writeFields(Out, Value);
+    } else {
+      writeULEB(Out, stringIndex(getNameFromYAMLScalar<T>(Value)));
+    }
+  }
+
+private:
+  template<typename T>
+  static void writeInteger(std::string &Out, T Value) {
+    if constexpr (std::is_signed_v<T>)
+      writeSLEB(Out, Value);
+    else
+      writeULEB(Out, Value);
+  }
+
+  template<typename T, size_t I = 0>
+  void writeUpcastable(std::string &Out, const T &Value) {
+    using concrete_types = concrete_types_traits_t<typename T::element_type>;
+
+    if constexpr (I == 0) {
+      if (Value.get() == nullptr) {
+        writeULEB(Out, 0);
+        return;
+      }
+    }
+
+    if constexpr (I < std::tuple_size_v<concrete_types>) {
+      using type = std::tuple_element_t<I, concrete_types>;
+      if (auto *Upcasted = llvm::dyn_cast<type>(Value.get())) {
+        writeULEB(Out, I + 1);
+        write(Out, *Upcasted);
+      } else {
+        writeUpcastable<T, I + 1>(Out, Value);
+      }
+    } else {
+      revng_abort();
+    }
+  }
+
+  template<size_t I = 0, typename T>
+  void writeFields(std::string &Out, const T &Value) {
+    if constexpr (I < std::tuple_size_v<T>) {
+      writeULEB(Out, I);
+      writeSized(Out, get<I>(Value));
+      writeFields<I + 1>(Out, Value);
+    }
+  }
+
+  template<typename T>
+  void writeSized(std::string &Out, const T &Value) {
+    // Encode the value, then prepend its size
+    size_t Start = Out.size();
+    write(Out, Value);
+    insertULEB(Out, Start, Out.size() - Start);
+  }
+
+  uint64_t stringIndex(const std::string &String) {
+    auto [It, New] = StringIndices.try_emplace(String, Strings.size());
+    if (New)
+      Strings.push_back(It->getKey());
+    return It->second;
+  }
+
+public:
+  static void writeULEB(std::string &Out, uint64_t Value) {
+    uint8_t Buffer[16];
+    unsigned Size = llvm::encodeULEB128(Value, Buffer);
+    Out.append(reinterpret_cast<const char *>(Buffer), Size);
+  }
+
+private:
+  static void writeSLEB(std::string &Out, int64_t Value) {
+    uint8_t Buffer[16];
+    unsigned Size = llvm::encodeSLEB128(Value, Buffer);
+    Out.append(reinterpret_cast<const char *>(Buffer), Size);
+  }
+
+  static void insertULEB(std::string &Out, size_t Position, uint64_t Value) {
+    uint8_t Buffer[16];
+    unsigned Size = llvm::encodeULEB128(Value, Buffer);
+    Out.insert(Position, reinterpret_cast<const char *>(Buffer), Size);
+  }
+};
+
+/// \brief Position of an element of a KeyedObjectContainer in the encoding
+template<typename K>
+struct BinaryIndexEntry {
+  K Key;
+  size_t Offset;
+  size_t Size;
+};
+
+class BinaryReader {
+private:
+  llvm::StringRef Buffer;
+  size_t Offset = 0;
+  std::vector<llvm::StringRef> Strings;
+  bool Failed = false;
+
+public:
+  BinaryReader(llvm::StringRef Buffer) : Buffer(Buffer) {}
+
+  BinaryReader(llvm::StringRef Buffer, llvm::ArrayRef<llvm::StringRef> Strings) :
+    Buffer(Buffer), Strings(Strings.begin(), Strings.end()) {}
+
+public:
+  template<typename T>
+  bool readDocument(T &Root) {
+    if (not readHeader())
+      return false;
+
+    read(Root);
+
+    return not Failed and Offset == Buffer.size();
+  }
+
+  /// \brief Read \p Root, except for its field \p I, whose elements are only
+  ///        recorded in \p Index
+  template<size_t I, typename T, typename K>
+  bool readDocument(T &Root, std::vector<BinaryIndexEntry<K>> &Index) {
+    if (not readHeader())
+      return false;
+
+    uint64_t FieldsCount = readULEB();
+    for (uint64_t J = 0; J < FieldsCount and not Failed; ++J) {
+      uint64_t FieldIndex = readULEB();
+      readSized([&] {
+        if (FieldIndex == I)
+          indexContainer<std::tuple_element_t<I, T>>(Index);
+        else
+          readFieldByIndex(Root, FieldIndex);
+      });
+    }
+
+    return not Failed and Offset == Buffer.size();
+  }
+
+  /// \brief Read \p Value from the \p Size bytes starting at \p Start
+  template<typename T>
+  bool readAt(T &Value, size_t Start, size_t Size) {
+    if (Start > Buffer.size() or Size > Buffer.size() - Start)
+      return false;
+
+    Offset = Start;
+    read(Value);
+
+    return not Failed and Offset == Start + Size;
+  }
+
+  std::vector<llvm::StringRef> takeStrings() { return std::move(Strings); }
+
+public:
+  /// \brief Read \p Magic and the string table
+  bool readHeader(llvm::StringRef Magic = TupleTreeBinaryMagic) {
+    if (not Buffer.startswith(Magic))
+      return false;
+    Offset = Magic.size();
+
+    uint64_t StringsCount = readULEB();
+    for (uint64_t I = 0; I < StringsCount and not Failed; ++I)
+      Strings.push_back(readBytes(readULEB()));
+
+    return not Failed;
+  }
+
+  bool failed() const { return Failed; }
+  void fail() { Failed = true; }
+
+  /// \brief Has the whole buffer been read successfully?
+  bool done() const { return not Failed and Offset == Buffer.size(); }
+
+  template<typename T>
+  void read(T &Value) {
+    if (Failed)
+      return;
+
+    if constexpr (std::is_enum_v<T>) {
+      Value = static_cast<T>(readInteger<std::underlying_type_t<T>>());
+    } else if constexpr (std::is_integral_v<T>) {
+      Value = readInteger<T>();
+    } else if constexpr (UpcastablePointerLike<T>) {
+      readUpcastable(Value, readULEB());
+    } else if constexpr (IsKeyedObjectContainer<T>) {
+      readContainer(Value);
+    } else if constexpr (IsContainer<T>) {
+      uint64_t Count = readULEB();
+      Value.clear();
+      for (uint64_t I = 0; I < Count and not Failed; ++I)
+        read(Value.emplace_back());
+    } else if constexpr (HasTupleSize<T>) {
+      uint64_t FieldsCount = readULEB();
+      for (uint64_t I = 0; I < FieldsCount and not Failed; ++I) {
+        uint64_t Index = readULEB();
+        readSized([&] { readFieldByIndex(Value, Index); });
+      }
+    } else {
+      uint64_t Index = readULEB();
+      if (Index >= Strings.size()) {
+        Failed = true;
+        return;
+      }
+      Value = getValueFromYAMLScalar<T>(Strings[Index]);
+    }
+  }
+
+private:
+  template<typename T>
+  T readInteger() {
+    if constexpr (std::is_signed_v<T>)
+      return static_cast<T>(readSLEB());
+    else
+      return static_cast<T>(readULEB());
+  }
+
+  template<typename T, size_t I = 0>
+  void readUpcastable(T &Value, uint64_t TypeIndex) {
+    using concrete_types = concrete_types_traits_t<typename T::element_type>;
+
+    if constexpr (I == 0) {
+      if (TypeIndex == 0) {
+        Value.reset();
+        return;
+      }
+    }
+
+    if constexpr (I < std::tuple_size_v<concrete_types>) {
+      using type = std::tuple_element_t<I, concrete_types>;
+      if (TypeIndex == I + 1) {
+        // The pointee might be stored inline: don't keep pointers to it
+        // across the assignment
+        Value = T::template make<type>();
+        read(*llvm::cast<type>(Value.get()));
+      } else {
+        readUpcastable<T, I + 1>(Value, TypeIndex);
+      }
+    } else {
+      Failed = true;
+    }
+  }
+
+  template<typename T>
+  void readContainer(T &Value) {
+    using value_type = typename T::value_type;
+    using KOT = KeyedObjectTraits<value_type>;
+    using key_type = decltype(KOT::key(std::declval<value_type>()));
+
+    uint64_t Count = readULEB();
+    if (Failed)
+      return;
+
+    // Keys are only needed to index the elements without decoding them
+    auto SkipKey = [this] { readSized([] {}); };
+
+    if constexpr (::detail::IsSortedVector<T>) {
+      // Decode the elements in place: SortedVector only sorts them once the
+      // batch insertion is over. Each element takes at least a byte.
+      Value.reserve(std::min<uint64_t>(Count, Buffer.size() - Offset));
+      auto Inserter = Value.batch_insert();
+      for (uint64_t I = 0; I < Count and not Failed; ++I) {
+        SkipKey();
+        auto &Element = Inserter.insert(KOT::fromKey(key_type()));
+        readSized([&] { read(Element); });
+      }
+    } else {
+      auto Inserter = Value.batch_insert();
+      for (uint64_t I = 0; I < Count and not Failed; ++I) {
+        SkipKey();
+        value_type Element = KOT::fromKey(key_type());
+        readSized([&] { read(Element); });
+        Inserter.insert(Element);
+      }
+    }
+  }
+
+  template<typename T, typename K>
+  void indexContainer(std::vector<BinaryIndexEntry<K>> &Index) {
+    uint64_t Count = readULEB();
+    if (Failed)
+      return;
+
+    Index.reserve(std::min<uint64_t>(Count, Buffer.size() - Offset));
+    for (uint64_t I = 0; I < Count and not Failed; ++I) {
+      K Key;
+      readSized([&] { read(Key); });
+
+      uint64_t Size = readULEB();
+      if (Failed or Size > Buffer.size() - Offset) {
+        Failed = true;
+        return;
+      }
+
+      Index.push_back({ std::move(Key), Offset, Size });
+      Offset += Size;
+    }
+  }
+
+  /// \brief Run \p Reader on the value prefixed by its ULEB128 size
+  ///
+  /// Whatever \p Reader leaves unread is skipped.
+  template<typename F>
+  void readSized(const F &Reader) {
+    uint64_t Size = readULEB();
+    if (Failed or Size > Buffer.size() - Offset) {
+      Failed = true;
+      return;
+    }
+
+    size_t End = Offset + Size;
+    Reader();
+
+    if (Offset > End)
+      Failed = true;
+    Offset = End;
+  }
+
+  template<size_t I = 0, typename T>
+  void readFieldByIndex(T &Value, uint64_t Index) {
+    if constexpr (I < std::tuple_size_v<T>) {
+      if (Index == I)
+        read(get<I>(Value));
+      else
+        readFieldByIndex<I + 1>(Value, Index);
+    }
+  }
+
+public:
+  uint64_t readULEB() {
+    if (Failed)
+      return 0;
+
+    unsigned Size = 0;
+    const char *Error = nullptr;
+    uint64_t Result = llvm::decodeULEB128(current(), &Size, end(), &Error);
+    Failed = Error != nullptr;
+    Offset += Size;
+    return Result;
+  }
+
+private:
+  int64_t readSLEB() {
+    if (Failed)
+      return 0;
+
+    unsigned Size = 0;
+    const char *Error = nullptr;
+    int64_t Result = llvm::decodeSLEB128(current(), &Size, end(), &Error);
+    Failed = Error != nullptr;
+    Offset += Size;
+    return Result;
+  }
+
+  llvm::StringRef readBytes(uint64_t Size) {
+    if (Failed or Size > Buffer.size() - Offset) {
+      Failed = true;
+      return {};
+    }
+
+    llvm::StringRef Result = Buffer.substr(Offset, Size);
+    Offset += Size;
+    return Result;
+  }
+
+  const uint8_t *current() const {
+    return reinterpret_cast<const uint8_t *>(Buffer.data()) + Offset;
+  }
+
+  const uint8_t *end() const {
+    return reinterpret_cast<const uint8_t *>(Buffer.data()) + Buffer.size();
+  }
+};
+
+} // namespace tupletree::detail
+
+/// \brief Serialize \p Element using the binary encoding
+template<TupleTreeCompatible T>
+void serializeBinary(llvm::raw_ostream &Stream, const T &Element) {
+  tupletree::detail::BinaryWriter Writer;
+  Writer.writeDocument(Stream, Element);
+}
+
+/// \brief Deserialize a TupleTree from its binary encoding
+template<TupleTreeCompatible T>
+llvm::ErrorOr<TupleTree<T>> deserializeBinary(llvm::StringRef Buffer) {
+  TupleTree<T> Result;
+
+  tupletree::detail::BinaryReader Reader(Buffer);
+  if (not Reader.readDocument(*Result))
+    return std::make_error_code(std::errc::illegal_byte_sequence);
+
+  // Update references to root
+  Result.initializeReferences();
+
+  return Result;
+}
+
+/// \brief A KeyedObjectContainer field of a binary-encoded TupleTree whose
+///        elements are decoded on first access
+///
+/// Loading a TupleTree through deserializeBinary(Buffer, Lazy) leaves the field
+/// \p I of the root empty and only records the key and the position of each of
+/// its elements: iterating over the keys is cheap and an element is decoded the
+/// first time it's requested. References pointing into the field cannot be
+/// resolved until it's materialized.
+template<TupleTreeCompatible RootT, size_t I>
+class LazyBinaryField {
+public:
+  using container_type = std::tuple_element_t<I, RootT>;
+  using value_type = typename container_type::value_type;
+  using key_type = std::remove_cvref_t<
+    decltype(KeyedObjectTraits<value_type>::key(std::declval<value_type>()))>;
+
+private:
+  using KOT = KeyedObjectTraits<value_type>;
+  using IndexEntry = tupletree::detail::BinaryIndexEntry<key_type>;
+
+private:
+  std::unique_ptr<const std::string> Data;
+  std::vector<llvm::StringRef> Strings;
+  /// Elements in the order of the encoding, i.e., sorted by key
+  std::vector<IndexEntry> Index;
+  RootT *Root = nullptr;
+  mutable std::vector<std::unique_ptr<value_type>> Decoded;
+
+public:
+  /// \brief Decode \p Buffer into \p TheRoot, except for the field \p I
+  bool load(llvm::StringRef Buffer, RootT &TheRoot) {
+    Data = std::make_unique<const std::string>(Buffer.str());
+    Strings.clear();
+    Index.clear();
+    Decoded.clear();
+    Root = &TheRoot;
+
+    tupletree::detail::BinaryReader Reader(*Data);
+    if (not Reader.template readDocument<I>(TheRoot, Index))
+      return false;
+
+    Strings = Reader.takeStrings();
+    Decoded.resize(Index.size());
+    return true;
+  }
+
+public:
+  size_t size() const { return Index.size(); }
+
+  auto keys() const {
+    return llvm::map_range(Index, [](const IndexEntry &Entry) -> const auto & {
+      return Entry.Key;
+    });
+  }
+
+  bool contains(const key_type &Key) const { return find(Key) != Index.end(); }
+
+  /// \brief Get the element with key \p Key, decoding it if necessary
+  ///
+  /// \return the element, or nullptr if there's no element with such a key.
+  const value_type *get(const key_type &Key) const {
+    auto It = find(Key);
+    if (It == Index.end())
+      return nullptr;
+
+    auto &Result = Decoded[It - Index.begin()];
+    if (not Result) {
+      Result = std::make_unique<value_type>(KOT::fromKey(Key));
+      decode(*It, *Result);
+    }
+
+    return Result.get();
+  }
+
+  /// \brief Decode all the elements into \p Container
+  ///
+  /// Elements returned by get() stay valid, but are not the ones in
+  /// \p Container.
+  void materialize(container_type &Container) const {
+    // Decode in place, the key of the new elements is already the right one
+    auto Inserter = Container.batch_insert();
+    for (const IndexEntry &Entry : Index)
+      decode(Entry, Inserter.insert(KOT::fromKey(Entry.Key)));
+  }
+
+private:
+  auto find(const key_type &Key) const {
+    auto Compare = [](const IndexEntry &Entry, const key_type &Key) {
+      return Entry.Key < Key;
+    };
+    auto It = std::lower_bound(Index.begin(), Index.end(), Key, Compare);
+    if (It != Index.end() and not(It->Key == Key))
+      return Index.end();
+    return It;
+  }
+
+  void decode(const IndexEntry &Entry, value_type &Result) const {
+    tupletree::detail::BinaryReader Reader(*Data, Strings);
+    bool Success = Reader.readAt(Result, Entry.Offset, Entry.Size);
+    revng_check(Success, "Malformed binary TupleTree element");
+
+    // Update references to root
+    auto Visitor = [this](auto &Element) {
+      using type = std::remove_cvref_t<decltype(Element)>;
+      if constexpr (IsTupleTreeReference<type>)
+        Element.Root = Root;
+    };
+    visitTupleTree(Result, Visitor, [](auto &) {});
+  }
+};
+
+/// \brief Deserialize a TupleTree from its binary encoding, leaving one of the
+///        fields of the root to be decoded on demand through \p Lazy
+template<TupleTreeCompatible T, size_t I>
+llvm::ErrorOr<TupleTree<T>>
+deserializeBinary(llvm::StringRef Buffer, LazyBinaryField<T, I> &Lazy) {
+  TupleTree<T> Result;
+
+  if (not Lazy.load(Buffer, *Result))
+    return std::make_error_code(std::errc::illegal_byte_sequence);
+
+  // Update references to root
+  Result.initializeReferences();
+
+  return Result;
+}
@@ -4,6 +4,7 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <memory>
 #include <set>
 #include <vector>
 
@@ -12,6 +13,7 @@
 #include "revng/ADT/KeyedObjectContainer.h"
 #include "revng/ADT/ZipMapIterator.h"
 #include "revng/Model/TupleTree.h"
+#include "revng/Model/TupleTreeHash.h"
 
 template<typename>
 struct is_std_vector : std::false_type {};
@@ -46,6 +48,10 @@ struct TupleTreeDiff {
   std::vector<Change> Changes;
   // TODO: invalidated instances
 
+  /// Values pointed by Changes owned by the diff itself, e.g., if it has been
+  /// deserialized
+  std::vector<std::shared_ptr<void>> Storage;
+
   TupleTreeDiff invert() const {
     TupleTreeDiff Result = *this;
     for (Change &C : Result.Changes) {
@@ -77,20 +83,38 @@ template<typename M>
 struct Diff {
   TupleTreePath Stack;
   TupleTreeDiff<M> Result;
+  TupleTreeHashes &LHSHashes;
+  TupleTreeHashes &RHSHashes;
+
+  Diff(TupleTreeHashes &LHSHashes, TupleTreeHashes &RHSHashes) :
+    LHSHashes(LHSHashes), RHSHashes(RHSHashes) {}
 
   TupleTreeDiff<M> diff(M &LHS, M &RHS) {
-    diffImpl(LHS, RHS);
+    if (not identical(LHS, RHS))
+      diffImpl(LHS, RHS);
     return Result;
   }
 
 private:
+  /// \brief Can we skip the subtrees \p LHS and \p RHS altogether?
+  template<typename T>
+  bool identical(T &LHS, T &RHS) {
+    // Scalars are cheaper to compare than to hash
+    if constexpr (TupleTreeCompatible<T>)
+      return LHSHashes.hash(LHS) == RHSHashes.hash(RHS);
+    else
+      return false;
+  }
+
   template<size_t I = 0, typename T>
   void diffTuple(T &LHS, T &RHS) {
     if constexpr (I < std::tuple_size_v<T>) {
 
-      Stack.push_back(size_t(I));
-      diffImpl(get<I>(LHS), get<I>(RHS));
-      Stack.pop_back();
+      if (not identical(get<I>(LHS), get<I>(RHS))) {
+        Stack.push_back(size_t(I));
+        diffImpl(get<I>(LHS), get<I>(RHS));
+        Stack.pop_back();
+      }
 
       // Recur
       diffTuple<I + 1>(LHS, RHS);
@@ -126,9 +150,14 @@ private:
       } else if (RHSElement == nullptr) {
         // Removed
         Result.remove(Stack, LHSElement);
-      } else {
-        // Identical
-        Stack.push_back(*LHSElement);
+      } else if (not identical(*LHSElement, *RHSElement)) {
+        // Changed
+        if constexpr (IsKeyedObjectContainer<T>) {
+          using KOT = KeyedObjectTraits<typename T::value_type>;
+          Stack.push_back(KOT::key(*LHSElement));
+        } else {
+          Stack.push_back(*LHSElement);
+        }
         diffImpl(*LHSElement, *RHSElement);
         Stack.pop_back();
       }
@@ -144,9 +173,24 @@ private:
 
 } // namespace tupletreediff::detail
 
+/// \brief Compute the differences between \p LHS and \p RHS, reusing the hashes
+///        of their subtrees computed in previous invocations
+///
+/// Useful to diff against the same tree multiple times, as long as it doesn't
+/// change in the meantime: only the subtrees that changed are visited.
+template<typename M>
+TupleTreeDiff<M> diff(M &LHS,
+                      M &RHS,
+                      TupleTreeHashes &LHSHashes,
+                      TupleTreeHashes &RHSHashes) {
+  return tupletreediff::detail::Diff<M>(LHSHashes, RHSHashes).diff(LHS, RHS);
+}
+
 template<typename M>
 TupleTreeDiff<M> diff(M &LHS, M &RHS) {
-  return tupletreediff::detail::Diff<M>().diff(LHS, RHS);
+  TupleTreeHashes LHSHashes;
+  TupleTreeHashes RHSHashes;
+  return diff(LHS, RHS, LHSHashes, RHSHashes);
 }
 
 //
@@ -268,7 +312,7 @@ concept NotIterableOrStdString = not IterableAndNotStdString<T>;
 template<typename T>
 struct ApplyDiffVisitor {
   using Change = typename TupleTreeDiff<T>::Change;
-  const Change *C;
+  llvm::ArrayRef<Change> Changes;
 
   template<typename TupleT, size_t I, typename K>
   void visitTupleElement(K &Element) {
@@ -282,31 +326,76 @@ struct ApplyDiffVisitor {
 
   template<IterableAndNotStdString S>
   void visit(S &M) {
-    revng_assert((C->Old == nullptr) != (C->New == nullptr));
+    // Containers that are not keyed change as a whole
+    if (Changes.front().Old != nullptr and Changes.front().New != nullptr) {
+      revng_assert(Changes.size() == 1);
+      assign(M);
+      return;
+    }
 
     using value_type = typename S::value_type;
     using KOT = KeyedObjectTraits<value_type>;
     using key_type = decltype(KOT::key(std::declval<value_type>()));
 
     size_t OldSize = M.size();
-    if (C->Old != nullptr) {
-      key_type Key = KOT::key(*reinterpret_cast<value_type *>(C->Old));
-      auto End = M.end();
-      auto CompareKeys = [Key](value_type &V) { return KOT::key(V) == Key; };
-      auto FirstToDelete = std::remove_if(M.begin(), End, CompareKeys);
-      M.erase(FirstToDelete, End);
-      revng_assert(OldSize == M.size() + 1);
-    } else if (C->New != nullptr) {
-      // TODO: assert not there already
-      addToContainer(M, *reinterpret_cast<value_type *>(C->New));
-      revng_assert(OldSize == M.size() - 1);
+
+    if constexpr (::detail::IsSortedVector<S>) {
+      // Apply all the changes at once, looking up each key only once
+      std::vector<std::remove_cv_t<key_type>> Removed;
+      std::vector<value_type> Added;
+      for (const Change &C : Changes) {
+        if (C.Old != nullptr)
+          Removed.push_back(KOT::key(*reinterpret_cast<value_type *>(C.Old)));
+        else
+          Added.push_back(*reinterpret_cast<value_type *>(C.New));
+      }
+
+      // Changes built by diff are already sorted
+      auto CompareKeys = [](const value_type &LHS, const value_type &RHS) {
+        return KOT::key(LHS) < KOT::key(RHS);
+      };
+      if (not std::is_sorted(Removed.begin(), Removed.end()))
+        std::sort(Removed.begin(), Removed.end());
+      if (not std::is_sorted(Added.begin(), Added.end(), CompareKeys))
+        std::sort(Added.begin(), Added.end(), CompareKeys);
+
+      size_t AddedCount = Added.size();
+      size_t RemovedCount = M.erase_sorted(Removed);
+      revng_assert(RemovedCount == Removed.size());
+      M.insert_or_assign_sorted(std::move(Added));
+      revng_assert(OldSize - RemovedCount + AddedCount == M.size());
     } else {
-      revng_abort();
+      for (const Change &C : Changes) {
+        OldSize = M.size();
+        if (C.Old != nullptr) {
+          key_type Key = KOT::key(*reinterpret_cast<value_type *>(C.Old));
+          auto End = M.end();
+          auto CompareKeys = [Key](value_type &V) {
+            return KOT::key(V) == Key;
+          };
+          auto FirstToDelete = std::remove_if(M.begin(), End, CompareKeys);
+          M.erase(FirstToDelete, End);
+          revng_assert(OldSize == M.size() + 1);
+        } else if (C.New != nullptr) {
+          // TODO: assert not there already
+          addToContainer(M, *reinterpret_cast<value_type *>(C.New));
+          revng_assert(OldSize == M.size() - 1);
+        } else {
+          revng_abort();
+        }
+      }
     }
   }
 
   template<NotIterableOrStdString S>
   void visit(S &M) {
+    revng_assert(Changes.size() == 1);
+    assign(M);
+  }
+
+  template<typename S>
+  void assign(S &M) {
+    const Change *C = &Changes.front();
     revng_assert(C->Old != nullptr and C->New != nullptr);
     auto *Old = reinterpret_cast<S *>(C->Old);
     auto *New = reinterpret_cast<S *>(C->New);
@@ -319,9 +408,25 @@ struct ApplyDiffVisitor {
 
 template<typename T>
 inline void TupleTreeDiff<T>::apply(T &M) const {
-  TupleTreePath LastPath;
-  for (const Change &C : Changes) {
-    tupletreediff::detail::ApplyDiffVisitor<T> ADV{ &C };
-    callByPath(ADV, C.Path, M);
+  auto IsAddOrRemove = [](const Change &C) {
+    return (C.Old == nullptr) != (C.New == nullptr);
+  };
+
+  // Additions and removals in the same container are consecutive: apply them
+  // together
+  llvm::ArrayRef<Change> Remaining = Changes;
+  while (not Remaining.empty()) {
+    const Change &First = Remaining.front();
+    size_t Count = 1;
+    if (IsAddOrRemove(First)) {
+      while (Count < Remaining.size() and IsAddOrRemove(Remaining[Count])
+             and Remaining[Count].Path == First.Path)
+        ++Count;
+    }
+
+    using namespace tupletreediff::detail;
+    ApplyDiffVisitor<T> ADV{ Remaining.take_front(Count) };
+    callByPath(ADV, First.Path, M);
+    Remaining = Remaining.drop_front(Count);
   }
 }
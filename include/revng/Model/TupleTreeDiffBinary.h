@@ -0,0 +1,299 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <type_traits>
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/ErrorOr.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/ADT/KeyedObjectContainer.h"
+#include "revng/ADT/TupleTreePath.h"
+#include "revng/ADT/UpcastablePointer.h"
+#include "revng/Model/TupleTree.h"
+#include "revng/Model/TupleTreeBinary.h"
+#include "revng/Model/TupleTreeDiff.h"
+
+//
+// Binary encoding of TupleTreeDiffs
+//
+// The encoding starts with TupleTreeDiffBinaryMagic and a string table, as the
+// binary encoding of TupleTrees, followed by the ULEB128 number of changes.
+// Each change is encoded as follows:
+//
+// * the ULEB128 length of its path, followed by its steps: the ULEB128 index of
+//   the field for tuple-likes and the encoding of the key for containers. Each
+//   step through an UpcastablePointer is followed by the ULEB128 index of its
+//   concrete type in concrete_types_traits.
+// * the ULEB128 kind of the change (see BinaryChangeKind), followed by the old
+//   and the new value for changes, by the new element for additions and by the
+//   key of the element for removals.
+//
+// Values are encoded as in the binary encoding of TupleTrees.
+//
+
+inline constexpr llvm::StringRef TupleTreeDiffBinaryMagic("\0RTD\1", 5);
+
+/// \brief Does \p Buffer contain a TupleTreeDiff in the binary encoding?
+inline bool isBinaryTupleTreeDiff(llvm::StringRef Buffer) {
+  return Buffer.startswith(TupleTreeDiffBinaryMagic);
+}
+
+namespace tupletreediff::detail {
+
+enum class BinaryChangeKind : uint64_t { Change, Add, Remove };
+
+template<typename T, typename Tuple, size_t I = 0>
+constexpr uint64_t tupleElementIndex() {
+  static_assert(I < std::tuple_size_v<Tuple>);
+  if constexpr (std::is_same_v<T, std::tuple_element_t<I, Tuple>>)
+    return I;
+  else
+    return tupleElementIndex<T, Tuple, I + 1>();
+}
+
+template<typename RootT>
+class BinaryDiffWriter {
+private:
+  using Change = typename TupleTreeDiff<RootT>::Change;
+  using BinaryWriter = tupletree::detail::BinaryWriter;
+
+private:
+  BinaryWriter &Writer;
+  std::string &Out;
+  const Change &C;
+  size_t Remaining;
+
+public:
+  BinaryDiffWriter(BinaryWriter &Writer, std::string &Out, const Change &C) :
+    Writer(Writer), Out(Out), C(C), Remaining(C.Path.size()) {}
+
+public:
+  template<typename TupleT, size_t I, typename K>
+  void visitTupleElement(K &Element) {
+    BinaryWriter::writeULEB(Out, I);
+    step(Element);
+  }
+
+  template<typename ContainerT, typename KeyT, typename K>
+  void visitContainerElement(KeyT Key, K &Element) {
+    Writer.write(Out, Key);
+    step(Element);
+  }
+
+private:
+  template<typename K>
+  void step(K &Element) {
+    --Remaining;
+    if (Remaining == 0) {
+      writeValues(Element);
+    } else if constexpr (UpcastablePointerLike<K>) {
+      using concrete_types = concrete_types_traits_t<typename K::element_type>;
+      upcast(Element, [this](auto &Upcasted) {
+        using type = std::remove_cvref_t<decltype(Upcasted)>;
+        constexpr auto Index = tupleElementIndex<type, concrete_types>();
+        BinaryWriter::writeULEB(Out, Index);
+      });
+    }
+  }
+
+  template<typename K>
+  void writeValues(K &) {
+    if constexpr (IsKeyedObjectContainer<K>) {
+      using value_type = typename K::value_type;
+      using KOT = KeyedObjectTraits<value_type>;
+      revng_assert((C.Old == nullptr) != (C.New == nullptr));
+
+      if (C.New != nullptr) {
+        writeKind(BinaryChangeKind::Add);
+        Writer.write(Out, *reinterpret_cast<const value_type *>(C.New));
+      } else {
+        writeKind(BinaryChangeKind::Remove);
+        Writer.write(Out, KOT::key(*reinterpret_cast<value_type *>(C.Old)));
+      }
+    } else {
+      revng_assert(C.Old != nullptr and C.New != nullptr);
+      writeKind(BinaryChangeKind::Change);
+      Writer.write(Out, *reinterpret_cast<const K *>(C.Old));
+      Writer.write(Out, *reinterpret_cast<const K *>(C.New));
+    }
+  }
+
+  void writeKind(BinaryChangeKind Kind) {
+    BinaryWriter::writeULEB(Out, static_cast<uint64_t>(Kind));
+  }
+};
+
+template<typename RootT>
+class BinaryDiffReader {
+private:
+  tupletree::detail::BinaryReader &Reader;
+  TupleTreeDiff<RootT> &Result;
+  TupleTreePath Path;
+
+public:
+  BinaryDiffReader(tupletree::detail::BinaryReader &Reader,
+                   TupleTreeDiff<RootT> &Result) :
+    Reader(Reader), Result(Result) {}
+
+public:
+  bool readChange() {
+    Path = TupleTreePath();
+    uint64_t Length = Reader.readULEB();
+    return Length != 0 and readSteps<RootT>(Length);
+  }
+
+private:
+  template<typename T>
+  bool readSteps(uint64_t Remaining) {
+    if (Reader.failed())
+      return false;
+
+    if (Remaining == 0)
+      return readValues<T>();
+
+    if constexpr (UpcastablePointerLike<T>) {
+      using concrete_types = concrete_types_traits_t<typename T::element_type>;
+      return readConcrete<concrete_types>(Reader.readULEB(), Remaining);
+    } else if constexpr (IsKeyedObjectContainer<T>) {
+      using value_type = typename T::value_type;
+      using KOT = KeyedObjectTraits<value_type>;
+      using key_type = decltype(KOT::key(std::declval<value_type>()));
+
+      key_type Key;
+      Reader.read(Key);
+      Path.push_back(Key);
+      return readSteps<value_type>(Remaining - 1);
+    } else if constexpr (HasTupleSize<T>) {
+      uint64_t Index = Reader.readULEB();
+      Path.push_back(size_t(Index));
+      return readField<T>(Index, Remaining - 1);
+    } else {
+      return false;
+    }
+  }
+
+  template<typename Tuple, size_t I = 0>
+  bool readConcrete(uint64_t Index, uint64_t Remaining) {
+    if constexpr (I < std::tuple_size_v<Tuple>) {
+      if (Index == I)
+        return readSteps<std::tuple_element_t<I, Tuple>>(Remaining);
+      else
+        return readConcrete<Tuple, I + 1>(Index, Remaining);
+    } else {
+      return false;
+    }
+  }
+
+  template<typename T, size_t I = 0>
+  bool readField(uint64_t Index, uint64_t Remaining) {
+    if constexpr (I < std::tuple_size_v<T>) {
+      if (Index == I)
+        return readSteps<std::tuple_element_t<I, T>>(Remaining);
+      else
+        return readField<T, I + 1>(Index, Remaining);
+    } else {
+      return false;
+    }
+  }
+
+  template<typename T>
+  bool readValues() {
+    auto Kind = static_cast<BinaryChangeKind>(Reader.readULEB());
+
+    if constexpr (IsKeyedObjectContainer<T>) {
+      using value_type = typename T::value_type;
+      using KOT = KeyedObjectTraits<value_type>;
+      using key_type = decltype(KOT::key(std::declval<value_type>()));
+
+      if (Kind == BinaryChangeKind::Add) {
+        value_type *New = own(KOT::fromKey(key_type()));
+        Reader.read(*New);
+        Result.add(Path, New);
+      } else if (Kind == BinaryChangeKind::Remove) {
+        key_type Key;
+        Reader.read(Key);
+        Result.remove(Path, own(KOT::fromKey(Key)));
+      } else {
+        return false;
+      }
+    } else {
+      if (Kind != BinaryChangeKind::Change)
+        return false;
+
+      T *Old = own(T());
+      T *New = own(T());
+      Reader.read(*Old);
+      Reader.read(*New);
+      Result.change(Path, Old, New);
+    }
+
+    return not Reader.failed();
+  }
+
+  template<typename T>
+  T *own(T &&Value) {
+    auto Owned = std::make_shared<T>(std::move(Value));
+    Result.Storage.push_back(Owned);
+    return Owned.get();
+  }
+};
+
+} // namespace tupletreediff::detail
+
+/// \brief Serialize \p Diff using the binary encoding
+///
+/// \p Base is the tree \p Diff applies to: it determines the concrete type of
+/// the UpcastablePointers in the paths.
+template<TupleTreeCompatible T>
+void serializeBinary(llvm::raw_ostream &Stream,
+                     const TupleTreeDiff<T> &Diff,
+                     T &Base) {
+  using namespace tupletreediff::detail;
+
+  tupletree::detail::BinaryWriter Writer;
+  std::string Body;
+  tupletree::detail::BinaryWriter::writeULEB(Body, Diff.Changes.size());
+  for (const auto &C : Diff.Changes) {
+    revng_assert(C.Path.size() != 0);
+    tupletree::detail::BinaryWriter::writeULEB(Body, C.Path.size());
+    BinaryDiffWriter<T> PathWriter(Writer, Body, C);
+    bool Found = callOnPathSteps(PathWriter, C.Path.toArrayRef(), Base);
+    revng_check(Found, "The diff does not apply to the base tree");
+  }
+
+  Writer.writeDocument(Stream, TupleTreeDiffBinaryMagic, Body);
+}
+
+/// \brief Deserialize a TupleTreeDiff from its binary encoding
+///
+/// The values of the changes are owned by the returned diff.
+template<TupleTreeCompatible T>
+llvm::ErrorOr<TupleTreeDiff<T>> deserializeBinaryDiff(llvm::StringRef Buffer) {
+  using namespace tupletreediff::detail;
+
+  auto Error = std::make_error_code(std::errc::illegal_byte_sequence);
+
+  tupletree::detail::BinaryReader Reader(Buffer);
+  if (not Reader.readHeader(TupleTreeDiffBinaryMagic))
+    return Error;
+
+  TupleTreeDiff<T> Result;
+  BinaryDiffReader<T> DiffReader(Reader, Result);
+  uint64_t Count = Reader.readULEB();
+  for (uint64_t I = 0; I < Count; ++I)
+    if (not DiffReader.readChange())
+      return Error;
+
+  if (not Reader.done())
+    return Error;
+
+  return Result;
+}
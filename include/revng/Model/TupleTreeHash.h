@@ -0,0 +1,90 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <type_traits>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/StringRef.h"
+
+#include "revng/ADT/KeyedObjectContainer.h"
+#include "revng/ADT/TupleTreePath.h"
+#include "revng/ADT/UpcastablePointer.h"
+#include "revng/Model/TupleTree.h"
+#include "revng/Support/YAMLTraits.h"
+
+/// \brief Memoized structural hashes of the nodes of a tuple tree
+///
+/// The hash of a tuple-like, of a container or of an UpcastablePointer combines
+/// the hashes of its children and is computed only once: it's then cached by
+/// the address of the node. Subtrees with different hashes are different,
+/// subtrees with the same hash are considered identical.
+///
+/// The cache is not notified about changes to the tree: it can be used across
+/// multiple queries only as long as the tree does not change, otherwise it has
+/// to be cleared.
+class TupleTreeHashes {
+private:
+  llvm::DenseMap<const void *, uint64_t> Cache;
+
+public:
+  template<typename T>
+  uint64_t hash(const T &Node) {
+    if constexpr (TupleTreeCompatible<T> or IsContainer<T>) {
+      auto It = Cache.find(&Node);
+      if (It != Cache.end())
+        return It->second;
+
+      uint64_t Result = compute(Node);
+      Cache[&Node] = Result;
+      return Result;
+    } else {
+      return compute(Node);
+    }
+  }
+
+  void clear() { Cache.clear(); }
+
+private:
+  template<typename T>
+  uint64_t compute(const T &Node) {
+    if constexpr (std::is_enum_v<T> or std::is_integral_v<T>) {
+      return llvm::hash_value(Node);
+    } else if constexpr (UpcastablePointerLike<T>) {
+      if (Node.get() == nullptr)
+        return 0;
+
+      uint64_t Result = 0;
+      Node.upcast([&](auto &Upcasted) {
+        using type = std::remove_cvref_t<decltype(Upcasted)>;
+        Result = llvm::hash_combine(typeID<type>(), hash(Upcasted));
+      });
+      return Result;
+    } else if constexpr (IsContainer<T>) {
+      llvm::hash_code Result = llvm::hash_value(Node.size());
+      for (const auto &Element : Node)
+        Result = llvm::hash_combine(Result, hash(Element));
+      return Result;
+    } else if constexpr (HasTupleSize<T>) {
+      return computeFields(Node, llvm::hash_value(std::tuple_size_v<T>));
+    } else if constexpr (std::is_convertible_v<const T &, llvm::StringRef>) {
+      return llvm::hash_value(llvm::StringRef(Node));
+    } else {
+      return llvm::hash_value(getNameFromYAMLScalar<T>(Node));
+    }
+  }
+
+  template<size_t I = 0, typename T>
+  uint64_t computeFields(const T &Node, llvm::hash_code Result) {
+    if constexpr (I < std::tuple_size_v<T>) {
+      Result = llvm::hash_combine(Result, hash(get<I>(Node)));
+      return computeFields<I + 1>(Node, Result);
+    } else {
+      return Result;
+    }
+  }
+};
@@ -10,6 +10,10 @@
 #include <optional>
 #include <string>
 
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/Twine.h"
+
 #include "revng/ADT/KeyedObjectTraits.h"
 #include "revng/ADT/RecursiveCoroutine.h"
 #include "revng/ADT/SortedVector.h"
@@ -55,24 +59,42 @@ namespace model {
 extern const std::set<llvm::StringRef> ReservedKeywords;
 
 /// \note Zero-sized identifiers are valid
-class Identifier : public llvm::SmallString<16> {
+///
+/// Identifiers are interned: the characters of each distinct identifier are
+/// stored only once, in a global pool which is never emptied, and an
+/// Identifier just points to them. Copies and equality comparisons take
+/// constant time and the strings they return never dangle.
+class Identifier {
 public:
-  using llvm::SmallString<16>::SmallString;
-  using llvm::SmallString<16>::operator=;
+  using Entry = llvm::StringMapEntry<llvm::NoneType>;
+
+private:
+  /// The interned string, nullptr for the empty identifier
+  const Entry *Interned = nullptr;
 
 public:
   static const Identifier Empty;
 
+public:
+  Identifier() = default;
+  Identifier(llvm::StringRef Name) : Interned(intern(Name)) {}
+  Identifier(const char *Name) : Identifier(llvm::StringRef(Name)) {}
+  Identifier(const std::string &Name) : Identifier(llvm::StringRef(Name)) {}
+  explicit Identifier(const llvm::Twine &Name) {
+    llvm::SmallString<64> Buffer;
+    Interned = intern(Name.toStringRef(Buffer));
+  }
+
 public:
   static Identifier fromString(llvm::StringRef Name) {
     revng_assert(not Name.empty());
-    Identifier Result;
+    std::string Result;
 
     // For reserved C keywords prepend a non-reserved prefix and we're done.
     if (ReservedKeywords.count(Name)) {
       Result += "prefix_";
       Result += Name;
-      return Result;
+      return Identifier(Result);
     }
 
     const auto BecomesUnderscore = [](const char C) {
@@ -91,13 +113,47 @@ public:
       if (not std::isalnum(C))
         C = '_';
 
-    return Result;
+    return Identifier(Result);
+  }
+
+public:
+  llvm::StringRef str() const {
+    return Interned == nullptr ? llvm::StringRef() : Interned->getKey();
+  }
+
+  operator llvm::StringRef() const { return str(); }
+
+  /// \note Interned strings are NUL-terminated
+  const char *c_str() const {
+    return Interned == nullptr ? "" : Interned->getKeyData();
+  }
+
+  const char *data() const { return c_str(); }
+  size_t size() const { return str().size(); }
+  bool empty() const { return Interned == nullptr; }
+
+public:
+  bool operator==(const Identifier &Other) const {
+    return Interned == Other.Interned;
+  }
+
+  bool operator==(llvm::StringRef Other) const { return str() == Other; }
+  bool operator==(const char *Other) const { return str() == Other; }
+  bool operator==(const std::string &Other) const { return str() == Other; }
+
+  std::strong_ordering operator<=>(const Identifier &Other) const {
+    if (Interned == Other.Interned)
+      return std::strong_ordering::equal;
+    return str().compare(Other.str()) <=> 0;
   }
 
 public:
   bool verify() const debug_function;
   bool verify(bool Assert) const debug_function;
   bool verify(VerifyHelper &VH) const;
+
+private:
+  static const Entry *intern(llvm::StringRef Name);
 };
 
 } // namespace model
@@ -5,7 +5,11 @@
 //
 
 #include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <set>
+#include <shared_mutex>
 
 #include "revng/Support/Assert.h"
 
@@ -16,25 +20,49 @@ namespace model {
 
 class VerifyHelper {
 private:
-  std::set<const model::Type *> VerifiedCache;
-  std::map<const model::Type *, uint64_t> SizeCache;
+  /// Memoization shared among all the helpers taking part to the same
+  /// verification, possibly from different threads
+  struct SharedCache {
+    mutable std::shared_mutex Mutex;
+    std::set<const model::Type *> VerifiedCache;
+    std::map<const model::Type *, uint64_t> SizeCache;
+  };
+
+private:
+  std::shared_ptr<SharedCache> Cache;
+  /// Types being verified by this helper, i.e., by this thread
   std::set<const model::Type *> InProgress;
   bool AssertOnFail = false;
 
 public:
-  VerifyHelper() = default;
-  VerifyHelper(bool AssertOnFail) : AssertOnFail(AssertOnFail) {}
+  VerifyHelper() : Cache(std::make_shared<SharedCache>()) {}
+  VerifyHelper(bool AssertOnFail) :
+    Cache(std::make_shared<SharedCache>()), AssertOnFail(AssertOnFail) {}
+
+  VerifyHelper(VerifyHelper &&) = default;
+  VerifyHelper &operator=(VerifyHelper &&) = default;
 
   ~VerifyHelper() { revng_assert(InProgress.size() == 0); }
 
+public:
+  /// \brief Create a helper to be used on another thread, sharing what has been
+  ///        verified so far with this one
+  VerifyHelper fork() const {
+    VerifyHelper Result(AssertOnFail);
+    Result.Cache = Cache;
+    return Result;
+  }
+
 public:
   void setVerified(const model::Type *T) {
-    revng_assert(not isVerified(T));
-    VerifiedCache.insert(T);
+    std::unique_lock Lock(Cache->Mutex);
+    // Another thread might have verified T in the meantime
+    Cache->VerifiedCache.insert(T);
   }
 
   bool isVerified(const model::Type *T) const {
-    return VerifiedCache.count(T) != 0;
+    std::shared_lock Lock(Cache->Mutex);
+    return Cache->VerifiedCache.count(T) != 0;
   }
 
 public:
@@ -44,7 +72,6 @@ public:
 
   void verificationInProgess(const model::Type *T) {
     revng_assert(not isVerificationInProgess(T));
-    revng_assert(not isVerified(T));
     InProgress.insert(T);
   }
 
@@ -55,13 +82,16 @@ public:
 
 public:
   void setSize(const model::Type *T, uint64_t Size) {
-    revng_assert(not size(T));
-    SizeCache[T] = Size;
+    std::unique_lock Lock(Cache->Mutex);
+    // Another thread might have computed the size of T in the meantime
+    auto It = Cache->SizeCache.try_emplace(T, Size).first;
+    revng_assert(It->second == Size);
   }
 
   std::optional<uint64_t> size(const model::Type *T) {
-    auto It = SizeCache.find(T);
-    if (It != SizeCache.end())
+    std::shared_lock Lock(Cache->Mutex);
+    auto It = Cache->SizeCache.find(T);
+    if (It != Cache->SizeCache.end())
       return It->second;
     else
       return {};
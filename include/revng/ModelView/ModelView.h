@@ -0,0 +1,120 @@
+#pragma once
+
+/*
+ * This file is distributed under the MIT License. See LICENSE.md for details.
+ */
+
+/*
+ * C API to inspect a model in the binary TupleTree encoding (see
+ * revng/Model/TupleTreeBinary.h) without decoding it.
+ *
+ * The model file is memory-mapped and values are handled through nodes, i.e.,
+ * the position of their encoding in the file. Containers are indexed the first
+ * time one of their elements is requested, nothing else is ever copied: strings
+ * point into the mapping and stay valid until the model is closed.
+ *
+ * A model handle must not be used by multiple threads at the same time.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct revng_model revng_model;
+
+/* The encoding of a value, relative to the beginning of the model file */
+typedef struct {
+  uint64_t Offset;
+  uint64_t Size;
+} revng_model_node;
+
+typedef struct {
+  const char *Data;
+  size_t Size;
+} revng_model_string;
+
+/* Indices of the fields of the model classes, as in their introspection */
+enum {
+  REVNG_MODEL_BINARY_FUNCTIONS = 0,
+  REVNG_MODEL_BINARY_TYPES = 1,
+  REVNG_MODEL_BINARY_PARTIAL_LIFTING = 2,
+  REVNG_MODEL_BINARY_ANALYSIS_FINGERPRINT = 3,
+
+  REVNG_MODEL_FUNCTION_ENTRY = 0,
+  REVNG_MODEL_FUNCTION_CUSTOM_NAME = 1,
+  REVNG_MODEL_FUNCTION_TYPE = 2,
+  REVNG_MODEL_FUNCTION_CFG = 3,
+  REVNG_MODEL_FUNCTION_PROTOTYPE = 4,
+  REVNG_MODEL_FUNCTION_MERGED_INTO = 5,
+
+  REVNG_MODEL_BASIC_BLOCK_START = 0,
+  REVNG_MODEL_BASIC_BLOCK_END = 1,
+  REVNG_MODEL_BASIC_BLOCK_CUSTOM_NAME = 2,
+  REVNG_MODEL_BASIC_BLOCK_SUCCESSORS = 3,
+
+  REVNG_MODEL_FUNCTION_EDGE_DESTINATION = 0,
+  REVNG_MODEL_FUNCTION_EDGE_TYPE = 1,
+  REVNG_MODEL_CALL_EDGE_PROTOTYPE = 2,
+
+  REVNG_MODEL_TYPE_KIND = 0,
+  REVNG_MODEL_TYPE_ID = 1
+};
+
+/* Map the model in \p Path, NULL if it's not a binary-encoded model */
+revng_model *revng_model_open(const char *Path);
+
+void revng_model_close(revng_model *Model);
+
+/* The model::Binary */
+revng_model_node revng_model_root(const revng_model *Model);
+
+/* Get the field \p Index of the tuple-like \p Node, false if it's missing */
+bool revng_model_field(revng_model *Model,
+                       revng_model_node Node,
+                       uint64_t Index,
+                       revng_model_node *Result);
+
+/* Number of elements of the container \p Node */
+uint64_t revng_model_count(revng_model *Model, revng_model_node Node);
+
+/*
+ * Get the key and the value of the element \p Index of the KeyedObjectContainer
+ * \p Node, false if out of range. \p Key might be NULL.
+ */
+bool revng_model_element(revng_model *Model,
+                         revng_model_node Node,
+                         uint64_t Index,
+                         revng_model_node *Key,
+                         revng_model_node *Value);
+
+/*
+ * Get the concrete type of the UpcastablePointer \p Node, i.e., its index in
+ * concrete_types_traits plus one (zero for nullptr), and the pointee.
+ */
+bool revng_model_upcast(revng_model *Model,
+                        revng_model_node Node,
+                        uint64_t *ConcreteType,
+                        revng_model_node *Value);
+
+/* Decode an unsigned integer or an enumeration */
+bool revng_model_unsigned(revng_model *Model,
+                          revng_model_node Node,
+                          uint64_t *Result);
+
+/* Decode a signed integer */
+bool revng_model_signed(revng_model *Model,
+                        revng_model_node Node,
+                        int64_t *Result);
+
+/* Get the YAML representation of any other scalar, e.g., a MetaAddress */
+bool revng_model_scalar(revng_model *Model,
+                        revng_model_node Node,
+                        revng_model_string *Result);
+
+#ifdef __cplusplus
+}
+#endif
@@ -20,6 +20,7 @@ public:
   void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
     AU.setPreservesAll();
     AU.addRequired<GeneratedCodeBasicInfoWrapperPass>();
+    AU.addRequired<LoadModelWrapperPass>();
     AU.addRequired<StackAnalysis>();
   }
 
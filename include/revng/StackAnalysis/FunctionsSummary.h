@@ -4,9 +4,15 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
-#include <deque>
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iterator>
 #include <map>
-#include <set>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/Optional.h"
 
 #include "revng/Support/Debug.h"
 #include "revng/Support/MetaAddress.h"
@@ -200,7 +206,7 @@ class RegisterArgument {
   friend struct CombineHelper;
 
 public:
-  enum Values { No, NoOrDead, Dead, Yes, Maybe, Contradiction };
+  enum Values : uint8_t { No, NoOrDead, Dead, Yes, Maybe, Contradiction };
 
 private:
   Values Value;
@@ -394,7 +400,7 @@ class FunctionReturnValue {
   friend struct CombineHelper;
 
 public:
-  enum Values { No, NoOrDead, Maybe, Contradiction, YesOrDead };
+  enum Values : uint8_t { No, NoOrDead, Maybe, Contradiction, YesOrDead };
 
 private:
   Values Value;
@@ -477,7 +483,15 @@ class FunctionCallReturnValue {
   friend struct CombineHelper;
 
 public:
-  enum Values { No, NoOrDead, Maybe, Yes, Dead, Contradiction, YesOrDead };
+  enum Values : uint8_t {
+    No,
+    NoOrDead,
+    Maybe,
+    Yes,
+    Dead,
+    Contradiction,
+    YesOrDead
+  };
 
 private:
   Values Value;
@@ -666,7 +680,21 @@ inline V getOrDefault(const std::map<K, V> &Map, K Key) {
 }
 
 /// \brief Class containg the final results about all the analyzed functions
+///
+/// The results are stored in a compact form. Each function and each CSV gets a
+/// dense index, and all the per-function data (basic blocks, register slots,
+/// call sites...) is stored in a handful of flat vectors, grouped by function.
+/// Each function owns a slice of each vector, which starts at the offset
+/// recorded in its FunctionRecord and ends where the one of the next function
+/// starts.
+///
+/// FunctionDescription and CallSiteDescription are lightweight views over this
+/// data. Functions are sorted by entry point and register slots by CSV.
+///
+/// \note Use FunctionsSummaryBuilder to create a FunctionsSummary.
 class FunctionsSummary {
+  friend class FunctionsSummaryBuilder;
+
 public:
   struct FunctionRegisterDescription {
     FunctionRegisterArgument Argument;
@@ -683,46 +711,287 @@ public:
     }
   };
 
-  struct FunctionDescription;
+  class FunctionDescription;
+  class CallSiteDescription;
+
+private:
+  using FRD = FunctionRegisterDescription;
+  using FCRD = FunctionCallRegisterDescription;
+
+  /// \brief A register slot: the index of the CSV and its description
+  template<typename T>
+  using RegisterSlot = std::pair<uint32_t, T>;
 
-  // TODO: this is finalized stuff, should we use vectors/SmalMaps instead of
-  //       maps?
-  struct CallSiteDescription {
-    CallSiteDescription(llvm::Instruction *Call, llvm::Value *Callee) :
-      Call(Call), Callee(Callee) {}
+  using BasicBlockEntry = std::pair<llvm::BasicBlock *, BranchType::Values>;
+  using FakeReturnEntry = std::pair<llvm::BasicBlock *, MetaAddress>;
 
-    llvm::Instruction *Call;
-    llvm::Value *Callee;
+  struct FunctionRecord {
+    llvm::BasicBlock *Entry = nullptr;
+    FunctionType::Values Type = FunctionType::Invalid;
 
-    using GlobalVariable = llvm::GlobalVariable;
+    /// The analysis gave up on this function, the results are conservative
+    bool Degraded = false;
 
-    template<typename K, typename V>
-    using map = std::map<K, V>;
+    // Start of the slices of this function
+    uint32_t BasicBlocksStart = 0;
+    uint32_t RegisterSlotsStart = 0;
+    uint32_t CallSitesStart = 0;
+    uint32_t ClobberedRegistersStart = 0;
+    uint32_t FakeReturnsStart = 0;
+  };
 
-    map<GlobalVariable *, FunctionCallRegisterDescription> RegisterSlots;
+  struct CallSiteRecord {
+    llvm::Instruction *Call = nullptr;
+    llvm::Value *Callee = nullptr;
 
+    /// Start of the slice of CallSiteSlots of this call site
+    uint32_t RegisterSlotsStart = 0;
+  };
+
+private:
+  // Getters turning an element of the flat vectors into what the ranges expose
+
+  template<typename T>
+  struct GetRegisterSlot {
+    static std::pair<llvm::GlobalVariable *, T>
+    get(const FunctionsSummary &Summary, const RegisterSlot<T> &Slot) {
+      return { Summary.CSVs[Slot.first], Slot.second };
+    }
+  };
+
+  struct GetCSV {
+    static llvm::GlobalVariable *
+    get(const FunctionsSummary &Summary, uint32_t Index) {
+      return Summary.CSVs[Index];
+    }
+  };
+
+  struct GetBasicBlock {
+    static BasicBlockEntry
+    get(const FunctionsSummary &, const BasicBlockEntry &Entry) {
+      return Entry;
+    }
+  };
+
+  struct GetFakeReturn {
+    static MetaAddress
+    get(const FunctionsSummary &, const FakeReturnEntry &Entry) {
+      return Entry.second;
+    }
+  };
+
+  struct GetCallSite {
+    static CallSiteDescription
+    get(const FunctionsSummary &Summary, const CallSiteRecord &Record);
+  };
+
+  struct GetFunction {
+    static std::pair<llvm::BasicBlock *, FunctionDescription>
+    get(const FunctionsSummary &Summary, const FunctionRecord &Record);
+  };
+
+public:
+  /// \brief Range over a slice of one of the flat vectors
+  ///
+  /// Getter turns each element into the value exposed to the user, which the
+  /// iterators produce by value.
+  template<typename T, typename Getter>
+  class SliceRange {
+  public:
+    class iterator {
+    public:
+      using iterator_category = std::forward_iterator_tag;
+      using value_type = decltype(Getter::get(std::declval<FunctionsSummary>(),
+                                              std::declval<T>()));
+      using difference_type = std::ptrdiff_t;
+      using pointer = void;
+      using reference = value_type;
+
+    private:
+      const FunctionsSummary *Summary;
+      const T *Current;
+
+    public:
+      iterator(const FunctionsSummary *Summary, const T *Current) :
+        Summary(Summary), Current(Current) {}
+
+    public:
+      value_type operator*() const { return Getter::get(*Summary, *Current); }
+
+      iterator &operator++() {
+        ++Current;
+        return *this;
+      }
+
+      iterator operator++(int) {
+        iterator Result = *this;
+        ++Current;
+        return Result;
+      }
+
+      bool operator==(const iterator &Other) const {
+        return Current == Other.Current;
+      }
+    };
+
+  private:
+    const FunctionsSummary *Summary = nullptr;
+    llvm::ArrayRef<T> Slice;
+
+  public:
+    SliceRange() = default;
+    SliceRange(const FunctionsSummary *Summary, llvm::ArrayRef<T> Slice) :
+      Summary(Summary), Slice(Slice) {}
+
+  public:
+    iterator begin() const { return iterator(Summary, Slice.begin()); }
+    iterator end() const { return iterator(Summary, Slice.end()); }
+    size_t size() const { return Slice.size(); }
+    bool empty() const { return Slice.empty(); }
+  };
+
+  using FunctionSlotsRange = SliceRange<RegisterSlot<FRD>,
+                                        GetRegisterSlot<FRD>>;
+  using CallSiteSlotsRange = SliceRange<RegisterSlot<FCRD>,
+                                        GetRegisterSlot<FCRD>>;
+  using CSVsRange = SliceRange<uint32_t, GetCSV>;
+  using BasicBlocksRange = SliceRange<BasicBlockEntry, GetBasicBlock>;
+  using FakeReturnsRange = SliceRange<FakeReturnEntry, GetFakeReturn>;
+  using CallSitesRange = SliceRange<CallSiteRecord, GetCallSite>;
+  using FunctionsRange = SliceRange<FunctionRecord, GetFunction>;
+
+  /// \brief View over the results about a call site
+  class CallSiteDescription {
+  private:
+    const FunctionsSummary *Summary;
+    const CallSiteRecord *Record;
+
+  public:
+    CallSiteDescription(const FunctionsSummary *Summary,
+                        const CallSiteRecord *Record) :
+      Summary(Summary), Record(Record) {}
+
+  public:
+    llvm::Instruction *call() const { return Record->Call; }
+    llvm::Value *callee() const { return Record->Callee; }
+
+    CallSiteSlotsRange registerSlots() const {
+      return { Summary,
+               slice(Summary->CallSiteSlots,
+                     Record->RegisterSlotsStart,
+                     (Record + 1)->RegisterSlotsStart) };
+    }
+
+    /// \return the first CSV for which this call site is not compatible with
+    ///         \p Function, or nullptr.
     llvm::GlobalVariable *
     isCompatibleWith(const FunctionDescription &Function) const;
   };
 
-  struct FunctionDescription {
-    FunctionDescription() : Function(nullptr), Type(FunctionType::Invalid) {}
-
-    llvm::Value *Function;
-    FunctionType::Values Type;
-    std::map<llvm::BasicBlock *, BranchType::Values> BasicBlocks;
-    // TODO: this should be a vector
-    std::map<llvm::GlobalVariable *, FunctionRegisterDescription> RegisterSlots;
-    std::deque<CallSiteDescription> CallSites;
-    std::set<llvm::GlobalVariable *> ClobberedRegisters;
-    std::multimap<llvm::BasicBlock *, MetaAddress> FakeReturns;
+  /// \brief View over the results about a function
+  class FunctionDescription {
+  private:
+    const FunctionsSummary *Summary;
+    const FunctionRecord *Record;
+
+  public:
+    FunctionDescription(const FunctionsSummary *Summary,
+                        const FunctionRecord *Record) :
+      Summary(Summary), Record(Record) {}
+
+  public:
+    llvm::BasicBlock *entry() const { return Record->Entry; }
+    FunctionType::Values type() const { return Record->Type; }
+    bool degraded() const { return Record->Degraded; }
+
+    BasicBlocksRange basicBlocks() const {
+      return { Summary,
+               slice(Summary->BasicBlocks,
+                     Record->BasicBlocksStart,
+                     (Record + 1)->BasicBlocksStart) };
+    }
+
+    FunctionSlotsRange registerSlots() const {
+      return { Summary,
+               slice(Summary->FunctionSlots,
+                     Record->RegisterSlotsStart,
+                     (Record + 1)->RegisterSlotsStart) };
+    }
+
+    CallSitesRange callSites() const {
+      return { Summary,
+               slice(Summary->CallSites,
+                     Record->CallSitesStart,
+                     (Record + 1)->CallSitesStart) };
+    }
+
+    CSVsRange clobberedRegisters() const {
+      return { Summary,
+               slice(Summary->ClobberedRegisters,
+                     Record->ClobberedRegistersStart,
+                     (Record + 1)->ClobberedRegistersStart) };
+    }
+
+    /// \return the destinations of the fake function return \p BB
+    FakeReturnsRange fakeReturns(llvm::BasicBlock *BB) const {
+      auto All = slice(Summary->FakeReturns,
+                       Record->FakeReturnsStart,
+                       (Record + 1)->FakeReturnsStart);
+      auto Compare = [](const FakeReturnEntry &LHS,
+                        const FakeReturnEntry &RHS) {
+        return std::less<llvm::BasicBlock *>()(LHS.first, RHS.first);
+      };
+      auto Key = FakeReturnEntry(BB, MetaAddress::invalid());
+      auto [Begin, End] = std::equal_range(All.begin(),
+                                           All.end(),
+                                           Key,
+                                           Compare);
+      return { Summary, llvm::ArrayRef<FakeReturnEntry>(Begin, End) };
+    }
   };
 
+private:
+  /// \brief The functions, sorted by entry point, followed by a sentinel
+  std::vector<FunctionRecord> Functions;
+
+  /// \brief All the CSVs mentioned in the summary, sorted
+  std::vector<llvm::GlobalVariable *> CSVs;
+
+  std::vector<BasicBlockEntry> BasicBlocks;
+  std::vector<RegisterSlot<FRD>> FunctionSlots;
+  std::vector<uint32_t> ClobberedRegisters;
+  std::vector<FakeReturnEntry> FakeReturns;
+
+  /// \brief The call sites, grouped by caller, followed by a sentinel
+  std::vector<CallSiteRecord> CallSites;
+  std::vector<RegisterSlot<FCRD>> CallSiteSlots;
+
 public:
-  /// \brief Map from function entry points to its description
-  std::map<llvm::BasicBlock *, FunctionDescription> Functions;
+  FunctionsSummary() : Functions(1), CallSites(1) {}
 
 public:
+  /// \return the number of functions
+  size_t size() const { return Functions.size() - 1; }
+
+  /// \brief All the functions, along with their entry point
+  FunctionsRange functions() const {
+    return { this, slice(Functions, 0, size()) };
+  }
+
+  /// \return the function starting at \p Entry, if any
+  llvm::Optional<FunctionDescription> get(llvm::BasicBlock *Entry) const {
+    auto Begin = Functions.begin();
+    auto End = Begin + size();
+    auto Compare = [](const FunctionRecord &Record, llvm::BasicBlock *Entry) {
+      return std::less<llvm::BasicBlock *>()(Record.Entry, Entry);
+    };
+    auto It = std::lower_bound(Begin, End, Entry, Compare);
+    if (It == End or It->Entry != Entry)
+      return llvm::None;
+
+    return FunctionDescription(this, &*It);
+  }
+
   void dump(const llvm::Module *M) const debug_function { dump(M, dbg); }
 
   /// \brief Dump in JSON format
@@ -776,7 +1045,25 @@ public:
   }
 
 private:
+  template<typename T>
+  static llvm::ArrayRef<T>
+  slice(const std::vector<T> &Vector, uint32_t Start, uint32_t End) {
+    return llvm::ArrayRef<T>(Vector).slice(Start, End - Start);
+  }
+
   void dumpInternal(const llvm::Module *M, StreamWrapperBase &&Stream) const;
 };
 
+inline FunctionsSummary::CallSiteDescription
+FunctionsSummary::GetCallSite::get(const FunctionsSummary &Summary,
+                                   const CallSiteRecord &Record) {
+  return CallSiteDescription(&Summary, &Record);
+}
+
+inline std::pair<llvm::BasicBlock *, FunctionsSummary::FunctionDescription>
+FunctionsSummary::GetFunction::get(const FunctionsSummary &Summary,
+                                   const FunctionRecord &Record) {
+  return { Record.Entry, FunctionDescription(&Summary, &Record) };
+}
+
 } // namespace StackAnalysis
@@ -4,7 +4,7 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
-#include <string>
+#include <ostream>
 
 #include "llvm/Pass.h"
 
@@ -15,8 +15,6 @@
 
 namespace StackAnalysis {
 
-extern const std::set<llvm::GlobalVariable *> EmptyCSVSet;
-
 class StackAnalysis : public llvm::ModulePass {
   friend class FunctionBoundariesDetectionPass;
 
@@ -34,22 +32,37 @@ public:
 
   bool runOnModule(llvm::Module &M) override;
 
-  const std::set<llvm::GlobalVariable *> &
-  getClobbered(llvm::BasicBlock *Function) const {
-    auto It = GrandResult.Functions.find(Function);
-    if (It == GrandResult.Functions.end())
-      return EmptyCSVSet;
+  FunctionsSummary::CSVsRange getClobbered(llvm::BasicBlock *Function) const {
+    if (auto Description = GrandResult.get(Function))
+      return Description->clobberedRegisters();
     else
-      return It->second.ClobberedRegisters;
+      return {};
   }
 
-  void serialize(std::ostream &Output) { Output << TextRepresentation; }
+  void serialize(const llvm::Module *M, std::ostream &Output) const {
+    GrandResult.dump(M, Output);
+  }
 
   void serializeMetadata(llvm::Function &F, GeneratedCodeBasicInfo &GCBI);
 
+  /// \brief Were the functions in the model already up to date?
+  ///
+  /// If so, the analysis has been skipped and GrandResult is empty.
+  bool upToDate() const { return UpToDate; }
+
+  /// \brief Record in \p TheBinary that its functions have been detected from
+  ///        the current IR of \p M, with the current options
+  ///
+  /// The next run of the analysis on the same IR, with the same options, will
+  /// be skipped.
+  static void recordFingerprint(const llvm::Module &M,
+                                model::Binary &TheBinary);
+
 public:
   FunctionsSummary GrandResult;
-  std::string TextRepresentation;
+
+private:
+  bool UpToDate = false;
 };
 
 } // namespace StackAnalysis
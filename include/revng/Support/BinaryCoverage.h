@@ -0,0 +1,135 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/ErrorOr.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Support/MetaAddress.h"
+
+/// \brief Compact, memory-mappable representation of the translated code
+///
+/// The file is composed by, in order:
+///
+/// * a FileHeader (32 bytes);
+/// * `RecordsCount` instruction records (32 bytes each), sorted by
+///   MetaAddress;
+/// * `BitmapsCount` bitmaps: a bitmap header (32 bytes) followed by one bit
+///   for each byte of the segment, set if it's part of a translated
+///   instruction, padded to a multiple of 64 bits.
+///
+/// All the fields are little endian and each section is 8-bytes aligned,
+/// therefore the reader can access the records directly from the mapped file.
+namespace BinaryCoverage {
+
+/// "RVNGCOV" followed by a NUL character, read as a little endian integer
+constexpr uint64_t Magic = 0x00564F43474E5652;
+constexpr uint32_t Version = 1;
+constexpr uint32_t HeaderSize = 32;
+constexpr uint32_t RecordSize = 32;
+constexpr uint32_t BitmapHeaderSize = 32;
+
+/// \brief A translated instruction
+struct Instruction {
+  MetaAddress Address;
+  uint64_t Size;
+  bool IsJumpTarget;
+
+  /// \note \p Other has to have the same type and epoch
+  bool contains(const MetaAddress &Other) const {
+    return Address.addressIsComparableWith(Other)
+           and Address.type() == Other.type()
+           and Address.epoch() == Other.epoch()
+           and Other.address() - Address.address() < Size;
+  }
+};
+
+/// \brief Collects the translated instructions and serializes them
+class Writer {
+private:
+  struct Segment {
+    MetaAddress Start;
+    uint64_t Size;
+  };
+
+private:
+  std::vector<Instruction> Instructions;
+  std::vector<Segment> Segments;
+
+public:
+  void addInstruction(MetaAddress Address, uint64_t Size, bool IsJumpTarget) {
+    Instructions.push_back({ Address, Size, IsJumpTarget });
+  }
+
+  /// \brief Emit a bitmap for the \p Size bytes starting at \p Start
+  void addSegment(MetaAddress Start, uint64_t Size) {
+    revng_assert(Start.isValid());
+    Segments.push_back({ Start, Size });
+  }
+
+public:
+  void write(llvm::raw_ostream &Output);
+  std::error_code write(llvm::StringRef Path);
+};
+
+/// \brief Read-only view on a binary coverage file
+///
+/// The file is memory-mapped, records are decoded on access.
+class Reader {
+private:
+  struct Bitmap {
+    MetaAddress Start;
+    uint64_t Size;
+    const uint8_t *Bits;
+  };
+
+private:
+  std::unique_ptr<llvm::MemoryBuffer> Buffer;
+  const uint8_t *Records = nullptr;
+  uint64_t RecordsCount = 0;
+  uint32_t Stride = RecordSize;
+  std::vector<Bitmap> Bitmaps;
+
+private:
+  Reader() = default;
+
+public:
+  static llvm::ErrorOr<Reader> open(llvm::StringRef Path);
+  static llvm::ErrorOr<Reader>
+  fromBuffer(std::unique_ptr<llvm::MemoryBuffer> Buffer);
+
+public:
+  size_t size() const { return RecordsCount; }
+  bool empty() const { return RecordsCount == 0; }
+  size_t bitmapsCount() const { return Bitmaps.size(); }
+
+  /// \return the start and the size of the bytes covered by the \p Index-th
+  ///         bitmap
+  std::pair<MetaAddress, uint64_t> bitmapRange(size_t Index) const {
+    return { Bitmaps[Index].Start, Bitmaps[Index].Size };
+  }
+
+  Instruction operator[](size_t Index) const;
+
+  /// \return the instruction containing \p Address, if any
+  llvm::Optional<Instruction> find(const MetaAddress &Address) const;
+
+  /// \brief Is \p Address part of a translated instruction?
+  ///
+  /// \note Bitmaps do not distinguish between the types of code, e.g., ARM
+  ///       and Thumb, therefore, if \p Address falls in a bitmap, the result
+  ///       only depends on its address.
+  bool isCovered(const MetaAddress &Address) const;
+};
+
+} // namespace BinaryCoverage
@@ -23,6 +23,15 @@ extern size_t MaxLoggerNameLength;
 
 #define debug_function __attribute__((used, noinline))
 
+/// \brief Maximum verbosity of the log statements compiled in
+///
+/// * 0: all the logging is stripped, loggers are never enabled;
+/// * 1: revng_log_verbose statements are stripped;
+/// * 2: everything is compiled in.
+#ifndef REVNG_MAX_LOG_LEVEL
+#define REVNG_MAX_LOG_LEVEL 2
+#endif
+
 /// \brief Stream an instance of this class to call Logger::emit()
 struct LogTerminator {
   const char *File;
@@ -47,7 +56,9 @@ public:
   void unindent(unsigned Level = 1);
   void setIndentation(unsigned Level);
 
-  bool isEnabled() const { return StaticEnabled && Enabled; }
+  bool isEnabled() const {
+    return REVNG_MAX_LOG_LEVEL > 0 && StaticEnabled && Enabled;
+  }
   llvm::StringRef name() const { return Name; }
   // TODO: allow optional description
   llvm::StringRef description() const { return ""; }
@@ -65,9 +76,12 @@ public:
   /// MyLogger << DoLog;
   void flush(const LogTerminator &LineInfo = LogTerminator{ "", 0 });
 
+  /// \note Disabled loggers do not even invoke writeToLog, which might be
+  ///       costly, e.g., computing the name of an llvm::Value.
   template<typename T>
-  inline Logger &operator<<(const T Other) {
-    writeToLog(*this, Other, static_cast<int>(0));
+  inline Logger &operator<<(const T &Other) {
+    if (isEnabled())
+      writeToLog(*this, Other, static_cast<int>(0));
     return *this;
   }
 
@@ -158,6 +172,14 @@ public:
 
   size_t size() const { return Loggers.size(); }
 
+  /// \brief Return true if at least one of the loggers is enabled
+  bool anyEnabled() const {
+    for (Logger<true> *L : Loggers)
+      if (L->isEnabled())
+        return true;
+    return false;
+  }
+
   void enable(llvm::StringRef Name) {
     for (Logger<true> *L : Loggers) {
       if (L->name() == Name) {
@@ -271,6 +293,7 @@ private:
   bool Enabled;
 };
 
+/// \brief Emit a log line, evaluating \p Expr only if \p Logger is enabled
 #define revng_log(Logger, Expr)  \
   do {                           \
     if (Logger.isEnabled()) {    \
@@ -278,6 +301,30 @@ private:
     }                            \
   } while (0)
 
+/// \brief Like revng_log, but stripped if REVNG_MAX_LOG_LEVEL is lower than 2
+///
+/// Use this for the messages emitted in hot loops, e.g., once per instruction.
+#if REVNG_MAX_LOG_LEVEL >= 2
+#define revng_log_verbose(Logger, Expr) revng_log(Logger, Expr)
+#else
+#define revng_log_verbose(Logger, Expr) \
+  do {                                  \
+    if (false) {                        \
+      (Logger) << Expr << DoLog;        \
+    }                                   \
+  } while (0)
+#endif
+
+/// \brief Invoke \p Callback with \p Logger, only if it's enabled
+///
+/// Useful to log information requiring some computation or multiple lines, in
+/// place of an explicit isEnabled() check.
+template<bool X, typename CallbackT>
+inline void logLazily(Logger<X> &TheLogger, CallbackT &&Callback) {
+  if (TheLogger.isEnabled())
+    Callback(TheLogger);
+}
+
 extern Logger<> NRALog;
 extern Logger<> PassesLog;
 extern Logger<> ReleaseLog;
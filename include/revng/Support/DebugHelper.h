@@ -8,9 +8,12 @@
 #include <ostream>
 #include <string>
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Optional.h"
 #include "llvm/IR/AssemblyAnnotationWriter.h"
 #include "llvm/IR/DIBuilder.h"
 
+#include "revng/Support/DebugStrings.h"
 #include "revng/Support/revng.h"
 
 namespace llvm {
@@ -37,6 +40,10 @@ enum Values {
 
 } // namespace DebugInfoType
 
+/// \brief Comments to print before each instruction, see DebugAnnotationWriter
+using InstructionAnnotations = llvm::DenseMap<const llvm::Instruction *,
+                                              std::string>;
+
 /// \brief AssemblyAnnotationWriter decorating the output withe debug
 ///        information
 ///
@@ -55,10 +62,13 @@ public:
   ///          created and run to produce an output without errors.
   ///
   /// \param Context the LLVM context.
-  /// \param Scope the scope, typically a `DISubprogram`.
   /// \param DebugInfo whether to decorate the IR being serialized with debug
   ///        metadata refering to the produce IR itself or not.
-  DebugAnnotationWriter(llvm::LLVMContext &Context, bool DebugInfo);
+  /// \param Annotations the comments containing the original assembly and
+  ///        the PTC of each instruction, see DebugHelper::annotations.
+  DebugAnnotationWriter(llvm::LLVMContext &Context,
+                        bool DebugInfo,
+                        const InstructionAnnotations &Annotations);
 
   virtual void
   emitInstructionAnnot(const llvm::Instruction *TheInstruction,
@@ -66,8 +76,7 @@ public:
 
 private:
   llvm::LLVMContext &Context;
-  unsigned OriginalInstrMDKind;
-  unsigned PTCInstrMDKind;
+  const InstructionAnnotations &Annotations;
   unsigned DbgMDKind;
   bool DebugInfo;
 };
@@ -82,7 +91,9 @@ public:
   /// \param Debug path where the debug output should be stored. If empty, \p
   ///        Output will be used along with a suffix, e.g. `.pts` if \p Type is
   ///        DebugInfoType::PTC, `.S` if it's DebugInfoType::OriginalAssembly or
-  ///        will match \p Output if \p Type is DebugInfoType::LLVMIR.
+  ///        will match \p Output if \p Type is DebugInfoType::LLVMIR. If \p
+  ///        Output is a bitcode file (`.bc`), the textual LLVM IR goes to \p
+  ///        Output with the `.ll` suffix.
   /// \param TheModule the LLVM module to print out.
   DebugHelper(std::string Output,
               llvm::Module *TheModule,
@@ -99,6 +110,10 @@ public:
   /// Copy the debug file to the output path, if they are the same
   bool copySource();
 
+  /// Memory-map the side file containing the strings referenced by
+  /// identifier in the metadata (see DebugStrings)
+  void loadStrings(llvm::StringRef Path);
+
 private:
   /// Create a new AssemblyAnnotationWriter
   ///
@@ -106,12 +121,25 @@ private:
   ///        information referred to itself or not.
   DebugAnnotationWriter *annotator(bool DebugInfo);
 
+  /// \brief The comments to print before the instructions of the root and the
+  ///        isolated functions
+  ///
+  /// The comments are collected the first time, on multiple threads, and
+  /// reused by all the following printings of the module.
+  const InstructionAnnotations &annotations();
+
+  const DebugStrings::Reader *strings() const {
+    return Strings ? &*Strings : nullptr;
+  }
+
 private:
   std::string OutputPath;
   llvm::DIBuilder Builder;
   llvm::Module *TheModule;
   llvm::DICompileUnit *CompileUnit;
   std::unique_ptr<DebugAnnotationWriter> Annotator;
+  llvm::Optional<InstructionAnnotations> Annotations;
+  llvm::Optional<DebugStrings::Reader> Strings;
 
   unsigned OriginalInstrMDKind;
   unsigned PTCInstrMDKind;
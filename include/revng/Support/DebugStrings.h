@@ -0,0 +1,94 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/ErrorOr.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+/// \brief Side file containing the debug strings of the lifted instructions
+///
+/// The original assembly and the PTC of each instruction can be recorded in
+/// the metadata attached to the lifted code. On large binaries, keeping all of
+/// them in the module is expensive, therefore they can be moved to a side file
+/// and, in the IR, replaced by an integer identifier.
+///
+/// The file is composed by, in order:
+///
+/// * a header: the magic number, the version, 32 bits of padding and the
+///   number of strings, `Count`;
+/// * `Count + 1` offsets, where the string with identifier `I` starts at the
+///   `I`-th offset and ends at the next one;
+/// * the content of all the strings.
+///
+/// All the fields are 64-bits little endian integers, offsets are relative to
+/// the beginning of the content of the strings.
+namespace DebugStrings {
+
+/// "RVNGDBS" followed by a NUL character, read as a little endian integer
+constexpr uint64_t Magic = 0x00534244474E5652;
+constexpr uint32_t Version = 1;
+constexpr uint64_t HeaderSize = 24;
+
+/// \brief Assigns identifiers to the strings and serializes them
+///
+/// Identical strings get the same identifier.
+class Writer {
+private:
+  llvm::StringMap<uint64_t> Identifiers;
+  std::vector<uint64_t> Offsets;
+  std::string Content;
+
+public:
+  /// \return the identifier of \p String
+  uint64_t add(llvm::StringRef String) {
+    auto [It, New] = Identifiers.try_emplace(String, Offsets.size());
+    if (New) {
+      Offsets.push_back(Content.size());
+      Content += String;
+    }
+    return It->second;
+  }
+
+  size_t size() const { return Offsets.size(); }
+
+public:
+  void write(llvm::raw_ostream &Output) const;
+  std::error_code write(llvm::StringRef Path) const;
+};
+
+/// \brief Read-only view on a memory-mapped debug strings file
+class Reader {
+private:
+  std::unique_ptr<llvm::MemoryBuffer> Buffer;
+  const uint8_t *Offsets = nullptr;
+  const char *Content = nullptr;
+  uint64_t Count = 0;
+
+private:
+  Reader() = default;
+
+public:
+  static llvm::ErrorOr<Reader> open(llvm::StringRef Path);
+  static llvm::ErrorOr<Reader>
+  fromBuffer(std::unique_ptr<llvm::MemoryBuffer> Buffer);
+
+public:
+  size_t size() const { return Count; }
+
+  /// \return the string with identifier \p Identifier, or an empty string if
+  ///         there's no such string
+  llvm::StringRef get(uint64_t Identifier) const;
+};
+
+} // namespace DebugStrings
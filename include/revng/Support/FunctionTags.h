@@ -4,9 +4,15 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <array>
+#include <bitset>
 #include <set>
+#include <vector>
 
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/IR/Module.h"
 
@@ -20,13 +26,20 @@ namespace FunctionTags {
 
 class Tag;
 
+/// Maximum number of tags that can be registered
+inline constexpr unsigned MaxTags = 64;
+
+/// \brief A set of tags, represented as a bitset indexed by the tag ID
 class TagsSet {
 private:
-  std::set<const Tag *> Tags;
+  std::bitset<MaxTags> Tags;
 
 public:
   TagsSet() {}
-  TagsSet(std::initializer_list<const Tag *> I) : Tags{ I } {}
+  TagsSet(std::initializer_list<const Tag *> I) {
+    for (const Tag *T : I)
+      insert(T);
+  }
 
 public:
   static TagsSet from(const llvm::Instruction *I);
@@ -34,23 +47,42 @@ public:
   static TagsSet from(const llvm::MDNode *MD);
 
 public:
-  bool contains(const Tag &T) const { return Tags.count(&T) != 0; }
+  bool contains(const Tag &T) const;
+  bool empty() const { return Tags.none(); }
+
+  /// \brief Return true if all the tags in \p Other are in this set
+  bool includes(const TagsSet &Other) const {
+    return (Tags & Other.Tags) == Other.Tags;
+  }
+
+  /// \brief The tags in the set, sorted by ID
+  llvm::SmallVector<const Tag *, 4> tags() const;
 
 public:
   template<typename T>
   void addTo(T *I) const;
 
 public:
-  void insert(const Tag *T) { Tags.insert(T); }
+  void insert(const Tag *T);
 };
 
 class Tag {
 private:
   llvm::StringRef Name;
 
+  /// Index of the tag in the registry, assigned at construction time
+  unsigned ID;
+
 public:
   Tag(llvm::StringRef Name);
 
+public:
+  llvm::StringRef name() const { return Name; }
+  unsigned id() const { return ID; }
+
+  /// \brief Get the tag registered with ID \p ID
+  static const Tag &fromID(unsigned ID);
+
 public:
   void addTo(llvm::Instruction *I) const;
   void addTo(llvm::GlobalObject *G) const;
@@ -74,13 +106,81 @@ public:
   }
 };
 
+inline bool TagsSet::contains(const Tag &T) const {
+  return Tags.test(T.id());
+}
+
+inline void TagsSet::insert(const Tag *T) {
+  Tags.set(T->id());
+}
+
 template<typename T>
 void TagsSet::addTo(T *I) const {
   // TODO: inefficient
-  for (const Tag *TheTag : Tags)
+  for (const Tag *TheTag : tags())
     TheTag->addTo(I);
 }
 
+/// \brief Index of the tags of the global objects of a module
+///
+/// The tags of all the global objects are decoded once, in bulk, at
+/// construction time. Then, querying the tags of an object costs a lookup and
+/// enumerating the objects with a certain tag does not involve inspecting the
+/// rest of the module.
+///
+/// Tags added through add() are also attached to the object. Users tagging,
+/// creating or erasing global objects by other means are responsible for
+/// calling update() or forget().
+class TagsIndex {
+private:
+  llvm::DenseMap<const llvm::GlobalObject *, TagsSet> Tags;
+
+  /// For each tag ID, the objects having such tag, in module order
+  std::array<std::vector<llvm::GlobalObject *>, MaxTags> Objects;
+
+public:
+  TagsIndex(llvm::Module &M);
+
+public:
+  TagsSet tags(const llvm::GlobalObject *G) const {
+    auto It = Tags.find(G);
+    return It == Tags.end() ? TagsSet() : It->second;
+  }
+
+  bool has(const Tag &T, const llvm::GlobalObject *G) const {
+    return tags(G).contains(T);
+  }
+
+  /// \note Adding \p T to an object invalidates the returned range
+  llvm::ArrayRef<llvm::GlobalObject *> objects(const Tag &T) const {
+    return Objects[T.id()];
+  }
+
+  auto functions(const Tag &T) const {
+    using namespace llvm;
+    auto IsFunction = [](GlobalObject *G) { return isa<Function>(G); };
+    auto ToFunction = [](GlobalObject *G) { return cast<Function>(G); };
+    return map_range(make_filter_range(objects(T), IsFunction), ToFunction);
+  }
+
+  auto globals(const Tag &T) const {
+    using namespace llvm;
+    auto IsGlobal = [](GlobalObject *G) { return isa<GlobalVariable>(G); };
+    auto ToGlobal = [](GlobalObject *G) { return cast<GlobalVariable>(G); };
+    return map_range(make_filter_range(objects(T), IsGlobal), ToGlobal);
+  }
+
+public:
+  /// \brief Attach \p T to \p G and record it
+  void add(const Tag &T, llvm::GlobalObject *G);
+
+  /// \brief Decode again the tags attached to \p G
+  void update(llvm::GlobalObject *G);
+
+  /// \brief Drop \p G from the index, e.g., before erasing it
+  void forget(llvm::GlobalObject *G);
+};
+
 extern Tag QEMU;
 extern Tag Helper;
 extern Tag Lifted;
@@ -91,5 +191,6 @@ extern Tag FunctionDispatcher;
 extern Tag Root;
 extern Tag CSVsAsArgumentsWrapper;
 extern Tag Marker;
+extern Tag IndirectPlaceholder;
 
 } // namespace FunctionTags
@@ -153,10 +153,10 @@ public:
   generator &operator=(const generator &other) = delete;
 
   ~generator() {
-    if (m_coroutine) {
-      revng_assert(m_coroutine.done());
+    // The consumer might stop before the end: destroying a suspended
+    // coroutine also destroys its local variables
+    if (m_coroutine)
       m_coroutine.destroy();
-    }
   }
 
   generator &operator=(generator &&other) noexcept {
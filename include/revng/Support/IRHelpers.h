@@ -9,6 +9,8 @@
 #include <sstream>
 #include <type_traits>
 
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/iterator_range.h"
 #include "llvm/Analysis/ConstantFolding.h"
@@ -247,6 +249,46 @@ struct IteratorDirection<false> {
   }
 };
 
+/// \brief A set of the basic blocks of a function, reusable across visits
+///
+/// Each block gets a number the first time it's inserted, and the set is a bit
+/// vector indexed by such number. Clearing the set keeps the numbering and the
+/// storage, so that, once warmed up, visits don't allocate.
+class BasicBlockSet {
+private:
+  llvm::DenseMap<const llvm::BasicBlock *, unsigned> Numbers;
+  llvm::BitVector Members;
+  llvm::SmallVector<unsigned, 16> Inserted;
+
+public:
+  /// \return true if \p BB was not in the set
+  bool insert(const llvm::BasicBlock *BB) {
+    auto It = Numbers.try_emplace(BB, Numbers.size()).first;
+    unsigned Index = It->second;
+    if (Index >= Members.size())
+      Members.resize(std::max<unsigned>(Index + 1, 2 * Members.size()));
+
+    if (Members.test(Index))
+      return false;
+
+    Members.set(Index);
+    Inserted.push_back(Index);
+    return true;
+  }
+
+  bool contains(const llvm::BasicBlock *BB) const {
+    auto It = Numbers.find(BB);
+    return It != Numbers.end() and Members.test(It->second);
+  }
+
+  /// \brief Empty the set, in time proportional to its size
+  void clear() {
+    for (unsigned Index : Inserted)
+      Members.reset(Index);
+    Inserted.clear();
+  }
+};
+
 template<bool Forward, typename Derived, typename SuccessorsRange>
 struct BFSVisitorBase {
 public:
@@ -261,8 +303,16 @@ public:
   using instruction_range = llvm::iterator_range<instruction_iterator>;
 
   void run(llvm::Instruction *I) {
+    BasicBlockSet Visited;
+    run(I, Visited);
+  }
+
+  /// \brief Visit starting from \p I, tracking the visited blocks in \p Visited
+  ///
+  /// \p Visited is cleared first: reuse it across visits to avoid allocations.
+  void run(llvm::Instruction *I, BasicBlockSet &Visited) {
     auto &ThisDerived = *static_cast<Derived *>(this);
-    std::set<BasicBlock *> Visited;
+    Visited.clear();
 
     using ID = IteratorDirection<Forward>;
     instruction_iterator It = ID::iterator(I);
@@ -281,24 +331,22 @@ public:
       instruction_range Range;
     };
 
-    std::queue<WorkItem> Queue;
-    Queue.push(WorkItem(I->getParent(), It));
+    // A FIFO queue, popping from Head
+    llvm::SmallVector<WorkItem, 16> Queue;
+    Queue.push_back(WorkItem(I->getParent(), It));
+    size_t Head = 0;
 
     bool ExhaustOnly = false;
 
-    while (not Queue.empty()) {
-      WorkItem Item = Queue.front();
-      Queue.pop();
+    while (Head < Queue.size()) {
+      WorkItem Item = Queue[Head++];
 
       switch (ThisDerived.visit(Item.Range)) {
       case Continue:
         if (not ExhaustOnly) {
-          for (auto *Successor : ThisDerived.successors(Item.BB)) {
-            if (Visited.count(Successor) == 0) {
-              Visited.insert(Successor);
-              Queue.push(WorkItem(Successor));
-            }
-          }
+          for (auto *Successor : ThisDerived.successors(Item.BB))
+            if (Visited.insert(Successor))
+              Queue.push_back(WorkItem(Successor));
         }
         break;
       case NoSuccessors:
@@ -337,6 +385,47 @@ struct ForwardBFSVisitor
   }
 };
 
+namespace detail {
+
+template<typename CallbackT, template<typename> class Direction>
+struct CallbackBFSVisitor
+  : public Direction<CallbackBFSVisitor<CallbackT, Direction>> {
+  CallbackT &Callback;
+
+  CallbackBFSVisitor(CallbackT &Callback) : Callback(Callback) {}
+
+  template<typename RangeT>
+  VisitAction visit(RangeT Range) {
+    return Callback(Range);
+  }
+};
+
+} // namespace detail
+
+/// \brief Visit breadth-first the instructions preceding \p I
+///
+/// \p Callback is invoked on the range of instructions of each basic block, in
+/// reverse order, and returns a VisitAction. Being a template parameter, it can
+/// be inlined in the visit.
+///
+/// \p Visited tracks the visited blocks, see BasicBlockSet.
+template<typename CallbackT>
+inline void
+visitBackward(llvm::Instruction *I, BasicBlockSet &Visited, CallbackT Callback) {
+  detail::CallbackBFSVisitor<CallbackT, BackwardBFSVisitor> Visitor(Callback);
+  Visitor.run(I, Visited);
+}
+
+/// \brief Visit breadth-first the instructions following \p I
+///
+/// \see visitBackward
+template<typename CallbackT>
+inline void
+visitForward(llvm::Instruction *I, BasicBlockSet &Visited, CallbackT Callback) {
+  detail::CallbackBFSVisitor<CallbackT, ForwardBFSVisitor> Visitor(Callback);
+  Visitor.run(I, Visited);
+}
+
 inline std::string getName(const llvm::Value *V);
 
 /// \brief Return a string with the value of a given integer constant.
@@ -809,6 +898,43 @@ getCallTo(const llvm::Instruction *I, llvm::StringRef Name) {
     return nullptr;
 }
 
+/// \brief Name of the metadata replacing the call to `newpc` beginning a basic
+///        block in lean modules
+///
+/// The metadata is attached to the terminator of the basic block and it's a
+/// tuple containing the first three arguments of the removed call: the PC, the
+/// size of the instruction and whether it's a jump target.
+static const char *NewPCMDName = "revng.newpc";
+
+/// \brief Name of the named metadata holding the ranges of memory read by the
+///        lifted code
+///
+/// Its only operand is a tuple containing an IntervalSet serialized in an
+/// MDString.
+static const char *ReadRangesMDName = "revng.read-ranges";
+
+/// \return the \p Index-th argument of \p I, if it's a call to `newpc`, or of
+///         the call to `newpc` replaced by metadata, if \p I is the first
+///         instruction of a basic block in a lean module, nullptr otherwise.
+inline llvm::Value *getNewPCArgument(llvm::Instruction *I, unsigned Index) {
+  using namespace llvm;
+
+  revng_assert(Index < 3);
+
+  if (CallInst *Call = getCallTo(I, "newpc"))
+    return Call->getArgOperand(Index);
+
+  BasicBlock *BB = I->getParent();
+  Instruction *T = BB->getTerminator();
+  if (T == nullptr or I != BB->getFirstNonPHI())
+    return nullptr;
+
+  if (auto *Tuple = cast_or_null<MDTuple>(T->getMetadata(NewPCMDName)))
+    return QuickMetadata(BB->getContext()).extract<Constant *>(Tuple, Index);
+
+  return nullptr;
+}
+
 inline MetaAddress getBasicBlockPC(llvm::BasicBlock *BB) {
   using namespace llvm;
 
@@ -816,8 +942,8 @@ inline MetaAddress getBasicBlockPC(llvm::BasicBlock *BB) {
   if (I == nullptr)
     return MetaAddress::invalid();
 
-  if (llvm::CallInst *Call = getCallTo(I, "newpc"))
-    return MetaAddress::fromConstant(Call->getOperand(0));
+  if (Value *PC = getNewPCArgument(I, 0))
+    return MetaAddress::fromConstant(PC);
 
   return MetaAddress::invalid();
 }
@@ -829,9 +955,9 @@ inline MetaAddress getBasicBlockJumpTarget(llvm::BasicBlock *BB) {
   if (I == nullptr)
     return MetaAddress::invalid();
 
-  if (llvm::CallInst *Call = getCallTo(I, "newpc")) {
-    if (getLimitedValue(Call->getOperand(2)) == 1) {
-      return MetaAddress::fromConstant(Call->getOperand(0));
+  if (Value *IsJT = getNewPCArgument(I, 2)) {
+    if (getLimitedValue(IsJT) == 1) {
+      return MetaAddress::fromConstant(getNewPCArgument(I, 0));
     }
   }
 
@@ -949,6 +1075,47 @@ inline llvm::User *getUniqueUser(llvm::Value *V) {
 ///         second the size of the instruction.
 std::pair<MetaAddress, uint64_t> getPC(llvm::Instruction *TheInstruction);
 
+/// \brief Memoizes the call to `newpc` reaching each basic block
+///
+/// The call to `newpc` reaching the end of a block is its last one or, if it
+/// has none, the one reaching all of its predecessors. If the predecessors
+/// disagree, no call reaches the block. Unlike getPC, the result does not
+/// depend on the order of the visit, and each block is inspected once.
+///
+/// Predecessors in loops without calls to `newpc` are ignored, and so are the
+/// blocks of the root dispatcher. Users changing the CFG or the calls to
+/// `newpc` are responsible for invalidating the cache.
+class NewPCCache {
+private:
+  struct Entry {
+    llvm::CallInst *Call = nullptr;
+
+    /// Distinct calls reach the block
+    bool Conflict = false;
+
+    /// The visit of the predecessors is in progress
+    bool Pending = false;
+  };
+
+private:
+  llvm::DenseMap<llvm::BasicBlock *, Entry> AtEnd;
+
+public:
+  /// \return the call to `newpc` reaching \p I, or nullptr if there's none or
+  ///         it's ambiguous
+  llvm::CallInst *reaching(llvm::Instruction *I);
+
+  /// \brief Same as ::getPC, but memoized
+  std::pair<MetaAddress, uint64_t> getPC(llvm::Instruction *I);
+
+  void invalidate() { AtEnd.clear(); }
+
+private:
+  Entry reachingEnd(llvm::BasicBlock *BB);
+  Entry reachingBegin(llvm::BasicBlock *BB);
+  static void merge(Entry &Accumulator, const Entry &Incoming);
+};
+
 /// \brief Replace all uses of \Old, with \New in \F.
 ///
 /// \return true if it changes something, false otherwise.
@@ -0,0 +1,39 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+
+/// \brief A snapshot of the memory used by the process, in bytes
+///
+/// Figures that cannot be obtained on the host are zero.
+struct MemoryUsage {
+  /// Resident set size
+  uint64_t RSS = 0;
+
+  /// Highest RSS since the program started or the last resetPeak
+  uint64_t PeakRSS = 0;
+
+  /// Bytes allocated through malloc and not freed yet, only if \p WithHeap
+  uint64_t HeapBytes = 0;
+
+public:
+  /// \param WithHeap also compute HeapBytes, which requires inspecting all the
+  ///        malloc arenas.
+  static MemoryUsage current(bool WithHeap = false);
+
+  /// \brief Reset PeakRSS to the current RSS
+  ///
+  /// \return false if the host does not allow it, in which case PeakRSS keeps
+  ///         tracking the peak since the program started.
+  static bool resetPeak();
+};
+
+/// \brief Return the memory freed so far to the OS
+///
+/// Call this at the end of the phases that free many short-lived objects at
+/// once, e.g., a harvesting round, so that fragmentation doesn't keep the RSS
+/// well above the live size. It does nothing with -release-freed-memory=false.
+void releaseFreedMemory();
@@ -4,6 +4,11 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <functional>
+#include <utility>
+
+#include "llvm/ADT/DenseMapInfo.h"
+#include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/Triple.h"
 
 #include "revng/Support/Debug.h"
@@ -406,6 +411,7 @@ inline bool isDefaultCode(Values Type) {
 /// \note Generic addresses have no alignment constraints.
 class MetaAddress : private PlainMetaAddress {
   friend class ProgramCounterHandler;
+  friend struct llvm::DenseMapInfo<MetaAddress>;
 
 public:
   /// \name Constructors
@@ -545,24 +551,41 @@ public:
 public:
   /// @{
   bool operator==(const MetaAddress &Other) const {
-    return tie() == Other.tie();
+    return packed() == Other.packed();
   }
 
   bool operator!=(const MetaAddress &Other) const {
     return not(*this == Other);
   }
 
-  bool operator<(const MetaAddress &Other) const { return tie() < Other.tie(); }
+  bool operator<(const MetaAddress &Other) const {
+    return packed() < Other.packed();
+  }
   bool operator<=(const MetaAddress &Other) const {
-    return tie() <= Other.tie();
+    return packed() <= Other.packed();
+  }
+  bool operator>(const MetaAddress &Other) const {
+    return packed() > Other.packed();
   }
-  bool operator>(const MetaAddress &Other) const { return tie() > Other.tie(); }
   bool operator>=(const MetaAddress &Other) const {
-    return tie() >= Other.tie();
+    return packed() >= Other.packed();
   }
 
   /// @}
 
+  /// \brief A 128-bit key ordered as the MetaAddress
+  ///
+  /// The first element packs the epoch, the address space and the type, the
+  /// second one is the address. Comparing two keys is equivalent to, and
+  /// cheaper than, comparing the fields one by one.
+  using PackedKey = std::pair<uint64_t, uint64_t>;
+
+  PackedKey packed() const {
+    uint64_t High = (static_cast<uint64_t>(Epoch) << 32)
+                    | (static_cast<uint64_t>(AddressSpace) << 16) | Type;
+    return { High, Address };
+  }
+
   /// \name Address comparisons
   ///
   /// Comparison operators are defined only if
@@ -841,11 +864,13 @@ public:
   static MetaAddress fromString(llvm::StringRef Text);
 
 private:
-  using Tied = std::tuple<const uint32_t &,
-                          const uint16_t &,
-                          const uint16_t &,
-                          const uint64_t &>;
-  Tied tie() const { return std::tie(Epoch, AddressSpace, Type, Address); }
+  /// Create a MetaAddress with an out of range type, for use as a sentinel
+  static MetaAddress sentinel(uint16_t Type) {
+    revng_assert(not MetaAddressType::isValid(MetaAddressType::Values(Type)));
+    MetaAddress Result;
+    Result.Type = Type;
+    return Result;
+  }
 };
 
 static_assert(sizeof(MetaAddress) <= 128 / 8,
@@ -857,6 +882,41 @@ struct compareAddress {};
 template<>
 struct compareAddress<MetaAddress> {
   bool operator()(const MetaAddress &LHS, const MetaAddress &RHS) const {
+    // Fast path: valid addresses with the same epoch, address space and type,
+    // typically all zero but the type, are always comparable
+    if (LHS.packed().first == RHS.packed().first and LHS.isValid())
+      return LHS.address() < RHS.address();
+
     return LHS.addressLowerThan(RHS);
   }
 };
+
+namespace llvm {
+
+template<>
+struct DenseMapInfo<MetaAddress> {
+  static MetaAddress getEmptyKey() { return MetaAddress::sentinel(0xFFFF); }
+
+  static MetaAddress getTombstoneKey() {
+    return MetaAddress::sentinel(0xFFFE);
+  }
+
+  static unsigned getHashValue(const MetaAddress &Value) {
+    auto [High, Low] = Value.packed();
+    return llvm::hash_combine(High, Low);
+  }
+
+  static bool isEqual(const MetaAddress &LHS, const MetaAddress &RHS) {
+    return LHS == RHS;
+  }
+};
+
+} // namespace llvm
+
+template<>
+struct std::hash<MetaAddress> {
+  size_t operator()(const MetaAddress &Value) const {
+    auto [High, Low] = Value.packed();
+    return llvm::hash_combine(High, Low);
+  }
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+
+#include "revng/Support/Assert.h"
+#include "revng/Support/MetaAddress.h"
+
+/// \brief Two-way cache between MetaAddresses and their llvm::ConstantStruct
+///
+/// MetaAddress::fromConstant extracts and validates four ConstantInts and
+/// MetaAddress::toConstant goes through the uniquing of five constants. The
+/// same few thousands addresses are converted over and over, e.g., for each
+/// call to newpc, so this turns both directions into a hash lookup.
+///
+/// Constants are never freed as long as the LLVMContext is alive, unless a
+/// transformation explicitly destroys them: the cache must not outlive such
+/// transformations. It is not thread-safe.
+class MetaAddressConstants {
+private:
+  llvm::StructType *Struct = nullptr;
+  llvm::DenseMap<const llvm::Constant *, MetaAddress> ToMetaAddress;
+  llvm::DenseMap<MetaAddress, llvm::Constant *> ToConstant;
+
+public:
+  MetaAddressConstants() = default;
+
+  /// \param Struct the MetaAddress type, see MetaAddress::getStruct
+  explicit MetaAddressConstants(llvm::StructType *Struct) : Struct(Struct) {}
+
+public:
+  bool hasStruct() const { return Struct != nullptr; }
+
+  /// \brief Cached version of MetaAddress::fromConstant
+  MetaAddress fromConstant(llvm::Value *V) {
+    auto *C = llvm::cast<llvm::Constant>(V);
+    auto [It, New] = ToMetaAddress.try_emplace(C, MetaAddress::invalid());
+    if (New) {
+      It->second = MetaAddress::fromConstant(V);
+      if (C->getType() == Struct)
+        ToConstant.try_emplace(It->second, C);
+    }
+
+    return It->second;
+  }
+
+  /// \brief Cached version of MetaAddress::toConstant
+  llvm::Constant *toConstant(const MetaAddress &Address) {
+    revng_assert(Struct != nullptr);
+    auto [It, New] = ToConstant.try_emplace(Address, nullptr);
+    if (New) {
+      It->second = Address.toConstant(Struct);
+      ToMetaAddress.try_emplace(It->second, Address);
+    }
+
+    return It->second;
+  }
+
+  void clear() {
+    ToMetaAddress.clear();
+    ToConstant.clear();
+  }
+};
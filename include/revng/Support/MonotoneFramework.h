@@ -4,11 +4,15 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <limits>
 #include <map>
+#include <queue>
 #include <set>
 #include <type_traits>
 #include <vector>
 
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/Optional.h"
 #include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/ADT/SmallVector.h"
@@ -41,18 +45,61 @@ template<typename Iterated, VisitType Visit>
 class MonotoneFrameworkWorkList {};
 
 // Breadth first implementation
+//
+// Entries are assigned a dense index the first time they are inserted, so that
+// checking whether an entry is already enqueued is a single bit test.
 template<typename Iterated>
 class MonotoneFrameworkWorkList<Iterated, BreadthFirst> {
 private:
-  UniquedQueue<Iterated> Queue;
+  /// Entries seen so far, in order of first insertion
+  std::vector<Iterated> Entries;
+
+  /// Map to quickly find the index of an entry in Entries
+  llvm::DenseMap<Iterated, uint32_t> EntriesIndex;
+
+  /// Indices of the enqueued entries, in insertion order
+  std::queue<uint32_t> Queue;
+
+  /// Entries currently in Queue
+  llvm::BitVector Enqueued;
 
 public:
   MonotoneFrameworkWorkList(Iterated) {}
-  void clear() { Queue.clear(); }
-  void insert(Iterated Entry) { Queue.insert(Entry); }
+
+  void clear() {
+    std::queue<uint32_t>().swap(Queue);
+    Enqueued.reset();
+  }
+
+  void insert(Iterated Entry) {
+    auto [It, New] = EntriesIndex.try_emplace(Entry, Entries.size());
+    if (New) {
+      Entries.push_back(Entry);
+      Enqueued.push_back(false);
+    }
+
+    uint32_t Index = It->second;
+    if (not Enqueued.test(Index)) {
+      Enqueued.set(Index);
+      Queue.push(Index);
+    }
+  }
+
   bool empty() const { return Queue.empty(); }
-  Iterated head() const { return Queue.head(); }
-  Iterated pop() { return Queue.pop(); }
+
+  Iterated head() const {
+    revng_assert(not empty());
+    return Entries[Queue.front()];
+  }
+
+  Iterated pop() {
+    revng_assert(not empty());
+    uint32_t Index = Queue.front();
+    Queue.pop();
+    Enqueued.reset(Index);
+    return Entries[Index];
+  }
+
   size_t size() const { return Queue.size(); }
 };
 
@@ -64,29 +111,17 @@ template<typename Iterated, VisitType Visit>
 requires IsPostOrderLike<Visit>
 class MonotoneFrameworkWorkList<Iterated, Visit> {
 private:
-  /// \brief Class for an entry in the work list
+  /// List of all basic blocks in the appropriate order
   ///
-  /// All the basic blocks are always in the list in (reverse) post order. When
-  /// an entry is popped it is simply disabled.
-  class PostOrderEntry {
-  private:
-    Iterated Entry;
-    bool Enabled;
-
-  public:
-    PostOrderEntry(Iterated Entry) : Entry(Entry), Enabled(true) {}
-    void enable() { Enabled = true; }
-    void disable() { Enabled = false; }
-    bool isEnabled() const { return Enabled; }
-    Iterated entry() const { return Entry; }
-  };
+  /// All the basic blocks are always in the list. When an entry is popped it is
+  /// simply disabled.
+  std::vector<Iterated> PostOrderList;
 
-private:
-  /// List of all basic blocks in the appropriate order
-  std::vector<PostOrderEntry> PostOrderList;
+  /// Enabled entries of PostOrderList
+  llvm::BitVector Enabled;
 
   /// Map to quickly find the index of an entry in PostOrderList
-  std::map<Iterated, size_t> PostOrderListIndex;
+  llvm::DenseMap<Iterated, size_t> PostOrderListIndex;
 
   /// The next index to consume. This should always point to the lowest enabled
   /// entry in PostOrderList
@@ -96,17 +131,13 @@ private:
   const static size_t InvalidIndex = std::numeric_limits<size_t>::max();
 
 public:
-  MonotoneFrameworkWorkList(const std::vector<Iterated> &RPOT) {
-    for (Iterated Entry : RPOT)
-      PostOrderList.push_back(PostOrderEntry(Entry));
-
+  MonotoneFrameworkWorkList(const std::vector<Iterated> &RPOT) :
+    PostOrderList(RPOT.begin(), RPOT.end()) {
     initialize();
   }
 
-  MonotoneFrameworkWorkList(const llvm::SmallVectorImpl<Iterated> &RPOT) {
-    for (Iterated Entry : RPOT)
-      PostOrderList.push_back(PostOrderEntry(Entry));
-
+  MonotoneFrameworkWorkList(const llvm::SmallVectorImpl<Iterated> &RPOT) :
+    PostOrderList(RPOT.begin(), RPOT.end()) {
     initialize();
   }
 
@@ -115,21 +146,11 @@ public:
 
   size_t size() const {
     revng_assert(verify());
-
-    if (empty())
-      return 0;
-
-    size_t Result = 0;
-    for (size_t I = Next; I < PostOrderList.size(); I++)
-      if (PostOrderList[I].isEnabled())
-        Result++;
-
-    return Result;
+    return Enabled.count();
   }
 
   void clear() {
-    for (PostOrderEntry &Entry : PostOrderList)
-      Entry.disable();
+    Enabled.reset();
     Next = InvalidIndex;
   }
 
@@ -139,7 +160,7 @@ public:
     revng_assert(It != PostOrderListIndex.end());
 
     // Enable it
-    PostOrderList[It->second].enable();
+    Enabled.set(It->second);
 
     // Reset next to the lowest enabled index, if necessary
     Next = std::min(Next, It->second);
@@ -149,28 +170,23 @@ public:
 
   Iterated head() const {
     revng_assert(Next != InvalidIndex);
-    return PostOrderList[Next].entry();
+    return PostOrderList[Next];
   }
 
   Iterated pop() {
     revng_assert(not empty());
     revng_assert(verify());
 
-    // Start from the next element and look for an enabled element
-    size_t I = Next + 1;
-    for (; I < PostOrderList.size(); I++)
-      if (PostOrderList[I].isEnabled())
-        break;
-
-    // Update Next
+    // Consume the current next
     size_t OldNext = Next;
-    Next = (I >= PostOrderList.size()) ? InvalidIndex : I;
+    Enabled.reset(OldNext);
 
-    // Consume the previous next
-    PostOrderList[OldNext].disable();
+    // Look for the next enabled element
+    int I = Enabled.find_next(OldNext);
+    Next = (I == -1) ? InvalidIndex : I;
 
     // Return the consumed entry
-    return PostOrderList[OldNext].entry();
+    return PostOrderList[OldNext];
   }
 
 private:
@@ -191,7 +207,10 @@ private:
 
     // Populate the index, used for faster lookups
     for (unsigned I = 0; I < PostOrderList.size(); I++)
-      PostOrderListIndex[PostOrderList[I].entry()] = I;
+      PostOrderListIndex[PostOrderList[I]] = I;
+
+    // Initially all the entries are enabled
+    Enabled.resize(PostOrderList.size(), true);
 
     // Initialize the next index
     Next = (PostOrderList.size() > 0) ? 0 : InvalidIndex;
@@ -201,27 +220,25 @@ private:
     if (PostOrderList.size() == 0 and not empty())
       return false;
 
-    if (empty()) {
-      // If the worklist is empty, no elements should be enabled
-      for (const PostOrderEntry &Entry : PostOrderList)
-        if (Entry.isEnabled())
-          return false;
-    } else {
-      // Otherwise, all the elements up to next should be disabled
-      for (size_t I = 0; I != Next; I++)
-        if (PostOrderList[I].isEnabled())
-          return false;
-
-      if (not PostOrderList[Next].isEnabled())
-        return false;
-    }
+    // No elements should be enabled before next, nor at all if the worklist is
+    // empty
+    int FirstEnabled = Enabled.find_first();
+    if (empty())
+      return FirstEnabled == -1;
 
-    return true;
+    return FirstEnabled != -1 and static_cast<size_t>(FirstEnabled) == Next;
   }
 };
 
 /// \brief CRTP base class for an element of the lattice
 ///
+/// Beside the methods below, a lattice element must provide a `copy` method,
+/// which the MonotoneFramework uses each time the same element has to be
+/// propagated to multiple successors. Since most transfer functions change only
+/// a small portion of the state, `copy` doesn't have to perform a deep copy:
+/// wrapping the sub-structures of the element in CopyOnWrite (see
+/// revng/ADT/CopyOnWrite.h) lets labels share them until they're modified.
+///
 /// \note This class is more for reference. It's unused.
 ///
 /// \tparam D the derived class.
@@ -280,6 +297,12 @@ private:
   LatticeElement Result;
 };
 
+/// \brief Analyses that can be interrupted when they exceed their work budget
+template<typename D>
+concept HasBudgetExceededInterrupt = requires(D &d) {
+  d.createBudgetExceededInterrupt();
+};
+
 /// \brief Helper struct for creation of Interrupts for MonotoneFramework
 ///
 /// This is for creating generic Interrupts.
@@ -301,6 +324,13 @@ struct InterruptCreator {
   InterruptTy createNoReturnInterrupt(D &d) {
     return d.createNoReturnInterrupt();
   }
+
+  InterruptTy createBudgetExceededInterrupt(D &d) {
+    if constexpr (HasBudgetExceededInterrupt<D>)
+      return d.createBudgetExceededInterrupt();
+    else
+      revng_abort();
+  }
 };
 
 /// \brief Specialization of InterruptCreator for DefaultInterrupt
@@ -322,6 +352,11 @@ struct InterruptCreator<D, LatticeElement, DefaultInterrupt<LatticeElement>> {
   DefaultInterrupt<LatticeElement> createNoReturnInterrupt(D &) {
     return DefaultInterrupt<LatticeElement>();
   }
+
+  DefaultInterrupt<LatticeElement> createBudgetExceededInterrupt(D &) {
+    revng_abort();
+    return DefaultInterrupt<LatticeElement>();
+  }
 };
 /// \brief CRTP base class for implementing a monotone framework
 ///
@@ -399,6 +434,15 @@ protected:
   /// \note Unused if DynamicGraph == false
   std::map<Label, llvm::SmallVector<Label, 2>> SuccessorsMap;
 
+  /// Maximum number of applications of the transfer function, 0 if unlimited
+  size_t Budget = 0;
+
+  /// Number of applications of the transfer function so far
+  ///
+  /// \note This is not reset by initialize, the budget covers all the runs of
+  ///       the analysis.
+  size_t Work = 0;
+
 public:
   using InterruptType = Interrupt;
 
@@ -451,6 +495,15 @@ public:
     return TheInterruptCreator.createNoReturnInterrupt(derived());
   }
 
+  /// \brief Create a "budget exceeded" interrupt, used when the transfer
+  ///        function has been applied more times than the budget allows
+  ///
+  /// \note This method must be implemented by the derived class D only if
+  ///       setBudget is used
+  Interrupt createBudgetExceededInterrupt() {
+    return TheInterruptCreator.createBudgetExceededInterrupt(derived());
+  }
+
   /// \brief Dump the final state
   ///
   /// \note This method must be implemented by the derived class D
@@ -507,6 +560,25 @@ public:
     }
   }
 
+  /// \brief Reset the analysis, preserving the state of some labels
+  ///
+  /// The states associated to the labels in \p Preserved are kept and the
+  /// labels are enqueued again, so that their successors are visited again
+  /// too. This is useful to run the analysis again after a change that cannot
+  /// affect the preserved labels, without reaching their fixed point again.
+  void initialize(const std::set<Label> &Preserved) {
+    std::map<Label, LatticeElement> OldState = std::move(State);
+    initialize();
+
+    for (Label L : Preserved) {
+      auto It = OldState.find(L);
+      if (It != OldState.end()) {
+        insert_or_assign(State, L, std::move(It->second));
+        WorkList.insert(L);
+      }
+    }
+  }
+
   /// \brief Registers \p L to be visited before the end of the analysis
   ///
   /// If \p L has already been visited at least once before, it's simply
@@ -528,12 +600,31 @@ public:
   /// \brief Register a new extremal label
   void registerExtremal(Label L) { Extremals.insert(L); }
 
+  /// \brief Limit the number of applications of the transfer function
+  ///
+  /// Once \p NewBudget applications have been performed, run returns the
+  /// interrupt created by D::createBudgetExceededInterrupt. 0 means unlimited.
+  void setBudget(size_t NewBudget) {
+    static_assert(HasBudgetExceededInterrupt<D>);
+    Budget = NewBudget;
+  }
+
+  /// \brief True if the analysis has exhausted its budget
+  bool budgetExceeded() const { return Budget != 0 and Work >= Budget; }
+
+  /// \brief Number of applications of the transfer function so far
+  size_t work() const { return Work; }
+
   /// \brief Resolve the data flow analysis problem using the MFP solution
   Interrupt run() {
     using namespace llvm;
 
     // Proceed until there are elements in the work list
     while (not WorkList.empty()) {
+      // Give up if we did too much work already
+      if (budgetExceeded())
+        return createBudgetExceededInterrupt();
+
       Label ToAnalyze = WorkList.head();
 
       // If we've been asked to visit this basic block before the end, consider
@@ -541,6 +632,7 @@ public:
       ToVisit.erase(ToAnalyze);
 
       // Run the transfer function
+      Work++;
       Interrupt Result = transfer(ToAnalyze);
 
       // Check if we should continue or if we should yield control to the
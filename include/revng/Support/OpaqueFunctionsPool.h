@@ -5,7 +5,11 @@
 //
 
 #include <map>
+#include <optional>
+#include <type_traits>
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/Twine.h"
 #include "llvm/IR/Attributes.h"
 #include "llvm/IR/DerivedTypes.h"
@@ -15,13 +19,30 @@
 #include "revng/Support/Assert.h"
 #include "revng/Support/FunctionTags.h"
 
+template<typename KeyT>
+concept HasDenseMapInfo = requires(const KeyT &Key) {
+  { llvm::DenseMapInfo<KeyT>::getEmptyKey() };
+  { llvm::DenseMapInfo<KeyT>::getHashValue(Key) };
+};
+
+/// \brief Creates and caches declarations of opaque functions by key
+///
+/// Keys supported by llvm::DenseMap, such as pointers and llvm::StringRef, are
+/// stored in a DenseMap, other keys in a std::map. In either case, the order of
+/// iteration is not meaningful.
 template<typename KeyT>
 class OpaqueFunctionsPool {
+private:
+  using ContainerType = std::conditional_t<HasDenseMapInfo<KeyT>,
+                                           llvm::DenseMap<KeyT,
+                                                          llvm::Function *>,
+                                           std::map<KeyT, llvm::Function *>>;
+
 private:
   llvm::Module *M;
   llvm::LLVMContext &Context;
   const bool PurgeOnDestruction;
-  std::map<KeyT, llvm::Function *> Pool;
+  ContainerType Pool;
   llvm::AttributeList AttributeSets;
   FunctionTags::TagsSet Tags;
 
@@ -54,27 +75,58 @@ public:
 
 public:
   void record(KeyT Key, llvm::Function *F) {
-    auto It = Pool.find(Key);
-    if (It == Pool.end())
-      Pool[Key] = F;
-    else
-      revng_assert(It->second == F);
+    auto [It, New] = Pool.insert({ Key, F });
+    revng_assert(New or It->second == F);
+  }
+
+  /// \brief Record the functions of the module having all the tags of the pool
+  ///
+  /// This lets a pass run again on a module without creating its declarations
+  /// again. The tags have to be set first, see setTags.
+  ///
+  /// \p GetKey is invoked on each of such functions and returns its key, or
+  /// std::nullopt to ignore it.
+  template<typename CallableT>
+  void recordExisting(CallableT GetKey) {
+    revng_assert(not Tags.empty());
+    for (llvm::Function &F : M->functions()) {
+      if (not FunctionTags::TagsSet::from(&F).includes(Tags))
+        continue;
+
+      std::optional<KeyT> Key = GetKey(F);
+      if (Key)
+        record(*Key, &F);
+    }
+  }
+
+  /// \brief Create the functions for all the keys in \p Keys at once
+  ///
+  /// \p Describe is invoked on each key not having a function yet, and
+  /// returns the type of its function and its name, in a std::pair.
+  template<typename RangeT, typename CallableT>
+  void prewarm(const RangeT &Keys, CallableT Describe) {
+    if constexpr (HasDenseMapInfo<KeyT> and requires { Keys.size(); })
+      Pool.reserve(Pool.size() + Keys.size());
+
+    for (const KeyT &Key : Keys) {
+      if (Pool.count(Key) != 0)
+        continue;
+
+      auto [FT, Name] = Describe(Key);
+      Pool.insert({ Key, create(FT, Name) });
+    }
   }
 
 public:
   llvm::Function *
   get(KeyT Key, llvm::FunctionType *FT, const llvm::Twine &Name = {}) {
-    using namespace llvm;
-
-    Function *F = nullptr;
+    llvm::Function *F = nullptr;
     auto It = Pool.find(Key);
     if (It != Pool.end()) {
       F = It->second;
     } else {
-      F = Function::Create(FT, GlobalValue::ExternalLinkage, Name, M);
-      F->setAttributes(AttributeSets);
-      Tags.addTo(F);
-      Pool.insert(It, { Key, F });
+      F = create(FT, Name);
+      Pool.insert({ Key, F });
     }
 
     // Ensure the function we're returning is as expected
@@ -93,4 +145,13 @@ public:
 
     return get(Key, FunctionType::get(ReturnType, Arguments, false), Name);
   }
+
+private:
+  llvm::Function *create(llvm::FunctionType *FT, const llvm::Twine &Name) {
+    using namespace llvm;
+    auto *F = Function::Create(FT, GlobalValue::ExternalLinkage, Name, M);
+    F->setAttributes(AttributeSets);
+    Tags.addTo(F);
+    return F;
+  }
 };
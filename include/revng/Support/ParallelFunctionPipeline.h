@@ -0,0 +1,78 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/PassInstrumentation.h"
+#include "llvm/IR/PassManager.h"
+
+/// \brief Process \p Functions on up to \p ThreadsCount threads, committing the
+///        changes in a fixed order
+///
+/// Each function goes through two phases:
+///
+/// * `Analyze(Function &, FunctionAnalysisManager &)` runs concurrently. It
+///   must not change the IR nor create anything in the LLVMContext (constants,
+///   types, metadata), since none of this is thread-safe. Each thread has its
+///   own FunctionAnalysisManager, populated by `RegisterAnalyses`, through
+///   which new pass manager analyses can be requested. Whatever has to survive
+///   must be returned, since the cached analyses of a function are dropped
+///   as soon as `Analyze` is done with it.
+/// * `Commit(Function &, Result &)` runs on the calling thread, one function
+///   at a time, in the order of \p Functions. This is where the IR is changed
+///   and makes the outcome independent from the scheduling of the threads.
+///
+/// \return true if any call to `Commit` returned true.
+template<typename RegisterT, typename AnalyzeT, typename CommitT>
+bool runFunctionPipeline(llvm::ArrayRef<llvm::Function *> Functions,
+                         unsigned ThreadsCount,
+                         RegisterT RegisterAnalyses,
+                         AnalyzeT Analyze,
+                         CommitT Commit) {
+  using namespace llvm;
+  using ResultT = std::invoke_result_t<AnalyzeT &,
+                                       Function &,
+                                       FunctionAnalysisManager &>;
+
+  std::vector<std::optional<ResultT>> Results(Functions.size());
+  std::atomic<size_t> Next(0);
+  auto Worker = [&]() {
+    FunctionAnalysisManager FAM;
+    FAM.registerPass([] { return PassInstrumentationAnalysis(); });
+    RegisterAnalyses(FAM);
+
+    for (size_t I = Next++; I < Functions.size(); I = Next++) {
+      Function &F = *Functions[I];
+      Results[I].emplace(Analyze(F, FAM));
+      FAM.clear(F, F.getName());
+    }
+  };
+
+  size_t Count = std::min<size_t>(ThreadsCount, Functions.size());
+  if (Count <= 1) {
+    Worker();
+  } else {
+    std::vector<std::thread> Threads;
+    for (size_t I = 0; I < Count; I++)
+      Threads.emplace_back(Worker);
+
+    for (std::thread &Thread : Threads)
+      Thread.join();
+  }
+
+  bool Changed = false;
+  for (size_t I = 0; I < Functions.size(); I++)
+    Changed = Commit(*Functions[I], *Results[I]) or Changed;
+
+  return Changed;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/ADT/StringRef.h"
+
+/// \brief Return true if any profiler has to be notified, see -profiler-regions
+bool areProfilerRegionsEnabled();
+
+/// \brief Notify the selected profilers that the region \p Name begins
+///
+/// If \p Enable is false, the region is to be excluded from the profile
+/// instead. Regions opened on a thread must be closed in reverse order. Prefer
+/// ProfilerRegion.
+void beginProfilerRegion(llvm::StringRef Name, bool Enable);
+
+/// \brief Notify the selected profilers that the innermost region ends
+void endProfilerRegion(bool Enable);
+
+/// \brief Mark the enclosing scope as a region of interest for the profiler
+///
+/// The profilers to notify are selected through -profiler-regions, among those
+/// available at build time:
+///
+/// * `callgrind`: instrumentation is started in the region, or stopped if
+///   \p Enable is false. Run Valgrind with `--instr-atstart=no`.
+/// * `perf`: the counters attached to the process are enabled in the region,
+///   or disabled if \p Enable is false, through `prctl`. Start `perf record`
+///   with `--delay=-1` to count the regions only.
+/// * `itt`: each region is an ITT task, shown by VTune.
+/// * `tracy`: each region is a Tracy zone.
+///
+/// ITT tasks and Tracy zones are not emitted for excluded regions. If no
+/// profiler is selected, this costs a check.
+class ProfilerRegion {
+private:
+  bool Active;
+  bool Enable;
+
+public:
+  ProfilerRegion(llvm::StringRef Name, bool Enable = true) :
+    Active(areProfilerRegionsEnabled()), Enable(Enable) {
+    if (Active)
+      beginProfilerRegion(Name, Enable);
+  }
+
+  ~ProfilerRegion() {
+    if (Active)
+      endProfilerRegion(Enable);
+  }
+
+  ProfilerRegion(const ProfilerRegion &) = delete;
+  ProfilerRegion &operator=(const ProfilerRegion &) = delete;
+};
@@ -4,9 +4,12 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Value.h"
+#include "llvm/IR/ValueHandle.h"
+#include "llvm/IR/ValueMap.h"
 
 #include "revng/Support/BlockType.h"
 #include "revng/Support/IRHelpers.h"
@@ -54,6 +57,12 @@ protected:
 
   std::set<llvm::Value *> CSVsAffectingPC;
 
+private:
+  using PCEvents = llvm::SmallVector<llvm::WeakVH, 4>;
+
+  /// Cache for pcEvents, entries are dropped when the basic block is deleted
+  mutable llvm::ValueMap<const llvm::BasicBlock *, PCEvents> PCEventsCache;
+
 public:
   using DispatcherTarget = std::pair<MetaAddress, llvm::BasicBlock *>;
   using DispatcherTargets = std::vector<DispatcherTarget>;
@@ -90,8 +99,10 @@ public:
   ///
   /// \return true if new instructions have been emitted.
   bool handleStore(llvm::IRBuilder<> &Builder, llvm::StoreInst *Store) const {
-    if (affectsPC(Store))
+    if (affectsPC(Store)) {
+      forgetPCEvents(Store->getParent());
       return handleStoreInternal(Builder, Store);
+    }
     return false;
   }
 
@@ -102,6 +113,7 @@ public:
 
   void setPC(llvm::IRBuilder<> &Builder, MetaAddress NewPC) const {
     revng_assert(NewPC.isValid() and NewPC.isCode());
+    forgetPCEvents(Builder.GetInsertBlock());
     store(Builder, AddressCSV, NewPC.address());
     store(Builder, EpochCSV, NewPC.epoch());
     store(Builder, AddressSpaceCSV, NewPC.addressSpace());
@@ -117,6 +129,13 @@ public:
 
   llvm::Value *loadPC(llvm::IRBuilder<> &Builder) const;
 
+  /// \brief Set the program counter to \p Address, a value only known at
+  ///        run-time, such as a return address loaded from the stack
+  void setPCFromValue(llvm::IRBuilder<> &Builder, llvm::Value *Address) const {
+    llvm::StoreInst *Store = Builder.CreateStore(Address, AddressCSV);
+    handleStore(Builder, Store);
+  }
+
 protected:
   virtual void
   initializePCInternal(llvm::IRBuilder<> &Builder, MetaAddress NewPC) const = 0;
@@ -144,6 +163,20 @@ public:
   std::pair<NextJumpTarget::Values, MetaAddress>
   getUniqueJumpTarget(llvm::BasicBlock *BB);
 
+  /// \brief Drop what getUniqueJumpTarget knows about \p BB
+  ///
+  /// getUniqueJumpTarget caches, for each basic block, the list of the
+  /// instructions that might affect the PC: stores to the PC CSVs, calls to
+  /// helpers and the last call to `newpc`. The list stays valid if their
+  /// operands change or they are erased, but it has to be dropped whenever one
+  /// of them is added to \p BB or \p BB is split. The code emitted by the
+  /// ProgramCounterHandler itself is taken care of.
+  void forgetPCEvents(const llvm::BasicBlock *BB) const {
+    PCEventsCache.erase(BB);
+  }
+
+  void forgetAllPCEvents() const { PCEventsCache.clear(); }
+
   void deserializePC(llvm::IRBuilder<> &Builder) const {
     using namespace llvm;
 
@@ -205,6 +238,24 @@ public:
     return buildDispatcher(Targets, Builder, Default, SetBlockType);
   }
 
+  /// \brief Build the dispatcher of a jump site whose targets are all known,
+  ///        e.g., a jump table
+  ///
+  /// If all the targets share epoch, address space and type, those are checked
+  /// once, followed by a single switch on the address. The address is the
+  /// value stored in the address CSV by the jump site, if still available in
+  /// the current basic block, so that the switch is on the expression
+  /// computing the target and LLVM can lower it to a native jump table.
+  /// Otherwise, this is equivalent to buildDispatcher.
+  ///
+  /// \note The resulting dispatcher is not a cascade of switches, it cannot be
+  ///       handled by addCaseToDispatcher, destroyDispatcher and the like.
+  DispatcherInfo
+  buildJumpSiteDispatcher(DispatcherTargets &Targets,
+                          llvm::IRBuilder<> &Builder,
+                          llvm::BasicBlock *Default,
+                          llvm::Optional<BlockType::Values> SetBlockType) const;
+
   /// \note \p Root must not already contain a case for \p NewTarget
   void
   addCaseToDispatcher(llvm::SwitchInst *Root,
@@ -213,6 +264,43 @@ public:
 
   void destroyDispatcher(llvm::SwitchInst *Root) const;
 
+  using KeepPredicate = llvm::function_ref<bool(const DispatcherTarget &)>;
+
+  /// \brief Drop the cases of the dispatcher for which \p Keep returns false
+  ///
+  /// \note The switches on epoch, address space and type are preserved, even if
+  ///       no case is left below them, so that new cases can be added later.
+  void pruneDispatcher(llvm::SwitchInst *Root, KeepPredicate Keep) const;
+
+  using WeightFunction = llvm::function_ref<uint64_t(const MetaAddress &)>;
+
+  /// \brief Attach branch weights to the switches of the dispatcher
+  ///
+  /// The weight of each case is obtained from \p Weight, the weight of the
+  /// switches on epoch, address space and type is the sum of the weights of the
+  /// cases below them. The default cases have weight zero.
+  void
+  setDispatcherWeights(llvm::SwitchInst *Root, WeightFunction Weight) const;
+
+  /// \brief Place a lookup table in front of the dispatcher rooted in \p Root
+  ///
+  /// The targets sharing the most common epoch, address space and type are
+  /// collected in a constant table. If their addresses are dense enough, the
+  /// table is indexed by the (scaled) distance from the lowest one, otherwise
+  /// by a perfect hash of the address. The matching entry provides a dense
+  /// index, dispatched through a switch the backend can lower to a jump table.
+  /// Everything else falls back to the original switch cascade.
+  ///
+  /// \note Once this has been done, no more cases can be added to \p Root and
+  ///       it can no longer be destroyed.
+  ///
+  /// \return false, leaving the dispatcher untouched, if there are less than
+  ///         \p MinimumTargets candidates for the table.
+  bool
+  addTableToDispatcher(llvm::SwitchInst *Root,
+                       unsigned MinimumTargets,
+                       llvm::Optional<BlockType::Values> SetBlockType) const;
+
   void buildHotPath(llvm::IRBuilder<> &Builder,
                     const DispatcherTarget &CandidateTarget,
                     llvm::BasicBlock *Default) const;
@@ -243,6 +331,10 @@ public:
 private:
   bool isPCAffectingHelper(llvm::Instruction *I) const;
 
+  /// \return the instructions of \p BB that might affect the PC, in reverse
+  ///         order, see forgetPCEvents
+  const PCEvents &pcEvents(llvm::BasicBlock *BB) const;
+
   static llvm::GlobalVariable *createAddress(llvm::Module *M) {
     return createVariable(M, AddressName, sizeof(MetaAddress::Address));
   }
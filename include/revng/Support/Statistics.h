@@ -4,22 +4,69 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
 #include <csignal>
 #include <cstdlib>
 #include <map>
+#include <mutex>
+#include <sstream>
 #include <string>
 #include <vector>
 
+#include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/Twine.h"
 #include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/raw_ostream.h"
 
 #include "revng/Support/Debug.h"
 
 const size_t MaxCounterMapDump = 32;
 
+/// \brief Number of shards of the statistics
+///
+/// Each thread updates a single shard, chosen round-robin the first time it
+/// records something. Shards are merged when the values are read.
+const size_t StatisticsShards = 16;
+
+/// \brief The shard the current thread should update
+inline size_t currentStatisticsShard() {
+  static std::atomic<size_t> NextShard = 0;
+  thread_local size_t Shard = NextShard++ % StatisticsShards;
+  return Shard;
+}
+
+/// \brief Collects the statistics to write them in a machine-readable format
+///
+/// Each statistic is a named set of (key, value) pairs.
+class StatisticsExporter {
+private:
+  std::map<std::string, std::map<std::string, double>> Values;
+
+public:
+  void add(llvm::StringRef Name, llvm::StringRef Key, double Value) {
+    Values[Name.str()][Key.str()] = Value;
+  }
+
+  /// \brief Write a JSON object mapping each name to its (key, value) pairs
+  void writeJSON(llvm::raw_ostream &Output) const;
+
+  /// \brief Write in the Prometheus text exposition format
+  ///
+  /// Each name becomes a gauge metric with the `revng_` prefix, the key is
+  /// stored in the `key` label.
+  void writePrometheus(llvm::raw_ostream &Output) const;
+};
+
 class OnQuitInteraface {
 public:
   virtual void onQuit() = 0;
+
+  /// \brief Record the current values into \p Exporter
+  virtual void exportTo(StatisticsExporter &Exporter) = 0;
+
   virtual ~OnQuitInteraface();
 };
 
@@ -35,29 +82,106 @@ inline size_t digitsCount(T Value) {
   return Digits;
 }
 
+/// \brief A set of named counters, which can be updated concurrently
+///
+/// A counter should be updated either through push or through pushMax, not
+/// both.
 template<typename K, typename T = uint64_t>
 class CounterMap : public OnQuitInteraface {
 private:
   using Container = std::map<K, T>;
-  Container Map;
+
+  struct alignas(64) Shard {
+    std::mutex Lock;
+    Container Counters;
+    Container Maxima;
+  };
+
+private:
+  std::array<Shard, StatisticsShards> Shards;
   std::string Name;
 
 public:
   CounterMap(const llvm::Twine &Name) : Name(Name.str()) { init(); }
   virtual ~CounterMap() {}
 
-  void push(K Key) { Map[Key]++; }
-  void push(K Key, T Value) { Map[Key] += Value; }
-  void clear(K Key) { Map.erase(Key); }
-  void clear() { Map.clear(); }
+  void push(K Key) {
+    Shard &S = currentShard();
+    std::lock_guard<std::mutex> Guard(S.Lock);
+    S.Counters[Key]++;
+  }
+
+  void push(K Key, T Value) {
+    Shard &S = currentShard();
+    std::lock_guard<std::mutex> Guard(S.Lock);
+    S.Counters[Key] += Value;
+  }
+
+  /// \brief Record \p Value, if it's larger than the current one
+  void pushMax(K Key, T Value) {
+    Shard &S = currentShard();
+    std::lock_guard<std::mutex> Guard(S.Lock);
+    T &Current = S.Maxima[Key];
+    Current = std::max(Current, Value);
+  }
+
+  /// \brief Get a copy of all the counters, merging the shards
+  Container snapshot() {
+    Container Result;
+
+    for (Shard &S : Shards) {
+      std::lock_guard<std::mutex> Guard(S.Lock);
+      for (const auto &[Key, Value] : S.Counters)
+        Result[Key] += Value;
+    }
+
+    for (Shard &S : Shards) {
+      std::lock_guard<std::mutex> Guard(S.Lock);
+      for (const auto &[Key, Value] : S.Maxima) {
+        T &Current = Result[Key];
+        Current = std::max(Current, Value);
+      }
+    }
+
+    return Result;
+  }
+
+  void clear(K Key) {
+    for (Shard &S : Shards) {
+      std::lock_guard<std::mutex> Guard(S.Lock);
+      S.Counters.erase(Key);
+      S.Maxima.erase(Key);
+    }
+  }
+
+  void clear() {
+    for (Shard &S : Shards) {
+      std::lock_guard<std::mutex> Guard(S.Lock);
+      S.Counters.clear();
+      S.Maxima.clear();
+    }
+  }
 
   virtual void onQuit() { dump(); }
 
+  virtual void exportTo(StatisticsExporter &Exporter) {
+    if (Name.empty())
+      return;
+
+    for (const auto &[Key, Value] : snapshot()) {
+      std::stringstream KeyString;
+      KeyString << Key;
+      Exporter.add(Name, KeyString.str(), Value);
+    }
+  }
+
   template<typename O>
   void dump(size_t Max, O &Output) {
     if (not Name.empty())
       Output << Name << ":\n";
 
+    Container Map = snapshot();
+
     using Pair = std::pair<K, T>;
     std::vector<Pair> Sorted;
     Sorted.reserve(Map.size());
@@ -89,6 +213,8 @@ public:
   void dump() { dump(MaxCounterMapDump, dbg); }
 
 private:
+  Shard &currentShard() { return Shards[currentStatisticsShard()]; }
+
   void init();
 };
 
@@ -100,7 +226,55 @@ private:
 ///
 /// If a name is provided, the results will be registered for printing at
 /// program termination.
+///
+/// Values can be recorded concurrently: each thread updates its own shard, and
+/// shards are merged when reading the results.
 class RunningStatistics : public OnQuitInteraface {
+private:
+  /// Number of values, their sum, mean and sum of squared differences from the
+  /// mean
+  struct Accumulator {
+    uint64_t N = 0;
+    double Sum = 0.0;
+    double Mean = 0.0;
+    double M2 = 0.0;
+
+    void push(double X) {
+      // See Knuth TAOCP vol 2, 3rd edition, page 232
+      N++;
+      Sum += X;
+      double Delta = X - Mean;
+      Mean += Delta / N;
+      M2 += Delta * (X - Mean);
+    }
+
+    /// \brief Combine with the values recorded by \p Other
+    ///
+    /// See Chan et al., "Updating Formulae and a Pairwise Algorithm for
+    /// Computing Sample Variances", 1979.
+    void merge(const Accumulator &Other) {
+      if (Other.N == 0)
+        return;
+
+      if (N == 0) {
+        *this = Other;
+        return;
+      }
+
+      uint64_t Total = N + Other.N;
+      double Delta = Other.Mean - Mean;
+      Mean += Delta * Other.N / Total;
+      M2 += Other.M2 + Delta * Delta * N * Other.N / Total;
+      Sum += Other.Sum;
+      N = Total;
+    }
+  };
+
+  struct alignas(64) Shard {
+    mutable std::mutex Lock;
+    Accumulator Values;
+  };
+
 public:
   RunningStatistics() : RunningStatistics(llvm::Twine(), false) {}
 
@@ -110,7 +284,7 @@ public:
   /// \arg Register whether this object should be registered for being printed
   ///      upon program termination or not.
   RunningStatistics(const llvm::Twine &Name, bool Register) :
-    Name(Name.str()), N(0) {
+    Name(Name.str()) {
 
     if (Register)
       init();
@@ -118,38 +292,34 @@ public:
 
   virtual ~RunningStatistics() {}
 
-  void clear() { N = 0; }
+  void clear() {
+    for (Shard &S : Shards) {
+      std::lock_guard<std::mutex> Guard(S.Lock);
+      S.Values = Accumulator();
+    }
+  }
 
   // TODO: make a template
   /// \brief Record a new value
   void push(double X) {
-    N++;
-    Sum += X;
-
-    // See Knuth TAOCP vol 2, 3rd edition, page 232
-    if (N == 1) {
-      OldM = NewM = X;
-      OldS = 0.0;
-    } else {
-      NewM = OldM + (X - OldM) / N;
-      NewS = OldS + (X - OldM) * (X - NewM);
-
-      // Set up for next iteration
-      OldM = NewM;
-      OldS = NewS;
-    }
+    Shard &S = Shards[currentStatisticsShard()];
+    std::lock_guard<std::mutex> Guard(S.Lock);
+    S.Values.push(X);
   }
 
   /// \return the total number of recorded values.
-  int size() const { return N; }
+  int size() const { return total().N; }
 
-  double mean() const { return (N > 0) ? NewM : 0.0; }
+  double mean() const { return total().Mean; }
 
-  double variance() const { return ((N > 1) ? NewS / (N - 1) : 0.0); }
+  double variance() const {
+    Accumulator Total = total();
+    return Total.N > 1 ? Total.M2 / (Total.N - 1) : 0.0;
+  }
 
-  double standardDeviation() const { return sqrt(variance()); }
+  double standardDeviation() const { return std::sqrt(variance()); }
 
-  double sum() const { return Sum; }
+  double sum() const { return total().Sum; }
 
   template<typename T>
   void dump(T &Output) {
@@ -165,14 +335,23 @@ public:
 
   virtual void onQuit();
 
+  virtual void exportTo(StatisticsExporter &Exporter);
+
 private:
   void init();
 
+  Accumulator total() const {
+    Accumulator Result;
+    for (const Shard &S : Shards) {
+      std::lock_guard<std::mutex> Guard(S.Lock);
+      Result.merge(S.Values);
+    }
+    return Result;
+  }
+
 private:
   std::string Name;
-  int N;
-  double OldM, NewM, OldS, NewS;
-  double Sum;
+  std::array<Shard, StatisticsShards> Shards;
 };
 
 // TODO: this is duplicated
@@ -187,15 +366,26 @@ public:
 
   /// \brief Registers an object for having its onQuit method called upon
   ///        program termination
-  void add(OnQuitInteraface *S) { Register.push_back(S); }
+  void add(OnQuitInteraface *S) {
+    std::lock_guard<std::mutex> Guard(Lock);
+    Register.push_back(S);
+  }
 
   void dump() {
+    std::lock_guard<std::mutex> Guard(Lock);
     for (OnQuitInteraface *S : Register)
       S->onQuit();
   }
 
+  void exportTo(StatisticsExporter &Exporter) {
+    std::lock_guard<std::mutex> Guard(Lock);
+    for (OnQuitInteraface *S : Register)
+      S->exportTo(Exporter);
+  }
+
 private:
   std::vector<OnQuitInteraface *> Register;
+  std::mutex Lock;
 };
 
 extern llvm::ManagedStatic<OnQuitRegistry> OnQuitStatistics;
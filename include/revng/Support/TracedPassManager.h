@@ -0,0 +1,22 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Pass.h"
+
+/// \brief A legacy pass manager recording an event for each pass in the trace
+///
+/// Each module and function pass is surrounded by a pair of passes of the same
+/// kind opening and closing the event, so that the scheduling is unaffected.
+/// Function passes are recorded once per function. The required analyses run
+/// by the pass manager right before a pass are accounted to the pass.
+///
+/// See beginPassTraceEvent for the recorded arguments. If tracing is disabled,
+/// this is a plain llvm::legacy::PassManager.
+class TracedPassManager : public llvm::legacy::PassManager {
+public:
+  void add(llvm::Pass *P) override;
+};
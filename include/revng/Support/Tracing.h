@@ -0,0 +1,113 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <optional>
+
+#include "llvm/ADT/Any.h"
+#include "llvm/ADT/StringRef.h"
+
+/// \brief Return true if a trace has to be recorded, see -trace-output
+bool isTracingEnabled();
+
+/// \brief Open an event named \p Name on the current thread
+///
+/// Events opened on a thread must be closed in reverse order. Prefer
+/// TraceScope.
+void beginTraceEvent(llvm::StringRef Name, llvm::StringRef Detail = {});
+
+/// \brief Close the innermost event open on the current thread
+void endTraceEvent();
+
+/// \brief Attach \p Value to the innermost event open on the current thread
+void setTraceArgument(llvm::StringRef Key, int64_t Value);
+
+/// \brief Record the value of the counter \p Name at the current time
+///
+/// Counters are shown as a track of their own.
+void traceCounter(llvm::StringRef Name, int64_t Value);
+
+/// \brief Open an event for the run of the pass \p Name
+///
+/// If -trace-pass-memory is enabled, the memory used by the pass is attached
+/// to the event when it's closed:
+///
+/// * `rss-delta`: how much the RSS grew, in bytes;
+/// * `peak-rss`: the highest RSS reached by the process during the pass;
+/// * `heap-delta`: how much the bytes allocated through malloc grew, only with
+///   -trace-pass-heap.
+///
+/// The RSS is also recorded in the `RSS` counter.
+void beginPassTraceEvent(llvm::StringRef Name, llvm::StringRef Detail = {});
+
+/// \brief Close the event opened by the last beginPassTraceEvent
+///
+/// \param Instructions the number of instructions of the IR the pass run on,
+///        after the pass, if available. Attached as `instructions`.
+void endPassTraceEvent(std::optional<uint64_t> Instructions = std::nullopt);
+
+/// \brief The number of instructions of \p IR, a module or a function
+std::optional<uint64_t> countInstructions(const llvm::Any &IR);
+
+/// \brief Record the duration of the enclosing scope in the trace
+///
+/// Events are recorded per thread and nest according to the scopes. Upon
+/// program termination, the trace is written in the Chrome trace event format
+/// to the path specified by -trace-output, and can be inspected with Perfetto
+/// or chrome://tracing.
+///
+/// If tracing is disabled, this costs a check.
+class TraceScope {
+private:
+  bool Active;
+
+public:
+  TraceScope(llvm::StringRef Name, llvm::StringRef Detail = {}) :
+    Active(isTracingEnabled()) {
+    if (Active)
+      beginTraceEvent(Name, Detail);
+  }
+
+  ~TraceScope() {
+    if (Active)
+      endTraceEvent();
+  }
+
+  TraceScope(const TraceScope &) = delete;
+  TraceScope &operator=(const TraceScope &) = delete;
+};
+
+/// \brief Record an event for each pass run with the callbacks \p PIC
+///
+/// See beginPassTraceEvent for the recorded arguments.
+///
+/// \p PIC is a llvm::PassInstrumentationCallbacks: the registration methods
+/// available depend on the LLVM version.
+template<typename T>
+inline void tracePasses(T &PIC) {
+  if (not isTracingEnabled())
+    return;
+
+  auto Begin = [](llvm::StringRef Name, auto &&...) {
+    beginPassTraceEvent(Name);
+  };
+  auto End = [](llvm::StringRef, llvm::Any IR, auto &&...) {
+    endPassTraceEvent(countInstructions(IR));
+  };
+  auto Invalidated = [](llvm::StringRef, auto &&...) { endPassTraceEvent(); };
+
+  if constexpr (requires { PIC.registerBeforeNonSkippedPassCallback(Begin); }) {
+    PIC.registerBeforeNonSkippedPassCallback(Begin);
+  } else {
+    PIC.registerBeforePassCallback([](llvm::StringRef Name, auto &&...) {
+      beginPassTraceEvent(Name);
+      return true;
+    });
+  }
+
+  PIC.registerAfterPassCallback(End);
+  PIC.registerAfterPassInvalidatedCallback(Invalidated);
+}
@@ -135,7 +135,10 @@ enum Values {
   FunctionSymbol = 1024,
   /// Immediate value in the IR, usually a return address
   SimpleLiteral = 2048,
-  LastReason = SimpleLiteral
+  /// Found by the linear sweep of the executable segments, e.g., a function
+  /// prologue or the start of an FDE
+  LinearSweep = 4096,
+  LastReason = LinearSweep
 };
 
 inline const char *getName(Values Reason) {
@@ -164,6 +167,8 @@ inline const char *getName(Values Reason) {
     return "FunctionSymbol";
   case SimpleLiteral:
     return "SimpleLiteral";
+  case LinearSweep:
+    return "LinearSweep";
   }
 
   revng_abort();
@@ -194,6 +199,8 @@ inline Values fromName(llvm::StringRef ReasonName) {
     return FunctionSymbol;
   else if (ReasonName == "SimpleLiteral")
     return SimpleLiteral;
+  else if (ReasonName == "LinearSweep")
+    return LinearSweep;
   else
     revng_abort();
 }
@@ -16,6 +16,12 @@ bool isDataFlowSink(const llvm::Instruction *Ins);
 
 using BitLivenessAnalysisResults = std::map<llvm::Instruction *, uint32_t>;
 
+/// \brief Compute the alive bits of each instruction of \p F
+///
+/// \note The IR is not modified, therefore this can run concurrently on
+///       distinct functions.
+BitLivenessAnalysisResults computeBitLiveness(llvm::Function &F);
+
 class BitLivenessWrapperPass : public llvm::FunctionPass {
 public:
   static char ID; // Pass identification, replacement for typeid
@@ -5,18 +5,28 @@
 //
 
 #include <compare>
+#include <condition_variable>
 #include <cstddef>
+#include <limits>
 #include <map>
+#include <mutex>
 #include <queue>
+#include <thread>
 #include <type_traits>
+#include <vector>
 
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/GraphTraits.h"
 #include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallSet.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include "revng/ADT/GenericGraph.h"
 #include "revng/ADT/ReversePostOrderTraversal.h"
+#include "revng/Support/Assert.h"
 #include "revng/Support/Concepts.h"
 
 namespace TypeShrinking {
@@ -140,4 +150,399 @@ getMaximalFixedPoint(const typename MFI::GraphType &Flow,
   return AnalysisResult;
 }
 
+/// \brief Results of getMaximalFixedPointDense
+///
+/// Labels are numbered densely, in the order they have been visited, and the
+/// results are stored in a vector indexed by such number.
+template<typename Label, typename LatticeElement>
+class DenseMFPResults {
+public:
+  using ResultType = MFPResult<LatticeElement>;
+
+private:
+  std::vector<Label> Labels;
+  std::vector<ResultType> Results;
+  llvm::DenseMap<Label, uint32_t> Indices;
+
+public:
+  DenseMFPResults(std::vector<Label> Labels,
+                  std::vector<ResultType> Results,
+                  llvm::DenseMap<Label, uint32_t> Indices) :
+    Labels(std::move(Labels)),
+    Results(std::move(Results)),
+    Indices(std::move(Indices)) {}
+
+public:
+  size_t size() const { return Labels.size(); }
+
+  llvm::ArrayRef<Label> labels() const { return Labels; }
+  llvm::ArrayRef<ResultType> results() const { return Results; }
+
+  /// \return a range of (Label, MFPResult) pairs, in visit order
+  auto entries() const { return llvm::zip(Labels, Results); }
+
+  const ResultType &at(Label L) const {
+    auto It = Indices.find(L);
+    revng_assert(It != Indices.end());
+    return Results[It->second];
+  }
+};
+
+/// \brief Graph of a monotone framework instance with densely numbered labels
+///
+/// Labels are numbered in the same order getMaximalFixedPoint assigns
+/// priorities: reverse post order starting from the entry node, if any, then
+/// from the extremal nodes and finally from the remaining nodes. Successors are
+/// stored as indices.
+template<typename Label>
+struct DenseFlowGraph {
+  std::vector<Label> Labels;
+  llvm::DenseMap<Label, uint32_t> Indices;
+  std::vector<uint32_t> SuccessorsStart;
+  std::vector<uint32_t> Successors;
+
+  size_t size() const { return Labels.size(); }
+
+  llvm::ArrayRef<uint32_t> successors(uint32_t Index) const {
+    uint32_t Start = SuccessorsStart[Index];
+    return llvm::ArrayRef<uint32_t>(Successors)
+      .slice(Start, SuccessorsStart[Index + 1] - Start);
+  }
+};
+
+template<MonotoneFrameworkInstance MFI,
+         typename GT = llvm::GraphTraits<typename MFI::GraphType>>
+DenseFlowGraph<typename MFI::Label>
+buildDenseFlowGraph(const typename MFI::GraphType &Flow,
+                    const std::vector<typename MFI::Label> &Extremals) {
+  using Label = typename MFI::Label;
+
+  DenseFlowGraph<Label> Result;
+  llvm::SmallSet<Label, 8> Visited{};
+  auto Visit = [&](Label Start) {
+    ReversePostOrderTraversalExt RPOTE(Start, Visited);
+    for (Label Node : RPOTE) {
+      Result.Indices[Node] = Result.Labels.size();
+      Result.Labels.push_back(Node);
+    }
+  };
+
+  if (GT::getEntryNode(Flow) != nullptr)
+    Visit(GT::getEntryNode(Flow));
+
+  for (Label Start : Extremals)
+    if (Visited.count(Start) == 0)
+      Visit(Start);
+
+  for (Label Start : llvm::nodes(Flow))
+    if (Visited.count(Start) == 0)
+      Visit(Start);
+
+  // Translate the successors into indices
+  Result.SuccessorsStart.reserve(Result.size() + 1);
+  for (Label Node : Result.Labels) {
+    Result.SuccessorsStart.push_back(Result.Successors.size());
+    for (Label Successor : successors<GT>(Node))
+      Result.Successors.push_back(Result.Indices.lookup(Successor));
+  }
+  Result.SuccessorsStart.push_back(Result.Successors.size());
+
+  return Result;
+}
+
+/// \brief Variant of getMaximalFixedPoint for large graphs
+///
+/// Labels are numbered upfront in the same order getMaximalFixedPoint
+/// assigns priorities, therefore the results are the same. The lattice
+/// elements are kept in a vector and the worklist is a bit vector, scanned
+/// from the lowest index, i.e., the highest priority.
+///
+/// \note Label must be usable as a key of llvm::DenseMap.
+template<MonotoneFrameworkInstance MFI,
+         typename GT = llvm::GraphTraits<typename MFI::GraphType>>
+DenseMFPResults<typename MFI::Label, typename MFI::LatticeElement>
+getMaximalFixedPointDense(const typename MFI::GraphType &Flow,
+                          typename MFI::LatticeElement InitialValue,
+                          typename MFI::LatticeElement ExtremalValue,
+                          const std::vector<typename MFI::Label> &Extremals) {
+  using Label = typename MFI::Label;
+  using LatticeElement = typename MFI::LatticeElement;
+
+  // Step 1 number the labels
+  auto Graph = buildDenseFlowGraph<MFI, GT>(Flow, Extremals);
+
+  std::vector<LatticeElement> Values(Graph.size(), InitialValue);
+  for (Label ExtremalLabel : Extremals)
+    Values[Graph.Indices.lookup(ExtremalLabel)] = ExtremalValue;
+
+  // Step 2 iteration
+  llvm::BitVector Worklist(Graph.size(), true);
+
+  // No bit before Lowest is set
+  uint32_t Lowest = 0;
+  while (true) {
+    int Found = Worklist.find_first_in(Lowest, Worklist.size());
+    if (Found == -1)
+      break;
+
+    uint32_t Start = Found;
+    Worklist.reset(Start);
+    Lowest = Start;
+
+    LatticeElement Updated = MFI::applyTransferFunction(Graph.Labels[Start],
+                                                        Values[Start]);
+    for (uint32_t End : Graph.successors(Start)) {
+      LatticeElement &PartialEnd = Values[End];
+      if (not MFI::isLessOrEqual(Updated, PartialEnd)) {
+        PartialEnd = MFI::combineValues(PartialEnd, Updated);
+        Worklist.set(End);
+        Lowest = std::min(Lowest, End);
+      }
+    }
+  }
+
+  // Step 3 presenting the results
+  using ResultType = MFPResult<LatticeElement>;
+  std::vector<ResultType> Results;
+  Results.reserve(Graph.size());
+  for (uint32_t I = 0; I < Graph.size(); ++I)
+    Results.push_back({ Values[I],
+                        MFI::applyTransferFunction(Graph.Labels[I],
+                                                   Values[I]) });
+
+  using ResultsType = DenseMFPResults<Label, LatticeElement>;
+  return ResultsType(std::move(Graph.Labels),
+                     std::move(Results),
+                     std::move(Graph.Indices));
+}
+
+/// \brief Compute the strongly connected components of \p Graph
+///
+/// \return the index of the component of each label. Components are numbered
+///         in reverse topological order: if there's an edge from A to B, the
+///         component of B has an index lower than or equal to the one of A.
+template<typename Label>
+std::vector<uint32_t>
+computeComponents(const DenseFlowGraph<Label> &Graph, uint32_t &Count) {
+  const uint32_t Unvisited = std::numeric_limits<uint32_t>::max();
+  std::vector<uint32_t> Component(Graph.size(), Unvisited);
+  std::vector<uint32_t> Order(Graph.size(), Unvisited);
+  std::vector<uint32_t> LowLink(Graph.size(), 0);
+  std::vector<uint32_t> Stack;
+
+  // Iterative version of Tarjan's algorithm: each frame is a label and the
+  // position of the next successor to explore
+  std::vector<std::pair<uint32_t, uint32_t>> Frames;
+  uint32_t NextOrder = 0;
+  Count = 0;
+
+  for (uint32_t Root = 0; Root < Graph.size(); ++Root) {
+    if (Order[Root] != Unvisited)
+      continue;
+
+    Frames.push_back({ Root, 0 });
+    Order[Root] = LowLink[Root] = NextOrder++;
+    Stack.push_back(Root);
+
+    while (not Frames.empty()) {
+      auto &[Node, Position] = Frames.back();
+      llvm::ArrayRef<uint32_t> Successors = Graph.successors(Node);
+
+      if (Position < Successors.size()) {
+        uint32_t Successor = Successors[Position++];
+        if (Order[Successor] == Unvisited) {
+          Order[Successor] = LowLink[Successor] = NextOrder++;
+          Stack.push_back(Successor);
+          Frames.push_back({ Successor, 0 });
+        } else if (Component[Successor] == Unvisited) {
+          LowLink[Node] = std::min(LowLink[Node], Order[Successor]);
+        }
+        continue;
+      }
+
+      // All the successors have been explored
+      uint32_t Done = Node;
+      Frames.pop_back();
+      if (not Frames.empty()) {
+        uint32_t Parent = Frames.back().first;
+        LowLink[Parent] = std::min(LowLink[Parent], LowLink[Done]);
+      }
+
+      if (LowLink[Done] == Order[Done]) {
+        uint32_t Member = 0;
+        do {
+          Member = Stack.back();
+          Stack.pop_back();
+          Component[Member] = Count;
+        } while (Member != Done);
+        ++Count;
+      }
+    }
+  }
+
+  return Component;
+}
+
+/// \brief Variant of getMaximalFixedPointDense solving independent strongly
+///        connected components concurrently
+///
+/// The components are solved in topological order: a component is enqueued
+/// once all the components with an edge towards it have reached their fixed
+/// point, and then it is solved in isolation using the same priorities of
+/// getMaximalFixedPointDense. Since each component only reads the final
+/// results of its predecessors, the results do not depend on the scheduling.
+///
+/// Graphs with less than \p MinimumSize labels, or if \p ThreadsCount is not
+/// greater than one, are handled by getMaximalFixedPointDense.
+///
+/// \note MFI::applyTransferFunction must be safe to call concurrently.
+template<MonotoneFrameworkInstance MFI,
+         typename GT = llvm::GraphTraits<typename MFI::GraphType>>
+DenseMFPResults<typename MFI::Label, typename MFI::LatticeElement>
+getMaximalFixedPointParallel(const typename MFI::GraphType &Flow,
+                             typename MFI::LatticeElement InitialValue,
+                             typename MFI::LatticeElement ExtremalValue,
+                             const std::vector<typename MFI::Label> &Extremals,
+                             unsigned ThreadsCount,
+                             size_t MinimumSize = 1024) {
+  using Label = typename MFI::Label;
+  using LatticeElement = typename MFI::LatticeElement;
+
+  auto Graph = buildDenseFlowGraph<MFI, GT>(Flow, Extremals);
+  if (ThreadsCount <= 1 or Graph.size() < MinimumSize)
+    return getMaximalFixedPointDense<MFI, GT>(Flow,
+                                              InitialValue,
+                                              ExtremalValue,
+                                              Extremals);
+
+  uint32_t ComponentsCount = 0;
+  std::vector<uint32_t> Component = computeComponents(Graph, ComponentsCount);
+
+  // Collect the members of each component, in priority order, and the
+  // predecessors of each label
+  std::vector<std::vector<uint32_t>> Members(ComponentsCount);
+  std::vector<std::vector<uint32_t>> Predecessors(Graph.size());
+  std::vector<uint32_t> Pending(ComponentsCount, 0);
+  for (uint32_t I = 0; I < Graph.size(); ++I) {
+    Members[Component[I]].push_back(I);
+    for (uint32_t Successor : Graph.successors(I)) {
+      Predecessors[Successor].push_back(I);
+      if (Component[Successor] != Component[I])
+        ++Pending[Component[Successor]];
+    }
+  }
+
+  std::vector<LatticeElement> Values(Graph.size(), InitialValue);
+  for (Label ExtremalLabel : Extremals)
+    Values[Graph.Indices.lookup(ExtremalLabel)] = ExtremalValue;
+  std::vector<LatticeElement> OutValues(Graph.size());
+
+  // Position of each label in the vector of members of its component
+  std::vector<uint32_t> Position(Graph.size());
+  for (const std::vector<uint32_t> &List : Members)
+    for (uint32_t I = 0; I < List.size(); ++I)
+      Position[List[I]] = I;
+
+  auto Solve = [&](uint32_t Current) {
+    const std::vector<uint32_t> &List = Members[Current];
+
+    // Merge the final results of the predecessors in other components
+    for (uint32_t Index : List) {
+      LatticeElement &Partial = Values[Index];
+      for (uint32_t Predecessor : Predecessors[Index]) {
+        if (Component[Predecessor] == Current)
+          continue;
+
+        const LatticeElement &Incoming = OutValues[Predecessor];
+        if (not MFI::isLessOrEqual(Incoming, Partial))
+          Partial = MFI::combineValues(Partial, Incoming);
+      }
+    }
+
+    // Solve the component in isolation
+    llvm::BitVector Worklist(List.size(), true);
+    while (true) {
+      int Found = Worklist.find_first();
+      if (Found == -1)
+        break;
+
+      Worklist.reset(Found);
+      uint32_t Start = List[Found];
+      LatticeElement Updated = MFI::applyTransferFunction(Graph.Labels[Start],
+                                                          Values[Start]);
+      for (uint32_t End : Graph.successors(Start)) {
+        if (Component[End] != Current)
+          continue;
+
+        LatticeElement &PartialEnd = Values[End];
+        if (not MFI::isLessOrEqual(Updated, PartialEnd)) {
+          PartialEnd = MFI::combineValues(PartialEnd, Updated);
+          Worklist.set(Position[End]);
+        }
+      }
+    }
+
+    for (uint32_t Index : List)
+      OutValues[Index] = MFI::applyTransferFunction(Graph.Labels[Index],
+                                                    Values[Index]);
+  };
+
+  // Schedule the components as soon as all their predecessors are done
+  std::mutex Lock;
+  std::condition_variable Changed;
+  std::vector<uint32_t> Ready;
+  for (uint32_t I = 0; I < ComponentsCount; ++I)
+    if (Pending[I] == 0)
+      Ready.push_back(I);
+  uint32_t Completed = 0;
+
+  auto Worker = [&]() {
+    std::unique_lock<std::mutex> Guard(Lock);
+    while (true) {
+      Changed.wait(Guard, [&] {
+        return not Ready.empty() or Completed == ComponentsCount;
+      });
+      if (Ready.empty())
+        return;
+
+      uint32_t Current = Ready.back();
+      Ready.pop_back();
+
+      Guard.unlock();
+      Solve(Current);
+      Guard.lock();
+
+      ++Completed;
+      for (uint32_t Index : Members[Current])
+        for (uint32_t Successor : Graph.successors(Index))
+          if (Component[Successor] != Current
+              and --Pending[Component[Successor]] == 0)
+            Ready.push_back(Component[Successor]);
+
+      Changed.notify_all();
+    }
+  };
+
+  std::vector<std::thread> Threads;
+  for (unsigned I = 0; I < ThreadsCount; ++I)
+    Threads.emplace_back(Worker);
+
+  for (std::thread &Thread : Threads)
+    Thread.join();
+
+  revng_assert(Completed == ComponentsCount);
+
+  // Present the results
+  using ResultType = MFPResult<LatticeElement>;
+  std::vector<ResultType> Results;
+  Results.reserve(Graph.size());
+  for (uint32_t I = 0; I < Graph.size(); ++I)
+    Results.push_back({ std::move(Values[I]), std::move(OutValues[I]) });
+
+  using ResultsType = DenseMFPResults<Label, LatticeElement>;
+  return ResultsType(std::move(Graph.Labels),
+                     std::move(Results),
+                     std::move(Graph.Indices));
+}
+
 } // namespace TypeShrinking
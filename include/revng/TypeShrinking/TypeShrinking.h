@@ -7,6 +7,7 @@
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/PassManager.h"
 #include "llvm/Transforms/Scalar.h"
 
 namespace TypeShrinking {
@@ -28,6 +29,26 @@ public:
   void getAnalysisUsage(llvm::AnalysisUsage &AU) const override;
 };
 
+/// \brief Run type shrinking on all the functions of the module
+///
+/// The bit liveness of independent functions is computed on a pool of
+/// threads, the IR is then shrunk one function at a time on the main thread.
+/// See runFunctionPipeline.
+class TypeShrinkingModulePass
+  : public llvm::PassInfoMixin<TypeShrinkingModulePass> {
+public:
+  llvm::PreservedAnalyses run(llvm::Module &M, llvm::ModuleAnalysisManager &);
+};
+
+/// \brief Legacy pass manager version of TypeShrinkingModulePass
+class TypeShrinkingModuleWrapperPass : public llvm::ModulePass {
+public:
+  static char ID; // Pass identification, replacement for typeid
+  TypeShrinkingModuleWrapperPass() : ModulePass(ID) {}
+
+  bool runOnModule(llvm::Module &M) override;
+};
+
 void applyTypeShrinking(llvm::legacy::FunctionPassManager &PM);
 
 } // namespace TypeShrinking
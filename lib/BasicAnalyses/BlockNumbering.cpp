@@ -0,0 +1,100 @@
+/// \file BlockNumbering.cpp
+/// \brief Numbers the basic blocks of a function in reverse post order
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Function.h"
+
+#include "revng/BasicAnalyses/BlockNumbering.h"
+
+using namespace llvm;
+
+AnalysisKey BlockNumberingAnalysis::Key;
+
+BlockNumbering BlockNumbering::compute(Function &F, const LoopInfo *LI) {
+  BlockNumbering Result;
+  if (F.empty())
+    return Result;
+
+  // Iterative depth first visit, recording pre and post order numbers
+  struct Pending {
+    BasicBlock *BB;
+    succ_iterator Next;
+  };
+  std::vector<Pending> Stack;
+  std::vector<BasicBlock *> PostOrder;
+  DenseMap<const BasicBlock *, uint32_t> PreOrderNumbers;
+
+  auto Enter = [&](BasicBlock *BB) {
+    PreOrderNumbers[BB] = PreOrderNumbers.size();
+    Stack.push_back({ BB, succ_begin(BB) });
+  };
+
+  Enter(&F.getEntryBlock());
+  while (not Stack.empty()) {
+    Pending &Top = Stack.back();
+    if (Top.Next == succ_end(Top.BB)) {
+      PostOrder.push_back(Top.BB);
+      Stack.pop_back();
+      continue;
+    }
+
+    BasicBlock *Successor = *Top.Next;
+    ++Top.Next;
+    if (PreOrderNumbers.count(Successor) == 0)
+      Enter(Successor);
+  }
+
+  // Assign the numbers following the reverse post order
+  uint32_t Count = PostOrder.size();
+  Result.RPO.assign(PostOrder.rbegin(), PostOrder.rend());
+  Result.BlockNumbers.resize(Count);
+  Result.Indices.reserve(Count);
+  for (uint32_t I = 0; I < Count; ++I) {
+    BasicBlock *BB = Result.RPO[I];
+    Result.Indices[BB] = I;
+    Numbers &N = Result.BlockNumbers[I];
+    N.PreOrder = PreOrderNumbers.lookup(BB);
+    N.PostOrder = Count - 1 - I;
+    N.LoopDepth = LI != nullptr ? LI->getLoopDepth(BB) : 0;
+  }
+
+  return Result;
+}
+
+bool BlockNumberingAnalysis::Result::invalidate(Function &,
+                                                const PreservedAnalyses &PA,
+                                                FunctionAnalysisManager::
+                                                  Invalidator &) {
+  auto PAC = PA.getChecker<BlockNumberingAnalysis>();
+  return not(PAC.preserved() or PAC.preservedSet<CFGAnalyses>());
+}
+
+BlockNumberingAnalysis::Result
+BlockNumberingAnalysis::run(Function &F, FunctionAnalysisManager &FAM) {
+  return BlockNumbering::compute(F, &FAM.getResult<LoopAnalysis>(F));
+}
+
+char BlockNumberingWrapperPass::ID = 0;
+using RegisterBlockNumbering = RegisterPass<BlockNumberingWrapperPass>;
+static RegisterBlockNumbering X("block-numbering",
+                                "Block Numbering",
+                                true,
+                                true);
+
+bool BlockNumberingWrapperPass::runOnFunction(Function &F) {
+  const LoopInfo &LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+  Numbering = BlockNumbering::compute(F, &LI);
+  return false;
+}
+
+void BlockNumberingWrapperPass::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.setPreservesAll();
+  AU.addRequired<LoopInfoWrapperPass>();
+}
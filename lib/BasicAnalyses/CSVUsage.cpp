@@ -0,0 +1,57 @@
+/// \file CSVUsage.cpp
+/// \brief Computes the CSVs directly accessed by a function
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+
+#include "revng/BasicAnalyses/CSVUsage.h"
+#include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
+#include "revng/Support/IRHelpers.h"
+
+using namespace llvm;
+
+AnalysisKey CSVUsageAnalysis::Key;
+
+FunctionCSVUsage
+FunctionCSVUsage::compute(Function &F, const std::set<GlobalVariable *> &CSVs) {
+  FunctionCSVUsage Result;
+
+  auto AsCSV = [&CSVs](Value *Pointer) -> GlobalVariable * {
+    auto *CSV = dyn_cast<GlobalVariable>(skipCasts(Pointer));
+    return CSVs.count(CSV) != 0 ? CSV : nullptr;
+  };
+
+  for (BasicBlock &BB : F) {
+    for (Instruction &I : BB) {
+      if (auto *Store = dyn_cast<StoreInst>(&I)) {
+        if (GlobalVariable *CSV = AsCSV(Store->getPointerOperand()))
+          Result.Written.insert(CSV);
+      } else if (auto *Load = dyn_cast<LoadInst>(&I)) {
+        if (GlobalVariable *CSV = AsCSV(Load->getPointerOperand()))
+          Result.Read.insert(CSV);
+      } else if (isa<CallInst>(&I)) {
+        Function *Callee = getCallee(&I);
+        if (Callee == nullptr or Callee->isIntrinsic())
+          continue;
+
+        // In case we meet an `abort` skip the rest of this block
+        if (Callee->getName() == "abort")
+          break;
+
+        Result.Callees.insert(Callee);
+      }
+    }
+  }
+
+  return Result;
+}
+
+CSVUsageAnalysis::Result
+CSVUsageAnalysis::run(Function &F, FunctionAnalysisManager &) {
+  auto CSVs = GeneratedCodeBasicInfo::collectCSVs(*F.getParent());
+  return FunctionCSVUsage::compute(F, { CSVs.begin(), CSVs.end() });
+}
@@ -10,6 +10,7 @@
 #include "llvm/IR/Module.h"
 
 #include "revng/BasicAnalyses/EmptyNewPC.h"
+#include "revng/BasicAnalyses/ModuleCleanup.h"
 #include "revng/Support/IRHelpers.h"
 
 using namespace llvm;
@@ -18,10 +19,21 @@ char EmptyNewPC::ID = 0;
 using Register = RegisterPass<EmptyNewPC>;
 static Register X("empty-newpc", "Create an empty newpc function", true, true);
 
+/// Only the body of `newpc` changes, no need to walk the module
+class EmptyNewPCStep : public CleanupStep {
+public:
+  bool finalize(Module &M) override {
+    LLVMContext &Context = getContext(&M);
+    Function *NewPCFunction = M.getFunction("newpc");
+    NewPCFunction->deleteBody();
+    ReturnInst::Create(Context, BasicBlock::Create(Context, "", NewPCFunction));
+    return true;
+  }
+};
+
+static RegisterCleanupStep<EmptyNewPCStep> Y("empty-newpc");
+
 bool EmptyNewPC::runOnModule(llvm::Module &M) {
-  LLVMContext &Context = getContext(&M);
-  Function *NewPCFunction = M.getFunction("newpc");
-  NewPCFunction->deleteBody();
-  ReturnInst::Create(Context, BasicBlock::Create(Context, "", NewPCFunction));
-  return false;
+  EmptyNewPCStep Step;
+  return ModuleCleanup({ &Step }).run(M);
 }
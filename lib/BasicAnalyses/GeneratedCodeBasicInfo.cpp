@@ -30,6 +30,7 @@ void GeneratedCodeBasicInfo::run(Module &M) {
   NewPC = M.getFunction("newpc");
   if (NewPC != nullptr) {
     MetaAddressStruct = cast<StructType>(NewPC->arg_begin()->getType());
+    MAConstants = MetaAddressConstants(MetaAddressStruct);
   }
 
   revng_log(PassesLog, "Starting GeneratedCodeBasicInfo");
@@ -86,12 +87,8 @@ void GeneratedCodeBasicInfo::run(Module &M) {
         UnexpectedPC = &BB;
         break;
 
-      case BlockType::JumpTargetBlock: {
-        auto *Call = cast<CallInst>(&*BB.begin());
-        revng_assert(Call->getCalledFunction()->getName() == "newpc");
-        JumpTargets[MetaAddress::fromConstant(Call->getArgOperand(0))] = &BB;
-        break;
-      }
+      case BlockType::JumpTargetBlock:
+        // Collected by initializeJumpTargets
       case BlockType::RootDispatcherHelperBlock:
       case BlockType::IndirectBranchDispatcherHelperBlock:
       case BlockType::EntryPoint:
@@ -103,18 +100,83 @@ void GeneratedCodeBasicInfo::run(Module &M) {
     }
   }
 
+  initializeJumpTargets();
+
+  CSVs = collectCSVs(M);
+
+  revng_log(PassesLog, "Ending GeneratedCodeBasicInfo");
+}
+
+void GeneratedCodeBasicInfo::initializeJumpTargets() {
+  JumpTargets.clear();
+
+  for (BasicBlock &BB : *RootFunction) {
+    if (not BB.empty() and isJumpTarget(&BB)) {
+      MetaAddress JumpTarget = getPCFromNewPC(&BB);
+      revng_assert(JumpTarget.isValid());
+      JumpTargets.emplace_back(JumpTarget, &BB);
+    }
+  }
+
+  llvm::sort(JumpTargets, [](const AddressToBlock &LHS,
+                             const AddressToBlock &RHS) {
+    return LHS.first < RHS.first;
+  });
+
+  auto SameAddress = [](const AddressToBlock &LHS, const AddressToBlock &RHS) {
+    return LHS.first == RHS.first;
+  };
+  revng_assert(std::adjacent_find(JumpTargets.begin(),
+                                  JumpTargets.end(),
+                                  SameAddress)
+               == JumpTargets.end());
+}
+
+void GeneratedCodeBasicInfo::invalidate(Function *F) {
+  DTMap.erase(F);
+
+  if (F == RootFunction) {
+    PCToBlockCache.clear();
+    initializeJumpTargets();
+  }
+}
+
+bool GeneratedCodeBasicInfo::invalidate(Module &,
+                                        const PreservedAnalyses &PA,
+                                        ModuleAnalysisManager::Invalidator &) {
+  auto Checker = PA.getChecker<GeneratedCodeBasicInfoAnalysis>();
+  return not(Checker.preserved()
+             or Checker.preservedSet<AllAnalysesOn<Module>>());
+}
+
+bool GeneratedCodeBasicInfo::invalidate(Function &F,
+                                        const PreservedAnalyses &PA,
+                                        FunctionAnalysisManager::Invalidator &) {
+  auto Checker = PA.getChecker<GeneratedCodeBasicInfoAnalysis>();
+  if (not(Checker.preserved() or Checker.preservedSet<CFGAnalyses>()))
+    invalidate(&F);
+
+  // The information about the rest of the module is still valid
+  return false;
+}
+
+std::vector<GlobalVariable *>
+GeneratedCodeBasicInfo::collectCSVs(const Module &M) {
+  std::vector<GlobalVariable *> Result;
+
   if (auto *NamedMD = M.getNamedMetadata("revng.csv")) {
+    QuickMetadata QMD(M.getContext());
     auto *Tuple = cast<MDTuple>(NamedMD->getOperand(0));
     for (const MDOperand &Operand : Tuple->operands()) {
       if (Operand.get() == nullptr)
         continue;
 
       auto *CSV = cast<GlobalVariable>(QMD.extract<Constant *>(Operand.get()));
-      CSVs.push_back(CSV);
+      Result.push_back(CSV);
     }
   }
 
-  revng_log(PassesLog, "Ending GeneratedCodeBasicInfo");
+  return Result;
 }
 
 GeneratedCodeBasicInfo::SuccessorsList
@@ -212,6 +274,8 @@ GeneratedCodeBasicInfo::getJumpTargetBlock(llvm::BasicBlock *BB) {
 }
 
 void GeneratedCodeBasicInfo::initializePCToBlockCache() {
+  PCToBlockCache.clear();
+
   const DominatorTree &DT = getDomTree(RootFunction);
   for (BasicBlock &BB : *RootFunction) {
     if (not GeneratedCodeBasicInfo::isTranslated(&BB))
@@ -228,8 +292,14 @@ void GeneratedCodeBasicInfo::initializePCToBlockCache() {
       revng_assert(DTNode != nullptr);
     }
 
-    PCToBlockCache.insert({ getBasicBlockPC(DTNode->getBlock()), &BB });
+    PCToBlockCache.emplace_back(getBasicBlockPC(DTNode->getBlock()), &BB);
   }
+
+  // Sort in bulk, preserving the order of the blocks generated by the same PC
+  llvm::stable_sort(PCToBlockCache,
+                    [](const AddressToBlock &LHS, const AddressToBlock &RHS) {
+                      return LHS.first < RHS.first;
+                    });
 }
 
 GeneratedCodeBasicInfo
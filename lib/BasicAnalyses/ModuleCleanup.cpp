@@ -0,0 +1,93 @@
+/// \file ModuleCleanup.cpp
+/// \brief Run several cleanup passes walking the module only once.
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <map>
+#include <string>
+
+#include "llvm/Support/CommandLine.h"
+
+#include "revng/BasicAnalyses/ModuleCleanup.h"
+#include "revng/Support/Assert.h"
+
+using namespace llvm;
+
+static std::map<std::string, CleanupStepFactory> &cleanupSteps() {
+  static std::map<std::string, CleanupStepFactory> Result;
+  return Result;
+}
+
+void registerCleanupStep(StringRef Name, CleanupStepFactory Factory) {
+  bool New = cleanupSteps().emplace(Name.str(), Factory).second;
+  revng_assert(New);
+}
+
+void ModuleCleanup::visit(Function &F) {
+  SmallVector<CleanupStep *, 4> Interested;
+  for (CleanupStep *Step : Steps)
+    if (Step->shouldVisit(F))
+      Interested.push_back(Step);
+
+  if (Interested.empty())
+    return;
+
+  for (CleanupStep *Step : Interested)
+    Step->visitFunction(F);
+
+  for (BasicBlock &BB : F)
+    for (Instruction &I : BB)
+      for (CleanupStep *Step : Interested)
+        Step->visitInstruction(I);
+}
+
+bool ModuleCleanup::run(Module &M) {
+  for (Function &F : M)
+    visit(F);
+
+  bool Changed = false;
+  for (CleanupStep *Step : Steps)
+    Changed = Step->finalize(M) or Changed;
+
+  return Changed;
+}
+
+bool ModuleCleanup::run(Function &F) {
+  visit(F);
+
+  bool Changed = false;
+  for (CleanupStep *Step : Steps)
+    Changed = Step->finalize(*F.getParent()) or Changed;
+
+  return Changed;
+}
+
+static cl::list<std::string> CleanupSteps("cleanup-steps",
+                                          cl::desc("the cleanup passes to "
+                                                   "run in --module-cleanup"),
+                                          cl::value_desc("pass"),
+                                          cl::CommaSeparated);
+
+char ModuleCleanupPass::ID = 0;
+
+using Register = RegisterPass<ModuleCleanupPass>;
+static Register X("module-cleanup",
+                  "Run the passes in -cleanup-steps in a single walk",
+                  true,
+                  true);
+
+bool ModuleCleanupPass::runOnModule(Module &M) {
+  std::vector<std::unique_ptr<CleanupStep>> Owned;
+  std::vector<CleanupStep *> Steps;
+  for (const std::string &Name : CleanupSteps) {
+    auto It = cleanupSteps().find(Name);
+    revng_check(It != cleanupSteps().end(), "Unknown cleanup step");
+
+    Owned.push_back(It->second());
+    Steps.push_back(Owned.back().get());
+  }
+
+  return ModuleCleanup(Steps).run(M);
+}
@@ -9,6 +9,7 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Metadata.h"
 
+#include "revng/BasicAnalyses/ModuleCleanup.h"
 #include "revng/BasicAnalyses/RemoveDbgMetadata.h"
 #include "revng/Support/FunctionTags.h"
 
@@ -19,14 +20,30 @@ char RemoveDbgMetadata::ID = 0;
 using Register = RegisterPass<RemoveDbgMetadata>;
 static Register X("remove-dbg-metadata", "Removes dbg metadata from Functions");
 
-bool RemoveDbgMetadata::runOnFunction(llvm::Function &F) {
-  if (not FunctionTags::Lifted.isTagOf(&F))
-    return false;
+class RemoveDbgMetadataStep : public CleanupStep {
+private:
+  bool Changed = false;
+
+public:
+  bool shouldVisit(Function &F) override {
+    return FunctionTags::Lifted.isTagOf(&F);
+  }
+
+  void visitFunction(Function &F) override {
+    F.setMetadata(LLVMContext::MD_dbg, nullptr);
+    Changed = true;
+  }
 
-  F.setMetadata(LLVMContext::MD_dbg, nullptr);
-  for (BasicBlock &BB : F)
-    for (Instruction &I : BB)
-      I.setMetadata(LLVMContext::MD_dbg, nullptr);
+  void visitInstruction(Instruction &I) override {
+    I.setMetadata(LLVMContext::MD_dbg, nullptr);
+  }
 
-  return true;
+  bool finalize(Module &) override { return Changed; }
+};
+
+static RegisterCleanupStep<RemoveDbgMetadataStep> Y("remove-dbg-metadata");
+
+bool RemoveDbgMetadata::runOnFunction(llvm::Function &F) {
+  RemoveDbgMetadataStep Step;
+  return ModuleCleanup({ &Step }).run(F);
 }
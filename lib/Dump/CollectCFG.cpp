@@ -5,10 +5,16 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/IR/CFG.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
 
-#include "revng/ADT/Queue.h"
 #include "revng/Dump/CollectCFG.h"
 #include "revng/Support/CommandLine.h"
 #include "revng/Support/IRHelpers.h"
@@ -26,16 +32,16 @@ static opt<std::string> OutputPath("collect-cfg-output",
                                    value_desc("path"),
                                    cat(MainCategory));
 
-void CollectCFG::serialize(std::ostream &Output) {
-  Output << "source,destination\n";
-  for (auto &P : Result) {
-    BasicBlock *Source = P.first;
-    std::sort(P.second.begin(), P.second.end(), CompareByName<BasicBlock>());
-    for (BasicBlock *Destination : P.second)
-      Output << Source->getName().data() << "," << Destination->getName().data()
-             << "\n";
-  }
-}
+static opt<unsigned> ThreadsCount("collect-cfg-threads",
+                                  init(1),
+                                  desc("number of threads collecting the "
+                                       "successors of the instructions"),
+                                  value_desc("threads"),
+                                  cat(MainCategory));
+
+/// Number of instructions whose successors are kept in memory before being
+/// written out
+static constexpr size_t ChunkSize = 1 << 14;
 
 bool CollectCFG::isNewInstruction(BasicBlock *BB) {
   if (BB->empty())
@@ -49,10 +55,11 @@ bool CollectCFG::isNewInstruction(BasicBlock *BB) {
   return true;
 }
 
-bool CollectCFG::runOnModule(Module &M) {
-  Function &F = *M.getFunction("root");
-  Result.clear();
+void CollectCFG::condense(Function &F) {
+  ComponentOf.clear();
+  Components.clear();
 
+  DenseSet<BasicBlock *> BlackList;
   for (BasicBlock &BB : F) {
     if (!isNewInstruction(&BB))
       BlackList.insert(&BB);
@@ -60,31 +67,186 @@ bool CollectCFG::runOnModule(Module &M) {
       break;
   }
 
-  // For each basic block
-  for (BasicBlock &BB : F) {
-    if (!isNewInstruction(&BB))
+  auto IsInternal = [&BlackList](BasicBlock *BB) {
+    return not isNewInstruction(BB) and BlackList.count(BB) == 0;
+  };
+
+  //
+  // Identify the strongly connected components of the internal blocks through
+  // an iterative version of Tarjan's algorithm. A component is completed after
+  // all those it can reach, therefore their indices are lower.
+  //
+  struct Frame {
+    BasicBlock *BB;
+    succ_iterator Next;
+  };
+  std::vector<Frame> DFS;
+  std::vector<BasicBlock *> Stack;
+  DenseMap<BasicBlock *, unsigned> Index;
+  DenseMap<BasicBlock *, unsigned> LowLink;
+
+  auto Push = [&](BasicBlock *BB) {
+    unsigned NewIndex = Index.size();
+    Index[BB] = NewIndex;
+    LowLink[BB] = NewIndex;
+    Stack.push_back(BB);
+    DFS.push_back({ BB, succ_begin(BB) });
+  };
+
+  for (BasicBlock &Root : F) {
+    if (not IsInternal(&Root) or Index.count(&Root) != 0)
       continue;
 
-    OnceQueue<BasicBlock *> Queue;
-    Queue.insert(&BB);
-    while (!Queue.empty()) {
-      BasicBlock *ToExplore = Queue.pop();
-      for (BasicBlock *Successor : successors(ToExplore)) {
-
-        // If it's a new instruction register it, otherwise enqueue the basic
-        // block for further processing
-        if (isNewInstruction(Successor)) {
-          Result[&BB].push_back(Successor);
-        } else if (BlackList.count(Successor) == 0) {
-          Queue.insert(Successor);
+    Push(&Root);
+    while (not DFS.empty()) {
+      BasicBlock *BB = DFS.back().BB;
+      succ_iterator &Next = DFS.back().Next;
+
+      if (Next != succ_end(BB)) {
+        BasicBlock *Successor = *Next++;
+        if (not IsInternal(Successor))
+          continue;
+
+        auto It = Index.find(Successor);
+        if (It == Index.end()) {
+          Push(Successor);
+        } else if (ComponentOf.count(Successor) == 0) {
+          // Successor is still on the stack
+          LowLink[BB] = std::min(LowLink[BB], It->second);
         }
+
+        continue;
       }
+
+      DFS.pop_back();
+      if (not DFS.empty()) {
+        unsigned &ParentLowLink = LowLink[DFS.back().BB];
+        ParentLowLink = std::min(ParentLowLink, LowLink[BB]);
+      }
+
+      if (LowLink[BB] != Index[BB])
+        continue;
+
+      // BB is the root of a component
+      unsigned ID = Components.size();
+      Components.emplace_back();
+      BasicBlock *Member = nullptr;
+      do {
+        Member = Stack.back();
+        Stack.pop_back();
+        ComponentOf[Member] = ID;
+      } while (Member != BB);
     }
   }
 
+  //
+  // Collect the edges leaving each component
+  //
+  std::vector<SmallVector<unsigned, 2>> Successors(Components.size());
+  for (auto [BB, ID] : ComponentOf) {
+    for (BasicBlock *Successor : successors(BB)) {
+      if (isNewInstruction(Successor)) {
+        Components[ID].Exits.push_back(Successor);
+      } else {
+        auto It = ComponentOf.find(Successor);
+        if (It != ComponentOf.end() and It->second != ID)
+          Successors[ID].push_back(It->second);
+      }
+    }
+  }
+
+  //
+  // Compose the reachable components, the successors come first
+  //
+  for (unsigned ID = 0; ID < Components.size(); ++ID) {
+    std::vector<unsigned> &Reachable = Components[ID].Reachable;
+    Reachable.push_back(ID);
+    for (unsigned Successor : Successors[ID])
+      llvm::append_range(Reachable, Components[Successor].Reachable);
+    llvm::sort(Reachable);
+    Reachable.erase(std::unique(Reachable.begin(), Reachable.end()),
+                    Reachable.end());
+  }
+}
+
+SmallVector<BasicBlock *, 2>
+CollectCFG::successorsOf(BasicBlock *BB) const {
+  SmallVector<BasicBlock *, 2> Result;
+  std::vector<unsigned> Reachable;
+
+  for (BasicBlock *Successor : successors(BB)) {
+    if (isNewInstruction(Successor)) {
+      Result.push_back(Successor);
+    } else {
+      auto It = ComponentOf.find(Successor);
+      if (It != ComponentOf.end())
+        llvm::append_range(Reachable, Components[It->second].Reachable);
+    }
+  }
+
+  // Each block is explored once, no matter how many paths lead to it
+  llvm::sort(Reachable);
+  Reachable.erase(std::unique(Reachable.begin(), Reachable.end()),
+                  Reachable.end());
+  for (unsigned ID : Reachable)
+    llvm::append_range(Result, Components[ID].Exits);
+
+  std::sort(Result.begin(), Result.end(), CompareByName<BasicBlock>());
+  return Result;
+}
+
+void CollectCFG::serialize(Function &F, std::ostream &Output) {
+  condense(F);
+
+  std::vector<BasicBlock *> Sources;
+  for (BasicBlock &BB : F)
+    if (isNewInstruction(&BB))
+      Sources.push_back(&BB);
+  std::stable_sort(Sources.begin(), Sources.end(), CompareByName<BasicBlock>());
+
+  Output << "source,destination\n";
+
+  // Collecting the successors doesn't touch the IR, so the instructions can be
+  // handled concurrently, a chunk at a time
+  std::vector<SmallVector<BasicBlock *, 2>> Chunk;
+  for (size_t Start = 0; Start < Sources.size(); Start += ChunkSize) {
+    size_t Size = std::min(ChunkSize, Sources.size() - Start);
+    Chunk.assign(Size, {});
+
+    std::atomic<size_t> Next(0);
+    auto Worker = [this, &Sources, &Chunk, &Next, Start, Size]() {
+      for (size_t I = Next++; I < Size; I = Next++)
+        Chunk[I] = successorsOf(Sources[Start + I]);
+    };
+
+    size_t Count = std::min<size_t>(ThreadsCount, Size);
+    if (Count <= 1) {
+      Worker();
+    } else {
+      std::vector<std::thread> Threads;
+      for (size_t I = 0; I < Count; I++)
+        Threads.emplace_back(Worker);
+
+      for (std::thread &Thread : Threads)
+        Thread.join();
+    }
+
+    for (size_t I = 0; I < Size; I++) {
+      BasicBlock *Source = Sources[Start + I];
+      for (BasicBlock *Destination : Chunk[I])
+        Output << Source->getName().data() << ","
+               << Destination->getName().data() << "\n";
+    }
+  }
+
+  ComponentOf.clear();
+  Components.clear();
+}
+
+bool CollectCFG::runOnModule(Module &M) {
   if (OutputPath.getNumOccurrences() == 1) {
     std::ofstream Output;
-    serialize(pathToStream(OutputPath, Output));
+    serialize(*M.getFunction("root"), pathToStream(OutputPath, Output));
   }
 
   return false;
@@ -27,7 +27,9 @@ bool FunctionCallIdentification::runOnModule(llvm::Module &M) {
   llvm::Function &F = *M.getFunction("root");
   auto &GCBI = getAnalysis<GeneratedCodeBasicInfoWrapperPass>().getGCBI();
 
-  FallthroughAddresses.clear();
+  std::set<MetaAddress> &Fallthroughs = fallthroughAddresses();
+  if (State == nullptr)
+    Fallthroughs.clear();
 
   // Create function call marker
   // TODO: we could factor this out
@@ -52,8 +54,26 @@ bool FunctionCallIdentification::runOnModule(llvm::Module &M) {
     revng_assert(FunctionCall->user_begin() == FunctionCall->user_end());
   }
 
+  // Select the basic blocks to inspect
+  std::vector<BasicBlock *> Blocks;
+  if (State == nullptr) {
+    for (BasicBlock &BB : F)
+      Blocks.push_back(&BB);
+  } else {
+    std::set<BasicBlock *> Selected = *Region;
+    for (WeakVH &Handle : State->Pending)
+      if (Handle != nullptr)
+        Selected.insert(cast<BasicBlock>(Handle));
+    State->Pending.clear();
+
+    for (BasicBlock *BB : Selected)
+      if (BB->getParent() == &F)
+        Blocks.push_back(BB);
+  }
+
   // Collect function calls
-  for (BasicBlock &BB : F) {
+  for (BasicBlock *Block : Blocks) {
+    BasicBlock &BB = *Block;
 
     if (BB.empty() or not GCBI.isTranslated(&BB))
       continue;
@@ -65,7 +85,7 @@ bool FunctionCallIdentification::runOnModule(llvm::Module &M) {
     if (Terminator != nullptr) {
       if (CallInst *Call = getFunctionCall(Terminator)) {
         auto Address = MetaAddress::fromConstant(Call->getOperand(2));
-        FallthroughAddresses.insert(Address);
+        Fallthroughs.insert(Address);
         continue;
       }
     }
@@ -222,6 +242,13 @@ bool FunctionCallIdentification::runOnModule(llvm::Module &M) {
     V.run(Terminator);
 
     BasicBlock *ReturnBB = GCBI.getBlockAt(ReturnPC);
+
+    // The return address might be translated later on, try again next time
+    bool LooksLikeCall = V.SaveRAFound and V.StorePCFound
+                         and V.NewPCLeft == 0;
+    if (State != nullptr and LooksLikeCall and ReturnBB == nullptr)
+      State->Pending.emplace_back(&BB);
+
     if (V.SaveRAFound and V.StorePCFound and V.NewPCLeft == 0
         and ReturnBB != nullptr) {
       // It's a function call, register it
@@ -269,7 +296,7 @@ bool FunctionCallIdentification::runOnModule(llvm::Module &M) {
                                                  V.LinkRegister,
                                                  Int8NullPtr };
 
-      FallthroughAddresses.insert(ReturnPC);
+      Fallthroughs.insert(ReturnPC);
 
       // If the instruction before the terminator is a call to exitTB, inject
       // the call to function_call before it, so it doesn't get purged
@@ -285,7 +312,9 @@ bool FunctionCallIdentification::runOnModule(llvm::Module &M) {
     }
   }
 
-  buildFilteredCFG(F);
+  // The filtered CFG is only dumped, don't pay for it at each incremental run
+  if (State == nullptr or FilteredCFGLog.isEnabled())
+    buildFilteredCFG(F);
 
   revng_log(PassesLog, "Ending FunctionCallIdentification");
 
@@ -18,6 +18,7 @@ bool PruneRetSuccessors::runOnModule(llvm::Module &M) {
   auto &GCBI = getAnalysis<GeneratedCodeBasicInfoWrapperPass>().getGCBI();
   auto &FCI = getAnalysis<FunctionCallIdentification>();
 
+  bool Changed = false;
   for (BasicBlock &BB : *GCBI.root()) {
     if (not GCBI.isTranslated(&BB)
         or BB.getTerminator()->getNumSuccessors() < 2)
@@ -40,8 +41,12 @@ bool PruneRetSuccessors::runOnModule(llvm::Module &M) {
       auto *NewTerminator = BranchInst::Create(GCBI.anyPC(), &BB);
       NewTerminator->copyMetadata(*OldTerminator);
       OldTerminator->eraseFromParent();
+      Changed = true;
     }
   }
 
-  return true;
+  if (Changed)
+    GCBI.invalidate(GCBI.root());
+
+  return Changed;
 }
@@ -11,6 +11,7 @@
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/GlobalVariable.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/Support/raw_os_ostream.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
@@ -49,6 +50,13 @@ static cl::opt<bool> DisableSafetyChecks("disable-enforce-abi-safety-checks",
                                          cl::cat(MainCategory),
                                          cl::init(false));
 
+/// \brief The LLVM counterpart of a model::RawFunctionType
+struct ABIPrototype {
+  FunctionType *Type = nullptr;
+  SmallVector<GlobalVariable *, 8> Arguments;
+  SmallVector<GlobalVariable *, 8> ReturnValues;
+};
+
 class EnforceABIImpl {
 public:
   EnforceABIImpl(Module &M,
@@ -60,14 +68,25 @@ public:
     Context(M.getContext()),
     Initializers(&M),
     IndirectPlaceholderPool(&M, false),
-    Binary(Binary) {}
+    Binary(Binary) {
+    IndirectPlaceholderPool.setTags({ &FunctionTags::IndirectPlaceholder });
+    IndirectPlaceholderPool.recordExisting([](Function &F) {
+      return std::optional<FunctionType *>(F.getFunctionType());
+    });
+  }
 
   void run();
 
 private:
+  const ABIPrototype &getPrototype(const model::Type *Key);
+
   Function *handleFunction(Function &F, const model::Function &FunctionModel);
 
-  void handleRegularFunctionCall(CallInst *Call);
+  void handleRegularFunctionCalls(Function &F,
+                                  const model::Function &FunctionModel);
+  void handleRegularFunctionCall(CallInst *Call,
+                                 Function *Callee,
+                                 const model::Function &FunctionModel);
   void generateCall(IRBuilder<> &Builder,
                     Function *Callee,
                     const model::CallEdge &CallSite);
@@ -77,6 +96,7 @@ private:
   GeneratedCodeBasicInfo &GCBI;
   std::map<Function *, const model::Function *> FunctionsMap;
   std::map<Function *, Function *> OldToNew;
+  std::map<const model::Type *, ABIPrototype> Prototypes;
   Function *FunctionDispatcher;
   Function *OpaquePC;
   LLVMContext &Context;
@@ -109,6 +129,12 @@ void EnforceABIImpl::run() {
   OpaquePC->addFnAttr(Attribute::ReadOnly);
   FunctionTags::OpaqueCSVValue.addTo(OpaquePC);
 
+  // Compute the prototypes of all the functions before rewriting anything,
+  // those of the call sites are computed, and memoized, on first use
+  for (const model::Function &FunctionModel : Binary.Functions)
+    if (FunctionModel.Type != model::FunctionType::Fake)
+      getPrototype(FunctionModel.Prototype.get());
+
   std::vector<Function *> OldFunctions;
   for (const model::Function &FunctionModel : Binary.Functions) {
     if (FunctionModel.Type == model::FunctionType::Fake)
@@ -123,20 +149,9 @@ void EnforceABIImpl::run() {
     OldToNew[OldFunction] = NewFunction;
   }
 
-  auto IsInIsolatedFunction = [this](Instruction *I) -> bool {
-    return FunctionsMap.count(I->getParent()->getParent()) != 0;
-  };
-
-  // Handle function calls in isolated functions
-  std::vector<CallInst *> RegularCalls;
-  for (auto *F : OldFunctions)
-    for (User *U : F->users())
-      if (auto *Call = dyn_cast<CallInst>(skipCasts(U)))
-        if (IsInIsolatedFunction(Call))
-          RegularCalls.push_back(Call);
-
-  for (CallInst *Call : RegularCalls)
-    handleRegularFunctionCall(Call);
+  // Handle function calls in isolated functions, one function at a time
+  for (auto [F, FunctionModel] : FunctionsMap)
+    handleRegularFunctionCalls(*F, *FunctionModel);
 
   // Drop function_dispatcher
   if (FunctionDispatcher != nullptr) {
@@ -147,8 +162,11 @@ void EnforceABIImpl::run() {
 
   // Drop all the old functions, after we stole all of its blocks
   for (Function *OldFunction : OldFunctions) {
-    for (User *U : OldFunction->users())
-      cast<Instruction>(U)->getParent()->dump();
+    if (not OldFunction->use_empty()) {
+      for (User *U : OldFunction->users())
+        cast<Instruction>(U)->getParent()->dump();
+      revng_abort("An old function is still in use");
+    }
     OldFunction->eraseFromParent();
   }
 
@@ -162,26 +180,32 @@ void EnforceABIImpl::run() {
   }
 }
 
-static FunctionType *
-toLLVMType(llvm::Module *M, const model::RawFunctionType &Prototype) {
+const ABIPrototype &EnforceABIImpl::getPrototype(const model::Type *Key) {
   using model::NamedTypedRegister;
   using model::RawFunctionType;
   using model::TypedRegister;
 
-  LLVMContext &Context = M->getContext();
+  auto It = Prototypes.find(Key);
+  if (It != Prototypes.end())
+    return It->second;
+
+  ABIPrototype &Result = Prototypes[Key];
+  const auto &Prototype = *cast<RawFunctionType>(Key);
 
-  SmallVector<llvm::Type *, 8> ArgumentsTypes;
-  SmallVector<llvm::Type *, 8> ReturnTypes;
+  SmallVector<Type *, 8> ArgumentsTypes;
+  SmallVector<Type *, 8> ReturnTypes;
 
   for (const NamedTypedRegister &TR : Prototype.Arguments) {
     auto Name = ABIRegister::toCSVName(TR.Location);
-    auto *CSV = cast<GlobalVariable>(M->getGlobalVariable(Name, true));
+    auto *CSV = cast<GlobalVariable>(M.getGlobalVariable(Name, true));
+    Result.Arguments.push_back(CSV);
     ArgumentsTypes.push_back(CSV->getType()->getPointerElementType());
   }
 
   for (const TypedRegister &TR : Prototype.ReturnValues) {
     auto Name = ABIRegister::toCSVName(TR.Location);
-    auto *CSV = cast<GlobalVariable>(M->getGlobalVariable(Name, true));
+    auto *CSV = cast<GlobalVariable>(M.getGlobalVariable(Name, true));
+    Result.ReturnValues.push_back(CSV);
     ReturnTypes.push_back(CSV->getType()->getPointerElementType());
   }
 
@@ -195,35 +219,23 @@ toLLVMType(llvm::Module *M, const model::RawFunctionType &Prototype) {
     ReturnType = StructType::create(ReturnTypes);
 
   // Create new function
-  return FunctionType::get(ReturnType, ArgumentsTypes, false);
+  Result.Type = FunctionType::get(ReturnType, ArgumentsTypes, false);
+
+  return Result;
 }
 
 Function *EnforceABIImpl::handleFunction(Function &OldFunction,
                                          const model::Function &FunctionModel) {
-  using model::NamedTypedRegister;
   using model::RawFunctionType;
-  using model::TypedRegister;
 
-  SmallVector<GlobalVariable *, 8> ArgumentCSVs;
-  SmallVector<GlobalVariable *, 8> ReturnCSVs;
-
-  const auto &Prototype = *cast<RawFunctionType>(FunctionModel.Prototype.get());
-  // We sort arguments by their CSV name
-  for (const NamedTypedRegister &TR : Prototype.Arguments) {
-    auto Name = ABIRegister::toCSVName(TR.Location);
-    auto *CSV = cast<GlobalVariable>(M.getGlobalVariable(Name, true));
-    ArgumentCSVs.push_back(CSV);
-  }
-
-  for (const TypedRegister &TR : Prototype.ReturnValues) {
-    auto Name = ABIRegister::toCSVName(TR.Location);
-    auto *CSV = cast<GlobalVariable>(M.getGlobalVariable(Name, true));
-    ReturnCSVs.push_back(CSV);
-  }
+  const model::Type *PrototypeType = FunctionModel.Prototype.get();
+  const auto &Prototype = *cast<RawFunctionType>(PrototypeType);
+  const ABIPrototype &LLVMPrototype = getPrototype(PrototypeType);
+  const auto &ArgumentCSVs = LLVMPrototype.Arguments;
+  const auto &ReturnCSVs = LLVMPrototype.ReturnValues;
 
   // Create new function
-  auto *NewType = toLLVMType(&M, Prototype);
-  auto *NewFunction = Function::Create(NewType,
+  auto *NewFunction = Function::Create(LLVMPrototype.Type,
                                        GlobalValue::ExternalLinkage,
                                        "",
                                        OldFunction.getParent());
@@ -234,7 +246,7 @@ Function *EnforceABIImpl::handleFunction(Function &OldFunction,
   // Set argument names
   for (const auto &[LLVMArgument, ModelArgument] :
        zip(NewFunction->args(), Prototype.Arguments))
-    LLVMArgument.setName(ModelArgument.name());
+    LLVMArgument.setName(ModelArgument.name().str());
 
   // Steal body from the old function
   std::vector<BasicBlock *> Body;
@@ -259,7 +271,7 @@ Function *EnforceABIImpl::handleFunction(Function &OldFunction,
     for (BasicBlock &BB : *NewFunction) {
       if (auto *Return = dyn_cast<ReturnInst>(BB.getTerminator())) {
         IRBuilder<> Builder(Return);
-        std::vector<Value *> ReturnValues;
+        SmallVector<Value *, 8> ReturnValues;
         for (GlobalVariable *ReturnCSV : ReturnCSVs)
           ReturnValues.push_back(Builder.CreateLoad(ReturnCSV));
 
@@ -276,18 +288,31 @@ Function *EnforceABIImpl::handleFunction(Function &OldFunction,
   return NewFunction;
 }
 
-void EnforceABIImpl::handleRegularFunctionCall(CallInst *Call) {
-  Function *Caller = Call->getParent()->getParent();
-  const model::Function &FunctionModel = *FunctionsMap.at(Caller);
+void EnforceABIImpl::handleRegularFunctionCalls(Function &F,
+                                                const model::Function &Model) {
+  revng_assert(F.getName() == Model.name());
 
-  Function *CallerFunction = Call->getParent()->getParent();
-  revng_assert(CallerFunction->getName() == FunctionModel.name());
+  // Rewrite in a single pass all the calls to the old functions. The
+  // rewriting only emits new instructions before the call being replaced.
+  for (Instruction &I : make_early_inc_range(instructions(F))) {
+    auto *Call = dyn_cast<CallInst>(&I);
+    if (Call == nullptr)
+      continue;
 
-  Function *Callee = cast<Function>(skipCasts(Call->getCalledOperand()));
-  bool IsDirect = (Callee != FunctionDispatcher);
-  if (IsDirect)
-    Callee = OldToNew.at(Callee);
+    auto *Callee = dyn_cast<Function>(skipCasts(Call->getCalledOperand()));
+    if (Callee == nullptr)
+      continue;
 
+    auto It = OldToNew.find(Callee);
+    if (It != OldToNew.end())
+      handleRegularFunctionCall(Call, It->second, Model);
+  }
+}
+
+void EnforceABIImpl::handleRegularFunctionCall(CallInst *Call,
+                                               Function *Callee,
+                                               const model::Function
+                                                 &FunctionModel) {
   // Identify the corresponding call site in the model
   MetaAddress BasicBlockAddress = GCBI.getJumpTarget(Call->getParent());
   const model::BasicBlock &Block = FunctionModel.CFG.at(BasicBlockAddress);
@@ -335,24 +360,17 @@ void EnforceABIImpl::handleRegularFunctionCall(CallInst *Call) {
 void EnforceABIImpl::generateCall(IRBuilder<> &Builder,
                                   Function *Callee,
                                   const model::CallEdge &CallSite) {
-  using model::NamedTypedRegister;
-  using model::RawFunctionType;
-  using model::TypedRegister;
-
   revng_assert(Callee != nullptr);
 
-  llvm::SmallVector<Value *, 8> Arguments;
-  llvm::SmallVector<GlobalVariable *, 8> ReturnCSVs;
-
-  const auto &Prototype = *cast<RawFunctionType>(CallSite.Prototype.get());
+  const ABIPrototype &Prototype = getPrototype(CallSite.Prototype.get());
+  const auto &ReturnCSVs = Prototype.ReturnValues;
 
   bool IsIndirect = (Callee != FunctionDispatcher);
   if (IsIndirect) {
     // Create a new `indirect_placeholder` function with the specific function
     // type we need
-    auto *NewType = toLLVMType(&M, Prototype);
-    Callee = IndirectPlaceholderPool.get(NewType,
-                                         NewType,
+    Callee = IndirectPlaceholderPool.get(Prototype.Type,
+                                         Prototype.Type,
                                          "indirect_placeholder");
   } else {
     BasicBlock *InsertBlock = Builder.GetInsertPoint()->getParent();
@@ -362,19 +380,12 @@ void EnforceABIImpl::generateCall(IRBuilder<> &Builder,
   }
 
   //
-  // Collect arguments and returns
+  // Collect arguments
   //
-  for (const NamedTypedRegister &TR : Prototype.Arguments) {
-    auto Name = ABIRegister::toCSVName(TR.Location);
-    GlobalVariable *CSV = M.getGlobalVariable(Name, true);
+  llvm::SmallVector<Value *, 8> Arguments;
+  Arguments.reserve(Prototype.Arguments.size());
+  for (GlobalVariable *CSV : Prototype.Arguments)
     Arguments.push_back(Builder.CreateLoad(CSV));
-  }
-
-  for (const TypedRegister &TR : Prototype.ReturnValues) {
-    auto Name = ABIRegister::toCSVName(TR.Location);
-    GlobalVariable *CSV = M.getGlobalVariable(Name, true);
-    ReturnCSVs.push_back(CSV);
-  }
 
   //
   // Produce the call
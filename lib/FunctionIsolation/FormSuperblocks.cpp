@@ -0,0 +1,238 @@
+/// \file FormSuperblocks.cpp
+/// \brief Copies hot join points in their hot predecessor, growing superblocks
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/Support/BranchProbability.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/SSAUpdater.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+
+#include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
+#include "revng/FunctionIsolation/FormSuperblocks.h"
+#include "revng/Support/CommandLine.h"
+#include "revng/Support/Debug.h"
+#include "revng/Support/FunctionTags.h"
+#include "revng/Support/IRHelpers.h"
+
+using namespace llvm;
+
+char FormSuperblocksPass::ID = 0;
+
+using Register = RegisterPass<FormSuperblocksPass>;
+static Register X("form-superblocks", "Form Superblocks Pass", false, false);
+
+static Logger<> Log("form-superblocks");
+
+static cl::opt<unsigned> MaxSize("superblock-max-size",
+                                 cl::init(32),
+                                 cl::desc("copy the join points with up to "
+                                          "this many instructions"),
+                                 cl::value_desc("instructions"),
+                                 cl::cat(MainCategory));
+
+static cl::opt<unsigned> Growth("superblock-growth",
+                                cl::init(10),
+                                cl::desc("let each function grow by at most "
+                                         "this percentage of instructions"),
+                                cl::value_desc("percentage"),
+                                cl::cat(MainCategory));
+
+/// A predecessor has to account for more than this fraction of the executions
+/// of a join point to get a copy of it
+static const BranchProbability HotEdge(1, 2);
+
+FormSuperblocksPass::FormSuperblocksPass() : FunctionPass(ID) {
+  // Unlike opt, revng-translate does not register the analyses upfront
+  initializeBlockFrequencyInfoWrapperPassPass(*PassRegistry::getPassRegistry());
+}
+
+void FormSuperblocksPass::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.addRequired<BlockFrequencyInfoWrapperPass>();
+}
+
+static bool hasBranchWeights(Function &F) {
+  for (BasicBlock &BB : F)
+    if (BB.getTerminator()->getMetadata(LLVMContext::MD_prof) != nullptr)
+      return true;
+  return false;
+}
+
+/// Can \p BB be copied at the end of another basic block?
+static bool isDuplicable(BasicBlock *BB) {
+  if (not GeneratedCodeBasicInfo::isTranslated(BB) or BB->hasAddressTaken()
+      or BB->isEHPad())
+    return false;
+
+  Instruction *Terminator = BB->getTerminator();
+  if (not isa<BranchInst>(Terminator) and not isa<SwitchInst>(Terminator)
+      and not isa<ReturnInst>(Terminator)
+      and not isa<UnreachableInst>(Terminator))
+    return false;
+
+  for (Instruction &I : *BB) {
+    if (isa<AllocaInst>(&I) or I.getType()->isTokenTy())
+      return false;
+
+    if (auto *Call = dyn_cast<CallInst>(&I))
+      if (Call->cannotDuplicate() or Call->isConvergent())
+        return false;
+  }
+
+  return true;
+}
+
+/// Number of instructions that copying \p BB adds
+static size_t duplicationCost(BasicBlock *BB) {
+  return BB->size() - std::distance(BB->phis().begin(), BB->phis().end());
+}
+
+/// \brief Replace the unconditional jump at the end of \p Predecessor with a
+///        copy of \p BB
+static void duplicateInto(BasicBlock *Predecessor, BasicBlock *BB) {
+  ValueToValueMapTy Mapping;
+  for (PHINode &Phi : BB->phis())
+    Mapping[&Phi] = Phi.getIncomingValueForBlock(Predecessor);
+
+  Predecessor->getTerminator()->eraseFromParent();
+
+  SmallVector<Instruction *, 16> Copies;
+  for (Instruction &I : *BB) {
+    if (isa<PHINode>(&I))
+      continue;
+
+    Instruction *Copy = I.clone();
+    if (I.hasName())
+      Copy->setName(I.getName());
+    Predecessor->getInstList().push_back(Copy);
+    Mapping[&I] = Copy;
+    Copies.push_back(Copy);
+  }
+
+  for (Instruction *Copy : Copies)
+    RemapInstruction(Copy,
+                     Mapping,
+                     RF_IgnoreMissingLocals | RF_NoModuleLevelChanges);
+
+  BB->removePredecessor(Predecessor, true);
+
+  // The successors are now reached from Predecessor too, one incoming value
+  // per edge
+  auto MapValue = [&Mapping](Value *V) -> Value * {
+    auto It = Mapping.find(V);
+    return It == Mapping.end() ? V : static_cast<Value *>(It->second);
+  };
+  for (BasicBlock *Successor : successors(Predecessor))
+    for (PHINode &Phi : Successor->phis())
+      Phi.addIncoming(MapValue(Phi.getIncomingValueForBlock(BB)), Predecessor);
+
+  // The values defined in BB now have two definitions reaching their uses
+  // outside of BB
+  SmallVector<Use *, 16> Uses;
+  for (Instruction &I : *BB) {
+    Uses.clear();
+    for (Use &U : I.uses()) {
+      auto *User = cast<Instruction>(U.getUser());
+      if (User->getParent() != BB or isa<PHINode>(User))
+        Uses.push_back(&U);
+    }
+
+    if (Uses.empty())
+      continue;
+
+    SSAUpdater Updater;
+    Updater.Initialize(I.getType(), I.getName());
+    Updater.AddAvailableValue(BB, &I);
+    Updater.AddAvailableValue(Predecessor, MapValue(&I));
+    for (Use *U : Uses)
+      Updater.RewriteUse(*U);
+  }
+}
+
+bool FormSuperblocksPass::runOnFunction(Function &F) {
+  bool HasTranslatedCode = FunctionTags::Root.isTagOf(&F)
+                           or FunctionTags::Lifted.isTagOf(&F);
+  if (not HasTranslatedCode or not hasBranchWeights(F))
+    return false;
+
+  auto &BFI = getAnalysis<BlockFrequencyInfoWrapperPass>().getBFI();
+  uint64_t EntryFrequency = std::max<uint64_t>(BFI.getEntryFreq(), 1);
+
+  DenseMap<BasicBlock *, uint64_t> Frequencies;
+  std::vector<BasicBlock *> HotBlocks;
+  for (BasicBlock &BB : F) {
+    uint64_t Frequency = BFI.getBlockFreq(&BB).getFrequency();
+    Frequencies[&BB] = Frequency;
+    bool IsTranslated = GeneratedCodeBasicInfo::isTranslated(&BB);
+    if (Frequency >= EntryFrequency and IsTranslated)
+      HotBlocks.push_back(&BB);
+  }
+
+  // Grow the hottest paths first
+  auto Compare = [&Frequencies](BasicBlock *LHS, BasicBlock *RHS) {
+    return Frequencies[LHS] > Frequencies[RHS];
+  };
+  std::stable_sort(HotBlocks.begin(), HotBlocks.end(), Compare);
+
+  // Small functions can get at least a copy
+  size_t Budget = F.getInstructionCount() * Growth / 100;
+  Budget = std::max<size_t>(Budget, MaxSize);
+  unsigned Duplicated = 0;
+  for (BasicBlock *Head : HotBlocks) {
+    // Follow the unconditional jumps from Head, copying the join points
+    BasicBlock *Tail = Head;
+    SmallPtrSet<BasicBlock *, 8> Visited;
+    while (Visited.insert(Tail).second) {
+      auto *Branch = dyn_cast<BranchInst>(Tail->getTerminator());
+      if (Branch == nullptr or Branch->isConditional())
+        break;
+
+      BasicBlock *Successor = Branch->getSuccessor(0);
+      if (Successor == Tail)
+        break;
+
+      // Tail already falls through Successor
+      if (Successor->getSinglePredecessor() == Tail) {
+        Tail = Successor;
+        continue;
+      }
+
+      uint64_t TailFrequency = Frequencies[Tail];
+      uint64_t &SuccessorFrequency = Frequencies[Successor];
+      size_t Cost = duplicationCost(Successor);
+      if (Cost > MaxSize or Cost > Budget
+          or TailFrequency <= HotEdge.scale(SuccessorFrequency)
+          or not isDuplicable(Successor))
+        break;
+
+      revng_log(Log,
+                "Copying " << getName(Successor) << " into " << getName(Tail));
+      duplicateInto(Tail, Successor);
+      SuccessorFrequency -= std::min(SuccessorFrequency, TailFrequency);
+      Budget -= Cost;
+      ++Duplicated;
+
+      // Tail now ends with the terminator of Successor
+      Visited.erase(Tail);
+    }
+  }
+
+  revng_log(Log,
+            "Copied " << Duplicated << " join points in " << getName(&F));
+
+  return Duplicated != 0;
+}
@@ -5,15 +5,22 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
 #include <iterator>
 
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/Analysis/BlockFrequencyInfo.h"
+#include "llvm/IR/Dominators.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
 #include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include "llvm/Transforms/Utils/PromoteMemToReg.h"
 
 #include "revng/ADT/Queue.h"
 #include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
 #include "revng/FunctionIsolation/InlineHelpers.h"
+#include "revng/Support/CommandLine.h"
 #include "revng/Support/IRHelpers.h"
 #include "revng/Support/OpaqueFunctionsPool.h"
 
@@ -26,8 +33,42 @@ char InlineHelpersPass::ID = 0;
 using Register = RegisterPass<InlineHelpersPass>;
 static Register X("inline-helpers", "Inline Helpers Pass", true, true);
 
+static Logger<> Log("inline-helpers");
+
+static cl::opt<unsigned> Threshold("inline-helpers-threshold",
+                                   cl::init(200),
+                                   cl::desc("inline the helpers with up to "
+                                            "this many instructions"),
+                                   cl::value_desc("instructions"),
+                                   cl::cat(MainCategory));
+
+static cl::opt<unsigned> HotThreshold("inline-helpers-hot-threshold",
+                                      cl::init(1000),
+                                      cl::desc("inline the helpers with up to "
+                                               "this many instructions at hot "
+                                               "call sites"),
+                                      cl::value_desc("instructions"),
+                                      cl::cat(MainCategory));
+
+static cl::opt<unsigned> HotFrequency("inline-helpers-hot-frequency",
+                                      cl::init(8),
+                                      cl::desc("consider hot the call sites "
+                                               "estimated to run at least "
+                                               "this many times per call to "
+                                               "the caller"),
+                                      cl::value_desc("frequency"),
+                                      cl::cat(MainCategory));
+
+static cl::opt<unsigned> Growth("inline-helpers-growth",
+                                cl::init(400),
+                                cl::desc("maximum growth of a function due to "
+                                         "helpers inlining, in percentage of "
+                                         "its original size"),
+                                cl::value_desc("percentage"),
+                                cl::cat(MainCategory));
+
 static bool shouldInline(Function *F) {
-  if (F == nullptr)
+  if (F == nullptr or F->isDeclaration())
     return false;
 
   return F->getSection() == "revng_inline";
@@ -64,30 +105,131 @@ static bool doInline(Function *F) {
   return ToInline.size() > 0;
 }
 
-class InlineHelpers {
-private:
-  LLVMContext &C;
+/// Cheap cleanups, not requiring anything beyond TransformUtils
+static void simplify(Function &F) {
+  // Promote the allocas left around by inlining
+  std::vector<AllocaInst *> Allocas;
+  for (Instruction &I : F.getEntryBlock())
+    if (auto *Alloca = dyn_cast<AllocaInst>(&I))
+      if (isAllocaPromotable(Alloca))
+        Allocas.push_back(Alloca);
+
+  if (Allocas.size() != 0) {
+    DominatorTree DT(F);
+    PromoteMemToReg(Allocas, DT);
+  }
+
+  for (BasicBlock &BB : F)
+    SimplifyInstructionsInBlock(&BB);
+
+  removeUnreachableBlocks(F);
+
+  for (BasicBlock &BB : make_early_inc_range(F))
+    MergeBlockIntoPredecessor(&BB);
+}
+
+void InlineHelpersPass::getAnalysisUsage(AnalysisUsage &AU) const {
+  // Share the dominator tree and the loop info with the other passes
+  AU.addRequired<BlockFrequencyInfoWrapperPass>();
+}
+
+bool InlineHelpersPass::doInitialization(Module &M) {
+  std::vector<Function *> Helpers;
+  for (Function &F : M)
+    if (shouldInline(&F) and not F.use_empty())
+      Helpers.push_back(&F);
+
+  // Prepare a clone of each helper with all of its inlinable callees inlined
+  for (Function *Helper : Helpers) {
+    ValueToValueMapTy VMap;
+    Function *Clone = CloneFunction(Helper, VMap);
+    Clone->setName(Helper->getName() + "_inlinable");
+    Clone->setLinkage(GlobalValue::InternalLinkage);
+    Clone->setSection("");
+
+    // Fixed-point inlining
+    while (doInline(Clone))
+      ;
+
+    simplify(*Clone);
+
+    Inlinable[Helper] = Clone;
+    Costs[Helper] = Clone->getInstructionCount();
+    revng_log(Log,
+              getName(Helper) << " costs " << Costs[Helper] << " instructions");
+  }
+
+  return Helpers.size() != 0;
+}
 
-public:
-  InlineHelpers(Module *M) : C(M->getContext()) {}
+bool InlineHelpersPass::doFinalization(Module &M) {
+  bool Changed = Inlinable.size() != 0;
 
-  void run(Function *F);
+  for (auto &[Helper, Clone] : Inlinable) {
+    revng_assert(Clone->use_empty());
+    Clone->eraseFromParent();
+  }
 
-private:
-  void wrapCallsToHelpers(Function *F);
-};
+  Inlinable.clear();
+  Costs.clear();
 
-void InlineHelpers::run(Function *F) {
-  // Fixed-point inlining
-  while (doInline(F))
-    ;
+  return Changed;
 }
 
 bool InlineHelpersPass::runOnFunction(Function &F) {
   if (not FunctionTags::Lifted.isTagOf(&F))
     return false;
 
-  InlineHelpers IH(F.getParent());
-  IH.run(&F);
-  return true;
+  struct CallSite {
+    CallInst *Call;
+    Function *Helper;
+    uint64_t Frequency;
+    unsigned Cost;
+  };
+
+  // Estimate how many times each call site runs per invocation of F, taking
+  // into account the branch weights of the profile, if available
+  auto &BFI = getAnalysis<BlockFrequencyInfoWrapperPass>().getBFI();
+  uint64_t EntryFrequency = std::max<uint64_t>(BFI.getEntryFreq(), 1);
+
+  std::vector<CallSite> CallSites;
+  for (BasicBlock &BB : F) {
+    uint64_t Frequency = BFI.getBlockFreq(&BB).getFrequency() / EntryFrequency;
+    for (Instruction &I : BB) {
+      if (auto *Call = getCallToInline(&I)) {
+        Function *Helper = Call->getCalledFunction();
+        auto It = Costs.find(Helper);
+        if (It != Costs.end())
+          CallSites.push_back({ Call, Helper, Frequency, It->second });
+      }
+    }
+  }
+
+  // Consider the hottest and cheapest call sites first
+  auto Compare = [](const CallSite &LHS, const CallSite &RHS) {
+    return std::tie(RHS.Frequency, LHS.Cost)
+           < std::tie(LHS.Frequency, RHS.Cost);
+  };
+  std::stable_sort(CallSites.begin(), CallSites.end(), Compare);
+
+  uint64_t Size = std::max(F.getInstructionCount(), Threshold.getValue());
+  uint64_t Budget = Size * Growth / 100;
+  bool Changed = false;
+  for (const CallSite &Site : CallSites) {
+    bool IsHot = Site.Frequency >= HotFrequency;
+    if (Site.Cost > (IsHot ? HotThreshold : Threshold) or Site.Cost > Budget) {
+      revng_log(Log,
+                "Not inlining " << getName(Site.Helper) << " in "
+                                << getName(&F));
+      continue;
+    }
+
+    // Inline the pre-optimized body
+    Site.Call->setCalledFunction(Inlinable.at(Site.Helper));
+    doInline(Site.Call);
+    Budget -= Site.Cost;
+    Changed = true;
+  }
+
+  return Changed;
 }
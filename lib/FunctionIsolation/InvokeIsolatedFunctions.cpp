@@ -5,6 +5,7 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include "llvm/ADT/MapVector.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Function.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
@@ -23,7 +24,7 @@ static Register
 class InvokeIsolatedFunctions {
 private:
   using FunctionInfo = tuple<const model::Function *, BasicBlock *, Function *>;
-  using FunctionMap = std::map<MetaAddress, FunctionInfo>;
+  using FunctionMap = MapVector<MetaAddress, FunctionInfo>;
 
 private:
   Function *RootFunction;
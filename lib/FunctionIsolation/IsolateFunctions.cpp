@@ -6,6 +6,9 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <atomic>
+#include <thread>
+
 #include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Verifier.h"
@@ -20,6 +23,7 @@
 #include "revng/ADT/ZipMapIterator.h"
 #include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
 #include "revng/FunctionIsolation/IsolateFunctions.h"
+#include "revng/Support/CommandLine.h"
 #include "revng/Support/Debug.h"
 #include "revng/Support/FunctionTags.h"
 #include "revng/Support/IRHelpers.h"
@@ -30,6 +34,23 @@ class IsolateFunctionsImpl;
 
 static Logger<> TheLogger("isolation");
 
+static cl::opt<unsigned> ThreadsCount("isolation-threads",
+                                      cl::init(1),
+                                      cl::desc("number of threads identifying "
+                                               "the blocks of the functions "
+                                               "to isolate"),
+                                      cl::value_desc("threads"),
+                                      cl::cat(MainCategory));
+
+static cl::opt<bool> MoveBlocks("isolation-move-blocks",
+                                cl::desc("move into the isolated function the "
+                                         "blocks of root belonging to a single "
+                                         "function instead of cloning them. "
+                                         "root will no longer be able to "
+                                         "execute them."),
+                                cl::cat(MainCategory),
+                                cl::init(false));
+
 // Define an alias for the data structure that will contain the LLVM functions
 using FunctionsMap = std::map<MDString *, Function *>;
 using ValueToValueMap = DenseMap<const Value *, Value *>;
@@ -96,6 +117,16 @@ struct Boundary {
   }
 };
 
+/// The blocks of root generated by a basic block of the model and the boundaries
+/// among them, i.e., those leaving the basic block
+struct BasicBlockPlan {
+  std::vector<BasicBlock *> Blocks;
+  std::vector<Boundary> Boundaries;
+};
+
+/// The plan of each basic block of a function, in the order of its CFG
+using FunctionPlan = std::vector<BasicBlockPlan>;
+
 class FunctionBlocks {
 private:
   enum FixedBlocks {
@@ -138,6 +169,8 @@ private:
   Function *FunctionDispatcher = nullptr;
   Function *CallMarker = nullptr;
   BlockToFunctionsMap IsolatedFunctionsMap;
+  /// Number of functions including each block of root
+  DenseMap<BasicBlock *, unsigned> OwnersCount;
   ConstantStringsPool Strings;
   GlobalVariable *ExceptionSourcePC;
   GlobalVariable *ExceptionDestinationPC;
@@ -156,23 +189,43 @@ public:
   void run();
 
 private:
-  /// Isolate the function described by \p Function
+  /// Identify the blocks of root to clone for each function to isolate
+  ///
+  /// This only reads root, therefore functions are planned concurrently.
+  ///
+  /// \return the plan of each non-fake function, in the order of the model
+  std::vector<FunctionPlan> planIsolation();
+
+  /// Identify the blocks generated by \p Entry jump target and its boundaries
+  BasicBlockPlan planBasicBlock(MetaAddress Entry) const;
+
+  /// Isolate the function described by \p Function according to \p Plan
   ///
   /// \return a pair of the entry block in root and the newly create Function
-  std::pair<BasicBlock *, Function *> isolate(const model::Function &Function);
+  std::pair<BasicBlock *, Function *> isolate(const model::Function &Function,
+                                              const FunctionPlan &Plan);
 
   /// Process a basic block from the model
   void handleBasicBlock(const model::BasicBlock &Block,
+                        const BasicBlockPlan &Plan,
                         ValueToValueMapTy &OldToNew,
                         FunctionBlocks &ClonedBlocks);
 
-  /// Clone the basic blocks involved in \p Entry jump target
+  /// Can \p BB be moved into the function being isolated instead of cloned?
+  bool isMovable(BasicBlock *BB) const;
+
+  /// Move the instructions of \p BB into a new block, leaving in root a stub
+  /// preserving the markers of \p BB and leading to unexpectedpc
+  ///
+  /// \return the new block
+  BasicBlock *moveBlock(BasicBlock *BB);
+
+  /// Clone, or move if possible, the basic blocks of \p Plan
   ///
-  /// \return a vector of boundary basic blocks
-  std::vector<Boundary>
-  cloneAndIdentifyBoundaries(MetaAddress Entry,
-                             ValueToValueMapTy &OldToNew,
-                             FunctionBlocks &ClonedBlocks);
+  /// \return a vector of the cloned boundary basic blocks
+  std::vector<Boundary> cloneBlocks(const BasicBlockPlan &Plan,
+                                    ValueToValueMapTy &OldToNew,
+                                    FunctionBlocks &ClonedBlocks);
 
   /// Create the code necessary to handle a direct branch in the IR
   bool handleDirectBoundary(const Boundary &TheBoundary,
@@ -234,8 +287,7 @@ void IFI::throwException(IRBuilder<> &Builder,
   if (Instruction *T = Builder.GetInsertBlock()->getTerminator())
     SourcePC = getPC(T).first;
 
-  auto *Ty = ExceptionSourcePC->getType()->getPointerElementType();
-  Builder.CreateStore(SourcePC.toConstant(Ty), ExceptionSourcePC);
+  Builder.CreateStore(GCBI.toConstant(SourcePC), ExceptionSourcePC);
 
   // Populate the destination PC
   Builder.CreateStore(GCBI.programCounterHandler()->loadPC(Builder),
@@ -468,10 +520,12 @@ bool IFI::handleIndirectBoundary(const std::vector<Boundary> &Boundaries,
     printAddressListComparison(ExpectedAddresses,
                                IndirectBoundary->Successors.Addresses);
 
-    // Create the dispatcher for the targets
-    auto Dispatcher = GCBI.buildDispatcher(ExpectedAddresses,
-                                           Builder,
-                                           ClonedBlocks.unexpectedPCBlock());
+    // Create the dispatcher for the targets. They are all known, switch
+    // directly on the address the jump site computes.
+    auto Dispatcher = GCBI.buildJumpSiteDispatcher(ExpectedAddresses,
+                                                   Builder,
+                                                   ClonedBlocks
+                                                     .unexpectedPCBlock());
     for (BasicBlock *BB : Dispatcher.NewBlocks)
       ClonedBlocks.push_back(BB);
 
@@ -610,24 +664,16 @@ bool IFI::handleDirectBoundary(const Boundary &TheBoundary,
   return IsCall;
 }
 
-std::vector<Boundary>
-IFI::cloneAndIdentifyBoundaries(MetaAddress Entry,
-                                ValueToValueMapTy &OldToNew,
-                                FunctionBlocks &ClonedBlocks) {
+BasicBlockPlan IFI::planBasicBlock(MetaAddress Entry) const {
   std::set<BasicBlock *> Blocks;
   for (BasicBlock *Block : GCBI.getBlocksGeneratedByPC(Entry))
     Blocks.insert(Block);
   revng_assert(Blocks.size() > 0);
 
-  std::vector<Boundary> Boundaries;
+  BasicBlockPlan Result;
+  Result.Blocks.assign(Blocks.begin(), Blocks.end());
 
   for (BasicBlock *BB : Blocks) {
-    // Clone basic block in root and register it
-    auto *NewBB = CloneBasicBlock(BB, OldToNew, "", RootFunction);
-    revng_assert(OldToNew.count(BB) == 0);
-    OldToNew.insert({ BB, NewBB });
-    ClonedBlocks.push_back(NewBB);
-
     // Is this a boundary basic block?
     auto HasNotBeenCloned = [&Blocks](BasicBlock *Successor) {
       return Blocks.count(Successor) == 0;
@@ -635,26 +681,109 @@ IFI::cloneAndIdentifyBoundaries(MetaAddress Entry,
     if (succ_empty(BB) or any(successors(BB), HasNotBeenCloned)) {
       BasicBlock *Callee = getFunctionCallCallee(BB);
       BasicBlock *Fallthrough = getFallthrough(BB);
-      Boundary NewBoundary{
-        NewBB, Callee, Fallthrough, GCBI.getSuccessors(BB)
-      };
-      Boundaries.push_back(NewBoundary);
+      Boundary NewBoundary{ BB, Callee, Fallthrough, GCBI.getSuccessors(BB) };
+      Result.Boundaries.push_back(NewBoundary);
     }
   }
 
+  return Result;
+}
+
+std::vector<FunctionPlan> IFI::planIsolation() {
+  std::vector<const model::Function *> Functions;
+  for (const model::Function &Function : Binary.Functions)
+    if (Function.Type != model::FunctionType::Fake)
+      Functions.push_back(&Function);
+
+  // Initialize the lazy pc-to-BasicBlock cache of GCBI before sharing it
+  GCBI.getBlocksGeneratedByPC(MetaAddress::invalid());
+
+  std::vector<FunctionPlan> Result(Functions.size());
+  std::atomic<size_t> Next(0);
+  auto Worker = [this, &Functions, &Result, &Next]() {
+    for (size_t I = Next++; I < Functions.size(); I = Next++)
+      for (const model::BasicBlock &Block : Functions[I]->CFG)
+        Result[I].push_back(planBasicBlock(Block.Start));
+  };
+
+  size_t Count = std::min<size_t>(ThreadsCount, Functions.size());
+  if (Count <= 1) {
+    Worker();
+  } else {
+    std::vector<std::thread> Threads;
+    for (size_t I = 0; I < Count; I++)
+      Threads.emplace_back(Worker);
+
+    for (std::thread &Thread : Threads)
+      Thread.join();
+  }
+
+  return Result;
+}
+
+bool IFI::isMovable(BasicBlock *BB) const {
+  if (not MoveBlocks or OwnersCount.lookup(BB) != 1)
+    return false;
+
+  if (isa<PHINode>(BB->front()))
+    return false;
+
+  // The stub left in root cannot provide the values of the moved instructions
+  for (Instruction &I : *BB)
+    for (User *U : I.users())
+      if (cast<Instruction>(U)->getParent() != BB)
+        return false;
+
+  return true;
+}
+
+BasicBlock *IFI::moveBlock(BasicBlock *BB) {
+  auto *NewBB = BasicBlock::Create(Context, "", RootFunction);
+  NewBB->takeName(BB);
+  NewBB->getInstList().splice(NewBB->end(), BB->getInstList());
+
+  // Keep BB itself in root, since blockaddresses and the dispatcher refer to
+  // it, but preserve what identifies it as the beginning of an instruction
+  Instruction *OldTerminator = NewBB->getTerminator();
+  if (CallInst *NewPC = getCallTo(&NewBB->front(), "newpc"))
+    BB->getInstList().push_back(NewPC->clone());
+  auto *Stub = BranchInst::Create(GCBI.unexpectedPC(), BB);
+  Stub->copyMetadata(*OldTerminator);
+
+  return NewBB;
+}
+
+std::vector<Boundary> IFI::cloneBlocks(const BasicBlockPlan &Plan,
+                                       ValueToValueMapTy &OldToNew,
+                                       FunctionBlocks &ClonedBlocks) {
+  for (BasicBlock *BB : Plan.Blocks) {
+    // Clone (or move) basic block in root and register it
+    BasicBlock *NewBB = nullptr;
+    if (isMovable(BB))
+      NewBB = moveBlock(BB);
+    else
+      NewBB = CloneBasicBlock(BB, OldToNew, "", RootFunction);
+    revng_assert(OldToNew.count(BB) == 0);
+    OldToNew.insert({ BB, NewBB });
+    ClonedBlocks.push_back(NewBB);
+  }
+
+  std::vector<Boundary> Boundaries = Plan.Boundaries;
+  for (Boundary &B : Boundaries)
+    B.Block = cast<BasicBlock>(&*OldToNew[B.Block]);
+
   return Boundaries;
 }
 
 void IFI::handleBasicBlock(const model::BasicBlock &Block,
+                           const BasicBlockPlan &Plan,
                            ValueToValueMapTy &OldToNew,
                            FunctionBlocks &ClonedBlocks) {
   // Sentinel to ensure we don't have more than a call within a basic block
   SetAtMostOnce CallConsumed;
 
-  // Identify boundary blocks
-  std::vector<Boundary> Boundaries = cloneAndIdentifyBoundaries(Block.Start,
-                                                                OldToNew,
-                                                                ClonedBlocks);
+  // Clone the blocks and identify the boundary ones
+  std::vector<Boundary> Boundaries = cloneBlocks(Plan, OldToNew, ClonedBlocks);
 
   // At this point, we first need to handle all the boundary blocks that
   // represent direct jumps, then we'll take care of the (only) indirect jump,
@@ -710,7 +839,7 @@ void IFI::handleBasicBlock(const model::BasicBlock &Block,
 }
 
 std::pair<BasicBlock *, Function *>
-IFI::isolate(const model::Function &Function) {
+IFI::isolate(const model::Function &Function, const FunctionPlan &Plan) {
   // Map from origina values to new ones
   ValueToValueMapTy OldToNew;
 
@@ -740,7 +869,8 @@ IFI::isolate(const model::Function &Function) {
   TheLogger << DoLog;
   LoggerIndent<> Indent(TheLogger);
 
-  for (const model::BasicBlock &Block : Function.CFG) {
+  revng_assert(Plan.size() == Function.CFG.size());
+  for (const auto &[Block, BlockPlan] : llvm::zip(Function.CFG, Plan)) {
 
     if (TheLogger.isEnabled()) {
       TheLogger << "Isolating ";
@@ -753,7 +883,7 @@ IFI::isolate(const model::Function &Function) {
     LoggerIndent<> Indent2(TheLogger);
 
     // Process the basic block
-    handleBasicBlock(Block, OldToNew, ClonedBlocks);
+    handleBasicBlock(Block, BlockPlan, OldToNew, ClonedBlocks);
   }
 
   // Create a dummy entry branching to real entry
@@ -794,7 +924,7 @@ IFI::isolate(const model::Function &Function) {
   FunctionTags::Lifted.addTo(NewFunction);
 
   revng_assert(NewFunction != nullptr);
-  NewFunction->setName(Function.name());
+  NewFunction->setName(Function.name().str());
 
   FunctionType *FT = NewFunction->getFunctionType();
   revng_assert(FT->getReturnType()->isVoidTy());
@@ -916,6 +1046,20 @@ void IFI::run() {
     ++I;
   }
 
+  // Identify what to clone first, since cloning and extracting alter root
+  std::vector<FunctionPlan> Plans = planIsolation();
+  auto NextPlan = Plans.begin();
+
+  if (MoveBlocks) {
+    for (const FunctionPlan &Plan : Plans) {
+      std::set<BasicBlock *> Owned;
+      for (const BasicBlockPlan &BlockPlan : Plan)
+        Owned.insert(BlockPlan.Blocks.begin(), BlockPlan.Blocks.end());
+      for (BasicBlock *BB : Owned)
+        ++OwnersCount[BB];
+    }
+  }
+
   std::set<Function *> IsolatedFunctions;
   for (const model::Function &Function : Binary.Functions) {
     // Do not isolate fake functions
@@ -923,7 +1067,9 @@ void IFI::run() {
       continue;
 
     // Perform isolation
-    auto [EntryBlock, IsolatedFunction] = isolate(Function);
+    revng_assert(NextPlan != Plans.end());
+    auto [EntryBlock, IsolatedFunction] = isolate(Function, *NextPlan);
+    ++NextPlan;
 
     // Record new isolated function
     BasicBlock *OriginalEntry = GCBI.getBlockAt(Function.Entry);
@@ -0,0 +1,271 @@
+/// \file MergeIdenticalFunctions.cpp
+/// \brief Keeps a single copy of the isolated functions with identical code
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalAlias.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+
+#include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
+#include "revng/FunctionIsolation/MergeIdenticalFunctions.h"
+#include "revng/Model/LoadModelPass.h"
+#include "revng/Support/Debug.h"
+#include "revng/Support/FunctionTags.h"
+#include "revng/Support/IRHelpers.h"
+
+using namespace llvm;
+
+char MergeIdenticalFunctionsPass::ID = 0;
+
+using Register = RegisterPass<MergeIdenticalFunctionsPass>;
+static Register X("merge-identical-functions",
+                  "Merge Identical Functions Pass",
+                  false,
+                  false);
+
+static Logger<> Log("merge-identical-functions");
+
+void MergeIdenticalFunctionsPass::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.addRequired<GeneratedCodeBasicInfoWrapperPass>();
+  AU.addRequired<LoadModelWrapperPass>();
+}
+
+/// An isolated function along with its description in the model
+struct Candidate {
+  Function *F;
+  const model::Function *ModelFunction;
+  /// Offsets from the entry of the start of the basic blocks of the function
+  std::set<uint64_t> BlockOffsets;
+};
+
+/// \brief Hash the structure of \p F, ignoring the value of the constants
+///
+/// Functions that FunctionComparator considers identical have the same hash.
+static hash_code hashStructure(Function &F) {
+  hash_code Result = hash_combine(F.getFunctionType(), F.size());
+  for (BasicBlock &BB : F) {
+    Result = hash_combine(Result, BB.size());
+    for (Instruction &I : BB)
+      Result = hash_combine(Result,
+                            I.getOpcode(),
+                            I.getType(),
+                            I.getNumOperands());
+  }
+
+  return Result;
+}
+
+/// \brief Checks whether two isolated functions can share the same code
+class FunctionComparator {
+private:
+  GlobalVariable *PCCSV;
+  GlobalVariable *ExceptionSourcePC;
+  const Candidate &Left;
+  const Candidate &Right;
+  DenseMap<const Value *, const Value *> Mapping;
+
+public:
+  FunctionComparator(GlobalVariable *PCCSV,
+                     GlobalVariable *ExceptionSourcePC,
+                     const Candidate &Left,
+                     const Candidate &Right) :
+    PCCSV(PCCSV),
+    ExceptionSourcePC(ExceptionSourcePC),
+    Left(Left),
+    Right(Right) {}
+
+public:
+  bool compare() {
+    Function &LeftF = *Left.F;
+    Function &RightF = *Right.F;
+    if (LeftF.getFunctionType() != RightF.getFunctionType()
+        or LeftF.getAttributes() != RightF.getAttributes()
+        or LeftF.size() != RightF.size())
+      return false;
+
+    // Map the arguments, the basic blocks and the instructions by position, so
+    // that forward references can be checked too
+    for (auto [LeftArgument, RightArgument] : zip(LeftF.args(), RightF.args()))
+      Mapping[&LeftArgument] = &RightArgument;
+
+    for (auto [LeftBB, RightBB] : zip(LeftF, RightF)) {
+      if (LeftBB.size() != RightBB.size())
+        return false;
+
+      Mapping[&LeftBB] = &RightBB;
+      for (auto [LeftI, RightI] : zip(LeftBB, RightBB))
+        Mapping[&LeftI] = &RightI;
+    }
+
+    for (auto [LeftBB, RightBB] : zip(LeftF, RightF))
+      for (auto [LeftI, RightI] : zip(LeftBB, RightBB))
+        if (not compare(LeftI, RightI))
+          return false;
+
+    return true;
+  }
+
+private:
+  bool compare(Instruction &LeftI, Instruction &RightI) const {
+    if (not LeftI.isSameOperationAs(&RightI))
+      return false;
+
+    // The arguments of newpc only describe the original instruction
+    if (isCallTo(&LeftI, "newpc"))
+      return isCallTo(&RightI, "newpc");
+
+    if (auto *LeftPHI = dyn_cast<PHINode>(&LeftI)) {
+      auto *RightPHI = cast<PHINode>(&RightI);
+      for (unsigned I = 0; I < LeftPHI->getNumIncomingValues(); ++I)
+        if (Mapping.lookup(LeftPHI->getIncomingBlock(I))
+            != RightPHI->getIncomingBlock(I))
+          return false;
+    }
+
+    if (auto *LeftStore = dyn_cast<StoreInst>(&LeftI)) {
+      auto *RightStore = cast<StoreInst>(&RightI);
+      Value *Pointer = LeftStore->getPointerOperand();
+      if (not compare(Pointer, RightStore->getPointerOperand()))
+        return false;
+
+      // The source of an exception is only reported
+      if (Pointer == ExceptionSourcePC)
+        return true;
+
+      if (Pointer == PCCSV
+          and isSameLocalPC(LeftStore->getValueOperand(),
+                            RightStore->getValueOperand()))
+        return true;
+    }
+
+    for (auto [LeftOperand, RightOperand] :
+         zip(LeftI.operands(), RightI.operands()))
+      if (not compare(LeftOperand.get(), RightOperand.get()))
+        return false;
+
+    return true;
+  }
+
+  bool compare(const Value *LeftV, const Value *RightV) const {
+    auto It = Mapping.find(LeftV);
+    if (It != Mapping.end())
+      return It->second == RightV;
+
+    // Constants and metadata are uniqued, globals are shared
+    return LeftV == RightV;
+  }
+
+  /// \brief Are \p LeftV and \p RightV the address of the same basic block of
+  ///        the respective function?
+  bool isSameLocalPC(const Value *LeftV, const Value *RightV) const {
+    auto *LeftPC = dyn_cast<ConstantInt>(LeftV);
+    auto *RightPC = dyn_cast<ConstantInt>(RightV);
+    if (LeftPC == nullptr or RightPC == nullptr)
+      return false;
+
+    uint64_t LeftEntry = Left.ModelFunction->Entry.address();
+    uint64_t RightEntry = Right.ModelFunction->Entry.address();
+    uint64_t LeftOffset = LeftPC->getLimitedValue() - LeftEntry;
+    uint64_t RightOffset = RightPC->getLimitedValue() - RightEntry;
+    return LeftOffset == RightOffset
+           and Left.BlockOffsets.count(LeftOffset) != 0
+           and Right.BlockOffsets.count(RightOffset) != 0;
+  }
+};
+
+bool MergeIdenticalFunctionsPass::runOnModule(Module &M) {
+  auto &GCBI = getAnalysis<GeneratedCodeBasicInfoWrapperPass>().getGCBI();
+  auto &ModelWrapper = getAnalysis<LoadModelWrapperPass>().get();
+  const model::Binary &Binary = ModelWrapper.getReadOnlyModel();
+
+  auto *ExceptionSourcePC = M.getGlobalVariable("exception_source_pc", true);
+
+  // Group the candidates by prototype and structure. model::Binary::Functions
+  // is sorted, so the first candidate of each group has the lowest entry.
+  using Key = std::pair<std::string, size_t>;
+  std::map<Key, std::vector<Candidate>> Groups;
+  for (const model::Function &ModelFunction : Binary.Functions) {
+    if (ModelFunction.Type == model::FunctionType::Fake
+        or ModelFunction.MergedInto.isValid()
+        or not ModelFunction.Prototype.isValid())
+      continue;
+
+    Function *F = M.getFunction(ModelFunction.name());
+    if (F == nullptr or F->isDeclaration()
+        or not FunctionTags::Lifted.isTagOf(F))
+      continue;
+
+    Candidate New{ F, &ModelFunction, {} };
+    for (const model::BasicBlock &Block : ModelFunction.CFG)
+      New.BlockOffsets.insert(Block.Start.address()
+                              - ModelFunction.Entry.address());
+
+    Key TheKey{ ModelFunction.Prototype.toString(), hashStructure(*F) };
+    Groups[TheKey].push_back(std::move(New));
+  }
+
+  // Compare each candidate with the functions kept so far in its group
+  std::vector<std::pair<const Candidate *, const Candidate *>> Merges;
+  for (auto &[_, Group] : Groups) {
+    std::vector<const Candidate *> Kept;
+    for (const Candidate &Current : Group) {
+      const Candidate *Match = nullptr;
+      for (const Candidate *Other : Kept) {
+        FunctionComparator Comparator(GCBI.pcReg(),
+                                      ExceptionSourcePC,
+                                      *Other,
+                                      Current);
+        if (Comparator.compare()) {
+          Match = Other;
+          break;
+        }
+      }
+
+      if (Match == nullptr)
+        Kept.push_back(&Current);
+      else
+        Merges.push_back({ &Current, Match });
+    }
+  }
+
+  revng_log(Log, "Merging " << Merges.size() << " functions");
+  if (Merges.empty())
+    return false;
+
+  // Record the merges in the model
+  TupleTree<model::Binary> &WriteableBinary = ModelWrapper.getWriteableModel();
+  for (auto [Duplicate, Original] : Merges) {
+    const MetaAddress &Entry = Duplicate->ModelFunction->Entry;
+    const MetaAddress &Target = Original->ModelFunction->Entry;
+    WriteableBinary->Functions[Entry].MergedInto = Target;
+  }
+
+  // Replace the duplicates with an alias of the function they're identical to
+  for (auto [Duplicate, Original] : Merges) {
+    Function *F = Duplicate->F;
+    revng_log(Log,
+              "Merging " << getName(F) << " into " << getName(Original->F));
+
+    F->replaceAllUsesWith(Original->F);
+    auto *Alias = GlobalAlias::create(F->getLinkage(), "", Original->F);
+    Alias->takeName(F);
+    F->eraseFromParent();
+  }
+
+  return true;
+}
@@ -0,0 +1,346 @@
+/// \file OutlineRegions.cpp
+/// \brief Moves the translated code of root into functions of bounded size
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Transforms/Utils/CodeExtractor.h"
+
+#include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
+#include "revng/FunctionIsolation/OutlineRegions.h"
+#include "revng/Support/CommandLine.h"
+#include "revng/Support/Debug.h"
+#include "revng/Support/IRHelpers.h"
+
+using namespace llvm;
+
+char OutlineRegionsPass::ID = 0;
+
+using Register = RegisterPass<OutlineRegionsPass>;
+static Register X("outline-regions", "Outline Regions Pass", false, false);
+
+static Logger<> Log("outline-regions");
+
+static cl::opt<unsigned> RegionSize("outline-region-size",
+                                    cl::init(5000),
+                                    cl::desc("outline from root regions of "
+                                             "about this many instructions"),
+                                    cl::value_desc("instructions"),
+                                    cl::cat(MainCategory));
+
+using BlockVector = std::vector<BasicBlock *>;
+
+/// The blockaddresses passed to function_call prevent moving blocks out of
+/// root. Without isolation function_call does nothing, drop its calls and the
+/// blockaddresses they leave behind.
+static void dropFunctionCallMarkers(Module &M, Function &Root) {
+  Function *FunctionCall = M.getFunction("function_call");
+  if (FunctionCall == nullptr)
+    return;
+
+  for (User *U : make_early_inc_range(FunctionCall->users()))
+    if (auto *Call = dyn_cast<CallInst>(U))
+      Call->eraseFromParent();
+
+  for (BasicBlock &BB : Root) {
+    if (BlockAddress *Address = BlockAddress::lookup(&BB)) {
+      Address->removeDeadConstantUsers();
+      if (Address->use_empty())
+        Address->destroyConstant();
+    }
+  }
+}
+
+/// Can \p BB be moved out of root?
+static bool isOutlinable(BasicBlock *BB) {
+  if (not GeneratedCodeBasicInfo::isTranslated(BB))
+    return false;
+
+  if (BB->hasAddressTaken() or BB->isEHPad() or isa<PHINode>(BB->begin()))
+    return false;
+
+  // Returning from the outlined function would not return from root
+  Instruction *Terminator = BB->getTerminator();
+  if (not isa<BranchInst>(Terminator) and not isa<SwitchInst>(Terminator)
+      and not isa<UnreachableInst>(Terminator))
+    return false;
+
+  for (Instruction &I : *BB) {
+    if (isa<AllocaInst>(&I))
+      return false;
+
+    if (auto *Call = dyn_cast<CallInst>(&I))
+      if (Call->isMustTailCall() or Call->hasFnAttr(Attribute::ReturnsTwice))
+        return false;
+  }
+
+  return true;
+}
+
+/// \brief Group the outlinable blocks of \p Root in regions
+///
+/// The strongly connected components of the CFG restricted to the outlinable
+/// blocks are found with an iterative version of Tarjan's algorithm. They are
+/// produced in reverse topological order, which tends to keep close blocks
+/// that run one after the other, and packed in regions of about RegionSize
+/// instructions.
+static std::vector<BlockVector> computeRegions(Function &Root) {
+  DenseSet<BasicBlock *> Outlinable;
+  for (BasicBlock &BB : Root)
+    if (isOutlinable(&BB))
+      Outlinable.insert(&BB);
+
+  std::vector<BlockVector> Result;
+  BlockVector Current;
+  size_t CurrentSize = 0;
+  auto Emit = [&](BlockVector &Component) {
+    size_t Size = 0;
+    for (BasicBlock *BB : Component)
+      Size += BB->size();
+
+    if (not Current.empty() and CurrentSize + Size > RegionSize) {
+      Result.push_back(std::move(Current));
+      Current.clear();
+      CurrentSize = 0;
+    }
+
+    Current.insert(Current.end(), Component.begin(), Component.end());
+    CurrentSize += Size;
+  };
+
+  struct Pending {
+    BasicBlock *BB;
+    succ_iterator Next;
+  };
+
+  DenseMap<BasicBlock *, unsigned> Indices;
+  DenseMap<BasicBlock *, unsigned> LowLinks;
+  DenseSet<BasicBlock *> OnStack;
+  BlockVector Stack;
+  std::vector<Pending> Visit;
+
+  auto Enter = [&](BasicBlock *BB) {
+    unsigned Index = Indices.size();
+    Indices[BB] = Index;
+    LowLinks[BB] = Index;
+    Stack.push_back(BB);
+    OnStack.insert(BB);
+    Visit.push_back({ BB, succ_begin(BB) });
+  };
+
+  for (BasicBlock &Start : Root) {
+    if (Outlinable.count(&Start) == 0 or Indices.count(&Start) != 0)
+      continue;
+
+    Enter(&Start);
+    while (not Visit.empty()) {
+      Pending &Top = Visit.back();
+      if (Top.Next != succ_end(Top.BB)) {
+        BasicBlock *BB = Top.BB;
+        BasicBlock *Successor = *Top.Next;
+        ++Top.Next;
+
+        if (Outlinable.count(Successor) == 0)
+          continue;
+
+        auto It = Indices.find(Successor);
+        if (It == Indices.end())
+          Enter(Successor);
+        else if (OnStack.count(Successor) != 0)
+          LowLinks[BB] = std::min(LowLinks[BB], It->second);
+
+        continue;
+      }
+
+      BasicBlock *BB = Top.BB;
+      Visit.pop_back();
+      unsigned LowLink = LowLinks[BB];
+      if (not Visit.empty()) {
+        unsigned &ParentLowLink = LowLinks[Visit.back().BB];
+        ParentLowLink = std::min(ParentLowLink, LowLink);
+      }
+
+      // Is BB the root of a strongly connected component?
+      if (LowLink != Indices[BB])
+        continue;
+
+      BlockVector Component;
+      BasicBlock *Member = nullptr;
+      do {
+        Member = Stack.back();
+        Stack.pop_back();
+        OnStack.erase(Member);
+        Component.push_back(Member);
+      } while (Member != BB);
+
+      Emit(Component);
+    }
+  }
+
+  if (not Current.empty())
+    Result.push_back(std::move(Current));
+
+  return Result;
+}
+
+/// An edge entering a region from outside, as successor \p Index of
+/// \p Terminator
+struct EntryEdge {
+  Instruction *Terminator;
+  unsigned Index;
+};
+
+/// \brief Collect, for each region, the edges entering it from outside
+///
+/// The dispatcher alone has an edge to each jump target: all the edges are
+/// visited at once, rather than looking at the predecessors of each region.
+static std::vector<std::vector<EntryEdge>>
+collectEntryEdges(Function &Root, const std::vector<BlockVector> &Regions) {
+  DenseMap<BasicBlock *, unsigned> RegionOf;
+  for (unsigned I = 0; I < Regions.size(); ++I)
+    for (BasicBlock *BB : Regions[I])
+      RegionOf[BB] = I;
+
+  std::vector<std::vector<EntryEdge>> Result(Regions.size());
+  for (BasicBlock &BB : Root) {
+    auto It = RegionOf.find(&BB);
+    bool Inside = It != RegionOf.end();
+    Instruction *Terminator = BB.getTerminator();
+    for (unsigned I = 0; I < Terminator->getNumSuccessors(); ++I) {
+      auto SuccessorIt = RegionOf.find(Terminator->getSuccessor(I));
+      if (SuccessorIt == RegionOf.end())
+        continue;
+
+      unsigned Region = SuccessorIt->second;
+      if (not Inside or It->second != Region)
+        Result[Region].push_back({ Terminator, I });
+    }
+  }
+
+  return Result;
+}
+
+/// \brief Make \p Region single-entry, as required by CodeExtractor
+///
+/// A new block is prepended to \p Region. All the \p Edges entering the
+/// region from outside now go through it, and it jumps to their original
+/// destination through a switch on the index of the entry.
+///
+/// \return false if \p Region is unreachable.
+static bool createHeader(BlockVector &Region, ArrayRef<EntryEdge> Edges) {
+  if (Edges.empty())
+    return false;
+
+  BlockVector Entries;
+  DenseMap<BasicBlock *, unsigned> EntryIndices;
+  for (const EntryEdge &Edge : Edges) {
+    BasicBlock *Entry = Edge.Terminator->getSuccessor(Edge.Index);
+    if (EntryIndices.try_emplace(Entry, Entries.size()).second)
+      Entries.push_back(Entry);
+  }
+
+  BasicBlock *FirstEntry = Entries[0];
+  Function *F = FirstEntry->getParent();
+  LLVMContext &Context = F->getContext();
+  auto *Header = BasicBlock::Create(Context, "region_entry", F, FirstEntry);
+
+  if (Entries.size() == 1) {
+    BranchInst::Create(FirstEntry, Header);
+    for (const EntryEdge &Edge : Edges)
+      Edge.Terminator->setSuccessor(Edge.Index, Header);
+  } else {
+    // Each predecessor reaches the header through a block of its own, so
+    // that a predecessor can reach different entries
+    auto *Int32 = Type::getInt32Ty(Context);
+    auto *Selector = PHINode::Create(Int32, 0, "entry_index", Header);
+    auto *Switch = SwitchInst::Create(Selector,
+                                      FirstEntry,
+                                      Entries.size() - 1,
+                                      Header);
+    for (unsigned I = 1; I < Entries.size(); ++I)
+      Switch->addCase(ConstantInt::get(Int32, I), Entries[I]);
+
+    using BlockPair = std::pair<BasicBlock *, BasicBlock *>;
+    DenseMap<BlockPair, BasicBlock *> Stubs;
+    for (const EntryEdge &Edge : Edges) {
+      BasicBlock *Entry = Edge.Terminator->getSuccessor(Edge.Index);
+      BasicBlock *&Stub = Stubs[{ Edge.Terminator->getParent(), Entry }];
+      if (Stub == nullptr) {
+        Stub = BasicBlock::Create(Context, "", F, Header);
+        BranchInst::Create(Header, Stub);
+        Selector->addIncoming(ConstantInt::get(Int32, EntryIndices[Entry]),
+                              Stub);
+      }
+
+      Edge.Terminator->setSuccessor(Edge.Index, Stub);
+    }
+  }
+
+  Region.insert(Region.begin(), Header);
+  return true;
+}
+
+bool OutlineRegionsPass::runOnModule(Module &M) {
+  Function *Root = M.getFunction("root");
+  if (Root == nullptr or Root->isDeclaration())
+    return false;
+
+  dropFunctionCallMarkers(M, *Root);
+
+  std::vector<BlockVector> Regions = computeRegions(*Root);
+  revng_log(Log, "Found " << Regions.size() << " regions");
+
+  // Create all the headers before outlining anything, since outlining
+  // rewrites the edges leaving a region
+  auto Edges = collectEntryEdges(*Root, Regions);
+  std::vector<BlockVector> Reachable;
+  for (unsigned I = 0; I < Regions.size(); ++I)
+    if (createHeader(Regions[I], Edges[I]))
+      Reachable.push_back(std::move(Regions[I]));
+
+  CodeExtractorAnalysisCache CEAC(*Root);
+  unsigned OutlinedCount = 0;
+  for (BlockVector &Region : Reachable) {
+    CodeExtractor Extractor(Region,
+                            nullptr,
+                            false,
+                            nullptr,
+                            nullptr,
+                            nullptr,
+                            false,
+                            false,
+                            "region");
+
+    // The header keeps root correct even if the region stays there
+    if (not Extractor.isEligible()) {
+      revng_log(Log, "Cannot outline " << getName(Region.front()));
+      continue;
+    }
+
+    Function *NewFunction = Extractor.extractCodeRegion(CEAC);
+    if (NewFunction == nullptr)
+      continue;
+
+    NewFunction->addFnAttr(Attribute::NoInline);
+    ++OutlinedCount;
+  }
+
+  revng_log(Log, "Outlined " << OutlinedCount << " regions");
+
+  return true;
+}
@@ -5,9 +5,13 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include "llvm/Support/CommandLine.h"
+
 #include "revng/ADT/GenericGraph.h"
+#include "revng/BasicAnalyses/CSVUsage.h"
 #include "revng/FunctionIsolation/PromoteCSVs.h"
 #include "revng/FunctionIsolation/StructInitializers.h"
+#include "revng/Support/CommandLine.h"
 #include "revng/Support/IRHelpers.h"
 #include "revng/TypeShrinking/MFP.h"
 #include "revng/TypeShrinking/SetLattices.h"
@@ -19,6 +23,14 @@ char PromoteCSVsPass::ID = 0;
 using Register = RegisterPass<PromoteCSVsPass>;
 static Register X("promote-csvs", "Promote CSVs Pass", true, true);
 
+static cl::opt<unsigned> ThreadsCount("promote-csvs-threads",
+                                      cl::init(1),
+                                      cl::desc("number of threads computing "
+                                               "the CSVs used by independent "
+                                               "functions"),
+                                      cl::value_desc("threads"),
+                                      cl::cat(MainCategory));
+
 // TODO: switch from CallInst to CallBase
 
 struct CSVsUsageMap {
@@ -37,6 +49,8 @@ struct CSVsUsageMap {
   }
 };
 
+using UsedCSVSet = std::set<std::pair<bool, GlobalVariable *>>;
+
 class PromoteCSVs {
 private:
   struct WrapperKey {
@@ -62,6 +76,16 @@ private:
   const GeneratedCodeBasicInfo &GCBI;
   std::set<GlobalVariable *> CSVs;
 
+  /// The tags of the functions of the module, decoded once
+  FunctionTags::TagsIndex Tagged;
+
+  /// The direct CSV usage of each function, shared across all the lifted
+  /// functions calling it
+  CSVUsageCache Usage;
+
+  /// The CSVs used by each function, including those used by its callees
+  std::map<Function *, UsedCSVSet> Closures;
+
 public:
   PromoteCSVs(Module *M, const GeneratedCodeBasicInfo &GCBI);
 
@@ -76,22 +100,47 @@ private:
   Function *createWrapper(const WrapperKey &Key);
   CSVsUsageMap getUsedCSVs(ArrayRef<CallInst *> CallsRange);
   void wrapCallsToHelpers(Function *F);
+  bool needsWrapper(Function *F) const;
 };
 
 PromoteCSVs::PromoteCSVs(Module *M, const GeneratedCodeBasicInfo &GCBI) :
-  M(M), Initializers(M), CSVInitializers(M, false), GCBI(GCBI) {
+  M(M),
+  Initializers(M),
+  CSVInitializers(M, false),
+  GCBI(GCBI),
+  Tagged(*M),
+  Usage(GCBI.csvs()) {
 
   CSVInitializers.addFnAttribute(Attribute::ReadOnly);
   CSVInitializers.addFnAttribute(Attribute::NoUnwind);
   CSVInitializers.setTags({ &FunctionTags::OpaqueCSVValue });
 
+  copy(GCBI.csvs(), std::inserter(this->CSVs, this->CSVs.begin()));
+
   // Record existing initializers
-  for (GlobalVariable *CSV : GCBI.csvs())
-    if (auto *F = M->getFunction((Twine("init_") + CSV->getName()).str()))
-      if (FunctionTags::OpaqueCSVValue.isTagOf(F))
-        CSVInitializers.record(CSV->getName(), F);
+  auto CSVName = [this](Function &F) -> std::optional<StringRef> {
+    StringRef Name = F.getName();
+    if (not Name.consume_front("init_"))
+      return std::nullopt;
 
-  copy(GCBI.csvs(), std::inserter(this->CSVs, this->CSVs.begin()));
+    auto *CSV = this->M->getGlobalVariable(Name, true);
+    if (CSV == nullptr or this->CSVs.count(CSV) == 0)
+      return std::nullopt;
+
+    return CSV->getName();
+  };
+  CSVInitializers.recordExisting(CSVName);
+
+  // Each promoted function initializes all the CSVs: create the initializers
+  // upfront, so that promoteCSVs only looks them up
+  auto Names = map_range(GCBI.csvs(),
+                         [](GlobalVariable *CSV) { return CSV->getName(); });
+  CSVInitializers.prewarm(Names, [this](StringRef Name) {
+    auto *CSV = this->M->getGlobalVariable(Name, true);
+    Type *CSVType = CSV->getType()->getPointerElementType();
+    auto *FT = FunctionType::get(CSVType, false);
+    return std::make_pair(FT, ("init_" + Name).str());
+  });
 }
 
 // TODO: assign alias information
@@ -153,9 +202,10 @@ Function *PromoteCSVs::createWrapper(const WrapperKey &Key) {
   HelperWrapper->setSection(Helper->getSection());
 
   // Copy and extend tags
-  auto Tags = FunctionTags::TagsSet::from(Helper);
+  auto Tags = Tagged.tags(Helper);
   Tags.insert(&FunctionTags::CSVsAsArgumentsWrapper);
   Tags.addTo(HelperWrapper);
+  Tagged.update(HelperWrapper);
 
   auto *Entry = BasicBlock::Create(Context, "", HelperWrapper);
 
@@ -360,7 +410,7 @@ void PromoteCSVs::promoteCSVs(Function *F) {
 
 struct FunctionNodeData {
   Function *F;
-  using UsedCSVSet = std::set<std::pair<bool, GlobalVariable *>>;
+  using UsedCSVSet = ::UsedCSVSet;
   UsedCSVSet UsedCSVs;
 };
 
@@ -393,11 +443,11 @@ static void addEdge(FunctionNode *Source, FunctionNode *Destination) {
   Source->addSuccessor(Destination);
 }
 
-static bool needsWrapper(Function *F) {
+bool PromoteCSVs::needsWrapper(Function *F) const {
   // Ignore lifted functions and functions that have already been wrapped
   {
     using namespace FunctionTags;
-    auto Tags = TagsSet::from(F);
+    auto Tags = Tagged.tags(F);
     if (Tags.contains(Lifted) or Tags.contains(CSVsAsArgumentsWrapper))
       return false;
   }
@@ -438,7 +488,7 @@ CSVsUsageMap PromoteCSVs::getUsedCSVs(ArrayRef<CallInst *> CallsRange) {
   std::queue<Function *> Queue;
   for (CallInst *Call : CallsRange) {
     Function *Callee = getCallee(Call);
-    if (FunctionTags::Helper.isTagOf(Callee)) {
+    if (Tagged.has(FunctionTags::Helper, Callee)) {
       CSVsUsageMap::CSVsUsage &Usage = Result.Calls[Call];
       auto UsedCSVs = GCBI.getCSVUsedByHelperCall(Call);
       Usage.Read = UsedCSVs.Read;
@@ -454,59 +504,46 @@ CSVsUsageMap PromoteCSVs::getUsedCSVs(ArrayRef<CallInst *> CallsRange) {
 
     auto *CallerNode = getNode(NodeMap, CallGraph, F);
 
-    for (BasicBlock &BB : *F) {
-
-      for (Instruction &I : BB) {
-        bool Write = false;
-        GlobalVariable *CSV = nullptr;
-
-        if (auto *Store = dyn_cast<StoreInst>(&I)) {
-
-          // Record store
-          Write = true;
-          CSV = dyn_cast<GlobalVariable>(skipCasts(Store->getPointerOperand()));
-
-        } else if (auto *Load = dyn_cast<StoreInst>(&I)) {
-
-          // Record load
-          CSV = dyn_cast<GlobalVariable>(skipCasts(Store->getPointerOperand()));
-
-        } else if (auto *Call = dyn_cast<CallInst>(&I)) {
-          Function *Callee = getCallee(Call);
-          revng_assert(Callee != nullptr);
-
-          // In case we meet an `abort` skip this block
-          if (Callee->getName() == "abort")
-            break;
+    // If the CSVs used by F and its callees are known, there's no need to
+    // explore them again
+    auto ClosureIt = Closures.find(F);
+    if (ClosureIt != Closures.end()) {
+      CallerNode->UsedCSVs = ClosureIt->second;
+      continue;
+    }
 
-          // TODO: use forwardTaintAnalysis
-          if (not needsWrapper(Callee))
-            continue;
+    const FunctionCSVUsage &FunctionUsage = Usage.get(F);
+    for (GlobalVariable *CSV : FunctionUsage.Read)
+      CallerNode->UsedCSVs.insert({ false, CSV });
+    for (GlobalVariable *CSV : FunctionUsage.Written)
+      CallerNode->UsedCSVs.insert({ true, CSV });
 
-          // Ensure callee is visited
-          if (NodeMap.count(Callee) == 0)
-            Queue.push(Callee);
+    for (Function *Callee : FunctionUsage.Callees) {
+      // TODO: use forwardTaintAnalysis
+      if (not needsWrapper(Callee))
+        continue;
 
-          // Insert an edge in the call graph
-          auto *CalleeNode = getNode(NodeMap, CallGraph, Callee);
-          addEdge(CalleeNode, CallerNode);
-        }
+      // Ensure callee is visited
+      if (NodeMap.count(Callee) == 0)
+        Queue.push(Callee);
 
-        // If there was a memory access targeting a CSV, record it
-        if (CSVs.count(CSV) != 0) {
-          CallerNode->UsedCSVs.insert({ Write, CSV });
-        }
-      }
+      // Insert an edge in the call graph
+      auto *CalleeNode = getNode(NodeMap, CallGraph, Callee);
+      addEdge(CalleeNode, CallerNode);
     }
   }
 
-  auto AnalysisResult = getMaximalFixedPoint<UsedRegistersMFI>(&CallGraph,
-                                                               {},
-                                                               {},
-                                                               {});
+  using MFI = UsedRegistersMFI;
+  auto AnalysisResult = getMaximalFixedPointParallel<MFI>(&CallGraph,
+                                                          {},
+                                                          {},
+                                                          {},
+                                                          ThreadsCount);
 
   // Populate results set
-  for (auto &[Label, Value] : AnalysisResult) {
+  for (auto [Label, Value] : AnalysisResult.entries()) {
+    Closures[Label->F] = Value.OutValue;
+
     auto &FunctionDescriptor = Result.Functions[Label->F];
     for (auto [IsWrite, CSV] : Value.OutValue) {
       if (IsWrite)
@@ -554,12 +591,14 @@ void PromoteCSVs::wrapCallsToHelpers(Function *F) {
 }
 
 void PromoteCSVs::run() {
-  for (Function &F : FunctionTags::Lifted.functions(M)) {
+  // Wrappers are not lifted functions, the range is not affected by their
+  // creation
+  for (Function *F : Tagged.functions(FunctionTags::Lifted)) {
     // Wrap calls to wrappers
-    wrapCallsToHelpers(&F);
+    wrapCallsToHelpers(F);
 
     // (Re-)promote CSVs
-    promoteCSVs(&F);
+    promoteCSVs(F);
   }
 }
 
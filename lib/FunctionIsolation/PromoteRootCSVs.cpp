@@ -0,0 +1,263 @@
+/// \file PromoteRootCSVs.cpp
+/// \brief Keeps the CSVs of root in SSA registers within single-entry regions
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <utility>
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/Transforms/Utils/PromoteMemToReg.h"
+
+#include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
+#include "revng/FunctionIsolation/PromoteRootCSVs.h"
+#include "revng/Support/Debug.h"
+#include "revng/Support/FunctionTags.h"
+#include "revng/Support/IRHelpers.h"
+
+using namespace llvm;
+
+char PromoteRootCSVsPass::ID = 0;
+
+using Register = RegisterPass<PromoteRootCSVsPass>;
+static Register X("promote-root-csvs", "Promote Root CSVs Pass", true, false);
+
+static Logger<> Log("promote-root-csvs");
+
+PromoteRootCSVsPass::PromoteRootCSVsPass() : FunctionPass(ID) {
+  // Unlike opt, revng-translate does not register the analyses upfront
+  initializeDominatorTreeWrapperPassPass(*PassRegistry::getPassRegistry());
+}
+
+void PromoteRootCSVsPass::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.addRequired<DominatorTreeWrapperPass>();
+  AU.setPreservesCFG();
+}
+
+/// How a region accesses a CSV
+struct CSVAccess {
+  bool Written = false;
+
+  /// The address of the CSV is used other than by a load or a store
+  bool Escapes = false;
+
+  /// The loads and the stores of the CSV in the region
+  SmallVector<Instruction *, 4> Accesses;
+};
+
+struct Region {
+  std::vector<BasicBlock *> Blocks;
+  MapVector<GlobalVariable *, CSVAccess> CSVs;
+};
+
+using PromotedCSVs = SmallVector<std::pair<GlobalVariable *, AllocaInst *>, 16>;
+
+/// Can \p BB be part of a region?
+static bool isPromotable(BasicBlock *BB) {
+  if (not GeneratedCodeBasicInfo::isTranslated(BB))
+    return false;
+
+  Instruction *Terminator = BB->getTerminator();
+  return isa<BranchInst>(Terminator) or isa<SwitchInst>(Terminator)
+         or isa<ReturnInst>(Terminator) or isa<UnreachableInst>(Terminator);
+}
+
+/// An instruction along with whether it uses a value directly
+using InstructionUse = std::pair<Instruction *, bool>;
+
+/// \brief Collect the instructions using \p V, possibly through constant
+///        expressions
+static void collectInstructionUsers(Value *V,
+                                    bool Direct,
+                                    SmallVectorImpl<InstructionUse> &Users) {
+  for (User *U : V->users()) {
+    if (auto *I = dyn_cast<Instruction>(U))
+      Users.push_back({ I, Direct });
+    else if (auto *Expression = dyn_cast<ConstantExpr>(U))
+      collectInstructionUsers(Expression, false, Users);
+  }
+}
+
+/// Load each CSV of \p CSVs into its alloca
+static void reload(IRBuilder<> &Builder, const PromotedCSVs &CSVs) {
+  for (auto [CSV, Alloca] : CSVs)
+    Builder.CreateStore(Builder.CreateLoad(CSV), Alloca);
+}
+
+/// Store each CSV of \p CSVs back to the global variable
+static void spill(IRBuilder<> &Builder, const PromotedCSVs &CSVs) {
+  for (auto [CSV, Alloca] : CSVs)
+    Builder.CreateStore(Builder.CreateLoad(Alloca), CSV);
+}
+
+/// The CSVs of \p CSVs that \p Call might write
+static PromotedCSVs clobbered(CallInst *Call, const PromotedCSVs &CSVs) {
+  if (not isCallToHelper(Call))
+    return CSVs;
+
+  auto Usage = GeneratedCodeBasicInfo::getCSVUsedByHelperCallIfAvailable(Call);
+  if (not Usage)
+    return CSVs;
+
+  PromotedCSVs Result;
+  for (auto [CSV, Alloca] : CSVs)
+    if (is_contained(Usage->Written, CSV))
+      Result.push_back({ CSV, Alloca });
+  return Result;
+}
+
+bool PromoteRootCSVsPass::runOnFunction(Function &F) {
+  if (not FunctionTags::Root.isTagOf(&F))
+    return false;
+
+  // Assign each translated basic block to a region, identified by its head.
+  // Visiting in reverse post-order, the predecessors of a block are assigned
+  // before the block itself, except on back edges.
+  DenseMap<BasicBlock *, BasicBlock *> HeadOf;
+  MapVector<BasicBlock *, Region> Regions;
+  ReversePostOrderTraversal<Function *> RPOT(&F);
+  for (BasicBlock *BB : RPOT) {
+    if (not isPromotable(BB))
+      continue;
+
+    BasicBlock *Head = nullptr;
+    if (not BB->hasAddressTaken()) {
+      for (BasicBlock *Predecessor : predecessors(BB)) {
+        BasicBlock *PredecessorHead = HeadOf.lookup(Predecessor);
+        if (PredecessorHead == nullptr
+            or (Head != nullptr and PredecessorHead != Head)) {
+          Head = nullptr;
+          break;
+        }
+        Head = PredecessorHead;
+      }
+    }
+
+    if (Head == nullptr)
+      Head = BB;
+
+    HeadOf[BB] = Head;
+    Regions[Head].Blocks.push_back(BB);
+  }
+
+  // Classify the accesses to each CSV, region by region
+  for (GlobalVariable *CSV :
+       GeneratedCodeBasicInfo::collectCSVs(*F.getParent())) {
+    SmallVector<InstructionUse, 16> Users;
+    collectInstructionUsers(CSV, true, Users);
+    for (auto [I, Direct] : Users) {
+      BasicBlock *Head = HeadOf.lookup(I->getParent());
+      if (Head == nullptr)
+        continue;
+
+      CSVAccess &Access = Regions[Head].CSVs[CSV];
+      auto *Load = dyn_cast<LoadInst>(I);
+      auto *Store = dyn_cast<StoreInst>(I);
+      if (Direct and Load != nullptr and Load->isSimple()) {
+        Access.Accesses.push_back(I);
+      } else if (Direct and Store != nullptr and Store->isSimple()
+                 and Store->getValueOperand() != CSV) {
+        Access.Written = true;
+        Access.Accesses.push_back(I);
+      } else {
+        Access.Escapes = true;
+      }
+    }
+  }
+
+  // Each CSV gets a single alloca, which is (re-)initialized at the head of
+  // each region using it
+  DenseMap<GlobalVariable *, AllocaInst *> Allocas;
+  std::vector<AllocaInst *> NewAllocas;
+  BasicBlock &Entry = F.getEntryBlock();
+  IRBuilder<> AllocaBuilder(&Entry, Entry.getFirstInsertionPt());
+
+  IRBuilder<> Builder(F.getContext());
+  unsigned PromotedRegions = 0;
+  for (auto &[Head, TheRegion] : Regions) {
+    PromotedCSVs Promoted;
+    PromotedCSVs Written;
+    for (auto &[CSV, Access] : TheRegion.CSVs) {
+      if (Access.Escapes)
+        continue;
+
+      AllocaInst *&Alloca = Allocas[CSV];
+      if (Alloca == nullptr) {
+        Type *CSVType = CSV->getType()->getPointerElementType();
+        Alloca = AllocaBuilder.CreateAlloca(CSVType, nullptr, CSV->getName());
+        NewAllocas.push_back(Alloca);
+      }
+
+      for (Instruction *I : Access.Accesses)
+        I->replaceUsesOfWith(CSV, Alloca);
+
+      Promoted.push_back({ CSV, Alloca });
+      if (Access.Written)
+        Written.push_back({ CSV, Alloca });
+    }
+
+    if (Promoted.empty())
+      continue;
+
+    ++PromotedRegions;
+
+    Builder.SetInsertPoint(Head, Head->getFirstInsertionPt());
+    reload(Builder, Promoted);
+
+    for (BasicBlock *BB : TheRegion.Blocks) {
+      // Callees see the global variables, and might write them
+      for (Instruction &I : make_early_inc_range(*BB)) {
+        auto *Call = dyn_cast<CallInst>(&I);
+        if (Call == nullptr or isMarker(Call) or Call->doesNotAccessMemory())
+          continue;
+
+        Builder.SetInsertPoint(Call);
+        spill(Builder, Written);
+
+        if (Call->onlyReadsMemory())
+          continue;
+
+        Builder.SetInsertPoint(Call->getNextNode());
+        reload(Builder, clobbered(Call, Promoted));
+      }
+
+      // Store the CSVs back before leaving the region
+      Instruction *Terminator = BB->getTerminator();
+      if (isa<UnreachableInst>(Terminator))
+        continue;
+
+      auto LeavesRegion = [&HeadOf, Head = Head](BasicBlock *Successor) {
+        return Successor == Head or HeadOf.lookup(Successor) != Head;
+      };
+      if (succ_empty(BB) or any_of(successors(BB), LeavesRegion)) {
+        Builder.SetInsertPoint(Terminator);
+        spill(Builder, Written);
+      }
+    }
+  }
+
+  revng_log(Log,
+            "Promoting " << NewAllocas.size() << " CSVs in " << PromotedRegions
+                         << " out of " << Regions.size() << " regions");
+
+  if (NewAllocas.empty())
+    return false;
+
+  auto &DT = getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+  PromoteMemToReg(NewAllocas, DT);
+
+  return true;
+}
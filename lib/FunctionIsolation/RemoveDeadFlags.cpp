@@ -0,0 +1,208 @@
+/// \file RemoveDeadFlags.cpp
+/// \brief Removes the stores to the x86 condition code CSVs that are never read
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <vector>
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+
+#include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
+#include "revng/FunctionIsolation/RemoveDeadFlags.h"
+#include "revng/Support/Debug.h"
+#include "revng/Support/FunctionTags.h"
+#include "revng/Support/IRHelpers.h"
+
+using namespace llvm;
+
+char RemoveDeadFlagsPass::ID = 0;
+using Register = RegisterPass<RemoveDeadFlagsPass>;
+static Register X("remove-dead-flags", "Remove Dead Flags Pass", false, false);
+
+static Logger<> Log("remove-dead-flags");
+
+/// Names of the CSVs holding the lazily computed x86 condition codes
+static const char *FlagCSVNames[] = { "cc_op", "cc_src", "cc_dst", "cc_src2" };
+
+class DeadFlagsRemover {
+private:
+  /// Bit I is set if the I-th flag is live
+  using LiveSet = uint8_t;
+
+private:
+  SmallVector<GlobalVariable *, 4> Flags;
+  LiveSet AllFlags = 0;
+
+public:
+  DeadFlagsRemover(Module &M) {
+    for (const char *Name : FlagCSVNames) {
+      GlobalVariable *CSV = M.getGlobalVariable(Name);
+      if (CSV == nullptr or not onlyLoadedAndStored(CSV))
+        continue;
+
+      AllFlags |= 1 << Flags.size();
+      Flags.push_back(CSV);
+    }
+  }
+
+public:
+  bool empty() const { return Flags.empty(); }
+
+  /// \return the number of removed stores
+  unsigned run(Function &F) {
+    std::map<BasicBlock *, LiveSet> LiveIn;
+
+    // Backward liveness analysis on the basic blocks
+    std::set<BasicBlock *> Pending;
+    std::vector<BasicBlock *> WorkList;
+    for (BasicBlock &BB : F) {
+      Pending.insert(&BB);
+      WorkList.push_back(&BB);
+    }
+
+    while (not WorkList.empty()) {
+      BasicBlock *BB = WorkList.back();
+      WorkList.pop_back();
+      Pending.erase(BB);
+
+      LiveSet Live = transfer(BB, liveOut(BB, LiveIn), nullptr);
+      auto It = LiveIn.find(BB);
+      if (It != LiveIn.end() and It->second == Live)
+        continue;
+
+      LiveIn[BB] = Live;
+      for (BasicBlock *Predecessor : predecessors(BB))
+        if (Pending.insert(Predecessor).second)
+          WorkList.push_back(Predecessor);
+    }
+
+    // Collect and erase the stores whose value is never read
+    std::vector<StoreInst *> DeadStores;
+    for (BasicBlock &BB : F)
+      transfer(&BB, liveOut(&BB, LiveIn), &DeadStores);
+
+    for (StoreInst *Store : DeadStores)
+      Store->eraseFromParent();
+
+    return DeadStores.size();
+  }
+
+private:
+  static bool onlyLoadedAndStored(GlobalVariable *CSV) {
+    for (User *U : CSV->users()) {
+      if (auto *Store = dyn_cast<StoreInst>(U)) {
+        if (Store->getPointerOperand() != CSV or Store->isVolatile())
+          return false;
+      } else if (auto *Load = dyn_cast<LoadInst>(U)) {
+        if (Load->isVolatile())
+          return false;
+      } else {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  LiveSet mask(Value *Pointer) const {
+    for (unsigned I = 0; I < Flags.size(); ++I)
+      if (Flags[I] == Pointer)
+        return 1 << I;
+    return 0;
+  }
+
+  LiveSet liveOut(BasicBlock *BB,
+                  const std::map<BasicBlock *, LiveSet> &LiveIn) const {
+    // The flags are dead upon return and at the end of the program
+    LiveSet Result = 0;
+    for (BasicBlock *Successor : successors(BB)) {
+      auto It = LiveIn.find(Successor);
+      if (It != LiveIn.end())
+        Result |= It->second;
+    }
+    return Result;
+  }
+
+  /// \return the flags read by \p Call, or AllFlags if unknown
+  LiveSet readByCall(CallBase *Call) const {
+    Function *Callee = Call->getCalledFunction();
+    if (Callee == nullptr)
+      return AllFlags;
+
+    // Helpers might leave the function by raising an exception, in which case
+    // the root function resumes from the current state
+    if (FunctionTags::Exceptional.isTagOf(Callee))
+      return AllFlags;
+
+    if (Callee->getName() == "newpc" or Callee->doesNotAccessMemory())
+      return 0;
+
+    if (isCallToHelper(Call)) {
+      using GCBI = GeneratedCodeBasicInfo;
+      auto Usage = GCBI::getCSVUsedByHelperCallIfAvailable(Call);
+      if (not Usage)
+        return AllFlags;
+
+      LiveSet Result = 0;
+      for (GlobalVariable *CSV : Usage->Read)
+        Result |= mask(CSV);
+      return Result;
+    }
+
+    return AllFlags;
+  }
+
+  /// \brief Compute the flags live at the beginning of \p BB
+  ///
+  /// \param DeadStores if not nullptr, the stores to flags that are not live
+  ///        are collected here
+  LiveSet transfer(BasicBlock *BB,
+                   LiveSet Live,
+                   std::vector<StoreInst *> *DeadStores) const {
+    for (Instruction &I : make_range(BB->rbegin(), BB->rend())) {
+      if (auto *Store = dyn_cast<StoreInst>(&I)) {
+        LiveSet Written = mask(Store->getPointerOperand());
+        if (Written != 0) {
+          if (DeadStores != nullptr and (Live & Written) == 0)
+            DeadStores->push_back(Store);
+          Live &= ~Written;
+        }
+      } else if (auto *Load = dyn_cast<LoadInst>(&I)) {
+        Live |= mask(Load->getPointerOperand());
+      } else if (auto *Call = dyn_cast<CallBase>(&I)) {
+        Function *Callee = Call->getCalledFunction();
+        if (Callee != nullptr and FunctionTags::Lifted.isTagOf(Callee)) {
+          // The callee doesn't read the flags we left
+          Live = 0;
+        } else {
+          Live |= readByCall(Call);
+        }
+      }
+    }
+
+    return Live;
+  }
+};
+
+bool RemoveDeadFlagsPass::runOnModule(Module &M) {
+  DeadFlagsRemover Remover(M);
+  if (Remover.empty())
+    return false;
+
+  unsigned Removed = 0;
+  for (Function &F : FunctionTags::Lifted.functions(&M))
+    Removed += Remover.run(F);
+
+  revng_log(Log, "Removed " << Removed << " stores to flags");
+
+  return Removed != 0;
+}
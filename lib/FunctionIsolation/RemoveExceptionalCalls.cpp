@@ -5,10 +5,14 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <set>
+#include <vector>
+
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
 
+#include "revng/BasicAnalyses/ModuleCleanup.h"
 #include "revng/FunctionIsolation/RemoveExceptionalCalls.h"
 #include "revng/Support/FunctionTags.h"
 #include "revng/Support/IRHelpers.h"
@@ -21,15 +25,34 @@ using Register = RegisterPass<RemoveExceptionalCalls>;
 static Register
   X("remove-exceptional-functions", "Remove Exceptional Functions");
 
-bool RemoveExceptionalCalls::runOnModule(llvm::Module &M) {
-  LLVMContext &C = M.getContext();
+class RemoveExceptionalCallsStep : public CleanupStep {
+private:
+  std::vector<CallBase *> ToErase;
+
+public:
+  bool shouldVisit(Function &F) override {
+    return FunctionTags::Lifted.isTagOf(&F);
+  }
+
+  void visitInstruction(Instruction &I) override {
+    // Collect all calls to exceptional functions in lifted functions
+    auto *Call = dyn_cast<CallBase>(&I);
+    if (Call == nullptr)
+      return;
+
+    auto *Callee = dyn_cast<Function>(skipCasts(Call->getCalledOperand()));
+    if (Callee != nullptr and FunctionTags::Exceptional.isTagOf(Callee))
+      ToErase.push_back(Call);
+  }
 
-  // Collect all calls to exceptional functions in lifted functions
-  std::set<CallBase *> ToErase;
-  for (Function &F : FunctionTags::Exceptional.functions(&M))
-    for (CallBase *Call : callers(&F))
-      if (FunctionTags::Lifted.isTagOf(Call->getParent()->getParent()))
-        ToErase.insert(Call);
+  bool finalize(Module &M) override;
+};
+
+static RegisterCleanupStep<RemoveExceptionalCallsStep>
+  Y("remove-exceptional-functions");
+
+bool RemoveExceptionalCallsStep::finalize(Module &M) {
+  LLVMContext &C = M.getContext();
 
   std::set<Function *> ToCleanup;
   for (CallBase *Call : ToErase) {
@@ -57,5 +80,12 @@ bool RemoveExceptionalCalls::runOnModule(llvm::Module &M) {
   for (Function *F : ToCleanup)
     EliminateUnreachableBlocks(*F, nullptr, false);
 
+  ToErase.clear();
+
   return true;
 }
+
+bool RemoveExceptionalCalls::runOnModule(llvm::Module &M) {
+  RemoveExceptionalCallsStep Step;
+  return ModuleCleanup({ &Step }).run(M);
+}
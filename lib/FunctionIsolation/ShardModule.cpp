@@ -0,0 +1,159 @@
+/// \file ShardModule.cpp
+/// \brief Splits a module with isolated functions in independent shards
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+
+#include "revng/FunctionIsolation/ShardModule.h"
+#include "revng/Support/CommandLine.h"
+#include "revng/Support/Debug.h"
+#include "revng/Support/FunctionTags.h"
+
+using namespace llvm;
+
+static cl::opt<unsigned> ImportThreshold("shard-import-threshold",
+                                         cl::init(100),
+                                         cl::desc("import in each shard the "
+                                                  "non-isolated functions "
+                                                  "with up to this many "
+                                                  "instructions"),
+                                         cl::value_desc("instructions"),
+                                         cl::cat(MainCategory));
+
+using GlobalValueSet = SmallPtrSet<const GlobalValue *, 16>;
+
+/// Give hidden external linkage to all the local symbols of \p M, so that they
+/// can be referenced across shards
+static void externalizeLocals(Module &M) {
+  for (GlobalValue &GV : M.global_values()) {
+    if (not GV.hasLocalLinkage())
+      continue;
+
+    if (not GV.hasName())
+      GV.setName("__revng_shard_local");
+    GV.setLinkage(GlobalValue::ExternalLinkage);
+    GV.setVisibility(GlobalValue::HiddenVisibility);
+  }
+}
+
+/// Collect in \p Result the functions using \p V, possibly through constants
+static void collectUsers(const Value *V, GlobalValueSet &Result) {
+  for (const User *U : V->users()) {
+    if (auto *I = dyn_cast<Instruction>(U))
+      Result.insert(I->getFunction());
+    else if (isa<Constant>(U) and not isa<GlobalValue>(U))
+      collectUsers(U, Result);
+  }
+}
+
+/// \return the functions that have to stay in the first shard, along with the
+///         global variables: those whose basic blocks have their address taken
+///         and those using such addresses
+static GlobalValueSet collectPinned(Module &M) {
+  GlobalValueSet Result;
+  for (Function &F : M) {
+    for (BasicBlock &BB : F) {
+      if (BlockAddress *Address = BlockAddress::lookup(&BB)) {
+        Result.insert(&F);
+        collectUsers(Address, Result);
+      }
+    }
+  }
+  return Result;
+}
+
+void shardModule(Module &M,
+                 unsigned Count,
+                 function_ref<void(std::unique_ptr<Module>)> ShardCallback) {
+  revng_assert(Count > 0);
+
+  externalizeLocals(M);
+
+  // Functions that cannot leave the first shard, as any global not in ShardOf
+  GlobalValueSet Pinned = collectPinned(M);
+  DenseMap<const GlobalValue *, unsigned> ShardOf;
+
+  // Small helpers are available to all the shards for inlining
+  GlobalValueSet Imported;
+  for (Function &F : M) {
+    if (F.isDeclaration() or F.hasComdat() or Pinned.count(&F) != 0)
+      continue;
+
+    if (not FunctionTags::Lifted.isTagOf(&F)
+        and F.getInstructionCount() <= ImportThreshold)
+      Imported.insert(&F);
+  }
+
+  auto IsSharded = [&Pinned, &Imported](Function *F) {
+    return not(F->isDeclaration() or F->hasComdat() or Pinned.count(F) != 0
+               or Imported.count(F) != 0);
+  };
+
+  // Lay out the functions to shard in depth-first order over the call graph
+  std::vector<Function *> Order;
+  SmallPtrSet<Function *, 16> Visited;
+  uint64_t TotalSize = 0;
+  for (Function &F : M) {
+    if (not IsSharded(&F) or not Visited.insert(&F).second)
+      continue;
+
+    std::vector<Function *> Stack{ &F };
+    while (not Stack.empty()) {
+      Function *Current = Stack.back();
+      Stack.pop_back();
+      Order.push_back(Current);
+      TotalSize += Current->getInstructionCount();
+
+      for (Instruction &I : instructions(Current)) {
+        if (auto *Call = dyn_cast<CallBase>(&I)) {
+          Function *Callee = Call->getCalledFunction();
+          if (Callee != nullptr and IsSharded(Callee)
+              and Visited.insert(Callee).second)
+            Stack.push_back(Callee);
+        }
+      }
+    }
+  }
+
+  // Cut the sequence in pieces of similar size
+  unsigned Shard = 0;
+  uint64_t Accumulated = 0;
+  for (Function *F : Order) {
+    ShardOf[F] = Shard;
+    Accumulated += F->getInstructionCount();
+    if (Shard + 1 < Count and Accumulated * Count >= TotalSize * (Shard + 1))
+      ++Shard;
+  }
+
+  for (unsigned Index = 0; Index < Count; ++Index) {
+    auto ShouldCloneDefinition = [&](const GlobalValue *GV) {
+      return ShardOf.lookup(GV) == Index or Imported.count(GV) != 0;
+    };
+
+    ValueToValueMapTy VMap;
+    std::unique_ptr<Module> Result = CloneModule(M,
+                                                 VMap,
+                                                 ShouldCloneDefinition);
+
+    // The definitions of the imported helpers are emitted by the first shard
+    if (Index != 0) {
+      for (const GlobalValue *GV : Imported) {
+        auto *Helper = cast<Function>(&*VMap[GV]);
+        Helper->setLinkage(GlobalValue::AvailableExternallyLinkage);
+      }
+    }
+
+    ShardCallback(std::move(Result));
+  }
+}
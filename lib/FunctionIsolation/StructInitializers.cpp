@@ -19,11 +19,12 @@ StructInitializers::StructInitializers(llvm::Module *M) :
   Pool.setTags({ &FunctionTags::StructInitializer });
 
   // Record existing initializers
-  for (Function &F : FunctionTags::StructInitializer.functions(M)) {
+  Pool.recordExisting([](Function &F) -> std::optional<StructType *> {
     auto *RT = F.getFunctionType()->getReturnType();
     if (auto *Struct = dyn_cast<StructType>(RT))
-      Pool.record(Struct, &F);
-  }
+      return Struct;
+    return std::nullopt;
+  });
 }
 
 Instruction *StructInitializers::createReturn(IRBuilder<> &Builder,
@@ -5,7 +5,11 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <atomic>
+#include <thread>
+
 #include "llvm/ADT/DepthFirstIterator.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/DOTGraphTraits.h"
 #include "llvm/Support/GraphWriter.h"
 #include "llvm/Support/raw_os_ostream.h"
@@ -13,9 +17,59 @@
 #include "revng/ADT/GenericGraph.h"
 #include "revng/Model/Binary.h"
 #include "revng/Model/VerifyHelper.h"
+#include "revng/Support/CommandLine.h"
 
 using namespace llvm;
 
+static cl::opt<unsigned> VerifyThreads("model-verify-threads",
+                                       cl::init(1),
+                                       cl::desc("number of threads verifying "
+                                                "functions and types of the "
+                                                "model"),
+                                       cl::value_desc("threads"),
+                                       cl::cat(MainCategory));
+
+/// \brief Check \p Verify holds for all the elements of \p Container
+///
+/// Elements are verified on up to VerifyThreads threads, each with its own fork
+/// of \p VH. As soon as an element fails, no more elements are verified.
+template<typename T, typename F>
+static bool verifyAll(model::VerifyHelper &VH,
+                      const T &Container,
+                      const F &Verify) {
+  size_t Size = Container.size();
+  size_t Count = std::min<size_t>(VerifyThreads, Size);
+  if (Count <= 1) {
+    for (const auto &Element : Container)
+      if (not Verify(VH, Element))
+        return false;
+    return true;
+  }
+
+  std::atomic<bool> Failed(false);
+  std::atomic<size_t> Next(0);
+  auto Begin = Container.begin();
+  auto Worker = [&](model::VerifyHelper &WorkerVH) {
+    for (size_t I = Next++; I < Size and not Failed; I = Next++)
+      if (not Verify(WorkerVH, *(Begin + I)))
+        Failed = true;
+  };
+
+  std::vector<model::VerifyHelper> Helpers;
+  Helpers.reserve(Count);
+  for (size_t I = 0; I < Count; I++)
+    Helpers.push_back(VH.fork());
+
+  std::vector<std::thread> Threads;
+  for (model::VerifyHelper &WorkerVH : Helpers)
+    Threads.emplace_back(Worker, std::ref(WorkerVH));
+
+  for (std::thread &Thread : Threads)
+    Thread.join();
+
+  return not Failed;
+}
+
 namespace model {
 
 struct FunctionCFGNodeData {
@@ -102,16 +156,17 @@ bool Binary::verifyTypes(bool Assert) const {
 
 bool Binary::verifyTypes(VerifyHelper &VH) const {
   // All types on their own should verify
-  std::set<Identifier> Names;
-  for (auto &Type : Types) {
-    // Verify the type
-    if (not Type.get()->verify(VH))
-      return VH.fail();
+  auto VerifyType = [](VerifyHelper &VH, const auto &Type) {
+    return static_cast<bool>(Type.get()->verify(VH));
+  };
+  if (not verifyAll(VH, Types, VerifyType))
+    return VH.fail();
 
-    // Ensure the names are unique
+  // Ensure the names are unique
+  std::set<Identifier> Names;
+  for (auto &Type : Types)
     if (not Names.insert(Type->name()).second)
       return VH.fail();
-  }
 
   return true;
 }
@@ -126,11 +181,18 @@ bool Binary::verify(bool Assert) const {
 }
 
 bool Binary::verify(VerifyHelper &VH) const {
-  for (const Function &F : Functions) {
-
+  auto VerifyFunction = [this](VerifyHelper &VH, const Function &F) {
     // Verify individual functions
     if (not F.verify(VH))
-      return VH.fail();
+      return false;
+
+    // Check the function this one has been merged with, if any
+    if (F.MergedInto.isValid()) {
+      auto It = Functions.find(F.MergedInto);
+      if (It == Functions.end() or It->MergedInto.isValid()
+          or It->Prototype != F.Prototype)
+        return false;
+    }
 
     // Check function calls
     for (const BasicBlock &Block : F.CFG) {
@@ -143,16 +205,21 @@ bool Binary::verify(VerifyHelper &VH) const {
 
           // If missing, fail
           if (It == Functions.end())
-            return VH.fail();
+            return false;
 
           // If call and callee prototypes differ, fail
           const Function &Callee = *It;
           if (Call->Prototype != Callee.Prototype)
-            return VH.fail();
+            return false;
         }
       }
     }
-  }
+
+    return true;
+  };
+
+  if (not verifyAll(VH, Functions, VerifyFunction))
+    return VH.fail();
 
   //
   // Verify the type system
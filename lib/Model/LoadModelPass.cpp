@@ -10,9 +10,11 @@
 #include "llvm/IR/Metadata.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/MemoryBuffer.h"
 
 // Local libraries includes
 #include "revng/Model/LoadModelPass.h"
+#include "revng/Model/TupleTreeBinary.h"
 
 using namespace llvm;
 
@@ -26,21 +28,48 @@ using RP = RegisterPass<T>;
 static RP<LoadModelWrapperPass>
   X("load-model", "Deserialize the model", true, true);
 
-TupleTree<model::Binary> loadModel(const llvm::Module &M) {
+/// \brief Get the serialized model, from the module itself or from the file it
+///        points to
+static std::unique_ptr<MemoryBuffer> getSerializedModel(const llvm::Module &M) {
   NamedMDNode *NamedMD = M.getNamedMetadata(ModelMetadataName);
   revng_check(NamedMD and NamedMD->getNumOperands());
 
   auto *Tuple = cast<MDTuple>(NamedMD->getOperand(0));
   revng_check(Tuple->getNumOperands());
 
-  Metadata *MD = Tuple->getOperand(0).get();
-  StringRef YAMLString = cast<MDString>(MD)->getString();
+  StringRef Serialized = cast<MDString>(Tuple->getOperand(0))->getString();
+  if (Tuple->getNumOperands() == 2 and Serialized == ModelFileMetadataTag) {
+    StringRef Path = cast<MDString>(Tuple->getOperand(1))->getString();
+    auto MaybeBuffer = MemoryBuffer::getFile(Path);
+    revng_check(MaybeBuffer, "Couldn't read the model file");
+    return std::move(*MaybeBuffer);
+  }
 
-  return std::move(TupleTree<model::Binary>::deserialize(YAMLString).get());
+  return MemoryBuffer::getMemBuffer(Serialized, ModelMetadataName, false);
 }
 
-static TupleTree<model::Binary> extractModel(Module &M) {
-  auto Result = loadModel(M);
+TupleTree<model::Binary> loadModel(const llvm::Module &M) {
+  auto Buffer = getSerializedModel(M);
+  StringRef Serialized = Buffer->getBuffer();
+  if (isBinaryTupleTree(Serialized))
+    return std::move(deserializeBinary<model::Binary>(Serialized).get());
+  else
+    return std::move(TupleTree<model::Binary>::deserialize(Serialized).get());
+}
+
+ModelWrapper loadModelWrapper(const llvm::Module &M) {
+  auto Buffer = getSerializedModel(M);
+  StringRef Serialized = Buffer->getBuffer();
+  if (not isBinaryTupleTree(Serialized))
+    return { std::move(TupleTree<model::Binary>::deserialize(Serialized).get()) };
+
+  ModelWrapper::LazyFunctions Functions;
+  auto MaybeBinary = deserializeBinary(Serialized, Functions);
+  return { std::move(MaybeBinary.get()), std::move(Functions) };
+}
+
+static ModelWrapper extractModel(Module &M) {
+  auto Result = loadModelWrapper(M);
   // Erase the named metadata in order to make sure no one is tempted to
   // deserialize it on its own
   NamedMDNode *NamedMD = M.getNamedMetadata(ModelMetadataName);
@@ -68,9 +97,43 @@ bool LoadModelWrapperPass::doFinalization(Module &M) {
 }
 
 ModelWrapper LoadModelAnalysis::run(Module &M, ModuleAnalysisManager &) {
-  return { loadModel(M) };
+  return loadModelWrapper(M);
 }
 
 ModelWrapper LoadModelAnalysis::run(Function &F, FunctionAnalysisManager &) {
-  return { loadModel(*F.getParent()) };
+  return loadModelWrapper(*F.getParent());
+}
+
+const model::Function *ModelWrapper::getFunction(const MetaAddress &Entry) const {
+  if (FunctionsPending)
+    return Functions->get(Entry);
+
+  auto It = TheBinary->Functions.find(Entry);
+  if (It == TheBinary->Functions.end())
+    return nullptr;
+  return &*It;
+}
+
+std::vector<MetaAddress> ModelWrapper::functionEntries() const {
+  std::vector<MetaAddress> Result;
+  if (FunctionsPending) {
+    Result.reserve(Functions->size());
+    for (const MetaAddress &Entry : Functions->keys())
+      Result.push_back(Entry);
+  } else {
+    Result.reserve(TheBinary->Functions.size());
+    for (const model::Function &Function : TheBinary->Functions)
+      Result.push_back(Function.Entry);
+  }
+
+  return Result;
+}
+
+void ModelWrapper::materializeFunctions() const {
+  if (not FunctionsPending)
+    return;
+
+  // Functions returned by getFunction so far remain valid
+  Functions->materialize(TheBinary->Functions);
+  FunctionsPending = false;
 }
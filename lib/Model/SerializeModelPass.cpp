@@ -7,14 +7,34 @@
 //
 
 // LLVM includes
+#include "llvm/ADT/SmallString.h"
 #include "llvm/IR/Metadata.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
 
 // Local libraries includes
 #include "revng/Model/SerializeModelPass.h"
+#include "revng/Model/TupleTreeBinary.h"
+#include "revng/Support/CommandLine.h"
 
 using namespace llvm;
 
+static cl::opt<bool> BinaryModel("binary-model",
+                                 cl::desc("Serialize the model in the module "
+                                          "using the binary encoding instead "
+                                          "of YAML"),
+                                 cl::cat(MainCategory),
+                                 cl::init(false));
+
+static cl::opt<std::string> ModelOutput("model-output",
+                                        cl::desc("Write the model to this "
+                                                 "file, instead of embedding "
+                                                 "it in the module"),
+                                        cl::value_desc("path"),
+                                        cl::cat(MainCategory));
+
 char SerializeModelWrapperPass::ID;
 
 template<typename T>
@@ -28,14 +48,40 @@ void writeModel(model::Binary &Model, llvm::Module &M) {
   NamedMDNode *NamedMD = M.getNamedMetadata(ModelMetadataName);
   revng_check(not NamedMD, "The model has alread been serialized");
 
-  std::string Buffer;
-  {
-    llvm::raw_string_ostream Stream(Buffer);
-    serialize(Stream, Model);
-  }
+  auto Serialize = [&Model](raw_ostream &Stream) {
+    if (BinaryModel)
+      serializeBinary(Stream, Model);
+    else
+      serialize(Stream, Model);
+  };
 
   LLVMContext &Context = M.getContext();
-  auto Tuple = MDTuple::get(Context, { MDString::get(Context, Buffer) });
+  MDTuple *Tuple = nullptr;
+  if (not ModelOutput.empty()) {
+    // Stream the model to its file, the module only records where it is
+    std::error_code EC;
+    raw_fd_ostream Stream(ModelOutput, EC);
+    revng_check(not EC, "Couldn't open the model output file");
+    Serialize(Stream);
+    Stream.close();
+    revng_check(not Stream.has_error(), "Couldn't write the model");
+
+    // Other tools might run from another directory
+    SmallString<128> Path(ModelOutput);
+    revng_check(not sys::fs::make_absolute(Path));
+
+    Tuple = MDTuple::get(Context,
+                         { MDString::get(Context, ModelFileMetadataTag),
+                           MDString::get(Context, Path) });
+  } else {
+    std::string Buffer;
+    {
+      llvm::raw_string_ostream Stream(Buffer);
+      Serialize(Stream);
+    }
+
+    Tuple = MDTuple::get(Context, { MDString::get(Context, Buffer) });
+  }
 
   NamedMD = M.getOrInsertNamedMetadata(ModelMetadataName);
   NamedMD->addOperand(Tuple);
@@ -4,12 +4,15 @@
 
 #include <bit>
 #include <cstddef>
+#include <mutex>
 #include <random>
 #include <string>
 #include <type_traits>
 
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallSet.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/Allocator.h"
 #include "llvm/Support/MathExtras.h"
 
 #include "revng/Model/Binary.h"
@@ -23,6 +26,32 @@ namespace model {
 
 const Identifier Identifier::Empty = Identifier("");
 
+namespace {
+
+/// \brief The strings of all the Identifiers
+class IdentifierPool {
+private:
+  std::mutex Mutex;
+  llvm::StringSet<llvm::BumpPtrAllocator> Strings;
+
+public:
+  const Identifier::Entry *intern(llvm::StringRef Name) {
+    std::lock_guard Lock(Mutex);
+    return &*Strings.insert(Name).first;
+  }
+};
+
+} // namespace
+
+const Identifier::Entry *Identifier::intern(llvm::StringRef Name) {
+  if (Name.empty())
+    return nullptr;
+
+  // Never destroyed: Identifiers might outlive any other static object
+  static IdentifierPool *Pool = new IdentifierPool;
+  return Pool->intern(Name);
+}
+
 const std::set<llvm::StringRef> ReservedKeywords = {
   // reserved keywords for primitive types
   "void"
@@ -185,32 +214,26 @@ model::Type::Type(TypeKind::Values TK) :
 
 Identifier model::UnionField::name() const {
   using llvm::Twine;
-  Identifier Result;
   if (CustomName.empty())
-    (Twine("unnamed_field_") + Twine(Index)).toVector(Result);
+    return Identifier(Twine("unnamed_field_") + Twine(Index));
   else
-    Result = CustomName;
-  return Result;
+    return CustomName;
 }
 
 Identifier model::StructField::name() const {
   using llvm::Twine;
-  Identifier Result;
   if (CustomName.empty())
-    (Twine("unnamed_field_at_offset_") + Twine(Offset)).toVector(Result);
+    return Identifier(Twine("unnamed_field_at_offset_") + Twine(Offset));
   else
-    Result = CustomName;
-  return Result;
+    return CustomName;
 }
 
 Identifier model::Argument::name() const {
   using llvm::Twine;
-  Identifier Result;
   if (CustomName.empty())
-    (Twine("unnamed_arg_") + Twine(Index)).toVector(Result);
+    return Identifier(Twine("unnamed_arg_") + Twine(Index));
   else
-    Result = CustomName;
-  return Result;
+    return CustomName;
 }
 
 Identifier model::Type::name() const {
@@ -274,42 +297,32 @@ isValidPrimitiveSize(PrimitiveTypeKind::Values PrimKind, uint8_t BS) {
 Identifier model::PrimitiveType::name() const {
   using llvm::Twine;
   revng_assert(isValidPrimitiveSize(PrimitiveKind, Size));
-  Identifier Result;
 
   switch (PrimitiveKind) {
   case PrimitiveTypeKind::Void:
-    Result = "void";
-    break;
+    return Identifier("void");
 
   case PrimitiveTypeKind::Unsigned:
-    (Twine("uint") + Twine(Size * 8) + Twine("_t")).toVector(Result);
-    break;
+    return Identifier(Twine("uint") + Twine(Size * 8) + Twine("_t"));
 
   case PrimitiveTypeKind::Number:
-    (Twine("number") + Twine(Size * 8) + Twine("_t")).toVector(Result);
-    break;
+    return Identifier(Twine("number") + Twine(Size * 8) + Twine("_t"));
 
   case PrimitiveTypeKind::PointerOrNumber:
-    ("pointer_or_number" + Twine(Size * 8) + "_t").toVector(Result);
-    break;
+    return Identifier("pointer_or_number" + Twine(Size * 8) + "_t");
 
   case PrimitiveTypeKind::Generic:
-    (Twine("generic") + Twine(Size * 8) + Twine("_t")).toVector(Result);
-    break;
+    return Identifier(Twine("generic") + Twine(Size * 8) + Twine("_t"));
 
   case PrimitiveTypeKind::Signed:
-    (Twine("int") + Twine(Size * 8) + Twine("_t")).toVector(Result);
-    break;
+    return Identifier(Twine("int") + Twine(Size * 8) + Twine("_t"));
 
   case PrimitiveTypeKind::Float:
-    (Twine("float") + Twine(Size * 8) + Twine("_t")).toVector(Result);
-    break;
+    return Identifier(Twine("float") + Twine(Size * 8) + Twine("_t"));
 
   default:
     revng_abort();
   }
-
-  return Result;
 }
 
 template<typename T>
@@ -318,7 +331,7 @@ Identifier customNameOrAutomatic(T *This) {
   if (not This->CustomName.empty())
     return This->CustomName;
   else
-    return Identifier((Twine(T::AutomaticNamePrefix) + Twine(This->ID)).str());
+    return Identifier(Twine(T::AutomaticNamePrefix) + Twine(This->ID));
 }
 
 Identifier model::StructType::name() const {
@@ -600,10 +613,12 @@ bool Identifier::verify(VerifyHelper &VH) const {
     return llvm::all_of(llvm::make_filter_range(Range, IsNotUnderscore),
                         isalnum);
   };
-  return VH.maybeFail(not(not empty() and std::isdigit((*this)[0]))
-                      and not startswith("_") and AllAlphaNumOrUnderscore(*this)
-                      and not beginsWithReservedPrefix(*this)
-                      and not ReservedKeywords.count(llvm::StringRef(*this)));
+  llvm::StringRef Name = str();
+  return VH.maybeFail(not(not Name.empty() and std::isdigit(Name[0]))
+                      and not Name.startswith("_")
+                      and AllAlphaNumOrUnderscore(Name)
+                      and not beginsWithReservedPrefix(Name)
+                      and not ReservedKeywords.count(Name));
 }
 
 static RecursiveCoroutine<bool>
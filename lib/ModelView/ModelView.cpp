@@ -0,0 +1,296 @@
+/// \file ModelView.cpp
+/// \brief Implementation of the C API inspecting binary-encoded models in
+///        place.
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <memory>
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/LEB128.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include "revng/Model/Binary.h"
+#include "revng/Model/TupleTreeBinary.h"
+#include "revng/ModelView/ModelView.h"
+
+using namespace llvm;
+
+template<typename T>
+static constexpr int field(typename TupleLikeTraits<T>::Fields Field) {
+  return static_cast<int>(Field);
+}
+
+using BinaryFields = TupleLikeTraits<model::Binary>::Fields;
+using FunctionFields = TupleLikeTraits<model::Function>::Fields;
+using BlockFields = TupleLikeTraits<model::BasicBlock>::Fields;
+using EdgeFields = TupleLikeTraits<model::CallEdge>::Fields;
+using TypeFields = TupleLikeTraits<model::Type>::Fields;
+
+static_assert(REVNG_MODEL_BINARY_FUNCTIONS
+              == field<model::Binary>(BinaryFields::Functions));
+static_assert(REVNG_MODEL_BINARY_TYPES
+              == field<model::Binary>(BinaryFields::Types));
+static_assert(REVNG_MODEL_BINARY_PARTIAL_LIFTING
+              == field<model::Binary>(BinaryFields::PartialLifting));
+static_assert(REVNG_MODEL_BINARY_ANALYSIS_FINGERPRINT
+              == field<model::Binary>(BinaryFields::AnalysisFingerprint));
+static_assert(REVNG_MODEL_FUNCTION_ENTRY
+              == field<model::Function>(FunctionFields::Entry));
+static_assert(REVNG_MODEL_FUNCTION_CUSTOM_NAME
+              == field<model::Function>(FunctionFields::CustomName));
+static_assert(REVNG_MODEL_FUNCTION_TYPE
+              == field<model::Function>(FunctionFields::Type));
+static_assert(REVNG_MODEL_FUNCTION_CFG
+              == field<model::Function>(FunctionFields::CFG));
+static_assert(REVNG_MODEL_FUNCTION_PROTOTYPE
+              == field<model::Function>(FunctionFields::Prototype));
+static_assert(REVNG_MODEL_FUNCTION_MERGED_INTO
+              == field<model::Function>(FunctionFields::MergedInto));
+static_assert(REVNG_MODEL_BASIC_BLOCK_START
+              == field<model::BasicBlock>(BlockFields::Start));
+static_assert(REVNG_MODEL_BASIC_BLOCK_END
+              == field<model::BasicBlock>(BlockFields::End));
+static_assert(REVNG_MODEL_BASIC_BLOCK_CUSTOM_NAME
+              == field<model::BasicBlock>(BlockFields::CustomName));
+static_assert(REVNG_MODEL_BASIC_BLOCK_SUCCESSORS
+              == field<model::BasicBlock>(BlockFields::Successors));
+static_assert(REVNG_MODEL_FUNCTION_EDGE_DESTINATION
+              == field<model::CallEdge>(EdgeFields::Destination));
+static_assert(REVNG_MODEL_FUNCTION_EDGE_TYPE
+              == field<model::CallEdge>(EdgeFields::Type));
+static_assert(REVNG_MODEL_CALL_EDGE_PROTOTYPE
+              == field<model::CallEdge>(EdgeFields::Prototype));
+static_assert(REVNG_MODEL_TYPE_KIND == field<model::Type>(TypeFields::Kind));
+static_assert(REVNG_MODEL_TYPE_ID == field<model::Type>(TypeFields::ID));
+
+namespace {
+
+/// \brief Decoder of the values of a node
+class Cursor {
+private:
+  StringRef Buffer;
+  uint64_t Offset;
+  uint64_t End;
+  bool Failed = false;
+
+public:
+  Cursor(StringRef Buffer, revng_model_node Node) :
+    Buffer(Buffer), Offset(Node.Offset), End(Node.Offset + Node.Size) {
+    Failed = Node.Offset > Buffer.size()
+             or Node.Size > Buffer.size() - Node.Offset;
+  }
+
+public:
+  bool failed() const { return Failed; }
+  bool atEnd() const { return Failed or Offset == End; }
+
+  uint64_t readULEB() {
+    if (Failed)
+      return 0;
+
+    unsigned Size = 0;
+    const char *Error = nullptr;
+    uint64_t Result = decodeULEB128(current(), &Size, end(), &Error);
+    Failed = Error != nullptr;
+    Offset += Size;
+    return Result;
+  }
+
+  int64_t readSLEB() {
+    if (Failed)
+      return 0;
+
+    unsigned Size = 0;
+    const char *Error = nullptr;
+    int64_t Result = decodeSLEB128(current(), &Size, end(), &Error);
+    Failed = Error != nullptr;
+    Offset += Size;
+    return Result;
+  }
+
+  /// \brief Read a value prefixed by its ULEB128 size
+  revng_model_node readSized() {
+    uint64_t Size = readULEB();
+    if (Failed or Size > End - Offset) {
+      Failed = true;
+      return { 0, 0 };
+    }
+
+    revng_model_node Result = { Offset, Size };
+    Offset += Size;
+    return Result;
+  }
+
+  /// \brief The rest of the node
+  revng_model_node rest() const { return { Offset, End - Offset }; }
+
+private:
+  const uint8_t *current() const {
+    return reinterpret_cast<const uint8_t *>(Buffer.data()) + Offset;
+  }
+
+  const uint8_t *end() const {
+    return reinterpret_cast<const uint8_t *>(Buffer.data()) + End;
+  }
+};
+
+struct ContainerElement {
+  revng_model_node Key;
+  revng_model_node Value;
+};
+
+} // namespace
+
+struct revng_model {
+  std::unique_ptr<MemoryBuffer> File;
+  std::vector<StringRef> Strings;
+  revng_model_node Root;
+
+  /// Elements of the KeyedObjectContainers indexed so far, by offset
+  DenseMap<uint64_t, std::vector<ContainerElement>> Containers;
+
+  StringRef buffer() const { return File->getBuffer(); }
+
+  const std::vector<ContainerElement> *elements(revng_model_node Node) {
+    auto It = Containers.find(Node.Offset);
+    if (It != Containers.end())
+      return &It->second;
+
+    Cursor Reader(buffer(), Node);
+    uint64_t Count = Reader.readULEB();
+    std::vector<ContainerElement> Elements;
+
+    // Each element takes at least two bytes
+    Elements.reserve(std::min<uint64_t>(Count, Node.Size / 2));
+    for (uint64_t I = 0; I < Count and not Reader.failed(); ++I) {
+      revng_model_node Key = Reader.readSized();
+      revng_model_node Value = Reader.readSized();
+      Elements.push_back({ Key, Value });
+    }
+
+    if (Reader.failed())
+      return nullptr;
+
+    return &(Containers[Node.Offset] = std::move(Elements));
+  }
+};
+
+revng_model *revng_model_open(const char *Path) {
+  // Large files are memory-mapped
+  auto MaybeFile = MemoryBuffer::getFile(Path, -1, false);
+  if (not MaybeFile)
+    return nullptr;
+
+  auto Result = std::make_unique<revng_model>();
+  Result->File = std::move(*MaybeFile);
+  StringRef Buffer = Result->buffer();
+  if (not isBinaryTupleTree(Buffer))
+    return nullptr;
+
+  // Record where the strings are, the root follows them
+  uint64_t Magic = TupleTreeBinaryMagic.size();
+  Cursor Reader(Buffer, { Magic, Buffer.size() - Magic });
+  uint64_t StringsCount = Reader.readULEB();
+  for (uint64_t I = 0; I < StringsCount and not Reader.failed(); ++I) {
+    revng_model_node String = Reader.readSized();
+    Result->Strings.push_back(Buffer.substr(String.Offset, String.Size));
+  }
+
+  if (Reader.failed())
+    return nullptr;
+
+  Result->Root = Reader.rest();
+  return Result.release();
+}
+
+void revng_model_close(revng_model *Model) {
+  delete Model;
+}
+
+revng_model_node revng_model_root(const revng_model *Model) {
+  return Model->Root;
+}
+
+bool revng_model_field(revng_model *Model,
+                       revng_model_node Node,
+                       uint64_t Index,
+                       revng_model_node *Result) {
+  Cursor Reader(Model->buffer(), Node);
+  uint64_t FieldsCount = Reader.readULEB();
+  for (uint64_t I = 0; I < FieldsCount and not Reader.failed(); ++I) {
+    uint64_t FieldIndex = Reader.readULEB();
+    revng_model_node Field = Reader.readSized();
+    if (FieldIndex == Index and not Reader.failed()) {
+      *Result = Field;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+uint64_t revng_model_count(revng_model *Model, revng_model_node Node) {
+  Cursor Reader(Model->buffer(), Node);
+  uint64_t Result = Reader.readULEB();
+  return Reader.failed() ? 0 : Result;
+}
+
+bool revng_model_element(revng_model *Model,
+                         revng_model_node Node,
+                         uint64_t Index,
+                         revng_model_node *Key,
+                         revng_model_node *Value) {
+  const std::vector<ContainerElement> *Elements = Model->elements(Node);
+  if (Elements == nullptr or Index >= Elements->size())
+    return false;
+
+  const ContainerElement &Element = (*Elements)[Index];
+  if (Key != nullptr)
+    *Key = Element.Key;
+  *Value = Element.Value;
+  return true;
+}
+
+bool revng_model_upcast(revng_model *Model,
+                        revng_model_node Node,
+                        uint64_t *ConcreteType,
+                        revng_model_node *Value) {
+  Cursor Reader(Model->buffer(), Node);
+  *ConcreteType = Reader.readULEB();
+  *Value = Reader.rest();
+  return not Reader.failed();
+}
+
+bool revng_model_unsigned(revng_model *Model,
+                          revng_model_node Node,
+                          uint64_t *Result) {
+  Cursor Reader(Model->buffer(), Node);
+  *Result = Reader.readULEB();
+  return Reader.atEnd() and not Reader.failed();
+}
+
+bool revng_model_signed(revng_model *Model,
+                        revng_model_node Node,
+                        int64_t *Result) {
+  Cursor Reader(Model->buffer(), Node);
+  *Result = Reader.readSLEB();
+  return Reader.atEnd() and not Reader.failed();
+}
+
+bool revng_model_scalar(revng_model *Model,
+                        revng_model_node Node,
+                        revng_model_string *Result) {
+  Cursor Reader(Model->buffer(), Node);
+  uint64_t Index = Reader.readULEB();
+  if (Reader.failed() or not Reader.atEnd() or Index >= Model->Strings.size())
+    return false;
+
+  StringRef String = Model->Strings[Index];
+  *Result = { String.data(), String.size() };
+  return true;
+}
@@ -68,7 +68,15 @@ static Register X("detect-abi", "ABI Detection Pass", true, true);
 bool ABIDetectionPass::runOnModule(Module &M) {
   auto &GCBI = getAnalysis<GeneratedCodeBasicInfoWrapperPass>().getGCBI();
   auto &SA = getAnalysis<StackAnalysis>();
-  SA.serializeMetadata(*M.getFunction("root"), GCBI);
+
+  // If the model is up to date, so is the metadata: the IR is the one that
+  // has been fingerprinted after its serialization
+  if (not SA.upToDate()) {
+    SA.serializeMetadata(*M.getFunction("root"), GCBI);
+
+    auto &LMP = getAnalysis<LoadModelWrapperPass>().get();
+    StackAnalysis::recordFingerprint(M, *LMP.getWriteableModel());
+  }
 
   if (FBDPOutputPath.getNumOccurrences() == 1) {
     std::ofstream Output;
@@ -4,6 +4,8 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <memory>
+#include <set>
 #include <stack>
 
 #include "llvm/ADT/SmallVector.h"
@@ -37,32 +39,41 @@ private:
 
   /// Result of the ABI analysis for the callee
   ///
-  /// \note FunctionABI can be quite large, create an instance only if needed.
-  std::unique_ptr<FunctionABI> ABI;
+  /// \note FunctionABI can be quite large, it's shared with the summary of the
+  ///       callee in the cache.
+  std::shared_ptr<const FunctionABI> ABI;
 
   /// Set of caller stack slots written by the callee
-  std::set<int32_t> WrittenStackSlots;
+  ///
+  /// \note The sets are interned by the analysis of the caller, which outlives
+  ///       its ABI IR.
+  const std::set<int32_t> *WrittenStackSlots;
 
 private:
   ABIIRInstruction(Opcode O,
                    FunctionCall Call,
-                   FunctionABI ABI,
-                   std::set<int32_t> WrittenStackSlots) :
+                   std::shared_ptr<const FunctionABI> ABI,
+                   const std::set<int32_t> &WrittenStackSlots) :
     O(O),
     Target(ASSlot::invalid()),
     Call(Call),
-    ABI(new FunctionABI(std::move(ABI))),
-    WrittenStackSlots(std::move(WrittenStackSlots)) {
+    ABI(std::move(ABI)),
+    WrittenStackSlots(&WrittenStackSlots) {
     revng_assert(O == DirectCall);
+    revng_assert(this->ABI);
   }
 
   ABIIRInstruction(Opcode O, ASSlot Target) :
-    O(O), Target(Target), ABI(), WrittenStackSlots() {
+    O(O), Target(Target), ABI(), WrittenStackSlots(nullptr) {
     revng_assert(O == Load || O == Store);
   }
 
   ABIIRInstruction(Opcode O, FunctionCall Call) :
-    O(O), Target(ASSlot::invalid()), Call(Call), ABI(), WrittenStackSlots() {
+    O(O),
+    Target(ASSlot::invalid()),
+    Call(Call),
+    ABI(),
+    WrittenStackSlots(nullptr) {
     revng_assert(O == IndirectCall);
   }
 
@@ -77,12 +88,12 @@ public:
 
   static ABIIRInstruction
   createDirectCall(FunctionCall Call,
-                   FunctionABI ABI,
-                   std::set<int32_t> WrittenStackSlots) {
+                   std::shared_ptr<const FunctionABI> ABI,
+                   const std::set<int32_t> &WrittenStackSlots) {
     return ABIIRInstruction(DirectCall,
                             Call,
                             std::move(ABI),
-                            std::move(WrittenStackSlots));
+                            WrittenStackSlots);
   }
 
   static ABIIRInstruction createIndirectCall(FunctionCall Call) {
@@ -108,7 +119,7 @@ public:
 
   const std::set<int32_t> &stackArguments() const {
     revng_assert(O == DirectCall);
-    return WrittenStackSlots;
+    return *WrittenStackSlots;
   }
 
   FunctionCall call() const {
@@ -6,6 +6,7 @@
 
 #include <limits>
 
+#include "llvm/ADT/DenseMapInfo.h"
 #include "llvm/IR/GlobalVariable.h"
 #include "llvm/IR/Module.h"
 
@@ -116,6 +117,8 @@ public:
 
 /// \brief Class representing the address of an address space slot
 class ASSlot {
+  friend struct llvm::DenseMapInfo<ASSlot>;
+
 private:
   ASID AS;
   int32_t Offset;
@@ -139,16 +142,24 @@ public:
 
   size_t hash() const;
 
+  /// \brief Encode this slot in a single integer
+  ///
+  /// The address space goes in the upper half and the offset, with the sign
+  /// bit flipped, in the lower half: comparing the encodings is the same as
+  /// comparing the (address space, offset) pairs.
+  uint64_t packed() const {
+    uint32_t BiasedOffset = static_cast<uint32_t>(Offset) ^ (1U << 31);
+    return (static_cast<uint64_t>(AS.id()) << 32) | BiasedOffset;
+  }
+
   bool operator==(const ASSlot &Other) const {
-    return std::tie(AS, Offset) == std::tie(Other.AS, Other.Offset);
+    return packed() == Other.packed();
   }
 
   bool operator!=(const ASSlot &Other) const { return not(*this == Other); }
 
   bool operator<(const ASSlot &Other) const {
-    auto ThisTuple = std::make_pair(AS.id(), Offset);
-    auto OtherTuple = std::make_pair(Other.AS.id(), Other.Offset);
-    return ThisTuple < OtherTuple;
+    return packed() < Other.packed();
   }
 
   int32_t offset() const { return Offset; }
@@ -223,6 +234,36 @@ private:
 
 } // namespace StackAnalysis
 
+namespace llvm {
+
+/// \brief Allow ASSlots in DenseMap/DenseSet
+///
+/// The empty and tombstone keys are in the invalid address space, at offsets
+/// different from the one of ASSlot::invalid().
+template<>
+struct DenseMapInfo<StackAnalysis::ASSlot> {
+  using ASSlot = StackAnalysis::ASSlot;
+  using ASID = StackAnalysis::ASID;
+
+  static ASSlot getEmptyKey() {
+    return ASSlot(ASID::invalidID(), std::numeric_limits<int32_t>::max());
+  }
+
+  static ASSlot getTombstoneKey() {
+    return ASSlot(ASID::invalidID(), std::numeric_limits<int32_t>::min());
+  }
+
+  static unsigned getHashValue(const ASSlot &Slot) {
+    return DenseMapInfo<uint64_t>::getHashValue(Slot.packed());
+  }
+
+  static bool isEqual(const ASSlot &LHS, const ASSlot &RHS) {
+    return LHS.packed() == RHS.packed();
+  }
+};
+
+} // namespace llvm
+
 namespace std {
 
 template<>
@@ -301,38 +301,56 @@ void Cache::identifyLinkRegisters(const Module *M) {
   }
 }
 
+void Cache::assignFunctionIndices(Function *F) {
+  // Any basic block might be the entry of a function
+  FunctionIndices.clear();
+  FunctionIndices.reserve(F->size());
+  uint32_t Index = 0;
+  for (BasicBlock &BB : *F)
+    FunctionIndices[&BB] = Index++;
+
+  Results.clear();
+  Results.resize(FunctionIndices.size());
+  Versions.assign(FunctionIndices.size(), 0);
+  Coherence.clear();
+  Coherence.resize(FunctionIndices.size());
+  FakeFunctions.clear();
+  FakeFunctions.resize(FunctionIndices.size());
+  NoReturnFunctions.clear();
+  NoReturnFunctions.resize(FunctionIndices.size());
+}
+
 void Cache::assignCPUIndices(Function *F, GeneratedCodeBasicInfo *GCBI) {
   // Enumerate CPU state and allocas
   CSVToIndexMap.clear();
   IndexToCSVMap.clear();
 
   // Skip 0, keep it as "invalid value"
-  int32_t I = 1;
+  IndexToCSVMap.push_back(nullptr);
 
-  IndexToCSVMap[I++] = GCBI->pcReg();
+  IndexToCSVMap.push_back(GCBI->pcReg());
 
   // Go through global variables first
   for (llvm::GlobalVariable *GV : GCBI->abiRegisters())
-    IndexToCSVMap[I++] = GV;
+    IndexToCSVMap.push_back(GV);
 
-  CSVCount = I;
+  CSVCount = IndexToCSVMap.size();
 
   // Look for AllocaInst at the beginning of the root function
   llvm::BasicBlock *Entry = &*F->begin();
   auto It = Entry->begin();
   while (It != Entry->end() and isa<AllocaInst>(&*It)) {
-    IndexToCSVMap[I] = &*It;
-
-    I++;
+    IndexToCSVMap.push_back(&*It);
     It++;
   }
 
-  for (auto &P : IndexToCSVMap)
-    CSVToIndexMap[P.second] = P.first;
+  for (int32_t I = 1; I < static_cast<int32_t>(IndexToCSVMap.size()); I++)
+    CSVToIndexMap[IndexToCSVMap[I]] = I;
 }
 
 Cache::Cache(Function *F, GeneratedCodeBasicInfo *GCBI) :
   DefaultLinkRegister(nullptr) {
+  assignFunctionIndices(F);
   assignCPUIndices(F, GCBI);
   identifyPartialStores(F);
   identifyIdentityLoads(F);
@@ -356,9 +374,9 @@ Cache::Cache(Function *F, GeneratedCodeBasicInfo *GCBI) :
 
 Optional<const IntraproceduralFunctionSummary *>
 Cache::get(BasicBlock *Function) const {
-  auto It = Results.find(Function);
-  if (It != Results.end())
-    return { &It->second };
+  const auto &Entry = Results[functionIndex(Function)];
+  if (Entry)
+    return { Entry.get() };
 
   return Optional<const IntraproceduralFunctionSummary *>();
 }
@@ -372,27 +390,30 @@ bool Cache::update(BasicBlock *Function,
     SaLog << DoLog;
   }
 
-  auto It = Results.find(Function);
-  if (It == Results.end()) {
-    Results.emplace(std::make_pair(Function, Result.copy()));
+  uint32_t Index = functionIndex(Function);
+  Versions[Index]++;
+
+  auto &Entry = Results[Index];
+  if (not Entry) {
+    Entry.reset(new IntraproceduralFunctionSummary(Result.copy()));
     return false;
-  } else {
-    auto &Summary = It->second;
+  }
 
-    Intraprocedural::Element &Old = Summary.FinalState;
-    const Intraprocedural::Element &New = Result.FinalState;
+  IntraproceduralFunctionSummary &Summary = *Entry;
 
-    // We should never put in the cache something more precise than what we had
-    // before or the analysis might not terminate.  In any case, we will perform
-    // the analysis only once most of the times. The main exception are
-    // recursive function calls which will temporarily inject in the cache a
-    // temporary top entry, which will be overwritten later on.
-    revng_assert(New.lowerThanOrEqual(Old));
+  Intraprocedural::Element &Old = Summary.FinalState;
+  const Intraprocedural::Element &New = Result.FinalState;
 
-    It->second = Result.copy();
+  // We should never put in the cache something more precise than what we had
+  // before or the analysis might not terminate.  In any case, we will perform
+  // the analysis only once most of the times. The main exception are
+  // recursive function calls which will temporarily inject in the cache a
+  // temporary top entry, which will be overwritten later on.
+  revng_assert(New.lowerThanOrEqual(Old));
 
-    return not Old.lowerThanOrEqual(New);
-  }
+  Summary = Result.copy();
+
+  return not Old.lowerThanOrEqual(New);
 }
 
 } // namespace StackAnalysis
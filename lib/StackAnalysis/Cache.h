@@ -4,6 +4,15 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+
 #include "Element.h"
 #include "IntraproceduralFunctionSummary.h"
 
@@ -11,34 +20,92 @@ class GeneratedCodeBasicInfo;
 
 namespace StackAnalysis {
 
+/// \brief What the caller says about a register at a function call
+struct CallerRegisterState {
+  int32_t Offset;
+  FunctionCallRegisterArgument::Values Argument;
+  FunctionCallReturnValue::Values ReturnValue;
+
+  bool operator==(const CallerRegisterState &) const = default;
+};
+
+/// \brief Outcome of the last coherence check of a function call
+///
+/// The check only depends on the summary of the callee and on what the caller
+/// says about the registers at the call site: as long as neither of them
+/// changes, the verdict still holds and the check can be skipped.
+struct CallCoherence {
+  /// Version of the callee summary, see Cache::version
+  uint32_t CalleeVersion = 0;
+  llvm::Optional<int32_t> FrameSize;
+  std::vector<CallerRegisterState> CallerRegisters;
+  bool Coherent = true;
+
+  bool isUpToDate(const CallCoherence &Other) const {
+    return CalleeVersion == Other.CalleeVersion
+           and FrameSize == Other.FrameSize
+           and CallerRegisters == Other.CallerRegisters;
+  }
+};
+
 /// \brief Cache for the result of the analysis of a function
 ///
 /// This cache keeps track of three pieces of information:
 ///
 /// * the result of the analysis of a function.
-/// * the set of "fake", "noreturn" and "indirect tail call" functions.
+/// * the set of "fake" and "noreturn" functions.
 /// * the association between each function and its return register.
+///
+/// Each basic block of the root function gets a dense index up front, and all
+/// the per-function information is stored in vectors and bit vectors indexed
+/// by it.
+///
+/// The cache can be shared among multiple threads analyzing independent sets
+/// of functions: each entry of Results is only ever accessed by the thread
+/// analyzing the corresponding function (the same holds for Versions and
+/// Coherence), while the bit vectors, which share
+/// words among functions, are protected by a lock.
 class Cache {
 private:
+  /// \brief Lock protecting FakeFunctions and NoReturnFunctions
+  mutable std::mutex Lock;
+
+  /// \brief Dense index of each basic block of the root function
+  llvm::DenseMap<const llvm::BasicBlock *, uint32_t> FunctionIndices;
+
   /// \brief For each function, the result of the intraprocedural analysis
-  std::map<llvm::BasicBlock *, IntraproceduralFunctionSummary> Results;
+  std::vector<std::unique_ptr<IntraproceduralFunctionSummary>> Results;
+
+  /// \brief For each function, how many times its entry in Results has been
+  ///        updated
+  std::vector<uint32_t> Versions;
+
+  /// \brief For each function, the last coherence check of its function calls
+  ///
+  /// This is bookkeeping of the analysis, not a result: it's mutable so that
+  /// the intraprocedural analysis can update it through a const Cache.
+  mutable std::vector<std::unique_ptr<std::map<FunctionCall, CallCoherence>>>
+    Coherence;
 
   /// \brief For each function, its link register (or nullptr for top of the
   ///        stack)
-  std::map<llvm::BasicBlock *, llvm::GlobalVariable *> LinkRegisters;
+  ///
+  /// If empty, all the functions use DefaultLinkRegister.
+  std::vector<llvm::Optional<llvm::GlobalVariable *>> LinkRegisters;
 
   /// \brief The elected default link register (i.e., the most common)
   llvm::GlobalVariable *DefaultLinkRegister;
 
-  std::set<llvm::BasicBlock *> FakeFunctions;
-  std::set<llvm::BasicBlock *> NoReturnFunctions;
-  std::set<llvm::BasicBlock *> IndirectTailCallFunctions;
+  llvm::BitVector FakeFunctions;
+  llvm::BitVector NoReturnFunctions;
+
+  llvm::DenseSet<const llvm::LoadInst *> IdentityLoads;
+  llvm::DenseSet<const llvm::StoreInst *> IdentityStores;
 
-  std::set<const llvm::LoadInst *> IdentityLoads;
-  std::set<const llvm::StoreInst *> IdentityStores;
+  llvm::DenseMap<const llvm::User *, int32_t> CSVToIndexMap;
 
-  std::map<const llvm::User *, int32_t> CSVToIndexMap;
-  std::map<int32_t, llvm::User *> IndexToCSVMap;
+  /// \brief The CPU state variable associated to each index (0 is invalid)
+  std::vector<llvm::User *> IndexToCSVMap;
   int32_t CSVCount;
 
 public:
@@ -53,24 +120,30 @@ public:
   llvm::GlobalVariable *getCSVByIndex(int32_t I) const {
     return llvm::cast<llvm::GlobalVariable>(IndexToCSVMap.at(I));
   }
-  bool isCSVIndex(int32_t I) const {
-    return IndexToCSVMap.count(I) != 0 and I < CSVCount;
-  }
+  bool isCSVIndex(int32_t I) const { return I > 0 and I < CSVCount; }
 
   bool isFakeFunction(llvm::BasicBlock *Function) const {
-    return FakeFunctions.count(Function) != 0;
+    uint32_t Index = functionIndex(Function);
+    std::lock_guard<std::mutex> Guard(Lock);
+    return FakeFunctions[Index];
   }
 
   void markAsFake(llvm::BasicBlock *Function) {
-    FakeFunctions.insert(Function);
+    uint32_t Index = functionIndex(Function);
+    std::lock_guard<std::mutex> Guard(Lock);
+    FakeFunctions.set(Index);
   }
 
   bool isNoReturnFunction(llvm::BasicBlock *Function) const {
-    return NoReturnFunctions.count(Function) != 0;
+    uint32_t Index = functionIndex(Function);
+    std::lock_guard<std::mutex> Guard(Lock);
+    return NoReturnFunctions[Index];
   }
 
   void markAsNoReturn(llvm::BasicBlock *Function) {
-    NoReturnFunctions.insert(Function);
+    uint32_t Index = functionIndex(Function);
+    std::lock_guard<std::mutex> Guard(Lock);
+    NoReturnFunctions.set(Index);
   }
 
   /// \brief Query the cache for the result of the analysis for a specific
@@ -85,6 +158,26 @@ public:
   bool update(llvm::BasicBlock *Function,
               const IntraproceduralFunctionSummary &Result);
 
+  /// \brief Version of the entry for \p Function, 0 if there's none
+  ///
+  /// The version changes every time the entry is updated.
+  uint32_t version(llvm::BasicBlock *Function) const {
+    return Versions[functionIndex(Function)];
+  }
+
+  /// \brief The last coherence check of the function call \p Call performed
+  ///        by \p Caller
+  ///
+  /// This is preserved across re-analyses of \p Caller, even if it has been
+  /// found incoherent and never made it into the cache.
+  CallCoherence &
+  callCoherence(llvm::BasicBlock *Caller, FunctionCall Call) const {
+    auto &Entry = Coherence[functionIndex(Caller)];
+    if (not Entry)
+      Entry = std::make_unique<std::map<FunctionCall, CallCoherence>>();
+    return (*Entry)[Call];
+  }
+
   /// \brief Get the link register for the function identified by \p Function
   ///
   /// \return a pointer to the CSV representing the link register for
@@ -97,11 +190,11 @@ public:
     if (LinkRegisters.size() == 0) {
       return DefaultLinkRegister;
     } else {
-      auto It = LinkRegisters.find(Function);
-      if (It == LinkRegisters.end())
+      const auto &LinkRegister = LinkRegisters[functionIndex(Function)];
+      if (not LinkRegister)
         return DefaultLinkRegister;
       else
-        return It->second;
+        return *LinkRegister;
     }
   }
 
@@ -119,6 +212,13 @@ public:
   }
 
 private:
+  uint32_t functionIndex(const llvm::BasicBlock *Function) const {
+    auto It = FunctionIndices.find(Function);
+    revng_assert(It != FunctionIndices.end());
+    return It->second;
+  }
+
+  void assignFunctionIndices(llvm::Function *F);
   void assignCPUIndices(llvm::Function *F, GeneratedCodeBasicInfo *GCBI);
   void identifyPartialStores(const llvm::Function *F);
   void identifyIdentityLoads(const llvm::Function *F);
@@ -0,0 +1,90 @@
+/// \file CostReport.cpp
+/// \brief Per-function report of the cost of the stack analysis
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <array>
+#include <fstream>
+#include <map>
+#include <set>
+
+#include "llvm/ADT/StringRef.h"
+
+#include "revng/Support/CommandLine.h"
+
+#include "CostReport.h"
+
+namespace StackAnalysis {
+
+namespace CostReport {
+
+Counter AnalysisTime("FunctionAnalysisTime");
+Counter AnalysisCount("FunctionAnalysisCount");
+Counter Iterations("FunctionIterations");
+Counter RecursionRestarts("FunctionRecursionRestarts");
+Counter PeakElementSize("FunctionPeakElementSize");
+Counter ABIAnalysisTime("FunctionABIAnalysisTime");
+Counter CacheHits("FunctionCacheHits");
+Counter CacheMisses("FunctionCacheMisses");
+
+void write(const std::string &Path) {
+  using Column = std::pair<const char *, Counter *>;
+  std::array<Column, 8> Columns = { { { "time_ns", &AnalysisTime },
+                                      { "analyses", &AnalysisCount },
+                                      { "iterations", &Iterations },
+                                      { "recursion_restarts",
+                                        &RecursionRestarts },
+                                      { "peak_element_size",
+                                        &PeakElementSize },
+                                      { "abi_time_ns", &ABIAnalysisTime },
+                                      { "cache_hits", &CacheHits },
+                                      { "cache_misses", &CacheMisses } } };
+
+  // Take a snapshot of all the counters and collect all the functions
+  std::array<std::map<std::string, uint64_t>, Columns.size()> Values;
+  std::set<std::string> Functions;
+  for (unsigned I = 0; I < Columns.size(); I++) {
+    Values[I] = Columns[I].second->snapshot();
+    for (auto &P : Values[I])
+      Functions.insert(P.first);
+  }
+
+  auto Get = [&Values](unsigned I, const std::string &Function) -> uint64_t {
+    auto It = Values[I].find(Function);
+    return It == Values[I].end() ? 0 : It->second;
+  };
+
+  std::ofstream File;
+  std::ostream &Output = pathToStream(Path, File);
+
+  if (llvm::StringRef(Path).endswith(".csv")) {
+    Output << "function";
+    for (const Column &C : Columns)
+      Output << "," << C.first;
+    Output << "\n";
+
+    for (const std::string &Function : Functions) {
+      Output << Function;
+      for (unsigned I = 0; I < Columns.size(); I++)
+        Output << "," << Get(I, Function);
+      Output << "\n";
+    }
+  } else {
+    Output << "[";
+    const char *Delimiter = "\n";
+    for (const std::string &Function : Functions) {
+      Output << Delimiter << "  { \"function\": \"" << Function << "\"";
+      for (unsigned I = 0; I < Columns.size(); I++)
+        Output << ", \"" << Columns[I].first << "\": " << Get(I, Function);
+      Output << " }";
+      Delimiter = ",\n";
+    }
+    Output << "\n]\n";
+  }
+}
+
+} // namespace CostReport
+
+} // namespace StackAnalysis
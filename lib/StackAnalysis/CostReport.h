@@ -0,0 +1,55 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <string>
+
+#include "revng/Support/Statistics.h"
+
+namespace StackAnalysis {
+
+/// \brief Per-function counters about the cost of the stack analysis
+///
+/// All the counters are indexed by the name of the entry basic block of the
+/// function.
+namespace CostReport {
+
+using Counter = CounterMap<std::string, uint64_t>;
+
+/// \brief Time spent in the analysis of the function, in nanoseconds
+extern Counter AnalysisTime;
+
+/// \brief Number of times an analysis of the function has been started
+extern Counter AnalysisCount;
+
+/// \brief Number of applications of the intraprocedural transfer function
+extern Counter Iterations;
+
+/// \brief Number of restarts due to a change in the summary of the function
+///        itself, i.e., due to recursion
+extern Counter RecursionRestarts;
+
+/// \brief Largest number of slots tracked at the beginning of a basic block
+extern Counter PeakElementSize;
+
+/// \brief Time spent in the ABI analyses, in nanoseconds
+extern Counter ABIAnalysisTime;
+
+/// \brief Cache hits at the call sites of the function
+extern Counter CacheHits;
+
+/// \brief Cache misses at the call sites of the function
+extern Counter CacheMisses;
+
+/// \brief Write all the counters to \p Path, one entry per function
+///
+/// The report is in CSV format if \p Path ends with ".csv", in JSON format
+/// otherwise.
+void write(const std::string &Path);
+
+} // namespace CostReport
+
+} // namespace StackAnalysis
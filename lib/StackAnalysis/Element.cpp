@@ -5,6 +5,9 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/STLExtras.h"
+
 #include "revng/Support/Debug.h"
 
 #include "Element.h"
@@ -49,7 +52,7 @@ unsigned ASSlot::cmp(const ASSlot &Other, const Module *M) const {
 }
 
 size_t ASSlot::hash() const {
-  return combineHash(std::hash<ASID>()(AS), std::hash<int32_t>()(Offset));
+  return std::hash<uint64_t>()(packed());
 }
 
 namespace Intraprocedural {
@@ -114,33 +117,36 @@ unsigned AddressSpace::cmp(const AddressSpace &Other, const Module *M) const {
   LoggerIndent<> Y(SaDiffLog);
   unsigned Result = 0;
 
-  for (auto &P : ASOContent) {
-    auto It = Other.ASOContent.find(P.first);
+  // Both sides are sorted by offset: walk them in parallel
+  auto ThisIt = ASOContent.begin();
+  auto ThisEnd = ASOContent.end();
+  for (auto &P : Other.ASOContent) {
+    while (ThisIt != ThisEnd and ThisIt->first < P.first)
+      ++ThisIt;
 
-    // Check if Other has it
-    if (It != Other.ASOContent.end()) {
-      // Check the actual value
-      ROA((P.second.cmp<Diff, EarlyExit>(It->second, M)), {
+    if (ThisIt != ThisEnd and ThisIt->first == P.first) {
+      // Both have it, check the actual value
+      ROA((ThisIt->second.cmp<Diff, EarlyExit>(P.second, M)), {
         slot(P.first).dump(M, SaDiffLog);
         SaDiffLog << DoLog;
       });
+    } else {
+      // TODO: assert this matters in the PruneLog
+      ROA(P.second.hasDirectContent(), {
+        slot(P.first).dump(M, SaDiffLog);
+        SaDiffLog << " is absent in the LHS and has direct content on the";
+        revng_log(SaDiffLog, " RHS");
+      });
     }
   }
 
-  for (auto &P : Other.ASOContent) {
-    auto It = ASOContent.find(P.first);
-    // TODO: assert this matters in the PruneLog
-    ROA(It == ASOContent.end() && P.second.hasDirectContent(), {
-      slot(P.first).dump(M, SaDiffLog);
-      SaDiffLog << " is absent in the LHS and has direct content on the";
-      revng_log(SaDiffLog, " RHS");
-    });
-  }
-
   return Result;
 }
 
 size_t AddressSpace::hash() const {
+  if (CachedHash)
+    return *CachedHash;
+
   size_t Result = 0;
 
   for (auto &P : ASOContent) {
@@ -148,6 +154,7 @@ size_t AddressSpace::hash() const {
     Result = combineHash(Result, std::hash<Value>()(P.second));
   }
 
+  CachedHash = Result;
   return Result;
 }
 
@@ -156,7 +163,7 @@ std::set<ASSlot> Element::collectSlots(int32_t CSVCount) const {
   std::set<ASSlot> SlotsPool;
 
   if (State.size() > CPU.id())
-    for (auto &P : State[CPU.id()].ASOContent)
+    for (auto &P : State[CPU.id()]->ASOContent)
       if (P.first < CSVCount)
         SlotsPool.insert(ASSlot::create(CPU, P.first));
 
@@ -185,7 +192,13 @@ unsigned Element::cmp(const Element &Other, const Module *M) const {
 
   size_t TotalASCount = State.size();
   for (unsigned I = 0; I < TotalASCount; I++) {
-    ROA((State[I].cmp<Diff, EarlyExit>(Other.State[I], M)), {
+    // Equal address spaces are lower than or equal to each other: skip the
+    // slot by slot comparison if they are shared or their contents match,
+    // which the cached hashes rule out in most of the other cases
+    if (State[I] == Other.State[I])
+      continue;
+
+    ROA((State[I]->cmp<Diff, EarlyExit>(Other.State[I], M)), {
       ASID(I).dump(SaDiffLog);
       SaDiffLog << DoLog;
     });
@@ -210,14 +223,29 @@ Element &Element::combine(const Element &Other) {
   }
 
   revng_assert(State.size() == Other.State.size());
-  for (unsigned I = 0; I < State.size(); I++)
-    mergeASState(State[I], Other.State[I]);
+  for (unsigned I = 0; I < State.size(); I++) {
+    // Combining an address space with itself leaves it unchanged
+    if (not State[I].sharesWith(Other.State[I]))
+      mergeASState(State[I].mutate(), Other.State[I]);
+  }
 
   return *this;
 }
 
 void Element::cleanup() {
-  for (AddressSpace &AS : State) {
+  for (CopyOnWrite<AddressSpace> &SharedAS : State) {
+    const AddressSpace &Current = SharedAS;
+    auto IsInitialValue = [&Current](const std::pair<int32_t, Value> &P) {
+      const ASSlot *TheTag = P.second.tag();
+      return TheTag != nullptr and *TheTag == Current.slot(P.first);
+    };
+
+    // Don't unshare address spaces with nothing to clean up
+    if (llvm::none_of(Current.ASOContent, IsInitialValue))
+      continue;
+
+    AddressSpace &AS = SharedAS.mutate();
+    AS.invalidateHash();
     for (auto It = AS.ASOContent.begin(); It != AS.ASOContent.end(); /**/) {
       if (const ASSlot *TheTag = It->second.tag()) {
         if (*TheTag == ASSlot::create(AS.ID, It->first)) {
@@ -246,8 +274,8 @@ std::set<ASSlot> Element::computeCalleeSavedSlots() const {
   uint32_t CPUID = ASID::cpuID().id();
   uint32_t StackID = ASID::stackID().id();
   if (State.size() > StackID and State.size() > CPUID) {
-    std::set<ASSlot> StackLeftovers;
-    for (auto &P : State[StackID].ASOContent) {
+    llvm::SmallDenseSet<ASSlot, 16> StackLeftovers;
+    for (auto &P : State[StackID]->ASOContent) {
       // Do we have direct content with a name?
       if (const ASSlot *T = P.second.tag()) {
         // Is the tag referreing to a CSV?
@@ -256,7 +284,7 @@ std::set<ASSlot> Element::computeCalleeSavedSlots() const {
       }
     }
 
-    for (auto &P : State[CPUID].ASOContent) {
+    for (auto &P : State[CPUID]->ASOContent) {
       // Do we have direct content with a name?
       if (const ASSlot *T = P.second.tag()) {
         // Is the name the same as the current slot?
@@ -270,12 +298,32 @@ std::set<ASSlot> Element::computeCalleeSavedSlots() const {
   return Result;
 }
 
+unsigned Element::intern(AddressSpacePool &Pool) {
+  unsigned Result = 0;
+
+  for (CopyOnWrite<AddressSpace> &SharedAS : State) {
+    size_t Hash = SharedAS->hash();
+    auto [Begin, End] = Pool.equal_range(Hash);
+    auto IsEqual = [&SharedAS](const auto &P) { return P.second == SharedAS; };
+    auto It = std::find_if(Begin, End, IsEqual);
+
+    if (It == End) {
+      // The storage is not shared yet: drop the unused capacity, if we own it
+      if (not SharedAS.isShared())
+        SharedAS.mutate().ASOContent.shrinkToFit();
+      Pool.emplace(Hash, SharedAS);
+    } else if (not It->second.sharesWith(SharedAS)) {
+      SharedAS = It->second;
+      Result++;
+    }
+  }
+
+  return Result;
+}
+
 void Element::mergeASState(AddressSpace &ThisState,
                            const AddressSpace &OtherState) {
-  // The following implementation can be easily replaced by any other
-  // implementation using a data structure allowing to iterate over a sorted
-  // pair of <ASO, *> pairs. In particular, instead of a std::map we could use
-  // a sorted std::vector of pairs.
+  ThisState.invalidateHash();
 
   // Iterate in parallel
   auto ThisIt = ThisState.ASOContent.begin();
@@ -294,8 +342,9 @@ void Element::mergeASState(AddressSpace &ThisState,
     if (ThisDone || (!OtherDone && ThisIt->first > OtherIt->first)) {
       // Only Other has the current offset: create a new default entry for
       // delayed appending in this and merge it with OtherContent
+      // This doesn't have the offset, no need to look it up
       auto ASO = ASSlot::create(ThisState.id(), OtherIt->first);
-      NewEntries.emplace_back(OtherIt->first, ThisState.load(ASO));
+      NewEntries.emplace_back(OtherIt->first, Value::fromTag(ASO));
 
       ThisContent = &NewEntries.back().second;
       OtherContent = &OtherIt->second;
@@ -305,7 +354,7 @@ void Element::mergeASState(AddressSpace &ThisState,
       // Only this has the current offset: create a default OtherContent and
       // merge with ThisContent
       auto ASO = ASSlot::create(OtherState.id(), ThisIt->first);
-      TmpContent = OtherState.load(ASO);
+      TmpContent = Value::fromTag(ASO);
 
       ThisContent = &ThisIt->second;
       OtherContent = &TmpContent;
@@ -330,8 +379,8 @@ void Element::mergeASState(AddressSpace &ThisState,
     OtherDone = OtherIt == OtherEndIt;
   }
 
-  for (std::pair<int32_t, Value> &P : NewEntries)
-    ThisState.ASOContent[P.first] = P.second;
+  // NewEntries has been populated in order of offset, merge it in one go
+  ThisState.ASOContent.insertSorted(NewEntries);
 }
 
 } // namespace Intraprocedural
@@ -4,8 +4,15 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
 #include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include "llvm/ADT/Optional.h"
+
+#include "revng/ADT/CopyOnWrite.h"
 #include "revng/ADT/LazySmallBitVector.h"
 #include "revng/Support/Statistics.h"
 
@@ -135,6 +142,88 @@ public:
   }
 };
 
+/// \brief Map from offsets to Values, stored as a vector sorted by offset
+///
+/// Address spaces are copied and merged much more often than new offsets are
+/// added to them. Keeping their content in a single contiguous allocation makes
+/// copies cheap and lets merges walk both sides linearly, as opposed to
+/// allocating and visiting a tree node for each slot.
+class OffsetValueMap {
+public:
+  using value_type = std::pair<int32_t, Value>;
+
+private:
+  using Vector = std::vector<value_type>;
+
+public:
+  using iterator = Vector::iterator;
+  using const_iterator = Vector::const_iterator;
+
+private:
+  Vector Entries;
+
+public:
+  iterator begin() { return Entries.begin(); }
+  iterator end() { return Entries.end(); }
+  const_iterator begin() const { return Entries.begin(); }
+  const_iterator end() const { return Entries.end(); }
+
+  size_t size() const { return Entries.size(); }
+
+  bool operator==(const OffsetValueMap &Other) const {
+    return Entries == Other.Entries;
+  }
+
+  iterator find(int32_t Offset) {
+    auto It = lowerBound(Offset);
+    return (It != end() and It->first == Offset) ? It : end();
+  }
+
+  const_iterator find(int32_t Offset) const {
+    auto It = lowerBound(Offset);
+    return (It != end() and It->first == Offset) ? It : end();
+  }
+
+  size_t count(int32_t Offset) const { return find(Offset) != end() ? 1 : 0; }
+
+  Value &operator[](int32_t Offset) {
+    auto It = lowerBound(Offset);
+    if (It == end() or It->first != Offset)
+      It = Entries.emplace(It, Offset, Value::empty());
+    return It->second;
+  }
+
+  iterator erase(iterator It) { return Entries.erase(It); }
+
+  /// \brief Release the memory reserved for entries that haven't been added
+  void shrinkToFit() { Entries.shrink_to_fit(); }
+
+  /// \brief Add all of \p NewEntries, which must be sorted by offset and
+  ///        must not be present in this map, in a single pass
+  void insertSorted(const Vector &NewEntries) {
+    if (NewEntries.empty())
+      return;
+
+    auto Middle = Entries.insert(end(), NewEntries.begin(), NewEntries.end());
+    std::inplace_merge(begin(), Middle, end(), compareOffsets);
+  }
+
+private:
+  static bool compareOffsets(const value_type &A, const value_type &B) {
+    return A.first < B.first;
+  }
+
+  iterator lowerBound(int32_t Offset) {
+    value_type Key(Offset, Value::empty());
+    return std::lower_bound(begin(), end(), Key, compareOffsets);
+  }
+
+  const_iterator lowerBound(int32_t Offset) const {
+    value_type Key(Offset, Value::empty());
+    return std::lower_bound(begin(), end(), Key, compareOffsets);
+  }
+};
+
 /// \brief Class representing the content of an address space
 ///
 /// An address space is composed by a set of <Offset, Value> pairs recording
@@ -143,13 +232,15 @@ class AddressSpace {
   friend class Element;
 
 public:
-  using Container = std::map<int32_t, Value>;
+  using Container = OffsetValueMap;
 
 private:
   /// Address space identifier
   ASID ID;
   /// Map associating an offset within the address space with a Value
   Container ASOContent;
+  /// Cached result of hash(), reset each time ASOContent changes
+  mutable llvm::Optional<size_t> CachedHash;
 
 public:
   AddressSpace(ASID ID) : ID(ID) {}
@@ -164,10 +255,14 @@ public:
   using ASOContentIt = Container::iterator;
   ASOContentIt eraseASO(ASOContentIt It) {
     revng_assert(!It->second.hasDirectContent());
+    invalidateHash();
     return ASOContent.erase(It);
   }
 
   bool operator==(const AddressSpace &Other) const {
+    // Different hashes prove the contents differ without visiting them
+    if (hash() != Other.hash())
+      return false;
     return ASOContent == Other.ASOContent;
   }
 
@@ -183,7 +278,10 @@ public:
 
   bool contains(int32_t Offset) const { return ASOContent.count(Offset) != 0; }
 
-  void set(int32_t Offset, Value V) { ASOContent[Offset] = V; }
+  void set(int32_t Offset, Value V) {
+    invalidateHash();
+    ASOContent[Offset] = V;
+  }
 
   ASID id() const { return ID; }
   ASSlot slot(int32_t Offset) const { return ASSlot::create(ID, Offset); }
@@ -227,6 +325,8 @@ public:
   }
 
 private:
+  void invalidateHash() { CachedHash.reset(); }
+
   const Value *get(int32_t Offset) const {
     auto It = ASOContent.find(Offset);
     if (It == ASOContent.end())
@@ -240,9 +340,17 @@ private:
 ///
 /// This class basically keeps the state of all the address spaces being
 /// considered in the current analysis.
+///
+/// Address spaces are shared among copies of an Element until they are
+/// modified: most of the time a basic block only affects the CPU address space,
+/// and the stack can be shared with the predecessor.
 class Element {
 public:
-  using Container = llvm::SmallVector<AddressSpace, 2>;
+  using Container = llvm::SmallVector<CopyOnWrite<AddressSpace>, 2>;
+
+  /// \brief Address spaces indexed by their hash, see intern
+  using AddressSpacePool = std::unordered_multimap<size_t,
+                                                   CopyOnWrite<AddressSpace>>;
 
 private:
   // The following vector is indexed with ASID
@@ -263,7 +371,7 @@ public:
     unsigned Count = ASID::stackID().id() + 1;
     Result.State.reserve(Count);
     for (unsigned I = 0; I < Count; I++)
-      Result.State.emplace_back(ASID(I));
+      Result.State.emplace_back(AddressSpace(ASID(I)));
 
     return Result;
   }
@@ -275,7 +383,8 @@ public:
   Element &operator=(Element &&Other) = default;
 
   /// \note Copy constructor has been deleted, so that we don't accidentally
-  ///       call it. Use this method instead.
+  ///       call it. Use this method instead. The address spaces are not
+  ///       actually copied until one of the two Elements modifies them.
   Element copy() const {
     Element Result;
     Result.State = State;
@@ -308,14 +417,32 @@ public:
 
   bool isBottom() const { return State.size() == 0; }
 
+  /// \brief Return the number of slots tracked in all the address spaces
+  size_t size() const {
+    size_t Result = 0;
+    for (const CopyOnWrite<AddressSpace> &AS : State)
+      Result += AS->size();
+    return Result;
+  }
+
   /// \brief Combine this lattice element with \p Other
   Element &combine(const Element &Other);
 
   /// \brief Remove all the slots that say that they contain their initial value
   void cleanup();
 
+  /// \brief Share the storage of the address spaces equal to one in \p Pool,
+  ///        add the others to it
+  ///
+  /// Equal address spaces computed independently, e.g., along two paths, are
+  /// not shared. This makes the Elements of an analysis take less memory while
+  /// they're not used, without changing their content.
+  ///
+  /// \return the number of address spaces that now share their storage.
+  unsigned intern(AddressSpacePool &Pool);
+
   bool addressSpaceContainsTag(ASID AddressSpace, const ASSlot *TheTag) const {
-    for (auto &P : State[AddressSpace.id()].ASOContent)
+    for (auto &P : State[AddressSpace.id()]->ASOContent)
       if (P.second.hasTag() && *P.second.tag() == *TheTag)
         return true;
 
@@ -328,7 +455,7 @@ public:
   std::set<int32_t> stackArguments(int32_t CallerStackSize) const {
     std::set<int32_t> Result;
     if (State.size() > 0)
-      for (auto &P : State[ASID::stackID().id()].ASOContent)
+      for (auto &P : State[ASID::stackID().id()]->ASOContent)
         if (P.first >= 0)
           Result.insert(P.first - CallerStackSize);
 
@@ -350,7 +477,7 @@ public:
     // Does target have a direct component?
     if (const ASSlot *AddressASO = Address.directContent()) {
       ASID TargetASID = AddressASO->addressSpace();
-      State[TargetASID.id()].set(AddressASO->offset(), StoredValue);
+      State[TargetASID.id()].mutate().set(AddressASO->offset(), StoredValue);
     }
   }
 
@@ -358,7 +485,7 @@ public:
   Value load(const Value &TargetAddress) const {
     // Does target have a direct component?
     if (const ASSlot *ASO = TargetAddress.directContent())
-      return State[ASO->addressSpace().id()].load(*ASO);
+      return State[ASO->addressSpace().id()]->load(*ASO);
 
     return Value::empty();
   }
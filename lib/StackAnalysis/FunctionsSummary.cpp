@@ -8,10 +8,13 @@
 
 #include "boost/icl/interval_set.hpp"
 
+#include "llvm/ADT/DenseMap.h"
+
 #include "revng/StackAnalysis/FunctionsSummary.h"
 #include "revng/Support/IRHelpers.h"
 
 #include "ASSlot.h"
+#include "FunctionsSummaryBuilder.h"
 
 using llvm::BasicBlock;
 using llvm::BlockAddress;
@@ -205,17 +208,14 @@ void FunctionCallReturnValue::combine(const FunctionReturnValue &Other) {
   }
 }
 
-template<typename T, typename F>
-static auto sort(const T &Range, const F &getKey) {
-  using pointer = decltype(&*Range.begin());
-  std::vector<pointer> Sorted;
-
-  for (auto &E : Range) {
-    Sorted.push_back(&E);
-  }
+/// \brief Collect the register slots in \p Range sorted by the name of the CSV
+template<typename T>
+static auto sortByCSVName(const T &Range) {
+  using Slot = typename T::iterator::value_type;
+  std::vector<Slot> Sorted(Range.begin(), Range.end());
 
-  auto Comparator = [&getKey](pointer &LHS, pointer &RHS) {
-    return getKey(LHS) < getKey(RHS);
+  auto Comparator = [](const Slot &LHS, const Slot &RHS) {
+    return LHS.first->getName() < RHS.first->getName();
   };
 
   std::sort(Sorted.begin(), Sorted.end(), Comparator);
@@ -223,13 +223,6 @@ static auto sort(const T &Range, const F &getKey) {
   return Sorted;
 }
 
-template<typename T>
-static auto sortByCSVName(const T &Range) {
-  using pointer = decltype(&*Range.begin());
-  auto SortKey = [](pointer P) { return P->first->getName(); };
-  return sort(Range, SortKey);
-}
-
 void FunctionsSummary::dumpInternal(const Module *M,
                                     StreamWrapperBase &&Stream) const {
   std::stringstream Output;
@@ -252,10 +245,10 @@ void FunctionsSummary::dumpInternal(const Module *M,
   }
 
   // Sort the functions by name, for extra determinism!
-  using Pair = std::pair<BasicBlock *, const FunctionDescription *>;
+  using Pair = std::pair<BasicBlock *, FunctionDescription>;
   std::vector<Pair> SortedFunctions;
-  for (auto &P : Functions)
-    SortedFunctions.push_back({ P.first, &P.second });
+  for (const Pair &P : functions())
+    SortedFunctions.push_back(P);
   auto Compare = [](const Pair &A, const Pair &B) {
     return getName(A.first) < getName(B.first);
   };
@@ -266,7 +259,7 @@ void FunctionsSummary::dumpInternal(const Module *M,
   for (auto &P : SortedFunctions) {
     Output << FunctionDelimiter << "\n  {\n";
     BasicBlock *Entry = P.first;
-    const FunctionDescription &Function = *P.second;
+    const FunctionDescription &Function = P.second;
 
     Output << "    \"entry_point\": \"";
     if (Entry != nullptr)
@@ -301,7 +294,9 @@ void FunctionsSummary::dumpInternal(const Module *M,
     }
     Output << "],\n";
 
-    Output << "    \"type\": \"" << getName(Function.Type) << "\",\n";
+    Output << "    \"type\": \"" << getName(Function.type()) << "\",\n";
+    if (Function.degraded())
+      Output << "    \"degraded\": true,\n";
 
     interval_set FunctionCoverage;
 
@@ -309,18 +304,15 @@ void FunctionsSummary::dumpInternal(const Module *M,
     Output << "    \"basic_blocks\": [";
 
     // Sort basic blocks by name
-    using Pair = std::pair<BasicBlock *const, BranchType::Values>;
-    std::vector<const Pair *> SortedBasicBlocks;
-    for (const Pair &P : Function.BasicBlocks)
-      SortedBasicBlocks.push_back(&*Function.BasicBlocks.find(P.first));
-    auto Compare = [](const Pair *P, const Pair *Q) {
-      return P->first->getName() < Q->first->getName();
+    using Pair = std::pair<BasicBlock *, BranchType::Values>;
+    auto BasicBlocks = Function.basicBlocks();
+    std::vector<Pair> SortedBasicBlocks(BasicBlocks.begin(), BasicBlocks.end());
+    auto Compare = [](const Pair &P, const Pair &Q) {
+      return P.first->getName() < Q.first->getName();
     };
     std::sort(SortedBasicBlocks.begin(), SortedBasicBlocks.end(), Compare);
 
-    for (const Pair *P : SortedBasicBlocks) {
-      BasicBlock *BB = P->first;
-      BranchType::Values Type = P->second;
+    for (const auto &[BB, Type] : SortedBasicBlocks) {
       const char *TypeName = BranchType::getName(Type);
       Output << BasicBlockDelimiter;
       Output << "{\"name\": \"" << getName(BB) << "\", ";
@@ -346,8 +338,7 @@ void FunctionsSummary::dumpInternal(const Module *M,
 
     Output << "    \"slots\": [";
     const char *SlotDelimiter = "";
-    for (auto *P : sortByCSVName(Function.RegisterSlots)) {
-      auto &[CSV, RD] = *P;
+    for (const auto &[CSV, RD] : sortByCSVName(Function.registerSlots())) {
       Output << SlotDelimiter;
       Output << "{\"slot\": \"" << CSV->getName().data() << "\", ";
 
@@ -363,7 +354,7 @@ void FunctionsSummary::dumpInternal(const Module *M,
 
     Output << "    \"clobbered\": [";
     const char *ClobberedDelimiter = "";
-    for (const GlobalVariable *CSV : Function.ClobberedRegisters) {
+    for (const GlobalVariable *CSV : Function.clobberedRegisters()) {
       Output << ClobberedDelimiter;
       Output << "\"" << CSV->getName().data() << "\"";
       ClobberedDelimiter = ", ";
@@ -385,19 +376,18 @@ void FunctionsSummary::dumpInternal(const Module *M,
 
     const char *FunctionCallDelimiter = "";
     Output << "    \"function_calls\": [";
-    for (const CallSiteDescription &CallSite : Function.CallSites) {
+    for (const CallSiteDescription &CallSite : Function.callSites()) {
       Output << FunctionCallDelimiter << "\n";
       Output << "      {\n";
       Output << "        \"caller\": ";
-      Output << "\"" << getName(CallSite.Call) << "\",\n";
+      Output << "\"" << getName(CallSite.call()) << "\",\n";
       Output << "        \"callee\": ";
-      Output << "\"" << getName(CallSite.Callee) << "\",\n";
+      Output << "\"" << getName(CallSite.callee()) << "\",\n";
       // TODO: caller address
       // TODO: callee address
       Output << "        \"slots\": [";
       const char *FunctionCallSlotsDelimiter = "";
-      for (auto *P : sortByCSVName(CallSite.RegisterSlots)) {
-        auto &[CSV, RD] = *P;
+      for (const auto &[CSV, RD] : sortByCSVName(CallSite.registerSlots())) {
         Output << FunctionCallSlotsDelimiter;
         Output << "{\"slot\": \"" << CSV->getName().data() << "\", ";
 
@@ -430,15 +420,38 @@ void FunctionsSummary::dumpInternal(const Module *M,
 using CSD = FunctionsSummary::CallSiteDescription;
 GlobalVariable *
 CSD::isCompatibleWith(const FunctionDescription &Function) const {
-  std::set<GlobalVariable *> Slots;
-  for (auto &P : RegisterSlots)
-    Slots.insert(P.first);
-  for (auto &P : Function.RegisterSlots)
-    Slots.insert(P.first);
-
-  for (GlobalVariable *CSV : Slots) {
-    FunctionCallRegisterDescription FCRD = getOrDefault(RegisterSlots, CSV);
-    FunctionRegisterDescription FRD = getOrDefault(Function.RegisterSlots, CSV);
+  // Both the ranges are sorted by CSV, walk them in parallel. A missing slot
+  // has the default description.
+  auto CallSiteSlots = registerSlots();
+  auto FunctionSlots = Function.registerSlots();
+  auto CallSiteIt = CallSiteSlots.begin();
+  auto FunctionIt = FunctionSlots.begin();
+  std::less<GlobalVariable *> Less;
+  while (CallSiteIt != CallSiteSlots.end()
+         or FunctionIt != FunctionSlots.end()) {
+    GlobalVariable *CSV = nullptr;
+    FunctionCallRegisterDescription FCRD;
+    FunctionRegisterDescription FRD;
+
+    bool TakeCallSite = (FunctionIt == FunctionSlots.end()
+                         or (CallSiteIt != CallSiteSlots.end()
+                             and not Less((*FunctionIt).first,
+                                          (*CallSiteIt).first)));
+    bool TakeFunction = (CallSiteIt == CallSiteSlots.end()
+                         or (FunctionIt != FunctionSlots.end()
+                             and not Less((*CallSiteIt).first,
+                                          (*FunctionIt).first)));
+
+    if (TakeCallSite) {
+      std::tie(CSV, FCRD) = *CallSiteIt;
+      ++CallSiteIt;
+    }
+
+    if (TakeFunction) {
+      std::tie(CSV, FRD) = *FunctionIt;
+      ++FunctionIt;
+    }
+
     if (not FCRD.isCompatibleWith(FRD))
       return CSV;
   }
@@ -446,4 +459,82 @@ CSD::isCompatibleWith(const FunctionDescription &Function) const {
   return nullptr;
 }
 
+FunctionsSummary FunctionsSummaryBuilder::finalize() {
+  FunctionsSummary Result;
+  Result.Functions.clear();
+  Result.CallSites.clear();
+
+  // Assign a dense index to all the CSVs, preserving their order
+  std::set<GlobalVariable *> AllCSVs;
+  for (auto &[Entry, Function] : Functions) {
+    for (auto &P : Function.RegisterSlots)
+      AllCSVs.insert(P.first);
+    for (GlobalVariable *CSV : Function.ClobberedRegisters)
+      AllCSVs.insert(CSV);
+    for (CallSiteDescription &CallSite : Function.CallSites)
+      for (auto &P : CallSite.RegisterSlots)
+        AllCSVs.insert(P.first);
+  }
+
+  Result.CSVs.assign(AllCSVs.begin(), AllCSVs.end());
+  llvm::DenseMap<GlobalVariable *, uint32_t> CSVIndices;
+  for (uint32_t Index = 0; Index < Result.CSVs.size(); ++Index)
+    CSVIndices[Result.CSVs[Index]] = Index;
+
+  // Lay out the data of each function in the flat vectors
+  Result.Functions.reserve(Functions.size() + 1);
+  for (auto &[Entry, Function] : Functions) {
+    FunctionsSummary::FunctionRecord Record;
+    Record.Entry = Entry;
+    Record.Type = Function.Type;
+    Record.Degraded = Function.Degraded;
+    Record.BasicBlocksStart = Result.BasicBlocks.size();
+    Record.RegisterSlotsStart = Result.FunctionSlots.size();
+    Record.CallSitesStart = Result.CallSites.size();
+    Record.ClobberedRegistersStart = Result.ClobberedRegisters.size();
+    Record.FakeReturnsStart = Result.FakeReturns.size();
+    Result.Functions.push_back(Record);
+
+    for (auto &P : Function.BasicBlocks)
+      Result.BasicBlocks.push_back(P);
+
+    for (auto &[CSV, Description] : Function.RegisterSlots)
+      Result.FunctionSlots.push_back({ CSVIndices[CSV], Description });
+
+    for (CallSiteDescription &CallSite : Function.CallSites) {
+      FunctionsSummary::CallSiteRecord CallSiteRecord;
+      CallSiteRecord.Call = CallSite.Call;
+      CallSiteRecord.Callee = CallSite.Callee;
+      CallSiteRecord.RegisterSlotsStart = Result.CallSiteSlots.size();
+      Result.CallSites.push_back(CallSiteRecord);
+
+      for (auto &[CSV, Description] : CallSite.RegisterSlots)
+        Result.CallSiteSlots.push_back({ CSVIndices[CSV], Description });
+    }
+
+    for (GlobalVariable *CSV : Function.ClobberedRegisters)
+      Result.ClobberedRegisters.push_back(CSVIndices[CSV]);
+
+    for (auto &P : Function.FakeReturns)
+      Result.FakeReturns.push_back(P);
+  }
+
+  // Add the sentinels marking the end of the last slices
+  FunctionsSummary::FunctionRecord Sentinel;
+  Sentinel.BasicBlocksStart = Result.BasicBlocks.size();
+  Sentinel.RegisterSlotsStart = Result.FunctionSlots.size();
+  Sentinel.CallSitesStart = Result.CallSites.size();
+  Sentinel.ClobberedRegistersStart = Result.ClobberedRegisters.size();
+  Sentinel.FakeReturnsStart = Result.FakeReturns.size();
+  Result.Functions.push_back(Sentinel);
+
+  FunctionsSummary::CallSiteRecord CallSiteSentinel;
+  CallSiteSentinel.RegisterSlotsStart = Result.CallSiteSlots.size();
+  Result.CallSites.push_back(CallSiteSentinel);
+
+  Functions.clear();
+
+  return Result;
+}
+
 } // namespace StackAnalysis
@@ -0,0 +1,54 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <deque>
+#include <map>
+#include <set>
+
+#include "revng/StackAnalysis/FunctionsSummary.h"
+
+namespace StackAnalysis {
+
+/// \brief Map-based, mutable counterpart of FunctionsSummary
+///
+/// The results about functions and call sites can be populated in any order,
+/// once they are complete the compact FunctionsSummary can be produced.
+class FunctionsSummaryBuilder {
+public:
+  using FRD = FunctionsSummary::FunctionRegisterDescription;
+  using FCRD = FunctionsSummary::FunctionCallRegisterDescription;
+
+  struct CallSiteDescription {
+    CallSiteDescription(llvm::Instruction *Call, llvm::Value *Callee) :
+      Call(Call), Callee(Callee) {}
+
+    llvm::Instruction *Call;
+    llvm::Value *Callee;
+    std::map<llvm::GlobalVariable *, FCRD> RegisterSlots;
+  };
+
+  struct FunctionDescription {
+    FunctionType::Values Type = FunctionType::Invalid;
+    bool Degraded = false;
+    std::map<llvm::BasicBlock *, BranchType::Values> BasicBlocks;
+    std::map<llvm::GlobalVariable *, FRD> RegisterSlots;
+    std::deque<CallSiteDescription> CallSites;
+    std::set<llvm::GlobalVariable *> ClobberedRegisters;
+    std::multimap<llvm::BasicBlock *, MetaAddress> FakeReturns;
+  };
+
+public:
+  /// \brief Map from function entry points to its description
+  std::map<llvm::BasicBlock *, FunctionDescription> Functions;
+
+public:
+  /// \brief Produce the compact FunctionsSummary
+  ///
+  /// \note This empties the builder.
+  FunctionsSummary finalize();
+};
+
+} // namespace StackAnalysis
@@ -5,11 +5,15 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <atomic>
 #include <chrono>
+#include <thread>
 
 #include "revng/Support/Statistics.h"
+#include "revng/Support/Tracing.h"
 
 #include "Cache.h"
+#include "FunctionsSummaryBuilder.h"
 #include "InterproceduralAnalysis.h"
 
 using llvm::BasicBlock;
@@ -20,16 +24,9 @@ using llvm::Optional;
 using llvm::StringRef;
 
 using time_point = std::chrono::steady_clock::time_point;
-using StringIntCounter = CounterMap<std::string, uint64_t>;
 
 Logger<> SaInterpLog("sa-interp");
 
-/// \brief Logger for counting how much time is spent on a function
-static StringIntCounter FunctionAnalysisTime("FunctionAnalysisTime");
-
-/// \brief Logger for counting how many times a function is analyzed
-static StringIntCounter FunctionAnalysisCount("FunctionAnalysisCount");
-
 template<typename T>
 static uint64_t nanoseconds(T Span) {
   return std::chrono::duration_cast<std::chrono::nanoseconds>(Span).count();
@@ -40,7 +37,9 @@ namespace StackAnalysis {
 void InterproceduralAnalysis::push(BasicBlock *Entry) {
   InProgressFunctions.insert(Entry);
   InProgress.emplace_back(Entry, TheCache, &GCBI, InProgressFunctions);
-  FunctionAnalysisCount.push(Entry->getName().str());
+  if (FunctionBudget != 0)
+    InProgress.back().setBudget(FunctionBudget);
+  CostReport::AnalysisCount.push(Entry->getName().str());
 }
 
 void InterproceduralAnalysis::run(BasicBlock *Entry, ResultsPool &Results) {
@@ -50,8 +49,9 @@ void InterproceduralAnalysis::run(BasicBlock *Entry, ResultsPool &Results) {
 
   Optional<const IFS *> Cached = TheCache.get(Entry);
 
-  // Has this function been analyzed already? If so, skip it.
-  if (Cached)
+  // Has this function been analyzed already, or is it known to be fake? If
+  // so, skip it.
+  if (Cached or TheCache.isFakeFunction(Entry))
     return;
 
   // Setup logger: each time we start a new intraprocedural analysis we indent
@@ -82,11 +82,14 @@ void InterproceduralAnalysis::run(BasicBlock *Entry, ResultsPool &Results) {
     time_point Begin = std::chrono::steady_clock::now();
 
     // Run/continue the intraprocedural analysis
-    Result = Current.run();
+    {
+      TraceScope Scope("Intraprocedural analysis", Current.entry()->getName());
+      Result = Current.run();
+    }
 
     time_point End = std::chrono::steady_clock::now();
-    FunctionAnalysisTime.push(Current.entry()->getName().str(),
-                              nanoseconds(End - Begin));
+    CostReport::AnalysisTime.push(Current.entry()->getName().str(),
+                                  nanoseconds(End - Begin));
 
     revng_assert(Result.requiresInterproceduralHandling());
 
@@ -142,7 +145,9 @@ void InterproceduralAnalysis::run(BasicBlock *Entry, ResultsPool &Results) {
         // has changed (hopefully the result won't be bottom) and will run the
         // analysis again until we're stable.
       } else {
-        // Just a regular (uncached) function call, push it on the stack
+        // Just a regular (uncached) function call, push it on the stack. The
+        // current analysis is suspended until the callee is done.
+        Current.compact();
         push(Callee);
       }
 
@@ -153,7 +158,9 @@ void InterproceduralAnalysis::run(BasicBlock *Entry, ResultsPool &Results) {
     case BranchType::RegularFunction: {
       const IFS &Summary = Result.getFunctionSummary();
 
-      revng_log(SaInterpLog, "We have a summary for " << Current.entry());
+      revng_log(SaInterpLog,
+                "We have a " << (Summary.Degraded ? "degraded " : "")
+                             << "summary for " << Current.entry());
 
       bool MustReanalyze = false;
 
@@ -197,8 +204,16 @@ void InterproceduralAnalysis::run(BasicBlock *Entry, ResultsPool &Results) {
         if (const auto *Root = getRecursionRoot(Current.entry()))
           popUntil(Root);
 
-        // Something changed, reset and re-run the analysis
-        Current.initialize();
+        // Something changed, reset and re-run the analysis. If only the
+        // summary of the current function changed, i.e., it's recursive, the
+        // basic blocks that don't depend on it don't have to be analyzed from
+        // scratch.
+        if (Offending.size() != 0) {
+          Current.initialize();
+        } else {
+          CostReport::RecursionRestarts.push(Current.entry()->getName().str());
+          Current.reinitialize(Current.entry());
+        }
 
       } else {
 
@@ -260,8 +275,33 @@ void ResultsPool::mergeFunction(BasicBlock *Function,
   LocallyWrittenRegisters[Function] = Summary.WrittenRegisters;
   FakeReturns[Function] = Summary.FakeReturns;
 
+  if (Summary.Degraded) {
+    // We gave up on this function: all the registers might be arguments and
+    // return values, both of the function and of its call sites
+    DegradedFunctions.insert(Function);
+
+    std::vector<CallSite> FunctionCallSites;
+    for (auto &P : CallSites)
+      if (P.first.belongsTo(Function))
+        FunctionCallSites.push_back(P.first);
+
+    for (int32_t Offset : Summary.WrittenRegisters) {
+      FunctionSlot Key = { Function, Offset };
+      FunctionRegisterArguments[Key] = FRA::maybe();
+      FunctionReturnValues[Key] = FRV::maybe();
+
+      for (const CallSite &Call : FunctionCallSites) {
+        FunctionCallSlot K = { Call, Offset };
+        FunctionCallRegisterArguments[K] = FCRA::maybe();
+        FunctionCallReturnValues[K] = FCRV::maybe();
+      }
+    }
+
+    return;
+  }
+
   // Merge results from the arguments analyses
-  const FunctionABI &ABI = Summary.ABI;
+  const FunctionABI &ABI = *Summary.ABI;
   auto &Slots = Summary.LocalSlots;
   for (auto &Slot : Slots) {
     int32_t Offset = Slot.first.offset();
@@ -571,11 +611,12 @@ struct ClobberedRegistersAnalysis {
   }
 };
 
-FunctionsSummary ResultsPool::finalize(Module *M, Cache *TheCache) {
+FunctionsSummary
+ResultsPool::finalize(Module *M, Cache *TheCache, unsigned ThreadsCount) {
   ASID CPU = ASID::cpuID();
 
   // Create the result data structure
-  FunctionsSummary Result;
+  FunctionsSummaryBuilder Result;
 
   // Set function types
   for (auto &P : FunctionTypes)
@@ -585,6 +626,9 @@ FunctionsSummary ResultsPool::finalize(Module *M, Cache *TheCache) {
   for (auto &P : FakeReturns)
     Result.Functions[P.first].FakeReturns = P.second;
 
+  for (BasicBlock *Function : DegradedFunctions)
+    Result.Functions[Function].Degraded = true;
+
   // Compute the set of registers clobbered by each function
   ClobberedRegistersAnalysis::ClobberedMap Clobbered;
   Clobbered = ClobberedRegistersAnalysis::run(*this);
@@ -600,7 +644,7 @@ FunctionsSummary ResultsPool::finalize(Module *M, Cache *TheCache) {
     Result.Functions[P.first.entry()].BasicBlocks[BB] = P.second;
   }
 
-  using CallSiteDescription = FunctionsSummary::CallSiteDescription;
+  using CallSiteDescription = FunctionsSummaryBuilder::CallSiteDescription;
 
   //
   // Collect, for each call site, all the slots and create a CallSiteDescription
@@ -668,12 +712,20 @@ FunctionsSummary ResultsPool::finalize(Module *M, Cache *TheCache) {
   // Merge information about a function and all the call sites targeting it
   //
 
-  // For each function
-  for (auto &P : Result.Functions) {
+  // Each function only updates its own description and the descriptions of
+  // the call sites targeting it, therefore functions can be handled in
+  // parallel and in any order. From now on, the maps shared by all the
+  // functions are only read, so create all the entries upfront.
+  for (auto &P : Result.Functions)
+    FunctionCallSitesMap[P.first];
+
+  using FunctionDescription = FunctionsSummaryBuilder::FunctionDescription;
+  using FunctionsMapEntry = std::pair<BasicBlock *const, FunctionDescription>;
+  auto Merge = [&](FunctionsMapEntry &P) {
     BasicBlock *FunctionEntry = P.first;
 
     // Integrate slots from each call site
-    FunctionCallSites &FCS = FunctionCallSitesMap[FunctionEntry];
+    FunctionCallSites &FCS = FunctionCallSitesMap.at(FunctionEntry);
 
     // Iterate over each slot
     for (ASSlot Slot : FCS.Slots) {
@@ -693,9 +745,9 @@ FunctionsSummary ResultsPool::finalize(Module *M, Cache *TheCache) {
           const CallSite &TheCallSite = Q.first;
           FunctionCallSlot FCS{ TheCallSite, Offset };
 
-          CallSiteRegister.Argument = FCRA[FCS];
+          CallSiteRegister.Argument = getOrDefault(FCRA, FCS);
           CallSiteRegister.Argument.notAvailable();
-          CallSiteRegister.ReturnValue = FCRV[FCS];
+          CallSiteRegister.ReturnValue = getOrDefault(FCRV, FCS);
           CallSiteRegister.ReturnValue.notAvailable();
 
           if (FunctionEntry != nullptr) {
@@ -716,7 +768,7 @@ FunctionsSummary ResultsPool::finalize(Module *M, Cache *TheCache) {
         //
 
         // Register status at the function
-        const FunctionRegisterArgument &FunctionStatus = FRA[TheFunctionSlot];
+        FunctionRegisterArgument FunctionStatus = FRA.at(TheFunctionSlot);
         auto Status = FunctionStatus.value();
         revng_assert(Status == FunctionRegisterArgument::Maybe
                      or Status == FunctionRegisterArgument::NoOrDead
@@ -735,7 +787,7 @@ FunctionsSummary ResultsPool::finalize(Module *M, Cache *TheCache) {
           FunctionCallSlot FCS{ TheCallSite, Offset };
 
           // Register status at current call site
-          const FunctionCallRegisterArgument &CallerStatus = FCRA[FCS];
+          FunctionCallRegisterArgument CallerStatus = getOrDefault(FCRA, FCS);
           auto Status = CallerStatus.value();
           revng_assert(Status == FunctionCallRegisterArgument::Maybe
                        or Status == FunctionCallRegisterArgument::Yes);
@@ -825,7 +877,7 @@ FunctionsSummary ResultsPool::finalize(Module *M, Cache *TheCache) {
         //
 
         // Register status at the function
-        const FunctionReturnValue &FunctionStatus = FRV[TheFunctionSlot];
+        auto FunctionStatus = getOrDefault(FRV, TheFunctionSlot);
         auto Status = FunctionStatus.value();
         revng_assert(Status == FunctionReturnValue::Maybe
                      or Status == FunctionReturnValue::No
@@ -840,7 +892,7 @@ FunctionsSummary ResultsPool::finalize(Module *M, Cache *TheCache) {
           FunctionCallSlot FCS{ TheCallSite, Offset };
 
           // Register status at current call site
-          const FunctionCallReturnValue &CallerStatus = FCRV[FCS];
+          FunctionCallReturnValue CallerStatus = getOrDefault(FCRV, FCS);
           auto Status = CallerStatus.value();
           revng_assert(Status == FunctionCallReturnValue::Maybe
                        or Status == FunctionCallReturnValue::NoOrDead
@@ -1009,9 +1061,32 @@ FunctionsSummary ResultsPool::finalize(Module *M, Cache *TheCache) {
         P.second.RegisterSlots[CSV].ReturnValue = Result;
       }
     }
+  };
+
+  std::vector<FunctionsMapEntry *> Work;
+  for (auto &P : Result.Functions)
+    Work.push_back(&P);
+
+  ThreadsCount = std::min<size_t>(ThreadsCount, Work.size());
+  if (ThreadsCount <= 1) {
+    for (FunctionsMapEntry *P : Work)
+      Merge(*P);
+  } else {
+    std::atomic<size_t> Next(0);
+    auto Worker = [&Work, &Next, &Merge]() {
+      for (size_t I = Next++; I < Work.size(); I = Next++)
+        Merge(*Work[I]);
+    };
+
+    std::vector<std::thread> Threads;
+    for (unsigned I = 0; I < ThreadsCount; I++)
+      Threads.emplace_back(Worker);
+
+    for (std::thread &Thread : Threads)
+      Thread.join();
   }
 
-  return Result;
+  return Result.finalize();
 }
 
 } // namespace StackAnalysis
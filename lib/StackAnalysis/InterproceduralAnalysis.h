@@ -6,6 +6,7 @@
 
 #include <map>
 #include <set>
+#include <string>
 #include <vector>
 
 #include "llvm/ADT/Optional.h"
@@ -18,6 +19,7 @@
 #include "revng/Support/Debug.h"
 #include "revng/Support/IRHelpers.h"
 
+#include "CostReport.h"
 #include "Intraprocedural.h"
 
 /// \brief Logger for messages concerning the interprocedural analysis
@@ -77,6 +79,9 @@ private:
   map<BasicBlock *, std::set<int32_t>> ExplicitlyCalleeSavedRegisters;
   map<BasicBlock *, std::vector<FunctionCall>> FunctionCalls;
 
+  /// \brief Functions whose analysis exceeded the budget
+  std::set<BasicBlock *> DegradedFunctions;
+
 public:
   /// \brief Register a function for which a summary is not available
   void registerFunction(llvm::BasicBlock *Function, FunctionType::Values Type) {
@@ -115,7 +120,12 @@ public:
 
   /// \brief Finalized the data stored in this object and produce a
   ///        FunctionsSummary
-  FunctionsSummary finalize(llvm::Module *M, Cache *TheCache);
+  ///
+  /// \param ThreadsCount the number of threads merging the results of the
+  ///        functions with the results of the call sites targeting them. The
+  ///        result doesn't depend on it.
+  FunctionsSummary
+  finalize(llvm::Module *M, Cache *TheCache, unsigned ThreadsCount = 1);
 
   void dump(const llvm::Module *M) const debug_function { dump(M, dbg); }
 
@@ -198,10 +208,13 @@ private:
   GeneratedCodeBasicInfo &GCBI;
   std::vector<Analysis> InProgress;
   std::set<llvm::BasicBlock *> InProgressFunctions; ///< For recursion detection
+  size_t FunctionBudget; ///< Maximum number of visits per function, if not 0
 
 public:
-  InterproceduralAnalysis(Cache &TheCache, GeneratedCodeBasicInfo &GCBI) :
-    TheCache(TheCache), GCBI(GCBI) {}
+  InterproceduralAnalysis(Cache &TheCache,
+                          GeneratedCodeBasicInfo &GCBI,
+                          size_t FunctionBudget = 0) :
+    TheCache(TheCache), GCBI(GCBI), FunctionBudget(FunctionBudget) {}
 
   void run(llvm::BasicBlock *Entry, ResultsPool &Results);
 
@@ -222,7 +235,12 @@ private:
   }
 
   void pop() {
-    InProgressFunctions.erase(InProgress.back().entry());
+    const Analysis &Last = InProgress.back();
+    std::string Name = Last.entry()->getName().str();
+    CostReport::Iterations.push(Name, Last.work());
+    CostReport::PeakElementSize.pushMax(Name, Last.peakElementSize());
+
+    InProgressFunctions.erase(Last.entry());
     InProgress.pop_back();
   }
 };
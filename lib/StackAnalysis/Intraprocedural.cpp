@@ -5,9 +5,12 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <chrono>
 #include <iomanip>
+#include <mutex>
 
 #include "Cache.h"
+#include "CostReport.h"
 #include "InterproceduralAnalysis.h"
 #include "Intraprocedural.h"
 
@@ -47,9 +50,16 @@ static Logger<> SaBBLog("sa-bb");
 // Statistics
 RunningStatistics ABIRegistersCountStats("ABIRegistersCount");
 static RunningStatistics CacheHitRate("CacheHitRate");
+static RunningStatistics InternedAddressSpacesStats("InternedAddressSpaces");
 
 /// \brief Per-function cache hit rate
 static std::map<BasicBlock *, RunningStatistics> FunctionCacheHitRate;
+static std::mutex FunctionCacheHitRateLock;
+
+static RunningStatistics &functionCacheHitRate(BasicBlock *Function) {
+  std::lock_guard<std::mutex> Guard(FunctionCacheHitRateLock);
+  return FunctionCacheHitRate[Function];
+}
 
 /// \brief Round \p Value to \p Digits
 template<typename F>
@@ -64,6 +74,54 @@ namespace StackAnalysis {
 namespace Intraprocedural {
 
 void Analysis::initialize() {
+  resetFunctionState();
+  Base::initialize();
+}
+
+void Analysis::reinitialize(BasicBlock *Callee) {
+  // Collect the basic blocks reachable from a call to Callee
+  OnceQueue<BasicBlock *> Affected;
+  for (auto &P : BranchesType)
+    if (getFunctionCallCallee(P.first) == Callee)
+      for (BasicBlock *Successor : SuccessorsMap[P.first])
+        Affected.insert(Successor);
+
+  while (not Affected.empty())
+    for (BasicBlock *Successor : SuccessorsMap[Affected.pop()])
+      Affected.insert(Successor);
+
+  std::set<BasicBlock *> Preserved;
+  std::set<BasicBlock *> Visited = Affected.visited();
+  for (auto &P : State)
+    if (Visited.count(P.first) == 0)
+      Preserved.insert(P.first);
+
+  revng_log(SaLog,
+            "Reinitializing " << getName(Entry) << ", preserving "
+                              << Preserved.size() << " out of "
+                              << State.size() << " basic blocks");
+
+  resetFunctionState();
+  Base::initialize(Preserved);
+}
+
+void Analysis::compact() {
+  Element::AddressSpacePool Pool;
+  unsigned Interned = InitialState.intern(Pool);
+
+  for (auto &P : State)
+    Interned += P.second.intern(Pool);
+
+  for (auto &P : ReturnCandidates)
+    Interned += P.second.intern(Pool);
+
+  InternedAddressSpacesStats.push(Interned);
+  revng_log(SaLog,
+            "Compacting " << getName(Entry) << ": " << Interned
+                          << " address spaces now share their storage");
+}
+
+void Analysis::resetFunctionState() {
   CacheMustHit = false;
 
   revng_log(SaLog, "Creating Analysis for " << getName(Entry));
@@ -106,14 +164,13 @@ void Analysis::initialize() {
   TheABIIR.reset();
   IncoherentFunctions.clear();
   SuccessorsMap.clear();
-  Base::initialize();
 }
 
 /// \brief Class to keep track of the Value associated to each instruction in a
 ///        basic block
 class BasicBlockState {
 public:
-  using ContentMap = std::map<Instruction *, Value>;
+  using ContentMap = llvm::DenseMap<Instruction *, Value>;
 
 private:
   BasicBlock *BB;
@@ -301,15 +358,16 @@ Interrupt Analysis::transfer(BasicBlock *BB) {
   auto It = State.find(BB);
   revng_assert(It != State.end());
   Element Result = It->second.copy();
+  PeakElementSize = std::max(PeakElementSize, Result.size());
 
-  revng_log(SaBBLog, "Analyzing " << getName(BB));
+  revng_log_verbose(SaBBLog, "Analyzing " << getName(BB));
   LoggerIndent<> Y(SaBBLog);
 
-  if (SaLog.isEnabled()) {
-    SaLog << "Analyzing basic block " << getName(BB) << DoLog;
-    Result.dump(M, SaLog);
-    SaLog << DoLog;
-  }
+  logLazily(SaLog, [&](Logger<> &Log) {
+    Log << "Analyzing basic block " << getName(BB) << DoLog;
+    Result.dump(M, Log);
+    Log << DoLog;
+  });
 
   // Reset the basic ABI IR basic block
   ABIIRBasicBlock &ABIBB = TheABIIR.get(BB);
@@ -323,7 +381,7 @@ Interrupt Analysis::transfer(BasicBlock *BB) {
 
   for (Instruction &I : *BB) {
 
-    revng_log(SaVerboseLog, "NewInstruction: " << getName(&I));
+    revng_log_verbose(SaVerboseLog, "NewInstruction: " << getName(&I));
 
     switch (I.getOpcode()) {
     case Instruction::Load: {
@@ -913,18 +971,20 @@ Interrupt Analysis::handleCall(Instruction *Caller,
       const char *ResultString = nullptr;
       if (CacheEntry) {
         CacheHitRate.push(1);
-        FunctionCacheHitRate[Callee].push(1);
+        functionCacheHitRate(Callee).push(1);
+        CostReport::CacheHits.push(Entry->getName().str());
         ResultString = "hit";
       } else {
         CacheHitRate.push(0);
-        FunctionCacheHitRate[Callee].push(0);
+        functionCacheHitRate(Callee).push(0);
+        CostReport::CacheMisses.push(Entry->getName().str());
         ResultString = "miss";
       }
 
       if (SaInterpLog.isEnabled()) {
         SaInterpLog << "Cache " << ResultString << " for " << Callee << " at "
                     << Caller << " (";
-        auto Mean = FunctionCacheHitRate[Callee].mean();
+        auto Mean = functionCacheHitRate(Callee).mean();
         SaInterpLog << "function hit rate: " << round(100 * Mean, 4) << "%";
         SaInterpLog << ", hit rate: " << round(100 * CacheHitRate.mean(), 4)
                     << "%) ";
@@ -969,15 +1029,17 @@ Interrupt Analysis::handleCall(Instruction *Caller,
     Result.apply(CallSummary->FinalState);
   }
 
-  if (IsRecursive or IsIndirect) {
+  // We know nothing about degraded callees, handle them as indirect calls
+  if (IsRecursive or IsIndirect or CallSummary->Degraded) {
     ABIBB.append(ABIIRInstruction::createIndirectCall(TheFunctionCall));
   } else {
     std::set<int32_t> StackArguments;
     if (CallerStackSize and *CallerStackSize >= 0)
       StackArguments = CallSummary->FinalState.stackArguments(*CallerStackSize);
+    auto It = StackArgumentsPool.insert(std::move(StackArguments)).first;
     ABIBB.append(ABIIRInstruction::createDirectCall(TheFunctionCall,
-                                                    CallSummary->ABI.copy(),
-                                                    StackArguments));
+                                                    CallSummary->ABI,
+                                                    *It));
   }
 
   // Record frame size
@@ -1022,6 +1084,11 @@ IFS Analysis::createSummary() {
   FunctionType::Values Type = P.first;
   Element GrandResult = std::move(P.second);
 
+  // The return candidates have been merged in GrandResult: if the analysis is
+  // run again, they will be recorded again
+  ReturnCandidates.clear();
+  FinalResult = Element::bottom();
+
   // Fake functions need no further analysis (NoReturn functions do)
   if (Type == FunctionType::Fake)
     return IFS::createFake();
@@ -1040,7 +1107,11 @@ IFS Analysis::createSummary() {
   revng_assert(TheABIIR.verify(), "The ABI IR is invalid");
 
   // Run the almighty ABI analyses
+  using namespace std::chrono;
+  auto Begin = steady_clock::now();
   ABI.analyze(TheABIIR);
+  auto Elapsed = duration_cast<nanoseconds>(steady_clock::now() - Begin);
+  CostReport::ABIAnalysisTime.push(Entry->getName().str(), Elapsed.count());
 
   // Find all the function calls that lead to results incoherent with the
   // callees and register them
@@ -1073,6 +1144,24 @@ IFS Analysis::createSummary() {
   return Summary;
 }
 
+Interrupt Analysis::createBudgetExceededInterrupt() {
+  revng_log(SaInterpLog,
+            getName(Entry) << " exceeded its budget after " << work()
+                           << " steps, giving up");
+
+  // Without a proper analysis, any register might be read or written
+  std::set<int32_t> AllRegisters;
+  for (int32_t Index = 1; TheCache->isCSVIndex(Index); Index++)
+    AllRegisters.insert(Index);
+
+  IncoherentFunctions.clear();
+
+  return Interrupt::createSummary(IFS::createDegraded(FrameSizeAtCallSite,
+                                                      BranchesType,
+                                                      std::move(AllRegisters),
+                                                      FakeReturns));
+}
+
 void Analysis::findIncoherentFunctions(const IFS &ABISummary) {
   // TODO: do we need to take into account also all the registers used
   //       in the various function calls?
@@ -1100,23 +1189,63 @@ void Analysis::findIncoherentFunctions(const IFS &ABISummary) {
 
     // We might not have an entry, e.g., if they callee is noreturn
     Optional<const IFS *> Cache = TheCache->get(Callee);
-    if (Cache) {
-      const FunctionABI &CalleeSummary = (*Cache)->ABI;
+    if (Cache and not(*Cache)->Degraded) {
+      const FunctionABI &CalleeSummary = *(*Cache)->ABI;
+
+      // Reuse the outcome of the last check on this call, if still valid
+      CallCoherence Current;
+      Current.CalleeVersion = TheCache->version(Callee);
+      Current.FrameSize = P.second;
+      Current.CallerRegisters = callerRegisters(ABISummary, TheFunctionCall);
+
+      CallCoherence &Last = TheCache->callCoherence(Entry, TheFunctionCall);
+      if (Last.isUpToDate(Current)) {
+        if (not Last.Coherent)
+          IncoherentFunctions.insert(Callee);
+        continue;
+      }
 
       // Loop over all the slots being considered in this function
       for (auto &Slot : Slots) {
-        if (not isCoherent(ABISummary.ABI,
+        if (not isCoherent(*ABISummary.ABI,
                            CalleeSummary,
                            TheFunctionCall,
                            Slot)) {
           IncoherentFunctions.insert(Callee);
+          Current.Coherent = false;
           break;
         }
       }
+
+      Last = std::move(Current);
     }
   }
 }
 
+std::vector<CallerRegisterState>
+Analysis::callerRegisters(const IFS &ABISummary,
+                          FunctionCall TheFunctionCall) const {
+  std::vector<CallerRegisterState> Result;
+  for (auto &Slot : ABISummary.LocalSlots) {
+    // Only used registers are checked, see isCoherent
+    if (Slot.second != LocalSlotType::UsedRegister)
+      continue;
+
+    int32_t Offset = Slot.first.offset();
+    FunctionCallRegisterArgument FunctionCallArgument;
+    FunctionCallReturnValue TheFunctionCallReturnValue;
+    ABISummary.ABI->applyResults(FunctionCallArgument, TheFunctionCall, Offset);
+    ABISummary.ABI->applyResults(TheFunctionCallReturnValue,
+                                 TheFunctionCall,
+                                 Offset);
+    Result.push_back({ Offset,
+                       FunctionCallArgument.value(),
+                       TheFunctionCallReturnValue.value() });
+  }
+
+  return Result;
+}
+
 bool Analysis::isCoherent(const FunctionABI &CallerSummary,
                           const FunctionABI &CalleeSummary,
                           FunctionCall TheFunctionCall,
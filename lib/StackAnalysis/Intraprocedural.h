@@ -10,6 +10,8 @@
 #include <utility>
 #include <vector>
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/SmallVector.h"
 
 #include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
@@ -321,13 +323,20 @@ private:
   int32_t PCIndex; ///< Offset of the PC CSV
   ABIFunction TheABIIR; ///< The ABI IR
 
+  /// \brief Interned sets of caller stack slots written by the callees
+  ///
+  /// The direct calls in the ABI IR point into this pool, which survives
+  /// restarts of the analysis.
+  std::set<std::set<int32_t>> StackArgumentsPool;
+
   /// \brief Set of return addresses from fake function calls
-  std::set<uint64_t> FakeReturnAddresses;
+  llvm::DenseSet<uint64_t> FakeReturnAddresses;
 
   /// \brief Branches list and classification
   std::map<llvm::BasicBlock *, BranchType::Values> BranchesType;
 
-  std::map<llvm::Instruction *, Value> VariableContent; ///< Content of allocas
+  /// \brief Content of allocas and of the instructions used in other blocks
+  llvm::DenseMap<llvm::Instruction *, Value> VariableContent;
 
   /// This flag is set if the last time we interrupted the analysis was due to
   /// an unhandled function call, which should then result in a cache hit
@@ -347,6 +356,9 @@ private:
 
   std::multimap<llvm::BasicBlock *, MetaAddress> FakeReturns;
 
+  /// \brief Largest initial state of a basic block met so far
+  size_t PeakElementSize = 0;
+
 public:
   Analysis(llvm::BasicBlock *Entry,
            const Cache &TheCache,
@@ -383,6 +395,8 @@ public:
 
   llvm::BasicBlock *entry() const { return Entry; }
 
+  size_t peakElementSize() const { return PeakElementSize; }
+
   void resetCacheMustHit() { CacheMustHit = false; }
 
   bool cacheMustHit() const { return CacheMustHit; }
@@ -390,6 +404,25 @@ public:
   /// \brief Reset the analysis with a new intial state
   void initialize();
 
+  /// \brief Reset the analysis after the summary of \p Callee has changed
+  ///
+  /// Unlike initialize, the state of the basic blocks not reachable from a
+  /// call to \p Callee doesn't depend on its summary, and it's preserved.
+  void reinitialize(llvm::BasicBlock *Callee);
+
+  /// \brief Reduce the memory taken by the analysis while it's suspended
+  ///
+  /// The states of the basic blocks are only needed again once the analysis
+  /// is resumed. Meanwhile, the equal address spaces among them share the same
+  /// storage, which bounds the memory taken by deep chains of suspended
+  /// analyses.
+  void compact();
+
+private:
+  /// \brief Reset all the information about the function but the states
+  void resetFunctionState();
+
+public:
   /// \brief Return the stack size of \p Result, if available
   llvm::Optional<int32_t> stackSize(Element &Result) const {
     Value StackPointer = Value::fromSlot(ASID::cpuID(), SPIndex);
@@ -470,6 +503,9 @@ public:
     return Interrupt::createSummary(createSummary());
   }
 
+  /// \brief Give up on the current function, producing a degraded summary
+  Interrupt createBudgetExceededInterrupt();
+
   /// \brief Return the set of functions called by this function in an
   ///        incoherent way
   ///
@@ -495,7 +531,16 @@ private:
                   FunctionCall TheFunctionCall,
                   IntraproceduralFunctionSummary::LocalSlot Slot) const;
 
+  /// \brief Collect what \p CallerSummary says about the registers used in
+  ///        this function at \p TheFunctionCall
+  std::vector<CallerRegisterState>
+  callerRegisters(const IntraproceduralFunctionSummary &ABISummary,
+                  FunctionCall TheFunctionCall) const;
+
   /// \brief Populate IncoherentFunctions
+  ///
+  /// Function calls whose callee summary, frame size and caller registers
+  /// didn't change since the last check are not checked again.
   void
   findIncoherentFunctions(const IntraproceduralFunctionSummary &ABISummary);
 
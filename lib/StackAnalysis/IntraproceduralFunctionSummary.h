@@ -5,6 +5,7 @@
 //
 
 #include <limits>
+#include <memory>
 
 #include "Element.h"
 #include "FunctionABI.h"
@@ -51,21 +52,38 @@ public:
 public:
   FunctionType::Values Type;
   Intraprocedural::Element FinalState;
-  FunctionABI ABI;
+
+  /// \brief Results of the ABI analysis of the function
+  ///
+  /// The results are immutable once the summary has been created, therefore
+  /// copies of the summary and the call sites in the ABI IR of the callers all
+  /// share the same instance.
+  std::shared_ptr<const FunctionABI> ABI;
+
   LocalSlotVector LocalSlots;
   CallSiteStackSizeMap FrameSizeAtCallSite;
   BranchesTypeMap BranchesType;
   std::set<int32_t> WrittenRegisters;
   FakeReturnsMap FakeReturns;
 
+  /// \brief True if the analysis of the function exceeded its budget
+  ///
+  /// Degraded summaries have no FinalState nor ABI analysis results: the
+  /// function has to be considered as possibly reading and writing all the
+  /// registers in WrittenRegisters.
+  bool Degraded = false;
+
 public:
   IntraproceduralFunctionSummary() :
     Type(FunctionType::Invalid),
-    FinalState(Intraprocedural::Element::bottom()) {}
+    FinalState(Intraprocedural::Element::bottom()),
+    ABI(emptyABI()) {}
 
 private:
   IntraproceduralFunctionSummary(FunctionType::Values Type) :
-    Type(Type), FinalState(Intraprocedural::Element::bottom()) {}
+    Type(Type),
+    FinalState(Intraprocedural::Element::bottom()),
+    ABI(emptyABI()) {}
 
   IntraproceduralFunctionSummary(FunctionType::Values Type,
                                  Intraprocedural::Element FinalState,
@@ -76,13 +94,13 @@ private:
                                  const FakeReturnsMap &FakeReturns) :
     Type(Type),
     FinalState(std::move(FinalState)),
-    ABI(std::move(ABI)),
     FrameSizeAtCallSite(std::move(FrameSizes)),
     BranchesType(std::move(BranchesType)),
     WrittenRegisters(std::move(WrittenRegisters)),
     FakeReturns(FakeReturns) {
 
-    process();
+    process(ABI);
+    this->ABI = std::make_shared<const FunctionABI>(std::move(ABI));
   }
 
 public:
@@ -121,6 +139,20 @@ public:
                                           std::move(FakeReturns));
   }
 
+  static IntraproceduralFunctionSummary
+  createDegraded(CallSiteStackSizeMap FrameSizes,
+                 BranchesTypeMap BranchesType,
+                 std::set<int32_t> AllRegisters,
+                 std::multimap<llvm::BasicBlock *, MetaAddress> FakeReturns) {
+    IFS Result(FunctionType::Regular);
+    Result.FrameSizeAtCallSite = std::move(FrameSizes);
+    Result.BranchesType = std::move(BranchesType);
+    Result.WrittenRegisters = std::move(AllRegisters);
+    Result.FakeReturns = std::move(FakeReturns);
+    Result.Degraded = true;
+    return Result;
+  }
+
   static IntraproceduralFunctionSummary bottom() {
     return IntraproceduralFunctionSummary();
   }
@@ -129,12 +161,13 @@ public:
     IFS Result;
     Result.Type = Type;
     Result.FinalState = FinalState.copy();
-    Result.ABI = ABI.copy();
+    Result.ABI = ABI;
     Result.LocalSlots = LocalSlots;
     Result.FrameSizeAtCallSite = FrameSizeAtCallSite;
     Result.BranchesType = BranchesType;
     Result.WrittenRegisters = WrittenRegisters;
     Result.FakeReturns = FakeReturns;
+    Result.Degraded = Degraded;
     return Result;
   }
 
@@ -149,13 +182,15 @@ public:
   template<typename T>
   void dump(const llvm::Module *M, T &Output) const {
     Output << "Type: " << FunctionType::getName(Type) << "\n";
+    if (Degraded)
+      Output << "Degraded: the budget has been exceeded\n";
 
     Output << "FinalState:\n";
     FinalState.dump(M, Output);
     Output << "\n";
 
     Output << "ABI:\n";
-    ABI.dump(M, Output);
+    ABI->dump(M, Output);
     Output << "\n";
 
     Output << "Local slots (" << LocalSlots.size() << "):\n";
@@ -167,7 +202,13 @@ public:
   }
 
 private:
-  void process() {
+  /// \brief The ABI shared by all the summaries without ABI analysis results
+  static const std::shared_ptr<const FunctionABI> &emptyABI() {
+    static const auto Empty = std::make_shared<const FunctionABI>();
+    return Empty;
+  }
+
+  void process(FunctionABI &ABI) {
     using namespace Intraprocedural;
     using std::set;
 
@@ -7,27 +7,51 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <map>
-#include <sstream>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #include "llvm/ADT/DepthFirstIterator.h"
+#include "llvm/ADT/EquivalenceClasses.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/IR/Dominators.h"
 #include "llvm/IR/Function.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/raw_ostream.h"
 
 #include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
 #include "revng/Model/Binary.h"
+#include "revng/Model/TupleTreeDiff.h"
 #include "revng/StackAnalysis/StackAnalysis.h"
 #include "revng/Support/CommandLine.h"
 #include "revng/Support/IRHelpers.h"
+#include "revng/Support/MemoryUsage.h"
+#include "revng/Support/ProfilerRegion.h"
+#include "revng/Support/Tracing.h"
 
 #include "Cache.h"
+#include "CostReport.h"
 #include "InterproceduralAnalysis.h"
 #include "Intraprocedural.h"
+#include "SummaryDatabase.h"
 
+using llvm::ArrayRef;
 using llvm::BasicBlock;
+using llvm::BlockAddress;
+using llvm::CallInst;
+using llvm::cast;
+using llvm::dyn_cast;
+using llvm::EquivalenceClasses;
 using llvm::Function;
 using llvm::Module;
 using llvm::RegisterPass;
@@ -40,7 +64,6 @@ using namespace llvm::cl;
 
 namespace StackAnalysis {
 
-const std::set<llvm::GlobalVariable *> EmptyCSVSet;
 
 char StackAnalysis::ID = 0;
 
@@ -53,6 +76,207 @@ static opt<std::string> ABIAnalysisOutputPath("abi-analysis-output",
                                               value_desc("path"),
                                               cat(MainCategory));
 
+static opt<unsigned> SAThreads("sa-threads",
+                               desc("Number of threads analyzing independent "
+                                    "groups of functions"),
+                               value_desc("threads"),
+                               cat(MainCategory),
+                               init(1));
+
+static opt<std::string> SummaryDatabasePath("sa-summary-database",
+                                            desc("Database of the types of "
+                                                 "the leaf functions, shared "
+                                                 "across binaries"),
+                                            value_desc("path"),
+                                            cat(MainCategory));
+
+static opt<std::string> BaseModelPath("sa-base-model",
+                                      desc("Model produced by a previous run: "
+                                           "only the functions that changed "
+                                           "since then, and their callers, "
+                                           "are analyzed again"),
+                                      value_desc("path"),
+                                      cat(MainCategory));
+
+static opt<std::string> CostReportPath("stack-analysis-report",
+                                       desc("Write the cost of the analysis "
+                                            "of each function in JSON, or in "
+                                            "CSV if the path ends with .csv"),
+                                       value_desc("path"),
+                                       cat(MainCategory));
+
+static opt<unsigned> FunctionBudget("sa-function-budget",
+                                    desc("Maximum number of basic blocks "
+                                         "visited in a function before "
+                                         "giving up and considering all the "
+                                         "registers as arguments and "
+                                         "clobbered (0 is unlimited)"),
+                                    value_desc("visits"),
+                                    cat(MainCategory),
+                                    init(0));
+
+static opt<bool> ForceAnalysis("sa-force",
+                               desc("Analyze the functions even if the model "
+                                    "has been produced from the same IR with "
+                                    "the same options"),
+                               cat(MainCategory),
+                               init(false));
+
+/// Bump this each time the functions produced by the analysis change
+static const char *FingerprintVersion = "stack-analysis 1";
+
+static void hashString(llvm::SHA1 &Hasher, llvm::StringRef String) {
+  static const uint8_t Terminator = 0;
+  Hasher.update(String);
+  // Terminate each string, so that concatenations don't collide
+  Hasher.update(ArrayRef<uint8_t>(Terminator));
+}
+
+/// \brief raw_ostream feeding what's written to it to a SHA1 hasher
+class SHA1Stream : public llvm::raw_ostream {
+private:
+  llvm::SHA1 &Hasher;
+  uint64_t Position = 0;
+
+public:
+  SHA1Stream(llvm::SHA1 &Hasher) : Hasher(Hasher) {}
+  ~SHA1Stream() override { flush(); }
+
+private:
+  void write_impl(const char *Pointer, size_t Size) override {
+    Hasher.update(llvm::StringRef(Pointer, Size));
+    Position += Size;
+  }
+
+  uint64_t current_pos() const override { return Position; }
+};
+
+/// \brief Compute the fingerprint of the IR of `root` and of the options
+///        affecting the result of the analysis
+///
+/// The content of the summary database is not part of the fingerprint, only
+/// its path is.
+static std::string fingerprint(const Module &M) {
+  llvm::SHA1 Hasher;
+  hashString(Hasher, FingerprintVersion);
+  hashString(Hasher, SummaryDatabasePath);
+  hashString(Hasher, std::to_string(FunctionBudget));
+
+  {
+    SHA1Stream Stream(Hasher);
+    M.getFunction("root")->print(Stream);
+  }
+
+  return llvm::toHex(Hasher.final(), true);
+}
+
+/// \brief Can the stack analysis go through \p BB?
+static bool isAnalyzable(BasicBlock *BB) {
+  switch (GeneratedCodeBasicInfo::getType(BB)) {
+  case BlockType::JumpTargetBlock:
+  case BlockType::TranslatedBlock:
+  case BlockType::IndirectBranchDispatcherHelperBlock:
+    return true;
+
+  case BlockType::RootDispatcherBlock:
+  case BlockType::RootDispatcherHelperBlock:
+  case BlockType::AnyPCBlock:
+  case BlockType::UnexpectedPCBlock:
+  case BlockType::DispatcherFailureBlock:
+  case BlockType::ExternalJumpsHandlerBlock:
+  case BlockType::EntryPoint:
+    return false;
+  }
+
+  revng_abort();
+}
+
+/// \brief Partition the blocks of \p F in groups that can be analyzed
+///        independently
+///
+/// Two blocks end up in the same group if one is a successor of the other or
+/// if one contains a function call targeting (or returning to) the other. The
+/// analysis never leaves the group of the function it started from, therefore
+/// functions in distinct groups never access the same entries of the Cache.
+static EquivalenceClasses<BasicBlock *> groupIndependentBlocks(Function &F) {
+  EquivalenceClasses<BasicBlock *> Groups;
+
+  for (BasicBlock &BB : F) {
+    if (not isAnalyzable(&BB))
+      continue;
+
+    Groups.insert(&BB);
+
+    auto Join = [&Groups, &BB](BasicBlock *Other) {
+      if (isAnalyzable(Other))
+        Groups.unionSets(&BB, Other);
+    };
+
+    for (BasicBlock *Successor : successors(&BB))
+      Join(Successor);
+
+    if (CallInst *Call = getFunctionCall(&BB)) {
+      if (auto *Callee = dyn_cast<BlockAddress>(Call->getArgOperand(0)))
+        Join(Callee->getBasicBlock());
+      Join(cast<BlockAddress>(Call->getArgOperand(1))->getBasicBlock());
+    }
+  }
+
+  return Groups;
+}
+
+/// \brief Run the interprocedural analysis on each of the \p Entries
+///
+/// If \p ThreadsCount is greater than one, the functions are split according
+/// to \p Groups and all the functions of a group are analyzed, in their
+/// original order, by the same thread. Since groups are independent, this
+/// produces the same content of \p TheCache as the sequential analysis.
+static void analyzeFunctions(ArrayRef<BasicBlock *> Entries,
+                             const EquivalenceClasses<BasicBlock *> &Groups,
+                             unsigned ThreadsCount,
+                             Cache &TheCache,
+                             GeneratedCodeBasicInfo &GCBI,
+                             ResultsPool &Results) {
+  auto Analyze = [&TheCache, &GCBI, &Results](BasicBlock *Entry) {
+    InterproceduralAnalysis SA(TheCache, GCBI, FunctionBudget);
+    SA.run(Entry, Results);
+  };
+
+  if (ThreadsCount <= 1) {
+    for (BasicBlock *Entry : Entries)
+      Analyze(Entry);
+    return;
+  }
+
+  // Collect the functions of each group, preserving their order
+  std::map<BasicBlock *, size_t> GroupIndex;
+  std::vector<std::vector<BasicBlock *>> Work;
+  for (BasicBlock *Entry : Entries) {
+    BasicBlock *Leader = Groups.getLeaderValue(Entry);
+    auto It = GroupIndex.find(Leader);
+    if (It == GroupIndex.end()) {
+      It = GroupIndex.emplace(Leader, Work.size()).first;
+      Work.emplace_back();
+    }
+    Work[It->second].push_back(Entry);
+  }
+
+  std::atomic<size_t> Next(0);
+  auto Worker = [&Work, &Next, &Analyze]() {
+    for (size_t I = Next++; I < Work.size(); I = Next++)
+      for (BasicBlock *Entry : Work[I])
+        Analyze(Entry);
+  };
+
+  ThreadsCount = std::min<size_t>(ThreadsCount, Work.size());
+  std::vector<std::thread> Threads;
+  for (unsigned I = 0; I < ThreadsCount; I++)
+    Threads.emplace_back(Worker);
+
+  for (std::thread &Thread : Threads)
+    Thread.join();
+}
+
 template<bool FunctionCall>
 static model::RegisterState::Values
 toRegisterState(RegisterArgument<FunctionCall> RA) {
@@ -113,21 +337,294 @@ toRegisterState(FunctionCallReturnValue RV) {
   revng_abort();
 }
 
+/// \brief A register of a prototype, along with its size in bytes
+using SizedRegister = std::pair<model::Register::Values, unsigned>;
+
+/// \brief The registers of a prototype, before it's recorded in the model
+struct RawPrototype {
+  std::vector<SizedRegister> Arguments;
+  std::vector<SizedRegister> ReturnValues;
+};
+
+/// \brief What the analysis of a single function contributes to the model
+///
+/// Pieces are built in parallel, without touching the model. The creation of
+/// types draws their IDs from a global generator, therefore the prototypes are
+/// recorded later, serially and always in the same order.
+struct FunctionPiece {
+  FunctionPiece(const MetaAddress &Entry) : Function(Entry) {}
+
+  model::Function Function;
+  RawPrototype Prototype;
+
+  /// Direct calls, inheriting the prototype of the callee
+  std::vector<std::pair<model::CallEdge *, MetaAddress>> DirectCalls;
+
+  /// Indirect calls, with the prototype to forge
+  std::vector<std::pair<model::CallEdge *, RawPrototype>> IndirectCalls;
+};
+
+/// \brief Collect the registers of \p Slots that should appear in a prototype
+template<typename T>
+static RawPrototype
+collectPrototype(GeneratedCodeBasicInfo &GCBI, const T &Slots) {
+  RawPrototype Result;
+  for (const auto &[CSV, Slot] : Slots) {
+    auto RegisterID = ABIRegister::fromCSVName(CSV->getName(), GCBI.arch());
+    if (RegisterID == model::Register::Invalid or CSV == GCBI.spReg())
+      continue;
+
+    llvm::Type *CSVType = CSV->getType()->getPointerElementType();
+    unsigned CSVSize = CSVType->getIntegerBitWidth() / 8;
+
+    if (model::RegisterState::shouldEmit(toRegisterState(Slot.Argument)))
+      Result.Arguments.emplace_back(RegisterID, CSVSize);
+
+    if (model::RegisterState::shouldEmit(toRegisterState(Slot.ReturnValue)))
+      Result.ReturnValues.emplace_back(RegisterID, CSVSize);
+
+    // TODO: populate preserved registers and FinalStackOffset
+  }
+
+  return Result;
+}
+
+/// \brief Record in \p TheBinary a new RawFunctionType with the registers of
+///        \p Prototype
+static model::TypePath
+recordPrototype(model::Binary &TheBinary, const RawPrototype &Prototype) {
+  using namespace model;
+
+  auto NewType = makeType<RawFunctionType>();
+  auto &FunctionType = *llvm::cast<RawFunctionType>(NewType.get());
+
+  auto ToRegister = [&TheBinary](const SizedRegister &Register) {
+    const auto &[RegisterID, Size] = Register;
+    NamedTypedRegister TR(RegisterID);
+    TR.Type = { TheBinary.getPrimitiveType(PrimitiveTypeKind::Generic, Size),
+                {} };
+    return TR;
+  };
+
+  {
+    auto ArgumentsInserter = FunctionType.Arguments.batch_insert();
+    for (const SizedRegister &Register : Prototype.Arguments)
+      ArgumentsInserter.insert(ToRegister(Register));
+
+    auto ReturnValuesInserter = FunctionType.ReturnValues.batch_insert();
+    for (const SizedRegister &Register : Prototype.ReturnValues)
+      ReturnValuesInserter.insert(ToRegister(Register));
+  }
+
+  return TheBinary.recordNewType(std::move(NewType));
+}
+
+using FunctionDescription = FunctionsSummary::FunctionDescription;
+
+/// \brief Build the piece of the model describing the function \p Summary
+static void buildFunctionPiece(GeneratedCodeBasicInfo &GCBI,
+                               const FunctionDescription &Summary,
+                               NewPCCache &NewPCs,
+                               FunctionPiece &Piece) {
+  using namespace model;
+
+  model::Function &Function = Piece.Function;
+  MetaAddress EntryPC = Function.Entry;
+
+  using FT = model::FunctionType::Values;
+  Function.Type = static_cast<FT>(Summary.type());
+
+  if (Function.Type == model::FunctionType::Fake)
+    return;
+
+  Piece.Prototype = collectPrototype(GCBI, Summary.registerSlots());
+
+  auto MakeEdge = [](MetaAddress Destination, FunctionEdgeType::Values Type) {
+    if (FunctionEdgeType::isCall(Type))
+      return UpcastableFunctionEdge::make<CallEdge>(Destination, Type);
+    else
+      return UpcastableFunctionEdge::make<FunctionEdge>(Destination, Type);
+  };
+
+  // Handle the situation in which we found no basic blocks at all
+  if (Function.Type == model::FunctionType::NoReturn
+      and Summary.basicBlocks().empty()) {
+    auto &EntryNodeSuccessors = Function.CFG[EntryPC].Successors;
+    auto Edge = MakeEdge(MetaAddress::invalid(), FunctionEdgeType::LongJmp);
+    EntryNodeSuccessors.insert(Edge);
+  }
+
+  for (const auto &[BB, Branch] : Summary.basicBlocks()) {
+    // Remap BranchType to FunctionEdgeType
+    namespace FET = FunctionEdgeType;
+    FET::Values EdgeType = FET::Invalid;
+
+    switch (Branch) {
+    case BranchType::Invalid:
+    case BranchType::FakeFunction:
+    case BranchType::RegularFunction:
+    case BranchType::NoReturnFunction:
+    case BranchType::UnhandledCall:
+      revng_abort();
+      break;
+
+    case BranchType::InstructionLocalCFG:
+      EdgeType = FET::Invalid;
+      break;
+
+    case BranchType::FunctionLocalCFG:
+      EdgeType = FET::DirectBranch;
+      break;
+
+    case BranchType::FakeFunctionCall:
+      EdgeType = FET::FakeFunctionCall;
+      break;
+
+    case BranchType::FakeFunctionReturn:
+      EdgeType = FET::FakeFunctionReturn;
+      break;
+
+    case BranchType::HandledCall:
+      EdgeType = FET::FunctionCall;
+      break;
+
+    case BranchType::IndirectCall:
+      EdgeType = FET::IndirectCall;
+      break;
+
+    case BranchType::Return:
+      EdgeType = FET::Return;
+      break;
+
+    case BranchType::BrokenReturn:
+      EdgeType = FET::BrokenReturn;
+      break;
+
+    case BranchType::IndirectTailCall:
+      EdgeType = FET::IndirectTailCall;
+      break;
+
+    case BranchType::LongJmp:
+      EdgeType = FET::LongJmp;
+      break;
+
+    case BranchType::Killer:
+      EdgeType = FET::Killer;
+      break;
+
+    case BranchType::Unreachable:
+      EdgeType = FET::Unreachable;
+      break;
+    }
+
+    if (EdgeType == FET::Invalid)
+      continue;
+
+    // Identify Source address
+    auto [Source, Size] = NewPCs.getPC(BB->getTerminator());
+    Source += Size;
+    revng_assert(Source.isValid());
+
+    // Identify Destination address
+    llvm::BasicBlock *JumpTargetBB = GCBI.getJumpTargetBlock(BB);
+    MetaAddress JumpTargetAddress = GCBI.getPCFromNewPC(JumpTargetBB);
+    model::BasicBlock &CurrentBlock = Function.CFG[JumpTargetAddress];
+    CurrentBlock.End = Source;
+    auto SuccessorsInserter = CurrentBlock.Successors.batch_insert();
+
+    if (EdgeType == FET::DirectBranch) {
+      // Handle direct branch
+      auto Successors = GCBI.getSuccessors(BB);
+      for (const MetaAddress &Destination : Successors.Addresses)
+        SuccessorsInserter.insert(MakeEdge(Destination, EdgeType));
+
+    } else if (EdgeType == FET::FakeFunctionReturn) {
+      // Handle fake function return
+      auto Destinations = Summary.fakeReturns(BB);
+      revng_assert(not Destinations.empty());
+      for (const MetaAddress &Destination : Destinations)
+        SuccessorsInserter.insert(MakeEdge(Destination, EdgeType));
+
+    } else if (FunctionEdgeType::isCall(EdgeType)) {
+      // Handle call
+      llvm::BasicBlock *Successor = BB->getSingleSuccessor();
+      MetaAddress Destination = MetaAddress::invalid();
+      if (Successor != nullptr)
+        Destination = getBasicBlockPC(Successor);
+
+      // Record the edge in the CFG
+      auto TempEdge = MakeEdge(Destination, EdgeType);
+      const auto &Result = SuccessorsInserter.insert(TempEdge);
+      auto *Edge = llvm::cast<CallEdge>(Result.get());
+
+      if (Destination.isValid()) {
+        // If it's a direct call, inherit the prototype from the callee
+        Piece.DirectCalls.emplace_back(Edge, Destination);
+      } else {
+        // It's an indirect call: forge a new prototype
+        bool Found = false;
+        for (const FunctionsSummary::CallSiteDescription &CSD :
+             Summary.callSites()) {
+          llvm::Instruction *Call = CSD.call();
+          if (not Call->isTerminator() or Call->getParent() != BB)
+            continue;
+
+          revng_assert(not Found);
+          Found = true;
+          auto Prototype = collectPrototype(GCBI, CSD.registerSlots());
+          Piece.IndirectCalls.emplace_back(Edge, std::move(Prototype));
+        }
+        revng_assert(Found);
+      }
+
+    } else {
+      // Handle other successors
+      llvm::BasicBlock *Successor = BB->getSingleSuccessor();
+      MetaAddress Destination = MetaAddress::invalid();
+      if (Successor != nullptr)
+        Destination = getBasicBlockPC(Successor);
+
+      // Record the edge in the CFG
+      SuccessorsInserter.insert(MakeEdge(Destination, EdgeType));
+    }
+  }
+
+  // Identical calls in the same block are merged, only the first one survives
+  llvm::SmallPtrSet<const FunctionEdge *, 16> Edges;
+  for (const model::BasicBlock &Block : Function.CFG)
+    for (const UpcastableFunctionEdge &Edge : Block.Successors)
+      Edges.insert(Edge.get());
+
+  auto IsMerged = [&Edges](const auto &Call) {
+    return Edges.count(Call.first) == 0;
+  };
+  llvm::erase_if(Piece.DirectCalls, IsMerged);
+
+  // The prototype of a merged indirect call is recorded all the same
+  for (auto &Call : Piece.IndirectCalls)
+    if (IsMerged(Call))
+      Call.first = nullptr;
+}
+
 void commitToModel(GeneratedCodeBasicInfo &GCBI,
                    Function *F,
                    const FunctionsSummary &Summary,
+                   const std::set<MetaAddress> &Preserved,
+                   unsigned ThreadsCount,
                    model::Binary &TheBinary);
 
 void commitToModel(GeneratedCodeBasicInfo &GCBI,
                    Function *F,
                    const FunctionsSummary &Summary,
+                   const std::set<MetaAddress> &Preserved,
+                   unsigned ThreadsCount,
                    model::Binary &TheBinary) {
-  using namespace model;
-
   //
-  // Create all the model::Function
+  // Collect the functions to create
   //
-  for (const auto &[Entry, FunctionSummary] : Summary.Functions) {
+  std::vector<const FunctionDescription *> Descriptions;
+  std::vector<FunctionPiece> Pieces;
+  for (const auto &[Entry, FunctionSummary] : Summary.functions()) {
     if (Entry == nullptr)
       continue;
 
@@ -135,263 +632,134 @@ void commitToModel(GeneratedCodeBasicInfo &GCBI,
     MetaAddress EntryPC = getBasicBlockPC(Entry);
     revng_assert(EntryPC.isValid());
 
-    // Create the function
-    revng_assert(TheBinary.Functions.count(EntryPC) == 0);
-    model::Function &Function = TheBinary.Functions[EntryPC];
-
-    // Assign a name
-
-    using FT = model::FunctionType::Values;
-    Function.Type = static_cast<FT>(FunctionSummary.Type);
-
-    if (Function.Type == model::FunctionType::Fake)
+    // Keep the functions not affected by the changes to the model
+    if (Preserved.count(EntryPC) != 0)
       continue;
 
-    // Build the function prototype
-    auto NewType = makeType<RawFunctionType>();
-    auto &FunctionType = *llvm::cast<RawFunctionType>(NewType.get());
-    {
-      auto ArgumentsInserter = FunctionType.Arguments.batch_insert();
-      auto ReturnValuesInserter = FunctionType.ReturnValues.batch_insert();
-      for (auto &[CSV, FRD] : FunctionSummary.RegisterSlots) {
-        auto RegisterID = ABIRegister::fromCSVName(CSV->getName(), GCBI.arch());
-        if (RegisterID == Register::Invalid or CSV == GCBI.spReg())
-          continue;
-
-        llvm::Type *CSVType = CSV->getType()->getPointerElementType();
-        auto CSVSize = CSVType->getIntegerBitWidth() / 8;
-        NamedTypedRegister TR(RegisterID);
-        TR.Type = {
-          TheBinary.getPrimitiveType(PrimitiveTypeKind::Generic, CSVSize), {}
-        };
-
-        if (model::RegisterState::shouldEmit(toRegisterState(FRD.Argument)))
-          ArgumentsInserter.insert(TR);
-
-        if (model::RegisterState::shouldEmit(toRegisterState(FRD.ReturnValue)))
-          ReturnValuesInserter.insert(TR);
-
-        // TODO: populate preserved registers
-      }
-    }
-
-    Function.Prototype = TheBinary.recordNewType(std::move(NewType));
+    revng_assert(TheBinary.Functions.count(EntryPC) == 0);
+    Descriptions.push_back(&FunctionSummary);
+    Pieces.emplace_back(EntryPC);
   }
 
   //
-  // Populate the CFG
+  // Build each function on its own, in parallel
   //
-  for (const auto &[Entry, FunctionSummary] : Summary.Functions) {
-    if (Entry == nullptr)
-      continue;
-    MetaAddress EntryPC = getBasicBlockPC(Entry);
 
-    auto It = TheBinary.Functions.find(EntryPC);
-    if (It == TheBinary.Functions.end())
-      continue;
+  // GCBI builds the dominator tree of F lazily: do it before the threads start
+  GCBI.getJumpTargetBlock(&F->getEntryBlock());
 
-    model::Function &Function = *It;
+  std::atomic<size_t> Next(0);
+  auto Worker = [&Descriptions, &Pieces, &Next, &GCBI]() {
+    NewPCCache NewPCs;
+    for (size_t I = Next++; I < Pieces.size(); I = Next++)
+      buildFunctionPiece(GCBI, *Descriptions[I], NewPCs, Pieces[I]);
+  };
 
-    if (Function.Type == model::FunctionType::Fake)
-      continue;
+  ThreadsCount = std::min<size_t>(std::max(ThreadsCount, 1U), Pieces.size());
+  std::vector<std::thread> Threads;
+  for (unsigned I = 0; I < ThreadsCount; I++)
+    Threads.emplace_back(Worker);
 
-    auto MakeEdge = [](MetaAddress Destination, FunctionEdgeType::Values Type) {
-      FunctionEdge *Result = nullptr;
-      if (FunctionEdgeType::isCall(Type))
-        Result = new CallEdge(Destination, Type);
-      else
-        Result = new FunctionEdge(Destination, Type);
-      return UpcastablePointer<FunctionEdge>(Result);
-    };
+  for (std::thread &Thread : Threads)
+    Thread.join();
 
-    // Handle the situation in which we found no basic blocks at all
-    if (Function.Type == model::FunctionType::NoReturn
-        and FunctionSummary.BasicBlocks.size() == 0) {
-      auto &EntryNodeSuccessors = Function.CFG[EntryPC].Successors;
-      auto Edge = MakeEdge(MetaAddress::invalid(), FunctionEdgeType::LongJmp);
-      EntryNodeSuccessors.insert(Edge);
+  //
+  // Commit the pieces to the model
+  //
+
+  // Record the function prototypes first, then the ones of the indirect calls,
+  // so that the IDs of the types don't depend on the number of threads
+  for (FunctionPiece &Piece : Pieces)
+    if (Piece.Function.Type != model::FunctionType::Fake)
+      Piece.Function.Prototype = recordPrototype(TheBinary, Piece.Prototype);
+
+  for (FunctionPiece &Piece : Pieces) {
+    for (auto &[Edge, Prototype] : Piece.IndirectCalls) {
+      model::TypePath Path = recordPrototype(TheBinary, Prototype);
+      if (Edge != nullptr)
+        Edge->Prototype = Path;
     }
+  }
 
-    for (auto &[BB, Branch] : FunctionSummary.BasicBlocks) {
-      // Remap BranchType to FunctionEdgeType
-      namespace FET = FunctionEdgeType;
-      FET::Values EdgeType = FET::Invalid;
-
-      switch (Branch) {
-      case BranchType::Invalid:
-      case BranchType::FakeFunction:
-      case BranchType::RegularFunction:
-      case BranchType::NoReturnFunction:
-      case BranchType::UnhandledCall:
-        revng_abort();
-        break;
-
-      case BranchType::InstructionLocalCFG:
-        EdgeType = FET::Invalid;
-        break;
-
-      case BranchType::FunctionLocalCFG:
-        EdgeType = FET::DirectBranch;
-        break;
-
-      case BranchType::FakeFunctionCall:
-        EdgeType = FET::FakeFunctionCall;
-        break;
-
-      case BranchType::FakeFunctionReturn:
-        EdgeType = FET::FakeFunctionReturn;
-        break;
-
-      case BranchType::HandledCall:
-        EdgeType = FET::FunctionCall;
-        break;
-
-      case BranchType::IndirectCall:
-        EdgeType = FET::IndirectCall;
-        break;
-
-      case BranchType::Return:
-        EdgeType = FET::Return;
-        break;
-
-      case BranchType::BrokenReturn:
-        EdgeType = FET::BrokenReturn;
-        break;
-
-      case BranchType::IndirectTailCall:
-        EdgeType = FET::IndirectTailCall;
-        break;
-
-      case BranchType::LongJmp:
-        EdgeType = FET::LongJmp;
-        break;
-
-      case BranchType::Killer:
-        EdgeType = FET::Killer;
-        break;
-
-      case BranchType::Unreachable:
-        EdgeType = FET::Unreachable;
-        break;
-      }
+  {
+    auto FunctionsInserter = TheBinary.Functions.batch_insert();
+    FunctionsInserter.setThreads(std::max(ThreadsCount, 1U));
+    FunctionsInserter.reserve(Pieces.size());
+    for (FunctionPiece &Piece : Pieces)
+      FunctionsInserter.insert(std::move(Piece.Function));
+  }
 
-      if (EdgeType == FET::Invalid)
-        continue;
+  // Direct calls inherit the prototype from the callee
+  for (FunctionPiece &Piece : Pieces)
+    for (auto &[Edge, Destination] : Piece.DirectCalls)
+      Edge->Prototype = TheBinary.Functions.at(Destination).Prototype;
 
-      // Identify Source address
-      auto [Source, Size] = getPC(BB->getTerminator());
-      Source += Size;
-      revng_assert(Source.isValid());
-
-      // Identify Destination address
-      llvm::BasicBlock *JumpTargetBB = GCBI.getJumpTargetBlock(BB);
-      MetaAddress JumpTargetAddress = GCBI.getPCFromNewPC(JumpTargetBB);
-      model::BasicBlock &CurrentBlock = Function.CFG[JumpTargetAddress];
-      CurrentBlock.End = Source;
-      auto SuccessorsInserter = CurrentBlock.Successors.batch_insert();
-
-      if (EdgeType == FET::DirectBranch) {
-        // Handle direct branch
-        auto Successors = GCBI.getSuccessors(BB);
-        for (const MetaAddress &Destination : Successors.Addresses)
-          SuccessorsInserter.insert(MakeEdge(Destination, EdgeType));
-
-      } else if (EdgeType == FET::FakeFunctionReturn) {
-        // Handle fake function return
-        auto [First, Last] = FunctionSummary.FakeReturns.equal_range(BB);
-        revng_assert(First != Last);
-        for (const auto &[_, Destination] : make_range(First, Last))
-          SuccessorsInserter.insert(MakeEdge(Destination, EdgeType));
-
-      } else if (FunctionEdgeType::isCall(EdgeType)) {
-        // Handle call
-        llvm::BasicBlock *Successor = BB->getSingleSuccessor();
-        MetaAddress Destination = MetaAddress::invalid();
-        if (Successor != nullptr)
-          Destination = getBasicBlockPC(Successor);
-
-        // Record the edge in the CFG
-        auto TempEdge = MakeEdge(Destination, EdgeType);
-        const auto &Result = SuccessorsInserter.insert(TempEdge);
-        auto *Edge = llvm::cast<CallEdge>(Result.get());
-
-        if (Destination.isValid()) {
-          // If it's a direct call, inherit the prototype from the callee
-          model::Function &Callee = TheBinary.Functions.at(Destination);
-          Edge->Prototype = Callee.Prototype;
-        } else {
-          // It's an indirect call: forge a new prototype
-          auto NewType = makeType<RawFunctionType>();
-          auto &CallType = *llvm::cast<RawFunctionType>(NewType.get());
-          {
-            auto ArgumentsInserter = CallType.Arguments.batch_insert();
-            auto ReturnValuesInserter = CallType.ReturnValues.batch_insert();
-            bool Found = false;
-            for (const FunctionsSummary::CallSiteDescription &CSD :
-                 FunctionSummary.CallSites) {
-              if (not CSD.Call->isTerminator() or CSD.Call->getParent() != BB)
-                continue;
-
-              revng_assert(not Found);
-              Found = true;
-              for (auto &[CSV, FCRD] : CSD.RegisterSlots) {
-                auto RegisterID = ABIRegister::fromCSVName(CSV->getName(),
-                                                           GCBI.arch());
-                if (RegisterID == model::Register::Invalid
-                    or CSV == GCBI.spReg())
-                  continue;
-
-                llvm::Type *CSVType = CSV->getType()->getPointerElementType();
-                auto CSVSize = CSVType->getIntegerBitWidth() / 8;
-                NamedTypedRegister TR(RegisterID);
-                TR.Type = {
-                  TheBinary.getPrimitiveType(model::PrimitiveTypeKind::Generic,
-                                             CSVSize),
-                  {}
-                };
-
-                auto ArgumentState = toRegisterState(FCRD.Argument);
-                if (model::RegisterState::shouldEmit(ArgumentState))
-                  ArgumentsInserter.insert(TR);
-
-                auto ReturnValueState = toRegisterState(FCRD.ReturnValue);
-                if (model::RegisterState::shouldEmit(ReturnValueState))
-                  ReturnValuesInserter.insert(TR);
-
-                // TODO: populate preserved registers and FinalStackOffset
-              }
-            }
-            revng_assert(Found);
-          }
-
-          Edge->Prototype = TheBinary.recordNewType(std::move(NewType));
-        }
+  revng_check(TheBinary.verify(true));
+}
 
-      } else {
-        // Handle other successors
-        llvm::BasicBlock *Successor = BB->getSingleSuccessor();
-        MetaAddress Destination = MetaAddress::invalid();
-        if (Successor != nullptr)
-          Destination = getBasicBlockPC(Successor);
+/// \brief Collect the functions affected by the changes from \p Base to
+///        \p TheBinary
+///
+/// A function is affected if it has been added, removed or changed, or if it
+/// calls, directly or indirectly, an affected function.
+static std::set<MetaAddress>
+affectedFunctions(model::Binary &Base, model::Binary &TheBinary) {
+  std::vector<MetaAddress> WorkList;
+  for (auto [Old, New] : zipmap_range(Base.Functions, TheBinary.Functions)) {
+    if (Old == nullptr)
+      WorkList.push_back(New->Entry);
+    else if (New == nullptr or diff(*Old, *New).Changes.size() != 0)
+      WorkList.push_back(Old->Entry);
+  }
 
-        // Record the edge in the CFG
-        SuccessorsInserter.insert(MakeEdge(Destination, EdgeType));
-      }
-    }
+  // Collect the callers of each function, both before and after the changes
+  std::map<MetaAddress, std::set<MetaAddress>> Callers;
+  for (model::Binary *Binary : { &Base, &TheBinary })
+    for (const model::Function &Function : Binary->Functions)
+      for (const model::BasicBlock &Block : Function.CFG)
+        for (const auto &Edge : Block.Successors)
+          if (model::FunctionEdgeType::isCall(Edge->Type))
+            Callers[Edge->Destination].insert(Function.Entry);
+
+  std::set<MetaAddress> Result;
+  while (not WorkList.empty()) {
+    MetaAddress Entry = WorkList.back();
+    WorkList.pop_back();
+    if (not Result.insert(Entry).second)
+      continue;
+
+    for (const MetaAddress &Caller : Callers[Entry])
+      WorkList.push_back(Caller);
   }
 
-  revng_check(TheBinary.verify(true));
+  return Result;
 }
 
 bool StackAnalysis::runOnModule(Module &M) {
   Function &F = *M.getFunction("root");
 
   revng_log(PassesLog, "Starting StackAnalysis");
+  TraceScope StackAnalysisScope("StackAnalysis");
+  ProfilerRegion StackAnalysisRegion("StackAnalysis");
 
   auto &GCBI = getAnalysis<GeneratedCodeBasicInfoWrapperPass>().getGCBI();
 
   auto &LMP = getAnalysis<LoadModelWrapperPass>().get();
 
+  // Skip the analysis if the functions in the model have already been
+  // detected from this IR, unless the results are required for something
+  // else than the model
+  const model::Binary &Model = LMP.getReadOnlyModel();
+  UpToDate = not ForceAnalysis and not Model.AnalysisFingerprint.empty()
+             and BaseModelPath.getNumOccurrences() == 0
+             and ABIAnalysisOutputPath.getNumOccurrences() == 0
+             and CostReportPath.getNumOccurrences() == 0
+             and Model.AnalysisFingerprint == fingerprint(M);
+  if (UpToDate) {
+    revng_log(StackAnalysisLog, "The model is up to date, skipping");
+    return false;
+  }
+
   // The stack analysis works function-wise. We consider two sets of functions:
   // first (Force == true) those that are highly likely to be real functions
   // (i.e., they have a direct call) and then (Force == false) all the remaining
@@ -420,18 +788,19 @@ bool StackAnalysis::runOnModule(Module &M) {
     bool IsPCStore = hasReason(Reasons, JTReason::PCStore);
     bool IsReturnAddress = hasReason(Reasons, JTReason::ReturnAddress);
     bool IsLoadAddress = hasReason(Reasons, JTReason::LoadAddress);
+    bool IsLinearSweep = hasReason(Reasons, JTReason::LinearSweep);
 
     if (IsFunctionSymbol or IsCallee) {
       // Called addresses are a strong hint
       Functions.emplace_back(&BB, true);
     } else if (not IsLoadAddress
-               and (IsUnusedGlobalData
+               and (IsUnusedGlobalData || IsLinearSweep
                     || (IsMemoryStore and not IsPCStore
                         and not IsReturnAddress))) {
       // TODO: keep IsReturnAddress?
-      // Consider addresses found in global data that have not been used or
-      // addresses that are not return addresses and do not end up in the PC
-      // directly.
+      // Consider addresses found in global data that have not been used,
+      // likely function entries found by the linear sweep or addresses that
+      // are not return addresses and do not end up in the PC directly.
       Functions.emplace_back(&BB, false);
     }
   }
@@ -441,33 +810,103 @@ bool StackAnalysis::runOnModule(Module &M) {
               getName(Function.Entry) << (Function.Force ? " (forced)" : ""));
   }
 
+  model::Binary &TheBinary = *LMP.getWriteableModel();
+
+  // The functions are going to change, the fingerprint is recorded again once
+  // the IR reflects them
+  TheBinary.AnalysisFingerprint.clear();
+
+  // In incremental mode, only the functions affected by the changes to the
+  // model are analyzed again, the others are preserved as they are
+  std::set<MetaAddress> Preserved;
+  if (BaseModelPath.getNumOccurrences() == 1) {
+    auto MaybeBuffer = llvm::MemoryBuffer::getFile(BaseModelPath);
+    revng_check(MaybeBuffer, "Couldn't read the base model");
+    llvm::StringRef YAML = (*MaybeBuffer)->getBuffer();
+    auto MaybeBase = TupleTree<model::Binary>::deserialize(YAML);
+    revng_check(MaybeBase, "Couldn't parse the base model");
+
+    std::set<MetaAddress> Affected = affectedFunctions(**MaybeBase,
+                                                       TheBinary);
+
+    Functions.clear();
+    for (const model::Function &Function : TheBinary.Functions) {
+      if (Affected.count(Function.Entry) == 0) {
+        Preserved.insert(Function.Entry);
+      } else if (BasicBlock *Entry = GCBI.getBlockAt(Function.Entry)) {
+        Functions.emplace_back(Entry, true);
+      } else {
+        dbg << "Warning: there's no basic block at ";
+        Function.Entry.dump(dbg);
+        dbg << ", ignoring the function\n";
+      }
+    }
+
+    // The affected functions will be created from scratch
+    for (const MetaAddress &Entry : Affected)
+      TheBinary.Functions.erase(Entry);
+
+    revng_log(StackAnalysisLog,
+              "Analyzing " << Functions.size() << " functions, preserving "
+                           << Preserved.size());
+  }
+
   // Initialize the cache where all the results will be accumulated
   Cache TheCache(&F, &GCBI);
 
+  // Seed the cache with the types of the functions recognized by the database
+  SummaryDatabase Database(SummaryDatabasePath, M, GCBI);
+  for (CFEP &Function : Functions) {
+    switch (Database.lookup(Function.Entry)) {
+    case FunctionType::Fake:
+      TheCache.markAsFake(Function.Entry);
+      break;
+    case FunctionType::NoReturn:
+      TheCache.markAsNoReturn(Function.Entry);
+      break;
+    default:
+      break;
+    }
+  }
+
   // Pool where the final results will be collected
   ResultsPool Results;
 
+  // Loggers are not thread safe, stick to a single thread if any is enabled
+  unsigned ThreadsCount = SAThreads;
+  if (Loggers->anyEnabled())
+    ThreadsCount = 1;
+
+  EquivalenceClasses<BasicBlock *> Groups;
+  if (ThreadsCount > 1)
+    Groups = groupIndependentBlocks(F);
+
   // First analyze all the `Force`d functions (i.e., with an explicit direct
   // call)
-  for (CFEP &Function : Functions) {
-    if (Function.Force) {
-      auto &GCBI = getAnalysis<GeneratedCodeBasicInfoWrapperPass>().getGCBI();
-      InterproceduralAnalysis SA(TheCache, GCBI);
-      SA.run(Function.Entry, Results);
-    }
+  std::vector<BasicBlock *> Forced;
+  for (CFEP &Function : Functions)
+    if (Function.Force)
+      Forced.push_back(Function.Entry);
+  {
+    TraceScope Scope("Analyze forced functions");
+    analyzeFunctions(Forced, Groups, ThreadsCount, TheCache, GCBI, Results);
   }
 
   // Now analyze all the remaining candidates which are not already part of
   // another function
   std::set<BasicBlock *> Visited = Results.visitedBlocks();
-  for (CFEP &Function : Functions) {
-    if (not Function.Force and Visited.count(Function.Entry) == 0) {
-      auto &GCBI = getAnalysis<GeneratedCodeBasicInfoWrapperPass>().getGCBI();
-      InterproceduralAnalysis SA(TheCache, GCBI);
-      SA.run(Function.Entry, Results);
-    }
+  std::vector<BasicBlock *> Remaining;
+  for (CFEP &Function : Functions)
+    if (not Function.Force and Visited.count(Function.Entry) == 0)
+      Remaining.push_back(Function.Entry);
+  {
+    TraceScope Scope("Analyze remaining functions");
+    analyzeFunctions(Remaining, Groups, ThreadsCount, TheCache, GCBI, Results);
   }
 
+  // Only the summaries of the intraprocedural analyses are left
+  releaseFreedMemory();
+
   for (CFEP &Function : Functions) {
     using IFS = IntraproceduralFunctionSummary;
     BasicBlock *Entry = Function.Entry;
@@ -487,45 +926,70 @@ bool StackAnalysis::runOnModule(Module &M) {
     // Regular functions need to be composed by at least a basic block
     if (Cached) {
       const IFS *Summary = *Cached;
-      if (Type == FunctionType::Regular)
+      if (Type == FunctionType::Regular and not Summary->Degraded)
         revng_assert(Summary->BranchesType.size() != 0);
 
       Results.registerFunction(Entry, Type, Summary);
+
+      // Don't share the type of functions we gave up on
+      if (Summary->Degraded)
+        continue;
     } else {
       Results.registerFunction(Entry, Type, nullptr);
     }
+
+    Database.record(Entry, Type);
   }
 
-  GrandResult = Results.finalize(&M, &TheCache);
+  Database.store();
+
+  if (CostReportPath.getNumOccurrences() == 1)
+    CostReport::write(CostReportPath);
+
+  {
+    TraceScope Scope("Finalize results");
+    GrandResult = Results.finalize(&M, &TheCache, ThreadsCount);
+  }
 
   if (ClobberedLog.isEnabled()) {
-    for (auto &P : GrandResult.Functions) {
-      ClobberedLog << getName(P.first) << ":";
-      for (const llvm::GlobalVariable *CSV : P.second.ClobberedRegisters)
+    for (const auto &[Entry, Function] : GrandResult.functions()) {
+      ClobberedLog << getName(Entry) << ":";
+      for (const llvm::GlobalVariable *CSV : Function.clobberedRegisters())
         ClobberedLog << " " << CSV->getName().data();
       ClobberedLog << DoLog;
     }
   }
 
   if (StackAnalysisLog.isEnabled()) {
-    std::stringstream Output;
-    GrandResult.dump(&M, Output);
-    TextRepresentation = Output.str();
-    revng_log(StackAnalysisLog, TextRepresentation);
+    GrandResult.dump(&M, StackAnalysisLog);
+    StackAnalysisLog << DoLog;
   }
 
   revng_log(PassesLog, "Ending StackAnalysis");
 
   if (ABIAnalysisOutputPath.getNumOccurrences() == 1) {
     std::ofstream Output;
-    serialize(pathToStream(ABIAnalysisOutputPath, Output));
+    serialize(&M, pathToStream(ABIAnalysisOutputPath, Output));
   }
 
-  commitToModel(GCBI, &F, GrandResult, *LMP.getWriteableModel());
+  {
+    TraceScope Scope("Commit to model");
+    commitToModel(GCBI,
+                  &F,
+                  GrandResult,
+                  Preserved,
+                  ThreadsCount,
+                  TheBinary);
+  }
 
   return false;
 }
 
+void StackAnalysis::recordFingerprint(const Module &M,
+                                      model::Binary &TheBinary) {
+  TheBinary.AnalysisFingerprint = fingerprint(M);
+}
+
 void StackAnalysis::serializeMetadata(Function &F,
                                       GeneratedCodeBasicInfo &GCBI) {
   using namespace llvm;
@@ -540,11 +1004,8 @@ void StackAnalysis::serializeMetadata(Function &F,
   std::map<Instruction *, std::vector<Metadata *>> MemberOf;
 
   // Loop over all the detected functions
-  for (const auto &P : Summary.Functions) {
-    BasicBlock *Entry = P.first;
-    const FunctionsSummary::FunctionDescription &Function = P.second;
-
-    if (Entry == nullptr or Function.BasicBlocks.size() == 0)
+  for (const auto &[Entry, Function] : Summary.functions()) {
+    if (Entry == nullptr or Function.basicBlocks().empty())
       continue;
 
     MetaAddress EntryPC = getBasicBlockPC(Entry);
@@ -559,24 +1020,24 @@ void StackAnalysis::serializeMetadata(Function &F,
     //   { { csv, argument, return value }, ... }
     // }
     //
-    auto *TypeMD = QMD.get(FunctionType::getName(Function.Type));
+    auto *TypeMD = QMD.get(FunctionType::getName(Function.type()));
 
     // Clobbered registers metadata
     std::vector<Metadata *> ClobberedMDs;
-    for (GlobalVariable *ClobberedCSV : Function.ClobberedRegisters) {
+    for (GlobalVariable *ClobberedCSV : Function.clobberedRegisters()) {
       if (not GCBI.isServiceRegister(ClobberedCSV))
         ClobberedMDs.push_back(QMD.get(ClobberedCSV));
     }
 
     // Register slots metadata
     std::vector<Metadata *> SlotMDs;
-    for (auto &P : Function.RegisterSlots) {
-      if (GCBI.isServiceRegister(P.first))
+    for (const auto &[SlotCSV, FRD] : Function.registerSlots()) {
+      if (GCBI.isServiceRegister(SlotCSV))
         continue;
 
-      auto *CSV = QMD.get(P.first);
-      auto *Argument = QMD.get(P.second.Argument.valueName());
-      auto *ReturnValue = QMD.get(P.second.ReturnValue.valueName());
+      auto *CSV = QMD.get(SlotCSV);
+      auto *Argument = QMD.get(FRD.Argument.valueName());
+      auto *ReturnValue = QMD.get(FRD.ReturnValue.valueName());
       SlotMDs.push_back(QMD.tuple({ CSV, Argument, ReturnValue }));
     }
 
@@ -592,18 +1053,18 @@ void StackAnalysis::serializeMetadata(Function &F,
     // Create func.call
     //
     for (const FunctionsSummary::CallSiteDescription &CallSite :
-         Function.CallSites) {
-      Instruction *Call = CallSite.Call;
+         Function.callSites()) {
+      Instruction *Call = CallSite.call();
 
       // Register slots metadata
       std::vector<Metadata *> SlotMDs;
-      for (auto &P : CallSite.RegisterSlots) {
-        if (GCBI.isServiceRegister(P.first))
+      for (const auto &[SlotCSV, FCRD] : CallSite.registerSlots()) {
+        if (GCBI.isServiceRegister(SlotCSV))
           continue;
 
-        auto *CSV = QMD.get(P.first);
-        auto *Argument = QMD.get(P.second.Argument.valueName());
-        auto *ReturnValue = QMD.get(P.second.ReturnValue.valueName());
+        auto *CSV = QMD.get(SlotCSV);
+        auto *Argument = QMD.get(FCRD.Argument.valueName());
+        auto *ReturnValue = QMD.get(FCRD.ReturnValue.valueName());
         SlotMDs.push_back(QMD.tuple({ CSV, Argument, ReturnValue }));
       }
 
@@ -615,10 +1076,7 @@ void StackAnalysis::serializeMetadata(Function &F,
     //
 
     // Loop over all the basic blocks composing the function
-    for (const auto &P : Function.BasicBlocks) {
-      BasicBlock *BB = P.first;
-      BranchType::Values Type = P.second;
-
+    for (const auto &[BB, Type] : Function.basicBlocks()) {
       auto *Pair = QMD.tuple({ FunctionMD, QMD.get(getName(Type)) });
 
       // Register that this block is associated to this function
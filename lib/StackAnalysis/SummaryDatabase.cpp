@@ -0,0 +1,278 @@
+/// \file SummaryDatabase.cpp
+/// \brief Implementation of the persistent database of function types
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+#include <fstream>
+#include <set>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
+#include "revng/Support/Debug.h"
+#include "revng/Support/IRHelpers.h"
+
+#include "SummaryDatabase.h"
+
+using namespace llvm;
+
+static Logger<> Log("sa-summary-database");
+
+/// Bump this each time the fingerprint, or the way the function types are
+/// computed, changes in an incompatible way
+static const char *DatabaseVersion = "revng-sa-summaries 1";
+
+/// Functions larger than this are not fingerprinted
+static const size_t MaxBlocks = 1024;
+
+namespace StackAnalysis {
+
+/// \brief Load the entries of the database at \p Path in \p Entries
+///
+/// \return false if there's no database at \p Path.
+static bool load(StringRef Path, SummaryDatabase::EntriesMap &Entries) {
+  std::ifstream Input(Path.str());
+  if (not Input.good())
+    return false;
+
+  std::string Line;
+  std::getline(Input, Line);
+  if (Line != DatabaseVersion) {
+    dbg << "Warning: ignoring " << Path.str() << ", unexpected version\n";
+    return true;
+  }
+
+  SummaryDatabase::EntriesMap Loaded;
+  while (std::getline(Input, Line)) {
+    auto [Hash, TypeName] = StringRef(Line).split(',');
+    if (TypeName != "Regular" and TypeName != "NoReturn"
+        and TypeName != "Fake") {
+      dbg << "Warning: ignoring malformed entries in " << Path.str() << "\n";
+      return true;
+    }
+
+    Loaded[Hash.str()] = FunctionType::fromName(TypeName);
+  }
+
+  Entries.merge(Loaded);
+  return true;
+}
+
+SummaryDatabase::SummaryDatabase(StringRef Path,
+                                 Module &M,
+                                 GeneratedCodeBasicInfo &GCBI) :
+  Path(Path), GCBI(GCBI) {
+  if (not enabled())
+    return;
+
+  // Collect the segments emitted by revng-lift, i.e., o_<flags>_0x<address>
+  for (GlobalVariable &Segment : M.globals()) {
+    StringRef Name = Segment.getName();
+    if (not Name.startswith("o_") or not Segment.hasInitializer())
+      continue;
+
+    size_t Position = Name.find("_0x");
+    uint64_t Start = 0;
+    if (Position == StringRef::npos
+        or Name.substr(Position + 3).getAsInteger(16, Start))
+      continue;
+
+    // Zero-filled portions might be a separate element of a struct
+    Constant *Initializer = Segment.getInitializer();
+    if (auto *Struct = dyn_cast<ConstantStruct>(Initializer))
+      Initializer = Struct->getOperand(0);
+
+    if (auto *Data = dyn_cast<ConstantDataSequential>(Initializer))
+      Segments.emplace_back(Start, Data->getRawDataValues());
+  }
+  std::sort(Segments.begin(), Segments.end());
+
+  if (not load(this->Path, Entries))
+    revng_log(Log, "Starting a new database at " << this->Path);
+
+  revng_log(Log, "Loaded " << Entries.size() << " entries");
+}
+
+bool SummaryDatabase::isAddress(uint64_t Address) const {
+  for (const auto &[Start, Data] : Segments)
+    if (Start <= Address and Address < Start + Data.size())
+      return true;
+  return false;
+}
+
+Optional<StringRef> SummaryDatabase::read(uint64_t Address,
+                                          uint64_t Size) const {
+  for (const auto &[Start, Data] : Segments)
+    if (Start <= Address and Address + Size <= Start + Data.size())
+      return Data.substr(Address - Start, Size);
+  return None;
+}
+
+Optional<std::string> SummaryDatabase::fingerprint(BasicBlock *Entry) const {
+  // Collect all the instructions reachable from the entry without leaving the
+  // function
+  std::map<uint64_t, uint64_t> Instructions;
+  std::set<BasicBlock *> Visited;
+  std::vector<BasicBlock *> WorkList{ Entry };
+  while (not WorkList.empty()) {
+    BasicBlock *BB = WorkList.back();
+    WorkList.pop_back();
+    if (not Visited.insert(BB).second)
+      continue;
+
+    // Only leaf functions with a reasonable size are considered
+    if (Visited.size() > MaxBlocks or isFunctionCall(BB))
+      return None;
+
+    for (Instruction &I : *BB) {
+      Value *PC = getNewPCArgument(&I, 0);
+      if (PC == nullptr)
+        continue;
+
+      MetaAddress Address = MetaAddress::fromConstant(PC);
+      if (not Address.isValid())
+        return None;
+      Value *Size = getNewPCArgument(&I, 1);
+      Instructions[Address.address()] = getLimitedValue(Size);
+    }
+
+    for (BasicBlock *Successor : successors(BB)) {
+      switch (GeneratedCodeBasicInfo::getType(Successor)) {
+      case BlockType::JumpTargetBlock:
+      case BlockType::TranslatedBlock:
+        WorkList.push_back(Successor);
+        break;
+
+      case BlockType::IndirectBranchDispatcherHelperBlock:
+        // We can't tell the targets of the indirect jump
+        return None;
+
+      default:
+        // Returns and jumps to the dispatchers
+        break;
+      }
+    }
+  }
+
+  uint64_t EntryAddress = getBasicBlockPC(Entry).address();
+
+  SHA1 Hasher;
+  Hasher.update(DatabaseVersion);
+  Hasher.update(Triple::getArchTypeName(GCBI.arch()));
+
+  for (const auto &[Address, Size] : Instructions) {
+    auto MaybeBytes = read(Address, Size);
+    if (not MaybeBytes)
+      return None;
+
+    SmallVector<uint8_t, 16> Bytes(MaybeBytes->bytes_begin(),
+                                   MaybeBytes->bytes_end());
+
+    // Mask the operands pointing into the binary. The first byte is never
+    // considered, it's always part of the opcode.
+    uint64_t End = Address + Size;
+    for (uint64_t Offset = 1; Offset < Size; ++Offset) {
+      uint8_t *Operand = Bytes.data() + Offset;
+      if (Offset + 8 <= Size
+          and isAddress(support::endian::read64le(Operand))) {
+        std::fill(Operand, Operand + 8, 0);
+        Offset += 7;
+      } else if (Offset + 4 <= Size) {
+        uint32_t Value = support::endian::read32le(Operand);
+        int64_t Displacement = static_cast<int32_t>(Value);
+        if (isAddress(Value) or isAddress(End + Displacement)) {
+          std::fill(Operand, Operand + 4, 0);
+          Offset += 3;
+        }
+      }
+    }
+
+    uint8_t Header[16];
+    support::endian::write64le(Header, Address - EntryAddress);
+    support::endian::write64le(Header + 8, Size);
+    Hasher.update(Header);
+    Hasher.update(Bytes);
+  }
+
+  return toHex(Hasher.final(), true);
+}
+
+FunctionType::Values SummaryDatabase::lookup(BasicBlock *Entry) const {
+  if (not enabled() or Entries.empty())
+    return FunctionType::Invalid;
+
+  auto MaybeHash = fingerprint(Entry);
+  if (not MaybeHash)
+    return FunctionType::Invalid;
+
+  auto It = Entries.find(*MaybeHash);
+  if (It == Entries.end())
+    return FunctionType::Invalid;
+
+  revng_log(Log,
+            getName(Entry) << " is " << FunctionType::getName(It->second));
+  return It->second;
+}
+
+void SummaryDatabase::record(BasicBlock *Entry, FunctionType::Values Type) {
+  if (not enabled())
+    return;
+
+  auto MaybeHash = fingerprint(Entry);
+  if (not MaybeHash)
+    return;
+
+  auto &Recorded = Entries[*MaybeHash];
+  Changed = Changed or Recorded != Type;
+  Recorded = Type;
+}
+
+void SummaryDatabase::store() const {
+  if (not enabled() or not Changed)
+    return;
+
+  // Write to a temporary file and then move it in place, so that concurrent
+  // runs never see a partial database
+  int FD = -1;
+  SmallString<128> TemporaryPath;
+  std::error_code EC = sys::fs::createUniqueFile(Path + ".%%%%%%%%",
+                                                 FD,
+                                                 TemporaryPath);
+  if (EC) {
+    dbg << "Warning: couldn't create a temporary file for " << Path << "\n";
+    return;
+  }
+
+  // Other runs, possibly on other machines sharing the database, might have
+  // stored new entries in the meantime: keep them, unless we disagree
+  EntriesMap Merged = Entries;
+  load(Path, Merged);
+
+  {
+    raw_fd_ostream Output(FD, true);
+    Output << DatabaseVersion << "\n";
+    for (const auto &[Hash, Type] : Merged)
+      Output << Hash << "," << FunctionType::getName(Type) << "\n";
+  }
+
+  EC = sys::fs::rename(TemporaryPath, Path);
+  if (EC) {
+    dbg << "Warning: couldn't store " << Path << "\n";
+    sys::fs::remove(TemporaryPath);
+  }
+
+  revng_log(Log, "Stored " << Merged.size() << " entries");
+}
+
+} // namespace StackAnalysis
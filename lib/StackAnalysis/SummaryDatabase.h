@@ -0,0 +1,80 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/StringRef.h"
+
+#include "revng/StackAnalysis/FunctionsSummary.h"
+
+namespace llvm {
+class BasicBlock;
+class Module;
+} // namespace llvm
+
+class GeneratedCodeBasicInfo;
+
+namespace StackAnalysis {
+
+/// \brief Persistent database of function types shared across binaries
+///
+/// Functions are identified by a fingerprint of their code: a hash of the
+/// input architecture and of the bytes of all the instructions reachable from
+/// the entry, along with their offset from the entry. Within each instruction,
+/// 32- and 64-bit operands that look like an absolute or PC-relative address
+/// of the binary are zeroed, so that the same function linked at different
+/// addresses, or in different programs, gets the same fingerprint.
+///
+/// For each fingerprint the database records the type of the function (fake,
+/// noreturn or regular) found by a previous run of the analysis. Since the
+/// type of a function depends on the functions it calls, the database only
+/// covers leaf functions.
+class SummaryDatabase {
+public:
+  using EntriesMap = std::map<std::string, FunctionType::Values>;
+
+private:
+  /// Start address and content of the segments of the input binary
+  using SegmentsVector = std::vector<std::pair<uint64_t, llvm::StringRef>>;
+
+private:
+  std::string Path;
+  GeneratedCodeBasicInfo &GCBI;
+  SegmentsVector Segments;
+  EntriesMap Entries;
+  bool Changed = false;
+
+public:
+  /// \param Path the path of the database. If empty, the database is
+  ///        disabled.
+  SummaryDatabase(llvm::StringRef Path,
+                  llvm::Module &M,
+                  GeneratedCodeBasicInfo &GCBI);
+
+public:
+  bool enabled() const { return not Path.empty(); }
+
+  /// \return the type recorded for a function with the same code as the one
+  ///         starting at \p Entry, or FunctionType::Invalid.
+  FunctionType::Values lookup(llvm::BasicBlock *Entry) const;
+
+  /// \brief Record the type of the function starting at \p Entry
+  void record(llvm::BasicBlock *Entry, FunctionType::Values Type);
+
+  /// \brief Write the database back, if anything has been recorded
+  void store() const;
+
+private:
+  llvm::Optional<std::string> fingerprint(llvm::BasicBlock *Entry) const;
+  bool isAddress(uint64_t Address) const;
+  llvm::Optional<llvm::StringRef> read(uint64_t Address, uint64_t Size) const;
+};
+
+} // namespace StackAnalysis
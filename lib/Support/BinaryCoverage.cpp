@@ -0,0 +1,209 @@
+/// \file BinaryCoverage.cpp
+/// \brief Implementation of the binary coverage writer and reader.
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+#include <system_error>
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/EndianStream.h"
+#include "llvm/Support/FileSystem.h"
+
+#include "revng/Support/BinaryCoverage.h"
+
+using namespace llvm;
+using namespace llvm::support;
+
+namespace BinaryCoverage {
+
+static void writeAddress(endian::Writer &W, const MetaAddress &Address) {
+  W.write<uint32_t>(Address.epoch());
+  W.write<uint16_t>(Address.addressSpace());
+  W.write<uint16_t>(static_cast<uint16_t>(Address.type()));
+}
+
+static MetaAddress readAddress(uint64_t Address, const uint8_t *Tail) {
+  auto Type = static_cast<MetaAddressType::Values>(endian::read16le(Tail + 6));
+  return MetaAddress(Address,
+                     Type,
+                     endian::read32le(Tail),
+                     endian::read16le(Tail + 4));
+}
+
+void Writer::write(raw_ostream &Output) {
+  auto Compare = [](const Instruction &LHS, const Instruction &RHS) {
+    return LHS.Address < RHS.Address;
+  };
+  llvm::sort(Instructions, Compare);
+
+  endian::Writer W(Output, little);
+
+  // Header
+  W.write<uint64_t>(Magic);
+  W.write<uint32_t>(Version);
+  W.write<uint32_t>(RecordSize);
+  W.write<uint64_t>(Instructions.size());
+  W.write<uint64_t>(Segments.size());
+
+  // Records
+  for (const Instruction &I : Instructions) {
+    W.write<uint64_t>(I.Address.address());
+    W.write<uint64_t>(I.Size);
+    writeAddress(W, I.Address);
+    W.write<uint8_t>(I.IsJumpTarget ? 1 : 0);
+    Output.write_zeros(7);
+  }
+
+  // Bitmaps
+  std::vector<uint64_t> Words;
+  for (const Segment &S : Segments) {
+    W.write<uint64_t>(S.Start.address());
+    W.write<uint64_t>(S.Size);
+    writeAddress(W, S.Start);
+    Output.write_zeros(8);
+
+    Words.assign((S.Size + 63) / 64, 0);
+    for (const Instruction &I : Instructions) {
+      if (not S.Start.addressIsComparableWith(I.Address))
+        continue;
+
+      uint64_t Offset = I.Address.address() - S.Start.address();
+      if (Offset >= S.Size)
+        continue;
+
+      uint64_t End = Offset + std::min(I.Size, S.Size - Offset);
+      for (uint64_t Byte = Offset; Byte < End; ++Byte)
+        Words[Byte / 64] |= uint64_t(1) << (Byte % 64);
+    }
+
+    for (uint64_t Word : Words)
+      W.write<uint64_t>(Word);
+  }
+}
+
+std::error_code Writer::write(StringRef Path) {
+  std::error_code EC;
+  raw_fd_ostream Output(Path, EC, sys::fs::OF_None);
+  if (EC)
+    return EC;
+
+  write(Output);
+  Output.close();
+  return Output.error();
+}
+
+ErrorOr<Reader> Reader::open(StringRef Path) {
+  auto MaybeBuffer = MemoryBuffer::getFile(Path, -1, false);
+  if (not MaybeBuffer)
+    return MaybeBuffer.getError();
+
+  return fromBuffer(std::move(*MaybeBuffer));
+}
+
+ErrorOr<Reader> Reader::fromBuffer(std::unique_ptr<MemoryBuffer> Buffer) {
+  auto Invalid = std::make_error_code(std::errc::illegal_byte_sequence);
+
+  auto *Data = reinterpret_cast<const uint8_t *>(Buffer->getBufferStart());
+  uint64_t Available = Buffer->getBufferSize();
+
+  // Header
+  if (Available < HeaderSize)
+    return Invalid;
+
+  if (endian::read64le(Data) != Magic
+      or endian::read32le(Data + 8) != Version)
+    return Invalid;
+
+  // Records might have been extended with new fields, skip them
+  uint32_t Stride = endian::read32le(Data + 12);
+  if (Stride < RecordSize or Stride % 8 != 0)
+    return Invalid;
+
+  uint64_t RecordsCount = endian::read64le(Data + 16);
+  uint64_t BitmapsCount = endian::read64le(Data + 24);
+  Data += HeaderSize;
+  Available -= HeaderSize;
+
+  if (RecordsCount > Available / Stride)
+    return Invalid;
+
+  Reader Result;
+  Result.Records = Data;
+  Result.RecordsCount = RecordsCount;
+  Result.Stride = Stride;
+  Data += RecordsCount * Stride;
+  Available -= RecordsCount * Stride;
+
+  // Bitmaps
+  for (uint64_t I = 0; I < BitmapsCount; ++I) {
+    if (Available < BitmapHeaderSize)
+      return Invalid;
+
+    MetaAddress Start = readAddress(endian::read64le(Data), Data + 16);
+    uint64_t Size = endian::read64le(Data + 8);
+    Data += BitmapHeaderSize;
+    Available -= BitmapHeaderSize;
+
+    uint64_t Words = Size / 64 + (Size % 64 != 0 ? 1 : 0);
+    if (Start.isInvalid() or Words > Available / 8)
+      return Invalid;
+
+    Result.Bitmaps.push_back({ Start, Size, Data });
+    Data += Words * 8;
+    Available -= Words * 8;
+  }
+
+  Result.Buffer = std::move(Buffer);
+  return Result;
+}
+
+Instruction Reader::operator[](size_t Index) const {
+  revng_assert(Index < RecordsCount);
+  const uint8_t *Record = Records + Index * Stride;
+  return { readAddress(endian::read64le(Record), Record + 16),
+           endian::read64le(Record + 8),
+           Record[24] != 0 };
+}
+
+Optional<Instruction> Reader::find(const MetaAddress &Address) const {
+  // Find the last record starting at or before Address
+  size_t Low = 0;
+  size_t High = RecordsCount;
+  while (Low < High) {
+    size_t Middle = Low + (High - Low) / 2;
+    if ((*this)[Middle].Address <= Address)
+      Low = Middle + 1;
+    else
+      High = Middle;
+  }
+
+  if (Low == 0)
+    return None;
+
+  Instruction Candidate = (*this)[Low - 1];
+  if (not Candidate.contains(Address))
+    return None;
+
+  return Candidate;
+}
+
+bool Reader::isCovered(const MetaAddress &Address) const {
+  for (const Bitmap &B : Bitmaps) {
+    if (not B.Start.addressIsComparableWith(Address))
+      continue;
+
+    uint64_t Offset = Address.address() - B.Start.address();
+    if (Offset < B.Size) {
+      uint64_t Word = endian::read64le(B.Bits + (Offset / 64) * 8);
+      return ((Word >> (Offset % 64)) & 1) != 0;
+    }
+  }
+
+  return find(Address).hasValue();
+}
+
+} // namespace BinaryCoverage
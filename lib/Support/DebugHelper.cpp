@@ -5,9 +5,15 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <string>
+#include <thread>
+#include <vector>
 
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/AssemblyAnnotationWriter.h"
 #include "llvm/IR/DIBuilder.h"
 #include "llvm/IR/Instruction.h"
@@ -21,9 +27,23 @@
 
 using namespace llvm;
 
+static cl::opt<unsigned> AnnotationThreads("debug-info-threads",
+                                           cl::init(1),
+                                           cl::desc("number of threads "
+                                                    "collecting the original "
+                                                    "assembly and the PTC to "
+                                                    "print as comments"),
+                                           cl::value_desc("threads"),
+                                           cl::cat(MainCategory));
+
 /// Boring code to get the text of the metadata with the specified kind
 /// associated to the given instruction
-static StringRef getText(const Instruction *Instruction, unsigned Kind) {
+///
+/// \param Strings if not nullptr, the side file containing the strings
+///        referenced by identifier.
+static StringRef getText(const Instruction *Instruction,
+                         unsigned Kind,
+                         const DebugStrings::Reader *Strings) {
   revng_assert(Instruction != nullptr);
 
   Metadata *MD = Instruction->getMetadata(Kind);
@@ -45,6 +65,13 @@ static StringRef getText(const Instruction *Instruction, unsigned Kind) {
   if (auto *String = dyn_cast<MDString>(MDOperand)) {
     return String->getString();
   } else if (auto *CAM = dyn_cast<ConstantAsMetadata>(MDOperand)) {
+    // The string has been moved to the side file
+    if (auto *Identifier = dyn_cast<ConstantInt>(CAM->getValue())) {
+      if (Strings == nullptr)
+        return StringRef();
+      return Strings->get(Identifier->getLimitedValue());
+    }
+
     auto *Cast = cast<ConstantExpr>(CAM->getValue());
     auto *GV = cast<GlobalVariable>(Cast->getOperand(0));
     auto *Initializer = GV->getInitializer();
@@ -66,31 +93,34 @@ replaceAll(std::string &Input, const std::string &From, const std::string &To) {
   }
 }
 
-/// Writes the text contained in the metadata with the specified kind ID to the
-/// output stream, unless that metadata is exactly the same as in the previous
-/// instruction.
-static void writeMetadataIfNew(const Instruction *TheInstruction,
-                               unsigned MDKind,
-                               formatted_raw_ostream &Output,
-                               StringRef Prefix) {
-  auto BeginIt = TheInstruction->getParent()->begin();
-  StringRef Text = getText(TheInstruction, MDKind);
-  if (Text.size()) {
-    StringRef LastText;
-
-    do {
-      if (TheInstruction->getIterator() == BeginIt) {
-        TheInstruction = nullptr;
-      } else {
-        TheInstruction = TheInstruction->getPrevNode();
-        LastText = getText(TheInstruction, MDKind);
+/// \brief Collect the comments to print before the instructions of \p F
+///
+/// Before each instruction, the text of the metadata of each kind in
+/// \p MDKinds is printed, unless it's exactly the same as in the last
+/// instruction of the block having it.
+static void collectAnnotations(const Function &F,
+                               ArrayRef<unsigned> MDKinds,
+                               const DebugStrings::Reader *Strings,
+                               InstructionAnnotations &Result) {
+  SmallVector<StringRef, 2> LastTexts(MDKinds.size());
+  for (const BasicBlock &Block : F) {
+    std::fill(LastTexts.begin(), LastTexts.end(), StringRef());
+
+    for (const Instruction &I : Block) {
+      std::string Annotation;
+      for (unsigned Index = 0; Index < MDKinds.size(); ++Index) {
+        StringRef Text = getText(&I, MDKinds[Index], Strings);
+        if (Text.size() == 0 or Text == LastTexts[Index])
+          continue;
+
+        LastTexts[Index] = Text;
+        std::string TextToSerialize = Text.str();
+        replaceAll(TextToSerialize, "\n", " ");
+        Annotation += "\n  ; " + TextToSerialize + "\n";
       }
-    } while (TheInstruction != nullptr && LastText.size() == 0);
 
-    if (TheInstruction == nullptr or LastText != Text) {
-      std::string TextToSerialize = Text.str();
-      replaceAll(TextToSerialize, "\n", " ");
-      Output << Prefix << TextToSerialize << "\n";
+      if (not Annotation.empty())
+        Result[&I] = std::move(Annotation);
     }
   }
 }
@@ -105,10 +135,10 @@ static void addModuleFlag(Module *TheModule, StringRef Flag, uint32_t Value) {
 
 using DAW = DebugAnnotationWriter;
 
-DAW::DebugAnnotationWriter(LLVMContext &Context, bool DebugInfo) :
-  Context(Context), DebugInfo(DebugInfo) {
-  OriginalInstrMDKind = Context.getMDKindID("oi");
-  PTCInstrMDKind = Context.getMDKindID("pi");
+DAW::DebugAnnotationWriter(LLVMContext &Context,
+                           bool DebugInfo,
+                           const InstructionAnnotations &Annotations) :
+  Context(Context), Annotations(Annotations), DebugInfo(DebugInfo) {
   DbgMDKind = Context.getMDKindID("dbg");
 }
 
@@ -127,8 +157,9 @@ void DAW::emitInstructionAnnot(const Instruction *Instr,
   if (Subprogram == nullptr or not isRootOrLifted(F))
     return;
 
-  writeMetadataIfNew(Instr, OriginalInstrMDKind, Output, "\n  ; ");
-  writeMetadataIfNew(Instr, PTCInstrMDKind, Output, "\n  ; ");
+  auto It = Annotations.find(Instr);
+  if (It != Annotations.end())
+    Output << It->second;
 
   if (DebugInfo) {
     // If DebugInfo is activated the generated LLVM IR textual representation
@@ -151,6 +182,10 @@ void DAW::emitInstructionAnnot(const Instruction *Instr,
   }
 }
 
+static bool isBitcode(StringRef Path) {
+  return Path.endswith(".bc");
+}
+
 DebugHelper::DebugHelper(std::string Output,
                          Module *TheModule,
                          DebugInfoType::Values DebugInfo,
@@ -171,6 +206,8 @@ DebugHelper::DebugHelper(std::string Output,
       this->DebugPath = OutputPath + ".ptc";
     else if (DebugInfo == DebugInfoType::OriginalAssembly)
       this->DebugPath = OutputPath + ".S";
+    else if (DebugInfo == DebugInfoType::LLVMIR and isBitcode(OutputPath))
+      this->DebugPath = OutputPath + ".ll";
     else if (DebugInfo == DebugInfoType::LLVMIR)
       this->DebugPath = OutputPath;
   }
@@ -238,11 +275,11 @@ void DebugHelper::generateDebugInfo() {
       if (DISubprogram *CurrentSubprogram = F.getSubprogram()) {
         for (BasicBlock &Block : F) {
           for (Instruction &Instruction : Block) {
-            StringRef Body = getText(&Instruction, MetadataKind);
+            StringRef Body = getText(&Instruction, MetadataKind, strings());
 
             if (Body.size() != 0 && Last != Body) {
               Last = Body;
-              Source << Body.data();
+              Source.write(Body.data(), Body.size());
 
               auto *Location = DILocation::get(TheModule->getContext(),
                                                LineIndex,
@@ -296,7 +333,52 @@ bool DebugHelper::copySource() {
   return false;
 }
 
+void DebugHelper::loadStrings(StringRef Path) {
+  auto MaybeStrings = DebugStrings::Reader::open(Path);
+  revng_check(MaybeStrings, "Couldn't load the debug strings");
+  Strings = std::move(*MaybeStrings);
+}
+
 DAW *DebugHelper::annotator(bool DebugInfo) {
-  Annotator.reset(new DAW(TheModule->getContext(), DebugInfo));
+  LLVMContext &Context = TheModule->getContext();
+  Annotator.reset(new DAW(Context, DebugInfo, annotations()));
   return Annotator.get();
 }
+
+const InstructionAnnotations &DebugHelper::annotations() {
+  if (Annotations)
+    return *Annotations;
+
+  // Only the functions with a subprogram are annotated
+  std::vector<const Function *> Functions;
+  for (const Function &F : TheModule->functions())
+    if (F.getSubprogram() != nullptr and isRootOrLifted(&F))
+      Functions.push_back(&F);
+
+  // Reading the metadata does not change the module, each thread collects the
+  // annotations of a subset of the functions
+  unsigned Count = std::max<size_t>(std::min<size_t>(AnnotationThreads,
+                                                     Functions.size()),
+                                    1);
+  std::vector<InstructionAnnotations> Partial(Count);
+  std::atomic<size_t> Next(0);
+  unsigned MDKinds[] = { OriginalInstrMDKind, PTCInstrMDKind };
+  auto Worker = [&](InstructionAnnotations &Result) {
+    for (size_t I = Next++; I < Functions.size(); I = Next++)
+      collectAnnotations(*Functions[I], MDKinds, strings(), Result);
+  };
+
+  std::vector<std::thread> Threads;
+  for (unsigned I = 1; I < Count; ++I)
+    Threads.emplace_back(Worker, std::ref(Partial[I]));
+  Worker(Partial[0]);
+  for (std::thread &Thread : Threads)
+    Thread.join();
+
+  Annotations = std::move(Partial[0]);
+  for (unsigned I = 1; I < Count; ++I)
+    for (auto &[Instruction, Annotation] : Partial[I])
+      (*Annotations)[Instruction] = std::move(Annotation);
+
+  return *Annotations;
+}
@@ -0,0 +1,100 @@
+/// \file DebugStrings.cpp
+/// \brief Implementation of the debug strings side file.
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/EndianStream.h"
+#include "llvm/Support/FileSystem.h"
+
+#include "revng/Support/DebugStrings.h"
+
+using namespace llvm;
+using namespace llvm::support;
+
+namespace DebugStrings {
+
+void Writer::write(raw_ostream &Output) const {
+  endian::Writer W(Output, little);
+
+  W.write<uint64_t>(Magic);
+  W.write<uint32_t>(Version);
+  W.write<uint32_t>(0);
+  W.write<uint64_t>(Offsets.size());
+
+  for (uint64_t Offset : Offsets)
+    W.write<uint64_t>(Offset);
+  W.write<uint64_t>(Content.size());
+
+  Output << Content;
+}
+
+std::error_code Writer::write(StringRef Path) const {
+  std::error_code EC;
+  raw_fd_ostream Output(Path, EC, sys::fs::OF_None);
+  if (EC)
+    return EC;
+
+  write(Output);
+  Output.close();
+  return Output.error();
+}
+
+ErrorOr<Reader> Reader::open(StringRef Path) {
+  auto MaybeBuffer = MemoryBuffer::getFile(Path, -1, false);
+  if (not MaybeBuffer)
+    return MaybeBuffer.getError();
+
+  return fromBuffer(std::move(*MaybeBuffer));
+}
+
+ErrorOr<Reader> Reader::fromBuffer(std::unique_ptr<MemoryBuffer> Buffer) {
+  auto Invalid = std::make_error_code(std::errc::illegal_byte_sequence);
+
+  auto *Data = reinterpret_cast<const uint8_t *>(Buffer->getBufferStart());
+  uint64_t Available = Buffer->getBufferSize();
+
+  if (Available < HeaderSize)
+    return Invalid;
+
+  if (endian::read64le(Data) != Magic
+      or endian::read32le(Data + 8) != Version)
+    return Invalid;
+
+  uint64_t Count = endian::read64le(Data + 16);
+  Data += HeaderSize;
+  Available -= HeaderSize;
+
+  if (Count >= Available / 8)
+    return Invalid;
+
+  // Offsets have to be monotonic and within the content
+  uint64_t ContentSize = Available - (Count + 1) * 8;
+  uint64_t Last = 0;
+  for (uint64_t I = 0; I <= Count; ++I) {
+    uint64_t Offset = endian::read64le(Data + I * 8);
+    if (Offset < Last or Offset > ContentSize)
+      return Invalid;
+    Last = Offset;
+  }
+
+  Reader Result;
+  Result.Offsets = Data;
+  Result.Content = reinterpret_cast<const char *>(Data + (Count + 1) * 8);
+  Result.Count = Count;
+  Result.Buffer = std::move(Buffer);
+  return Result;
+}
+
+StringRef Reader::get(uint64_t Identifier) const {
+  if (Identifier >= Count)
+    return StringRef();
+
+  uint64_t Start = endian::read64le(Offsets + Identifier * 8);
+  uint64_t End = endian::read64le(Offsets + (Identifier + 1) * 8);
+  return StringRef(Content + Start, End - Start);
+}
+
+} // namespace DebugStrings
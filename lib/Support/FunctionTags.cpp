@@ -5,9 +5,10 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
-#include <map>
+#include <algorithm>
 
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/InstrTypes.h"
 #include "llvm/IR/Metadata.h"
@@ -31,10 +32,20 @@ Tag FunctionDispatcher("FunctionDispatcher");
 Tag Root("Root");
 Tag CSVsAsArgumentsWrapper("CSVsAsArgumentsWrapper");
 Tag Marker("Marker");
+Tag IndirectPlaceholder("IndirectPlaceholder");
 
 static const char *TagsMetadataName = "revng.tags";
 
-static ManagedStatic<std::map<StringRef, Tag *>> Registry;
+namespace {
+
+struct TagsRegistry {
+  StringMap<Tag *> ByName;
+  std::vector<Tag *> ByID;
+};
+
+} // namespace
+
+static ManagedStatic<TagsRegistry> Registry;
 
 template<typename T>
 static llvm::MDNode *getMetadata(T *V) {
@@ -62,10 +73,17 @@ static void append(T *V, StringRef Name) {
   V->setMetadata(TagsMetadataName, MDTuple::get(C, Tags));
 }
 
-Tag::Tag(StringRef Name) : Name(Name) {
-  revng_check(Registry->count(Name) == 0,
+Tag::Tag(StringRef Name) : Name(Name), ID(Registry->ByID.size()) {
+  revng_check(Registry->ByName.count(Name) == 0,
               "Tag with the same name already registered");
-  (*Registry)[Name] = this;
+  revng_check(ID < MaxTags, "Too many tags registered");
+  Registry->ByName[Name] = this;
+  Registry->ByID.push_back(this);
+}
+
+const Tag &Tag::fromID(unsigned ID) {
+  revng_assert(ID < Registry->ByID.size());
+  return *Registry->ByID[ID];
 }
 
 void Tag::addTo(Instruction *I) const {
@@ -84,14 +102,22 @@ TagsSet TagsSet::from(const MDNode *MD) {
 
   for (const MDOperand &Op : cast<MDTuple>(MD)->operands()) {
     StringRef Name = cast<MDString>(Op.get())->getString();
-    auto It = Registry->find(Name);
-    if (It != Registry->end())
-      Result.Tags.insert(It->second);
+    auto It = Registry->ByName.find(Name);
+    if (It != Registry->ByName.end())
+      Result.insert(It->second);
   }
 
   return Result;
 }
 
+SmallVector<const Tag *, 4> TagsSet::tags() const {
+  SmallVector<const Tag *, 4> Result;
+  for (unsigned ID = 0; ID < MaxTags; ++ID)
+    if (Tags.test(ID))
+      Result.push_back(&Tag::fromID(ID));
+  return Result;
+}
+
 TagsSet TagsSet::from(const Instruction *I) {
   return from(getMetadata(I));
 }
@@ -100,4 +126,65 @@ TagsSet TagsSet::from(const GlobalObject *G) {
   return from(getMetadata(G));
 }
 
+static void eraseObject(std::vector<GlobalObject *> &Objects, GlobalObject *G) {
+  Objects.erase(std::remove(Objects.begin(), Objects.end(), G), Objects.end());
+}
+
+TagsIndex::TagsIndex(Module &M) {
+  auto Record = [this](GlobalObject &G) {
+    TagsSet Set = TagsSet::from(&G);
+    if (Set.empty())
+      return;
+
+    Tags[&G] = Set;
+    for (const Tag *T : Set.tags())
+      Objects[T->id()].push_back(&G);
+  };
+
+  for (Function &F : M)
+    Record(F);
+
+  for (GlobalVariable &G : M.globals())
+    Record(G);
+}
+
+void TagsIndex::add(const Tag &T, GlobalObject *G) {
+  T.addTo(G);
+
+  TagsSet &Set = Tags[G];
+  if (Set.contains(T))
+    return;
+
+  Set.insert(&T);
+  Objects[T.id()].push_back(G);
+}
+
+void TagsIndex::update(GlobalObject *G) {
+  TagsSet Set = TagsSet::from(G);
+  TagsSet Old = tags(G);
+  for (const Tag *T : Set.tags())
+    if (not Old.contains(*T))
+      Objects[T->id()].push_back(G);
+
+  for (const Tag *T : Old.tags())
+    if (not Set.contains(*T))
+      eraseObject(Objects[T->id()], G);
+
+  if (Set.empty())
+    Tags.erase(G);
+  else
+    Tags[G] = Set;
+}
+
+void TagsIndex::forget(GlobalObject *G) {
+  auto It = Tags.find(G);
+  if (It == Tags.end())
+    return;
+
+  for (const Tag *T : It->second.tags())
+    eraseObject(Objects[T->id()], G);
+
+  Tags.erase(It);
+}
+
 } // namespace FunctionTags
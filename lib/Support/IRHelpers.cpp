@@ -72,6 +72,16 @@ Constant *getUniqueString(Module *M,
   return ConstantExpr::getBitCast(NewVariable, Int8PtrTy);
 }
 
+static std::pair<MetaAddress, uint64_t> toPC(CallInst *NewPCCall) {
+  if (NewPCCall == nullptr)
+    return { MetaAddress::invalid(), 0 };
+
+  auto PC = MetaAddress::fromConstant(NewPCCall->getArgOperand(0));
+  uint64_t Size = getLimitedValue(NewPCCall->getArgOperand(1));
+  revng_assert(Size != 0);
+  return { PC, Size };
+}
+
 std::pair<MetaAddress, uint64_t> getPC(Instruction *TheInstruction) {
   CallInst *NewPCCall = nullptr;
   std::set<BasicBlock *> Visited;
@@ -127,12 +137,110 @@ std::pair<MetaAddress, uint64_t> getPC(Instruction *TheInstruction) {
     }
   }
 
-  // Couldn't find the current PC
-  if (NewPCCall == nullptr)
-    return { MetaAddress::invalid(), 0 };
+  return toPC(NewPCCall);
+}
 
-  auto PC = MetaAddress::fromConstant(NewPCCall->getArgOperand(0));
-  uint64_t Size = getLimitedValue(NewPCCall->getArgOperand(1));
-  revng_assert(Size != 0);
-  return { PC, Size };
+/// \return the last call to `newpc` in \p BB, if any
+static CallInst *lastNewPC(BasicBlock *BB) {
+  for (Instruction &I : reverse(*BB))
+    if (CallInst *Call = getCallTo(&I, "newpc"))
+      return Call;
+  return nullptr;
+}
+
+void NewPCCache::merge(Entry &Accumulator, const Entry &Incoming) {
+  if (Incoming.Conflict)
+    Accumulator.Conflict = true;
+  else if (Accumulator.Call == nullptr)
+    Accumulator.Call = Incoming.Call;
+  else if (Incoming.Call != nullptr and Incoming.Call != Accumulator.Call)
+    Accumulator.Conflict = true;
+}
+
+NewPCCache::Entry NewPCCache::reachingEnd(BasicBlock *Start) {
+  using GCBI = GeneratedCodeBasicInfo;
+
+  auto It = AtEnd.find(Start);
+  if (It != AtEnd.end())
+    return It->second;
+
+  if (CallInst *Last = lastNewPC(Start))
+    return AtEnd[Start] = { Last, false, false };
+
+  // Visit the predecessors depth-first, without recursion, since chains of
+  // blocks without calls to newpc can be long
+  struct Frame {
+    BasicBlock *BB;
+    pred_iterator Next;
+    Entry Result;
+  };
+  SmallVector<Frame, 16> Stack;
+
+  AtEnd[Start].Pending = true;
+  Stack.push_back({ Start, pred_begin(Start), {} });
+
+  while (not Stack.empty()) {
+    Frame &Top = Stack.back();
+
+    // All the predecessors have been merged
+    if (Top.Next == pred_end(Top.BB)) {
+      Entry Result = Top.Result;
+      AtEnd[Top.BB] = Result;
+      Stack.pop_back();
+      if (not Stack.empty())
+        merge(Stack.back().Result, Result);
+      continue;
+    }
+
+    BasicBlock *Predecessor = *Top.Next;
+    ++Top.Next;
+
+    if (GCBI::isPartOfRootDispatcher(Predecessor))
+      continue;
+
+    auto It = AtEnd.find(Predecessor);
+    if (It != AtEnd.end()) {
+      // Pending predecessors are part of a loop without calls to newpc
+      if (not It->second.Pending)
+        merge(Top.Result, It->second);
+      continue;
+    }
+
+    if (CallInst *Last = lastNewPC(Predecessor)) {
+      Entry Result = { Last, false, false };
+      AtEnd[Predecessor] = Result;
+      merge(Top.Result, Result);
+      continue;
+    }
+
+    AtEnd[Predecessor].Pending = true;
+    Stack.push_back({ Predecessor, pred_begin(Predecessor), {} });
+  }
+
+  return AtEnd[Start];
+}
+
+NewPCCache::Entry NewPCCache::reachingBegin(BasicBlock *BB) {
+  using GCBI = GeneratedCodeBasicInfo;
+
+  Entry Result;
+  for (BasicBlock *Predecessor : predecessors(BB))
+    if (not GCBI::isPartOfRootDispatcher(Predecessor))
+      merge(Result, reachingEnd(Predecessor));
+  return Result;
+}
+
+CallInst *NewPCCache::reaching(Instruction *I) {
+  BasicBlock *BB = I->getParent();
+  auto Previous = make_range(std::next(I->getReverseIterator()), BB->rend());
+  for (Instruction &Candidate : Previous)
+    if (CallInst *Call = getCallTo(&Candidate, "newpc"))
+      return Call;
+
+  Entry Result = reachingBegin(BB);
+  return Result.Conflict ? nullptr : Result.Call;
+}
+
+std::pair<MetaAddress, uint64_t> NewPCCache::getPC(Instruction *I) {
+  return toPC(reaching(I));
 }
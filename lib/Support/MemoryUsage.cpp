@@ -0,0 +1,128 @@
+/// \file MemoryUsage.cpp
+/// \brief Inspects the memory used by the process
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <fstream>
+#include <string>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#if defined(REVNG_ALLOCATOR_MIMALLOC)
+#include <mimalloc.h>
+#elif defined(REVNG_ALLOCATOR_JEMALLOC)
+#include <jemalloc/jemalloc.h>
+#elif defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#include "llvm/Support/CommandLine.h"
+
+#include "revng/Support/CommandLine.h"
+#include "revng/Support/Debug.h"
+#include "revng/Support/MemoryUsage.h"
+
+namespace cl = llvm::cl;
+
+static Logger<> Log("release-memory");
+
+static cl::opt<bool> ReleaseFreedMemory("release-freed-memory",
+                                        cl::desc("return the memory freed by "
+                                                 "each phase (e.g., a "
+                                                 "harvesting round) to the OS"),
+                                        cl::cat(MainCategory),
+                                        cl::init(true));
+
+/// \return the value of the field \p Name of /proc/self/status, in bytes
+static uint64_t readStatusField(const std::string &Name) {
+  std::ifstream Status("/proc/self/status");
+  std::string Line;
+  while (std::getline(Status, Line)) {
+    if (Line.compare(0, Name.size(), Name) == 0 and Line.size() > Name.size()
+        and Line[Name.size()] == ':') {
+      // The value is expressed in kB
+      return std::stoull(Line.substr(Name.size() + 1)) * 1024;
+    }
+  }
+
+  return 0;
+}
+
+static uint64_t heapBytes() {
+#if defined(REVNG_ALLOCATOR_JEMALLOC)
+  // Refresh the statistics, then read them
+  uint64_t Epoch = 1;
+  size_t EpochSize = sizeof(Epoch);
+  mallctl("epoch", &Epoch, &EpochSize, &Epoch, EpochSize);
+
+  size_t Allocated = 0;
+  size_t AllocatedSize = sizeof(Allocated);
+  if (mallctl("stats.allocated", &Allocated, &AllocatedSize, nullptr, 0) != 0)
+    return 0;
+  return Allocated;
+#elif defined(REVNG_ALLOCATOR_MIMALLOC)
+  return 0;
+#elif defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+  return mallinfo2().uordblks;
+#elif defined(__GLIBC__)
+  // The fields of mallinfo are int, they wrap around past 2 GiB
+  return static_cast<unsigned>(mallinfo().uordblks);
+#else
+  return 0;
+#endif
+}
+
+MemoryUsage MemoryUsage::current(bool WithHeap) {
+  MemoryUsage Result;
+
+  uint64_t Pages = 0;
+  uint64_t ResidentPages = 0;
+  std::ifstream Statm("/proc/self/statm");
+  if (Statm >> Pages >> ResidentPages)
+    Result.RSS = ResidentPages * sysconf(_SC_PAGESIZE);
+
+  // VmHWM honors resetPeak, ru_maxrss doesn't
+  Result.PeakRSS = readStatusField("VmHWM");
+  if (Result.PeakRSS == 0) {
+    struct rusage Usage;
+    if (getrusage(RUSAGE_SELF, &Usage) == 0)
+      Result.PeakRSS = static_cast<uint64_t>(Usage.ru_maxrss) * 1024;
+  }
+
+  if (WithHeap)
+    Result.HeapBytes = heapBytes();
+
+  return Result;
+}
+
+bool MemoryUsage::resetPeak() {
+  // See clear_refs in proc(5)
+  std::ofstream ClearRefs("/proc/self/clear_refs");
+  ClearRefs << "5";
+  ClearRefs.flush();
+  return ClearRefs.good();
+}
+
+void releaseFreedMemory() {
+  if (not ReleaseFreedMemory)
+    return;
+
+  uint64_t RSSBefore = Log.isEnabled() ? MemoryUsage::current().RSS : 0;
+
+#if defined(REVNG_ALLOCATOR_MIMALLOC)
+  mi_collect(true);
+#elif defined(REVNG_ALLOCATOR_JEMALLOC)
+  // Purge the unused dirty pages of all the arenas
+  std::string Purge = "arena." + std::to_string(MALLCTL_ARENAS_ALL) + ".purge";
+  mallctl(Purge.c_str(), nullptr, nullptr, nullptr, 0);
+#elif defined(__GLIBC__)
+  malloc_trim(0);
+#endif
+
+  revng_log(Log,
+            "RSS went from " << RSSBefore << " to "
+                             << MemoryUsage::current().RSS << " bytes");
+}
@@ -0,0 +1,201 @@
+/// \file ProfilerRegion.cpp
+/// \brief Notifies the profilers in use about the regions of interest
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+#ifdef HAVE_VALGRIND_CALLGRIND_H
+#include "valgrind/callgrind.h"
+#endif
+
+#ifdef HAVE_ITTNOTIFY_H
+#include "ittnotify.h"
+#endif
+
+#ifdef HAVE_TRACY
+#include "tracy/TracyC.h"
+#endif
+
+#include "llvm/ADT/STLExtras.h"
+
+#include "revng/Support/Assert.h"
+#include "revng/Support/CommandLine.h"
+#include "revng/Support/ProfilerRegion.h"
+
+namespace cl = llvm::cl;
+
+namespace ProfilerBackend {
+
+enum Values { Callgrind, Perf, ITT, Tracy };
+
+} // namespace ProfilerBackend
+
+using BackendsList = cl::list<ProfilerBackend::Values>;
+static BackendsList Backends("profiler-regions",
+                             cl::desc("notify these profilers about the "
+                                      "regions of interest"),
+                             cl::values(clEnumValN(ProfilerBackend::Callgrind,
+                                                   "callgrind",
+                                                   "Valgrind's Callgrind"),
+                                        clEnumValN(ProfilerBackend::Perf,
+                                                   "perf",
+                                                   "Linux perf"),
+                                        clEnumValN(ProfilerBackend::ITT,
+                                                   "itt",
+                                                   "Intel VTune"),
+                                        clEnumValN(ProfilerBackend::Tracy,
+                                                   "tracy",
+                                                   "Tracy")),
+                             cl::CommaSeparated,
+                             cl::cat(MainCategory));
+
+static bool isAvailable(ProfilerBackend::Values Backend) {
+  switch (Backend) {
+  case ProfilerBackend::Callgrind:
+#ifdef HAVE_VALGRIND_CALLGRIND_H
+    return true;
+#else
+    return false;
+#endif
+
+  case ProfilerBackend::Perf:
+#ifdef __linux__
+    return true;
+#else
+    return false;
+#endif
+
+  case ProfilerBackend::ITT:
+#ifdef HAVE_ITTNOTIFY_H
+    return true;
+#else
+    return false;
+#endif
+
+  case ProfilerBackend::Tracy:
+#ifdef HAVE_TRACY
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  revng_abort();
+}
+
+bool areProfilerRegionsEnabled() {
+  if (Backends.empty())
+    return false;
+
+  static bool Checked = [] {
+    for (ProfilerBackend::Values Backend : Backends)
+      revng_check(isAvailable(Backend),
+                  "The selected profiler is not supported by this build");
+    return true;
+  }();
+  (void) Checked;
+
+  return true;
+}
+
+static void toggleCallgrind(bool Start) {
+#ifdef HAVE_VALGRIND_CALLGRIND_H
+  if (Start) {
+    CALLGRIND_START_INSTRUMENTATION;
+  } else {
+    CALLGRIND_STOP_INSTRUMENTATION;
+  }
+#endif
+}
+
+static void togglePerf(bool Enable) {
+#ifdef __linux__
+  prctl(Enable ? PR_TASK_PERF_EVENTS_ENABLE : PR_TASK_PERF_EVENTS_DISABLE);
+#endif
+}
+
+#ifdef HAVE_ITTNOTIFY_H
+static __itt_domain *ittDomain() {
+  static __itt_domain *Domain = __itt_domain_create("revng");
+  return Domain;
+}
+#endif
+
+#ifdef HAVE_TRACY
+/// The zones open on the current thread, innermost last
+static thread_local std::vector<TracyCZoneCtx> TracyZones;
+#endif
+
+void beginProfilerRegion(llvm::StringRef Name, bool Enable) {
+  for (ProfilerBackend::Values Backend : Backends) {
+    switch (Backend) {
+    case ProfilerBackend::Callgrind:
+      toggleCallgrind(Enable);
+      break;
+
+    case ProfilerBackend::Perf:
+      togglePerf(Enable);
+      break;
+
+    case ProfilerBackend::ITT:
+#ifdef HAVE_ITTNOTIFY_H
+      if (Enable) {
+        std::string NullTerminated = Name.str();
+        auto *Handle = __itt_string_handle_create(NullTerminated.c_str());
+        __itt_task_begin(ittDomain(), __itt_null, __itt_null, Handle);
+      }
+#endif
+      break;
+
+    case ProfilerBackend::Tracy:
+#ifdef HAVE_TRACY
+      if (Enable) {
+        TracyCZoneN(Zone, "ProfilerRegion", 1);
+        TracyCZoneName(Zone, Name.data(), Name.size());
+        TracyZones.push_back(Zone);
+      }
+#endif
+      break;
+    }
+  }
+}
+
+void endProfilerRegion(bool Enable) {
+  // Close in reverse order, so that the innermost notifications match
+  for (ProfilerBackend::Values Backend : llvm::reverse(Backends)) {
+    switch (Backend) {
+    case ProfilerBackend::Callgrind:
+      toggleCallgrind(not Enable);
+      break;
+
+    case ProfilerBackend::Perf:
+      togglePerf(not Enable);
+      break;
+
+    case ProfilerBackend::ITT:
+#ifdef HAVE_ITTNOTIFY_H
+      if (Enable)
+        __itt_task_end(ittDomain());
+#endif
+      break;
+
+    case ProfilerBackend::Tracy:
+#ifdef HAVE_TRACY
+      if (Enable) {
+        revng_assert(not TracyZones.empty());
+        TracyCZoneEnd(TracyZones.back());
+        TracyZones.pop_back();
+      }
+#endif
+      break;
+    }
+  }
+}
@@ -5,7 +5,11 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <limits>
+
 #include "llvm/ADT/SmallSet.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/Support/MathExtras.h"
 
 #include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
 #include "revng/Support/ProgramCounterHandler.h"
@@ -55,6 +59,7 @@ public:
                                       Value *PCAddress,
                                       Value *SavedRegisters) const final {
     Builder.CreateStore(PCAddress, AddressCSV);
+    forgetPCEvents(Builder.GetInsertBlock());
   }
 
 protected:
@@ -168,6 +173,7 @@ private:
 
     // Update the PC address too
     B.CreateStore(PCAddress, AddressCSV);
+    forgetPCEvents(B.GetInsertBlock());
   }
 
 protected:
@@ -342,6 +348,30 @@ llvm::Value *ProgramCounterHandler::loadPC(llvm::IRBuilder<> &Builder) const {
   return V;
 }
 
+const PCH::PCEvents &PCH::pcEvents(BasicBlock *BB) const {
+  auto It = PCEventsCache.find(BB);
+  if (It != PCEventsCache.end())
+    return It->second;
+
+  PCEvents &Result = PCEventsCache[BB];
+  for (Instruction &I : make_range(BB->rbegin(), BB->rend())) {
+    if (auto *Store = dyn_cast<StoreInst>(&I)) {
+      Value *Pointer = Store->getPointerOperand();
+      if (Pointer == AddressCSV || Pointer == EpochCSV
+          || Pointer == AddressSpaceCSV || Pointer == TypeCSV)
+        Result.emplace_back(Store);
+    } else if (isCallTo(&I, "newpc")) {
+      // Nothing before a call to newpc is relevant
+      Result.emplace_back(&I);
+      break;
+    } else if (getCallToHelper(&I) != nullptr) {
+      Result.emplace_back(&I);
+    }
+  }
+
+  return Result;
+}
+
 std::pair<NextJumpTarget::Values, MetaAddress>
 PCH::getUniqueJumpTarget(BasicBlock *BB) {
   std::vector<StackEntry> Stack;
@@ -361,8 +391,13 @@ PCH::getUniqueJumpTarget(BasicBlock *BB) {
 
     PartialMetaAddress &PMA = S.agreement();
 
-    // Iterate backward on all instructions
-    for (Instruction &I : make_range(BB->rbegin(), BB->rend())) {
+    // Iterate backward on the instructions that might affect the PC
+    for (const WeakVH &Event : pcEvents(BB)) {
+      // The instruction has been erased
+      if (Event == nullptr)
+        continue;
+
+      Instruction &I = *cast<Instruction>(Event);
       if (auto *Store = dyn_cast<StoreInst>(&I)) {
         // We found a store
         Value *Pointer = Store->getPointerOperand();
@@ -681,6 +716,346 @@ void PCH::destroyDispatcher(SwitchInst *Root) const {
   SwitchManager(Root, {}).destroy(Root);
 }
 
+void PCH::pruneDispatcher(SwitchInst *Root, KeepPredicate Keep) const {
+  for (const auto &EpochCase : Root->cases()) {
+    uint64_t Epoch = EpochCase.getCaseValue()->getZExtValue();
+    for (const auto &AddressSpaceCase : getNextSwitch(EpochCase)->cases()) {
+      uint64_t AddressSpace = AddressSpaceCase.getCaseValue()->getZExtValue();
+      for (const auto &TypeCase : getNextSwitch(AddressSpaceCase)->cases()) {
+        uint64_t RawType = TypeCase.getCaseValue()->getZExtValue();
+        auto Type = static_cast<MetaAddressType::Values>(RawType);
+        SwitchInst *AddressSwitch = getNextSwitch(TypeCase);
+
+        // Note: removeCase moves the last case in place of the removed one
+        auto It = AddressSwitch->case_begin();
+        while (It != AddressSwitch->case_end()) {
+          MetaAddress MA(It->getCaseValue()->getZExtValue(),
+                         Type,
+                         Epoch,
+                         AddressSpace);
+          if (Keep({ MA, It->getCaseSuccessor() }))
+            ++It;
+          else
+            It = AddressSwitch->removeCase(It);
+        }
+      }
+    }
+  }
+}
+
+static uint64_t setSwitchWeights(SwitchInst *Switch,
+                                 ArrayRef<uint64_t> CaseWeights) {
+  uint64_t Total = 0;
+  uint64_t Max = 0;
+  for (uint64_t Weight : CaseWeights) {
+    Total += Weight;
+    Max = std::max(Max, Weight);
+  }
+
+  if (Max == 0)
+    return 0;
+
+  // Branch weights are 32-bits wide
+  uint64_t Scale = Max / std::numeric_limits<uint32_t>::max() + 1;
+  SmallVector<uint32_t, 16> Weights;
+  Weights.reserve(CaseWeights.size() + 1);
+  Weights.push_back(0);
+  for (uint64_t Weight : CaseWeights)
+    Weights.push_back(Weight / Scale);
+
+  MDBuilder MDB(getContext(Switch));
+  Switch->setMetadata(LLVMContext::MD_prof, MDB.createBranchWeights(Weights));
+  return Total;
+}
+
+void PCH::setDispatcherWeights(SwitchInst *Root, WeightFunction Weight) const {
+  std::vector<uint64_t> EpochWeights;
+  for (const auto &EpochCase : Root->cases()) {
+    uint64_t Epoch = EpochCase.getCaseValue()->getZExtValue();
+    SwitchInst *AddressSpaceSwitch = getNextSwitch(EpochCase);
+
+    std::vector<uint64_t> AddressSpaceWeights;
+    for (const auto &AddressSpaceCase : AddressSpaceSwitch->cases()) {
+      uint64_t AddressSpace = AddressSpaceCase.getCaseValue()->getZExtValue();
+      SwitchInst *TypeSwitch = getNextSwitch(AddressSpaceCase);
+
+      std::vector<uint64_t> TypeWeights;
+      for (const auto &TypeCase : TypeSwitch->cases()) {
+        uint64_t RawType = TypeCase.getCaseValue()->getZExtValue();
+        auto Type = static_cast<MetaAddressType::Values>(RawType);
+        SwitchInst *AddressSwitch = getNextSwitch(TypeCase);
+
+        std::vector<uint64_t> AddressWeights;
+        for (const auto &Case : AddressSwitch->cases()) {
+          MetaAddress MA(Case.getCaseValue()->getZExtValue(),
+                         Type,
+                         Epoch,
+                         AddressSpace);
+          AddressWeights.push_back(Weight(MA));
+        }
+
+        TypeWeights.push_back(setSwitchWeights(AddressSwitch, AddressWeights));
+      }
+
+      AddressSpaceWeights.push_back(setSwitchWeights(TypeSwitch, TypeWeights));
+    }
+
+    EpochWeights.push_back(setSwitchWeights(AddressSpaceSwitch,
+                                            AddressSpaceWeights));
+  }
+
+  setSwitchWeights(Root, EpochWeights);
+}
+
+/// \brief Layout of the lookup table of a dispatcher
+struct DispatcherTable {
+  /// Amount by which addresses are shifted right, i.e., their common alignment
+  unsigned Shift = 0;
+
+  /// If true, slots are indexed by `(Address - Base) >> Shift`, otherwise by
+  /// `((Address >> Shift) * Multiplier) >> (64 - Bits)`
+  bool Dense = false;
+  uint64_t Base = 0;
+  uint64_t Multiplier = 0;
+  unsigned Bits = 0;
+
+  /// Number of slots
+  uint64_t Size = 0;
+
+  uint64_t slot(uint64_t Address) const {
+    if (Dense)
+      return (Address - Base) >> Shift;
+    else
+      return ((Address >> Shift) * Multiplier) >> (64 - Bits);
+  }
+
+  /// \brief Choose the layout for the sorted and unique \p Addresses
+  ///
+  /// \return false if no collision-free layout could be found.
+  bool initialize(ArrayRef<uint64_t> Addresses) {
+    revng_assert(Addresses.size() != 0);
+
+    uint64_t Differences = 0;
+    for (uint64_t Address : Addresses)
+      Differences |= Address - Addresses.front();
+    Shift = Differences == 0 ? 0 : countTrailingZeros(Differences);
+
+    // Use a direct-mapped table if at least a quarter of the slots is used
+    uint64_t Span = ((Addresses.back() - Addresses.front()) >> Shift) + 1;
+    if (Span / 4 <= Addresses.size()) {
+      Dense = true;
+      Base = Addresses.front();
+      Size = Span;
+      return true;
+    }
+
+    // Look for a multiplicative hash function without collisions, starting
+    // from a table with at least twice as many slots as addresses
+    Dense = false;
+    unsigned MinimumBits = std::max(1U, Log2_64_Ceil(2 * Addresses.size()));
+    for (Bits = MinimumBits; Bits <= MinimumBits + 2; Bits++) {
+      Size = 1ULL << Bits;
+      std::vector<bool> Used(Size);
+      Multiplier = 0x9E3779B97F4A7C15ULL;
+      for (unsigned Attempt = 0; Attempt < 64; Attempt++) {
+        std::fill(Used.begin(), Used.end(), false);
+
+        bool Collision = false;
+        for (uint64_t Address : Addresses) {
+          uint64_t Slot = slot(Address);
+          if (Used[Slot]) {
+            Collision = true;
+            break;
+          }
+          Used[Slot] = true;
+        }
+
+        if (not Collision)
+          return true;
+
+        // Try the next (odd) candidate
+        Multiplier = Multiplier * 6364136223846793005ULL
+                     + 1442695040888963407ULL;
+        Multiplier |= 1;
+      }
+    }
+
+    return false;
+  }
+
+  Value *emitSlot(IRBuilder<> &Builder, Value *Address) const {
+    Value *Shifted = nullptr;
+    if (Dense) {
+      Shifted = Builder.CreateSub(Address, Builder.getInt64(Base));
+      return Builder.CreateLShr(Shifted, Shift);
+    } else {
+      Shifted = Builder.CreateLShr(Address, Shift);
+      Value *Hash = Builder.CreateMul(Shifted, Builder.getInt64(Multiplier));
+      return Builder.CreateLShr(Hash, 64 - Bits);
+    }
+  }
+};
+
+bool PCH::addTableToDispatcher(SwitchInst *Root,
+                               unsigned MinimumTargets,
+                               Optional<BlockType::Values> SetBlockType) const {
+  // Find the switch on addresses with the largest number of cases
+  SwitchInst *AddressSpaceSwitch = nullptr;
+  SwitchInst *TypeSwitch = nullptr;
+  SwitchInst *AddressSwitch = nullptr;
+  ConstantInt *Epoch = nullptr;
+  ConstantInt *AddressSpace = nullptr;
+  ConstantInt *Type = nullptr;
+  for (auto EpochCase : Root->cases()) {
+    SwitchInst *CurrentAddressSpaceSwitch = getNextSwitch(EpochCase);
+    for (auto AddressSpaceCase : CurrentAddressSpaceSwitch->cases()) {
+      SwitchInst *CurrentTypeSwitch = getNextSwitch(AddressSpaceCase);
+      for (auto TypeCase : CurrentTypeSwitch->cases()) {
+        SwitchInst *CurrentAddressSwitch = getNextSwitch(TypeCase);
+        unsigned CasesCount = CurrentAddressSwitch->getNumCases();
+        if (AddressSwitch == nullptr
+            or CasesCount > AddressSwitch->getNumCases()) {
+          AddressSpaceSwitch = CurrentAddressSpaceSwitch;
+          TypeSwitch = CurrentTypeSwitch;
+          AddressSwitch = CurrentAddressSwitch;
+          Epoch = EpochCase.getCaseValue();
+          AddressSpace = AddressSpaceCase.getCaseValue();
+          Type = TypeCase.getCaseValue();
+        }
+      }
+    }
+  }
+
+  if (AddressSwitch == nullptr)
+    return false;
+
+  // Collect the targets. Those with PHIs keep going through the cascade, so
+  // that we don't have to add new incoming blocks.
+  std::vector<std::pair<uint64_t, BasicBlock *>> Targets;
+  for (auto Case : AddressSwitch->cases()) {
+    BasicBlock *Target = Case.getCaseSuccessor();
+    if (not isa<PHINode>(Target->front()))
+      Targets.emplace_back(Case.getCaseValue()->getZExtValue(), Target);
+  }
+
+  if (Targets.size() < MinimumTargets or Targets.size() == 0)
+    return false;
+
+  llvm::sort(Targets);
+
+  std::vector<uint64_t> Addresses;
+  Addresses.reserve(Targets.size());
+  for (const auto &P : Targets)
+    Addresses.push_back(P.first);
+
+  DispatcherTable Table;
+  if (not Table.initialize(Addresses))
+    return false;
+
+  // Fill the table. Empty slots point to an invalid index, which is handled by
+  // the default case of the switch on the index.
+  auto InvalidIndex = static_cast<uint32_t>(Targets.size());
+  std::vector<uint64_t> SlotAddresses(Table.Size, 0);
+  std::vector<uint32_t> SlotIndices(Table.Size, InvalidIndex);
+  for (unsigned I = 0; I < Targets.size(); I++) {
+    uint64_t Slot = Table.slot(Targets[I].first);
+    revng_assert(SlotIndices[Slot] == InvalidIndex);
+    SlotAddresses[Slot] = Targets[I].first;
+    SlotIndices[Slot] = I;
+  }
+
+  LLVMContext &Context = getContext(Root);
+  Module *M = getModule(Root);
+  auto *AddressesArray = ConstantDataArray::get(Context, SlotAddresses);
+  auto *AddressesTable = new GlobalVariable(*M,
+                                            AddressesArray->getType(),
+                                            true,
+                                            GlobalValue::PrivateLinkage,
+                                            AddressesArray,
+                                            "dispatcher_table_addresses");
+  auto *IndicesArray = ConstantDataArray::get(Context, SlotIndices);
+  auto *IndicesTable = new GlobalVariable(*M,
+                                          IndicesArray->getType(),
+                                          true,
+                                          GlobalValue::PrivateLinkage,
+                                          IndicesArray,
+                                          "dispatcher_table_indices");
+
+  // Move the cascade in its own basic block, the head of the dispatcher will
+  // branch there if the lookup fails
+  BasicBlock *Head = Root->getParent();
+  Function *F = Head->getParent();
+  MDNode *HeadBlockType = Root->getMetadata(BlockTypeMDName);
+  BasicBlock *Cascade = Head->splitBasicBlock(Root,
+                                              Head->getName() + "_cascade");
+  Head->getTerminator()->eraseFromParent();
+  if (SetBlockType)
+    setBlockType(Root, *SetBlockType);
+
+  auto CreateBlock = [&Context, F, Head](const Twine &Suffix) {
+    return BasicBlock::Create(Context, Head->getName() + Suffix, F);
+  };
+
+  auto Tag = [&SetBlockType](Instruction *T) {
+    if (SetBlockType)
+      setBlockType(T, *SetBlockType);
+  };
+
+  // Is the current MetaAddress handled by the table?
+  IRBuilder<> Builder(Head);
+  BasicBlock *Lookup = CreateBlock("_lookup");
+  Value *IsCandidate = Builder.CreateICmpEQ(Root->getCondition(), Epoch);
+  Value *AddressSpaceCondition = AddressSpaceSwitch->getCondition();
+  IsCandidate = Builder.CreateAnd(IsCandidate,
+                                  Builder.CreateICmpEQ(AddressSpaceCondition,
+                                                       AddressSpace));
+  IsCandidate = Builder.CreateAnd(IsCandidate,
+                                  Builder.CreateICmpEQ(TypeSwitch
+                                                         ->getCondition(),
+                                                       Type));
+  auto *Branch = Builder.CreateCondBr(IsCandidate, Lookup, Cascade);
+  Branch->setMetadata(BlockTypeMDName, HeadBlockType);
+
+  // Compute the slot
+  Builder.SetInsertPoint(Lookup);
+  Value *Address = Builder.CreateZExtOrTrunc(AddressSwitch->getCondition(),
+                                             Builder.getInt64Ty());
+  Value *Slot = Table.emitSlot(Builder, Address);
+  if (Table.Dense) {
+    BasicBlock *InRange = CreateBlock("_in_range");
+    Value *IsInRange = Builder.CreateICmpULT(Slot,
+                                             Builder.getInt64(Table.Size));
+    Tag(Builder.CreateCondBr(IsInRange, InRange, Cascade));
+    Builder.SetInsertPoint(InRange);
+  }
+
+  // Check the slot actually holds the current address
+  BasicBlock *Dispatch = CreateBlock("_table");
+  Value *Indices[] = { Builder.getInt64(0), Slot };
+  Value *SlotAddressPointer = Builder.CreateInBoundsGEP(AddressesArray
+                                                          ->getType(),
+                                                        AddressesTable,
+                                                        Indices);
+  Value *SlotAddress = Builder.CreateLoad(SlotAddressPointer);
+  Value *IsHit = Builder.CreateICmpEQ(SlotAddress, Address);
+  Tag(Builder.CreateCondBr(IsHit, Dispatch, Cascade));
+
+  // Dispatch on the dense index
+  Builder.SetInsertPoint(Dispatch);
+  Value *IndexPointer = Builder.CreateInBoundsGEP(IndicesArray->getType(),
+                                                  IndicesTable,
+                                                  Indices);
+  Value *Index = Builder.CreateLoad(IndexPointer);
+  SwitchInst *IndexSwitch = Builder.CreateSwitch(Index,
+                                                 Cascade,
+                                                 Targets.size());
+  for (unsigned I = 0; I < Targets.size(); I++)
+    IndexSwitch->addCase(Builder.getInt32(I), Targets[I].second);
+  Tag(IndexSwitch);
+
+  return true;
+}
+
 PCH::DispatcherInfo
 PCH::buildDispatcher(DispatcherTargets &Targets,
                      IRBuilder<> &Builder,
@@ -760,6 +1135,84 @@ PCH::buildDispatcher(DispatcherTargets &Targets,
   return Result;
 }
 
+/// \return the value last stored in \p CSV before the insertion point of
+///         \p Builder, if it is in the same basic block and nothing else could
+///         have written \p CSV in between
+static Value *getLastStoredValue(IRBuilder<> &Builder, GlobalVariable *CSV) {
+  BasicBlock *BB = Builder.GetInsertBlock();
+  auto It = Builder.GetInsertPoint();
+  while (It != BB->begin()) {
+    --It;
+    if (auto *Store = dyn_cast<StoreInst>(&*It)) {
+      Value *Pointer = Store->getPointerOperand();
+      if (Pointer == CSV)
+        return Store->getValueOperand();
+      else if (isa<GlobalVariable>(Pointer))
+        continue;
+    }
+
+    if (It->mayWriteToMemory() and not isMarker(&*It))
+      return nullptr;
+  }
+
+  return nullptr;
+}
+
+PCH::DispatcherInfo
+PCH::buildJumpSiteDispatcher(DispatcherTargets &Targets,
+                             IRBuilder<> &Builder,
+                             BasicBlock *Default,
+                             Optional<BlockType::Values> SetBlockType) const {
+  revng_assert(Targets.size() != 0);
+
+  const MetaAddress &First = Targets[0].first;
+  auto IsLikeFirst = [&First](const DispatcherTarget &Target) {
+    const MetaAddress &MA = Target.first;
+    return MA.epoch() == First.epoch()
+           and MA.addressSpace() == First.addressSpace()
+           and MA.type() == First.type();
+  };
+  if (not llvm::all_of(Targets, IsLikeFirst))
+    return buildDispatcher(Targets, Builder, Default, SetBlockType);
+
+  DispatcherInfo Result;
+  LLVMContext &Context = getContext(Default);
+
+  Value *Address = getLastStoredValue(Builder, AddressCSV);
+  if (Address == nullptr)
+    Address = Builder.CreateLoad(AddressCSV);
+
+  auto CreateCmp = [&Builder](GlobalVariable *CSV, uint64_t Value) {
+    Instruction *Load = Builder.CreateLoad(CSV);
+    Type *LoadType = Load->getType();
+    return Builder.CreateICmpEQ(Load, ConstantInt::get(LoadType, Value));
+  };
+  Value *IsExpected = Builder.CreateAnd({ CreateCmp(EpochCSV, First.epoch()),
+                                          CreateCmp(AddressSpaceCSV,
+                                                    First.addressSpace()),
+                                          CreateCmp(TypeCSV, First.type()) });
+
+  BasicBlock *BB = Builder.GetInsertBlock();
+  auto *SwitchBlock = BasicBlock::Create(Context,
+                                         BB->getName() + "_jump_table",
+                                         BB->getParent());
+  Result.NewBlocks.push_back(SwitchBlock);
+  Builder.CreateCondBr(IsExpected, SwitchBlock, Default);
+
+  IRBuilder<> SwitchBuilder(SwitchBlock);
+  SwitchInst *Switch = SwitchBuilder.CreateSwitch(Address,
+                                                  Default,
+                                                  Targets.size());
+  for (const auto &[MA, Target] : Targets)
+    ::addCase(Switch, MA.address(), Target);
+
+  if (SetBlockType)
+    setBlockType(Switch, *SetBlockType);
+
+  Result.Switch = Switch;
+  return Result;
+}
+
 std::unique_ptr<ProgramCounterHandler>
 PCH::create(Triple::ArchType Architecture,
             Module *M,
@@ -5,6 +5,12 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+
 #include "revng/Support/CommandLine.h"
 #include "revng/Support/Statistics.h"
 
@@ -22,6 +28,32 @@ static cl::alias A1("T",
                     cl::aliasopt(Statistics),
                     cl::cat(MainCategory));
 
+namespace StatisticsFormat {
+
+enum Values { JSON, Prometheus };
+
+} // namespace StatisticsFormat
+
+namespace SF = StatisticsFormat;
+
+static cl::opt<std::string> StatisticsOutput("statistics-output",
+                                             cl::desc("on exit or SIGINT, "
+                                                      "write the statistics "
+                                                      "in a machine-readable "
+                                                      "format to this file"),
+                                             cl::value_desc("path"),
+                                             cl::cat(MainCategory));
+
+static auto Formats = cl::values(clEnumValN(SF::JSON, "json", "JSON object"),
+                                 clEnumValN(SF::Prometheus,
+                                            "prometheus",
+                                            "Prometheus text format"));
+static cl::opt<SF::Values> Format("statistics-format",
+                                  cl::desc("format of -statistics-output"),
+                                  Formats,
+                                  cl::cat(MainCategory),
+                                  cl::init(SF::JSON));
+
 struct Handler {
   int Signal;
   bool Restore;
@@ -38,13 +70,39 @@ static std::array<Handler, 3> Handlers = { { { SIGINT, true, {}, {} },
 llvm::ManagedStatic<OnQuitRegistry> OnQuitStatistics;
 
 void installStatistics() {
-  if (Statistics)
+  if (Statistics or not StatisticsOutput.empty())
     OnQuitStatistics->install();
 }
 
+static void exportStatistics() {
+  StatisticsExporter Exporter;
+  OnQuitStatistics->exportTo(Exporter);
+
+  std::error_code EC;
+  llvm::raw_fd_ostream Output(StatisticsOutput, EC, llvm::sys::fs::OF_Text);
+  if (EC) {
+    dbg << "Cannot open " << StatisticsOutput << ": " << EC.message() << "\n";
+    return;
+  }
+
+  switch (Format) {
+  case SF::JSON:
+    Exporter.writeJSON(Output);
+    break;
+  case SF::Prometheus:
+    Exporter.writePrometheus(Output);
+    break;
+  }
+}
+
 static void onQuit() {
-  dbg << "\n";
-  OnQuitStatistics->dump();
+  if (Statistics) {
+    dbg << "\n";
+    OnQuitStatistics->dump();
+  }
+
+  if (not StatisticsOutput.empty())
+    exportStatistics();
 }
 
 static void onQuitSignalHandler(int Signal) {
@@ -85,5 +143,63 @@ void RunningStatistics::onQuit() {
   dbg << "\n";
 }
 
+void RunningStatistics::exportTo(StatisticsExporter &Exporter) {
+  if (Name.empty())
+    return;
+
+  Accumulator Total = total();
+  Exporter.add(Name, "n", Total.N);
+  Exporter.add(Name, "sum", Total.Sum);
+  Exporter.add(Name, "mean", Total.Mean);
+  Exporter.add(Name, "variance", variance());
+}
+
+void StatisticsExporter::writeJSON(llvm::raw_ostream &Output) const {
+  llvm::json::OStream JSON(Output, 2);
+  JSON.object([&] {
+    for (const auto &[Name, Entries] : Values) {
+      JSON.attributeObject(Name, [&] {
+        for (const auto &[Key, Value] : Entries)
+          JSON.attribute(Key, Value);
+      });
+    }
+  });
+  Output << "\n";
+}
+
+/// \brief Turn \p Name into a valid Prometheus metric name
+static std::string toMetricName(llvm::StringRef Name) {
+  std::string Result = "revng_";
+  for (char C : Name)
+    Result += (llvm::isAlnum(C) or C == '_') ? C : '_';
+  return Result;
+}
+
+/// \brief Escape \p Value to be used as a Prometheus label value
+static std::string toLabelValue(llvm::StringRef Value) {
+  std::string Result;
+  for (char C : Value) {
+    if (C == '\\' or C == '"')
+      Result += '\\';
+
+    if (C == '\n')
+      Result += "\\n";
+    else
+      Result += C;
+  }
+  return Result;
+}
+
+void StatisticsExporter::writePrometheus(llvm::raw_ostream &Output) const {
+  for (const auto &[Name, Entries] : Values) {
+    std::string Metric = toMetricName(Name);
+    Output << "# TYPE " << Metric << " gauge\n";
+    for (const auto &[Key, Value] : Entries) {
+      Output << Metric << "{key=\"" << toLabelValue(Key) << "\"} ";
+      Output << llvm::format("%.17g", Value) << "\n";
+    }
+  }
+}
+
 OnQuitInteraface::~OnQuitInteraface() {
 }
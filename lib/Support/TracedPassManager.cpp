@@ -0,0 +1,108 @@
+/// \file TracedPassManager.cpp
+/// \brief Records the passes run by a legacy pass manager in the trace
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <string>
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+
+#include "revng/Support/TracedPassManager.h"
+#include "revng/Support/Tracing.h"
+
+using namespace llvm;
+
+namespace {
+
+/// \brief Opens or closes the event of a module pass
+class ModuleTraceProbe : public ModulePass {
+public:
+  static char ID;
+
+private:
+  std::string Name;
+  bool Begin;
+
+public:
+  ModuleTraceProbe(StringRef Name, bool Begin) :
+    ModulePass(ID), Name(Name.str()), Begin(Begin) {}
+
+  bool runOnModule(Module &M) override {
+    if (Begin)
+      beginPassTraceEvent(Name);
+    else
+      endPassTraceEvent(M.getInstructionCount());
+    return false;
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesAll();
+  }
+
+  StringRef getPassName() const override { return "ModuleTraceProbe"; }
+};
+
+/// \brief Opens or closes the event of a function pass on a function
+class FunctionTraceProbe : public FunctionPass {
+public:
+  static char ID;
+
+private:
+  std::string Name;
+  bool Begin;
+
+public:
+  FunctionTraceProbe(StringRef Name, bool Begin) :
+    FunctionPass(ID), Name(Name.str()), Begin(Begin) {}
+
+  bool runOnFunction(Function &F) override {
+    if (Begin)
+      beginPassTraceEvent(Name, F.getName());
+    else
+      endPassTraceEvent(F.getInstructionCount());
+    return false;
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesAll();
+  }
+
+  StringRef getPassName() const override { return "FunctionTraceProbe"; }
+};
+
+} // namespace
+
+char ModuleTraceProbe::ID = 0;
+char FunctionTraceProbe::ID = 0;
+
+void TracedPassManager::add(Pass *P) {
+  using Base = legacy::PassManager;
+
+  if (not isTracingEnabled() or P->getAsImmutablePass() != nullptr) {
+    Base::add(P);
+    return;
+  }
+
+  StringRef Name = P->getPassName();
+  switch (P->getPassKind()) {
+  case PT_Module:
+    Base::add(new ModuleTraceProbe(Name, true));
+    Base::add(P);
+    Base::add(new ModuleTraceProbe(Name, false));
+    break;
+
+  case PT_Function:
+    Base::add(new FunctionTraceProbe(Name, true));
+    Base::add(P);
+    Base::add(new FunctionTraceProbe(Name, false));
+    break;
+
+  default:
+    // Loop, region and SCC passes run nested in their own managers
+    Base::add(P);
+    break;
+  }
+}
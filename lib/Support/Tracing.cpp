@@ -0,0 +1,298 @@
+/// \file Tracing.cpp
+/// \brief Records the duration of the main phases in Chrome trace event format
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Support/CommandLine.h"
+#include "revng/Support/Debug.h"
+#include "revng/Support/MemoryUsage.h"
+#include "revng/Support/Tracing.h"
+
+namespace cl = llvm::cl;
+
+using Clock = std::chrono::steady_clock;
+
+static cl::opt<std::string> TraceOutput("trace-output",
+                                        cl::desc("on exit, write the "
+                                                 "duration of the main phases "
+                                                 "to this file, in the Chrome "
+                                                 "trace event format"),
+                                        cl::value_desc("path"),
+                                        cl::cat(MainCategory));
+
+static cl::opt<bool> TracePassMemory("trace-pass-memory",
+                                     cl::desc("record the RSS growth and peak "
+                                              "of each pass in the trace, see "
+                                              "-trace-output"),
+                                     cl::cat(MainCategory));
+
+static cl::opt<bool> TracePassHeap("trace-pass-heap",
+                                   cl::desc("with -trace-pass-memory, record "
+                                            "also the growth of the bytes "
+                                            "allocated through malloc (slow)"),
+                                   cl::cat(MainCategory));
+
+namespace {
+
+struct TraceEvent {
+  std::string Name;
+  std::string Detail;
+  Clock::time_point Begin;
+  Clock::time_point End;
+  std::vector<std::pair<std::string, int64_t>> Arguments;
+};
+
+struct CounterSample {
+  std::string Name;
+  Clock::time_point Time;
+  int64_t Value;
+};
+
+/// The events of a thread, owned jointly with the Tracer so that they survive
+/// the termination of the thread
+struct ThreadEvents {
+  std::mutex Lock;
+  unsigned ID = 0;
+  std::vector<TraceEvent> Completed;
+  std::vector<TraceEvent> Open;
+  std::vector<CounterSample> Counters;
+};
+
+class Tracer {
+private:
+  std::mutex Lock;
+  Clock::time_point Start = Clock::now();
+  std::vector<std::shared_ptr<ThreadEvents>> Threads;
+  bool Registered = false;
+
+public:
+  std::shared_ptr<ThreadEvents> registerThread() {
+    std::lock_guard<std::mutex> Guard(Lock);
+
+    // Write the trace on exit
+    if (not Registered) {
+      std::atexit([] { get().write(); });
+      Registered = true;
+    }
+
+    auto Result = std::make_shared<ThreadEvents>();
+    Result->ID = Threads.size();
+    Threads.push_back(Result);
+    return Result;
+  }
+
+  void write();
+
+public:
+  /// \note Never destroyed, since the trace is written on exit
+  static Tracer &get() {
+    static Tracer *Instance = new Tracer;
+    return *Instance;
+  }
+};
+
+} // namespace
+
+static ThreadEvents &currentThreadEvents() {
+  thread_local std::shared_ptr<ThreadEvents> Events;
+  if (not Events)
+    Events = Tracer::get().registerThread();
+  return *Events;
+}
+
+void Tracer::write() {
+  std::error_code EC;
+  llvm::raw_fd_ostream Output(TraceOutput, EC, llvm::sys::fs::OF_Text);
+  if (EC) {
+    dbg << "Cannot open " << TraceOutput << ": " << EC.message() << "\n";
+    return;
+  }
+
+  auto Microseconds = [this](Clock::time_point Time) {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(Time - Start).count();
+  };
+
+  Clock::time_point Now = Clock::now();
+
+  std::lock_guard<std::mutex> Guard(Lock);
+  llvm::json::OStream JSON(Output);
+  JSON.object([&] {
+    JSON.attribute("displayTimeUnit", "ms");
+    JSON.attributeArray("traceEvents", [&] {
+      for (const std::shared_ptr<ThreadEvents> &Thread : Threads) {
+        std::lock_guard<std::mutex> ThreadGuard(Thread->Lock);
+
+        auto Emit = [&](const TraceEvent &Event, Clock::time_point End) {
+          JSON.object([&] {
+            JSON.attribute("name", Event.Name);
+            JSON.attribute("cat", "revng");
+            JSON.attribute("ph", "X");
+            JSON.attribute("pid", 1);
+            JSON.attribute("tid", Thread->ID);
+            JSON.attribute("ts", Microseconds(Event.Begin));
+            JSON.attribute("dur", Microseconds(End) - Microseconds(Event.Begin));
+            if (not Event.Detail.empty() or not Event.Arguments.empty())
+              JSON.attributeObject("args", [&] {
+                if (not Event.Detail.empty())
+                  JSON.attribute("detail", Event.Detail);
+                for (const auto &[Key, Value] : Event.Arguments)
+                  JSON.attribute(Key, Value);
+              });
+          });
+        };
+
+        for (const TraceEvent &Event : Thread->Completed)
+          Emit(Event, Event.End);
+
+        // Events still open, e.g., if we're exiting due to an error
+        for (const TraceEvent &Event : Thread->Open)
+          Emit(Event, Now);
+
+        for (const CounterSample &Sample : Thread->Counters) {
+          JSON.object([&] {
+            JSON.attribute("name", Sample.Name);
+            JSON.attribute("cat", "revng");
+            JSON.attribute("ph", "C");
+            JSON.attribute("pid", 1);
+            JSON.attribute("ts", Microseconds(Sample.Time));
+            JSON.attributeObject("args", [&] {
+              JSON.attribute("value", Sample.Value);
+            });
+          });
+        }
+      }
+    });
+  });
+  Output << "\n";
+}
+
+bool isTracingEnabled() {
+  return not TraceOutput.empty();
+}
+
+void beginTraceEvent(llvm::StringRef Name, llvm::StringRef Detail) {
+  ThreadEvents &Events = currentThreadEvents();
+  std::lock_guard<std::mutex> Guard(Events.Lock);
+  Events.Open.push_back({ Name.str(), Detail.str(), Clock::now(), {}, {} });
+}
+
+void endTraceEvent() {
+  Clock::time_point End = Clock::now();
+  ThreadEvents &Events = currentThreadEvents();
+  std::lock_guard<std::mutex> Guard(Events.Lock);
+  revng_assert(not Events.Open.empty());
+  Events.Completed.push_back(std::move(Events.Open.back()));
+  Events.Completed.back().End = End;
+  Events.Open.pop_back();
+}
+
+void setTraceArgument(llvm::StringRef Key, int64_t Value) {
+  ThreadEvents &Events = currentThreadEvents();
+  std::lock_guard<std::mutex> Guard(Events.Lock);
+  revng_assert(not Events.Open.empty());
+  Events.Open.back().Arguments.emplace_back(Key.str(), Value);
+}
+
+void traceCounter(llvm::StringRef Name, int64_t Value) {
+  Clock::time_point Now = Clock::now();
+  ThreadEvents &Events = currentThreadEvents();
+  std::lock_guard<std::mutex> Guard(Events.Lock);
+  Events.Counters.push_back({ Name.str(), Now, Value });
+}
+
+namespace {
+
+/// The memory usage at the beginning of a pass
+struct PassMemory {
+  MemoryUsage Begin;
+
+  /// The highest RSS observed so far, since nested passes reset the peak
+  uint64_t PeakRSS = 0;
+};
+
+} // namespace
+
+/// The passes running on the current thread, innermost last
+static thread_local std::vector<PassMemory> PassMemoryStack;
+
+void beginPassTraceEvent(llvm::StringRef Name, llvm::StringRef Detail) {
+  if (not TracePassMemory) {
+    beginTraceEvent(Name, Detail);
+    return;
+  }
+
+  // Sample before opening the event, so it doesn't account for the sampling
+  MemoryUsage Usage = MemoryUsage::current(TracePassHeap);
+  traceCounter("RSS", Usage.RSS);
+
+  // Resetting the peak loses the one of the enclosing pass, save it
+  if (not PassMemoryStack.empty()) {
+    uint64_t &OuterPeak = PassMemoryStack.back().PeakRSS;
+    OuterPeak = std::max(OuterPeak, Usage.PeakRSS);
+  }
+
+  uint64_t PeakRSS = MemoryUsage::resetPeak() ? Usage.RSS : Usage.PeakRSS;
+  PassMemoryStack.push_back({ Usage, PeakRSS });
+  beginTraceEvent(Name, Detail);
+}
+
+void endPassTraceEvent(std::optional<uint64_t> Instructions) {
+  if (Instructions)
+    setTraceArgument("instructions", *Instructions);
+
+  if (TracePassMemory) {
+    revng_assert(not PassMemoryStack.empty());
+    PassMemory Pass = PassMemoryStack.back();
+    PassMemoryStack.pop_back();
+
+    MemoryUsage Usage = MemoryUsage::current(TracePassHeap);
+    uint64_t PeakRSS = std::max(Pass.PeakRSS, Usage.PeakRSS);
+    traceCounter("RSS", Usage.RSS);
+
+    auto Delta = [](uint64_t After, uint64_t Before) -> int64_t {
+      return static_cast<int64_t>(After - Before);
+    };
+    setTraceArgument("rss-delta", Delta(Usage.RSS, Pass.Begin.RSS));
+    setTraceArgument("peak-rss", PeakRSS);
+    if (TracePassHeap)
+      setTraceArgument("heap-delta",
+                       Delta(Usage.HeapBytes, Pass.Begin.HeapBytes));
+
+    if (not PassMemoryStack.empty()) {
+      uint64_t &OuterPeak = PassMemoryStack.back().PeakRSS;
+      OuterPeak = std::max(OuterPeak, PeakRSS);
+    }
+  }
+
+  endTraceEvent();
+}
+
+std::optional<uint64_t> countInstructions(const llvm::Any &IR) {
+  using llvm::any_cast;
+  using llvm::any_isa;
+
+  if (any_isa<const llvm::Module *>(IR))
+    return any_cast<const llvm::Module *>(IR)->getInstructionCount();
+  else if (any_isa<const llvm::Function *>(IR))
+    return any_cast<const llvm::Function *>(IR)->getInstructionCount();
+  else
+    return std::nullopt;
+}
@@ -11,15 +11,20 @@
 //
 
 #include <limits>
+#include <numeric>
 
 #include "llvm/ADT/APInt.h"
 #include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Type.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/CommandLine.h"
 
 #include "revng/Support/Assert.h"
+#include "revng/Support/CommandLine.h"
 #include "revng/TypeShrinking/BitLiveness.h"
 #include "revng/TypeShrinking/DataFlowGraph.h"
 #include "revng/TypeShrinking/MFP.h"
@@ -58,6 +63,12 @@ static llvm::RegisterPass<BitLivenessWrapperPass> X("bit-liveness",
                                                     true,
                                                     true);
 
+static llvm::cl::opt<bool> Sparse("bit-liveness-sparse",
+                                  llvm::cl::desc("run bit liveness on the "
+                                                 "def-use chains, without "
+                                                 "building a data flow graph"),
+                                  llvm::cl::cat(MainCategory));
+
 const uint32_t Top = std::numeric_limits<uint32_t>::max();
 
 bool isDataFlowSink(const Instruction *Ins) {
@@ -220,9 +231,7 @@ static uint32_t transferZExt(Instruction *Ins, const uint32_t &Element) {
   return std::min(Element, getMaxOperandSize(Ins));
 }
 
-uint32_t
-BitLivenessAnalysis::applyTransferFunction(DataFlowNode *L, const uint32_t E) {
-  auto *Ins = L->Instruction;
+static uint32_t transferInstruction(Instruction *Ins, const uint32_t E) {
   uint32_t Input = E;
   // At most every bit of the result is alive
   if (!isDataFlowSink(Ins)) {
@@ -236,7 +245,7 @@ BitLivenessAnalysis::applyTransferFunction(DataFlowNode *L, const uint32_t E) {
   case Instruction::Add:
   case Instruction::Sub:
   case Instruction::Mul:
-    return std::min(E, getMaxOperandSize(L->Instruction));
+    return std::min(E, getMaxOperandSize(Ins));
   case Instruction::Shl:
     return transferShiftLeft(Ins, E);
   case Instruction::LShr:
@@ -253,8 +262,67 @@ BitLivenessAnalysis::applyTransferFunction(DataFlowNode *L, const uint32_t E) {
   }
 }
 
-BitLivenessPass::Result
-BitLivenessPass::run(llvm::Function &F, llvm::FunctionAnalysisManager &) {
+uint32_t
+BitLivenessAnalysis::applyTransferFunction(DataFlowNode *L, const uint32_t E) {
+  return transferInstruction(L->Instruction, E);
+}
+
+/// Solve the same problem of BitLivenessAnalysis directly on the def-use
+/// chains: the operands of an instruction play the role of its successors in
+/// the DataFlowGraph
+static BitLivenessAnalysisResults computeSparseBitLiveness(llvm::Function &F) {
+  std::vector<Instruction *> Instructions;
+  llvm::DenseMap<Instruction *, uint32_t> Indices;
+  for (Instruction &I : llvm::instructions(F)) {
+    Indices[&I] = Instructions.size();
+    Instructions.push_back(&I);
+  }
+
+  std::vector<uint32_t> Values(Instructions.size(), 0);
+  for (uint32_t I = 0; I < Instructions.size(); ++I)
+    if (isDataFlowSink(Instructions[I]))
+      Values[I] = Top;
+
+  // Liveness flows from the users to the operands, start from the bottom
+  std::vector<uint32_t> Worklist(Instructions.size());
+  std::iota(Worklist.begin(), Worklist.end(), 0);
+  BitVector Pending(Instructions.size(), true);
+
+  while (not Worklist.empty()) {
+    uint32_t Index = Worklist.back();
+    Worklist.pop_back();
+    Pending.reset(Index);
+
+    Instruction *Ins = Instructions[Index];
+    uint32_t Updated = transferInstruction(Ins, Values[Index]);
+    for (llvm::Value *Operand : Ins->operands()) {
+      auto *Definition = llvm::dyn_cast<Instruction>(Operand);
+      if (Definition == nullptr)
+        continue;
+
+      uint32_t OperandIndex = Indices.lookup(Definition);
+      uint32_t &Alive = Values[OperandIndex];
+      if (Updated > Alive) {
+        Alive = Updated;
+        if (not Pending.test(OperandIndex)) {
+          Pending.set(OperandIndex);
+          Worklist.push_back(OperandIndex);
+        }
+      }
+    }
+  }
+
+  BitLivenessAnalysisResults Result;
+  for (uint32_t I = 0; I < Instructions.size(); ++I)
+    Result[Instructions[I]] = transferInstruction(Instructions[I], Values[I]);
+
+  return Result;
+}
+
+BitLivenessAnalysisResults computeBitLiveness(llvm::Function &F) {
+  if (Sparse)
+    return computeSparseBitLiveness(F);
+
   GenericGraph<DataFlowNode> DataFlowGraph = buildDataFlowGraph(F);
   std::vector<DataFlowNode *> ExtremalLabels;
   for (DataFlowNode *Node : DataFlowGraph.nodes()) {
@@ -263,20 +331,25 @@ BitLivenessPass::run(llvm::Function &F, llvm::FunctionAnalysisManager &) {
     }
   }
 
-  auto MFPResults = getMaximalFixedPoint<BitLivenessAnalysis>(&DataFlowGraph,
-                                                              0,
-                                                              Top,
-                                                              ExtremalLabels);
-  BitLivenessPass::Result Result;
-  for (auto &[Label, MFPResult] : MFPResults)
+  using BLA = BitLivenessAnalysis;
+  auto MFPResults = getMaximalFixedPointDense<BLA>(&DataFlowGraph,
+                                                   0,
+                                                   Top,
+                                                   ExtremalLabels);
+  BitLivenessAnalysisResults Result;
+  for (auto [Label, MFPResult] : MFPResults.entries())
     Result[Label->Instruction] = MFPResult.OutValue;
 
   return Result;
 }
 
+BitLivenessPass::Result
+BitLivenessPass::run(llvm::Function &F, llvm::FunctionAnalysisManager &) {
+  return computeBitLiveness(F);
+}
+
 bool BitLivenessWrapperPass::runOnFunction(llvm::Function &F) {
-  llvm::FunctionAnalysisManager FAM;
-  Result = BitLivenessPass().run(F, FAM);
+  Result = computeBitLiveness(F);
   return false;
 }
 
@@ -19,9 +19,11 @@
 #include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/CommandLine.h"
 
+#include "revng/Support/ParallelFunctionPipeline.h"
 #include "revng/TypeShrinking/BitLiveness.h"
 #include "revng/TypeShrinking/DataFlowGraph.h"
 #include "revng/TypeShrinking/MFP.h"
@@ -38,12 +40,29 @@ static cl::opt<uint32_t> MinimumWidth("min-width",
                                       cl::value_desc("min-width"),
                                       cl::cat(MainCategory));
 
+static cl::opt<unsigned> ThreadsCount("type-shrinking-threads",
+                                      cl::init(1),
+                                      cl::desc("number of threads computing "
+                                               "the bit liveness of "
+                                               "independent functions"),
+                                      cl::value_desc("threads"),
+                                      cl::cat(MainCategory));
+
 char TypeShrinking::TypeShrinkingWrapperPass::ID = 0;
+char TypeShrinking::TypeShrinkingModuleWrapperPass::ID = 0;
 
 using Register = RegisterPass<TypeShrinking::TypeShrinkingWrapperPass>;
 static Register
   X("type-shrinking", "Run the type shrinking analysis", true, true);
 
+using TypeShrinking::TypeShrinkingModuleWrapperPass;
+using RegisterModule = RegisterPass<TypeShrinkingModuleWrapperPass>;
+static RegisterModule Y("type-shrinking-module",
+                        "Run the type shrinking analysis on all the "
+                        "functions, computing bit liveness in parallel",
+                        false,
+                        false);
+
 namespace TypeShrinking {
 
 void TypeShrinkingWrapperPass::getAnalysisUsage(AnalysisUsage &AU) const {
@@ -137,6 +156,38 @@ bool TypeShrinkingWrapperPass::runOnFunction(Function &F) {
   return runTypeShrinking(F, FixedPoints);
 }
 
+static bool runTypeShrinkingOnModule(Module &M) {
+  std::vector<Function *> Functions;
+  for (Function &F : M)
+    if (not F.isDeclaration())
+      Functions.push_back(&F);
+
+  // Computing the bit liveness doesn't touch the IR, so all the functions can
+  // be analyzed concurrently. Shrinking creates new instructions and
+  // constants, so it's performed on this thread.
+  auto Register = [](FunctionAnalysisManager &FAM) {
+    FAM.registerPass([] { return BitLivenessPass(); });
+  };
+  auto Analyze = [](Function &F, FunctionAnalysisManager &FAM) {
+    return std::move(FAM.getResult<BitLivenessPass>(F));
+  };
+  return runFunctionPipeline(Functions,
+                             ThreadsCount,
+                             Register,
+                             Analyze,
+                             runTypeShrinking);
+}
+
+bool TypeShrinkingModuleWrapperPass::runOnModule(Module &M) {
+  return runTypeShrinkingOnModule(M);
+}
+
+PreservedAnalyses TypeShrinkingModulePass::run(Module &M,
+                                               ModuleAnalysisManager &) {
+  bool HasChanges = runTypeShrinkingOnModule(M);
+  return HasChanges ? PreservedAnalyses::none() : PreservedAnalyses::all();
+}
+
 PreservedAnalyses
 TypeShrinkingPass::run(Function &F, FunctionAnalysisManager &FAM) {
   const auto &FixedPoints = FAM.getResult<BitLivenessPass>(F);
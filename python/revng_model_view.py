@@ -0,0 +1,363 @@
+#
+# This file is distributed under the MIT License. See LICENSE.md for details.
+#
+
+"""Lazy, read-only views over a binary-encoded model.
+
+The model (as produced by `-binary-model -model-output=<path>`) is
+memory-mapped by librevngModelView and nothing is decoded until it's accessed:
+scanning the entry addresses of the functions only touches their keys.
+
+    with Model("model.bin") as model:
+        for function in model.functions:
+            print(function.entry, function.prototype)
+
+Views must not outlive the model they come from.
+"""
+
+import ctypes
+import os
+import sys
+from collections.abc import Sequence
+
+class Node(ctypes.Structure):
+    _fields_ = [("offset", ctypes.c_uint64), ("size", ctypes.c_uint64)]
+
+class String(ctypes.Structure):
+    _fields_ = [("data", ctypes.c_void_p), ("size", ctypes.c_size_t)]
+
+# Keep in sync with revng/ModelView/ModelView.h
+BINARY_FUNCTIONS = 0
+BINARY_TYPES = 1
+BINARY_PARTIAL_LIFTING = 2
+BINARY_ANALYSIS_FINGERPRINT = 3
+
+FUNCTION_CUSTOM_NAME = 1
+FUNCTION_TYPE = 2
+FUNCTION_CFG = 3
+FUNCTION_PROTOTYPE = 4
+FUNCTION_MERGED_INTO = 5
+
+BASIC_BLOCK_END = 1
+BASIC_BLOCK_CUSTOM_NAME = 2
+BASIC_BLOCK_SUCCESSORS = 3
+
+FUNCTION_EDGE_DESTINATION = 0
+FUNCTION_EDGE_TYPE = 1
+CALL_EDGE_PROTOTYPE = 2
+
+TYPE_KIND = 0
+TYPE_ID = 1
+
+# Keep in sync with the enumerations in revng/Model/Binary.h and
+# revng/Model/Type.h
+FUNCTION_TYPES = ["Invalid", "Regular", "NoReturn", "Fake"]
+
+FUNCTION_EDGE_TYPES = ["Invalid", "DirectBranch", "FakeFunctionCall",
+                       "FakeFunctionReturn", "FunctionCall", "IndirectCall",
+                       "Return", "BrokenReturn", "IndirectTailCall", "LongJmp",
+                       "Killer", "Unreachable"]
+
+TYPE_KINDS = ["Invalid", "Primitive", "Enum", "Typedef", "Struct", "Union",
+              "CABIFunctionType", "RawFunctionType"]
+
+# Index plus one of CallEdge in concrete_types_traits<model::FunctionEdge>
+CALL_EDGE = 1
+
+def load_library():
+    # librevngModelView lives in lib/, this module in lib/python/
+    path = os.environ.get("REVNG_MODEL_VIEW_LIBRARY")
+    if path is None:
+        path = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                            os.pardir,
+                            "librevngModelView.so")
+
+    library = ctypes.CDLL(path)
+
+    model = ctypes.c_void_p
+    node = Node
+    node_pointer = ctypes.POINTER(Node)
+    prototypes = {
+        "revng_model_open": (model, [ctypes.c_char_p]),
+        "revng_model_close": (None, [model]),
+        "revng_model_root": (node, [model]),
+        "revng_model_field": (ctypes.c_bool,
+                              [model, node, ctypes.c_uint64, node_pointer]),
+        "revng_model_count": (ctypes.c_uint64, [model, node]),
+        "revng_model_element": (ctypes.c_bool,
+                                [model,
+                                 node,
+                                 ctypes.c_uint64,
+                                 node_pointer,
+                                 node_pointer]),
+        "revng_model_upcast": (ctypes.c_bool,
+                               [model,
+                                node,
+                                ctypes.POINTER(ctypes.c_uint64),
+                                node_pointer]),
+        "revng_model_unsigned": (ctypes.c_bool,
+                                 [model,
+                                  node,
+                                  ctypes.POINTER(ctypes.c_uint64)]),
+        "revng_model_signed": (ctypes.c_bool,
+                               [model, node, ctypes.POINTER(ctypes.c_int64)]),
+        "revng_model_scalar": (ctypes.c_bool,
+                               [model, node, ctypes.POINTER(String)]),
+    }
+
+    for name, (result, arguments) in prototypes.items():
+        function = getattr(library, name)
+        function.restype = result
+        function.argtypes = arguments
+
+    return library
+
+_library = None
+
+def library():
+    global _library
+    if _library is None:
+        _library = load_library()
+    return _library
+
+class MalformedModel(Exception):
+    pass
+
+class Model:
+    """A binary-encoded model::Binary"""
+
+    def __init__(self, path):
+        self.handle = library().revng_model_open(os.fsencode(path))
+        if not self.handle:
+            raise MalformedModel(f"{path} is not a binary-encoded model")
+        self.root = library().revng_model_root(self.handle)
+
+    def close(self):
+        if self.handle:
+            library().revng_model_close(self.handle)
+            self.handle = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def __del__(self):
+        self.close()
+
+    @property
+    def functions(self):
+        return Container(self, self.field(self.root, BINARY_FUNCTIONS), Function)
+
+    @property
+    def types(self):
+        return Container(self, self.field(self.root, BINARY_TYPES), Type)
+
+    @property
+    def partial_lifting(self):
+        return bool(self.unsigned(self.field(self.root, BINARY_PARTIAL_LIFTING),
+                                  0))
+
+    @property
+    def analysis_fingerprint(self):
+        node = self.field(self.root, BINARY_ANALYSIS_FINGERPRINT)
+        return self.scalar(node, "")
+
+    #
+    # Decoding of the nodes, missing fields take the default value
+    #
+
+    def field(self, node, index):
+        if node is None:
+            return None
+        result = Node()
+        if not library().revng_model_field(self.handle, node, index, result):
+            return None
+        return result
+
+    def count(self, node):
+        if node is None:
+            return 0
+        return library().revng_model_count(self.handle, node)
+
+    def element(self, node, index):
+        key = Node()
+        value = Node()
+        if not library().revng_model_element(self.handle,
+                                             node,
+                                             index,
+                                             key,
+                                             value):
+            raise MalformedModel("Couldn't index a container")
+        return key, value
+
+    def upcast(self, node):
+        concrete_type = ctypes.c_uint64()
+        value = Node()
+        if not library().revng_model_upcast(self.handle,
+                                            node,
+                                            concrete_type,
+                                            value):
+            raise MalformedModel("Couldn't decode an UpcastablePointer")
+        return concrete_type.value, value
+
+    def unsigned(self, node, default=None):
+        if node is None:
+            return default
+        result = ctypes.c_uint64()
+        if not library().revng_model_unsigned(self.handle, node, result):
+            raise MalformedModel("Couldn't decode an integer")
+        return result.value
+
+    def scalar(self, node, default=None):
+        if node is None:
+            return default
+        result = String()
+        if not library().revng_model_scalar(self.handle, node, result):
+            raise MalformedModel("Couldn't decode a scalar")
+        return ctypes.string_at(result.data, result.size).decode("utf-8")
+
+    def enumeration(self, node, names):
+        value = self.unsigned(node, 0)
+        return names[value] if value < len(names) else str(value)
+
+class Container(Sequence):
+    """A KeyedObjectContainer, sorted by key"""
+
+    def __init__(self, model, node, view):
+        self.model = model
+        self.node = node
+        self.view = view
+        self.length = model.count(node)
+
+    def __len__(self):
+        return self.length
+
+    def __getitem__(self, index):
+        if isinstance(index, slice):
+            return [self[i] for i in range(*index.indices(self.length))]
+
+        if index < 0:
+            index += self.length
+        if not 0 <= index < self.length:
+            raise IndexError("Container index out of range")
+
+        key, value = self.model.element(self.node, index)
+        return self.view(self.model, key, value)
+
+class View:
+    def __init__(self, model, key, node):
+        self.model = model
+        self.key = key
+        self.node = node
+
+    def field(self, index):
+        return self.model.field(self.node, index)
+
+    def scalar(self, index, default=None):
+        return self.model.scalar(self.field(index), default)
+
+class Function(View):
+    @property
+    def entry(self):
+        # The key, no need to look into the function
+        return self.model.scalar(self.key)
+
+    @property
+    def custom_name(self):
+        return self.scalar(FUNCTION_CUSTOM_NAME, "")
+
+    @property
+    def type(self):
+        return self.model.enumeration(self.field(FUNCTION_TYPE),
+                                      FUNCTION_TYPES)
+
+    @property
+    def prototype(self):
+        return self.scalar(FUNCTION_PROTOTYPE, "")
+
+    @property
+    def merged_into(self):
+        return self.scalar(FUNCTION_MERGED_INTO, ":Invalid")
+
+    @property
+    def cfg(self):
+        return Container(self.model, self.field(FUNCTION_CFG), BasicBlock)
+
+class BasicBlock(View):
+    @property
+    def start(self):
+        return self.model.scalar(self.key)
+
+    @property
+    def end(self):
+        return self.scalar(BASIC_BLOCK_END, ":Invalid")
+
+    @property
+    def custom_name(self):
+        return self.scalar(BASIC_BLOCK_CUSTOM_NAME, "")
+
+    @property
+    def successors(self):
+        return Container(self.model,
+                         self.field(BASIC_BLOCK_SUCCESSORS),
+                         FunctionEdge)
+
+class FunctionEdge(View):
+    def __init__(self, model, key, node):
+        concrete_type, node = model.upcast(node)
+        super().__init__(model, key, node)
+        self.is_call = concrete_type == CALL_EDGE
+
+    @property
+    def destination(self):
+        return self.scalar(FUNCTION_EDGE_DESTINATION, ":Invalid")
+
+    @property
+    def type(self):
+        return self.model.enumeration(self.field(FUNCTION_EDGE_TYPE),
+                                      FUNCTION_EDGE_TYPES)
+
+    @property
+    def prototype(self):
+        """The prototype of a call edge, or None"""
+        if not self.is_call:
+            return None
+        return self.scalar(CALL_EDGE_PROTOTYPE, "")
+
+class Type(View):
+    """A model::Type, only its key is exposed: the other fields depend on the
+    kind of the type"""
+
+    def __init__(self, model, key, node):
+        _, node = model.upcast(node)
+        super().__init__(model, key, node)
+
+    @property
+    def kind(self):
+        return self.model.enumeration(self.model.field(self.key, TYPE_KIND),
+                                      TYPE_KINDS)
+
+    @property
+    def id(self):
+        return self.model.unsigned(self.model.field(self.key, TYPE_ID), 0)
+
+    @property
+    def path(self):
+        """The reference to this type, as in Function.prototype"""
+        return f"/Types/{self.kind}-{self.id}"
+
+def main():
+    if len(sys.argv) != 2:
+        sys.stderr.write(f"Usage: {sys.argv[0]} MODEL\n")
+        return 1
+
+    with Model(sys.argv[1]) as model:
+        for function in model.functions:
+            print(function.entry, function.prototype)
+
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -5,8 +5,11 @@
 #include <assert.h>
 #include <elf.h>
 #include <endian.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <pthread.h>
+#include <semaphore.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -14,6 +17,7 @@
 #include <string.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <sys/types.h>
 #include <sys/ucontext.h>
 #include <unistd.h>
@@ -265,16 +269,89 @@ void unknownPC(PlainMetaAddress *PC) {
 #ifdef TRACE
 
 // Execution tracing support
+//
+// Program counters are recorded in one of two buffers. Once it's full, it's
+// handed over to a background thread, which writes it out, while the program
+// keeps going on the other buffer. The program blocks only if the background
+// thread is not done yet with the previous buffer.
+//
+// Set REVNG_TRACE_FORMAT to choose how program counters are recorded:
+//
+// * raw (default): a 64-bit little endian integer for each instruction.
+// * compact: a header followed by, for each instruction, the difference from
+//   the previous program counter, zigzag and LEB128 encoded.
+// * blocks: same as compact, but only the first instruction after a change in
+//   the control flow is recorded. Instructions executed by falling through the
+//   previous one are omitted.
+//
+// Compact traces can be decoded with revng-decode-trace.
+enum trace_format { TRACE_RAW, TRACE_COMPACT, TRACE_BLOCKS };
+
+// "RVNGTRC" followed by a NUL character
+static const char trace_magic[8] = "RVNGTRC";
+static const uint32_t trace_version = 1;
+static const uint32_t trace_flag_blocks = 1;
+
 static int trace_fd = -1;
-static size_t trace_buffer_size = 1024 * 1024;
+static enum trace_format trace_format = TRACE_RAW;
+static size_t trace_buffer_size = 1024 * 1024 * sizeof(uint64_t);
 static size_t trace_buffer_index = 0;
-static uint64_t *trace_buffer;
+static size_t trace_max_record_size = sizeof(uint64_t);
+static uint8_t *trace_buffer;
+
+// State for delta encoding
+static uint64_t trace_last_pc = 0;
+static uint64_t trace_next_pc = 0;
+
+// The buffer owned by the background thread
+static uint8_t *pending_trace_buffer;
+static size_t pending_trace_buffer_index = 0;
+
+// Posted when pending_trace_buffer has to be written out
+static sem_t trace_buffer_full;
+
+// Posted when pending_trace_buffer has been written out
+static sem_t trace_buffer_free;
 
 static void flush_trace_buffer(void);
 
 void flush_trace_buffer(void);
 void flush_trace_buffer_signal_handler(int signal);
 
+static void write_trace(const uint8_t *data, size_t size) {
+  while (size > 0) {
+    ssize_t written = write(trace_fd, data, size);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      return;
+    }
+
+    data += written;
+    size -= written;
+  }
+}
+
+static void wait_semaphore(sem_t *semaphore) {
+  while (sem_wait(semaphore) != 0)
+    assert(errno == EINTR);
+}
+
+static void *trace_writer(void *argument) {
+  // Signals have to be handled by the program, we would deadlock otherwise
+  sigset_t all_signals;
+  sigfillset(&all_signals);
+  pthread_sigmask(SIG_BLOCK, &all_signals, NULL);
+
+  while (true) {
+    wait_semaphore(&trace_buffer_full);
+    write_trace(pending_trace_buffer, pending_trace_buffer_index);
+    sem_post(&trace_buffer_free);
+  }
+
+  return NULL;
+}
+
 void init_tracing(void) {
   // If REVNG_TRACE_PATH contains a path, enable tracing
   char *trace_path = getenv("REVNG_TRACE_PATH");
@@ -285,18 +362,59 @@ void init_tracing(void) {
     assert(trace_fd != -1);
 
     // Set REVNG_TRACE_BUFFER_SIZE to customimze buffer size, default is 1024
-    // * 1024 instructions
+    // * 1024 instructions in raw format
     char *trace_buffer_size_string = getenv("REVNG_TRACE_BUFFER_SIZE");
     if (trace_buffer_size_string != NULL
         && strlen(trace_buffer_size_string) > 0) {
       char **first_invalid = NULL;
       trace_buffer_size = strtoll(trace_buffer_size_string, first_invalid, 0);
       assert(**first_invalid == '\0');
+      trace_buffer_size *= sizeof(uint64_t);
     }
 
-    // Allocate buffer to hold program counters
-    trace_buffer = malloc(trace_buffer_size * sizeof(uint64_t));
+    char *trace_format_string = getenv("REVNG_TRACE_FORMAT");
+    if (trace_format_string != NULL && strlen(trace_format_string) > 0) {
+      if (strcmp(trace_format_string, "raw") == 0) {
+        trace_format = TRACE_RAW;
+      } else if (strcmp(trace_format_string, "compact") == 0) {
+        trace_format = TRACE_COMPACT;
+      } else if (strcmp(trace_format_string, "blocks") == 0) {
+        trace_format = TRACE_BLOCKS;
+      } else {
+        assert(false && "Unknown REVNG_TRACE_FORMAT");
+      }
+    }
+
+    // A LEB128-encoded 64-bit integer takes up to 10 bytes
+    if (trace_format != TRACE_RAW)
+      trace_max_record_size = 10;
+    if (trace_buffer_size < trace_max_record_size)
+      trace_buffer_size = trace_max_record_size;
+
+    // Allocate the buffers to hold program counters
+    trace_buffer = malloc(trace_buffer_size);
     assert(trace_buffer != NULL);
+    pending_trace_buffer = malloc(trace_buffer_size);
+    assert(pending_trace_buffer != NULL);
+
+    // Compact formats start with an header
+    if (trace_format != TRACE_RAW) {
+      uint32_t flags = trace_format == TRACE_BLOCKS ? trace_flag_blocks : 0;
+      uint32_t header[2] = { htole32(trace_version), htole32(flags) };
+      write_trace((const uint8_t *) trace_magic, sizeof(trace_magic));
+      write_trace((const uint8_t *) header, sizeof(header));
+    }
+
+    // Start the background thread, initially the pending buffer is free
+    int result = sem_init(&trace_buffer_full, 0, 0);
+    assert(result == 0);
+    result = sem_init(&trace_buffer_free, 0, 1);
+    assert(result == 0);
+    pthread_t writer;
+    result = pthread_create(&writer, NULL, trace_writer, NULL);
+    assert(result == 0);
+    result = pthread_detach(writer);
+    assert(result == 0);
 
     // In case of a crash, flush the buffer
     static const int signals[] = { SIGINT, SIGABRT, SIGTERM, SIGSEGV };
@@ -311,18 +429,37 @@ void init_tracing(void) {
     }
 
     // Upon exit, flush the buffer too
-    int result = atexit(flush_trace_buffer);
+    result = atexit(flush_trace_buffer);
     assert(result == 0);
   }
 }
 
+// Hand over the current buffer to the background thread
+static void swap_trace_buffers(void) {
+  wait_semaphore(&trace_buffer_free);
+
+  uint8_t *full = trace_buffer;
+  trace_buffer = pending_trace_buffer;
+  pending_trace_buffer = full;
+  pending_trace_buffer_index = trace_buffer_index;
+  trace_buffer_index = 0;
+
+  sem_post(&trace_buffer_full);
+}
+
+// Write out everything synchronously, since we might be about to terminate
 static void flush_trace_buffer(void) {
-  if (trace_fd == -1 || trace_buffer_index == 0)
+  if (trace_fd == -1)
     return;
 
+  // Wait for the background thread to be done with the pending buffer
+  wait_semaphore(&trace_buffer_free);
+
   // Write the all buffer out and reset the counter
-  write(trace_fd, trace_buffer, sizeof(uint64_t) * trace_buffer_index);
+  write_trace(trace_buffer, trace_buffer_index);
   trace_buffer_index = 0;
+
+  sem_post(&trace_buffer_free);
 }
 
 void flush_trace_buffer_signal_handler(int signal) {
@@ -343,12 +480,274 @@ void newpc(uint64_t pc,
   if (trace_fd == -1)
     return;
 
-  // Record the program counter
-  trace_buffer[trace_buffer_index++] = pc;
+  // Make sure there's room for the longest record
+  if (trace_buffer_index + trace_max_record_size > trace_buffer_size)
+    swap_trace_buffers();
 
-  // If the buffer is full, flush it out
-  if (trace_buffer_index >= trace_buffer_size)
-    flush_trace_buffer();
+  if (trace_format == TRACE_RAW) {
+    // Record the program counter
+    uint64_t value = htole64(pc);
+    memcpy(trace_buffer + trace_buffer_index, &value, sizeof(value));
+    trace_buffer_index += sizeof(value);
+    return;
+  }
+
+  // Skip instructions we reached falling through, if requested
+  uint64_t expected_pc = trace_next_pc;
+  trace_next_pc = pc + instruction_size;
+  if (trace_format == TRACE_BLOCKS && pc == expected_pc)
+    return;
+
+  // Record the zigzag-encoded difference from the previous program counter
+  int64_t delta = (int64_t) (pc - trace_last_pc);
+  uint64_t value = ((uint64_t) delta << 1) ^ (uint64_t) (delta >> 63);
+  trace_last_pc = pc;
+
+  while (value >= 0x80) {
+    trace_buffer[trace_buffer_index++] = (uint8_t) (value | 0x80);
+    value >>= 7;
+  }
+  trace_buffer[trace_buffer_index++] = (uint8_t) value;
+}
+
+#else
+
+#if defined(PROFILE) || defined(SAMPLE)
+
+// Formatting routines safe to use in a signal handler
+static char *format_hex(char *output, uint64_t value) {
+  char digits[16];
+  int count = 0;
+  do {
+    digits[count++] = "0123456789abcdef"[value % 16];
+    value /= 16;
+  } while (value != 0);
+
+  *output++ = '0';
+  *output++ = 'x';
+  while (count > 0)
+    *output++ = digits[--count];
+  return output;
+}
+
+static char *format_decimal(char *output, uint64_t value) {
+  char digits[20];
+  int count = 0;
+  do {
+    digits[count++] = '0' + value % 10;
+    value /= 10;
+  } while (value != 0);
+
+  while (count > 0)
+    *output++ = digits[--count];
+  return output;
+}
+
+// Function dumping the collected data upon exit or termination
+static void (*dump_results)(void) = NULL;
+
+static void dump_results_signal_handler(int signal) {
+  dump_results();
+
+  // Proceed with the default behavior
+  struct sigaction default_action;
+  memset(&default_action, 0, sizeof(default_action));
+  default_action.sa_handler = SIG_DFL;
+  sigaction(signal, &default_action, NULL);
+  raise(signal);
+}
+
+static void register_dump_results(void (*dump)(void)) {
+  dump_results = dump;
+
+  // In case of a crash, dump the results
+  static const int signals[] = { SIGINT, SIGABRT, SIGTERM };
+  for (unsigned c = 0; c < sizeof(signals) / sizeof(int); c++) {
+    struct sigaction new_handler;
+    memset(&new_handler, 0, sizeof(new_handler));
+    new_handler.sa_handler = dump_results_signal_handler;
+    int result = sigaction(signals[c], &new_handler, NULL);
+    assert(result == 0);
+  }
+
+  // Upon exit, dump the results too
+  int result = atexit(dump);
+  assert(result == 0);
+}
+
+// This function is called by the syscall helpers in case of exit/exit_group
+void on_exit_syscall(void) {
+  if (dump_results != NULL)
+    dump_results();
+}
+
+#endif
+
+#ifdef PROFILE
+
+// Basic block counters support
+//
+// When lifting with -block-counters, each jump target increments its own entry
+// of revng_block_counters. At exit, the non-zero counters are dumped to the path
+// specified by REVNG_PROFILE_PATH, one "address,count" line for each of them.
+extern uint64_t revng_block_counters[] __attribute__((weak));
+extern const uint64_t revng_block_counters_pcs[] __attribute__((weak));
+extern const uint64_t revng_block_counters_count __attribute__((weak));
+
+static const char *profile_path = NULL;
+
+static void dump_block_counters(void) {
+  if (profile_path == NULL || &revng_block_counters_count == NULL)
+    return;
+
+  int fd = open(profile_path,
+                O_WRONLY | O_CREAT | O_TRUNC,
+                S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  if (fd == -1)
+    return;
+
+  for (uint64_t i = 0; i < revng_block_counters_count; i++) {
+    if (revng_block_counters[i] == 0)
+      continue;
+
+    char line[64];
+    char *end = format_hex(line, revng_block_counters_pcs[i]);
+    *end++ = ',';
+    end = format_decimal(end, revng_block_counters[i]);
+    *end++ = '\n';
+    write(fd, line, end - line);
+  }
+
+  close(fd);
+}
+
+void init_tracing(void) {
+  // If REVNG_PROFILE_PATH contains a path, enable profiling
+  char *path = getenv("REVNG_PROFILE_PATH");
+  if (path == NULL || strlen(path) == 0)
+    return;
+
+  if (&revng_block_counters_count == NULL) {
+    fprintf(stderr, "Warning: the program has no block counters\n");
+    return;
+  }
+
+  profile_path = path;
+  register_dump_results(dump_block_counters);
+}
+
+#elif defined(SAMPLE)
+
+// Sampling support
+//
+// Every REVNG_SAMPLE_PERIOD microseconds of CPU time (1000 by default), a
+// SIGPROF records the guest program counter of the instruction being executed,
+// as reported by the last call to newpc, along with the host program counter.
+// Samples are stored in a ring buffer of REVNG_SAMPLE_BUFFER_SIZE entries
+// (65536 by default), therefore only the most recent ones are kept. At exit,
+// the samples are dumped to the path specified by REVNG_SAMPLE_PATH, one
+// "guest_pc,host_pc" line for each of them, oldest first.
+struct sample {
+  uint64_t guest_pc;
+  uint64_t host_pc;
+};
+
+static const char *sample_path = NULL;
+static struct sample *samples = NULL;
+static uint64_t samples_capacity = 0;
+static volatile uint64_t samples_count = 0;
+static volatile uint64_t current_guest_pc = 0;
+
+static uint64_t get_host_pc(void *opaque_context) {
+  ucontext_t *context = opaque_context;
+#if defined(__x86_64__) && defined(REG_RIP)
+  return context->uc_mcontext.gregs[REG_RIP];
+#elif defined(__riscv) && defined(REG_PC)
+  return context->uc_mcontext.__gregs[REG_PC];
+#else
+  (void) context;
+  return 0;
+#endif
+}
+
+static void handle_sigprof(int signo, siginfo_t *info, void *opaque_context) {
+  uint64_t index = samples_count;
+  struct sample *entry = &samples[index % samples_capacity];
+  entry->guest_pc = current_guest_pc;
+  entry->host_pc = get_host_pc(opaque_context);
+  samples_count = index + 1;
+}
+
+static void dump_samples(void) {
+  if (sample_path == NULL)
+    return;
+
+  // Stop sampling
+  struct itimerval disabled;
+  memset(&disabled, 0, sizeof(disabled));
+  setitimer(ITIMER_PROF, &disabled, NULL);
+
+  int fd = open(sample_path,
+                O_WRONLY | O_CREAT | O_TRUNC,
+                S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  if (fd == -1)
+    return;
+
+  uint64_t count = samples_count;
+  uint64_t first = count > samples_capacity ? count - samples_capacity : 0;
+  for (uint64_t i = first; i < count; i++) {
+    struct sample *entry = &samples[i % samples_capacity];
+
+    char line[64];
+    char *end = format_hex(line, entry->guest_pc);
+    *end++ = ',';
+    end = format_hex(end, entry->host_pc);
+    *end++ = '\n';
+    write(fd, line, end - line);
+  }
+
+  close(fd);
+}
+
+static uint64_t get_sample_option(const char *name, uint64_t default_value) {
+  char *value = getenv(name);
+  if (value == NULL || strlen(value) == 0)
+    return default_value;
+
+  uint64_t result = strtoull(value, NULL, 0);
+  assert(result != 0);
+  return result;
+}
+
+void init_tracing(void) {
+  // If REVNG_SAMPLE_PATH contains a path, enable sampling
+  char *path = getenv("REVNG_SAMPLE_PATH");
+  if (path == NULL || strlen(path) == 0)
+    return;
+
+  uint64_t period = get_sample_option("REVNG_SAMPLE_PERIOD", 1000);
+  samples_capacity = get_sample_option("REVNG_SAMPLE_BUFFER_SIZE", 64 * 1024);
+  samples = calloc(samples_capacity, sizeof(struct sample));
+  assert(samples != NULL);
+
+  sample_path = path;
+  register_dump_results(dump_samples);
+
+  // SA_RESTART avoids spurious EINTRs in the syscalls of the program
+  struct sigaction sigprof_handler;
+  memset(&sigprof_handler, 0, sizeof(sigprof_handler));
+  sigprof_handler.sa_sigaction = &handle_sigprof;
+  sigemptyset(&sigprof_handler.sa_mask);
+  sigprof_handler.sa_flags = SA_SIGINFO | SA_RESTART;
+  int result = sigaction(SIGPROF, &sigprof_handler, NULL);
+  assert(result == 0);
+
+  struct itimerval timer;
+  timer.it_interval.tv_sec = period / 1000000;
+  timer.it_interval.tv_usec = period % 1000000;
+  timer.it_value = timer.it_interval;
+  result = setitimer(ITIMER_PROF, &timer, NULL);
+  assert(result == 0);
 }
 
 #else
@@ -359,26 +758,115 @@ void init_tracing(void) {
 void on_exit_syscall(void) {
 }
 
+#endif
+
 void newpc(uint64_t pc,
            uint64_t instruction_size,
            uint32_t is_first,
            uint8_t *vars,
            ...) {
+#ifdef SAMPLE
+  current_guest_pc = pc;
+#endif
 }
 
 #endif
 
+// Zero-filled pages of the segments, which are not part of the executable.
+// For each of them, zero_segments contains the start address, the end address
+// and whether they are writeable.
+extern const uint64_t zero_segments[] __attribute__((weak));
+extern const uint64_t zero_segments_count __attribute__((weak));
+
+// Map the zero-filled pages of the segments, the kernel will allocate them on
+// first access
+static void map_zero_segments(void) {
+  if (&zero_segments_count == NULL)
+    return;
+
+  long page_size = sysconf(_SC_PAGESIZE);
+  assert(page_size > 0);
+
+  for (uint64_t i = 0; i < zero_segments_count; i++) {
+    uint64_t start = zero_segments[3 * i];
+    uint64_t end = zero_segments[3 * i + 1];
+    bool writeable = zero_segments[3 * i + 2] != 0;
+    assert(start % page_size == 0);
+
+    uint64_t size = (end - start + page_size - 1) & ~(page_size - 1);
+    int protection = PROT_READ | (writeable ? PROT_WRITE : 0);
+    void *result = mmap((void *) (uintptr_t) start,
+                        size,
+                        protection,
+                        MAP_ANONYMOUS | MAP_PRIVATE | MAP_FIXED_NOREPLACE,
+                        -1,
+                        0);
+    assert(result == (void *) (uintptr_t) start);
+  }
+}
+
+// Executable segments sorted by start address, built by init_segments
+struct segment {
+  uint64_t start;
+  uint64_t end;
+};
+
+static struct segment *sorted_segments = NULL;
+
+// Index in sorted_segments of the segment last found by is_executable
+static uint64_t last_hit_segment = 0;
+
+static int compare_segments(const void *a, const void *b) {
+  const struct segment *left = a;
+  const struct segment *right = b;
+  if (left->start < right->start)
+    return -1;
+  return left->start > right->start;
+}
+
+static void init_segments(void) {
+  assert(segments_count != 0);
+
+  sorted_segments = malloc(segments_count * sizeof(struct segment));
+  assert(sorted_segments != NULL);
+
+  for (uint64_t i = 0; i < segments_count; i++) {
+    sorted_segments[i].start = segment_boundaries[2 * i];
+    sorted_segments[i].end = segment_boundaries[2 * i + 1];
+  }
+
+  qsort(sorted_segments,
+        segments_count,
+        sizeof(struct segment),
+        compare_segments);
+}
+
 // Check if the target address is inside an executable segment,
 // if so serialize and jump
 bool is_executable(uint64_t pc) {
-  assert(segments_count != 0);
+  assert(sorted_segments != NULL);
+
+  // Consecutive lookups usually hit the same segment
+  struct segment *last = &sorted_segments[last_hit_segment];
+  if (pc >= last->start && pc < last->end)
+    return true;
+
+  // Find the last segment starting at or before pc
+  uint64_t low = 0;
+  uint64_t high = segments_count;
+  while (low < high) {
+    uint64_t middle = low + (high - low) / 2;
+    if (sorted_segments[middle].start <= pc)
+      low = middle + 1;
+    else
+      high = middle;
+  }
 
-  // Check if the pc is inside one of the executable segments
-  for (int i = 0; i < segments_count; i++)
-    if (pc >= segment_boundaries[2 * i] && pc < segment_boundaries[2 * i + 1])
-      return true;
+  if (low == 0 || pc >= sorted_segments[low - 1].end)
+    return false;
 
-  return false;
+  last_hit_segment = low - 1;
+  return true;
 }
 
 void handle_sigsegv(int signo, siginfo_t *info, void *opaque_context) {
@@ -411,6 +899,10 @@ int main(int argc, char *argv[]) {
   saved_argc = argc;
   saved_argv = argv;
 
+  // Map the zero-filled pages of the segments before any other allocation
+  // might take their place
+  map_zero_segments();
+
   // Initialize the tracing system
   init_tracing();
 
@@ -441,6 +933,9 @@ int main(int argc, char *argv[]) {
   // Initialize the syscall system
   syscall_init();
 
+  // Prepare the executable segments lookup table
+  init_segments();
+
   // Implant custom SIGSEGV handler
   install_sigsegv_handler();
 
@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+
+# This script runs a command, records its wall time and peak RSS in a JSON file
+# and compares them against a baseline. If the command is slower or bigger than
+# the baseline beyond the tolerance, a warning is printed or, in fail mode, the
+# script fails. This is used to catch performance regressions in the tests.
+#
+# The exit code of the command is always propagated.
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import time
+
+METRICS = [("wall-time", "s"), ("peak-rss", "KiB")]
+
+def log(message):
+  sys.stderr.write(message + "\n")
+
+def measure(command):
+  """Run command, return its exit code, wall time (in seconds) and peak RSS
+  (in KiB)"""
+  begin = time.monotonic()
+  process = subprocess.Popen(command)
+  # wait4 also accounts for the children spawned by the revng wrapper
+  _, status, usage = os.wait4(process.pid, 0)
+  end = time.monotonic()
+  return os.waitstatus_to_exitcode(status), end - begin, usage.ru_maxrss
+
+def regressions(baseline, measurement, tolerance, minimums):
+  """Return a description of each metric exceeding the tolerance"""
+  result = []
+  for metric, unit in METRICS:
+    if metric not in baseline:
+      continue
+
+    old = baseline[metric]
+    new = measurement[metric]
+
+    # Ignore differences too small to be meaningful
+    if new - old <= minimums[metric]:
+      continue
+
+    if new > old * (1 + tolerance / 100):
+      result.append("{} grew from {:.2f}{} to {:.2f}{} (+{:.0f}%, tolerance "
+                    "{:.0f}%)".format(metric, old, unit, new, unit,
+                                      (new / old - 1) * 100 if old > 0
+                                      else float("inf"),
+                                      tolerance))
+  return result
+
+def main():
+  parser = argparse.ArgumentParser(description="Run a command and check its \
+wall time and peak RSS against a baseline.")
+  parser.add_argument("--baseline", metavar="BASELINE", required=True,
+                      help="The JSON file with the reference measurements.")
+  parser.add_argument("--output", metavar="OUTPUT", required=True,
+                      help="Where to record the measurements.")
+  parser.add_argument("--mode", choices=["warn", "fail", "record"],
+                      default="warn",
+                      help="What to do if the tolerance is exceeded. record "
+                      + "overwrites the baseline with the measurements.")
+  parser.add_argument("--tolerance", type=float, default=25,
+                      help="Maximum growth, in percent.")
+  parser.add_argument("--minimum-wall-time", type=float, default=0.5,
+                      help="Ignore wall time growths smaller than this many "
+                      + "seconds.")
+  parser.add_argument("--minimum-peak-rss", type=float, default=16384,
+                      help="Ignore peak RSS growths smaller than this many "
+                      + "KiB.")
+  parser.add_argument("command", metavar="COMMAND", nargs=argparse.REMAINDER,
+                      help="The command to run, after --.")
+  args = parser.parse_args()
+
+  command = args.command
+  if command and command[0] == "--":
+    command = command[1:]
+  if not command:
+    log("No command specified")
+    return 1
+
+  exit_code, wall_time, peak_rss = measure(command)
+  if exit_code != 0:
+    return exit_code
+
+  measurement = {"wall-time": wall_time, "peak-rss": peak_rss}
+  with open(args.output, "w") as output:
+    json.dump(measurement, output, indent=2)
+    output.write("\n")
+
+  if args.mode == "record":
+    with open(args.baseline, "w") as baseline:
+      json.dump(measurement, baseline, indent=2)
+      baseline.write("\n")
+    return 0
+
+  if not os.path.exists(args.baseline):
+    return 0
+
+  with open(args.baseline, "r") as baseline_file:
+    baseline = json.load(baseline_file)
+
+  minimums = {"wall-time": args.minimum_wall_time,
+              "peak-rss": args.minimum_peak_rss}
+  problems = regressions(baseline, measurement, args.tolerance, minimums)
+  if not problems:
+    return 0
+
+  prefix = "Error" if args.mode == "fail" else "Warning"
+  for problem in problems:
+    log("{}: {} with respect to {}".format(prefix, problem, args.baseline))
+
+  return 1 if args.mode == "fail" else 0
+
+if __name__ == "__main__":
+  sys.exit(main())
@@ -9,6 +9,9 @@
 # Additionally, one of the nodes should have a double border ("peripheries=2")
 # to represent it's the initial node.
 #
+# For each analysis, a bit-sliced version tracking many registers at once is
+# also emitted, in a class with the "Set" suffix.
+#
 # This script works and should keep working on Python 2.7 and Python 3.
 
 # Standard imports
@@ -277,7 +280,9 @@ public:
                                             if x.attr["index"] == str(index)])
 
   result = defaultdict(lambda: [])
+  join = {}
   for v1 in lattice.nodes_iter():
+    join[(v1.name, v1.name)] = v1.name
     for v2 in lattice.nodes_iter():
       if v1 != v2:
         i1 = int(v1.attr["index"])
@@ -291,6 +296,7 @@ public:
         output = node_by_index(output)
 
         result[output].append((v1, v2))
+        join[(v1.name, v2.name)] = output.name
         assert output in result
 
   first = True
@@ -460,8 +466,179 @@ public:
 
 """.format())
 
+  # Collect, for each value, the values greater than or equal to it
+  greater = {}
+  for v1 in lattice.nodes_iter():
+    i1 = int(v1.attr["index"])
+    greater[v1.name] = sorted(v2.name
+                              for v2 in lattice.nodes_iter()
+                              if reachability[i1][int(v2.attr["index"])] != 0)
+
+  # Collect, for each transfer function, the values it changes
+  changes = {}
+  for tf in tf_names:
+    changes[tf] = sorted((edge[0].name, edge[1].name)
+                         for edge in transfer_functions[tf]
+                         if edge[0].name != edge[1].name)
+
+  out += emit_bit_sliced(name,
+                         values,
+                         bottom.name,
+                         join,
+                         greater,
+                         tf_names,
+                         changes,
+                         call_arcs)
+
   return tf_names, out
 
+def emit_bit_sliced(name, values, bottom, join, greater, tf_names, changes,
+                    call_arcs):
+  """Emit a class tracking the value of the analysis for N registers at once:
+  each value is represented by the set of registers having it, so that
+  combine and transfer are a handful of operations on bitsets"""
+  out = ""
+
+  out += ("""/// \\brief Bit-sliced version of {0}
+///
+/// Tracks N registers at once: each value of the lattice is associated to the
+/// set of registers having it.
+template<size_t N>
+class {0}Set {{
+public:
+  using Analysis = {0};
+  using Mask = std::bitset<N>;
+
+private:
+  std::array<Mask, {1}> Masks;
+
+public:
+  {0}Set() {{ Masks[Analysis::{2}].set(); }}
+
+  explicit {0}Set(Analysis::Values V) {{ Masks[V].set(); }}
+
+  Analysis::Values get(size_t Register) const {{
+""".format(name, len(values), bottom))
+
+  for value in values:
+    out += ("""    if (Masks[Analysis::{0}][Register])
+      return Analysis::{0};
+""".format(value))
+
+  out += ("""    revng_abort();
+  }
+
+  void set(size_t Register, Analysis::Values V) {
+    for (Mask &M : Masks)
+      M.reset(Register);
+    Masks[V].set(Register);
+  }
+
+  /// \\brief The registers having value \\p V
+  const Mask &registers(Analysis::Values V) const { return Masks[V]; }
+
+""")
+
+  # combine: each value of the result is the union of the pairs joining to it
+  out += ("""  void combine(const {0}Set &Other) {{
+    std::array<Mask, {1}> Result;
+""".format(name, len(values)))
+  for output in values:
+    pairs = sorted(pair for pair, result in join.items() if result == output)
+    terms = ["(Masks[Analysis::{}] & Other.Masks[Analysis::{}])".format(a, b)
+             for a, b in pairs]
+    out += ("""    Result[Analysis::{}] = {};
+""".format(output, "\n      | ".join(terms)))
+  out += ("""    Masks = Result;
+  }
+
+""")
+
+  # lowerThanOrEqual: each register must have a greater or equal value in Other
+  out += ("""  bool lowerThanOrEqual(const {0}Set &Other) const {{
+    return """.format(name))
+  conditions = []
+  for value in values:
+    allowed = " | ".join("Other.Masks[Analysis::{}]".format(v)
+                         for v in greater[value])
+    conditions.append("(Masks[Analysis::{}] & ~({})).none()".format(value,
+                                                                   allowed))
+  out += ("\n      and ".join(conditions))
+  out += (""";
+  }
+
+""")
+
+  # transfer: first detach from each source the registers moving away, then
+  # attach them to their destinations
+  def emit_transfer(prefix, tf):
+    if not changes[tf]:
+      return ("""    case {}{}:
+      break;
+
+""".format(prefix, tf))
+
+    result = ("""    case {}{}: {{
+""".format(prefix, tf))
+    for index, (source, _) in enumerate(changes[tf]):
+      result += ("""      Mask From{} = Masks[Analysis::{}] & Registers;
+""".format(index, source))
+    for index, (source, _) in enumerate(changes[tf]):
+      result += ("""      Masks[Analysis::{}] &= ~From{};
+""".format(source, index))
+    for index, (_, destination) in enumerate(changes[tf]):
+      result += ("""      Masks[Analysis::{}] |= From{};
+""".format(destination, index))
+    result += ("""    } break;
+
+""")
+    return result
+
+  out += ("""  /// \\brief Apply \\p T to the registers in \\p Registers
+  void transfer(Analysis::TransferFunction T, Mask Registers = Mask().set()) {
+    switch(T) {
+""")
+  for tf in tf_names:
+    out += emit_transfer("Analysis::", tf)
+  out += ("""    }
+  }
+
+""")
+
+  out += ("""  /// \\brief Apply \\p T to the registers in \\p Registers
+  void transfer(GeneralTransferFunction T, Mask Registers = Mask().set()) {
+    switch(T) {
+""")
+  for tf in tf_names:
+    out += emit_transfer("GeneralTransferFunction::", tf)
+  out += ("""    default:
+      revng_abort();
+    }
+  }
+
+""")
+
+  if call_arcs:
+    out += ("""  /// \\brief Return from a call to a function whose registers have the values
+  ///        in \\p Callee
+  void returnFromCall(const {0}Set &Callee) {{
+""".format(name))
+    for value in values:
+      out += ("""    transfer(Analysis::ReturnFrom{0}, Callee.Masks[Analysis::{0}]);
+""".format(value))
+    out += ("""  }
+
+""")
+
+  out += ("""  bool operator==(const {0}Set &Other) const {{
+    return Masks == Other.Masks;
+  }}
+}};
+
+""".format(name))
+
+  return out
+
 def main():
   parser = argparse.ArgumentParser(description="Generate C++ code from dot \
     files representing a monotone framework.")
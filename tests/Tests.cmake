@@ -8,5 +8,6 @@ enable_testing()
 include(${CMAKE_SOURCE_DIR}/tests/unit/UnitTests.cmake)
 include(${CMAKE_SOURCE_DIR}/tests/analysis/AnalysisTests.cmake)
 include(${CMAKE_SOURCE_DIR}/tests/runtime/RuntimeTests.cmake)
+include(${CMAKE_SOURCE_DIR}/tests/benchmarks/Benchmarks.cmake)
 
 set(TEST_CFLAGS_${ARCH} "${TEST_CFLAGS_${ARCH}} -mthumb")
@@ -22,6 +22,22 @@ set(ANALYSIS_DIFF_stack_analysis "${CMAKE_SOURCE_DIR}/scripts/compare-json.py --
 
 set(USED_REFERENCE_FILES "")
 
+#
+# Performance gating
+#
+
+# When enabled, the wall time and peak RSS of the analysis of each test are
+# recorded next to its output and compared against the baseline next to the
+# reference file. In warn mode regressions beyond the tolerance are reported,
+# in fail mode they make the test fail, in record mode the baselines are
+# overwritten with the new measurements.
+set(ANALYSIS_PERFORMANCE "off" CACHE STRING
+  "Check the performance of the analysis tests (off, warn, fail or record)")
+set_property(CACHE ANALYSIS_PERFORMANCE PROPERTY STRINGS off warn fail record)
+set(ANALYSIS_PERFORMANCE_TOLERANCE "25" CACHE STRING
+  "Maximum growth, in percent, of wall time and peak RSS of an analysis test")
+set(ANALYSIS_PERFORMANCE_SUFFIX ".performance.json")
+
 #
 # Broken tests
 #
@@ -53,9 +69,18 @@ macro(artifact_handler CATEGORY INPUT_FILE CONFIGURATION OUTPUT TARGET_NAME)
       list(APPEND USED_REFERENCE_FILES "${REFERENCE}")
       if(EXISTS "${REFERENCE}" AND NOT "${BASENAME}" IN_LIST "BROKEN_TESTS_${CATEGORY}")
 
+        set(MEASURE "")
+        if(NOT "${ANALYSIS_PERFORMANCE}" STREQUAL "off")
+          set(MEASURE "${CMAKE_SOURCE_DIR}/scripts/check-performance.py \
+            --mode ${ANALYSIS_PERFORMANCE} \
+            --tolerance ${ANALYSIS_PERFORMANCE_TOLERANCE} \
+            --baseline ${REFERENCE}${ANALYSIS_PERFORMANCE_SUFFIX} \
+            --output ${ANALYSIS_OUTPUT}${ANALYSIS_PERFORMANCE_SUFFIX} --")
+        endif()
+
         set(TEST_NAME test-lifted-${CATEGORY}-${ANALYSIS}-${TARGET_NAME})
         add_test(NAME ${TEST_NAME}
-          COMMAND sh -c "./bin/revng opt --${ANALYSIS_OPT_${ANALYSIS}} --${ANALYSIS_OPT_OUTPUT_${ANALYSIS}}=${ANALYSIS_OUTPUT} ${OUTPUT} --debug-log=stackanalysis -o /dev/null \
+          COMMAND sh -c "${MEASURE} ./bin/revng opt --${ANALYSIS_OPT_${ANALYSIS}} --${ANALYSIS_OPT_OUTPUT_${ANALYSIS}}=${ANALYSIS_OUTPUT} ${OUTPUT} --debug-log=stackanalysis -o /dev/null \
           && ${ANALYSIS_DIFF_${ANALYSIS}} ${REFERENCE} ${ANALYSIS_OUTPUT}")
         set_tests_properties(${TEST_NAME} PROPERTIES LABELS "analysis;${CATEGORY};${CONFIGURATION};${ANALYSIS}")
 
@@ -0,0 +1,74 @@
+#
+# This file is distributed under the MIT License. See LICENSE.md for details.
+#
+
+# The benchmarking corpus is composed by the compiled binaries of the analysis
+# tests, for all the supported architectures
+macro(artifact_handler CATEGORY INPUT_FILE CONFIGURATION OUTPUT TARGET_NAME)
+  if("${CATEGORY}" MATCHES "^tests_analysis.*" AND NOT "${CONFIGURATION}" STREQUAL "aarch64")
+    set_property(GLOBAL APPEND PROPERTY REVNG_BENCHMARK_CORPUS "${INPUT_FILE}")
+  endif()
+endmacro()
+register_derived_artifact("compiled" "benchmark-corpus" "" "FILE")
+
+# Run the pipeline stages on the whole corpus and collect the results in
+# benchmarks.json. This is not part of the default target, nor a test: invoke
+# it explicitly with `make revng-benchmarks`.
+get_property(BENCHMARK_CORPUS GLOBAL PROPERTY REVNG_BENCHMARK_CORPUS)
+add_custom_target(revng-benchmarks
+  COMMAND "${CMAKE_BINARY_DIR}/bin/revng-benchmark"
+    --revng "${CMAKE_BINARY_DIR}/bin/revng"
+    --output "${CMAKE_BINARY_DIR}/benchmarks.json"
+    ${BENCHMARK_CORPUS}
+  WORKING_DIRECTORY "${CMAKE_BINARY_DIR}"
+  USES_TERMINAL
+  COMMENT "Benchmarking the rev.ng pipeline stages")
+add_dependencies(revng-benchmarks revng-all-binaries)
+
+#
+# revng-runtime-benchmarks
+#
+
+# Compare the speed of the translated runtime tests against native and
+# emulated execution. Each run of each program is a line of the manifest.
+set(RUNTIME_BENCHMARK_MANIFEST "${CMAKE_BINARY_DIR}/runtime-benchmark-corpus.tsv")
+file(WRITE "${RUNTIME_BENCHMARK_MANIFEST}" "")
+macro(artifact_handler CATEGORY INPUT_FILE CONFIGURATION OUTPUT TARGET_NAME)
+  if("${CATEGORY}" STREQUAL "tests_runtime" AND NOT "${CONFIGURATION}" STREQUAL "static_native" AND NOT "${CONFIGURATION}" STREQUAL "aarch64")
+    foreach(RUN IN LISTS ARTIFACT_RUNS_${ARTIFACT_CATEGORY}__${ARTIFACT})
+      file(APPEND "${RUNTIME_BENCHMARK_MANIFEST}"
+        "${CONFIGURATION}\t${INPUT_FILE}\t${ARTIFACT_RUNS_${ARTIFACT_CATEGORY}__${ARTIFACT}__${RUN}}\n")
+    endforeach()
+  endif()
+endmacro()
+register_derived_artifact("compiled" "runtime-benchmark-corpus" "" "FILE")
+
+# Not part of the default target, nor a test: invoke it explicitly with
+# `make revng-runtime-benchmarks`, the results are in runtime-benchmarks.json
+add_custom_target(revng-runtime-benchmarks
+  COMMAND "${CMAKE_BINARY_DIR}/bin/revng-runtime-benchmark"
+    --revng "${CMAKE_BINARY_DIR}/bin/revng"
+    --output "${CMAKE_BINARY_DIR}/runtime-benchmarks.json"
+    "${RUNTIME_BENCHMARK_MANIFEST}"
+  WORKING_DIRECTORY "${CMAKE_BINARY_DIR}"
+  USES_TERMINAL
+  COMMENT "Benchmarking the translated programs")
+add_dependencies(revng-runtime-benchmarks revng-all-binaries)
+
+#
+# revng-microbenchmarks
+#
+
+# Measure the performance of the ADT and Support containers. Built only if
+# Google Benchmark is available, run it with `./bin/revng-microbenchmarks`.
+find_package(benchmark CONFIG QUIET)
+if(benchmark_FOUND)
+  revng_add_private_executable(revng-microbenchmarks
+    "${CMAKE_SOURCE_DIR}/tests/benchmarks/Containers.cpp")
+  target_include_directories(revng-microbenchmarks
+    PRIVATE "${CMAKE_SOURCE_DIR}")
+  target_link_libraries(revng-microbenchmarks
+    revngSupport
+    benchmark::benchmark
+    ${LLVM_LIBRARIES})
+endif()
@@ -0,0 +1,449 @@
+/// \file Containers.cpp
+/// \brief Microbenchmarks for the ADT and Support containers
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+#include <map>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DepthFirstIterator.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/IR/ConstantRange.h"
+
+#include "revng/ADT/ConstantRangeSet.h"
+#include "revng/ADT/GenericGraph.h"
+#include "revng/ADT/LazySmallBitVector.h"
+#include "revng/ADT/MutableSet.h"
+#include "revng/ADT/SmallMap.h"
+#include "revng/ADT/SortedVector.h"
+#include "revng/ADT/ZipMapIterator.h"
+#include "revng/Support/MetaAddress.h"
+
+#include "tests/unit/TestKeyedObject.h"
+
+using namespace llvm;
+
+/// \return \p Count keys uniformly distributed in [0, \p Count * \p Spread)
+///
+/// The sequence only depends on the arguments, so that each run measures the
+/// same workload.
+static std::vector<uint64_t>
+randomKeys(size_t Count, uint64_t Spread = 4, unsigned Seed = 0) {
+  std::mt19937_64 Generator(Count * 31 + Seed);
+  std::uniform_int_distribution<uint64_t> Distribution(0, Count * Spread - 1);
+  std::vector<uint64_t> Result(Count);
+  for (uint64_t &Key : Result)
+    Key = Distribution(Generator);
+  return Result;
+}
+
+//
+// SmallMap
+//
+
+/// Insert a few keys and look them up, as done for the per-instruction maps
+template<typename MapType>
+static void BM_SmallMapInsertLookup(benchmark::State &State) {
+  auto Keys = randomKeys(State.range(0));
+  for (auto _ : State) {
+    MapType Map;
+    for (uint64_t Key : Keys)
+      Map[Key] = Key;
+
+    uint64_t Sum = 0;
+    for (uint64_t Key : Keys)
+      Sum += Map.find(Key)->second;
+    benchmark::DoNotOptimize(Sum);
+  }
+  State.SetItemsProcessed(State.iterations() * Keys.size() * 2);
+}
+
+using SmallMap16 = SmallMap<uint64_t, uint64_t, 16>;
+BENCHMARK_TEMPLATE(BM_SmallMapInsertLookup, SmallMap16)->Range(2, 256);
+BENCHMARK_TEMPLATE(BM_SmallMapInsertLookup, std::map<uint64_t, uint64_t>)
+  ->Range(2, 256);
+using DenseMapU64 = DenseMap<uint64_t, uint64_t>;
+BENCHMARK_TEMPLATE(BM_SmallMapInsertLookup, DenseMapU64)->Range(2, 256);
+
+template<typename MapType>
+static void BM_SmallMapIterate(benchmark::State &State) {
+  MapType Map;
+  for (uint64_t Key : randomKeys(State.range(0)))
+    Map[Key] = Key;
+
+  for (auto _ : State) {
+    uint64_t Sum = 0;
+    for (auto &[Key, Value] : Map)
+      Sum += Value;
+    benchmark::DoNotOptimize(Sum);
+  }
+  State.SetItemsProcessed(State.iterations() * Map.size());
+}
+
+BENCHMARK_TEMPLATE(BM_SmallMapIterate, SmallMap16)->Range(2, 256);
+BENCHMARK_TEMPLATE(BM_SmallMapIterate, std::map<uint64_t, uint64_t>)
+  ->Range(2, 256);
+
+//
+// LazySmallBitVector
+//
+
+static LazySmallBitVector randomBitVector(size_t Bits, unsigned Seed) {
+  std::mt19937 Generator(Seed);
+  LazySmallBitVector Result;
+  for (size_t I = 0; I < Bits; I++)
+    if (Generator() % 2 == 0)
+      Result.set(I);
+  return Result;
+}
+
+static void BM_LazySmallBitVectorSet(benchmark::State &State) {
+  auto Indices = randomKeys(State.range(0), 1);
+  for (auto _ : State) {
+    LazySmallBitVector Vector;
+    for (uint64_t Index : Indices)
+      Vector.set(Index);
+    benchmark::DoNotOptimize(Vector);
+  }
+  State.SetItemsProcessed(State.iterations() * Indices.size());
+}
+BENCHMARK(BM_LazySmallBitVectorSet)->Range(8, 4096);
+
+static void BM_LazySmallBitVectorSetOperations(benchmark::State &State) {
+  auto Left = randomBitVector(State.range(0), 1);
+  auto Right = randomBitVector(State.range(0), 2);
+  for (auto _ : State) {
+    LazySmallBitVector Result = Left;
+    Result |= Right;
+    Result &= Left;
+    Result ^= Right;
+    benchmark::DoNotOptimize(Result.count());
+  }
+}
+BENCHMARK(BM_LazySmallBitVectorSetOperations)->Range(8, 4096);
+
+static void BM_LazySmallBitVectorIterate(benchmark::State &State) {
+  auto Vector = randomBitVector(State.range(0), 1);
+  for (auto _ : State) {
+    unsigned Sum = 0;
+    for (unsigned Index : Vector)
+      Sum += Index;
+    benchmark::DoNotOptimize(Sum);
+  }
+}
+BENCHMARK(BM_LazySmallBitVectorIterate)->Range(8, 4096);
+
+//
+// ConstantRangeSet
+//
+
+/// A set of \p Count disjoint ranges with random bounds
+static ConstantRangeSet randomRangeSet(size_t Count, unsigned Seed) {
+  std::mt19937_64 Generator(Seed);
+  ConstantRangeSet Result(64, false);
+  for (size_t I = 0; I < Count; I++) {
+    uint64_t Start = Generator() % (Count * 1024);
+    uint64_t Size = 1 + Generator() % 512;
+    ConstantRange Range(APInt(64, Start), APInt(64, Start + Size));
+    Result = Result.unionWith(Range);
+  }
+  return Result;
+}
+
+static void BM_ConstantRangeSetUnion(benchmark::State &State) {
+  auto Left = randomRangeSet(State.range(0), 1);
+  auto Right = randomRangeSet(State.range(0), 2);
+  for (auto _ : State)
+    benchmark::DoNotOptimize(Left.unionWith(Right));
+}
+BENCHMARK(BM_ConstantRangeSetUnion)->Range(1, 256);
+
+static void BM_ConstantRangeSetIntersection(benchmark::State &State) {
+  auto Left = randomRangeSet(State.range(0), 1);
+  auto Right = randomRangeSet(State.range(0), 2);
+  for (auto _ : State)
+    benchmark::DoNotOptimize(Left.intersectWith(Right));
+}
+BENCHMARK(BM_ConstantRangeSetIntersection)->Range(1, 256);
+
+static void BM_ConstantRangeSetContains(benchmark::State &State) {
+  auto Set = randomRangeSet(State.range(0), 1);
+  auto Other = randomRangeSet(1, 2);
+  for (auto _ : State)
+    benchmark::DoNotOptimize(Set.contains(Other));
+}
+BENCHMARK(BM_ConstantRangeSetContains)->Range(1, 256);
+
+//
+// KeyedObjectContainers: SortedVector and MutableSet versus std::map
+//
+
+template<typename T>
+static void insertElements(T &Container, const std::vector<uint64_t> &Keys) {
+  if constexpr (std::is_same_v<T, std::map<uint64_t, Element>>) {
+    for (uint64_t Key : Keys)
+      Container.insert({ Key, Element(Key, Key) });
+  } else {
+    for (uint64_t Key : Keys)
+      Container.insert(Element(Key, Key));
+  }
+}
+
+template<typename T>
+static void BM_KeyedContainerInsert(benchmark::State &State) {
+  auto Keys = randomKeys(State.range(0));
+  for (auto _ : State) {
+    T Container;
+    insertElements(Container, Keys);
+    benchmark::DoNotOptimize(Container);
+  }
+  State.SetItemsProcessed(State.iterations() * Keys.size());
+}
+
+/// Insert all the elements at once, as done by the deserialization
+static void BM_SortedVectorBatchInsert(benchmark::State &State) {
+  auto Keys = randomKeys(State.range(0));
+  for (auto _ : State) {
+    SortedVector<Element> Container;
+    {
+      auto Inserter = Container.batch_insert_or_assign();
+      for (uint64_t Key : Keys)
+        Inserter.insert_or_assign(Element(Key, Key));
+    }
+    benchmark::DoNotOptimize(Container);
+  }
+  State.SetItemsProcessed(State.iterations() * Keys.size());
+}
+
+template<typename T>
+static void BM_KeyedContainerLookup(benchmark::State &State) {
+  auto Keys = randomKeys(State.range(0));
+  T Container;
+  insertElements(Container, Keys);
+
+  // Look up both present and missing keys
+  auto Queries = randomKeys(State.range(0), 4, 1);
+  for (auto _ : State) {
+    unsigned Found = 0;
+    for (uint64_t Key : Queries)
+      Found += Container.count(Key);
+    benchmark::DoNotOptimize(Found);
+  }
+  State.SetItemsProcessed(State.iterations() * Queries.size());
+}
+
+template<typename T>
+static void BM_KeyedContainerIterate(benchmark::State &State) {
+  T Container;
+  insertElements(Container, randomKeys(State.range(0)));
+  for (auto _ : State) {
+    uint64_t Sum = 0;
+    for (const auto &Entry : Container) {
+      if constexpr (std::is_same_v<T, std::map<uint64_t, Element>>)
+        Sum += Entry.second.value();
+      else
+        Sum += Entry.value();
+    }
+    benchmark::DoNotOptimize(Sum);
+  }
+  State.SetItemsProcessed(State.iterations() * Container.size());
+}
+
+using ElementMap = std::map<uint64_t, Element>;
+BENCHMARK_TEMPLATE(BM_KeyedContainerInsert, SortedVector<Element>)
+  ->Range(8, 1 << 14);
+BENCHMARK(BM_SortedVectorBatchInsert)->Range(8, 1 << 14);
+BENCHMARK_TEMPLATE(BM_KeyedContainerInsert, MutableSet<Element>)
+  ->Range(8, 1 << 14);
+BENCHMARK_TEMPLATE(BM_KeyedContainerInsert, ElementMap)->Range(8, 1 << 14);
+BENCHMARK_TEMPLATE(BM_KeyedContainerLookup, SortedVector<Element>)
+  ->Range(8, 1 << 14);
+BENCHMARK_TEMPLATE(BM_KeyedContainerLookup, MutableSet<Element>)
+  ->Range(8, 1 << 14);
+BENCHMARK_TEMPLATE(BM_KeyedContainerLookup, ElementMap)->Range(8, 1 << 14);
+BENCHMARK_TEMPLATE(BM_KeyedContainerIterate, SortedVector<Element>)
+  ->Range(8, 1 << 14);
+BENCHMARK_TEMPLATE(BM_KeyedContainerIterate, MutableSet<Element>)
+  ->Range(8, 1 << 14);
+BENCHMARK_TEMPLATE(BM_KeyedContainerIterate, ElementMap)->Range(8, 1 << 14);
+
+//
+// ZipMapIterator
+//
+
+/// Zip two containers sharing half of their keys, as done when diffing models
+template<typename T>
+static void BM_ZipMap(benchmark::State &State) {
+  auto Keys = randomKeys(State.range(0));
+  auto OtherKeys = randomKeys(State.range(0) / 2 + 1);
+  auto Half = Keys.begin() + Keys.size() / 2;
+  OtherKeys.insert(OtherKeys.end(), Keys.begin(), Half);
+
+  T Left;
+  T Right;
+  for (uint64_t Key : Keys)
+    Left.insert(Key);
+  for (uint64_t Key : OtherKeys)
+    Right.insert(Key);
+
+  for (auto _ : State) {
+    unsigned Both = 0;
+    for (auto [LeftElement, RightElement] : zipmap_range(Left, Right))
+      Both += LeftElement != nullptr and RightElement != nullptr;
+    benchmark::DoNotOptimize(Both);
+  }
+  State.SetItemsProcessed(State.iterations() * (Left.size() + Right.size()));
+}
+
+BENCHMARK_TEMPLATE(BM_ZipMap, SortedVector<uint64_t>)->Range(8, 1 << 14);
+BENCHMARK_TEMPLATE(BM_ZipMap, MutableSet<uint64_t>)->Range(8, 1 << 14);
+BENCHMARK_TEMPLATE(BM_ZipMap, std::set<uint64_t>)->Range(8, 1 << 14);
+
+//
+// MetaAddress
+//
+
+static std::vector<MetaAddress>
+randomAddresses(size_t Count, unsigned Seed = 0) {
+  std::vector<MetaAddress> Result;
+  Result.reserve(Count);
+  for (uint64_t Key : randomKeys(Count, 64, Seed))
+    Result.push_back(MetaAddress::fromPC(Triple::x86_64, 0x400000 + Key));
+  return Result;
+}
+
+static void BM_MetaAddressSort(benchmark::State &State) {
+  auto Addresses = randomAddresses(State.range(0));
+  for (auto _ : State) {
+    auto ToSort = Addresses;
+    std::sort(ToSort.begin(), ToSort.end());
+    benchmark::DoNotOptimize(ToSort.data());
+  }
+  State.SetItemsProcessed(State.iterations() * Addresses.size());
+}
+BENCHMARK(BM_MetaAddressSort)->Range(8, 1 << 14);
+
+/// Binary search on a sorted vector, the typical lookup of a jump target
+static void BM_MetaAddressBinarySearch(benchmark::State &State) {
+  auto Addresses = randomAddresses(State.range(0));
+  auto Queries = randomAddresses(State.range(0), 1);
+  std::sort(Addresses.begin(), Addresses.end());
+  for (auto _ : State) {
+    unsigned Found = 0;
+    for (const MetaAddress &Query : Queries)
+      Found += std::binary_search(Addresses.begin(), Addresses.end(), Query);
+    benchmark::DoNotOptimize(Found);
+  }
+  State.SetItemsProcessed(State.iterations() * Queries.size());
+}
+BENCHMARK(BM_MetaAddressBinarySearch)->Range(8, 1 << 14);
+
+static void BM_MetaAddressMapLookup(benchmark::State &State) {
+  std::map<MetaAddress, unsigned> Map;
+  for (const MetaAddress &Address : randomAddresses(State.range(0)))
+    Map[Address] = 0;
+  auto Queries = randomAddresses(State.range(0), 1);
+  for (auto _ : State) {
+    unsigned Found = 0;
+    for (const MetaAddress &Query : Queries)
+      Found += Map.count(Query);
+    benchmark::DoNotOptimize(Found);
+  }
+  State.SetItemsProcessed(State.iterations() * Queries.size());
+}
+BENCHMARK(BM_MetaAddressMapLookup)->Range(8, 1 << 14);
+
+static void BM_MetaAddressToString(benchmark::State &State) {
+  auto Addresses = randomAddresses(State.range(0));
+  for (auto _ : State) {
+    for (const MetaAddress &Address : Addresses) {
+      auto Text = Address.toString();
+      benchmark::DoNotOptimize(MetaAddress::fromString(Text));
+    }
+  }
+  State.SetItemsProcessed(State.iterations() * Addresses.size());
+}
+BENCHMARK(BM_MetaAddressToString)->Range(8, 1024);
+
+//
+// GenericGraph
+//
+
+struct BenchmarkNodeData {
+  BenchmarkNodeData(uint64_t Index) : Index(Index) {}
+  uint64_t Index;
+};
+
+/// A CFG-like graph: a chain with random forward and backward edges
+template<typename NodeType>
+static GenericGraph<NodeType> randomGraph(size_t Count) {
+  GenericGraph<NodeType> Graph;
+  std::vector<NodeType *> Nodes;
+  Nodes.reserve(Count);
+  for (size_t I = 0; I < Count; I++)
+    Nodes.push_back(Graph.addNode(I));
+  Graph.setEntryNode(Nodes[0]);
+
+  auto Targets = randomKeys(Count, 1);
+  for (size_t I = 0; I + 1 < Count; I++) {
+    Nodes[I]->addSuccessor(Nodes[I + 1]);
+    if (I % 2 == 0)
+      Nodes[I]->addSuccessor(Nodes[Targets[I]]);
+  }
+
+  return Graph;
+}
+
+template<typename NodeType>
+static void BM_GenericGraphBuild(benchmark::State &State) {
+  for (auto _ : State)
+    benchmark::DoNotOptimize(randomGraph<NodeType>(State.range(0)));
+  State.SetItemsProcessed(State.iterations() * State.range(0));
+}
+
+template<typename NodeType>
+static void BM_GenericGraphDepthFirst(benchmark::State &State) {
+  auto Graph = randomGraph<NodeType>(State.range(0));
+  for (auto _ : State) {
+    uint64_t Sum = 0;
+    for (NodeType *Node : depth_first(&Graph))
+      Sum += Node->Index;
+    benchmark::DoNotOptimize(Sum);
+  }
+  State.SetItemsProcessed(State.iterations() * State.range(0));
+}
+
+template<typename NodeType>
+static void BM_GenericGraphPostOrder(benchmark::State &State) {
+  auto Graph = randomGraph<NodeType>(State.range(0));
+  for (auto _ : State) {
+    uint64_t Sum = 0;
+    for (NodeType *Node : post_order(&Graph))
+      Sum += Node->Index;
+    benchmark::DoNotOptimize(Sum);
+  }
+  State.SetItemsProcessed(State.iterations() * State.range(0));
+}
+
+using ForwardBenchmarkNode = ForwardNode<BenchmarkNodeData>;
+using BidirectionalBenchmarkNode = BidirectionalNode<BenchmarkNodeData>;
+BENCHMARK_TEMPLATE(BM_GenericGraphBuild, ForwardBenchmarkNode)
+  ->Range(64, 1 << 14);
+BENCHMARK_TEMPLATE(BM_GenericGraphBuild, BidirectionalBenchmarkNode)
+  ->Range(64, 1 << 14);
+BENCHMARK_TEMPLATE(BM_GenericGraphDepthFirst, ForwardBenchmarkNode)
+  ->Range(64, 1 << 14);
+BENCHMARK_TEMPLATE(BM_GenericGraphDepthFirst, BidirectionalBenchmarkNode)
+  ->Range(64, 1 << 14);
+BENCHMARK_TEMPLATE(BM_GenericGraphPostOrder, ForwardBenchmarkNode)
+  ->Range(64, 1 << 14);
+
+BENCHMARK_MAIN();
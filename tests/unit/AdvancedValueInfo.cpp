@@ -5,6 +5,8 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <functional>
+
 #define BOOST_TEST_MODULE AdvancedValueInfo
 bool init_unit_test();
 #include "boost/test/unit_test.hpp"
@@ -42,6 +44,15 @@ public:
   }
 };
 
+using MockupAVI = AdvancedValueInfo<MockupMemoryOracle>;
+using QueryFunction = std::function<MaterializedValues(MockupAVI &,
+                                                       BasicBlock *,
+                                                       Value *)>;
+
+static MaterializedValues explore(MockupAVI &AVI, BasicBlock *BB, Value *V) {
+  return AVI.explore(BB, V);
+}
+
 class TestAdvancedValueInfoPass : public ModulePass {
 public:
   using ResultsMap = std::map<Value *, MaterializedValues>;
@@ -51,8 +62,8 @@ public:
 
 public:
   TestAdvancedValueInfoPass() : ModulePass(ID), Results(nullptr) {}
-  TestAdvancedValueInfoPass(ResultsMap &Results) :
-    ModulePass(ID), Results(&Results) {}
+  TestAdvancedValueInfoPass(ResultsMap &Results, QueryFunction Query) :
+    ModulePass(ID), Results(&Results), Query(Query) {}
 
   void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
     AU.setPreservesAll();
@@ -65,6 +76,7 @@ public:
 
 private:
   ResultsMap *Results;
+  QueryFunction Query;
 };
 
 char TestAdvancedValueInfoPass::ID = 0;
@@ -86,12 +98,12 @@ bool TestAdvancedValueInfoPass::runOnModule(llvm::Module &M) {
 
   MockupMemoryOracle MO(M.getDataLayout());
   BasicBlock *StopAt = &Root.getEntryBlock();
-  AdvancedValueInfo<MockupMemoryOracle> AVI(LVI, SCEV, DT, MO, StopAt);
+  MockupAVI AVI(LVI, SCEV, DT, MO, StopAt);
 
   for (User *U : M.getGlobalVariable("pc", true)->users()) {
     if (auto *Store = dyn_cast<StoreInst>(U)) {
       Value *V = Store->getValueOperand();
-      (*Results)[V] = AVI.explore(Store->getParent(), V);
+      (*Results)[V] = Query(AVI, Store->getParent(), V);
     }
   }
 
@@ -100,7 +112,9 @@ bool TestAdvancedValueInfoPass::runOnModule(llvm::Module &M) {
 
 using CheckMap = std::map<const char *, MaterializedValues>;
 
-static void checkAdvancedValueInfo(const char *Body, const CheckMap &Map) {
+static void checkAdvancedValueInfo(const char *Body,
+                                   const CheckMap &Map,
+                                   QueryFunction Query = explore) {
   auto &Registry = *PassRegistry::getPassRegistry();
   initializeDominatorTreeWrapperPassPass(Registry);
   initializeLazyValueInfoWrapperPassPass(Registry);
@@ -116,7 +130,7 @@ static void checkAdvancedValueInfo(const char *Body, const CheckMap &Map) {
   legacy::PassManager PM;
   PM.add(createLazyValueInfoPass());
   PM.add(new ScalarEvolutionWrapperPass);
-  PM.add(new TestAdvancedValueInfoPass(Results));
+  PM.add(new TestAdvancedValueInfoPass(Results, Query));
   PM.run(*M);
 
   TestAdvancedValueInfoPass::ResultsMap Reference;
@@ -466,3 +480,50 @@ end:
                                AI64(33),
                                AI64(34) } } });
 }
+
+BOOST_AUTO_TEST_CASE(TestEnumerate) {
+  const char *Body = R"LLVM(
+  %to_store = load i64, i64 *@pc
+  %cmp = icmp ult i64 %to_store, 5
+  br i1 %cmp, label %smaller, label %end
+
+smaller:
+  store i64 %to_store, i64* @pc
+  br label %end
+
+end:
+  unreachable
+
+)LLVM";
+
+  // Stop as soon as we have two values
+  auto FirstTwo = [](MockupAVI &AVI, BasicBlock *BB, Value *V) {
+    AVIBudget Budget(DefaultAVIBudget);
+    bool Complete = false;
+    MaterializedValues Result;
+    for (MaterializedValue &Value : AVI.enumerate(BB, V, Budget, Complete)) {
+      Result.push_back(Value);
+      if (Result.size() == 2)
+        break;
+    }
+
+    revng_check(not Complete);
+    return Result;
+  };
+  checkAdvancedValueInfo(Body,
+                         { { "to_store", { AI64(0), AI64(1) } } },
+                         FirstTwo);
+
+  // Materializing all the values requires more than the available budget
+  auto SmallBudget = [](MockupAVI &AVI, BasicBlock *BB, Value *V) {
+    AVIBudget Budget(3);
+    bool Complete = false;
+    MaterializedValues Result;
+    for (MaterializedValue &Value : AVI.enumerate(BB, V, Budget, Complete))
+      Result.push_back(Value);
+
+    revng_check(not Complete);
+    return Result;
+  };
+  checkAdvancedValueInfo(Body, { { "to_store", {} } }, SmallBudget);
+}
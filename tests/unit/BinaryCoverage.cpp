@@ -0,0 +1,116 @@
+/// \file BinaryCoverage.cpp
+/// \brief Tests for the binary coverage format
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <string>
+
+#define BOOST_TEST_MODULE BinaryCoverage
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Support/BinaryCoverage.h"
+
+BOOST_TEST_DONT_PRINT_LOG_VALUE(MetaAddress)
+
+using namespace llvm;
+using namespace BinaryCoverage;
+
+static MetaAddress pc(uint64_t Address) {
+  return MetaAddress::fromPC(Triple::x86_64, Address);
+}
+
+static MetaAddress generic(uint64_t Address) {
+  return MetaAddress::fromGeneric(Triple::x86_64, Address);
+}
+
+static ErrorOr<Reader> roundTrip(Writer &W) {
+  std::string Data;
+  raw_string_ostream Stream(Data);
+  W.write(Stream);
+  Stream.flush();
+  return Reader::fromBuffer(MemoryBuffer::getMemBufferCopy(Data));
+}
+
+static Writer makeWriter() {
+  // Out of order, as they are found in the module
+  Writer W;
+  W.addInstruction(pc(0x1010), 2, false);
+  W.addInstruction(pc(0x1000), 4, true);
+  W.addInstruction(pc(0x1004), 3, false);
+  return W;
+}
+
+BOOST_AUTO_TEST_CASE(TestRecords) {
+  Writer W = makeWriter();
+  auto MaybeReader = roundTrip(W);
+  BOOST_TEST(static_cast<bool>(MaybeReader));
+  Reader &R = *MaybeReader;
+
+  BOOST_TEST(R.size() == 3U);
+  BOOST_TEST(R.bitmapsCount() == 0U);
+
+  // Records are sorted
+  BOOST_TEST(R[0].Address == pc(0x1000));
+  BOOST_TEST(R[0].Size == 4U);
+  BOOST_TEST(R[0].IsJumpTarget);
+  BOOST_TEST(R[1].Address == pc(0x1004));
+  BOOST_TEST(not R[1].IsJumpTarget);
+  BOOST_TEST(R[2].Address == pc(0x1010));
+
+  // Lookups
+  BOOST_TEST(R.find(pc(0x1002))->Address == pc(0x1000));
+  BOOST_TEST(R.find(pc(0x1006))->Address == pc(0x1004));
+  BOOST_TEST(not R.find(pc(0x1007)));
+  BOOST_TEST(not R.find(pc(0xfff)));
+  BOOST_TEST(not R.find(pc(0x1012)));
+  BOOST_TEST(R.isCovered(pc(0x1011)));
+  BOOST_TEST(not R.isCovered(pc(0x100f)));
+}
+
+BOOST_AUTO_TEST_CASE(TestBitmaps) {
+  Writer W = makeWriter();
+  W.addSegment(generic(0x1000), 0x11);
+
+  auto MaybeReader = roundTrip(W);
+  BOOST_TEST(static_cast<bool>(MaybeReader));
+  Reader &R = *MaybeReader;
+  BOOST_TEST(R.size() == 3U);
+  BOOST_TEST(R.bitmapsCount() == 1U);
+
+  // Generic addresses can be looked up in the bitmap
+  for (uint64_t Address = 0x1000; Address < 0x1007; ++Address)
+    BOOST_TEST(R.isCovered(generic(Address)));
+  BOOST_TEST(not R.isCovered(generic(0x1007)));
+  BOOST_TEST(not R.isCovered(generic(0x100f)));
+  BOOST_TEST(R.isCovered(generic(0x1010)));
+
+  // Out of the bitmap, only the records are considered
+  BOOST_TEST(not R.isCovered(generic(0x1011)));
+  BOOST_TEST(R.isCovered(pc(0x1011)));
+}
+
+BOOST_AUTO_TEST_CASE(TestInvalid) {
+  auto Check = [](StringRef Data) {
+    auto Buffer = MemoryBuffer::getMemBufferCopy(Data);
+    return static_cast<bool>(Reader::fromBuffer(std::move(Buffer)));
+  };
+
+  BOOST_TEST(not Check(""));
+  BOOST_TEST(not Check(std::string(64, 'a')));
+
+  // Truncated
+  std::string Data;
+  raw_string_ostream Stream(Data);
+  Writer W = makeWriter();
+  W.write(Stream);
+  Stream.flush();
+  BOOST_TEST(Check(Data));
+  BOOST_TEST(not Check(StringRef(Data).drop_back(1)));
+}
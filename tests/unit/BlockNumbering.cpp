@@ -0,0 +1,133 @@
+/// \file BlockNumbering.cpp
+/// \brief Tests for BlockNumbering
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#define BOOST_TEST_MODULE BlockNumbering
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/PassInstrumentation.h"
+#include "llvm/IR/Verifier.h"
+
+#include "revng/ADT/Queue.h"
+#include "revng/BasicAnalyses/BlockNumbering.h"
+#include "revng/UnitTestHelpers/LLVMTestHelpers.h"
+#include "revng/UnitTestHelpers/UnitTestHelpers.h"
+
+using namespace llvm;
+
+const char *LoopBody = R"LLVM(
+  br label %header
+
+header:
+  br i1 true, label %body, label %exit
+
+body:
+  br i1 true, label %header, label %inner
+
+inner:
+  br i1 true, label %inner, label %latch
+
+latch:
+  br label %header
+
+exit:
+  ret void
+
+unreachable:
+  br label %exit
+)LLVM";
+
+BOOST_AUTO_TEST_CASE(TestNumbers) {
+  LLVMContext C;
+  std::unique_ptr<Module> M = loadModule(C, LoopBody);
+  revng_check(not verifyModule(*M, &dbgs()));
+  Function *F = M->getFunction("main");
+
+  DominatorTree DT(*F);
+  LoopInfo LI(DT);
+  BlockNumbering Numbering = BlockNumbering::compute(*F, &LI);
+
+  auto *Entry = &F->getEntryBlock();
+  auto *Header = basicBlockByName(F, "header");
+  auto *Body = basicBlockByName(F, "body");
+  auto *Inner = basicBlockByName(F, "inner");
+  auto *Latch = basicBlockByName(F, "latch");
+  auto *Exit = basicBlockByName(F, "exit");
+  auto *Unreachable = basicBlockByName(F, "unreachable");
+
+  revng_check(Numbering.size() == 6);
+  revng_check(not Numbering.isReachable(Unreachable));
+  revng_check(not Numbering.lookup(Unreachable).has_value());
+
+  // The indices follow the reverse post order
+  for (unsigned I = 0; I < Numbering.size(); ++I)
+    revng_check(Numbering.rpoIndex(Numbering.rpo()[I]) == I);
+  revng_check(Numbering.rpo().front() == Entry);
+
+  // Every block comes before its successors, except along retreating edges
+  for (BasicBlock *BB : Numbering.rpo())
+    for (BasicBlock *Successor : successors(BB))
+      if (not Numbering.isRetreatingEdge(BB, Successor))
+        revng_check(Numbering.rpoIndex(BB) < Numbering.rpoIndex(Successor));
+  revng_check(Numbering.isRetreatingEdge(Body, Header));
+  revng_check(Numbering.isRetreatingEdge(Inner, Inner));
+  revng_check(Numbering.isRetreatingEdge(Latch, Header));
+  revng_check(not Numbering.isRetreatingEdge(Header, Body));
+
+  // Dominators are DFS ancestors
+  for (BasicBlock *A : Numbering.rpo())
+    for (BasicBlock *B : Numbering.rpo())
+      if (DT.dominates(A, B))
+        revng_check(Numbering.isDFSAncestor(A, B));
+  revng_check(Numbering.preOrder(Entry) == 0);
+  revng_check(Numbering.postOrder(Entry) == Numbering.size() - 1);
+
+  revng_check(Numbering.loopDepth(Entry) == 0);
+  revng_check(Numbering.loopDepth(Header) == 1);
+  revng_check(Numbering.loopDepth(Latch) == 1);
+  revng_check(Numbering.loopDepth(Inner) == 2);
+  revng_check(Numbering.loopDepth(Exit) == 0);
+
+  // Use the numbering to drive a worklist
+  using RPOIndexOf = BlockNumbering::RPOIndexOf;
+  DenseOnceQueue<BasicBlock *, RPOIndexOf> Queue(Numbering.rpoIndexOf(),
+                                                 Numbering.size());
+  Queue.insert(Header);
+  unsigned Visited = 0;
+  while (not Queue.empty()) {
+    ++Visited;
+    for (BasicBlock *Successor : successors(Queue.pop()))
+      Queue.insert(Successor);
+  }
+  revng_check(Visited == 5);
+  revng_check(not Queue.contains(Entry));
+}
+
+BOOST_AUTO_TEST_CASE(TestInvalidation) {
+  LLVMContext C;
+  std::unique_ptr<Module> M = loadModule(C, LoopBody);
+  Function *F = M->getFunction("main");
+
+  FunctionAnalysisManager FAM;
+  FAM.registerPass([] { return PassInstrumentationAnalysis(); });
+  FAM.registerPass([] { return DominatorTreeAnalysis(); });
+  FAM.registerPass([] { return LoopAnalysis(); });
+  FAM.registerPass([] { return BlockNumberingAnalysis(); });
+
+  const BlockNumbering *First = &FAM.getResult<BlockNumberingAnalysis>(*F);
+
+  // Preserving the CFG preserves the numbering
+  PreservedAnalyses PA;
+  PA.preserveSet<CFGAnalyses>();
+  FAM.invalidate(*F, PA);
+  revng_check(FAM.getCachedResult<BlockNumberingAnalysis>(*F) == First);
+
+  FAM.invalidate(*F, PreservedAnalyses::none());
+  revng_check(FAM.getCachedResult<BlockNumberingAnalysis>(*F) == nullptr);
+}
@@ -5,6 +5,9 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <bitset>
+#include <vector>
+
 #define BOOST_TEST_MODULE ConstantrangeSet
 bool init_unit_test();
 #include "boost/test/unit_test.hpp"
@@ -62,3 +65,77 @@ BOOST_AUTO_TEST_CASE(TestEnumerate) {
     dbg << "\n";
   }
 }
+
+using Membership = std::bitset<256>;
+
+static Membership membership(const ConstantRangeSet &Set) {
+  Membership Result;
+  for (const llvm::APInt &Value : Set)
+    Result.set(Value.getLimitedValue());
+  return Result;
+}
+
+BOOST_AUTO_TEST_CASE(TestSetOperations) {
+  using CRS = ConstantRangeSet;
+
+  // Compare union, intersection and contains against the membership of
+  // each value, for all the pairs of a set of (possibly wrapping) ranges
+  std::vector<CRS> Sets;
+  for (uint64_t Start : { 0, 3, 10, 128, 250 })
+    for (uint64_t End : { 0, 5, 10, 200 })
+      if (Start != End)
+        Sets.push_back(CRS({ { 8, Start }, { 8, End } }));
+  Sets.push_back(CRS(8, true));
+  Sets.push_back(CRS(8, false));
+
+  // Add some sets with more intervals than those stored inline
+  for (size_t I = 0; I + 2 < Sets.size(); I += 3)
+    Sets.push_back(Sets[I].unionWith(Sets[I + 1]).intersectWith(Sets[I + 2]));
+
+  for (const CRS &Left : Sets) {
+    Membership LeftMembers = membership(Left);
+    revng_check(Left.isEmptySet() == LeftMembers.none());
+    revng_check(Left.isFullSet() == LeftMembers.all());
+
+    for (const CRS &Right : Sets) {
+      Membership RightMembers = membership(Right);
+      Membership Union = membership(Left.unionWith(Right));
+      Membership Intersection = membership(Left.intersectWith(Right));
+      revng_check(Union == (LeftMembers | RightMembers));
+      revng_check(Intersection == (LeftMembers & RightMembers));
+
+      bool Contains = (LeftMembers & RightMembers) == RightMembers;
+      revng_check(Left.contains(Right) == Contains);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestWide) {
+  using CRS = ConstantRangeSet;
+  using llvm::APInt;
+
+  // Sets wider than 64 bits are stored as APInt
+  auto Range = [](uint64_t Start, uint64_t End) {
+    return CRS({ APInt(128, Start), APInt(128, End) });
+  };
+
+  CRS Merged = Range(10, 20).unionWith(Range(30, 40)).unionWith(Range(15, 35));
+  revng_check(Merged == Range(10, 40));
+  revng_check(Merged.size() == APInt(128, 30));
+  revng_check(Merged.contains(Range(12, 38)));
+  revng_check(not Merged.contains(Range(5, 15)));
+  revng_check(Range(10, 20).intersectWith(Range(30, 40)).isEmptySet());
+  revng_check(Range(10, 20).intersectWith(Range(15, 40)) == Range(15, 20));
+
+  std::vector<uint64_t> Expected = { 10, 11, 12, 13, 14, 15, 16, 17, 18, 19 };
+  std::vector<uint64_t> Values;
+  for (const APInt &Value : Range(10, 20))
+    Values.push_back(Value.getLimitedValue());
+  revng_check(Values == Expected);
+
+  CRS Full(128, true);
+  revng_check(Full.isFullSet());
+  revng_check(Full.contains(Merged));
+  revng_check(not Merged.contains(Full));
+  revng_check(Full.intersectWith(Merged) == Merged);
+}
@@ -0,0 +1,47 @@
+/// \file CopyOnWrite.cpp
+/// \brief Tests for CopyOnWrite
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <vector>
+
+#define BOOST_TEST_MODULE CopyOnWrite
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "revng/ADT/CopyOnWrite.h"
+
+using Vector = std::vector<int>;
+
+BOOST_AUTO_TEST_CASE(CopiesShareUntilMutated) {
+  CopyOnWrite<Vector> A(Vector{ 1, 2, 3 });
+  CopyOnWrite<Vector> B = A;
+
+  revng_check(A.sharesWith(B));
+  revng_check(A.isShared());
+  revng_check(A == B);
+
+  B.mutate().push_back(4);
+
+  revng_check(not A.sharesWith(B));
+  revng_check(not A.isShared());
+  revng_check(A->size() == 3);
+  revng_check(B->size() == 4);
+  revng_check(A != B);
+}
+
+BOOST_AUTO_TEST_CASE(MutateUnsharedInPlace) {
+  CopyOnWrite<Vector> A(Vector{ 1 });
+  const Vector *Before = &A.get();
+  A.mutate().push_back(2);
+  revng_check(&A.get() == Before);
+}
+
+BOOST_AUTO_TEST_CASE(EqualityComparesContent) {
+  CopyOnWrite<Vector> A(Vector{ 1, 2 });
+  CopyOnWrite<Vector> B(Vector{ 1, 2 });
+  revng_check(not A.sharesWith(B));
+  revng_check(A == B);
+}
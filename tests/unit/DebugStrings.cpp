@@ -0,0 +1,68 @@
+/// \file DebugStrings.cpp
+/// \brief Tests for the debug strings side file
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <string>
+
+#define BOOST_TEST_MODULE DebugStrings
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Support/DebugStrings.h"
+
+BOOST_TEST_DONT_PRINT_LOG_VALUE(llvm::StringRef)
+
+using namespace llvm;
+using namespace DebugStrings;
+
+static std::string serialize(const Writer &W) {
+  std::string Data;
+  raw_string_ostream Stream(Data);
+  W.write(Stream);
+  Stream.flush();
+  return Data;
+}
+
+static bool isValid(StringRef Data) {
+  auto Buffer = MemoryBuffer::getMemBufferCopy(Data);
+  return static_cast<bool>(Reader::fromBuffer(std::move(Buffer)));
+}
+
+BOOST_AUTO_TEST_CASE(TestRoundTrip) {
+  Writer W;
+  BOOST_TEST(W.add("mov rax, rbx\n") == 0U);
+  BOOST_TEST(W.add("") == 1U);
+  BOOST_TEST(W.add("ret\n") == 2U);
+
+  // Identical strings are interned
+  BOOST_TEST(W.add("mov rax, rbx\n") == 0U);
+  BOOST_TEST(W.size() == 3U);
+
+  std::string Data = serialize(W);
+  auto MaybeReader = Reader::fromBuffer(MemoryBuffer::getMemBufferCopy(Data));
+  BOOST_TEST(static_cast<bool>(MaybeReader));
+  Reader &R = *MaybeReader;
+
+  BOOST_TEST(R.size() == 3U);
+  BOOST_TEST(R.get(0) == "mov rax, rbx\n");
+  BOOST_TEST(R.get(1) == "");
+  BOOST_TEST(R.get(2) == "ret\n");
+  BOOST_TEST(R.get(3) == "");
+}
+
+BOOST_AUTO_TEST_CASE(TestInvalid) {
+  BOOST_TEST(not isValid(""));
+  BOOST_TEST(not isValid(std::string(64, 'a')));
+
+  Writer W;
+  W.add("nop\n");
+  std::string Data = serialize(W);
+  BOOST_TEST(isValid(Data));
+  BOOST_TEST(not isValid(StringRef(Data).drop_back(1)));
+}
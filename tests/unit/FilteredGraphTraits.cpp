@@ -47,6 +47,23 @@ EdgeHasLetterInName(const llvm::GraphTraits<DotGraph *>::EdgeRef &E) {
   return E.second->getName().contains(Letter);
 }
 
+static unsigned PredicateCalls = 0;
+
+template<char Letter>
+static bool
+CountingHasLetterInName(const llvm::GraphTraits<Function *>::NodeRef &Src,
+                        const llvm::GraphTraits<Function *>::NodeRef &Tgt) {
+  ++PredicateCalls;
+  return HasLetterInName<Letter>(Src, Tgt);
+}
+
+template<char Letter>
+static bool
+CountingEdgeHasLetterInName(const llvm::GraphTraits<DotNode *>::EdgeRef &E) {
+  ++PredicateCalls;
+  return E.second->getName().contains(Letter);
+}
+
 template<typename T>
 static bool AlwaysTrue(const T & /*Src*/, const T & /*Tgt*/) {
   return true;
@@ -825,4 +842,130 @@ end:
   }
 }
 
+BOOST_AUTO_TEST_CASE(CachedFilteredGraphTests) {
+
+  std::string Body{ R"LLVM(
+  br label %starter
+
+starter:
+  %to_store = load i64, i64* @rax
+  %gt10 = icmp ugt i64 %to_store, 10
+  br i1 %gt10, label %end, label %false
+
+false:
+  %gt30 = icmp ugt i64 %to_store, 30
+  br i1 %gt30, label %end, label %_xit
+
+_xit:
+  unreachable
+
+end:
+  store i64 %to_store, i64* @pc
+  unreachable
+
+)LLVM" };
+
+  LLVMContext C;
+  std::unique_ptr<llvm::Module> M = loadModule(C, Body.data());
+  revng_check(not verifyModule(*M, &dbgs()));
+
+  Function *F = M->getFunction("main");
+  BasicBlock *BackBB = &F->getBasicBlockList().back();
+
+  { // Node pair filter, the predicate is evaluated only on the first visit
+    using NPFG = NodePairFilteredGraph<Function *,
+                                       CountingHasLetterInName<'e'>>;
+    using CNPFG = CachedNodePairFilteredGraph<Function *,
+                                              CountingHasLetterInName<'e'>>;
+
+    std::vector<BasicBlock *> Expected;
+    for (BasicBlock *BB : llvm::depth_first(NPFG(F)))
+      Expected.push_back(BB);
+
+    PredicateCalls = 0;
+    std::vector<BasicBlock *> Results;
+    for (BasicBlock *BB : llvm::depth_first(CNPFG(F)))
+      Results.push_back(BB);
+    revng_check(Results == Expected);
+    revng_check(PredicateCalls > 0);
+
+    unsigned FirstVisitCalls = PredicateCalls;
+    Results.clear();
+    for (BasicBlock *BB : llvm::depth_first(CNPFG(F)))
+      Results.push_back(BB);
+    revng_check(Results == Expected);
+    revng_check(PredicateCalls == FirstVisitCalls);
+
+    // Predecessors are cached separately
+    using BBNPFG = NodePairFilteredGraph<BasicBlock *,
+                                         CountingHasLetterInName<'e'>>;
+    using BBCNPFG = CachedNodePairFilteredGraph<BasicBlock *,
+                                                CountingHasLetterInName<'e'>>;
+    std::vector<BasicBlock *> ExpectedInverse;
+    for (BasicBlock *BB : llvm::inverse_depth_first(BBNPFG(BackBB)))
+      ExpectedInverse.push_back(BB);
+    Results.clear();
+    for (BasicBlock *BB : llvm::inverse_depth_first(BBCNPFG(BackBB)))
+      Results.push_back(BB);
+    revng_check(Results == ExpectedInverse);
+    BBCNPFG::invalidate();
+
+    // After the invalidation, the predicate is evaluated again
+    CNPFG::invalidate();
+    PredicateCalls = 0;
+    Results.clear();
+    for (BasicBlock *BB : llvm::depth_first(CNPFG(F)))
+      Results.push_back(BB);
+    revng_check(Results == Expected);
+    revng_check(PredicateCalls == FirstVisitCalls);
+    CNPFG::invalidate();
+  }
+
+  { // Edge filter
+    DotGraph Input;
+    using namespace boost::unit_test::framework;
+    revng_check(master_test_suite().argc == 2);
+    std::string FileName = master_test_suite().argv[1];
+    FileName += "001.dot";
+    Input.parseDotFromFile(FileName, "initial_block");
+
+    using EFG = EdgeFilteredGraph<DotNode *, CountingEdgeHasLetterInName<'a'>>;
+    using CEFG = CachedEdgeFilteredGraph<DotNode *,
+                                         CountingEdgeHasLetterInName<'a'>>;
+
+    DotNode *Entry = Input.getNodeByName("initial_block");
+    DotNode *Exit = Input.getNodeByName("end");
+
+    std::vector<llvm::StringRef> Expected, ExpectedInverse, Results;
+    for (DotNode *Node : llvm::depth_first(EFG(Entry)))
+      Expected.push_back(Node->getName());
+    for (DotNode *Node : llvm::inverse_depth_first(EFG(Exit)))
+      ExpectedInverse.push_back(Node->getName());
+
+    PredicateCalls = 0;
+    for (DotNode *Node : llvm::depth_first(CEFG(Entry)))
+      Results.push_back(Node->getName());
+    revng_check(Results == Expected);
+
+    unsigned FirstVisitCalls = PredicateCalls;
+    Results.clear();
+    for (DotNode *Node : llvm::depth_first(CEFG(Entry)))
+      Results.push_back(Node->getName());
+    revng_check(Results == Expected);
+    revng_check(PredicateCalls == FirstVisitCalls);
+
+    Results.clear();
+    for (DotNode *Node : llvm::inverse_depth_first(CEFG(Exit)))
+      Results.push_back(Node->getName());
+    revng_check(Results == ExpectedInverse);
+
+    // Edges are served from the cache too
+    for (DotNode *Node : llvm::depth_first(CEFG(Entry)))
+      for (const auto &Edge : llvm::children_edges<CEFG>(Node))
+        revng_check(Edge.second->getName().contains('a'));
+
+    CEFG::invalidate();
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,122 @@
+/// \file FormSuperblocks.cpp
+/// \brief Tests for FormSuperblocksPass
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <memory>
+
+#define BOOST_TEST_MODULE FormSuperblocks
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/SourceMgr.h"
+
+#include "revng/FunctionIsolation/FormSuperblocks.h"
+#include "revng/Support/Assert.h"
+#include "revng/Support/FunctionTags.h"
+#include "revng/Support/IRHelpers.h"
+
+using namespace llvm;
+
+// A loop whose body takes the hot side of a diamond, then reaches the join
+// point testing the exit condition
+static const char *LoopModule = R"LLVM(
+@a = internal global i64 0
+@b = internal global i64 0
+
+define void @f() {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i64 [ 0, %entry ], [ %next, %join ]
+  %value = load i64, i64* @a
+  %condition = icmp eq i64 %value, 0
+  br i1 %condition, label %hot, label %cold{{PROFILE}}
+
+hot:
+  store i64 1, i64* @b
+  br label %join
+
+cold:
+  store i64 2, i64* @b
+  br label %join
+
+join:
+  %next = add i64 %i, 1
+  %done = icmp eq i64 %next, 100
+  br i1 %done, label %exit, label %loop
+
+exit:
+  store i64 %next, i64* @a
+  ret void
+}
+
+!0 = !{!"branch_weights", i32 1000, i32 1}
+)LLVM";
+
+static std::unique_ptr<Module> run(LLVMContext &Context, bool WithProfile) {
+  std::string Source = LoopModule;
+  std::string Placeholder = "{{PROFILE}}";
+  Source.replace(Source.find(Placeholder),
+                 Placeholder.size(),
+                 WithProfile ? ", !prof !0" : "");
+
+  SMDiagnostic Diagnostic;
+  auto Buffer = MemoryBuffer::getMemBuffer(Source);
+  std::unique_ptr<Module> M = parseIR(Buffer->getMemBufferRef(),
+                                      Diagnostic,
+                                      Context);
+  revng_check(M.get() != nullptr);
+  FunctionTags::Root.addTo(M->getFunction("f"));
+
+  legacy::PassManager PM;
+  PM.add(new FormSuperblocksPass());
+  PM.run(*M);
+
+  revng_check(not verifyModule(*M, &dbgs()));
+  return M;
+}
+
+static BasicBlock *getBlock(Function &F, StringRef Name) {
+  for (BasicBlock &BB : F)
+    if (BB.getName() == Name)
+      return &BB;
+  revng_abort();
+}
+
+BOOST_AUTO_TEST_CASE(HotJoinPointIsCopied) {
+  LLVMContext Context;
+  auto M = run(Context, true);
+  Function &F = *M->getFunction("f");
+
+  // hot now tests the exit condition on its own
+  auto *Branch = cast<BranchInst>(getBlock(F, "hot")->getTerminator());
+  revng_check(Branch->isConditional());
+
+  // join is left to cold only
+  BasicBlock *Join = getBlock(F, "join");
+  revng_check(Join->getSinglePredecessor() == getBlock(F, "cold"));
+
+  // The induction variable and the exit see both definitions of %next
+  revng_check(pred_size(getBlock(F, "exit")) == 2);
+  revng_check(isa<PHINode>(getBlock(F, "exit")->front()));
+}
+
+BOOST_AUTO_TEST_CASE(NoProfileNoChanges) {
+  LLVMContext Context;
+  auto M = run(Context, false);
+  Function &F = *M->getFunction("f");
+
+  auto *Branch = cast<BranchInst>(getBlock(F, "hot")->getTerminator());
+  revng_check(Branch->isUnconditional());
+  revng_check(pred_size(getBlock(F, "join")) == 2);
+}
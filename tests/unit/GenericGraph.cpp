@@ -18,6 +18,7 @@ bool init_unit_test();
 #include "llvm/Support/raw_ostream.h"
 
 #include "revng/ADT/FilteredGraphTraits.h"
+#include "revng/ADT/FrozenGraph.h"
 #include "revng/ADT/GenericGraph.h"
 #include "revng/ADT/SerializableGraph.h"
 
@@ -280,6 +281,89 @@ BOOST_AUTO_TEST_CASE(TestFilterGraphTraits) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(TestFrozenGraph) {
+  auto DG = createGraph<BidirectionalTestNode>();
+  auto Frozen = freeze(DG.Graph);
+  using FrozenNode = decltype(Frozen)::Node;
+
+  revng_check(Frozen.size() == 4);
+  FrozenNode *Root = Frozen.getEntryNode();
+  revng_check(Root->Rank == 0);
+  revng_check(Frozen.indexOf(Root) == 0);
+
+  revng_check(Root->successorCount() == 2);
+  revng_check(Root->successors()[0]->Rank == 1);
+  revng_check(Root->successors()[1]->Rank == 3);
+  revng_check(not Root->hasPredecessors());
+
+  FrozenNode *Final = Root->successors()[0]->successors()[0];
+  revng_check(Final->Rank == 2);
+  revng_check(not Final->hasSuccessors());
+  revng_check(Final->predecessorCount() == 2);
+  revng_check(Final->predecessors()[0]->Rank == 1);
+  revng_check(Final->predecessors()[1]->Rank == 3);
+
+  // Check the frozen graph can be moved around
+  auto Moved = std::move(Frozen);
+  revng_check(Moved.getEntryNode() == Root);
+
+  std::vector<FrozenNode *> Visited;
+  for (FrozenNode *Node : ReversePostOrderTraversal<decltype(&Moved)>(&Moved))
+    Visited.push_back(Node);
+  revng_check(Visited.size() == 4);
+  revng_check(Visited.front() == Root and Visited.back() == Final);
+
+  Visited.clear();
+  for (FrozenNode *Node : inverse_depth_first(Final))
+    Visited.push_back(Node);
+  revng_check(Visited.size() == 4);
+
+  unsigned SCCCount = 0;
+  for (auto &SCC : make_range(scc_begin(&Moved), scc_end(&Moved))) {
+    revng_check(SCC.size() == 1);
+    ++SCCCount;
+  }
+  revng_check(SCCCount == 4);
+}
+
+struct CountedNodeData {
+  static inline int Alive = 0;
+  CountedNodeData(int) { ++Alive; }
+  CountedNodeData(const CountedNodeData &) { ++Alive; }
+  ~CountedNodeData() { --Alive; }
+};
+
+BOOST_AUTO_TEST_CASE(TestNodesLifetime) {
+  using NodeType = BidirectionalNode<CountedNodeData>;
+  {
+    GenericGraph<NodeType> Graph;
+    NodeType *Previous = Graph.addNode(0);
+    for (int I = 1; I < 100; ++I) {
+      NodeType *Current = Graph.addNode(I);
+      Previous->addSuccessor(Current);
+      Previous = Current;
+    }
+
+    // Nodes allocated outside of the graph are still accepted
+    Graph.addNode(std::make_unique<NodeType>(100));
+    revng_check(CountedNodeData::Alive == 101);
+
+    Graph.removeNode(Graph.nodes().begin());
+    revng_check(CountedNodeData::Alive == 100);
+
+    // Moving the graph preserves the nodes
+    auto Moved = std::move(Graph);
+    revng_check(Moved.size() == 100);
+    revng_check(CountedNodeData::Alive == 100);
+
+    Moved.clear();
+    revng_check(CountedNodeData::Alive == 0);
+
+    Moved.addNode(0);
+  }
+  revng_check(CountedNodeData::Alive == 0);
+}
+
 BOOST_AUTO_TEST_CASE(TestWriteGraph) {
   auto DG = createGraph<BidirectionalTestNode>();
   llvm::raw_null_ostream NullOutput;
@@ -312,6 +396,31 @@ BOOST_AUTO_TEST_CASE(TestSerializeGraph) {
   revng_check(Deserialized == Serializable);
 }
 
+BOOST_AUTO_TEST_CASE(TestBinarySerializeGraph) {
+  auto DG = createGraph<BidirectionalTestNode>();
+  auto Serializable = toSerializable(DG.Graph);
+  using Binary = BinaryGraph<TestNodeData, TestEdgeLabel>;
+
+  std::string Buffer;
+  {
+    llvm::raw_string_ostream Stream(Buffer);
+    Binary::write(Serializable, Stream);
+  }
+
+  auto Deserialized = Binary::fromBuffer(Buffer);
+  revng_check(Deserialized);
+  revng_check(Deserialized->nodeCount() == 4);
+  revng_check(Deserialized->edgeCount() == 4);
+  revng_check(Deserialized->toSerializable() == Serializable);
+
+  using Node = decltype(DG)::Node;
+  auto Reloaded = Deserialized->toGenericGraph<Node>();
+  revng_check(toSerializable(Reloaded) == Serializable);
+
+  // Truncated buffers are rejected
+  revng_check(not Binary::fromBuffer(StringRef(Buffer).drop_back()));
+}
+
 // MutableEdgeNode tests
 struct SomeNode {
   std::string Text;
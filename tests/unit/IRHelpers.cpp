@@ -9,6 +9,8 @@
 bool init_unit_test();
 #include "boost/test/unit_test.hpp"
 
+#include "llvm/IR/IRBuilder.h"
+
 #include "revng/Support/IRHelpers.h"
 #include "revng/UnitTestHelpers/LLVMTestHelpers.h"
 #include "revng/UnitTestHelpers/UnitTestHelpers.h"
@@ -95,3 +97,58 @@ BOOST_AUTO_TEST_CASE(TestForwardBFSVisitor) {
   };
   revng_check(V.VisitLog == GroundTruth);
 }
+
+BOOST_AUTO_TEST_CASE(TestVisitBackwardReusingVisited) {
+  LLVMContext TestContext;
+  std::unique_ptr<Module> M = loadModule(TestContext, VisitorTestBody);
+  Function *F = M->getFunction("main");
+
+  const std::vector<std::string> GroundTruth = { "target",           "d",
+                                                 "first_if_false:2", "c",
+                                                 "first_if_true:2",  "b",
+                                                 "initial_block:2",  "a" };
+
+  BasicBlockSet Visited;
+  for (unsigned I = 0; I < 2; ++I) {
+    std::vector<std::string> VisitLog;
+    visitBackward(instructionByName(F, "target"), Visited, [&](auto Range) {
+      for (Instruction &I : Range)
+        VisitLog.push_back(getName(&I));
+      return Continue;
+    });
+    revng_check(VisitLog == GroundTruth);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestNewPCCache) {
+  LLVMContext TestContext;
+  std::unique_ptr<Module> M = loadModule(TestContext, VisitorTestBody);
+  Function *F = M->getFunction("main");
+
+  auto *Int64 = Type::getInt64Ty(TestContext);
+  auto *NewPCType = FunctionType::get(Type::getVoidTy(TestContext),
+                                      { Int64, Int64 },
+                                      false);
+  FunctionCallee NewPC = M->getOrInsertFunction("newpc", NewPCType);
+  auto InsertNewPC = [&](const char *Before, uint64_t Address) {
+    IRBuilder<> Builder(instructionByName(F, Before));
+    Value *Arguments[] = { ConstantInt::get(Int64, Address),
+                           ConstantInt::get(Int64, 1) };
+    return Builder.CreateCall(NewPC, Arguments);
+  };
+
+  CallInst *First = InsertNewPC("a", 0x1000);
+  CallInst *Second = InsertNewPC("e", 0x2000);
+
+  NewPCCache Cache;
+
+  // Both the paths to center come from the first newpc
+  revng_check(Cache.reaching(instructionByName(F, "target")) == First);
+  revng_check(Cache.reaching(instructionByName(F, "f")) == First);
+
+  // The newpc in the same block takes precedence
+  revng_check(Cache.reaching(instructionByName(F, "e")) == Second);
+
+  // The predecessors of end disagree
+  revng_check(Cache.reaching(instructionByName(F, "g")) == nullptr);
+}
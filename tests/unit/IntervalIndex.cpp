@@ -0,0 +1,104 @@
+/// \file IntervalIndex.cpp
+/// \brief Tests for IntervalIndex
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+#define BOOST_TEST_MODULE IntervalIndex
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "revng/ADT/IntervalIndex.h"
+
+using Index = IntervalIndex<unsigned>;
+
+static std::vector<unsigned>
+overlapping(const Index &TheIndex, uint64_t Start, uint64_t End) {
+  std::vector<unsigned> Result;
+  TheIndex.forEachOverlapping(Start, End, [&Result](const Index::Entry &E) {
+    Result.push_back(E.Value);
+  });
+  std::sort(Result.begin(), Result.end());
+  return Result;
+}
+
+static std::vector<unsigned> containing(const Index &TheIndex, uint64_t Point) {
+  std::vector<unsigned> Result;
+  TheIndex.forEachContaining(Point, [&Result](const Index::Entry &E) {
+    Result.push_back(E.Value);
+  });
+  std::sort(Result.begin(), Result.end());
+  return Result;
+}
+
+BOOST_AUTO_TEST_CASE(TestEmpty) {
+  Index Empty;
+  revng_check(Empty.empty());
+  revng_check(containing(Empty, 0).empty());
+
+  // Empty intervals are dropped
+  Index OnlyEmpty({ { 10, 10, 0 }, { 20, 5, 1 } });
+  revng_check(OnlyEmpty.empty());
+  revng_check(overlapping(OnlyEmpty, 0, 100).empty());
+}
+
+BOOST_AUTO_TEST_CASE(TestSimple) {
+  constexpr uint64_t Max = std::numeric_limits<uint64_t>::max();
+  Index TheIndex({ { 10, 20, 0 },
+                   { 15, 30, 1 },
+                   { 0, 5, 2 },
+                   { 100, Max, 3 } });
+  revng_check(TheIndex.size() == 4);
+
+  using Values = std::vector<unsigned>;
+  revng_check(containing(TheIndex, 4) == Values{ 2 });
+  revng_check(containing(TheIndex, 5).empty());
+  revng_check(containing(TheIndex, 17) == (Values{ 0, 1 }));
+  revng_check(containing(TheIndex, 20) == Values{ 1 });
+  revng_check(containing(TheIndex, Max - 1) == Values{ 3 });
+  revng_check(containing(TheIndex, Max).empty());
+  revng_check(overlapping(TheIndex, 5, 10).empty());
+  revng_check(overlapping(TheIndex, 5, 11) == Values{ 0 });
+  revng_check(overlapping(TheIndex, 0, Max) == (Values{ 0, 1, 2, 3 }));
+  revng_check(overlapping(TheIndex, 17, 17).empty());
+}
+
+BOOST_AUTO_TEST_CASE(TestRandom) {
+  // Compare against a linear scan, with sizes around powers of two
+  std::mt19937_64 Generator(42);
+  for (unsigned Size : { 1, 2, 3, 7, 8, 9, 31, 32, 33, 100, 1000 }) {
+    std::vector<Index::Entry> Entries;
+    for (unsigned I = 0; I < Size; ++I) {
+      uint64_t Start = Generator() % 2000;
+      uint64_t Length = Generator() % 4 == 0 ? Generator() % 500 :
+                                               Generator() % 20;
+      Entries.push_back({ Start, Start + Length, I });
+    }
+
+    Index TheIndex(Entries);
+
+    for (unsigned Query = 0; Query < 500; ++Query) {
+      uint64_t Start = Generator() % 2600;
+      uint64_t End = Start + 1 + Generator() % 50;
+
+      std::vector<unsigned> ExpectedOverlapping;
+      std::vector<unsigned> ExpectedContaining;
+      for (const Index::Entry &E : Entries) {
+        bool IsEmpty = E.End <= E.Start;
+        if (not IsEmpty and E.Start < End and Start < E.End)
+          ExpectedOverlapping.push_back(E.Value);
+        if (E.Start <= Start and Start < E.End)
+          ExpectedContaining.push_back(E.Value);
+      }
+
+      revng_check(overlapping(TheIndex, Start, End) == ExpectedOverlapping);
+      revng_check(containing(TheIndex, Start) == ExpectedContaining);
+    }
+  }
+}
@@ -0,0 +1,135 @@
+/// \file IntervalSet.cpp
+/// \brief Tests for IntervalSet
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#define BOOST_TEST_MODULE IntervalSet
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "revng/ADT/IntervalSet.h"
+#include "revng/Support/Assert.h"
+
+using Interval = IntervalSet::Interval;
+using Intervals = std::vector<Interval>;
+
+static bool matches(const IntervalSet &Set, const Intervals &Expected) {
+  llvm::ArrayRef<Interval> Actual = Set.intervals();
+  return Actual.vec() == Expected;
+}
+
+static IntervalSet roundTrip(const IntervalSet &Set) {
+  std::string Buffer;
+  llvm::raw_string_ostream Stream(Buffer);
+  Set.serialize(Stream);
+  Stream.flush();
+
+  auto Result = IntervalSet::deserialize(Buffer);
+  revng_check(Result);
+  return *Result;
+}
+
+BOOST_AUTO_TEST_CASE(TestEmpty) {
+  IntervalSet Empty;
+  revng_check(Empty.empty());
+  revng_check(not Empty.contains(0));
+  revng_check(not Empty.overlaps(0, 100));
+
+  // Empty intervals are ignored
+  Empty.insert(10, 10);
+  Empty.insert(20, 5);
+  revng_check(Empty.empty());
+  revng_check(IntervalSet({ { 10, 10 }, { 20, 5 } }).empty());
+
+  revng_check(roundTrip(Empty).empty());
+}
+
+BOOST_AUTO_TEST_CASE(TestMerge) {
+  constexpr uint64_t Max = std::numeric_limits<uint64_t>::max();
+
+  // In order, out of order, overlapping and adjacent insertions
+  IntervalSet Set;
+  Set.insert(10, 20);
+  Set.insert(15, 30);
+  Set.insert(100, Max);
+  Set.insert(0, 5);
+  Set.insert(30, 40);
+  Set.insert(50, 60);
+  revng_check(matches(Set, { { 0, 5 }, { 10, 40 }, { 50, 60 }, { 100, Max } }));
+
+  revng_check(Set.contains(4));
+  revng_check(not Set.contains(5));
+  revng_check(Set.contains(39));
+  revng_check(Set.contains(39));
+  revng_check(not Set.contains(40));
+  revng_check(Set.contains(Max - 1));
+  revng_check(not Set.contains(Max));
+  revng_check(Set.find(35)->Start == 10);
+
+  revng_check(not Set.overlaps(5, 10));
+  revng_check(Set.overlaps(5, 11));
+  revng_check(Set.overlaps(45, 51));
+  revng_check(not Set.overlaps(60, 100));
+  revng_check(not Set.overlaps(17, 17));
+
+  IntervalSet Bulk({
+    { 50, 60 }, { 100, Max }, { 30, 40 }, { 0, 5 }, { 10, 31 } });
+  revng_check(Bulk == Set);
+  revng_check(roundTrip(Set) == Set);
+}
+
+BOOST_AUTO_TEST_CASE(TestMalformed) {
+  revng_check(not IntervalSet::deserialize(""));
+
+  // Truncated
+  revng_check(not IntervalSet::deserialize(llvm::StringRef("\x01\x05", 2)));
+
+  // Empty interval
+  revng_check(not IntervalSet::deserialize(llvm::StringRef("\x01\x05\x00", 3)));
+
+  // Adjacent intervals
+  llvm::StringRef Adjacent("\x02\x05\x01\x00\x01", 5);
+  revng_check(not IntervalSet::deserialize(Adjacent));
+
+  // Trailing data
+  revng_check(not IntervalSet::deserialize(llvm::StringRef("\x00\x00", 2)));
+}
+
+BOOST_AUTO_TEST_CASE(TestRandom) {
+  // Compare against a bitmap
+  constexpr uint64_t Size = 2000;
+  std::mt19937_64 Generator(42);
+  for (unsigned Count : { 1, 2, 10, 100, 1000 }) {
+    std::vector<bool> Expected(Size + 64);
+    IntervalSet Set;
+    for (unsigned I = 0; I < Count; ++I) {
+      uint64_t Start = Generator() % Size;
+      uint64_t End = Start + Generator() % 50;
+      Set.insert(Start, End);
+      for (uint64_t Point = Start; Point < End; ++Point)
+        Expected[Point] = true;
+
+      // Interleave insertions and queries
+      uint64_t Point = Generator() % Size;
+      revng_check(Set.contains(Point) == Expected[Point]);
+    }
+
+    for (uint64_t Point = 0; Point < Expected.size(); ++Point)
+      revng_check(Set.contains(Point) == Expected[Point]);
+
+    // Intervals are disjoint and separated by a gap
+    llvm::ArrayRef<Interval> All = Set.intervals();
+    for (size_t I = 1; I < All.size(); ++I)
+      revng_check(All[I - 1].End < All[I].Start);
+
+    revng_check(roundTrip(Set) == Set);
+  }
+}
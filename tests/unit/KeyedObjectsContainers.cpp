@@ -152,10 +152,115 @@ BOOST_AUTO_TEST_CASE(TestMutableSet) {
   testSet<MutableSet<Element>>();
 }
 
+BOOST_AUTO_TEST_CASE(TestFlatMutableSet) {
+  testSet<FlatMutableSet<Element>>();
+}
+
 BOOST_AUTO_TEST_CASE(TestSortedVector) {
   testSet<SortedVector<Element>>();
 }
 
+BOOST_AUTO_TEST_CASE(TestHashIndexedSortedVector) {
+  testSet<HashIndexedSortedVector<Element>>();
+}
+
+BOOST_AUTO_TEST_CASE(TestHashIndexedSortedVectorInvalidation) {
+  HashIndexedSortedVector<Element> Vector{ { 10, 10 }, { 30, 30 } };
+  revng_check(Vector.find(10) == Vector.begin());
+
+  // Inserting in the middle moves the following elements
+  Vector.insert({ 20, 20 });
+  revng_check(Vector.at(30).value() == 30);
+  revng_check(Vector.find(20) == Vector.begin() + 1);
+
+  // So does erasing
+  Vector.erase(10);
+  revng_check(Vector.count(10) == 0);
+  revng_check(Vector.find(20) == Vector.begin());
+
+  // Bulk operations
+  Vector.insert_or_assign_sorted({ { 5, 5 }, { 25, 25 } });
+  revng_check(Vector.at(25).value() == 25);
+  std::vector<uint64_t> ToErase{ 5, 20 };
+  Vector.erase_sorted(ToErase);
+  revng_check(Vector.find(30) == Vector.begin() + 1);
+
+  {
+    auto Inserter = Vector.batch_insert();
+    Inserter.insert({ 1, 1 });
+  }
+  revng_check(Vector.find(1) == Vector.begin());
+  revng_check(Vector.at(30).value() == 30);
+
+  // Copies have their own index
+  HashIndexedSortedVector<Element> Copy = Vector;
+  Vector.clear();
+  revng_check(Vector.find(1) == Vector.end());
+  revng_check(Copy.at(1).value() == 1);
+
+  HashIndexedSortedVector<Element> Expected{ { 1, 1 }, { 25, 25 }, { 30, 30 } };
+  revng_check(Copy == Expected);
+}
+
+BOOST_AUTO_TEST_CASE(TestSortedVectorSortedBulkOperations) {
+  SortedVector<Element> Vector{ { 0, 0 }, { 2, 0 }, { 4, 0 }, { 6, 0 } };
+
+  // Assign existing elements and merge in new ones
+  Vector.insert_or_assign_sorted({ { 1, 1 }, { 2, 2 }, { 7, 7 } });
+  revng_check(Vector.size() == 6);
+  revng_check(Vector.at(2).value() == 2);
+  revng_check(Vector.at(7).value() == 7);
+  revng_check(std::is_sorted(Vector.begin(), Vector.end(), [](auto &L, auto &R) {
+    return L.key() < R.key();
+  }));
+
+  // Missing keys are ignored
+  std::vector<uint64_t> ToErase{ 0, 3, 6, 7 };
+  revng_check(Vector.erase_sorted(ToErase) == 3);
+
+  SortedVector<Element> Expected{ { 1, 1 }, { 2, 2 }, { 4, 0 } };
+  revng_check(Vector == Expected);
+}
+
+BOOST_AUTO_TEST_CASE(TestSortedVectorBatchInsert) {
+  SortedVector<Element> Vector{ { 10, 0 }, { 20, 0 } };
+
+  // Elements in order: appended after the existing ones, no sorting
+  {
+    auto Inserter = Vector.batch_insert();
+    Inserter.reserve(2);
+    Inserter.insert({ 30, 30 });
+    Inserter.insert({ 40, 40 });
+  }
+  revng_check(Vector.size() == 4);
+
+  // Elements out of order: sorted on multiple threads and merged, keeping the
+  // existing elements
+  constexpr uint64_t Count = 100000;
+  {
+    auto Inserter = Vector.batch_insert();
+    Inserter.setThreads(4);
+    Inserter.reserve(Count);
+    for (uint64_t I = Count; I > 0; --I)
+      Inserter.insert({ I, I });
+  }
+  revng_check(Vector.size() == Count);
+  revng_check(Vector.at(20).value() == 0);
+  revng_check(Vector.at(Count).value() == Count);
+  revng_check(std::is_sorted(Vector.begin(), Vector.end(), [](auto &L, auto &R) {
+    return L.key() < R.key();
+  }));
+
+  // Assigning replaces the existing elements
+  {
+    auto Inserter = Vector.batch_insert_or_assign();
+    Inserter.insert_or_assign({ 5, 5 });
+    Inserter.insert_or_assign({ 20, 20 });
+  }
+  revng_check(Vector.size() == Count);
+  revng_check(Vector.at(20).value() == 20);
+}
+
 template<typename T>
 bool isSerializationStable(T &&Original) {
   std::string Buffer;
@@ -176,10 +281,14 @@ bool isSerializationStable(T &&Original) {
 BOOST_AUTO_TEST_CASE(TestYAMLSerializationStability) {
   revng_check(isSerializationStable(SortedVector<int>{ 4, 19, 7 }));
   revng_check(isSerializationStable(MutableSet<int>{ 4, 19, 7 }));
+  revng_check(isSerializationStable(FlatMutableSet<int>{ 4, 19, 7 }));
 
   SortedVector<Element> TestSV{ { 1, 2 }, { 2, 3 } };
   revng_check(isSerializationStable(std::move(TestSV)));
 
+  HashIndexedSortedVector<Element> TestHISV{ { 1, 2 }, { 2, 3 } };
+  revng_check(isSerializationStable(std::move(TestHISV)));
+
   MutableSet<Element> TestMS{ { 1, 2 }, { 2, 3 } };
   revng_check(isSerializationStable(std::move(TestMS)));
 }
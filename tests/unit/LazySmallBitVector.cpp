@@ -219,3 +219,71 @@ BOOST_AUTO_TEST_CASE(TestIterator) {
   std::copy(A.begin(), A.end(), std::back_inserter(Results));
   BOOST_REQUIRE_EQUAL(Results, (std::vector<unsigned>{ 0, 16, 1000 }));
 }
+
+BOOST_AUTO_TEST_CASE(TestCount) {
+  LazySmallBitVector A;
+  BOOST_TEST(A.count() == 0U);
+
+  // Test small
+  A.set(0);
+  A.set(16);
+  BOOST_TEST(A.count() == 2U);
+
+  // Test large
+  A.set(FirstLargeBit);
+  A.set(1000);
+  BOOST_TEST(A.count() == 4U);
+
+  A.unset(16);
+  BOOST_TEST(A.count() == 3U);
+}
+
+BOOST_AUTO_TEST_CASE(TestLargeBulkOperations) {
+  LazySmallBitVector A;
+  LazySmallBitVector B;
+
+  for (unsigned I = 0; I < 2000; I += 3)
+    A.set(I);
+
+  for (unsigned I = 0; I < 1000; I += 2)
+    B.set(I);
+
+  LazySmallBitVector Union = A | B;
+  LazySmallBitVector Intersection = A & B;
+  LazySmallBitVector Difference = A ^ B;
+
+  for (unsigned I = 0; I < 2000; I++) {
+    bool InA = I % 3 == 0;
+    bool InB = I < 1000 and I % 2 == 0;
+    BOOST_TEST(Union[I] == (InA or InB));
+    BOOST_TEST(Intersection[I] == (InA and InB));
+    BOOST_TEST(Difference[I] == (InA != InB));
+  }
+
+  BOOST_TEST(Union.count() == Intersection.count() + Difference.count());
+  BOOST_TEST((Difference ^ B) == A);
+
+  // Equality ignores trailing zero words of the larger vector
+  LazySmallBitVector Small;
+  Small.set(3);
+  LazySmallBitVector Large = Small;
+  Large.set(1500);
+  Large.unset(1500);
+  BOOST_TEST(!Large.isSmall());
+  BOOST_TEST(Small == Large);
+  BOOST_TEST(Large == Small);
+
+  LazySmallBitVector LargeCopy;
+  LargeCopy.set(3);
+  LargeCopy.set(FirstLargeBit);
+  LargeCopy.unset(FirstLargeBit);
+  BOOST_TEST(Large == LargeCopy);
+  LargeCopy.set(FirstLargeBit + 1);
+  BOOST_TEST(Large != LargeCopy);
+
+  // Iteration skips the empty words
+  std::vector<unsigned> Results;
+  Large.set(1999);
+  std::copy(Large.begin(), Large.end(), std::back_inserter(Results));
+  BOOST_REQUIRE_EQUAL(Results, (std::vector<unsigned>{ 3, 1999 }));
+}
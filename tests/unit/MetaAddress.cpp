@@ -6,13 +6,19 @@
 //
 
 #include <map>
+#include <unordered_map>
+#include <vector>
 
 #define BOOST_TEST_MODULE MetaAddress
 bool init_unit_test();
 #include "boost/test/execution_monitor.hpp"
 #include "boost/test/unit_test.hpp"
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/IR/LLVMContext.h"
+
 #include "revng/Support/MetaAddress.h"
+#include "revng/Support/MetaAddressConstants.h"
 #include "revng/UnitTestHelpers/UnitTestHelpers.h"
 
 BOOST_TEST_DONT_PRINT_LOG_VALUE(MetaAddress)
@@ -178,3 +184,70 @@ BOOST_AUTO_TEST_CASE(Map) {
 
   BOOST_TEST(Map.size() == size_t(5));
 }
+
+BOOST_AUTO_TEST_CASE(PackedKey) {
+  std::vector<MetaAddress> Addresses = {
+    MetaAddress::invalid(),
+    generic64(0),
+    generic64(0x1000),
+    pc(0x1000),
+    MetaAddress::fromPC(Triple::x86_64, 0x1000, 1),
+    MetaAddress::fromPC(Triple::x86_64, 0x1000, 0, 1),
+    MetaAddress::fromPC(Triple::arm, 0x1001)
+  };
+
+  for (const MetaAddress &LHS : Addresses) {
+    for (const MetaAddress &RHS : Addresses) {
+      BOOST_TEST((LHS.packed() < RHS.packed()) == (LHS < RHS));
+      BOOST_TEST((LHS.packed() == RHS.packed()) == (LHS == RHS));
+    }
+  }
+
+  BOOST_TEST(compareAddress<MetaAddress>()(pc(0x1000), pc(0x1001)));
+  BOOST_TEST(not compareAddress<MetaAddress>()(pc(0x1001), pc(0x1000)));
+}
+
+BOOST_AUTO_TEST_CASE(Hash) {
+  llvm::DenseMap<MetaAddress, int> DenseMap;
+  std::unordered_map<MetaAddress, int> UnorderedMap;
+
+  for (MetaAddress Address : { generic64(0),
+                               MetaAddress::invalid(),
+                               pc(0),
+                               MetaAddress::fromPC(Triple::arm, 0),
+                               MetaAddress::fromPC(Triple::arm, 1) }) {
+    DenseMap[Address] = 1;
+    UnorderedMap[Address] = 1;
+  }
+
+  BOOST_TEST(DenseMap.size() == size_t(5));
+  BOOST_TEST(UnorderedMap.size() == size_t(5));
+  BOOST_TEST(DenseMap.count(pc(0)) == size_t(1));
+  BOOST_TEST(DenseMap.count(pc(1)) == size_t(0));
+}
+
+BOOST_AUTO_TEST_CASE(ConstantsCache) {
+  LLVMContext Context;
+  auto *Struct = StructType::create({ Type::getInt32Ty(Context),
+                                      Type::getInt16Ty(Context),
+                                      Type::getInt16Ty(Context),
+                                      Type::getInt64Ty(Context) },
+                                    "MetaAddress");
+  MetaAddressConstants Constants(Struct);
+
+  // toConstant agrees with MetaAddress and always returns the same constant
+  Constant *PC = Constants.toConstant(pc(0x1000));
+  BOOST_TEST(PC == pc(0x1000).toConstant(Struct));
+  BOOST_TEST(Constants.toConstant(pc(0x1000)) == PC);
+  BOOST_TEST(Constants.toConstant(pc(0x1004)) != PC);
+
+  // fromConstant works on constants not created through the cache too
+  Constant *Generic = generic64(0x2000).toConstant(Struct);
+  BOOST_TEST(Constants.fromConstant(Generic) == generic64(0x2000));
+  BOOST_TEST(Constants.fromConstant(Generic) == generic64(0x2000));
+  BOOST_TEST(Constants.toConstant(generic64(0x2000)) == Generic);
+
+  BOOST_TEST(Constants.fromConstant(PC) == pc(0x1000));
+  Constant *Invalid = Constants.toConstant(MetaAddress::invalid());
+  BOOST_TEST(Constants.fromConstant(Invalid).isInvalid());
+}
@@ -10,7 +10,9 @@ bool init_unit_test();
 #include "boost/test/unit_test.hpp"
 
 #include "revng/Model/Binary.h"
+#include "revng/Model/TupleTreeBinary.h"
 #include "revng/Model/TupleTreeDiff.h"
+#include "revng/Model/TupleTreeDiffBinary.h"
 
 using namespace model;
 
@@ -196,6 +198,33 @@ BOOST_AUTO_TEST_CASE(TestTupleTreeReference) {
   revng_check(AnElement.Self.get() == &AnElement);
 }
 
+BOOST_AUTO_TEST_CASE(TestTupleTreeReferenceAfterMutations) {
+  using namespace TestTupleTree;
+
+  using Reference = TupleTreeReference<TestTupleTree::Element,
+                                       TestTupleTree::Root>;
+
+  TupleTree<Root> TheRoot;
+  TheRoot->Elements[3];
+  Reference ToThree = Reference::fromString(TheRoot.get(), "/Elements/3");
+  revng_check(ToThree.get() == &TheRoot->Elements.at(3));
+
+  // Shift and reallocate the elements: the cached element must not be used
+  for (int I = 0; I < 100; ++I)
+    TheRoot->Elements[-I];
+  revng_check(ToThree.get() == &TheRoot->Elements.at(3));
+  revng_check(ToThree.get() == &TheRoot->Elements.at(3));
+
+  // Replace the cached element with another one
+  TheRoot->Elements.erase(3);
+  revng_check(ToThree.get() == nullptr);
+  TheRoot->Elements[3];
+  revng_check(ToThree.get() == &TheRoot->Elements.at(3));
+
+  Reference Copy = ToThree;
+  revng_check(Copy.get() == ToThree.get());
+}
+
 BOOST_AUTO_TEST_CASE(TestTupleTreeDiff) {
   if (false) {
     model::Binary Left;
@@ -204,8 +233,175 @@ BOOST_AUTO_TEST_CASE(TestTupleTreeDiff) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(TestTupleTreeDiffSkipsIdenticalSubtrees) {
+  model::Binary Left;
+  model::Binary Right;
+  for (model::Binary *Binary : { &Left, &Right }) {
+    Binary->Functions[ARM1000].CFG[ARM1000].End = ARM2000;
+    Binary->Functions[ARM2000].CustomName = "second";
+  }
+
+  TupleTreeHashes LeftHashes;
+  TupleTreeHashes RightHashes;
+  revng_check(LeftHashes.hash(Left) == RightHashes.hash(Right));
+  revng_check(diff(Left, Right).Changes.size() == 0);
+
+  Right.Functions.at(ARM2000).CustomName = "changed";
+  RightHashes.clear();
+  revng_check(LeftHashes.hash(Left) != RightHashes.hash(Right));
+  revng_check(LeftHashes.hash(Left.Functions.at(ARM1000))
+              == RightHashes.hash(Right.Functions.at(ARM1000)));
+
+  auto Diff = diff(Left, Right, LeftHashes, RightHashes);
+  revng_check(Diff.Changes.size() == 1);
+  auto *Old = static_cast<model::Identifier *>(Diff.Changes[0].Old);
+  revng_check(Old == &Left.Functions.at(ARM2000).CustomName);
+}
+
 static_assert(std::is_default_constructible_v<TupleTree<TestTupleTree::Root>>);
 static_assert(not std::is_copy_assignable_v<TupleTree<TestTupleTree::Root>>);
 static_assert(not std::is_copy_constructible_v<TupleTree<TestTupleTree::Root>>);
 static_assert(std::is_move_assignable_v<TupleTree<TestTupleTree::Root>>);
 static_assert(std::is_move_constructible_v<TupleTree<TestTupleTree::Root>>);
+
+BOOST_AUTO_TEST_CASE(TestBinarySerialization) {
+  TupleTree<model::Binary> Original;
+
+  // Types, including references among them
+  auto Int = Original->getPrimitiveType(PrimitiveTypeKind::Signed, 4);
+  auto Struct = UpcastablePointer<model::Type>::make<StructType>();
+  auto *TheStruct = llvm::cast<StructType>(Struct.get());
+  TheStruct->CustomName = "my_struct";
+  TheStruct->Size = 8;
+  StructField &Field = TheStruct->Fields[4];
+  Field.CustomName = "field";
+  Field.Type.UnqualifiedType = Int;
+  Field.Type.Qualifiers.push_back(Qualifier::createConst());
+  auto StructPath = Original->recordNewType(std::move(Struct));
+  auto StructKey = StructPath.get()->key();
+
+  // Functions and their CFG
+  Function &F = Original->Functions[ARM1000];
+  F.CustomName = "function";
+  F.Type = FunctionType::Regular;
+  BasicBlock &Block = F.CFG[ARM1000];
+  Block.End = ARM2000;
+  Block.Successors.insert(KeyedObjectTraits<UpcastableFunctionEdge>::
+                            fromKey({ ARM3000, FunctionEdgeType::FunctionCall }));
+  Original->Functions[ARM3000].Type = FunctionType::NoReturn;
+
+  std::string Buffer;
+  {
+    llvm::raw_string_ostream Stream(Buffer);
+    serializeBinary(Stream, *Original);
+  }
+  revng_check(isBinaryTupleTree(Buffer));
+
+  auto MaybeDeserialized = deserializeBinary<model::Binary>(Buffer);
+  revng_check(MaybeDeserialized);
+  TupleTree<model::Binary> &Deserialized = *MaybeDeserialized;
+  revng_check(Deserialized.verify());
+
+  // Compare the YAML of the two
+  std::string OriginalYAML;
+  Original.serialize(OriginalYAML);
+  std::string DeserializedYAML;
+  Deserialized.serialize(DeserializedYAML);
+  revng_check(OriginalYAML == DeserializedYAML);
+
+  // References point into the new tree
+  auto *NewType = Deserialized->Types.at(StructKey).get();
+  auto &NewStruct = *llvm::cast<StructType>(NewType);
+  const TypePath &NewFieldType = NewStruct.Fields.at(4).Type.UnqualifiedType;
+  revng_check(NewFieldType.Root == Deserialized.get());
+  revng_check(llvm::isa<PrimitiveType>(NewFieldType.get()));
+
+  const Function &NewF = Deserialized->Functions.at(ARM1000);
+  revng_check(NewF.CFG.at(ARM1000).Successors.size() == 1);
+
+  // Truncated inputs are rejected
+  llvm::StringRef Truncated(Buffer.data(), Buffer.size() - 1);
+  revng_check(not deserializeBinary<model::Binary>(Truncated));
+}
+
+BOOST_AUTO_TEST_CASE(TestLazyBinaryDeserialization) {
+  TupleTree<model::Binary> Original;
+  Original->Functions[ARM1000].CustomName = "first";
+  Function &Second = Original->Functions[ARM2000];
+  Second.CustomName = "second";
+  Second.CFG[ARM2000].End = ARM3000;
+
+  std::string Buffer;
+  {
+    llvm::raw_string_ostream Stream(Buffer);
+    serializeBinary(Stream, *Original);
+  }
+
+  constexpr auto FunctionsIndex = static_cast<size_t>(
+    Fields<model::Binary>::Functions);
+  LazyBinaryField<model::Binary, FunctionsIndex> Functions;
+  auto MaybeDeserialized = deserializeBinary(Buffer, Functions);
+  revng_check(MaybeDeserialized);
+  TupleTree<model::Binary> &Deserialized = *MaybeDeserialized;
+
+  // Functions are indexed, but not decoded
+  revng_check(Deserialized->Functions.size() == 0);
+  revng_check(Functions.size() == 2);
+  revng_check(*Functions.keys().begin() == ARM1000);
+  revng_check(Functions.contains(ARM2000));
+  revng_check(Functions.get(ARM3000) == nullptr);
+
+  // Decode a single function
+  const Function *NewSecond = Functions.get(ARM2000);
+  revng_check(NewSecond != nullptr and NewSecond->CustomName == "second");
+  revng_check(NewSecond->CFG.at(ARM2000).End == ARM3000);
+  revng_check(Functions.get(ARM2000) == NewSecond);
+
+  // Decode everything
+  Functions.materialize(Deserialized->Functions);
+  std::string OriginalYAML;
+  Original.serialize(OriginalYAML);
+  std::string DeserializedYAML;
+  Deserialized.serialize(DeserializedYAML);
+  revng_check(OriginalYAML == DeserializedYAML);
+}
+
+BOOST_AUTO_TEST_CASE(TestBinaryDiff) {
+  TupleTree<model::Binary> Left;
+  auto Struct = UpcastablePointer<model::Type>::make<StructType>();
+  llvm::cast<StructType>(Struct.get())->Fields[0].CustomName = "field";
+  auto StructKey = Left->recordNewType(std::move(Struct)).get()->key();
+  Left->Functions[ARM1000].CustomName = "first";
+  Left->Functions[ARM2000].CFG[ARM2000].End = ARM3000;
+
+  // Change a field of a concrete type, add and remove functions and blocks
+  TupleTree<model::Binary> Right = Left.clone(Left);
+  auto *RightStruct = llvm::cast<StructType>(Right->Types.at(StructKey).get());
+  RightStruct->Fields.at(0).CustomName = "renamed";
+  Right->Functions.erase(ARM1000);
+  Right->Functions[ARM3000].CustomName = "third";
+  Right->Functions.at(ARM2000).CFG[ARM3000].End = ARM3000;
+
+  auto Diff = diff(*Left, *Right);
+  revng_check(Diff.Changes.size() == 4);
+
+  std::string Buffer;
+  {
+    llvm::raw_string_ostream Stream(Buffer);
+    serializeBinary(Stream, Diff, *Left);
+  }
+  revng_check(isBinaryTupleTreeDiff(Buffer));
+
+  auto MaybeDeserialized = deserializeBinaryDiff<model::Binary>(Buffer);
+  revng_check(MaybeDeserialized);
+  revng_check(MaybeDeserialized->Changes.size() == 4);
+
+  // Applying the deserialized diff to Left gives Right
+  MaybeDeserialized->apply(*Left);
+  Left.initializeReferences();
+  revng_check(diff(*Left, *Right).Changes.size() == 0);
+
+  // Truncated inputs are rejected
+  llvm::StringRef Truncated(Buffer.data(), Buffer.size() - 1);
+  revng_check(not deserializeBinaryDiff<model::Binary>(Truncated));
+}
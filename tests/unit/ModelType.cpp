@@ -41,6 +41,21 @@ static bool checkSerialization(const TupleTree<model::Binary> &T) {
   return T->Types == Deserialized->Types;
 }
 
+BOOST_AUTO_TEST_CASE(Identifiers) {
+  // Equal identifiers share their storage
+  std::string Name = "a_rather_long_identifier_name";
+  Identifier First(Name);
+  Identifier Second(Twine("a_rather_long_") + "identifier_name");
+  revng_check(First == Second);
+  revng_check(First.c_str() == Second.c_str());
+  revng_check(First == Name and Name == First.str());
+
+  revng_check(Identifier().empty());
+  revng_check(Identifier("") == Identifier::Empty);
+  revng_check(Identifier("a") < Identifier("b"));
+  revng_check(Identifier::fromString("0x1000") == "prefix_0x1000");
+}
+
 BOOST_AUTO_TEST_CASE(PrimitiveTypes) {
   revng_check(PrimitiveType(PrimitiveTypeKind::Void, 0).verify(true));
   revng_check(PrimitiveType(PrimitiveTypeKind::Unsigned, 1).verify(true));
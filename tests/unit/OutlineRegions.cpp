@@ -0,0 +1,127 @@
+/// \file OutlineRegions.cpp
+/// \brief Tests for OutlineRegionsPass
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <memory>
+
+#define BOOST_TEST_MODULE OutlineRegions
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/SourceMgr.h"
+
+#include "revng/FunctionIsolation/OutlineRegions.h"
+#include "revng/Support/Assert.h"
+
+using namespace llvm;
+
+// a and b form a loop, c jumps back to the dispatcher. a also contains the
+// call to function_call of a call from c.
+static const char *RootModule = R"LLVM(
+@pc = internal global i64 0
+@counter = internal global i64 0
+
+define internal void @function_call(i8*, i8*) {
+  ret void
+}
+
+define void @root() {
+entry:
+  br label %dispatcher
+
+dispatcher:
+  %pc = load i64, i64* @pc
+  switch i64 %pc, label %fail [ i64 4096, label %a
+                                i64 4100, label %b
+                                i64 4200, label %c ], !revng.block.type !0
+
+fail:
+  ret void, !revng.block.type !1
+
+a:
+  store i64 1, i64* @counter
+  call void @function_call(i8* blockaddress(@root, %c),
+                           i8* blockaddress(@root, %dispatcher))
+  br label %b
+
+b:
+  %value = load i64, i64* @counter
+  %condition = icmp eq i64 %value, 0
+  br i1 %condition, label %a, label %c
+
+c:
+  store i64 4096, i64* @pc
+  br label %dispatcher
+}
+
+!0 = !{!"RootDispatcherBlock"}
+!1 = !{!"DispatcherFailureBlock"}
+)LLVM";
+
+static std::unique_ptr<Module> run(LLVMContext &Context, unsigned RegionSize) {
+  StringMap<cl::Option *> &Options = cl::getRegisteredOptions();
+  auto *SizeOption = Options["outline-region-size"];
+  static_cast<cl::opt<unsigned> *>(SizeOption)->setValue(RegionSize);
+
+  SMDiagnostic Diagnostic;
+  auto Buffer = MemoryBuffer::getMemBuffer(RootModule);
+  std::unique_ptr<Module> M = parseIR(Buffer->getMemBufferRef(),
+                                      Diagnostic,
+                                      Context);
+  revng_check(M.get() != nullptr);
+
+  legacy::PassManager PM;
+  PM.add(new OutlineRegionsPass());
+  PM.run(*M);
+
+  revng_check(not verifyModule(*M, &dbgs()));
+  return M;
+}
+
+static unsigned countRegions(Module &M) {
+  unsigned Result = 0;
+  for (Function &F : M)
+    if (F.getName().startswith("root.region"))
+      ++Result;
+  return Result;
+}
+
+static bool containsStores(Function &F) {
+  for (BasicBlock &BB : F)
+    for (Instruction &I : BB)
+      if (isa<StoreInst>(&I))
+        return true;
+  return false;
+}
+
+BOOST_AUTO_TEST_CASE(SingleRegion) {
+  LLVMContext Context;
+  auto M = run(Context, 1000);
+
+  revng_check(countRegions(*M) == 1);
+  revng_check(not containsStores(*M->getFunction("root")));
+  revng_check(M->getFunction("function_call")->use_empty());
+
+  for (Function &F : *M)
+    if (F.getName().startswith("root.region"))
+      revng_check(F.hasFnAttribute(Attribute::NoInline));
+}
+
+BOOST_AUTO_TEST_CASE(LoopsAreNotSplit) {
+  LLVMContext Context;
+  auto M = run(Context, 1);
+
+  // One region for the a-b loop, one for c
+  revng_check(countRegions(*M) == 2);
+  revng_check(not containsStores(*M->getFunction("root")));
+}
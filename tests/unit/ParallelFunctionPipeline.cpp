@@ -0,0 +1,106 @@
+/// \file ParallelFunctionPipeline.cpp
+/// \brief Tests for runFunctionPipeline
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#define BOOST_TEST_MODULE ParallelFunctionPipeline
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+
+#include "revng/Support/ParallelFunctionPipeline.h"
+#include "revng/UnitTestHelpers/UnitTestHelpers.h"
+
+using namespace llvm;
+
+/// Count the instructions of a function
+class InstructionCountAnalysis
+  : public AnalysisInfoMixin<InstructionCountAnalysis> {
+  friend AnalysisInfoMixin<InstructionCountAnalysis>;
+
+private:
+  static AnalysisKey Key;
+
+public:
+  struct Result {
+    size_t Instructions;
+  };
+
+public:
+  Result run(Function &F, FunctionAnalysisManager &) {
+    return { F.getInstructionCount() };
+  }
+};
+
+AnalysisKey InstructionCountAnalysis::Key;
+
+/// Create \p Count functions, the i-th of which has i + 1 instructions
+static std::vector<Function *> createFunctions(Module &M, unsigned Count) {
+  LLVMContext &Context = M.getContext();
+  IntegerType *Int32 = Type::getInt32Ty(Context);
+  auto *FT = FunctionType::get(Int32, { Int32 }, false);
+
+  std::vector<Function *> Result;
+  for (unsigned I = 0; I < Count; I++) {
+    auto *F = Function::Create(FT,
+                               GlobalValue::ExternalLinkage,
+                               "f" + Twine(I),
+                               &M);
+    IRBuilder<> Builder(BasicBlock::Create(Context, "", F));
+    Value *Sum = F->getArg(0);
+    for (unsigned J = 0; J < I; J++)
+      Sum = Builder.CreateAdd(Sum, Builder.getInt32(J + 1));
+    Builder.CreateRet(Sum);
+    Result.push_back(F);
+  }
+
+  return Result;
+}
+
+static void checkPipeline(unsigned ThreadsCount) {
+  LLVMContext Context;
+  Module M("test", Context);
+  std::vector<Function *> Functions = createFunctions(M, 64);
+
+  auto Register = [](FunctionAnalysisManager &FAM) {
+    FAM.registerPass([] { return InstructionCountAnalysis(); });
+  };
+  auto Analyze = [](Function &F, FunctionAnalysisManager &FAM) {
+    return FAM.getResult<InstructionCountAnalysis>(F).Instructions;
+  };
+
+  // Commits must happen in order and see the result of the analysis
+  std::vector<Function *> Committed;
+  auto Commit = [&Committed](Function &F, size_t &Count) {
+    revng_check(Count == Committed.size() + 1);
+    Committed.push_back(&F);
+    return Count == 10;
+  };
+
+  bool Changed = runFunctionPipeline(Functions,
+                                     ThreadsCount,
+                                     Register,
+                                     Analyze,
+                                     Commit);
+  revng_check(Changed);
+  revng_check(Committed == Functions);
+}
+
+BOOST_AUTO_TEST_CASE(SingleThread) {
+  checkPipeline(1);
+}
+
+BOOST_AUTO_TEST_CASE(MultipleThreads) {
+  checkPipeline(4);
+}
+
+BOOST_AUTO_TEST_CASE(NoFunctions) {
+  auto Register = [](FunctionAnalysisManager &) {};
+  auto Analyze = [](Function &, FunctionAnalysisManager &) { return 0; };
+  auto Commit = [](Function &, int &) { return true; };
+  revng_check(not runFunctionPipeline({}, 4, Register, Analyze, Commit));
+}
@@ -0,0 +1,155 @@
+/// \file PromoteRootCSVs.cpp
+/// \brief Tests for PromoteRootCSVsPass
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <memory>
+
+#define BOOST_TEST_MODULE PromoteRootCSVs
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/SourceMgr.h"
+
+#include "revng/FunctionIsolation/PromoteRootCSVs.h"
+#include "revng/Support/Assert.h"
+#include "revng/Support/FunctionTags.h"
+#include "revng/Support/IRHelpers.h"
+
+using namespace llvm;
+
+// A jump target incrementing rax, then conditionally copying it in rbx and
+// calling a helper, before going back to the dispatcher
+static const char *RootModule = R"LLVM(
+@pc = internal global i64 0
+@rax = internal global i64 0
+@rbx = internal global i64 0
+
+declare void @helper_foo()
+declare void @use(i64*)
+
+define void @root() {
+entry:
+  br label %dispatcher
+
+dispatcher:
+  %pc = load i64, i64* @pc
+  switch i64 %pc, label %exit [ i64 0, label %jt ], !revng.block.type !1
+
+jt:
+  %rax = load i64, i64* @rax
+  %sum = add i64 %rax, 1
+  store i64 %sum, i64* @rax
+  %condition = icmp eq i64 %sum, 10
+  br i1 %condition, label %copy, label %join
+
+copy:
+  %rax.copy = load i64, i64* @rax
+  store i64 %rax.copy, i64* @rbx
+  call void @helper_foo()
+  %rbx.after = load i64, i64* @rbx
+  store i64 %rbx.after, i64* @rax
+  {{ESCAPE}}
+  br label %join
+
+join:
+  store i64 8, i64* @pc
+  br label %dispatcher
+
+exit:
+  ret void, !revng.block.type !2
+}
+
+!revng.csv = !{!0}
+!0 = !{i64* @pc, i64* @rax, i64* @rbx}
+!1 = !{!"RootDispatcherBlock"}
+!2 = !{!"DispatcherFailureBlock"}
+)LLVM";
+
+static std::unique_ptr<Module> run(LLVMContext &Context, bool Escape) {
+  std::string Source = RootModule;
+  std::string Placeholder = "{{ESCAPE}}";
+  Source.replace(Source.find(Placeholder),
+                 Placeholder.size(),
+                 Escape ? "call void @use(i64* @rbx)" : "");
+
+  SMDiagnostic Diagnostic;
+  auto Buffer = MemoryBuffer::getMemBuffer(Source);
+  std::unique_ptr<Module> M = parseIR(Buffer->getMemBufferRef(),
+                                      Diagnostic,
+                                      Context);
+  revng_check(M.get() != nullptr);
+  FunctionTags::Root.addTo(M->getFunction("root"));
+
+  legacy::PassManager PM;
+  PM.add(new PromoteRootCSVsPass());
+  PM.run(*M);
+
+  revng_check(not verifyModule(*M, &dbgs()));
+  return M;
+}
+
+static BasicBlock *getBlock(Function &F, StringRef Name) {
+  for (BasicBlock &BB : F)
+    if (BB.getName() == Name)
+      return &BB;
+  revng_abort();
+}
+
+static unsigned countAccesses(BasicBlock *BB, StringRef CSVName) {
+  GlobalVariable *CSV = BB->getModule()->getGlobalVariable(CSVName, true);
+  unsigned Result = 0;
+  for (Instruction &I : *BB) {
+    if (auto *Load = dyn_cast<LoadInst>(&I))
+      Result += Load->getPointerOperand() == CSV ? 1 : 0;
+    else if (auto *Store = dyn_cast<StoreInst>(&I))
+      Result += Store->getPointerOperand() == CSV ? 1 : 0;
+  }
+  return Result;
+}
+
+BOOST_AUTO_TEST_CASE(CSVsStayInRegisters) {
+  LLVMContext Context;
+  auto M = run(Context, false);
+  Function &F = *M->getFunction("root");
+
+  // rax is loaded once at the head, and never stored in it
+  revng_check(countAccesses(getBlock(F, "jt"), "rax") == 1);
+
+  // Before the call, the written CSVs are stored back, after the call they're
+  // loaded again
+  BasicBlock *Copy = getBlock(F, "copy");
+  revng_check(countAccesses(Copy, "rax") == 2);
+  revng_check(countAccesses(Copy, "rbx") == 2);
+  revng_check(countAccesses(Copy, "pc") == 2);
+  revng_check(isa<StoreInst>(Copy->front()));
+
+  // The edge to the dispatcher stores back all the written CSVs
+  BasicBlock *Join = getBlock(F, "join");
+  revng_check(countAccesses(Join, "rax") == 1);
+  revng_check(countAccesses(Join, "rbx") == 1);
+  revng_check(countAccesses(Join, "pc") == 1);
+
+  // The dispatcher is left alone
+  revng_check(countAccesses(getBlock(F, "dispatcher"), "pc") == 1);
+}
+
+BOOST_AUTO_TEST_CASE(EscapingCSVsAreLeftAlone) {
+  LLVMContext Context;
+  auto M = run(Context, true);
+  Function &F = *M->getFunction("root");
+
+  // rbx is passed by address, its accesses are untouched
+  revng_check(countAccesses(getBlock(F, "copy"), "rbx") == 2);
+  revng_check(countAccesses(getBlock(F, "join"), "rbx") == 0);
+
+  // rax is still promoted
+  revng_check(countAccesses(getBlock(F, "jt"), "rax") == 1);
+}
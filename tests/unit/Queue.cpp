@@ -0,0 +1,79 @@
+/// \file Queue.cpp
+/// \brief Tests for the uniqued queues and stacks
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <vector>
+
+#define BOOST_TEST_MODULE Queue
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "revng/ADT/Queue.h"
+#include "revng/ADT/UniquedStack.h"
+#include "revng/UnitTestHelpers/UnitTestHelpers.h"
+
+struct Identity {
+  size_t operator()(unsigned Value) const { return Value; }
+};
+
+template<typename QueueT>
+static std::vector<unsigned> drain(QueueT &Queue) {
+  std::vector<unsigned> Result;
+  while (not Queue.empty())
+    Result.push_back(Queue.pop());
+  return Result;
+}
+
+BOOST_AUTO_TEST_CASE(TestDenseUniquedQueue) {
+  DenseUniquedQueue<unsigned, Identity> Queue;
+  UniquedQueue<unsigned> Reference;
+  for (unsigned I : { 3, 1, 3, 100, 1, 0 }) {
+    Queue.insert(I);
+    Reference.insert(I);
+  }
+
+  revng_check(Queue.size() == Reference.size());
+  revng_check(Queue.contains(100));
+  revng_check(not Queue.contains(2));
+  revng_check(not Queue.contains(1000));
+
+  revng_check(Queue.pop() == Reference.pop());
+  revng_check(not Queue.contains(3));
+
+  // Popped elements can be inserted again
+  Queue.insert(3);
+  Reference.insert(3);
+  revng_check(drain(Queue) == drain(Reference));
+}
+
+BOOST_AUTO_TEST_CASE(TestDenseOnceQueue) {
+  DenseOnceQueue<unsigned, Identity> Queue(Identity(), 4);
+  Queue.insert(2);
+  Queue.insert(7);
+  revng_check(Queue.pop() == 2);
+
+  // Popped elements cannot be inserted again
+  Queue.insert(2);
+  revng_check(drain(Queue) == std::vector<unsigned>{ 7 });
+  revng_check(Queue.contains(2));
+  revng_check(Queue.contains(7));
+
+  Queue.clear();
+  revng_check(not Queue.contains(2));
+}
+
+BOOST_AUTO_TEST_CASE(TestDenseUniquedStack) {
+  DenseUniquedStack<unsigned, Identity> Stack;
+  for (unsigned I : { 1, 2, 1, 3, 2 })
+    Stack.insert(I);
+
+  revng_check(Stack.size() == 3);
+  revng_check(Stack.pop() == 3);
+  Stack.insert(3);
+  Stack.reverse();
+  revng_check(drain(Stack) == (std::vector<unsigned>{ 1, 2, 3 }));
+  revng_check(not Stack.contains(1));
+}
@@ -142,5 +142,11 @@ int main(int, char *[]) {
   std::cout << "Result: " << Result << std::endl;
   revng_check(Result == 28);
 
+  // Recurse deep enough to span several slabs of the coroutine frame pool
+  size_t Depth = countDown(20000);
+  revng_check(Depth == 20000);
+  Depth = countDown(20000);
+  revng_check(Depth == 20000);
+
   return 0;
 }
@@ -0,0 +1,140 @@
+/// \file RemoveDeadFlags.cpp
+/// \brief Tests for RemoveDeadFlagsPass
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <memory>
+#include <string>
+
+#define BOOST_TEST_MODULE RemoveDeadFlags
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/SourceMgr.h"
+
+#include "revng/FunctionIsolation/RemoveDeadFlags.h"
+#include "revng/Support/FunctionTags.h"
+#include "revng/UnitTestHelpers/LLVMTestHelpers.h"
+
+using namespace llvm;
+
+static const char *FlagsModuleBegin = R"LLVM(
+@cc_op = internal global i32 0
+@cc_dst = internal global i64 0
+@cc_src = internal global i64 0
+
+declare void @unknown()
+declare void @lifted()
+
+define void @main() {
+initial_block:
+)LLVM";
+
+static std::unique_ptr<Module>
+run(LLVMContext &Context, const char *Body) {
+  std::string ModuleText = FlagsModuleBegin;
+  ModuleText += Body;
+  ModuleText += "\n}\n";
+
+  SMDiagnostic Diagnostic;
+  auto Buffer = MemoryBuffer::getMemBuffer(ModuleText);
+  std::unique_ptr<Module> M = parseIR(Buffer->getMemBufferRef(),
+                                      Diagnostic,
+                                      Context);
+  revng_check(M.get() != nullptr);
+
+  FunctionTags::Lifted.addTo(M->getFunction("main"));
+  FunctionTags::Lifted.addTo(M->getFunction("lifted"));
+
+  legacy::PassManager PM;
+  PM.add(new RemoveDeadFlagsPass());
+  PM.run(*M);
+
+  return M;
+}
+
+static unsigned countStores(Module &M) {
+  unsigned Result = 0;
+  for (BasicBlock &BB : *M.getFunction("main"))
+    for (Instruction &I : BB)
+      if (isa<StoreInst>(&I))
+        ++Result;
+  return Result;
+}
+
+BOOST_AUTO_TEST_CASE(Overwritten) {
+  const char *Body = R"LLVM(
+  %first = add i64 1, 0
+  store i64 %first, i64* @cc_dst
+  %second = add i64 2, 0
+  store i64 %second, i64* @cc_dst
+  %value = load i64, i64* @cc_dst
+  store i64 %value, i64* @cc_src
+  call void @unknown()
+  ret void
+)LLVM";
+
+  LLVMContext Context;
+  auto M = run(Context, Body);
+  Function *F = M->getFunction("main");
+
+  revng_check(countStores(*M) == 2);
+  auto *Store = cast<StoreInst>(instructionByName(F, "s:second"));
+  revng_check(Store->getPointerOperand() == M->getGlobalVariable("cc_dst"));
+}
+
+BOOST_AUTO_TEST_CASE(DeadAtReturnAndCalls) {
+  const char *Body = R"LLVM(
+  store i32 1, i32* @cc_op
+  call void @lifted()
+  store i32 2, i32* @cc_op
+  ret void
+)LLVM";
+
+  LLVMContext Context;
+  auto M = run(Context, Body);
+
+  revng_check(countStores(*M) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(LiveOnSomePath) {
+  const char *Body = R"LLVM(
+  store i32 1, i32* @cc_op
+  br i1 undef, label %reads, label %writes
+
+reads:
+  %value = load i32, i32* @cc_op
+  call void @unknown()
+  ret void
+
+writes:
+  store i32 2, i32* @cc_op
+  ret void
+)LLVM";
+
+  LLVMContext Context;
+  auto M = run(Context, Body);
+
+  // The first store is kept, the one before returning is not
+  revng_check(countStores(*M) == 1);
+  BasicBlock &Entry = M->getFunction("main")->getEntryBlock();
+  revng_check(isa<StoreInst>(&*Entry.begin()));
+}
+
+BOOST_AUTO_TEST_CASE(UnknownCall) {
+  const char *Body = R"LLVM(
+  store i32 1, i32* @cc_op
+  call void @unknown()
+  ret void
+)LLVM";
+
+  LLVMContext Context;
+  auto M = run(Context, Body);
+
+  revng_check(countStores(*M) == 1);
+}
@@ -42,3 +42,14 @@ inline RecursiveCoroutine<void> accumulateSums(int I, int &Result) {
   if (I)
     rc_recur accumulateSums(I - 1, Result);
 }
+
+inline RecursiveCoroutine<size_t> countDown(size_t I) {
+  if (I == 0)
+    rc_return 0;
+
+  // At each level, get10 allocates and releases a frame on top of the frames
+  // of all the pending calls
+  size_t Ten = rc_recur get10();
+  size_t Rest = rc_recur countDown(I - 1);
+  rc_return Rest + Ten / 10;
+}
@@ -11,6 +11,8 @@
 bool init_unit_test();
 #include "boost/test/unit_test.hpp"
 
+#include "llvm/ADT/DenseMap.h"
+
 #include "revng/ADT/SmallMap.h"
 
 using namespace llvm;
@@ -113,3 +115,72 @@ BOOST_AUTO_TEST_CASE(Contains) {
   revng_check(Map.contains(Value));
   revng_check(!Map.contains(Value + 1));
 }
+
+BOOST_AUTO_TEST_CASE(KeyArray) {
+  // Integer keys are looked up through the separate inline key array
+  SmallMap<int, int, 8> Map;
+
+  for (int I = 7; I >= 0; I--)
+    Map[I] = I * 10;
+
+  for (int I = 0; I < 8; I++)
+    revng_check(Map.at(I) == I * 10);
+  revng_check(!Map.contains(8));
+
+  // Erasing must keep the key array in sync with the pairs
+  Map.erase(3);
+  revng_check(!Map.contains(3));
+  revng_check(Map.size() == 7);
+  revng_check(Map.at(7) == 70);
+
+  // Sorting must keep the key array in sync with the pairs
+  auto It = Map.lower_bound(3);
+  revng_check(It != Map.end() && It->first == 4);
+  for (int I = 0; I < 8; I++)
+    if (I != 3)
+      revng_check(Map.at(I) == I * 10);
+}
+
+BOOST_AUTO_TEST_CASE(PointerKeys) {
+  int Values[3];
+  SmallMap<int *, int, 4> Map;
+
+  Map[&Values[2]] = 2;
+  Map[&Values[0]] = 0;
+
+  revng_check(Map.at(&Values[0]) == 0);
+  revng_check(Map.at(&Values[2]) == 2);
+  revng_check(!Map.contains(&Values[1]));
+}
+
+BOOST_AUTO_TEST_CASE(DenseMapSpill) {
+  using Map = SmallMap<int, int, 2, std::less<int>, DenseMap<int, int>>;
+  Map M;
+
+  for (int I = 0; I < 10; I++)
+    M[I] = I + 1;
+
+  revng_check(M.size() == 10);
+  for (int I = 0; I < 10; I++)
+    revng_check(M.at(I) == I + 1);
+
+  unsigned Count = 0;
+  for (auto &[Key, Value] : M) {
+    revng_check(Value == Key + 1);
+    Count++;
+  }
+  revng_check(Count == 10);
+
+  M.erase(5);
+  revng_check(!M.contains(5));
+  revng_check(M.size() == 9);
+}
+
+BOOST_AUTO_TEST_CASE(InlineSize) {
+  static_assert(smallMapInlineSize<int, int>() == 8);
+  static_assert(smallMapInlineSize<int, int>(2) == 16);
+  static_assert(smallMapInlineSize<int, std::array<char, 100>>() == 1);
+  SmallMap<int, int, smallMapInlineSize<int, int>()> Map;
+  Map[1] = 1;
+  revng_check(Map.at(1) == 1);
+}
@@ -113,6 +113,22 @@ target_link_libraries(test_zipmapiterator
 add_test(NAME test_zipmapiterator COMMAND ./bin/test_zipmapiterator)
 set_tests_properties(test_zipmapiterator PROPERTIES LABELS "unit")
 
+#
+# test_copyonwrite
+#
+
+revng_add_private_executable(test_copyonwrite "${SRC}/CopyOnWrite.cpp")
+target_compile_definitions(test_copyonwrite
+  PRIVATE "BOOST_TEST_DYN_LINK=1")
+target_include_directories(test_copyonwrite
+  PRIVATE "${CMAKE_SOURCE_DIR}")
+target_link_libraries(test_copyonwrite
+  revngSupport
+  Boost::unit_test_framework
+  ${LLVM_LIBRARIES})
+add_test(NAME test_copyonwrite COMMAND ./bin/test_copyonwrite)
+set_tests_properties(test_copyonwrite PROPERTIES LABELS "unit")
+
 #
 # test_constantrangeset
 #
@@ -130,6 +146,74 @@ target_link_libraries(test_constantrangeset
 add_test(NAME test_constantrangeset COMMAND ./bin/test_constantrangeset)
 set_tests_properties(test_constantrangeset PROPERTIES LABELS "unit")
 
+#
+# test_intervalindex
+#
+
+revng_add_private_executable(test_intervalindex "${SRC}/IntervalIndex.cpp")
+target_compile_definitions(test_intervalindex
+  PRIVATE "BOOST_TEST_DYN_LINK=1")
+target_include_directories(test_intervalindex
+  PRIVATE "${CMAKE_SOURCE_DIR}")
+target_link_libraries(test_intervalindex
+  revngSupport
+  revngUnitTestHelpers
+  Boost::unit_test_framework
+  ${LLVM_LIBRARIES})
+add_test(NAME test_intervalindex COMMAND ./bin/test_intervalindex)
+set_tests_properties(test_intervalindex PROPERTIES LABELS "unit")
+
+#
+# test_intervalset
+#
+
+revng_add_private_executable(test_intervalset "${SRC}/IntervalSet.cpp")
+target_compile_definitions(test_intervalset
+  PRIVATE "BOOST_TEST_DYN_LINK=1")
+target_include_directories(test_intervalset
+  PRIVATE "${CMAKE_SOURCE_DIR}")
+target_link_libraries(test_intervalset
+  revngSupport
+  revngUnitTestHelpers
+  Boost::unit_test_framework
+  ${LLVM_LIBRARIES})
+add_test(NAME test_intervalset COMMAND ./bin/test_intervalset)
+set_tests_properties(test_intervalset PROPERTIES LABELS "unit")
+
+#
+# test_binarycoverage
+#
+
+revng_add_private_executable(test_binarycoverage "${SRC}/BinaryCoverage.cpp")
+target_compile_definitions(test_binarycoverage
+  PRIVATE "BOOST_TEST_DYN_LINK=1")
+target_include_directories(test_binarycoverage
+  PRIVATE "${CMAKE_SOURCE_DIR}")
+target_link_libraries(test_binarycoverage
+  revngSupport
+  revngUnitTestHelpers
+  Boost::unit_test_framework
+  ${LLVM_LIBRARIES})
+add_test(NAME test_binarycoverage COMMAND ./bin/test_binarycoverage)
+set_tests_properties(test_binarycoverage PROPERTIES LABELS "unit")
+
+#
+# test_debugstrings
+#
+
+revng_add_private_executable(test_debugstrings "${SRC}/DebugStrings.cpp")
+target_compile_definitions(test_debugstrings
+  PRIVATE "BOOST_TEST_DYN_LINK=1")
+target_include_directories(test_debugstrings
+  PRIVATE "${CMAKE_SOURCE_DIR}")
+target_link_libraries(test_debugstrings
+  revngSupport
+  revngUnitTestHelpers
+  Boost::unit_test_framework
+  ${LLVM_LIBRARIES})
+add_test(NAME test_debugstrings COMMAND ./bin/test_debugstrings)
+set_tests_properties(test_debugstrings PROPERTIES LABELS "unit")
+
 #
 # test_shrinkinstructionoperands
 #
@@ -328,3 +412,124 @@ target_link_libraries(test_model_type
   ${LLVM_LIBRARIES})
 add_test(NAME test_model_type COMMAND ./bin/test_model_type)
 set_tests_properties(test_model_type PROPERTIES LABELS "unit")
+
+#
+# test_removedeadflags
+#
+
+revng_add_private_executable(test_removedeadflags "${SRC}/RemoveDeadFlags.cpp")
+target_compile_definitions(test_removedeadflags
+  PRIVATE "BOOST_TEST_DYN_LINK=1")
+target_include_directories(test_removedeadflags
+  PRIVATE "${CMAKE_SOURCE_DIR}")
+target_link_libraries(test_removedeadflags
+  revngFunctionIsolation
+  revngSupport
+  revngUnitTestHelpers
+  Boost::unit_test_framework
+  ${LLVM_LIBRARIES})
+add_test(NAME test_removedeadflags COMMAND ./bin/test_removedeadflags)
+set_tests_properties(test_removedeadflags PROPERTIES LABELS "unit")
+
+#
+# test_outlineregions
+#
+
+revng_add_private_executable(test_outlineregions "${SRC}/OutlineRegions.cpp")
+target_compile_definitions(test_outlineregions
+  PRIVATE "BOOST_TEST_DYN_LINK=1")
+target_include_directories(test_outlineregions
+  PRIVATE "${CMAKE_SOURCE_DIR}")
+target_link_libraries(test_outlineregions
+  revngFunctionIsolation
+  revngSupport
+  Boost::unit_test_framework
+  ${LLVM_LIBRARIES})
+add_test(NAME test_outlineregions COMMAND ./bin/test_outlineregions)
+set_tests_properties(test_outlineregions PROPERTIES LABELS "unit")
+
+#
+# test_parallelfunctionpipeline
+#
+
+revng_add_private_executable(test_parallelfunctionpipeline "${SRC}/ParallelFunctionPipeline.cpp")
+target_compile_definitions(test_parallelfunctionpipeline
+  PRIVATE "BOOST_TEST_DYN_LINK=1")
+target_include_directories(test_parallelfunctionpipeline
+  PRIVATE "${CMAKE_SOURCE_DIR}")
+target_link_libraries(test_parallelfunctionpipeline
+  revngSupport
+  revngUnitTestHelpers
+  Boost::unit_test_framework
+  ${LLVM_LIBRARIES})
+add_test(NAME test_parallelfunctionpipeline COMMAND ./bin/test_parallelfunctionpipeline)
+set_tests_properties(test_parallelfunctionpipeline PROPERTIES LABELS "unit")
+
+#
+# test_blocknumbering
+#
+
+revng_add_private_executable(test_blocknumbering "${SRC}/BlockNumbering.cpp")
+target_compile_definitions(test_blocknumbering
+  PRIVATE "BOOST_TEST_DYN_LINK=1")
+target_include_directories(test_blocknumbering
+  PRIVATE "${CMAKE_SOURCE_DIR}")
+target_link_libraries(test_blocknumbering
+  revngSupport
+  revngBasicAnalyses
+  revngUnitTestHelpers
+  Boost::unit_test_framework
+  ${LLVM_LIBRARIES})
+add_test(NAME test_blocknumbering COMMAND ./bin/test_blocknumbering)
+set_tests_properties(test_blocknumbering PROPERTIES LABELS "unit")
+
+#
+# test_queue
+#
+
+revng_add_private_executable(test_queue "${SRC}/Queue.cpp")
+target_compile_definitions(test_queue
+  PRIVATE "BOOST_TEST_DYN_LINK=1")
+target_include_directories(test_queue
+  PRIVATE "${CMAKE_SOURCE_DIR}")
+target_link_libraries(test_queue
+  revngSupport
+  revngUnitTestHelpers
+  Boost::unit_test_framework
+  ${LLVM_LIBRARIES})
+add_test(NAME test_queue COMMAND ./bin/test_queue)
+set_tests_properties(test_queue PROPERTIES LABELS "unit")
+
+#
+# test_formsuperblocks
+#
+
+revng_add_private_executable(test_formsuperblocks "${SRC}/FormSuperblocks.cpp")
+target_compile_definitions(test_formsuperblocks
+  PRIVATE "BOOST_TEST_DYN_LINK=1")
+target_include_directories(test_formsuperblocks
+  PRIVATE "${CMAKE_SOURCE_DIR}")
+target_link_libraries(test_formsuperblocks
+  revngFunctionIsolation
+  revngSupport
+  Boost::unit_test_framework
+  ${LLVM_LIBRARIES})
+add_test(NAME test_formsuperblocks COMMAND ./bin/test_formsuperblocks)
+set_tests_properties(test_formsuperblocks PROPERTIES LABELS "unit")
+
+#
+# test_promoterootcsvs
+#
+
+revng_add_private_executable(test_promoterootcsvs "${SRC}/PromoteRootCSVs.cpp")
+target_compile_definitions(test_promoterootcsvs
+  PRIVATE "BOOST_TEST_DYN_LINK=1")
+target_include_directories(test_promoterootcsvs
+  PRIVATE "${CMAKE_SOURCE_DIR}")
+target_link_libraries(test_promoterootcsvs
+  revngFunctionIsolation
+  revngSupport
+  Boost::unit_test_framework
+  ${LLVM_LIBRARIES})
+add_test(NAME test_promoterootcsvs COMMAND ./bin/test_promoterootcsvs)
+set_tests_properties(test_promoterootcsvs PROPERTIES LABELS "unit")
@@ -47,6 +47,26 @@ static_assert(std::is_copy_constructible_v<UpcastablePointer<TestClass>>);
 static_assert(std::is_move_assignable_v<UpcastablePointer<TestClass>>);
 static_assert(std::is_move_constructible_v<UpcastablePointer<TestClass>>);
 
+// Test InlineUpcastablePointer
+using InlineTestPointer = InlineUpcastablePointer<TestClass>;
+static_assert(UniquePtrLike<InlineTestPointer>);
+static_assert(UpcastablePointerLike<InlineTestPointer>);
+static_assert(IsUpcastablePointer<InlineTestPointer>);
+static_assert(std::is_copy_constructible_v<InlineTestPointer>);
+static_assert(std::is_move_constructible_v<InlineTestPointer>);
+
 int main() {
+  auto Pointer = InlineTestPointer::make<TestClass>();
+  InlineTestPointer Copy = Pointer;
+  revng_check(Copy.get() != nullptr and Copy.get() != Pointer.get());
+
+  InlineTestPointer Moved = std::move(Pointer);
+  revng_check(Moved.get() != nullptr and Pointer.get() == nullptr);
+
+  Moved.reset(new TestClass);
+  revng_check(Moved.get() != nullptr);
+  Moved.reset();
+  revng_check(Moved.get() == nullptr);
+
   return 0;
 }
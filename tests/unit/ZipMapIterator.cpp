@@ -213,3 +213,88 @@ BOOST_AUTO_TEST_CASE(TestSmallMap) {
 BOOST_AUTO_TEST_CASE(TestSortedVectorAndMutableSet) {
   run<SortedVector<int>, MutableSet<int>>();
 }
+
+template<typename LeftMap, typename RightMap>
+static auto collect(LeftMap &Left, RightMap &Right) {
+  using Iterator = ZipMapIterator<LeftMap, RightMap>;
+  std::vector<typename Iterator::value_type> Result;
+  std::copy(zipmap_begin(Left, Right),
+            zipmap_end(Left, Right),
+            std::back_inserter(Result));
+  return Result;
+}
+
+BOOST_AUTO_TEST_CASE(TestLopsided) {
+  // Long runs on one side are skipped through galloping: make sure the result
+  // matches the one obtained walking std::sets one element at a time
+  SortedVector<int> Left;
+  SortedVector<int> Right;
+  std::set<int> LeftSet;
+  std::set<int> RightSet;
+  for (int I = 0; I < 1000; ++I) {
+    Left.insert(I);
+    LeftSet.insert(I);
+  }
+
+  for (int I : { -5, 0, 1, 2, 500, 998, 999, 1000, 2000 }) {
+    Right.insert(I);
+    RightSet.insert(I);
+  }
+
+  auto CheckSame = [](auto &Left, auto &Right, auto &LeftSet, auto &RightSet) {
+    auto Result = collect(Left, Right);
+    auto Expected = collect(LeftSet, RightSet);
+    revng_check(Result.size() == Expected.size());
+    for (unsigned I = 0; I < Result.size(); ++I) {
+      auto [LeftElement, RightElement] = Result[I];
+      auto [LeftExpected, RightExpected] = Expected[I];
+      revng_check((LeftElement == nullptr) == (LeftExpected == nullptr));
+      revng_check((RightElement == nullptr) == (RightExpected == nullptr));
+      if (LeftElement != nullptr)
+        revng_check(*LeftElement == *LeftExpected);
+      if (RightElement != nullptr)
+        revng_check(*RightElement == *RightExpected);
+    }
+  };
+
+  CheckSame(Left, Right, LeftSet, RightSet);
+  CheckSame(Right, Left, RightSet, LeftSet);
+}
+
+BOOST_AUTO_TEST_CASE(TestPartitions) {
+  SortedVector<int> Left;
+  SortedVector<int> Right;
+  for (int I = 0; I < 300; I += 2)
+    Left.insert(I);
+  for (int I = 0; I < 100; I += 3)
+    Right.insert(I);
+
+  auto Expected = collect(Left, Right);
+  for (size_t Count : { 1, 2, 3, 7, 64, 1000 }) {
+    for (bool Swap : { false, true }) {
+      auto &A = Swap ? Right : Left;
+      auto &B = Swap ? Left : Right;
+      auto Reference = collect(A, B);
+      decltype(Reference) Result;
+      auto Partitions = zipmap_partitions(A, B, Count);
+      revng_check(Partitions.size() <= Count);
+      for (auto Range : Partitions)
+        for (auto Pair : Range)
+          Result.push_back(Pair);
+      revng_check(Result == Reference);
+    }
+  }
+
+  // The results of a parallel visit come back in order
+  auto Visit = [](auto Range) {
+    std::vector<int> Keys;
+    for (auto [LeftElement, RightElement] : Range)
+      Keys.push_back(LeftElement != nullptr ? *LeftElement : *RightElement);
+    return Keys;
+  };
+  std::vector<int> Keys;
+  for (std::vector<int> &Chunk : parallel_zipmap(Left, Right, 4, Visit))
+    Keys.insert(Keys.end(), Chunk.begin(), Chunk.end());
+  revng_check(Keys.size() == Expected.size());
+  revng_check(std::is_sorted(Keys.begin(), Keys.end()));
+}
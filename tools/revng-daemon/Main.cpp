@@ -0,0 +1,416 @@
+/// \file Main.cpp
+/// \brief This file implements revng-daemon, which loads a lifted module once
+///        and serves requests on a local socket, so that passes can be run on
+///        it, and its model inspected and changed, without parsing it again
+///        each time
+///
+/// Requests and responses are line-based: each request is a single line, each
+/// response is composed by zero or more lines of output followed by a line
+/// containing either `ok` or `error: ` and a description of the problem.
+///
+/// The following requests are supported:
+///
+/// * `run <pipeline>`: run the given new pass manager pipeline, in the syntax
+///   of `opt -passes`. The analysis managers are shared across requests,
+///   therefore the results of the analyses preserved by the passes, such as
+///   the dominator trees, GCBI and the model, are not computed again.
+/// * `run-legacy <pass> [<pass>...]`: run the given legacy passes, e.g., those
+///   loaded through `-load`. Legacy analyses do not outlive the pass manager
+///   and the cached analyses are dropped afterwards.
+/// * `model`: print the model, in YAML.
+/// * `apply-model <path>`: replace the model with the one in \p path, applying
+///   the differences to the current one, and print the number of changes.
+/// * `verify`: verify the module.
+/// * `save <path>`: write the module, textual IR if the extension is .ll,
+///   bitcode otherwise.
+/// * `quit`: stop the daemon.
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+
+extern "C" {
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+}
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassInstrumentation.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Pass.h"
+#include "llvm/PassInfo.h"
+#include "llvm/PassRegistry.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/PluginLoader.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/ToolOutputFile.h"
+
+#include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
+#include "revng/Model/LoadModelPass.h"
+#include "revng/Model/SerializeModelPass.h"
+#include "revng/Model/TupleTreeDiff.h"
+#include "revng/Support/CommandLine.h"
+#include "revng/Support/Debug.h"
+#include "revng/Support/TracedPassManager.h"
+#include "revng/Support/Tracing.h"
+
+using namespace llvm::cl;
+
+using llvm::Module;
+using llvm::StringRef;
+
+namespace {
+
+#define DESCRIPTION desc("the lifted module, as produced by revng-lift")
+opt<std::string> InputPath(Positional,
+                           Required,
+                           DESCRIPTION,
+                           cat(MainCategory));
+#undef DESCRIPTION
+
+opt<std::string> SocketPath("socket",
+                            desc("path of the socket to listen on"),
+                            value_desc("path"),
+                            Required,
+                            cat(MainCategory));
+
+} // namespace
+
+static Logger<> DaemonLog("daemon");
+
+/// \brief A client connection, read line by line
+class Connection {
+private:
+  int FD;
+  std::string Pending;
+  llvm::raw_fd_ostream Output;
+
+public:
+  Connection(int FD) : FD(FD), Output(FD, true) {}
+
+public:
+  /// \return false if the client closed the connection
+  bool readLine(std::string &Line) {
+    while (true) {
+      size_t End = Pending.find('\n');
+      if (End != std::string::npos) {
+        Line = Pending.substr(0, End);
+        Pending.erase(0, End + 1);
+        return true;
+      }
+
+      char Buffer[4096];
+      ssize_t Size = read(FD, Buffer, sizeof(Buffer));
+      if (Size < 0 and errno == EINTR)
+        continue;
+      if (Size <= 0)
+        return false;
+
+      Pending.append(Buffer, Size);
+    }
+  }
+
+  llvm::raw_ostream &output() { return Output; }
+
+  void ok() { respond("ok"); }
+  void error(const llvm::Twine &Message) { respond("error: " + Message); }
+
+private:
+  void respond(const llvm::Twine &Status) {
+    Output << Status << "\n";
+    Output.flush();
+  }
+};
+
+/// \brief The resident state: the module and the analysis managers
+class Daemon {
+private:
+  std::unique_ptr<Module> M;
+  llvm::PassBuilder PB;
+  llvm::LoopAnalysisManager LAM;
+  llvm::FunctionAnalysisManager FAM;
+  llvm::CGSCCAnalysisManager CGAM;
+  llvm::ModuleAnalysisManager MAM;
+  llvm::PassInstrumentationCallbacks PIC;
+
+public:
+  Daemon(std::unique_ptr<Module> TheModule) : M(std::move(TheModule)) {
+    // Record each pass in the trace, see -trace-output. This has to be
+    // registered before PassBuilder registers the default instrumentation.
+    tracePasses(PIC);
+    auto Instrumentation = [this] {
+      return llvm::PassInstrumentationAnalysis(&PIC);
+    };
+    LAM.registerPass(Instrumentation);
+    FAM.registerPass(Instrumentation);
+    CGAM.registerPass(Instrumentation);
+    MAM.registerPass(Instrumentation);
+
+    MAM.registerPass([] { return LoadModelAnalysis(); });
+    MAM.registerPass([] { return GeneratedCodeBasicInfoAnalysis(); });
+    FAM.registerPass([] { return LoadModelAnalysis(); });
+    FAM.registerPass([] { return GeneratedCodeBasicInfoAnalysis(); });
+
+    PB.registerModuleAnalyses(MAM);
+    PB.registerCGSCCAnalyses(CGAM);
+    PB.registerFunctionAnalyses(FAM);
+    PB.registerLoopAnalyses(LAM);
+    PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+  }
+
+public:
+  /// \return false if the daemon has to stop
+  bool handle(StringRef Request, Connection &Client);
+
+private:
+  void run(StringRef Pipeline, Connection &Client);
+  void runLegacy(StringRef Passes, Connection &Client);
+  void printModel(Connection &Client);
+  void applyModel(StringRef Path, Connection &Client);
+  void verify(Connection &Client);
+  void save(StringRef Path, Connection &Client);
+
+private:
+  TupleTree<model::Binary> &model() {
+    return MAM.getResult<LoadModelAnalysis>(*M).getWriteableModel();
+  }
+
+  /// \brief Serialize the resident model in the module metadata
+  void syncModel() {
+    auto &Model = model();
+    if (auto *NamedMD = M->getNamedMetadata(ModelMetadataName))
+      NamedMD->eraseFromParent();
+    writeModel(*Model, *M);
+  }
+};
+
+bool Daemon::handle(StringRef Request, Connection &Client) {
+  auto [Command, Argument] = Request.trim().split(' ');
+  Argument = Argument.trim();
+  revng_log(DaemonLog, "Handling " << Request);
+
+  if (Command == "run")
+    run(Argument, Client);
+  else if (Command == "run-legacy")
+    runLegacy(Argument, Client);
+  else if (Command == "model")
+    printModel(Client);
+  else if (Command == "apply-model")
+    applyModel(Argument, Client);
+  else if (Command == "verify")
+    verify(Client);
+  else if (Command == "save")
+    save(Argument, Client);
+  else if (Command == "quit")
+    return false;
+  else
+    Client.error("unknown request \"" + Command + "\"");
+
+  return true;
+}
+
+void Daemon::run(StringRef Pipeline, Connection &Client) {
+  llvm::ModulePassManager MPM;
+  if (llvm::Error Error = PB.parsePassPipeline(MPM, Pipeline)) {
+    Client.error(llvm::toString(std::move(Error)));
+    return;
+  }
+
+  // Invalidation of the cached analyses is driven by what the passes preserve
+  TraceScope Scope("Pipeline", Pipeline);
+  MPM.run(*M, MAM);
+  Client.ok();
+}
+
+void Daemon::runLegacy(StringRef Passes, Connection &Client) {
+  llvm::SmallVector<StringRef, 8> Names;
+  Passes.split(Names, ' ', -1, false);
+
+  llvm::PassRegistry &Registry = *llvm::PassRegistry::getPassRegistry();
+  TracedPassManager PM;
+  for (StringRef Name : Names) {
+    const llvm::PassInfo *Info = Registry.getPassInfo(Name);
+    if (Info == nullptr or Info->getNormalCtor() == nullptr) {
+      Client.error("unknown pass \"" + Name + "\"");
+      return;
+    }
+    PM.add(Info->createPass());
+  }
+
+  // Legacy passes read the model from the module, as if run through opt
+  syncModel();
+  PM.add(new SerializeModelWrapperPass());
+  PM.run(*M);
+
+  // The legacy passes don't tell us what they preserve
+  MAM.clear();
+  Client.ok();
+}
+
+void Daemon::printModel(Connection &Client) {
+  model().serialize(Client.output());
+  Client.ok();
+}
+
+void Daemon::applyModel(StringRef Path, Connection &Client) {
+  auto MaybeBuffer = llvm::MemoryBuffer::getFile(Path);
+  if (not MaybeBuffer) {
+    Client.error("couldn't open " + Path + ": "
+                 + MaybeBuffer.getError().message());
+    return;
+  }
+
+  StringRef YAML = (*MaybeBuffer)->getBuffer();
+  auto MaybeModel = TupleTree<model::Binary>::deserialize(YAML);
+  if (not MaybeModel) {
+    Client.error("couldn't parse " + Path + ": "
+                 + MaybeModel.getError().message());
+    return;
+  }
+
+  // Apply the differences, so that the objects that did not change are not
+  // replaced
+  TupleTree<model::Binary> &Model = model();
+  auto Diff = diff(*Model, **MaybeModel);
+  Diff.apply(*Model);
+  Model.initializeReferences();
+
+  // The analyses might depend on the model, except for the model itself
+  MAM.invalidate(*M, llvm::PreservedAnalyses::none());
+
+  Client.output() << Diff.Changes.size() << " changes\n";
+  Client.ok();
+}
+
+void Daemon::verify(Connection &Client) {
+  if (llvm::verifyModule(*M, &Client.output()))
+    Client.error("the module is broken");
+  else
+    Client.ok();
+}
+
+void Daemon::save(StringRef Path, Connection &Client) {
+  if (Path.empty()) {
+    Client.error("a path is required");
+    return;
+  }
+
+  std::error_code EC;
+  llvm::ToolOutputFile Output(Path, EC, llvm::sys::fs::OF_None);
+  if (EC) {
+    Client.error("couldn't open " + Path + ": " + EC.message());
+    return;
+  }
+
+  syncModel();
+  if (llvm::sys::path::extension(Path) == ".ll")
+    M->print(Output.os(), nullptr);
+  else
+    llvm::WriteBitcodeToFile(*M, Output.os());
+  Output.keep();
+
+  Client.ok();
+}
+
+static int listenOn(StringRef Path) {
+  sockaddr_un Address;
+  std::memset(&Address, 0, sizeof(Address));
+  Address.sun_family = AF_UNIX;
+  if (Path.size() >= sizeof(Address.sun_path)) {
+    dbg << "The socket path is too long: " << Path.str() << "\n";
+    return -1;
+  }
+  std::memcpy(Address.sun_path, Path.data(), Path.size());
+
+  // Replace stale sockets, but nothing else
+  llvm::sys::fs::file_status Status;
+  if (not llvm::sys::fs::status(Path, Status)) {
+    if (Status.type() != llvm::sys::fs::file_type::socket_file) {
+      dbg << "Couldn't create the socket, " << Path.str() << " exists\n";
+      return -1;
+    }
+    llvm::sys::fs::remove(Path);
+  }
+
+  int FD = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (FD < 0) {
+    dbg << "Couldn't create the socket: " << std::strerror(errno) << "\n";
+    return -1;
+  }
+
+  auto *GenericAddress = reinterpret_cast<sockaddr *>(&Address);
+  if (bind(FD, GenericAddress, sizeof(Address)) != 0 or listen(FD, 1) != 0) {
+    dbg << "Couldn't listen on " << Path.str() << ": " << std::strerror(errno)
+        << "\n";
+    close(FD);
+    return -1;
+  }
+
+  return FD;
+}
+
+int main(int argc, const char *argv[]) {
+  // Enable LLVM stack trace
+  llvm::sys::PrintStackTraceOnErrorSignal(argv[0]);
+
+  HideUnrelatedOptions({ &MainCategory });
+  ParseCommandLineOptions(argc, argv);
+
+  llvm::LLVMContext Context;
+  llvm::SMDiagnostic Errors;
+  std::unique_ptr<Module> M = llvm::parseIRFile(InputPath, Errors, Context);
+  if (M.get() == nullptr) {
+    Errors.print("revng-daemon", llvm::dbgs());
+    return EXIT_FAILURE;
+  }
+
+  Daemon TheDaemon(std::move(M));
+
+  int ListenFD = listenOn(SocketPath);
+  if (ListenFD < 0)
+    return EXIT_FAILURE;
+
+  // Serve one client at a time: requests work on the same module
+  bool Running = true;
+  while (Running) {
+    int ClientFD = accept(ListenFD, nullptr, nullptr);
+    if (ClientFD < 0) {
+      if (errno == EINTR)
+        continue;
+      dbg << "Couldn't accept a connection: " << std::strerror(errno) << "\n";
+      break;
+    }
+
+    Connection Client(ClientFD);
+    std::string Request;
+    while (Running and Client.readLine(Request)) {
+      if (not StringRef(Request).trim().empty())
+        Running = TheDaemon.handle(Request, Client);
+    }
+
+    if (not Running)
+      Client.ok();
+  }
+
+  close(ListenFD);
+  llvm::sys::fs::remove(SocketPath.getValue());
+
+  return Running ? EXIT_FAILURE : EXIT_SUCCESS;
+}
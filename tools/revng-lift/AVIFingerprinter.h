@@ -0,0 +1,303 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <vector>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Analysis/LazyValueInfo.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Operator.h"
+
+#include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
+#include "revng/Support/IRHelpers.h"
+
+/// \brief Fingerprint of what an AdvancedValueInfo query can observe
+///
+/// AdvancedValueInfo, and the analyses it employs, explore the code backward
+/// from the query and stop at the root dispatcher. The fingerprint of a query
+/// covers the instructions of the blocks that can reach it without going
+/// through the root dispatcher (its *region*), the dispatcher edges leading
+/// into the region and the ranges LazyValueInfo computes for the values
+/// defined outside of the region.
+///
+/// Blocks and globals are identified by name, and constants by value, so that
+/// the fingerprints of different copies of the root function (i.e., of
+/// different harvesting rounds) can be compared.
+class AVIFingerprinter {
+private:
+  using Hash = llvm::Optional<llvm::hash_code>;
+  using BlockSet = llvm::SmallPtrSet<const llvm::BasicBlock *, 16>;
+
+private:
+  /// Regions with more instructions than this have no fingerprint
+  static constexpr size_t MaxRegionSize = 4096;
+
+private:
+  llvm::LazyValueInfo &LVI;
+  llvm::BasicBlock *StopAt;
+  /// Calls to this function are identified by their first argument only
+  const llvm::Function *Marker;
+  llvm::DenseMap<const llvm::Instruction *, unsigned> Positions;
+  llvm::DenseMap<const llvm::BasicBlock *, Hash> Regions;
+
+public:
+  AVIFingerprinter(llvm::Function &F,
+                   llvm::LazyValueInfo &LVI,
+                   llvm::BasicBlock *StopAt,
+                   const llvm::Function *Marker) :
+    LVI(LVI), StopAt(StopAt), Marker(Marker) {
+    for (llvm::BasicBlock &BB : F) {
+      unsigned Position = 0;
+      for (llvm::Instruction &I : BB)
+        Positions[&I] = Position++;
+    }
+  }
+
+public:
+  /// \return the fingerprint of a query on \p I, or None if its region is too
+  ///         large or contains something that cannot be identified
+  llvm::Optional<uint64_t> get(const llvm::Instruction *I) {
+    const llvm::BasicBlock *BB = I->getParent();
+
+    auto It = Regions.find(BB);
+    if (It == Regions.end())
+      It = Regions.insert({ BB, region(BB) }).first;
+
+    if (not It->second)
+      return llvm::None;
+
+    llvm::hash_code Result = llvm::hash_combine(*It->second,
+                                                Positions.lookup(I));
+    return static_cast<size_t>(Result);
+  }
+
+private:
+  bool isStop(const llvm::BasicBlock *BB) const {
+    auto *NonConst = const_cast<llvm::BasicBlock *>(BB);
+    return BB == StopAt
+           or GeneratedCodeBasicInfo::isPartOfRootDispatcher(NonConst);
+  }
+
+  Hash region(const llvm::BasicBlock *BB) {
+    using namespace llvm;
+
+    BlockSet Region;
+    std::vector<const BasicBlock *> WorkList{ BB };
+    Region.insert(BB);
+    size_t Size = 0;
+    while (not WorkList.empty()) {
+      const BasicBlock *Current = WorkList.back();
+      WorkList.pop_back();
+
+      Size += Current->size();
+      if (Size > MaxRegionSize)
+        return None;
+
+      for (const BasicBlock *Predecessor : predecessors(Current))
+        if (not isStop(Predecessor) and Region.insert(Predecessor).second)
+          WorkList.push_back(Predecessor);
+    }
+
+    // Combine the blocks in a way that does not depend on the visit order
+    uint64_t Sum = 0;
+    for (const BasicBlock *Member : Region) {
+      Hash BlockHash = block(Member, Region);
+      if (not BlockHash)
+        return None;
+      Sum += static_cast<size_t>(*BlockHash);
+    }
+
+    return hash_combine(Region.size(), Sum);
+  }
+
+  Hash block(const llvm::BasicBlock *BB, const BlockSet &Region) {
+    using namespace llvm;
+
+    if (not BB->hasName())
+      return None;
+
+    hash_code Result = hash_value(BB->getName());
+
+    for (const Instruction &I : *BB) {
+      Hash InstructionHash = instruction(&I, Region);
+      if (not InstructionHash)
+        return None;
+      Result = hash_combine(Result, *InstructionHash);
+    }
+
+    // Edges entering the region from the dispatcher
+    for (const BasicBlock *Predecessor : predecessors(BB)) {
+      if (Region.count(Predecessor) != 0)
+        continue;
+
+      if (not Predecessor->hasName())
+        return None;
+
+      Result = hash_combine(Result, Predecessor->getName());
+      const Instruction *T = Predecessor->getTerminator();
+      if (auto *Switch = dyn_cast<SwitchInst>(T)) {
+        Hash Condition = value(Switch->getCondition(), Region);
+        if (not Condition)
+          return None;
+        Result = hash_combine(Result, *Condition);
+
+        Result = hash_combine(Result, Switch->getDefaultDest() == BB);
+        for (const auto &Case : Switch->cases())
+          if (Case.getCaseSuccessor() == BB)
+            Result = hash_combine(Result, Case.getCaseValue()->getValue());
+      } else {
+        Hash TerminatorHash = instruction(T, Region);
+        if (not TerminatorHash)
+          return None;
+        Result = hash_combine(Result, *TerminatorHash);
+      }
+    }
+
+    return Result;
+  }
+
+  Hash instruction(const llvm::Instruction *I, const BlockSet &Region) {
+    using namespace llvm;
+
+    hash_code Result = hash_combine(I->getOpcode(),
+                                    I->getType(),
+                                    I->getRawSubclassOptionalData());
+
+    if (auto *Cmp = dyn_cast<CmpInst>(I)) {
+      Result = hash_combine(Result, Cmp->getPredicate());
+    } else if (auto *Phi = dyn_cast<PHINode>(I)) {
+      for (const BasicBlock *Incoming : Phi->blocks()) {
+        if (not Incoming->hasName())
+          return None;
+        Result = hash_combine(Result, Incoming->getName());
+      }
+    } else if (auto *Alloca = dyn_cast<AllocaInst>(I)) {
+      Result = hash_combine(Result, Alloca->getAllocatedType());
+    } else if (auto *GEP = dyn_cast<GetElementPtrInst>(I)) {
+      Result = hash_combine(Result, GEP->getSourceElementType());
+    } else if (auto *Extract = dyn_cast<ExtractValueInst>(I)) {
+      Result = hash_combine(Result, hash_combine_range(Extract->idx_begin(),
+                                                       Extract->idx_end()));
+    } else if (auto *Insert = dyn_cast<InsertValueInst>(I)) {
+      Result = hash_combine(Result, hash_combine_range(Insert->idx_begin(),
+                                                       Insert->idx_end()));
+    } else if (isa<ShuffleVectorInst>(I) or I->isAtomic()) {
+      return None;
+    }
+
+    // Calls to the marker also carry an identifier, which changes at each
+    // round, ignore it
+    unsigned OperandsCount = I->getNumOperands();
+    if (auto *Call = dyn_cast<CallInst>(I))
+      if (skipCasts(Call->getCalledOperand()) == Marker)
+        OperandsCount = 1;
+
+    for (unsigned Index = 0; Index < OperandsCount; ++Index) {
+      Hash OperandHash = value(I->getOperand(Index), Region);
+      if (not OperandHash)
+        return None;
+      Result = hash_combine(Result, *OperandHash);
+    }
+
+    return Result;
+  }
+
+  Hash value(const llvm::Value *V, const BlockSet &Region) {
+    using namespace llvm;
+
+    if (auto *C = dyn_cast<Constant>(V))
+      return constant(C);
+
+    if (auto *BB = dyn_cast<BasicBlock>(V)) {
+      if (not BB->hasName())
+        return None;
+      return hash_combine(Value::BasicBlockVal, BB->getName());
+    }
+
+    if (auto *Argument = dyn_cast<llvm::Argument>(V))
+      return hash_combine(Value::ArgumentVal, Argument->getArgNo());
+
+    auto *I = dyn_cast<Instruction>(V);
+    if (I == nullptr)
+      return None;
+
+    const BasicBlock *BB = I->getParent();
+    if (not BB->hasName())
+      return None;
+
+    hash_code Result = hash_combine(Value::InstructionVal,
+                                    BB->getName(),
+                                    Positions.lookup(I));
+    if (Region.count(BB) != 0)
+      return Result;
+
+    // The value is defined outside of the region: what flows in is
+    // represented by the range LazyValueInfo associates to it
+    auto *Type = dyn_cast<IntegerType>(I->getType());
+    if (Type == nullptr)
+      return None;
+
+    auto *NonConst = const_cast<Instruction *>(I);
+    ConstantRange Range = LVI.getConstantRange(NonConst, NonConst->getParent());
+    return hash_combine(Result, Range.getLower(), Range.getUpper());
+  }
+
+  Hash constant(const llvm::Constant *C) {
+    using namespace llvm;
+
+    hash_code Result = hash_combine(C->getValueID(), C->getType());
+
+    if (auto *CI = dyn_cast<ConstantInt>(C))
+      return hash_combine(Result, CI->getValue());
+
+    if (auto *CFP = dyn_cast<ConstantFP>(C))
+      return hash_combine(Result, CFP->getValueAPF());
+
+    if (auto *GV = dyn_cast<GlobalValue>(C)) {
+      if (not GV->hasName())
+        return None;
+      return hash_combine(Result, GV->getName());
+    }
+
+    if (auto *Data = dyn_cast<ConstantDataSequential>(C))
+      return hash_combine(Result, Data->getRawDataValues());
+
+    if (isa<ConstantPointerNull>(C) or isa<UndefValue>(C)
+        or isa<ConstantAggregateZero>(C))
+      return Result;
+
+    if (auto *CE = dyn_cast<ConstantExpr>(C)) {
+      Result = hash_combine(Result,
+                            CE->getOpcode(),
+                            CE->getRawSubclassOptionalData());
+      if (CE->isCompare())
+        Result = hash_combine(Result, CE->getPredicate());
+      if (auto *GEP = dyn_cast<GEPOperator>(CE))
+        Result = hash_combine(Result, GEP->getSourceElementType());
+      if (CE->hasIndices())
+        Result = hash_combine(Result,
+                              hash_combine_range(CE->getIndices().begin(),
+                                                 CE->getIndices().end()));
+    } else if (not isa<ConstantAggregate>(C)) {
+      return None;
+    }
+
+    for (const Use &Operand : C->operands()) {
+      Hash OperandHash = constant(cast<Constant>(Operand.get()));
+      if (not OperandHash)
+        return None;
+      Result = hash_combine(Result, *OperandHash);
+    }
+
+    return Result;
+  }
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <map>
+#include <utility>
+
+#include "revng/BasicAnalyses/MaterializedValue.h"
+#include "revng/Support/MetaAddress.h"
+
+/// \brief Results of the AdvancedValueInfo queries of the last harvesting round
+///
+/// Each entry is keyed by the address of the tracked instruction and by a
+/// fingerprint of everything the query could observe (see AVIFingerprinter).
+/// Only the entries that have been looked up or inserted during the last round
+/// are preserved by endRound, the others are dropped.
+class AVIResultsCache {
+public:
+  using Key = std::pair<MetaAddress, uint64_t>;
+
+private:
+  std::map<Key, MaterializedValues> Previous;
+  std::map<Key, MaterializedValues> Current;
+
+public:
+  /// \return the cached results for \p K, or nullptr
+  const MaterializedValues *find(const Key &K) {
+    auto It = Current.find(K);
+    if (It != Current.end())
+      return &It->second;
+
+    It = Previous.find(K);
+    if (It == Previous.end())
+      return nullptr;
+
+    // Keep the entry alive for the next round too
+    auto &Entry = *Current.insert(Previous.extract(It)).position;
+    return &Entry.second;
+  }
+
+  void insert(const Key &K, MaterializedValues Values) {
+    Current[K] = std::move(Values);
+  }
+
+  /// \brief Drop all the entries that have not been used since the last call
+  void endRound() {
+    Previous = std::move(Current);
+    Current.clear();
+  }
+
+  size_t size() const { return Previous.size() + Current.size(); }
+};
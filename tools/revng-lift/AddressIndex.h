@@ -0,0 +1,200 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/STLExtras.h"
+
+#include "revng/Support/Assert.h"
+#include "revng/Support/MetaAddress.h"
+
+/// \brief Bitmap with one bit per byte of a set of address ranges
+///
+/// It's used as a fast filter in front of the containers indexed by
+/// MetaAddress: if the bit associated to an address is not set, the address is
+/// not in the container. Since only the address component of a MetaAddress is
+/// considered, a set bit only means the address *might* be in the container.
+class AddressBitmap {
+private:
+  struct Range {
+    MetaAddress Start;
+    MetaAddress End;
+    llvm::BitVector Bits;
+  };
+
+private:
+  std::vector<Range> Ranges;
+  /// Index of the last range that has been hit, lookups tend to be local
+  mutable size_t LastHit = 0;
+
+public:
+  AddressBitmap() = default;
+
+  template<typename RangesVector>
+  explicit AddressBitmap(const RangesVector &AddressRanges) {
+    for (const auto &[Start, End] : AddressRanges) {
+      revng_assert(Start.addressLowerThanOrEqual(End));
+      Ranges.push_back({ Start, End, llvm::BitVector(End - Start) });
+    }
+  }
+
+public:
+  /// \return false if \p Address is not part of any range
+  bool set(MetaAddress Address) {
+    Range *R = find(Address);
+    if (R == nullptr)
+      return false;
+
+    R->Bits.set(Address - R->Start);
+    return true;
+  }
+
+  /// \return false if \p Address has never been set
+  bool mayContain(MetaAddress Address) const {
+    const Range *R = find(Address);
+    return R != nullptr and R->Bits.test(Address - R->Start);
+  }
+
+private:
+  Range *find(MetaAddress Address) {
+    const auto *This = this;
+    return const_cast<Range *>(This->find(Address));
+  }
+
+  const Range *find(MetaAddress Address) const {
+    if (not Address.isValid() or Ranges.empty())
+      return nullptr;
+
+    auto Contains = [&Address](const Range &R) {
+      return R.Start.addressLowerThanOrEqual(Address)
+             and Address.addressLowerThan(R.End);
+    };
+
+    if (Contains(Ranges[LastHit]))
+      return &Ranges[LastHit];
+
+    for (size_t I = 0; I < Ranges.size(); ++I) {
+      if (Contains(Ranges[I])) {
+        LastHit = I;
+        return &Ranges[I];
+      }
+    }
+
+    return nullptr;
+  }
+};
+
+/// \brief Map from MetaAddress to \p T stored in a sorted vector
+///
+/// New elements are appended to a small unsorted buffer, which is sorted and
+/// merged in the main vector once it's full, or when the elements are iterated.
+/// Lookups perform a binary search on the main vector and a linear scan of the
+/// buffer.
+///
+/// \note Inserting new elements invalidates pointers to existing ones.
+template<typename T>
+class FlatAddressMap {
+public:
+  using value_type = std::pair<MetaAddress, T>;
+  using const_iterator = typename std::vector<value_type>::const_iterator;
+
+private:
+  static constexpr size_t MaxPending = 64;
+
+private:
+  mutable std::vector<value_type> Sorted;
+  mutable std::vector<value_type> Pending;
+
+public:
+  size_t size() const { return Sorted.size() + Pending.size(); }
+  bool empty() const { return size() == 0; }
+
+  /// \return a pointer to the element associated to \p Key, or nullptr
+  T *find(const MetaAddress &Key) {
+    auto It = std::lower_bound(Sorted.begin(), Sorted.end(), Key, compareKey);
+    if (It != Sorted.end() and It->first == Key)
+      return &It->second;
+
+    for (value_type &Element : Pending)
+      if (Element.first == Key)
+        return &Element.second;
+
+    return nullptr;
+  }
+
+  const T *find(const MetaAddress &Key) const {
+    return const_cast<FlatAddressMap *>(this)->find(Key);
+  }
+
+  bool count(const MetaAddress &Key) const { return find(Key) != nullptr; }
+
+  /// \brief Insert a new element, \p Key must not be in the map already
+  T &insert(const MetaAddress &Key, T Value) {
+    revng_assert(find(Key) == nullptr);
+
+    if (Pending.size() == MaxPending)
+      flush();
+
+    Pending.emplace_back(Key, std::move(Value));
+    return Pending.back().second;
+  }
+
+  const_iterator begin() const {
+    flush();
+    return Sorted.begin();
+  }
+
+  const_iterator end() const {
+    flush();
+    return Sorted.end();
+  }
+
+  /// \brief Erase all the elements for which \p Predicate returns true
+  template<typename F>
+  void eraseIf(F &&Predicate) {
+    flush();
+    llvm::erase_if(Sorted, [&Predicate](value_type &Element) {
+      return Predicate(Element.first, Element.second);
+    });
+  }
+
+  /// \brief Iterate over the elements in order, allowing to mutate them
+  template<typename F>
+  void forEach(F &&Function) {
+    flush();
+    for (value_type &Element : Sorted)
+      Function(Element.first, Element.second);
+  }
+
+private:
+  static bool compareKey(const value_type &Element, const MetaAddress &Key) {
+    return Element.first < Key;
+  }
+
+  static bool compareElements(const value_type &LHS, const value_type &RHS) {
+    return LHS.first < RHS.first;
+  }
+
+  /// \brief Sort the pending elements and merge them in the main vector
+  void flush() const {
+    if (Pending.empty())
+      return;
+
+    std::sort(Pending.begin(), Pending.end(), compareElements);
+    size_t OldSize = Sorted.size();
+    Sorted.insert(Sorted.end(),
+                  std::make_move_iterator(Pending.begin()),
+                  std::make_move_iterator(Pending.end()));
+    std::inplace_merge(Sorted.begin(),
+                       Sorted.begin() + OldSize,
+                       Sorted.end(),
+                       compareElements);
+    Pending.clear();
+  }
+};
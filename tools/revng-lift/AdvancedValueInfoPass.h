@@ -4,16 +4,28 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/Analysis/LazyValueInfo.h"
 #include "llvm/Analysis/ScalarEvolution.h"
 #include "llvm/Analysis/ValueTracking.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/IR/Dominators.h"
+#include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/PassManager.h"
+#include "llvm/Passes/PassBuilder.h"
 #include "llvm/Support/KnownBits.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Transforms/Utils/Cloning.h"
 
 #include "revng/BasicAnalyses/AdvancedValueInfo.h"
 
+#include "AVIFingerprinter.h"
 #include "JumpTargetManager.h"
 
 inline Logger<> AVIPassLogger("avipass");
@@ -23,10 +35,15 @@ private:
   const llvm::DataLayout &DL;
   JumpTargetManager &JTM;
   BinaryFile::Endianess E;
+  /// If not nullptr, taken while reading from JTM, which is shared among
+  /// threads
+  std::mutex *Lock;
 
 public:
-  StaticDataMemoryOracle(const llvm::DataLayout &DL, JumpTargetManager &JTM) :
-    DL(DL), JTM(JTM) {
+  StaticDataMemoryOracle(const llvm::DataLayout &DL,
+                         JumpTargetManager &JTM,
+                         std::mutex *Lock = nullptr) :
+    DL(DL), JTM(JTM), Lock(Lock) {
     // Read the value using the endianess of the destination architecture,
     // since, if there's a mismatch, in the stack we will also have a byteswap
     // instruction
@@ -37,6 +54,11 @@ public:
   const llvm::DataLayout &getDataLayout() const { return DL; }
 
   MaterializedValue load(llvm::Constant *Address) {
+    if (Lock == nullptr)
+      return JTM.readFromPointer(Address, E);
+
+    // readFromPointer keeps track of the memory areas that have been read
+    std::lock_guard<std::mutex> Guard(*Lock);
     return JTM.readFromPointer(Address, E);
   }
 };
@@ -45,10 +67,12 @@ class AdvancedValueInfoPass
   : public llvm::PassInfoMixin<AdvancedValueInfoPass> {
 private:
   JumpTargetManager *JTM;
+  unsigned Threads;
   static constexpr const char *MarkerName = "revng_avi";
 
 public:
-  AdvancedValueInfoPass(JumpTargetManager *JTM) : JTM(JTM) {}
+  AdvancedValueInfoPass(JumpTargetManager *JTM, unsigned Threads = 1) :
+    JTM(JTM), Threads(Threads) {}
 
   llvm::PreservedAnalyses
   run(llvm::Function &F, llvm::FunctionAnalysisManager &);
@@ -63,8 +87,147 @@ public:
     Marker->addFnAttr(llvm::Attribute::InaccessibleMemOnly);
     return Marker;
   }
+
+private:
+  /// Possible values of the tracked value of each call to the marker
+  using ResultsVector = std::vector<MaterializedValues>;
+
+  /// \return the calls to \p Marker in \p F, in program order
+  static std::vector<llvm::CallInst *>
+  markerCalls(llvm::Function &F, llvm::Function *Marker) {
+    using namespace llvm;
+    std::vector<CallInst *> Result;
+    for (BasicBlock &BB : F)
+      for (Instruction &I : BB)
+        if (auto *Call = dyn_cast<CallInst>(&I))
+          if (skipCasts(Call->getCalledOperand()) == Marker)
+            Result.push_back(Call);
+    return Result;
+  }
+
+  /// \brief Run AVI on every \p Shards-th call in \p Calls listed in
+  ///        \p Pending, starting from the \p Shard-th
+  ///
+  /// All the queries share the same LazyValueInfo, ScalarEvolution and
+  /// DominatorTree from \p FAM, which are computed at most once per round,
+  /// and the same AdvancedValueInfo, which caches the SCEV evaluations.
+  void explore(llvm::Function &F,
+               llvm::FunctionAnalysisManager &FAM,
+               std::mutex *Lock,
+               llvm::ArrayRef<llvm::CallInst *> Calls,
+               llvm::ArrayRef<size_t> Pending,
+               unsigned Shard,
+               unsigned Shards,
+               ResultsVector &Results);
+
+  /// \brief Shard the pending calls to the marker in \p F among \p Shards
+  ///        threads
+  ///
+  /// LLVM values and analyses cannot be shared among threads, therefore each
+  /// thread parses its own copy of \p F in a separate LLVMContext and
+  /// computes LazyValueInfo and ScalarEvolution on it. Only the definition of
+  /// \p F is copied, all the other globals become declarations.
+  void exploreInParallel(llvm::Function &F,
+                         llvm::ArrayRef<size_t> Pending,
+                         unsigned Shards,
+                         ResultsVector &Results);
 };
 
+inline void
+AdvancedValueInfoPass::explore(llvm::Function &F,
+                               llvm::FunctionAnalysisManager &FAM,
+                               std::mutex *Lock,
+                               llvm::ArrayRef<llvm::CallInst *> Calls,
+                               llvm::ArrayRef<size_t> Pending,
+                               unsigned Shard,
+                               unsigned Shards,
+                               ResultsVector &Results) {
+  using namespace llvm;
+
+  // The StaticDataMemoryOracle provide the contents of memory areas that are
+  // mapped statically (i.e., in segments). This is critical to capture, e.g.,
+  // virtual tables
+  StaticDataMemoryOracle MO(F.getParent()->getDataLayout(), *JTM, Lock);
+
+  auto &LVI = FAM.getResult<LazyValueAnalysis>(F);
+  auto &DT = FAM.getResult<DominatorTreeAnalysis>(F);
+
+  BasicBlock *Entry = &F.getEntryBlock();
+  SwitchInst *Terminator = cast<SwitchInst>(Entry->getTerminator());
+  BasicBlock *Dispatcher = Terminator->getDefaultDest();
+
+  auto &SCEV = FAM.getResult<ScalarEvolutionAnalysis>(F);
+  AdvancedValueInfo<StaticDataMemoryOracle> AVI(LVI, SCEV, DT, MO, Dispatcher);
+
+  for (size_t J = Shard; J < Pending.size(); J += Shards) {
+    size_t I = Pending[J];
+    CallInst *Call = Calls[I];
+    revng_assert(Call->getNumArgOperands() >= 1);
+
+    // Let AVI provide a series of possible values
+    Results[I] = AVI.explore(Call->getParent(), Call->getArgOperand(0));
+  }
+
+  revng_log(AVIPassLogger,
+            "SCEV evaluations: " << AVI.scevCache().hits() << " cached, "
+                                 << AVI.scevCache().misses() << " computed");
+}
+
+inline void
+AdvancedValueInfoPass::exploreInParallel(llvm::Function &F,
+                                         llvm::ArrayRef<size_t> Pending,
+                                         unsigned Shards,
+                                         ResultsVector &Results) {
+  using namespace llvm;
+
+  // Serialize a module containing only F
+  SmallVector<char, 0> Bitcode;
+  {
+    ValueToValueMapTy VMap;
+    auto OnlyF = [&F](const GlobalValue *GV) { return GV == &F; };
+    std::unique_ptr<Module> Standalone = CloneModule(*F.getParent(),
+                                                     VMap,
+                                                     OnlyF);
+    raw_svector_ostream Stream(Bitcode);
+    WriteBitcodeToFile(*Standalone, Stream);
+  }
+
+  std::mutex Lock;
+  auto Work = [&](unsigned Shard) {
+    LLVMContext Context;
+    MemoryBufferRef Buffer(StringRef(Bitcode.data(), Bitcode.size()),
+                           F.getName());
+    Expected<std::unique_ptr<Module>> MaybeModule = parseBitcodeFile(Buffer,
+                                                                     Context);
+    revng_check(static_cast<bool>(MaybeModule));
+    std::unique_ptr<Module> Replica = std::move(*MaybeModule);
+
+    Function *ReplicaF = Replica->getFunction(F.getName());
+    revng_assert(ReplicaF != nullptr);
+    Function *ReplicaMarker = Replica->getFunction(MarkerName);
+    std::vector<CallInst *> Calls = markerCalls(*ReplicaF, ReplicaMarker);
+    revng_assert(Calls.size() == Results.size());
+
+    ModuleAnalysisManager MAM;
+    FunctionAnalysisManager FAM;
+    auto MAMFunctionProxyFactory = [&MAM] {
+      return ModuleAnalysisManagerFunctionProxy(MAM);
+    };
+    FAM.registerPass(MAMFunctionProxyFactory);
+
+    PassBuilder PB;
+    PB.registerFunctionAnalyses(FAM);
+    PB.registerModuleAnalyses(MAM);
+
+    explore(*ReplicaF, FAM, &Lock, Calls, Pending, Shard, Shards, Results);
+  };
+
+  ThreadPool Pool(hardware_concurrency(Shards));
+  for (unsigned Shard = 0; Shard < Shards; ++Shard)
+    Pool.async(Work, Shard);
+  Pool.wait();
+}
+
 inline llvm::PreservedAnalyses
 AdvancedValueInfoPass::run(llvm::Function &F,
                            llvm::FunctionAnalysisManager &FAM) {
@@ -101,21 +264,6 @@ AdvancedValueInfoPass::run(llvm::Function &F,
   if (Marker == nullptr)
     return llvm::PreservedAnalyses::all();
 
-  // The StaticDataMemoryOracle provide the contents of memory areas that are
-  // mapped statically (i.e., in segments). This is critical to capture, e.g.,
-  // virtual tables
-  StaticDataMemoryOracle MO(F.getParent()->getDataLayout(), *JTM);
-
-  auto &LVI = FAM.getResult<LazyValueAnalysis>(F);
-  auto &DT = FAM.getResult<DominatorTreeAnalysis>(F);
-
-  BasicBlock *Entry = &F.getEntryBlock();
-  SwitchInst *Terminator = cast<SwitchInst>(Entry->getTerminator());
-  BasicBlock *Dispatcher = Terminator->getDefaultDest();
-
-  auto &SCEV = FAM.getResult<ScalarEvolutionAnalysis>(F);
-  AdvancedValueInfo<StaticDataMemoryOracle> AVI(LVI, SCEV, DT, MO, Dispatcher);
-
 #ifndef NDEBUG
   // Ensure that no instruction has itself as operand, except for phis
   for (BasicBlock &BB : F)
@@ -124,19 +272,63 @@ AdvancedValueInfoPass::run(llvm::Function &F,
         revng_assert(isa<PHINode>(V) or V != &I);
 #endif
 
-  for (User *U : Marker->users()) {
-    auto *Call = dyn_cast<CallInst>(U);
-    if (Call == nullptr or skipCasts(Call->getCalledOperand()) != Marker
-        or Call->getParent()->getParent() != &F)
-      continue;
+  std::vector<CallInst *> Calls = markerCalls(F, Marker);
+  ResultsVector Results(Calls.size());
 
-    revng_assert(Call->getNumArgOperands() >= 1);
-    Value *ToTrack = Call->getArgOperand(0);
+  // Reuse the results of the previous round for the queries whose
+  // fingerprint did not change
+  BasicBlock *Entry = &F.getEntryBlock();
+  SwitchInst *Terminator = cast<SwitchInst>(Entry->getTerminator());
+  BasicBlock *Dispatcher = Terminator->getDefaultDest();
+  auto &LVI = FAM.getResult<LazyValueAnalysis>(F);
+  AVIFingerprinter Fingerprinter(F, LVI, Dispatcher, Marker);
+  AVIResultsCache &Cache = JTM->aviCache();
+
+  std::vector<Optional<AVIResultsCache::Key>> Keys(Calls.size());
+  std::vector<size_t> Pending;
+  for (size_t I = 0; I < Calls.size(); ++I) {
+    CallInst *Call = Calls[I];
+
+    // The third argument of the marker, if present, is the address of the
+    // tracked instruction
+    if (Call->getNumArgOperands() >= 3) {
+      auto PC = MetaAddress::fromConstant(Call->getArgOperand(2));
+      if (Optional<uint64_t> Fingerprint = Fingerprinter.get(Call))
+        Keys[I] = AVIResultsCache::Key(PC, *Fingerprint);
+    }
 
-    AVIPassLogger << "Tracking " << ToTrack << ":";
+    const MaterializedValues *Cached = nullptr;
+    if (Keys[I])
+      Cached = Cache.find(*Keys[I]);
 
-    // Let AVI provide a series of possible values
-    MaterializedValues Values = AVI.explore(Call->getParent(), ToTrack);
+    if (Cached != nullptr)
+      Results[I] = *Cached;
+    else
+      Pending.push_back(I);
+  }
+
+  revng_log(AVIPassLogger,
+            (Calls.size() - Pending.size())
+              << " of " << Calls.size() << " queries found in the cache");
+
+  // Loggers are not thread-safe, stay sequential if they are enabled
+  unsigned Shards = std::min<size_t>(Threads, Pending.size());
+  if (Shards > 1 and not AVIPassLogger.isEnabled()
+      and not AVILogger.isEnabled())
+    exploreInParallel(F, Pending, Shards, Results);
+  else if (not Pending.empty())
+    explore(F, FAM, nullptr, Calls, Pending, 0, 1, Results);
+
+  for (size_t I : Pending)
+    if (Keys[I])
+      Cache.insert(*Keys[I], Results[I]);
+  Cache.endRound();
+
+  for (size_t I = 0; I < Calls.size(); ++I) {
+    CallInst *Call = Calls[I];
+    const MaterializedValues &Values = Results[I];
+
+    AVIPassLogger << "Tracking " << Call->getArgOperand(0) << ":";
 
     //
     // Create a revng.avi metadata containing the type of instruction and
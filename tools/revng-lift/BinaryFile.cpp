@@ -5,7 +5,10 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
+#include <functional>
 #include <memory>
+#include <set>
 #include <string>
 #include <tuple>
 #include <utility>
@@ -24,6 +27,7 @@
 #include "llvm/Support/Endian.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/LEB128.h"
+#include "llvm/Support/ThreadPool.h"
 
 #include "revng/Support/CommandLine.h"
 #include "revng/Support/Debug.h"
@@ -40,6 +44,14 @@ using LabelList = BinaryFile::LabelList;
 static Logger<> EhFrameLog("ehframe");
 static Logger<> LabelsLog("labels");
 
+static cl::opt<unsigned> ParsingThreads("parsing-threads",
+                                        cl::desc("number of threads parsing "
+                                                 "the relocations of the "
+                                                 "input binary"),
+                                        cl::value_desc("count"),
+                                        cl::cat(MainCategory),
+                                        cl::init(1));
+
 const unsigned char R_MIPS_IMPLICIT_RELATIVE = 255;
 
 namespace nooverflow {
@@ -594,6 +606,7 @@ BinaryFile::BinaryFile(std::string FilePath, uint64_t PreferedBaseAddress) :
   }
 
   rebuildLabelsMap();
+  rebuildSegmentIndex();
 }
 
 void BinaryFile::registerBindEntry(const object::MachOBindEntry *Entry,
@@ -1277,6 +1290,122 @@ uint64_t BinaryFile::symbolsCount(const FilePortion &Relocations) {
   return SymbolsCount;
 }
 
+void BinaryFile::rebuildSegmentIndex() {
+  ReadableSegments.clear();
+  for (unsigned I = 0; I < Segments.size(); ++I)
+    if (Segments[I].IsReadable)
+      ReadableSegments.push_back(I);
+
+  auto StartOf = [this](unsigned Index) {
+    return Segments[Index].StartVirtualAddress.address();
+  };
+  auto CompareStart = [&StartOf](unsigned A, unsigned B) {
+    return StartOf(A) < StartOf(B);
+  };
+  std::stable_sort(ReadableSegments.begin(),
+                   ReadableSegments.end(),
+                   CompareStart);
+
+  ReadableSegmentsOverlap = false;
+  for (unsigned I = 1; I < ReadableSegments.size(); ++I) {
+    const SegmentInfo &Previous = Segments[ReadableSegments[I - 1]];
+    if (Previous.EndVirtualAddress.address() > StartOf(ReadableSegments[I]))
+      ReadableSegmentsOverlap = true;
+  }
+
+  IndexedSegmentsCount = Segments.size();
+  LastReadSegment = 0;
+}
+
+const SegmentInfo *BinaryFile::findReadableSegment(MetaAddress Address,
+                                                   unsigned Size,
+                                                   unsigned &Hint) const {
+  // Note: we also consider writeable memory areas because, despite being
+  // modifiable, can contain useful information
+  if (ReadableSegmentsOverlap or IndexedSegmentsCount != Segments.size()) {
+    for (const SegmentInfo &Segment : Segments)
+      if (Segment.contains(Address, Size) and Segment.IsReadable)
+        return &Segment;
+    return nullptr;
+  }
+
+  // Consecutive reads tend to hit the same segment
+  if (Hint < ReadableSegments.size()) {
+    const SegmentInfo &Segment = Segments[ReadableSegments[Hint]];
+    if (Segment.contains(Address, Size))
+      return &Segment;
+  }
+
+  // Find the last segment starting at or before Address
+  auto StartsAfter = [this](uint64_t Value, unsigned Index) {
+    return Value < Segments[Index].StartVirtualAddress.address();
+  };
+  auto It = std::upper_bound(ReadableSegments.begin(),
+                             ReadableSegments.end(),
+                             Address.address(),
+                             StartsAfter);
+  if (It == ReadableSegments.begin())
+    return nullptr;
+  --It;
+
+  const SegmentInfo &Segment = Segments[*It];
+  if (not Segment.contains(Address, Size))
+    return nullptr;
+
+  Hint = It - ReadableSegments.begin();
+  return &Segment;
+}
+
+/// Reads a T from a segment, the [p_filesz, p_memsz] portion reads as zero
+template<typename T, support::endianness E>
+struct SegmentReader {
+  uint64_t operator()(const SegmentInfo &Segment, MetaAddress Address) const {
+    uint64_t Offset = Address - Segment.StartVirtualAddress;
+    if (Offset > Segment.Data.size())
+      return 0;
+
+    const unsigned char *Start = Segment.Data.data() + Offset;
+    size_t Available = Segment.Data.size() - Offset;
+    if (Available >= sizeof(T))
+      return support::endian::read<T, E, 1>(Start);
+
+    char Buffer[sizeof(T)] = { 0 };
+    memcpy(&Buffer, Start, Available);
+    return support::endian::read<T, E, 1>(&Buffer);
+  }
+};
+
+/// \brief Call \p F with the SegmentReader for \p Size and the requested
+///        endianness
+///
+/// This lets callers pick the reader once, then run their loop with size and
+/// endianness known at compile time.
+template<typename CallableT>
+static auto withSegmentReader(unsigned Size, bool IsLittleEndian, CallableT F) {
+  using support::endianness;
+  switch (Size) {
+  case 1:
+    return F(SegmentReader<uint8_t, endianness::little>());
+  case 2:
+    if (IsLittleEndian)
+      return F(SegmentReader<uint16_t, endianness::little>());
+    else
+      return F(SegmentReader<uint16_t, endianness::big>());
+  case 4:
+    if (IsLittleEndian)
+      return F(SegmentReader<uint32_t, endianness::little>());
+    else
+      return F(SegmentReader<uint32_t, endianness::big>());
+  case 8:
+    if (IsLittleEndian)
+      return F(SegmentReader<uint64_t, endianness::little>());
+    else
+      return F(SegmentReader<uint64_t, endianness::big>());
+  default:
+    revng_abort("Unexpected read size");
+  }
+}
+
 Optional<uint64_t> BinaryFile::readRawValue(MetaAddress Address,
                                             unsigned Size,
                                             Endianess E) const {
@@ -1284,49 +1413,41 @@ Optional<uint64_t> BinaryFile::readRawValue(MetaAddress Address,
                            architecture().isLittleEndian() :
                            E == LittleEndian);
 
-  for (auto &Segment : segments()) {
-    // Note: we also consider writeable memory areas because, despite being
-    // modifiable, can contain useful information
-    if (Segment.contains(Address, Size) && Segment.IsReadable) {
-      uint64_t Offset = Address - Segment.StartVirtualAddress;
-      // Handle the [p_filesz, p_memsz] portion of the segment
-      if (Offset > Segment.Data.size())
-        return 0;
-
-      const unsigned char *Start = Segment.Data.data() + Offset;
-
-      char Buffer[8] = { 0 };
-      memcpy(&Buffer,
-             Start,
-             std::min(static_cast<size_t>(Size), Segment.Data.size() - Offset));
-
-      using support::endianness;
-      using support::endian::read;
-      switch (Size) {
-      case 1:
-        return read<uint8_t, endianness::little, 1>(&Buffer);
-      case 2:
-        if (IsLittleEndian)
-          return read<uint16_t, endianness::little, 1>(&Buffer);
-        else
-          return read<uint16_t, endianness::big, 1>(&Buffer);
-      case 4:
-        if (IsLittleEndian)
-          return read<uint32_t, endianness::little, 1>(&Buffer);
-        else
-          return read<uint32_t, endianness::big, 1>(&Buffer);
-      case 8:
-        if (IsLittleEndian)
-          return read<uint64_t, endianness::little, 1>(&Buffer);
-        else
-          return read<uint64_t, endianness::big, 1>(&Buffer);
-      default:
-        revng_abort("Unexpected read size");
-      }
+  const SegmentInfo *Segment = findReadableSegment(Address,
+                                                   Size,
+                                                   LastReadSegment);
+  if (Segment == nullptr)
+    return Optional<uint64_t>();
+
+  return withSegmentReader(Size, IsLittleEndian, [&](auto Read) {
+    return Read(*Segment, Address);
+  });
+}
+
+std::vector<Optional<uint64_t>>
+BinaryFile::readRawValues(ArrayRef<MetaAddress> Addresses,
+                          unsigned Size,
+                          Endianess E) const {
+  bool IsLittleEndian = ((E == OriginalEndianess) ?
+                           architecture().isLittleEndian() :
+                           E == LittleEndian);
+
+  std::vector<Optional<uint64_t>> Result;
+  Result.reserve(Addresses.size());
+
+  // Size and endianness are resolved once for the whole batch
+  unsigned Hint = LastReadSegment;
+  withSegmentReader(Size, IsLittleEndian, [&](auto Read) {
+    for (MetaAddress Address : Addresses) {
+      const SegmentInfo *Segment = findReadableSegment(Address, Size, Hint);
+      if (Segment == nullptr)
+        Result.emplace_back();
+      else
+        Result.emplace_back(Read(*Segment, Address));
     }
-  }
+  });
 
-  return Optional<uint64_t>();
+  return Result;
 }
 
 Label BinaryFile::parseRelocation(unsigned char RelocationType,
@@ -1410,31 +1531,78 @@ void BinaryFile::registerRelocations(Elf_Rel_Array<T, HasAddend> Relocations,
   if (Dynsym.isAvailable())
     Symbols = Dynsym.extractAs<Elf_Sym>(Segments);
 
-  for (Elf_Rel Relocation : Relocations) {
-    auto Type = static_cast<unsigned char>(Relocation.getType(false));
-    uint64_t Addend = RelocationHelper<T, HasAddend>::getAddend(Relocation);
-    MetaAddress Address = relocate(fromGeneric(Relocation.r_offset));
-
-    StringRef SymbolName;
-    uint64_t SymbolSize = 0;
-    unsigned char SymbolType = llvm::ELF::STT_NOTYPE;
-    if (Dynsym.isAvailable() and Dynstr.isAvailable()) {
-      uint32_t SymbolIndex = Relocation.getSymbol(false);
-      revng_check(SymbolIndex < Symbols.size());
-      const Elf_Sym &Symbol = Symbols[SymbolIndex];
-      auto Result = Symbol.getName(Dynstr.extractString(Segments));
-      if (Result)
-        SymbolName = *Result;
-      SymbolSize = Symbol.st_size;
-      SymbolType = Symbol.getType();
+  StringRef DynstrContent;
+  bool HasSymbols = Dynsym.isAvailable() and Dynstr.isAvailable();
+  if (HasSymbols)
+    DynstrContent = Dynstr.extractString(Segments);
+
+  // Each slice of relocations is parsed, possibly by a different thread, in a
+  // buffer of its own. The buffers are then registered in order.
+  struct Slice {
+    ArrayRef<Elf_Rel> Relocations;
+    std::vector<Label> Labels;
+    std::vector<unsigned char> UnhandledTypes;
+  };
+
+  static constexpr size_t SliceSize = 1 << 14;
+  std::vector<Slice> Slices;
+  for (size_t Start = 0; Start < Relocations.size(); Start += SliceSize) {
+    size_t Size = std::min(SliceSize, Relocations.size() - Start);
+    Slices.push_back({ Relocations.slice(Start, Size), {}, {} });
+  }
+
+  const auto &RelocationTypes = TheArchitecture.relocationTypes();
+  auto ParseSlice = [&](Slice &S) {
+    for (const Elf_Rel &Relocation : S.Relocations) {
+      auto Type = static_cast<unsigned char>(Relocation.getType(false));
+      if (RelocationTypes.count(Type) == 0) {
+        S.UnhandledTypes.push_back(Type);
+        continue;
+      }
+
+      uint64_t Addend = RelocationHelper<T, HasAddend>::getAddend(Relocation);
+      MetaAddress Address = relocate(fromGeneric(Relocation.r_offset));
+
+      StringRef SymbolName;
+      uint64_t SymbolSize = 0;
+      unsigned char SymbolType = llvm::ELF::STT_NOTYPE;
+      if (HasSymbols) {
+        uint32_t SymbolIndex = Relocation.getSymbol(false);
+        revng_check(SymbolIndex < Symbols.size());
+        const Elf_Sym &Symbol = Symbols[SymbolIndex];
+        auto Result = Symbol.getName(DynstrContent);
+        if (Result)
+          SymbolName = *Result;
+        SymbolSize = Symbol.st_size;
+        SymbolType = Symbol.getType();
+      }
+
+      S.Labels.push_back(parseRelocation(Type,
+                                         Address,
+                                         Addend,
+                                         SymbolName,
+                                         SymbolSize,
+                                         SymbolType::fromELF(SymbolType)));
     }
+  };
+
+  if (ParsingThreads > 1 and Slices.size() > 1) {
+    ThreadPool Pool(hardware_concurrency(ParsingThreads));
+    for (Slice &S : Slices)
+      Pool.async(ParseSlice, std::ref(S));
+    Pool.wait();
+  } else {
+    for (Slice &S : Slices)
+      ParseSlice(S);
+  }
 
-    registerLabel(parseRelocation(Type,
-                                  Address,
-                                  Addend,
-                                  SymbolName,
-                                  SymbolSize,
-                                  SymbolType::fromELF(SymbolType)));
+  for (Slice &S : Slices) {
+    for (unsigned char Type : S.UnhandledTypes)
+      dbg << "Warning: unhandled relocation type " << static_cast<int>(Type)
+          << "\n";
+
+    for (const Label &L : S.Labels)
+      registerLabel(L);
   }
 }
 
@@ -1499,13 +1667,70 @@ void BinaryFile::rebuildLabelsMap() {
     ZeroSizedLabels[I]->setVirtualSize(End - Start);
   }
 
-  // Insert all the other labels in the map
-  for (Label &L : Labels) {
+  // Build the map in bulk, instead of adding the labels one by one. Sweep the
+  // start and end addresses of all the labels in order, keeping track of the
+  // active ones, and append a segment between each pair of consecutive
+  // addresses. Active labels are kept in registration order, so the result is
+  // the same.
+  struct Boundary {
+    MetaAddress Address;
+    bool IsStart;
+    size_t Index;
+  };
+
+  std::vector<Boundary> Boundaries;
+  for (size_t I = 0; I < Labels.size(); ++I) {
+    const Label &L = Labels[I];
     MetaAddress Start = L.address();
     MetaAddress End = L.address() + L.size();
-    LabelsMap += make_pair(Interval::right_open(Start, End), LabelList{ &L });
+    if (Start.addressLowerThan(End)) {
+      Boundaries.push_back({ Start, true, I });
+      Boundaries.push_back({ End, false, I });
+    }
   }
 
+  auto CompareBoundaries = [](const Boundary &LHS, const Boundary &RHS) {
+    return LHS.Address.addressLowerThan(RHS.Address);
+  };
+  std::sort(Boundaries.begin(), Boundaries.end(), CompareBoundaries);
+
+  std::set<size_t> Active;
+  auto Hint = LabelsMap.end();
+  for (size_t I = 0; I < Boundaries.size();) {
+    MetaAddress Start = Boundaries[I].Address;
+    for (; I < Boundaries.size(); ++I) {
+      const Boundary &Current = Boundaries[I];
+      if (Start.addressLowerThan(Current.Address))
+        break;
+
+      if (Current.IsStart)
+        Active.insert(Current.Index);
+      else
+        Active.erase(Current.Index);
+    }
+
+    if (Active.empty())
+      continue;
+
+    revng_assert(I < Boundaries.size());
+    LabelList Segment;
+    for (size_t Index : Active)
+      Segment.push_back(&Labels[Index]);
+
+    auto NewInterval = Interval::right_open(Start, Boundaries[I].Address);
+    Hint = LabelsMap.add(Hint, make_pair(NewInterval, Segment));
+  }
+
+  // Index the symbols by address, for nameForAddress
+  std::vector<LabelIndex::Entry> SymbolEntries;
+  for (const Label &L : Labels) {
+    if (L.isSymbol()) {
+      uint64_t Start = L.address().address();
+      SymbolEntries.push_back({ Start, Start + L.size(), &L });
+    }
+  }
+  SymbolsByAddress = LabelIndex(std::move(SymbolEntries));
+
   // Dump the map out
   if (LabelsLog.isEnabled()) {
     for (auto &P : LabelsMap) {
@@ -1889,6 +2114,15 @@ void BinaryFile::parseEHFrame(MetaAddress EHFrameAddress,
       auto PCBeginPointer = EHFrameReader.readPointer(*CIE.FDEPointerEncoding);
       MetaAddress PCBegin = getGenericPointer<T>(PCBeginPointer);
       logAddress(EhFrameLog, "PCBegin: ", PCBegin);
+      if (PCBegin.isValid())
+        FDEStarts.insert(PCBegin);
+
+      // Landing pads come from the LSDA only, if there's none there's nothing
+      // else to decode
+      if (not CIE.LSDAPointerEncoding and not EhFrameLog.isEnabled()) {
+        EHFrameReader.moveTo(EndOffset);
+        continue;
+      }
 
       // PCRange
       EHFrameReader.readPointer(*CIE.FDEPointerEncoding);
@@ -1969,9 +2203,13 @@ static bool isBetterThan(const Label *NewCandidate, const Label *OldCandidate) {
     return true;
 
   if (NewCandidate->address() == OldCandidate->address()) {
-    StringRef OldName = OldCandidate->symbolName();
-    if (OldName.size() == 0)
-      return true;
+    // Prefer labels with a name, then the ones registered first
+    bool NewHasName = NewCandidate->symbolName().size() != 0;
+    bool OldHasName = OldCandidate->symbolName().size() != 0;
+    if (NewHasName != OldHasName)
+      return NewHasName;
+
+    return NewCandidate < OldCandidate;
   }
 
   return false;
@@ -1979,63 +2217,61 @@ static bool isBetterThan(const Label *NewCandidate, const Label *OldCandidate) {
 
 std::string
 BinaryFile::nameForAddress(MetaAddress Address, uint64_t Size) const {
-  using interval = boost::icl::interval<MetaAddress, compareAddress>;
   std::stringstream Result;
-  const auto &SymbolMap = labels();
 
   auto End = Address.toGeneric() + Size;
   revng_assert(Address.isValid() and End.isValid());
-  auto It = SymbolMap.find(interval::right_open(Address, End));
-  if (It != SymbolMap.end()) {
-    // We have to look for (in order):
-    //
-    // * Exact match
-    // * Contained (non 0-sized)
-    // * Contained (0-sized)
-    const Label *ExactMatch = nullptr;
-    const Label *ContainedNonZeroSized = nullptr;
-    const Label *ContainedZeroSized = nullptr;
-
-    for (const Label *L : It->second) {
-      // Consider symbols only
-      if (not L->isSymbol())
-        continue;
-
-      if (L->matches(Address, Size)) {
 
-        // It's an exact match
+  // We have to look for (in order):
+  //
+  // * Exact match
+  // * Contained (non 0-sized)
+  // * Contained (0-sized)
+  //
+  // Candidates are visited in no particular order, ties are broken in favor of
+  // the label registered first
+  const Label *ExactMatch = nullptr;
+  const Label *ContainedNonZeroSized = nullptr;
+  const Label *ContainedZeroSized = nullptr;
+
+  auto Visit = [&](const LabelIndex::Entry &Entry) {
+    const Label *L = Entry.Value;
+
+    if (L->matches(Address, Size)) {
+
+      // It's an exact match
+      if (ExactMatch == nullptr or L < ExactMatch)
         ExactMatch = L;
-        break;
 
-      } else if (not L->isSizeVirtual() and L->contains(Address, Size)) {
+    } else if (not L->isSizeVirtual() and L->contains(Address, Size)) {
 
-        // It's contained in a not 0-sized symbol
-        if (isBetterThan(L, ContainedNonZeroSized))
-          ContainedNonZeroSized = L;
+      // It's contained in a not 0-sized symbol
+      if (isBetterThan(L, ContainedNonZeroSized))
+        ContainedNonZeroSized = L;
 
-      } else if (L->isSizeVirtual() and L->contains(Address, 0)) {
+    } else if (L->isSizeVirtual() and L->contains(Address, 0)) {
 
-        // It's contained in a 0-sized symbol
-        if (isBetterThan(L, ContainedZeroSized))
-          ContainedZeroSized = L;
-      }
-    }
-
-    const Label *Chosen = nullptr;
-    if (ExactMatch != nullptr)
-      Chosen = ExactMatch;
-    else if (ContainedNonZeroSized != nullptr)
-      Chosen = ContainedNonZeroSized;
-    else if (ContainedZeroSized != nullptr)
-      Chosen = ContainedZeroSized;
-
-    if (Chosen != nullptr and Chosen->symbolName().size() != 0) {
-      auto Arch = architecture().type();
-      Address.dumpRelativeTo(Result,
-                             Chosen->address().toPC(Arch),
-                             Chosen->symbolName());
-      return Result.str();
+      // It's contained in a 0-sized symbol
+      if (isBetterThan(L, ContainedZeroSized))
+        ContainedZeroSized = L;
     }
+  };
+  SymbolsByAddress.forEachContaining(Address.address(), Visit);
+
+  const Label *Chosen = nullptr;
+  if (ExactMatch != nullptr)
+    Chosen = ExactMatch;
+  else if (ContainedNonZeroSized != nullptr)
+    Chosen = ContainedNonZeroSized;
+  else if (ContainedZeroSized != nullptr)
+    Chosen = ContainedZeroSized;
+
+  if (Chosen != nullptr and Chosen->symbolName().size() != 0) {
+    auto Arch = architecture().type();
+    Address.dumpRelativeTo(Result,
+                           Chosen->address().toPC(Arch),
+                           Chosen->symbolName());
+    return Result.str();
   }
 
   // We don't have a symbol to use, just return the address
@@ -14,6 +14,7 @@
 #include "llvm/Object/Binary.h"
 #include "llvm/Object/ELFTypes.h"
 
+#include "revng/ADT/IntervalIndex.h"
 #include "revng/Support/revng.h"
 
 namespace llvm {
@@ -448,6 +449,8 @@ public:
 
   using LabelIntervalMap = interval_map<MetaAddress, LabelList, compareAddress>;
 
+  using LabelIndex = IntervalIndex<const Label *>;
+
   enum Endianess { OriginalEndianess, BigEndian, LittleEndian };
 
 public:
@@ -487,6 +490,7 @@ public:
   const std::vector<SegmentInfo> &segments() const { return Segments; }
   const LabelIntervalMap &labels() const { return LabelsMap; }
   const std::set<MetaAddress> &landingPads() const { return LandingPads; }
+  const std::set<MetaAddress> &fdeStarts() const { return FDEStarts; }
   const std::set<MetaAddress> &codePointers() const { return CodePointers; }
   MetaAddress entryPoint() const { return EntryPoint; }
 
@@ -529,6 +533,17 @@ public:
                                         unsigned Size,
                                         Endianess E = OriginalEndianess) const;
 
+  /// \brief Try to read an integer of \p Size bytes at each of \p Addresses
+  ///
+  /// Equivalent to calling readRawValue on each address, but the endianness is
+  /// resolved once and consecutive addresses falling in the same segment do
+  /// not go through the segment lookup again. Meant for scanning arrays, such
+  /// as jump tables.
+  std::vector<llvm::Optional<uint64_t>>
+  readRawValues(llvm::ArrayRef<MetaAddress> Addresses,
+                unsigned Size,
+                Endianess E = OriginalEndianess) const;
+
   MetaAddress relocate(MetaAddress Address) const {
     if (BaseAddress) {
       return Address + *BaseAddress;
@@ -585,7 +600,8 @@ private:
   std::pair<MetaAddress, uint64_t>
   ehFrameFromEhFrameHdr(MetaAddress EHFrameHdrAddress);
 
-  /// \brief Parse the .eh_frame section to collect all the landing pads
+  /// \brief Parse the .eh_frame section to collect all the landing pads and
+  ///        the start address of the FDEs
   ///
   /// \param EHFrameAddress the address of the .eh_frame section
   /// \param FDEsCount the count of FDEs in the .eh_frame section
@@ -642,6 +658,17 @@ private:
 
   void rebuildLabelsMap();
 
+  void rebuildSegmentIndex();
+
+  /// \brief Find the readable segment containing [\p Address, \p Address +
+  ///        \p Size)
+  ///
+  /// \param Hint position in ReadableSegments of the last segment found, which
+  ///        is tried first and updated on success.
+  const SegmentInfo *findReadableSegment(MetaAddress Address,
+                                         unsigned Size,
+                                         unsigned &Hint) const;
+
   SegmentInfo *findSegment(MetaAddress Address) {
     for (SegmentInfo &Segment : Segments)
       if (Segment.contains(Address))
@@ -660,14 +687,28 @@ private:
   llvm::object::OwningBinary<llvm::object::Binary> BinaryHandle;
   Architecture TheArchitecture;
   std::vector<SegmentInfo> Segments;
+  /// Indices in Segments of the readable segments, sorted by start address
+  std::vector<unsigned> ReadableSegments;
+  /// Size of Segments when ReadableSegments was built, if it changed the index
+  /// is stale
+  size_t IndexedSegmentsCount = 0;
+  /// If readable segments overlap the first match in Segments wins, which the
+  /// index cannot tell
+  bool ReadableSegmentsOverlap = false;
+  /// Last hit of readRawValue, the lifter only reads from a single thread
+  mutable unsigned LastReadSegment = 0;
   std::vector<std::string> NeededLibraryNames;
   /// The set of the landing pad addresses collected from .eh_frame
   std::set<MetaAddress> LandingPads;
+  /// The start addresses of the FDEs in .eh_frame
+  std::set<MetaAddress> FDEStarts;
   /// These are taken from dynamic symbols/relocations
   std::set<MetaAddress> CodePointers;
   std::map<llvm::StringRef, uint64_t> CanonicalValues;
   std::vector<Label> Labels;
   LabelIntervalMap LabelsMap;
+  /// Symbols only, built along with LabelsMap
+  LabelIndex SymbolsByAddress;
 
   /// The program's entry point
   MetaAddress EntryPoint;
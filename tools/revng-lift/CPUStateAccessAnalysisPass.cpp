@@ -6,11 +6,13 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <memory>
 #include <sstream>
 #include <stack>
 #include <string>
 #include <vector>
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/IR/Instructions.h"
@@ -18,6 +20,7 @@
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Value.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/Support/Allocator.h"
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/raw_ostream.h"
 
@@ -49,6 +52,44 @@ static uint64_t NumUnknown = 0;
 static std::map<std::string, uint64_t> FunToNumUnknown;
 static std::map<std::string, std::set<std::string>> FunToUnknowns;
 
+/// \brief Computes the set of Functions directly called by \p F
+///
+/// \param LoadMDKind is the metadata kind used for decorating call sites that
+///        access CPU State to load data
+/// \param StoreMDKind is the metadata kind used for decorating call sites that
+///        access CPU State to store data
+/// \param Lazy tells if the analysis is running in Lazy mode
+static ConstFunctionPtrSet directCallees(const Function &F,
+                                         const unsigned LoadMDKind,
+                                         const unsigned StoreMDKind,
+                                         const bool Lazy) {
+  ConstFunctionPtrSet Result;
+  for (const BasicBlock &BB : F) {
+    for (const Instruction &I : BB) {
+      const auto *TheCall = dyn_cast<const CallInst>(&I);
+      if (TheCall == nullptr)
+        continue;
+
+      // If this call has already been decorated with LoadMDKind or
+      // StoreMDKind metadata it means that it has already been processed by a
+      // previous run of CPUStateAccessAnalysis.
+      // If we're running in lazy mode, we can skip calls that have already
+      // been decorated.
+      if (Lazy) {
+        if (TheCall->getMetadata(LoadMDKind) != nullptr
+            or TheCall->getMetadata(StoreMDKind) != nullptr) {
+          continue;
+        }
+      }
+
+      if (const Function *Callee = getCallee(TheCall))
+        Result.insert(Callee);
+    }
+  }
+
+  return Result;
+}
+
 /// \brief Computes the set of Functions reachable from a given Function through
 ///        direct calls.
 ///
@@ -59,80 +100,32 @@ static std::map<std::string, std::set<std::string>> FunToUnknowns;
 /// \param StoreMDKind is the metadata kind used for decorating call sites that
 ///        access CPU State to store data
 /// \param Lazy tells if the analysis is running in Lazy mode
+/// \param Cache if not null, the callees of the functions other than
+///        RootFunction are taken from here, if available, or recorded here
 /// \return set of pointers to the reachable Functions
-///
-/// This function can probably be implemented using the call graph utilities
-/// already present in LLVM, but when I tried it I spent a day doing it and I
-/// gave up because of bugs in the functions coming from LLVM. Then I
-/// implemented my own version, i.e. this function
 static ConstFunctionPtrSet
 computeDirectlyReachableFunctions(const Function *RootFunction,
                                   const unsigned LoadMDKind,
                                   const unsigned StoreMDKind,
-                                  const bool Lazy) {
-  std::map<const Function *, ConstFunctionPtrSet> CallGraph;
+                                  const bool Lazy,
+                                  CPUStateAccessAnalysisCache *Cache) {
+  std::map<const Function *, const ConstFunctionPtrSet *> CallGraph;
+  std::map<const Function *, ConstFunctionPtrSet> Uncached;
   const Module &M = *RootFunction->getParent();
 
-  // Initialize empty CallGraph
-  for (const Function &F : M)
-    CallGraph[&F] = {};
-
   for (const Function &F : M) {
-    for (const Use &U : F.uses()) {
-      const User *TheUser = U.getUser();
-      if (const auto *TheCall = dyn_cast<const CallInst>(TheUser)) {
-        // If this call has already been decorated with LoadMDKind or
-        // StoreMDKind metadata it means that it has already been processed by
-        // a previous run of CPUStateAccessAnalysis.
-        // If we're running in lazy mode, we can skip calls that have already
-        // been decorated.
-        if (Lazy) {
-          if (TheCall->getMetadata(LoadMDKind) != nullptr
-              or TheCall->getMetadata(StoreMDKind) != nullptr) {
-            continue;
-          }
-        }
-        const Function *Caller = TheCall->getFunction();
-        const Function *Callee = getCallee(TheCall);
-        if (Callee == &F) {
-          CallGraph[Caller].insert(Callee);
-        }
-      } else if (const auto *CExpr = dyn_cast<const ConstantExpr>(TheUser)) {
-        SmallPtrSet<const ConstantExpr *, 16> CurBitCasts;
-        SmallPtrSet<const ConstantExpr *, 16> NextBitCasts;
-        CurBitCasts.insert(CExpr);
-        while (not CurBitCasts.empty()) {
-          NextBitCasts.clear();
-          for (const ConstantExpr *BitCast : CurBitCasts) {
-            for (const User *BitCastUser : BitCast->users()) {
-              const auto *TheCall = dyn_cast<const CallInst>(BitCastUser);
-              const auto *NewCExpr = dyn_cast<const ConstantExpr>(BitCastUser);
-              if (TheCall) {
-                // If this call has already been decorated with LoadMDKind or
-                // StoreMDKind metadata it means that it has already been
-                // processed by a previous run of CPUStateAccessAnalysis.
-                // If we're running in lazy mode, we can skip calls that have
-                // already been decorated.
-                if (Lazy) {
-                  if (TheCall->getMetadata(LoadMDKind) != nullptr
-                      or TheCall->getMetadata(StoreMDKind) != nullptr) {
-                    continue;
-                  }
-                }
-                const Function *Caller = TheCall->getFunction();
-                const Function *Callee = getCallee(TheCall);
-                if (Callee == &F) {
-                  CallGraph[Caller].insert(Callee);
-                }
-              } else if (NewCExpr) {
-                NextBitCasts.insert(NewCExpr);
-              }
-            }
-          }
-          std::swap(CurBitCasts, NextBitCasts);
-        }
-      }
+    if (Cache == nullptr or &F == RootFunction) {
+      auto Callees = directCallees(F, LoadMDKind, StoreMDKind, Lazy);
+      CallGraph[&F] = &(Uncached[&F] = std::move(Callees));
+      continue;
     }
+
+    auto &Entry = Cache->Callees[&F];
+    if (Entry.Function == nullptr) {
+      Entry.Function = const_cast<Function *>(&F);
+      Entry.Callees = directCallees(F, LoadMDKind, StoreMDKind, Lazy);
+    }
+    CallGraph[&F] = &Entry.Callees;
   }
 
   ConstFunctionPtrSet ReachableFunctions = { RootFunction };
@@ -141,7 +134,7 @@ computeDirectlyReachableFunctions(const Function *RootFunction,
   while (not CurrentChildren.empty()) {
     NextChildren.clear();
     for (const Function *F : CurrentChildren) {
-      for (const Function *Callee : CallGraph.at(F)) {
+      for (const Function *Callee : *CallGraph.at(F)) {
         bool NewInsertion = ReachableFunctions.insert(Callee).second;
         if (NewInsertion)
           NextChildren.insert(Callee);
@@ -664,21 +657,27 @@ forwardTaintAnalysis(const Module *M,
   return Results;
 }
 
+/// \brief Allocator of the sources of the `WorkItem`s
+///
+/// The sources of a `WorkItem` never change, and all the `WorkItem`s are done
+/// once the analysis of an access is over, at which point the arena is reset.
+using WorkItemArena = BumpPtrAllocator;
+
 class WorkItem {
 
 public:
-  using size_type = SmallVector<const Use *, 3>::size_type;
-  using iterator = SmallVector<const Use *, 3>::iterator;
-  using const_iterator = SmallVector<const Use *, 3>::const_iterator;
+  using size_type = ArrayRef<const Use *>::size_type;
+  using iterator = ArrayRef<const Use *>::iterator;
+  using const_iterator = ArrayRef<const Use *>::const_iterator;
 
 private:
   // The value whose sources we're analyzing
   Value *CurrentValue;
 
-  // Sources are kind of the opposite of `Use`s. Every pointer in this vector
+  // Sources are kind of the opposite of `Use`s. Every pointer in this array
   // points to a `Use` whose `User` is the `Value` pointed by the `CurrentValue`
-  // member of this `WorkItem`.
-  SmallVector<const Use *, 3> Sources;
+  // member of this `WorkItem`. The array is owned by a `WorkItemArena`.
+  ArrayRef<const Use *> Sources;
 
   // The index of the Source that is currently considered for the analysis
   size_type SourceIndex;
@@ -686,25 +685,28 @@ private:
 public:
   WorkItem() : CurrentValue(nullptr), Sources(), SourceIndex(0) {}
 
-  explicit WorkItem(Instruction *I) :
+  explicit WorkItem(Instruction *I, WorkItemArena &Arena) :
     CurrentValue(I), Sources(), SourceIndex(0) {
+    SmallVector<const Use *, 4> Srcs;
     if (not isa<StoreInst>(I)) {
       for (const Use &OpUse : I->operands()) {
-        Sources.push_back(&OpUse);
+        Srcs.push_back(&OpUse);
       }
     } else {
       const auto PtrOpNum = StoreInst::getPointerOperandIndex();
-      Sources.push_back(&I->getOperandUse(PtrOpNum));
+      Srcs.push_back(&I->getOperandUse(PtrOpNum));
     }
-    revng_assert(not Sources.empty());
+    setSources(Srcs, Arena);
   }
 
   explicit WorkItem(Argument *A,
                     const ConstFunctionPtrSet &ReachableFunctions,
                     const bool IsLazy,
                     const unsigned LoadMDKind,
-                    const unsigned StoreMDKind) :
+                    const unsigned StoreMDKind,
+                    WorkItemArena &Arena) :
     CurrentValue(A), Sources(), SourceIndex(0) {
+    SmallVector<const Use *, 8> Srcs;
     const Function *F = A->getParent();
     revng_assert(not F->empty());
     revng_log(CSVAccessLog, "Function: " << F);
@@ -739,7 +741,7 @@ public:
           revng_log(CSVAccessLog,
                     "ActualUse:" << actualArgUse.getUser() << " : "
                                  << dumpToString(actualArgUse.getUser()));
-          Sources.push_back(&actualArgUse);
+          Srcs.push_back(&actualArgUse);
         } else {
           revng_log(CSVAccessLog, "NOT Reachable");
         }
@@ -776,7 +778,7 @@ public:
               revng_log(CSVAccessLog,
                         "ActualUse:" << actualArgUse.getUser() << " : "
                                      << dumpToString(actualArgUse.getUser()));
-              Sources.push_back(&actualArgUse);
+              Srcs.push_back(&actualArgUse);
             }
           }
         }
@@ -784,15 +786,17 @@ public:
     }
     // This might be too strict, because the arguments of the root function
     // don't have any sources. However, we assume that we never reach them.
-    revng_assert(not Sources.empty());
+    setSources(Srcs, Arena);
   }
 
   explicit WorkItem(CallInst *C,
                     const bool IsLoad,
                     const bool IsLazy,
                     const unsigned LoadMDKind,
-                    const unsigned StoreMDKind) :
+                    const unsigned StoreMDKind,
+                    WorkItemArena &Arena) :
     CurrentValue(C), Sources(), SourceIndex(0) {
+    SmallVector<const Use *, 4> Srcs;
 
     revng_assert(not IsLazy
                  or (C->getMetadata(LoadMDKind) == nullptr
@@ -802,22 +806,31 @@ public:
     revng_assert(F != nullptr); // Assume no indirect calls
     if (F->getIntrinsicID() == Intrinsic::memcpy) {
       const Use &AddrOp = C->getOperandUse(IsLoad ? 1 : 0);
-      Sources.push_back(&AddrOp);
+      Srcs.push_back(&AddrOp);
       const Use &SizeOp = C->getOperandUse(2);
-      Sources.push_back(&SizeOp);
+      Srcs.push_back(&SizeOp);
     } else {
       for (const BasicBlock &BB : *F) {
         const Instruction *I = BB.getTerminator();
         if (I and isa<ReturnInst>(I) and I->getNumOperands() != 0) {
           revng_assert(I->getNumOperands() == 1);
           const Use &RetValUse = I->getOperandUse(0);
-          Sources.push_back(&RetValUse);
+          Srcs.push_back(&RetValUse);
         }
       }
     }
-    revng_assert(not Sources.empty());
+    setSources(Srcs, Arena);
+  }
+
+private:
+  void setSources(ArrayRef<const Use *> Srcs, WorkItemArena &Arena) {
+    revng_assert(not Srcs.empty());
+    const Use **Data = Arena.Allocate<const Use *>(Srcs.size());
+    std::uninitialized_copy(Srcs.begin(), Srcs.end(), Data);
+    Sources = makeArrayRef(Data, Srcs.size());
   }
 
+
 public:
   friend inline void writeToLog(Logger<true> &L, const WorkItem &I, int) {
     L << "Value: " << I.Val() << " : " << dumpToString(I.Val()) << DoLog;
@@ -935,7 +948,7 @@ template<class T>
 class CRTPOffsetFolder {
 
 protected:
-  using offset_iterator = std::set<int64_t>::const_iterator;
+  using offset_iterator = CSVOffsets::const_iterator;
   using offset_iterator_range = llvm::iterator_range<offset_iterator>;
   using OffsetPair = std::pair<const CSVOffsets *, const CSVOffsets *>;
 
@@ -1274,7 +1287,7 @@ private:
           auto IdxIt = GEP->idx_begin();
           auto IdxEnd = GEP->idx_end();
           int IdxOpNum = 1;
-          std::set<int64_t> LastTypeOffsets = { 0 };
+          SmallVector<int64_t, 4> LastTypeOffsets = { 0 };
 
           for (; IdxIt != IdxEnd; ++IdxIt, ++IdxOpNum) {
             const CSVOffsets *IdxCSVOffset = OffsetTuple[IdxOpNum];
@@ -1296,7 +1309,7 @@ private:
                 revng_assert(ArrayNumElem);
                 LastTypeOffsets.clear();
                 for (uint64_t O = 0; O < ArrayNumElem; ++O)
-                  LastTypeOffsets.insert(O);
+                  LastTypeOffsets.push_back(O);
 
                 ConstIdxList.push_back(0);
               } else if (ElementTy->isStructTy()) {
@@ -1317,8 +1330,7 @@ private:
                   ConstIdxList.push_back(*IdxCSVOffset->begin());
 
                   revng_assert(IdxCSVOffset->size() != 0);
-                  LastTypeOffsets.clear();
-                  LastTypeOffsets.insert(IdxCSVOffset->begin(),
+                  LastTypeOffsets.assign(IdxCSVOffset->begin(),
                                          IdxCSVOffset->end());
                 }
               } else {
@@ -1480,6 +1492,7 @@ private:
   CallPtrSet CrossedCallSites;
   using WorkListVector = std::vector<WorkItem>;
   WorkListVector WorkList;
+  WorkItemArena Arena;
   ConstValuePtrSet InExploration;
 
   // Helper folders
@@ -1521,6 +1534,7 @@ public:
     StoreCallSiteOffsets(),
     CrossedCallSites(),
     WorkList(),
+    Arena(),
     InExploration(),
     AddSubFolder(M),
     NumericFolder(M),
@@ -1537,6 +1551,7 @@ private:
     StoreCallSiteOffsets = {};
     CrossedCallSites = {};
     WorkList = {};
+    Arena.Reset();
     InExploration = {};
   }
 
@@ -1567,8 +1582,7 @@ private:
   /// \param [out] W a `WorkItem` that will be initialized with the unexplored
   ///                sources of `V` if any.
   /// \param IsLoad true if we're exploring from a load
-  OptCSVOffsets
-  getOffsetsOrExploreSrc(Value *V, WorkItem &W, bool IsLoad) const;
+  OptCSVOffsets getOffsetsOrExploreSrc(Value *V, WorkItem &W, bool IsLoad);
 
   void insertCallSiteOffset(Value *V, CSVOffsets &&Offset);
 
@@ -1737,7 +1751,7 @@ private:
 
   void push(WorkItem &&Item) {
     InExploration.insert(Item.Val());
-    WorkList.push_back(Item);
+    WorkList.push_back(std::move(Item));
     CSVAccessLog.indent(2);
   }
 
@@ -2010,13 +2024,18 @@ void CPUSAOA::insertCallSiteOffset(Value *V, CSVOffsets &&Offset) {
 }
 
 OptCSVOffsets
-CPUSAOA::getOffsetsOrExploreSrc(Value *V, WorkItem &Item, bool IsLoad) const {
+CPUSAOA::getOffsetsOrExploreSrc(Value *V, WorkItem &Item, bool IsLoad) {
   if (auto *Call = dyn_cast<CallInst>(V)) {
     revng_log(CSVAccessLog, "CALL: " << dumpToString(Call));
-    Item = WorkItem(Call, IsLoad, Lazy, LoadMDKind, StoreMDKind);
+    Item = WorkItem(Call, IsLoad, Lazy, LoadMDKind, StoreMDKind, Arena);
   } else if (auto *Arg = dyn_cast<Argument>(V)) {
     revng_log(CSVAccessLog, "ARG: " << dumpToString(Arg));
-    Item = WorkItem(Arg, ReachableFunctions, Lazy, LoadMDKind, StoreMDKind);
+    Item = WorkItem(Arg,
+                    ReachableFunctions,
+                    Lazy,
+                    LoadMDKind,
+                    StoreMDKind,
+                    Arena);
   } else if (auto *Instr = dyn_cast<Instruction>(V)) {
     revng_log(CSVAccessLog, "INST: " << dumpToString(Instr));
     const auto OpCode = Instr->getOpcode();
@@ -2053,7 +2072,7 @@ CPUSAOA::getOffsetsOrExploreSrc(Value *V, WorkItem &Item, bool IsLoad) const {
       break;
     }
     // If we reach this point the CSVOffsets of this instruction are not known
-    Item = WorkItem(Instr);
+    Item = WorkItem(Instr, Arena);
   } else if (const auto *IntConst = dyn_cast<const ConstantInt>(V)) {
     int64_t Offset = IntConst->getSExtValue();
     revng_log(CSVAccessLog, "CONST: " << Offset);
@@ -2065,6 +2084,14 @@ CPUSAOA::getOffsetsOrExploreSrc(Value *V, WorkItem &Item, bool IsLoad) const {
 }
 
 bool CPUSAOA::exploreImmediateSources(Value *V, bool IsLoad) {
+  // If the offsets of V have already been folded for all the active call
+  // sites, folding its sources again would give the same result
+  if (not isa<ConstantInt>(V) and not isInExploration(V)
+      and not isNewVisitWithCallSite(V, nullptr)) {
+    revng_log(CSVAccessLog, "Already folded");
+    return false;
+  }
+
   // Try to get new unexplored sources for V.
   WorkItem NewItem;
   {
@@ -2174,13 +2201,14 @@ void CPUSAOA::analyzeAccess(Instruction *LoadOrStore, bool IsLoad) {
 
   // Initialization
   if (not callsBuiltinMemcpy(LoadOrStore))
-    push(WorkItem(LoadOrStore));
+    push(WorkItem(LoadOrStore, Arena));
   else
     push(WorkItem(cast<CallInst>(LoadOrStore),
                   IsLoad,
                   Lazy,
                   LoadMDKind,
-                  StoreMDKind));
+                  StoreMDKind,
+                  Arena));
 
   while (not WorkList.empty()) {
     const auto size = WorkList.size();
@@ -2233,6 +2261,9 @@ void CPUSAOA::analyzeAccess(Instruction *LoadOrStore, bool IsLoad) {
     if (not WorkList.empty())
       selectNextSource(WorkList.back());
   }
+
+  // No WorkItem is left, their sources can go
+  Arena.Reset();
 }
 
 template<bool IsLoad>
@@ -2306,7 +2337,7 @@ void CPUSAOA::computeAggregatedOffsets() {
           New = O;
         } else {
           revng_assert(O.size());
-          std::set<int64_t> FineGrainedOffsets;
+          SmallVector<int64_t, 4> FineGrainedOffsets;
           // Now compute the fine-grained offsets
           for (const int64_t Coarse : O) {
             int64_t Refined = Coarse;
@@ -2321,7 +2352,7 @@ void CPUSAOA::computeAggregatedOffsets() {
                 Type *AccessedTy = AccessedVar->getType();
                 SizeAtOffset = DL.getTypeAllocSize(AccessedTy) - InternalOffset;
                 revng_assert(SizeAtOffset > 0);
-                FineGrainedOffsets.insert(Refined - InternalOffset);
+                FineGrainedOffsets.push_back(Refined - InternalOffset);
                 CSVAccessLog << "Value: " << I << DoLog;
                 CSVAccessLog << "Insert Refined: " << Refined << DoLog;
               } else {
@@ -3074,6 +3105,9 @@ private:
   // A reference to the associated VariableManager
   VariableManager *Variables;
 
+  // Results of previous runs, if any
+  CPUStateAccessAnalysisCache *Cache;
+
   // References to the maps that will be filled by this analysis.
   // Every map maps an Instruction to the CSVOffset representing all the
   // possible offsets that are accessed by that Instruction, being it either a
@@ -3094,10 +3128,12 @@ private:
 public:
   CPUStateAccessAnalysis(const Module &Mod,
                          VariableManager *V,
-                         const bool IsLazy) :
+                         const bool IsLazy,
+                         CPUStateAccessAnalysisCache *Cache) :
     Lazy(IsLazy),
     M(Mod),
     Variables(V),
+    Cache(Cache),
     CSVLoadOffsetMap(),
     CSVStoreOffsetMap(),
     LoadMDKind(Mod.getContext().getMDKindID("revng.csvaccess.offsets.load")),
@@ -3190,7 +3226,8 @@ bool CPUStateAccessAnalysis::run() {
   auto ReachedFunctions = computeDirectlyReachableFunctions(RootFunction,
                                                             LoadMDKind,
                                                             StoreMDKind,
-                                                            Lazy);
+                                                            Lazy,
+                                                            Cache);
   if (CSVAccessLog.isEnabled()) {
     CSVAccessLog << "====== Reachable Functions ======";
     for (const Function *F : ReachedFunctions)
@@ -3271,7 +3308,7 @@ bool CPUStateAccessAnalysis::run() {
 }
 
 bool CPUStateAccessAnalysisPass::runOnModule(Module &Mod) {
-  CPUStateAccessAnalysis AccessAnalysis(Mod, Variables, Lazy);
+  CPUStateAccessAnalysis AccessAnalysis(Mod, Variables, Lazy, Cache);
   return AccessAnalysis.run();
 }
 
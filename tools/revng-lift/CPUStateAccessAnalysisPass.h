@@ -6,7 +6,9 @@
 
 #include <map>
 #include <ostream>
+#include <set>
 
+#include "llvm/IR/ValueHandle.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/raw_ostream.h"
 
@@ -15,11 +17,30 @@
 #include "CSVOffsets.h"
 
 namespace llvm {
+class Function;
 class Instruction;
-}
+} // namespace llvm
 
 class VariableManager;
 
+/// \brief Results of CPUStateAccessAnalysisPass reusable across lazy runs
+///
+/// While lifting, only the root function changes, the helpers are left
+/// untouched. Therefore, the functions directly called by each function other
+/// than root are computed once and reused by all the subsequent runs sharing
+/// this cache.
+class CPUStateAccessAnalysisCache {
+public:
+  struct CalleesEntry {
+    /// Becomes null if the function is deleted, invalidating the entry
+    llvm::WeakVH Function;
+    std::set<const llvm::Function *> Callees;
+  };
+
+public:
+  std::map<const llvm::Function *, CalleesEntry> Callees;
+};
+
 /// \brief LLVM pass to analyze the access patterns to the CPU State Variable
 class CPUStateAccessAnalysisPass : public llvm::ModulePass {
 public:
@@ -28,16 +49,21 @@ public:
 private:
   const bool Lazy;
   VariableManager *Variables;
+  CPUStateAccessAnalysisCache *Cache;
 
 public:
   static char ID;
 
 public:
   CPUStateAccessAnalysisPass() :
-    llvm::ModulePass(ID), Lazy(false), Variables(nullptr){};
+    llvm::ModulePass(ID), Lazy(false), Variables(nullptr), Cache(nullptr){};
 
-  CPUStateAccessAnalysisPass(VariableManager *VM, bool IsLazy = false) :
-    llvm::ModulePass(ID), Lazy(IsLazy), Variables(VM){};
+  /// \param Cache if not null, results that are still valid are taken from
+  ///        here, and new ones are recorded. Meant to be shared by lazy runs.
+  CPUStateAccessAnalysisPass(VariableManager *VM,
+                             bool IsLazy = false,
+                             CPUStateAccessAnalysisCache *Cache = nullptr) :
+    llvm::ModulePass(ID), Lazy(IsLazy), Variables(VM), Cache(Cache){};
 
 public:
   virtual bool runOnModule(llvm::Module &TheModule) override;
@@ -4,17 +4,24 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
-#include <set>
+#include <algorithm>
+#include <iterator>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
 
 template<bool StaticallyEnabled>
 class Logger;
 
 /// \brief Different types of accesses to the CPU State Variables (CSVs), with a
 ///        set of possible offsets.
+///
+/// Most accesses have a handful of possible offsets, therefore they are kept
+/// sorted and without duplicates in a vector with inline storage.
 class CSVOffsets {
 
 private:
-  using OffsetSet = std::set<int64_t>;
+  using OffsetSet = llvm::SmallVector<int64_t, 4>;
 
 public:
   using iterator = OffsetSet::iterator;
@@ -64,9 +71,12 @@ public:
     // Useful for debug revng_assert(not isUnknown(K) and not
     // isUnknownInPtr(K));
   }
-  CSVOffsets(Kind K, std::set<int64_t> O) : OffsetKind(K), Offsets(O) {
+  CSVOffsets(Kind K, llvm::ArrayRef<int64_t> O) :
+    OffsetKind(K), Offsets(O.begin(), O.end()) {
     // Useful for debug revng_assert(not isUnknown(K) and not
     // isUnknownInPtr(K));
+    std::sort(Offsets.begin(), Offsets.end());
+    Offsets.erase(std::unique(Offsets.begin(), Offsets.end()), Offsets.end());
   }
 
 public:
@@ -79,8 +89,8 @@ public:
   iterator begin() { return Offsets.begin(); }
   iterator end() { return Offsets.end(); }
 
-  const_iterator begin() const { return Offsets.cbegin(); }
-  const_iterator end() const { return Offsets.cend(); }
+  const_iterator begin() const { return Offsets.begin(); }
+  const_iterator end() const { return Offsets.end(); }
 
   size_type size() const { return Offsets.size(); }
   size_type empty() const { return Offsets.empty(); }
@@ -137,13 +147,18 @@ public:
     return K;
   }
 
-  void insert(int64_t O) { Offsets.insert(O); }
+  void insert(int64_t O) {
+    auto It = std::lower_bound(Offsets.begin(), Offsets.end(), O);
+    if (It == Offsets.end() or *It != O)
+      Offsets.insert(It, O);
+  }
+
   void combine(const CSVOffsets &other) {
     Kind K0 = OffsetKind;
     Kind K1 = other.OffsetKind;
     // For equal kinds just merge the offsets
     if (K0 == K1) {
-      Offsets.insert(other.Offsets.begin(), other.Offsets.end());
+      merge(other.Offsets);
       return;
     }
 
@@ -175,7 +190,7 @@ public:
         Offsets = {};
       } else {
         OffsetKind = Kind::OutAndKnownInPtr;
-        Offsets.insert(other.Offsets.begin(), other.Offsets.end());
+        merge(other.Offsets);
       }
       return;
     }
@@ -196,4 +211,22 @@ public:
     OffsetKind = Kind::Unknown;
     Offsets = {};
   }
+
+private:
+  /// \brief Add all the offsets in \p Other, which is sorted as well
+  void merge(const OffsetSet &Other) {
+    auto Begin = Offsets.begin();
+    auto End = Offsets.end();
+    if (std::includes(Begin, End, Other.begin(), Other.end()))
+      return;
+
+    OffsetSet Merged;
+    Merged.reserve(Offsets.size() + Other.size());
+    std::set_union(Begin,
+                   End,
+                   Other.begin(),
+                   Other.end(),
+                   std::back_inserter(Merged));
+    Offsets = std::move(Merged);
+  }
 };
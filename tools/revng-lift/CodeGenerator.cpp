@@ -8,7 +8,9 @@
 
 #include <cstring>
 #include <fstream>
+#include <limits>
 #include <memory>
+#include <optional>
 #include <queue>
 #include <set>
 #include <sstream>
@@ -18,10 +20,13 @@
 
 #include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/ExecutionEngine/RuntimeDyld.h"
 #include "llvm/IR/CFG.h"
 #include "llvm/IR/DiagnosticPrinter.h"
 #include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/InlineAsm.h"
+#include "llvm/IR/InstIterator.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/MDBuilder.h"
 #include "llvm/IR/Module.h"
@@ -29,6 +34,7 @@
 #include "llvm/IRReader/IRReader.h"
 #include "llvm/Linker/Linker.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/raw_os_ostream.h"
 #include "llvm/Transforms/InstCombine/InstCombine.h"
@@ -44,14 +50,21 @@
 #include "revng/Support/Debug.h"
 #include "revng/Support/DebugHelper.h"
 #include "revng/Support/FunctionTags.h"
+#include "revng/Support/ProfilerRegion.h"
 #include "revng/Support/ProgramCounterHandler.h"
+#include "revng/Support/TracedPassManager.h"
+#include "revng/Support/Tracing.h"
 #include "revng/Support/revng.h"
 
 #include "CodeGenerator.h"
 #include "ExternalJumpsHandler.h"
 #include "InstructionTranslator.h"
 #include "JumpTargetManager.h"
+#include "LiftCache.h"
+#include "LinearSweep.h"
+#include "PTCDecoder.h"
 #include "PTCInterface.h"
+#include "ShardedLift.h"
 #include "VariableManager.h"
 
 using namespace llvm;
@@ -73,6 +86,56 @@ static cl::alias A1("c",
                     cl::aliasopt(CoveragePath),
                     cl::cat(MainCategory));
 
+static cl::opt<string> BinaryCoveragePath("binary-coverage-path",
+                                          cl::desc("destination path for the "
+                                                   "translated ranges in the "
+                                                   "compact binary format"),
+                                          cl::value_desc("path"),
+                                          cl::cat(MainCategory));
+
+static cl::opt<bool> LeanNewPC("lean-newpc",
+                               cl::desc("replace the calls to newpc with "
+                                        "metadata at the end of lifting. "
+                                        "Incompatible with tracing and with "
+                                        "the analyses inspecting each "
+                                        "instruction."),
+                               cl::cat(MainCategory),
+                               cl::init(false));
+
+static cl::opt<bool> BlockCounters("block-counters",
+                                   cl::desc("count how many times each jump "
+                                            "target is executed, requires "
+                                            "the profile support module"),
+                                   cl::cat(MainCategory),
+                                   cl::init(false));
+
+static cl::opt<bool> DirectSyscalls("direct-syscalls",
+                                    cl::desc("perform the syscalls whose "
+                                             "arguments need no conversion "
+                                             "directly, requires an x86-64 "
+                                             "input and host"),
+                                    cl::cat(MainCategory),
+                                    cl::init(false));
+
+static cl::opt<string> ProfilePath("profile",
+                                   cl::desc("execution counts of the jump "
+                                            "targets, as dumped by the "
+                                            "profile support module or by "
+                                            "revng-decode-trace, to guide the "
+                                            "layout of the generated code"),
+                                   cl::value_desc("path"),
+                                   cl::cat(MainCategory));
+
+static cl::opt<string> FastImportsPath("fast-imports",
+                                       cl::desc("list of the dynamic "
+                                                "functions to call directly, "
+                                                "one per line, as NAME "
+                                                "[ARGUMENT_REGISTER...] [-> "
+                                                "RETURN_REGISTER]. Requires an "
+                                                "x86-64 input and host."),
+                                       cl::value_desc("path"),
+                                       cl::cat(MainCategory));
+
 // TODO: linking-info-path?
 static cl::opt<string> LinkingInfoPath("linking-info",
                                        cl::desc("destination path for the CSV "
@@ -137,7 +200,64 @@ static cl::opt<bool> RecordPTC("record-ptc",
                                cl::desc("create metadata for PTC"),
                                cl::cat(MainCategory));
 
+static cl::opt<string> DebugStringsPath("debug-strings-path",
+                                        cl::desc("destination path for the "
+                                                 "strings recorded by "
+                                                 "-record-asm and -record-ptc. "
+                                                 "If set, the metadata only "
+                                                 "contains their identifier."),
+                                        cl::value_desc("path"),
+                                        cl::cat(MainCategory));
+
+static cl::opt<unsigned> DecodeAhead("decode-ahead",
+                                     cl::desc("number of pending jump targets "
+                                              "to decode in background while "
+                                              "emitting LLVM IR (0 disables)"),
+                                     cl::value_desc("count"),
+                                     cl::cat(MainCategory),
+                                     cl::init(0));
+
+static cl::opt<string> LiftCachePath("lift-cache",
+                                     cl::desc("directory where to cache the "
+                                              "jump targets found in each "
+                                              "binary across runs"),
+                                     cl::value_desc("path"),
+                                     cl::cat(MainCategory));
+
+static cl::opt<bool> ZeroCopySegments("zero-copy-segments",
+                                      cl::desc("don't copy the segments to "
+                                               "append their zero-filled "
+                                               "portion, represent it with a "
+                                               "zeroinitializer instead"),
+                                      cl::cat(MainCategory));
+
+static cl::opt<bool> ExternalSegments("external-segments",
+                                      cl::desc("declare the segments as "
+                                               "external variables and write "
+                                               "their content to "
+                                               "OUTPUT.segments.bin, along "
+                                               "with OUTPUT.segments.S, which "
+                                               "defines them"),
+                                      cl::cat(MainCategory));
+
+static cl::opt<unsigned> DispatcherTable("dispatcher-table",
+                                         cl::desc("dispatch through a lookup "
+                                                  "table if there are at "
+                                                  "least this many jump "
+                                                  "targets (0 disables)"),
+                                         cl::value_desc("count"),
+                                         cl::cat(MainCategory),
+                                         cl::init(0));
+
+static cl::opt<bool> LinearSweep("linear-sweep",
+                                 cl::desc("before the recursive exploration, "
+                                          "register as jump targets the "
+                                          "function prologues and the FDEs "
+                                          "found in the executable segments"),
+                                 cl::cat(MainCategory));
+
 static Logger<> PTCLog("ptc");
+static Logger<> ModuleSizeLog("module-size");
 
 template<typename T, typename... Args>
 inline std::array<T, sizeof...(Args)> make_array(Args &&...args) {
@@ -201,7 +321,7 @@ public:
 // Outline the destructor for the sake of privacy in the header
 CodeGenerator::~CodeGenerator() = default;
 
-static std::unique_ptr<Module> parseIR(StringRef Path, LLVMContext &Context) {
+std::unique_ptr<Module> loadModule(StringRef Path, LLVMContext &Context) {
   std::unique_ptr<Module> Result;
   SMDiagnostic Errors;
   Result = parseIRFile(Path, Errors, Context);
@@ -214,15 +334,38 @@ static std::unique_ptr<Module> parseIR(StringRef Path, LLVMContext &Context) {
   return Result;
 }
 
+std::unique_ptr<Module>
+loadHelpersModule(StringRef Path, LLVMContext &Context) {
+  std::unique_ptr<Module> Result = loadModule(Path, Context);
+  prepareHelpersModule(*Result, ptc.exception_index);
+  return Result;
+}
+
 CodeGenerator::CodeGenerator(BinaryFile &Binary,
                              Architecture &Target,
                              llvm::LLVMContext &TheContext,
                              std::string Output,
                              std::string Helpers,
                              std::string EarlyLinked) :
+  CodeGenerator(Binary,
+                Target,
+                TheContext,
+                Output,
+                loadHelpersModule(Helpers, TheContext),
+                loadModule(EarlyLinked, TheContext)) {
+}
+
+CodeGenerator::CodeGenerator(BinaryFile &Binary,
+                             Architecture &Target,
+                             llvm::LLVMContext &TheContext,
+                             std::string Output,
+                             std::unique_ptr<Module> Helpers,
+                             std::unique_ptr<Module> EarlyLinked) :
   TargetArchitecture(std::move(Target)),
   Context(TheContext),
   TheModule(new Module("top", Context)),
+  HelpersModule(std::move(Helpers)),
+  EarlyLinkedModule(std::move(EarlyLinked)),
   OutputPath(Output),
   Debug(new DebugHelper(Output, TheModule.get(), DebugInfo, DebugPath)),
   Binary(Binary) {
@@ -230,26 +373,8 @@ CodeGenerator::CodeGenerator(BinaryFile &Binary,
   OriginalInstrMDKind = Context.getMDKindID("oi");
   PTCInstrMDKind = Context.getMDKindID("pi");
 
-  HelpersModule = parseIR(Helpers, Context);
-
   TheModule->setDataLayout(HelpersModule->getDataLayout());
 
-  // Tag all global objects in HelpersModule as QEMU
-  for (GlobalVariable &G : HelpersModule->globals())
-    FunctionTags::QEMU.addTo(&G);
-
-  for (Function &F : HelpersModule->functions()) {
-    F.setDSOLocal(false);
-
-    FunctionTags::QEMU.addTo(&F);
-
-    if (F.hasFnAttribute(Attribute::NoReturn)
-        or F.getSection() == "revng_exceptional")
-      FunctionTags::Exceptional.addTo(&F);
-  }
-
-  EarlyLinkedModule = parseIR(EarlyLinked, Context);
-
   if (CoveragePath.size() == 0)
     CoveragePath = Output + ".coverage.csv";
 
@@ -291,6 +416,29 @@ CodeGenerator::CodeGenerator(BinaryFile &Binary,
     createConstGlobal("phdr_address", Binary.programHeadersAddress().address());
   }
 
+  // Zero-filled portions of the segments spanning whole pages are not
+  // emitted, support.c maps them with anonymous memory at startup. This must
+  // match the maximum page size forced at link time.
+  const uint64_t PageSize = 4096;
+  auto *Int64 = Type::getInt64Ty(Context);
+  SmallVector<Constant *, 12> ZeroSegments;
+
+  // With external segments, the module only declares the segment variables.
+  // Their content goes to a raw file, included by an assembly file defining
+  // them, so that it never becomes an LLVM constant.
+  std::ofstream SegmentsData;
+  std::ofstream SegmentsAssembly;
+  std::string SegmentsDataName;
+  uint64_t SegmentsDataSize = 0;
+  if (ExternalSegments) {
+    std::string SegmentsDataPath = OutputPath + ".segments.bin";
+    SegmentsDataName = sys::path::filename(SegmentsDataPath).str();
+    SegmentsData.open(SegmentsDataPath, std::ios::binary);
+    SegmentsAssembly.open(OutputPath + ".segments.S");
+    revng_check(SegmentsData and SegmentsAssembly,
+                "Couldn't create the segments files");
+  }
+
   for (SegmentInfo &Segment : Binary.segments()) {
     // If it's executable register it as a valid code area
     if (Segment.IsExecutable) {
@@ -319,7 +467,8 @@ CodeGenerator::CodeGenerator(BinaryFile &Binary,
       // The next page is not mapped
       if (not Found) {
         revng_check(Segment.EndVirtualAddress.address() != 0);
-        NoMoreCodeBoundaries.insert(Segment.EndVirtualAddress);
+        uint64_t Boundary = Segment.EndVirtualAddress.address();
+        NoMoreCodeBoundaries.insert(Boundary, Boundary + 1);
         const auto &Architecture = Binary.architecture();
         auto BasicBlockEndingPattern = Architecture.basicBlockEndingPattern();
         ptc.mmap(End.address(),
@@ -330,24 +479,61 @@ CodeGenerator::CodeGenerator(BinaryFile &Binary,
 
     std::string Name = Segment.generateName();
 
+    // Leave out the zero-filled pages beyond the end of the data
+    uint64_t Start = Segment.StartVirtualAddress.address();
+    uint64_t DataEnd = alignTo(Start + Segment.Data.size(), PageSize);
+    uint64_t Size = Segment.size();
+    if (Start + Size > DataEnd) {
+      Size = DataEnd - Start;
+      ZeroSegments.push_back(ConstantInt::get(Int64, DataEnd));
+      ZeroSegments.push_back(ConstantInt::get(Int64, Start + Segment.size()));
+      ZeroSegments.push_back(ConstantInt::get(Int64, Segment.IsWriteable));
+    }
+
     // Get data and size
-    auto *DataType = ArrayType::get(Uint8Ty, Segment.size());
+    Type *DataType = ArrayType::get(Uint8Ty, Size);
 
     Constant *TheData = nullptr;
-    if (Segment.size() == Segment.Data.size()) {
+    if (ExternalSegments) {
+      // The data is looked up through the assembler include path, so the
+      // files can be moved together
+      uint64_t DataSize = std::min<uint64_t>(Size, Segment.Data.size());
+      const char *Data = reinterpret_cast<const char *>(Segment.Data.data());
+      SegmentsData.write(Data, DataSize);
+
+      SegmentsAssembly << "  .section ." << Name << ",\"a"
+                       << (Segment.IsWriteable ? "w" : "") << "\",@progbits\n"
+                       << "  .globl " << Name << "\n"
+                       << Name << ":\n"
+                       << "  .incbin \"" << SegmentsDataName << "\", "
+                       << SegmentsDataSize << ", " << DataSize << "\n";
+      if (Size > DataSize)
+        SegmentsAssembly << "  .zero " << (Size - DataSize) << "\n";
+      SegmentsAssembly << "  .size " << Name << ", " << Size << "\n";
+
+      SegmentsDataSize += DataSize;
+    } else if (Size == Segment.Data.size()) {
       // Create the array directly from the mmap'd ELF
       TheData = ConstantDataArray::get(Context, Segment.Data);
+    } else if (ZeroCopySegments and Size > Segment.Data.size()) {
+      // Create the array directly from the mmap'd ELF and append the NULL
+      // bytes as a separate, zero-initialized, array
+      auto *Data = ConstantDataArray::get(Context, Segment.Data);
+      auto *ZeroType = ArrayType::get(Uint8Ty, Size - Segment.Data.size());
+      auto *Zero = ConstantAggregateZero::get(ZeroType);
+      TheData = ConstantStruct::getAnon(Context, { Data, Zero }, true);
+      DataType = TheData->getType();
     } else {
       // If we have extra data at the end we need to create a copy of the
       // segment and append the NULL bytes
-      auto FullData = std::make_unique<uint8_t[]>(Segment.size());
+      auto FullData = std::make_unique<uint8_t[]>(Size);
 
-      size_t MinSize = std::min(Segment.size(), Segment.Data.size());
+      size_t MinSize = std::min(Size, Segment.Data.size());
       ::memcpy(FullData.get(), Segment.Data.data(), MinSize);
-      if (Segment.size() > Segment.Data.size())
+      if (Size > Segment.Data.size())
         ::bzero(FullData.get() + Segment.Data.size(),
-                Segment.size() - Segment.Data.size());
-      auto DataRef = ArrayRef<uint8_t>(FullData.get(), Segment.size());
+                Size - Segment.Data.size());
+      auto DataRef = ArrayRef<uint8_t>(FullData.get(), Size);
       TheData = ConstantDataArray::get(Context, DataRef);
     }
 
@@ -370,6 +556,22 @@ CodeGenerator::CodeGenerator(BinaryFile &Binary,
                       << "\n";
   }
 
+  // Describe the zero-filled pages to support.c: for each of them, the start
+  // address, the end address and whether they are writeable
+  auto *ZeroSegmentsType = ArrayType::get(Int64, ZeroSegments.size());
+  new GlobalVariable(*TheModule,
+                     ZeroSegmentsType,
+                     true,
+                     GlobalValue::ExternalLinkage,
+                     ConstantArray::get(ZeroSegmentsType, ZeroSegments),
+                     "zero_segments");
+  new GlobalVariable(*TheModule,
+                     Int64,
+                     true,
+                     GlobalValue::ExternalLinkage,
+                     ConstantInt::get(Int64, ZeroSegments.size() / 3),
+                     "zero_segments_count");
+
   // Write needed libraries CSV
   std::string NeededLibs = OutputPath + ".need.csv";
   std::ofstream NeededLibsStream(NeededLibs);
@@ -543,6 +745,94 @@ bool CpuLoopFunctionPass::runOnModule(Module &M) {
   return true;
 }
 
+/// Named metadata marking a helpers module which has already been prepared
+static const char *PreparedHelpersMDName = "revng.prepared-helpers";
+
+void prepareHelpersModule(Module &Helpers, intptr_t ExceptionIndexOffset) {
+  if (Helpers.getNamedMetadata(PreparedHelpersMDName) != nullptr)
+    return;
+
+  // Tag all global objects in Helpers as QEMU
+  for (GlobalVariable &G : Helpers.globals())
+    FunctionTags::QEMU.addTo(&G);
+
+  for (Function &F : Helpers.functions()) {
+    F.setDSOLocal(false);
+
+    FunctionTags::QEMU.addTo(&F);
+
+    if (F.hasFnAttribute(Attribute::NoReturn)
+        or F.getSection() == "revng_exceptional")
+      FunctionTags::Exceptional.addTo(&F);
+  }
+
+  // Prepare the helper modules by transforming the cpu_loop function and
+  // running SROA
+  TracedPassManager CpuLoopPM;
+  CpuLoopPM.add(new LoopInfoWrapperPass());
+  CpuLoopPM.add(new CpuLoopFunctionPass(ExceptionIndexOffset));
+  CpuLoopPM.add(createSROAPass());
+  CpuLoopPM.run(Helpers);
+
+  // Drop the main
+  Helpers.getFunction("main")->eraseFromParent();
+
+  //
+  // Handle some specific QEMU functions as no-ops or abort
+  //
+
+  // Transform in no op
+  auto NoOpFunctionNames = make_array<const char *>("cpu_dump_state",
+                                                    "cpu_exit",
+                                                    "end_exclusive",
+                                                    "fprintf",
+                                                    "mmap_lock",
+                                                    "mmap_unlock",
+                                                    "pthread_cond_broadcast",
+                                                    "pthread_mutex_unlock",
+                                                    "pthread_mutex_lock",
+                                                    "pthread_cond_wait",
+                                                    "pthread_cond_signal",
+                                                    "process_pending_signals",
+                                                    "qemu_log_mask",
+                                                    "qemu_thread_atexit_init",
+                                                    "start_exclusive");
+  for (auto Name : NoOpFunctionNames)
+    replaceFunctionWithRet(Helpers.getFunction(Name), 0);
+
+  // Transform in abort
+
+  // do_arm_semihosting: we don't care about semihosting
+  // EmulateAll: requires access to the opcode
+  auto AbortFunctionNames = make_array<const char *>("cpu_restore_state",
+                                                     "cpu_mips_exec",
+                                                     "gdb_handlesig",
+                                                     "queue_signal",
+                                                     // syscall.c
+                                                     "do_ioctl_dm",
+                                                     "print_syscall",
+                                                     "print_syscall_ret",
+                                                     // ARM cpu_loop
+                                                     "cpu_abort",
+                                                     "do_arm_semihosting",
+                                                     "EmulateAll");
+  for (auto Name : AbortFunctionNames) {
+    Function *TheFunction = Helpers.getFunction(Name);
+    if (TheFunction != nullptr) {
+      revng_assert(Helpers.getFunction("abort") != nullptr);
+      BasicBlock *NewBody = replaceFunction(TheFunction);
+      CallInst::Create(Helpers.getFunction("abort"), {}, NewBody);
+      new UnreachableInst(Helpers.getContext(), NewBody);
+    }
+  }
+
+  replaceFunctionWithRet(Helpers.getFunction("page_check_range"), 1);
+  replaceFunctionWithRet(Helpers.getFunction("page_get_flags"),
+                         0xffffffff);
+
+  Helpers.getOrInsertNamedMetadata(PreparedHelpersMDName);
+}
+
 class CpuLoopExitPass : public llvm::ModulePass {
 public:
   static char ID;
@@ -733,8 +1023,321 @@ bool CpuLoopExitPass::runOnModule(llvm::Module &M) {
   return true;
 }
 
+/// \brief Erase the QEMU functions that, after lifting, nobody uses anymore
+///
+/// All the helpers get linked in, but only a fraction of them is actually
+/// called by the lifted code. Since they are internal, nothing else can refer
+/// to them.
+/// \brief Parse a list of "address,count" lines
+///
+/// If the count is missing, it's assumed to be one, so that a trace, i.e., a
+/// list of addresses, can be used too.
+static JumpTargetManager::ProfileCounts
+loadProfile(const JumpTargetManager &JumpTargets, const std::string &Path) {
+  std::ifstream Input(Path);
+  revng_check(Input.good(), "Couldn't open the profile");
+
+  JumpTargetManager::ProfileCounts Result;
+  unsigned Malformed = 0;
+  std::string Line;
+  while (std::getline(Input, Line)) {
+    StringRef Trimmed = StringRef(Line).trim();
+    if (Trimmed.empty())
+      continue;
+
+    auto [AddressString, CountString] = Trimmed.split(',');
+    uint64_t Address = 0;
+    uint64_t Count = 1;
+    if (AddressString.getAsInteger(0, Address)
+        or (not CountString.empty() and CountString.getAsInteger(10, Count))) {
+      ++Malformed;
+      continue;
+    }
+
+    Result[JumpTargets.fromPC(Address)] += Count;
+  }
+
+  if (Malformed != 0)
+    dbg << "Warning: ignoring " << Malformed << " malformed lines in "
+        << Path << "\n";
+
+  return Result;
+}
+
+/// \brief Parse the list of dynamic functions to call directly
+///
+/// Each line has the form `NAME [ARGUMENT_REGISTER...] [-> RETURN_REGISTER]`.
+/// Since the native function is called through the host calling convention,
+/// only prototypes taking integer arguments in the argument registers, in
+/// order, and returning an integer in the return register are accepted.
+static std::vector<FastImport>
+loadFastImports(const Architecture &Arch, const std::string &Path) {
+  using namespace model::Register;
+
+  std::ifstream Input(Path);
+  revng_check(Input.good(), "Couldn't open the list of fast imports");
+
+  // The System V x86-64 calling convention
+  const Values ArgumentRegisters[] = { rdi_x86_64, rsi_x86_64, rdx_x86_64,
+                                       rcx_x86_64, r8_x86_64,  r9_x86_64 };
+  const Values ReturnRegister = rax_x86_64;
+
+  std::vector<FastImport> Result;
+  unsigned Malformed = 0;
+  std::string Line;
+  while (std::getline(Input, Line)) {
+    StringRef Trimmed = StringRef(Line).trim();
+    if (Trimmed.empty() or Trimmed.startswith("#"))
+      continue;
+
+    auto [PrototypeString, ReturnString] = Trimmed.split("->");
+    SmallVector<StringRef, 8> Fields;
+    PrototypeString.split(Fields, ' ', -1, false);
+    ReturnString = ReturnString.trim();
+    if (Fields.empty()) {
+      ++Malformed;
+      continue;
+    }
+
+    FastImport Import;
+    Import.Name = Fields[0].str();
+    bool Valid = true;
+    for (StringRef Field : llvm::drop_begin(Fields, 1)) {
+      Values Register = fromRegisterName(Field, Arch.type());
+      size_t Index = Import.Arguments.size();
+      Valid = Valid and Index < std::size(ArgumentRegisters)
+              and Register == ArgumentRegisters[Index];
+      Import.Arguments.push_back(Register);
+    }
+
+    if (not ReturnString.empty()) {
+      Import.ReturnValue = fromRegisterName(ReturnString, Arch.type());
+      Valid = Valid and Import.ReturnValue == ReturnRegister;
+    }
+
+    if (not Valid) {
+      ++Malformed;
+      continue;
+    }
+
+    Result.push_back(std::move(Import));
+  }
+
+  if (Malformed != 0)
+    dbg << "Warning: ignoring " << Malformed << " unsupported lines in "
+        << Path << "\n";
+
+  return Result;
+}
+
+/// \brief x86-64 syscalls whose arguments don't need any conversion when the
+///        host is x86-64 too
+static const uint64_t DirectSyscallNumbers[] = {
+  0, // read
+  1, // write
+  3, // close
+  8, // lseek
+  17, // pread64
+  18, // pwrite64
+  19, // readv
+  20, // writev
+  24, // sched_yield
+  35, // nanosleep
+  39, // getpid
+  186, // gettid
+  202, // futex
+  228, // clock_gettime
+  232, // epoll_wait
+  233, // epoll_ctl
+};
+
+/// \brief Perform the simplest syscalls without going through QEMU
+///
+/// Each call to the syscall helper in \p Root is preceded by a check on the
+/// syscall number: the syscalls in DirectSyscallNumbers are performed through
+/// a `syscall` instruction, all the others through the helper, as before.
+static void emitDirectSyscalls(Function &Root,
+                               const Architecture &Arch,
+                               const ProgramCounterHandler &PCH) {
+  if (Arch.type() != Triple::x86_64) {
+    dbg << "Warning: direct syscalls are supported only on x86-64\n";
+    return;
+  }
+
+  Module *M = Root.getParent();
+  Function *SyscallHelper = M->getFunction(Arch.syscallHelper());
+  if (SyscallHelper == nullptr)
+    return;
+
+  std::vector<CallInst *> Calls;
+  for (User *U : SyscallHelper->users())
+    if (auto *Call = dyn_cast<CallInst>(U))
+      if (Call->getParent()->getParent() == &Root)
+        Calls.push_back(Call);
+
+  LLVMContext &Context = M->getContext();
+  IntegerType *Int64 = Type::getInt64Ty(Context);
+  StringRef NumberCSVName = Arch.syscallNumberRegister();
+  GlobalVariable *NumberCSV = M->getGlobalVariable(NumberCSVName);
+  revng_assert(NumberCSV != nullptr);
+
+  // The syscall number and the arguments, as mandated by the kernel ABI
+  const char *ArgumentCSVNames[] = { "rdi", "rsi", "rdx", "r10", "r8", "r9" };
+  SmallVector<Type *, 7> ArgumentsTypes(7, Int64);
+  auto *AsmType = FunctionType::get(Int64, ArgumentsTypes, false);
+  auto *Asm = InlineAsm::get(AsmType,
+                             "syscall",
+                             "={rax},{rax},{rdi},{rsi},{rdx},{r10},{r8},{r9},"
+                             "~{rcx},~{r11},~{memory},~{dirflag},~{fpsr},"
+                             "~{flags}",
+                             true,
+                             InlineAsm::AsmDialect::AD_ATT);
+
+  for (CallInst *Call : Calls) {
+    // The helper might not return
+    Instruction *Next = Call->getNextNode();
+    if (Next == nullptr or isa<UnreachableInst>(Next))
+      continue;
+
+    auto [PC, Size] = getPC(Call);
+    if (PC.isInvalid())
+      continue;
+
+    BasicBlock *Entry = Call->getParent();
+    BasicBlock *Helper = Entry->splitBasicBlock(Call, "syscall.helper");
+    BasicBlock *Done = Helper->splitBasicBlock(Next, "syscall.done");
+    BasicBlock *Direct = BasicBlock::Create(Context,
+                                            "syscall.direct",
+                                            &Root,
+                                            Helper);
+
+    // Dispatch on the syscall number
+    Entry->getTerminator()->eraseFromParent();
+    IRBuilder<> Builder(Entry);
+    Value *Number = Builder.CreateLoad(NumberCSV);
+    auto *Switch = Builder.CreateSwitch(Number, Helper);
+    for (uint64_t SyscallNumber : DirectSyscallNumbers)
+      Switch->addCase(ConstantInt::get(Int64, SyscallNumber), Direct);
+
+    // Perform the syscall and move on to the next instruction, as the helper
+    // would
+    Builder.SetInsertPoint(Direct);
+    SmallVector<Value *, 7> Arguments = { Number };
+    for (const char *Name : ArgumentCSVNames) {
+      // A CSV that is never used is always zero
+      if (GlobalVariable *CSV = M->getGlobalVariable(Name))
+        Arguments.push_back(Builder.CreateLoad(CSV));
+      else
+        Arguments.push_back(ConstantInt::get(Int64, 0));
+    }
+
+    Builder.CreateStore(Builder.CreateCall(Asm, Arguments), NumberCSV);
+    PCH.setPC(Builder, PC + Size);
+    Builder.CreateBr(Done);
+  }
+}
+
+/// \brief Erase the helpers not reachable from the rest of the module
+///
+/// Helpers are the functions and global variables imported from the helpers
+/// module. Everything else is considered alive and so is everything it
+/// references, transitively. Unlike erasing the helpers without uses, this also
+/// drops groups of helpers referencing each other, e.g., through recursion or
+/// tables of function pointers.
+static void dropDeadHelpers(Module &M) {
+  auto IsHelper = [](GlobalValue *GV) {
+    auto *GO = dyn_cast<GlobalObject>(GV);
+    return GO != nullptr and GO->hasLocalLinkage()
+           and FunctionTags::QEMU.isTagOf(GO);
+  };
+
+  std::set<GlobalValue *> Alive;
+  std::vector<GlobalValue *> WorkList;
+  std::set<Constant *> VisitedConstants;
+  auto Reference = [&](Value *V) {
+    std::vector<Value *> Pending{ V };
+    while (not Pending.empty()) {
+      Value *Current = Pending.back();
+      Pending.pop_back();
+
+      if (auto *GV = dyn_cast<GlobalValue>(Current)) {
+        if (Alive.insert(GV).second)
+          WorkList.push_back(GV);
+      } else if (auto *C = dyn_cast<Constant>(Current)) {
+        if (VisitedConstants.insert(C).second)
+          for (Value *Operand : C->operands())
+            Pending.push_back(Operand);
+      }
+    }
+  };
+
+  for (GlobalValue &GV : M.global_values())
+    if (not IsHelper(&GV))
+      Reference(&GV);
+
+  while (not WorkList.empty()) {
+    GlobalValue *GV = WorkList.back();
+    WorkList.pop_back();
+
+    if (auto *F = dyn_cast<Function>(GV)) {
+      for (Value *Operand : F->operands())
+        Reference(Operand);
+      for (Instruction &I : instructions(F))
+        for (Value *Operand : I.operands())
+          Reference(Operand);
+    } else if (auto *User = dyn_cast<llvm::User>(GV)) {
+      // Global variables (initializers), aliases and ifuncs
+      for (Value *Operand : User->operands())
+        Reference(Operand);
+    }
+  }
+
+  std::vector<GlobalObject *> Dead;
+  for (GlobalObject &GO : M.global_objects())
+    if (IsHelper(&GO) and Alive.count(&GO) == 0)
+      Dead.push_back(&GO);
+
+  // Dead helpers might reference each other, detach them first
+  for (GlobalObject *GO : Dead) {
+    if (auto *F = dyn_cast<Function>(GO))
+      F->dropAllReferences();
+    else
+      cast<GlobalVariable>(GO)->dropAllReferences();
+  }
+
+  for (GlobalObject *GO : Dead) {
+    GO->removeDeadConstantUsers();
+    revng_assert(GO->use_empty());
+    GO->eraseFromParent();
+  }
+}
+
+static void logModuleSize(const char *When, Module &M) {
+  if (not ModuleSizeLog.isEnabled())
+    return;
+
+  size_t Instructions = 0;
+  for (Function &F : M)
+    Instructions += F.getInstructionCount();
+
+  ModuleSizeLog << When << ": " << M.size() << " functions, "
+                << M.global_size() << " global variables, " << Instructions
+                << " instructions" << DoLog;
+}
+
 void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
+  SmallVector<uint64_t, 1> Entries;
+  if (RawVirtualAddress)
+    Entries.push_back(*RawVirtualAddress);
+  translate(Entries, std::numeric_limits<unsigned>::max(), 0);
+}
+
+void CodeGenerator::translate(ArrayRef<uint64_t> Entries,
+                              unsigned MaxDepth,
+                              unsigned Budget) {
   using FT = FunctionType;
+  TraceScope TranslateScope("translate");
+  ProfilerRegion TranslateRegion("translate");
 
   // Declare the abort function
   auto *AbortTy = FunctionType::get(Type::getVoidTy(Context), false);
@@ -745,17 +1348,6 @@ void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
     FunctionTags::Exceptional.addTo(Abort);
   }
 
-  // Prepare the helper modules by transforming the cpu_loop function and
-  // running SROA
-  legacy::PassManager CpuLoopPM;
-  CpuLoopPM.add(new LoopInfoWrapperPass());
-  CpuLoopPM.add(new CpuLoopFunctionPass(ptc.exception_index));
-  CpuLoopPM.add(createSROAPass());
-  CpuLoopPM.run(*HelpersModule);
-
-  // Drop the main
-  HelpersModule->getFunction("main")->eraseFromParent();
-
   // From syscall.c
   new GlobalVariable(*TheModule,
                      Type::getInt32Ty(Context),
@@ -764,59 +1356,6 @@ void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
                      ConstantInt::get(Type::getInt32Ty(Context), 0),
                      StringRef("do_strace"));
 
-  //
-  // Handle some specific QEMU functions as no-ops or abort
-  //
-
-  // Transform in no op
-  auto NoOpFunctionNames = make_array<const char *>("cpu_dump_state",
-                                                    "cpu_exit",
-                                                    "end_exclusive"
-                                                    "fprintf",
-                                                    "mmap_lock",
-                                                    "mmap_unlock",
-                                                    "pthread_cond_broadcast",
-                                                    "pthread_mutex_unlock",
-                                                    "pthread_mutex_lock",
-                                                    "pthread_cond_wait",
-                                                    "pthread_cond_signal",
-                                                    "process_pending_signals",
-                                                    "qemu_log_mask",
-                                                    "qemu_thread_atexit_init",
-                                                    "start_exclusive");
-  for (auto Name : NoOpFunctionNames)
-    replaceFunctionWithRet(HelpersModule->getFunction(Name), 0);
-
-  // Transform in abort
-
-  // do_arm_semihosting: we don't care about semihosting
-  // EmulateAll: requires access to the opcode
-  auto AbortFunctionNames = make_array<const char *>("cpu_restore_state",
-                                                     "cpu_mips_exec",
-                                                     "gdb_handlesig",
-                                                     "queue_signal",
-                                                     // syscall.c
-                                                     "do_ioctl_dm",
-                                                     "print_syscall",
-                                                     "print_syscall_ret",
-                                                     // ARM cpu_loop
-                                                     "cpu_abort",
-                                                     "do_arm_semihosting",
-                                                     "EmulateAll");
-  for (auto Name : AbortFunctionNames) {
-    Function *TheFunction = HelpersModule->getFunction(Name);
-    if (TheFunction != nullptr) {
-      revng_assert(HelpersModule->getFunction("abort") != nullptr);
-      BasicBlock *NewBody = replaceFunction(TheFunction);
-      CallInst::Create(HelpersModule->getFunction("abort"), {}, NewBody);
-      new UnreachableInst(Context, NewBody);
-    }
-  }
-
-  replaceFunctionWithRet(HelpersModule->getFunction("page_check_range"), 1);
-  replaceFunctionWithRet(HelpersModule->getFunction("page_get_flags"),
-                         0xffffffff);
-
   //
   // Record globals for marking them as internal after linking
   //
@@ -838,6 +1377,9 @@ void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
   bool Result = TheLinker.linkInModule(std::move(HelpersModule));
   revng_assert(not Result, "Linking failed");
 
+  if (auto *Prepared = TheModule->getNamedMetadata(PreparedHelpersMDName))
+    TheModule->eraseNamedMetadata(Prepared);
+
   //
   // Mark as internal all the imported globals
   //
@@ -856,12 +1398,13 @@ void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
   // Create the VariableManager
   //
   VariableManager Variables(*TheModule, TargetArchitecture);
-  auto createCPUStateAccessAnalysisPass = [&Variables]() {
-    return new CPUStateAccessAnalysisPass(&Variables, true);
+  CPUStateAccessAnalysisCache CSAACache;
+  auto createCPUStateAccessAnalysisPass = [&Variables, &CSAACache]() {
+    return new CPUStateAccessAnalysisPass(&Variables, true, &CSAACache);
   };
 
   {
-    legacy::PassManager PM;
+    TracedPassManager PM;
     PM.add(new CpuLoopExitPass(&Variables));
     PM.run(*TheModule);
   }
@@ -991,9 +1534,27 @@ void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
                                 Binary,
                                 createCPUStateAccessAnalysisPass);
 
+  bool Restricted = (MaxDepth != std::numeric_limits<unsigned>::max()
+                     or Budget != 0);
+  revng_assert(not Restricted or not Entries.empty());
+  if (Restricted)
+    JumpTargets.restrictExploration(MaxDepth, Budget);
+
+  if (Shard != nullptr) {
+    auto Exchange = [this, &JumpTargets]() {
+      return Shard->exchange(JumpTargets);
+    };
+    JumpTargets.restrictToShard(ShardStart, ShardEnd, Exchange);
+  }
+
   MetaAddress VirtualAddress = MetaAddress::invalid();
-  if (RawVirtualAddress) {
-    VirtualAddress = JumpTargets.fromPC(*RawVirtualAddress);
+  if (not Entries.empty()) {
+    for (uint64_t RawEntry : Entries.drop_front()) {
+      MetaAddress Entry = JumpTargets.fromPC(RawEntry);
+      if (Entry.isValid())
+        JumpTargets.registerJT(Entry, JTReason::GlobalData);
+    }
+    VirtualAddress = JumpTargets.fromPC(Entries.front());
   } else {
     JumpTargets.harvestGlobalData();
     VirtualAddress = Binary.entryPoint();
@@ -1007,6 +1568,29 @@ void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
     PCH->initializePC(Builder, VirtualAddress);
   }
 
+  // Seed the jump targets with those found by a previous run on the same
+  // binary, if any
+  StringRef HelpersName = HelpersModule->getModuleIdentifier();
+  std::string CacheOptions = sys::path::filename(HelpersName).str();
+  for (uint64_t RawEntry : Entries)
+    CacheOptions += ",entry=" + std::to_string(RawEntry);
+  if (Restricted) {
+    CacheOptions += ",depth=" + std::to_string(MaxDepth);
+    CacheOptions += ",budget=" + std::to_string(Budget);
+  }
+  if (LinearSweep)
+    CacheOptions += ",linear-sweep";
+
+  // A shard only sees part of the jump targets, keep it away from the cache
+  StringRef CachePath = Shard == nullptr ? StringRef(LiftCachePath) : "";
+  LiftCache Cache(CachePath, Binary, CacheOptions);
+  for (const auto &[PC, Reasons] : Cache.load())
+    JumpTargets.registerJTWithReasons(PC, Reasons);
+
+  // Seed the jump targets found by the shards, if any
+  for (const auto &[PC, Reasons] : Seeds)
+    JumpTargets.registerJTWithReasons(PC, Reasons);
+
   OpaqueIdentity OI(TheModule.get());
 
   // Fake jumps to the dispatcher-related basic blocks. This way all the blocks
@@ -1018,17 +1602,36 @@ void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
 
   JumpTargets.setCFGForm(CFGForm::SemanticPreserving);
 
+  PTCDecoder Decoder(DecodeAhead);
+
+  // Seed the jump targets with the likely function entries, so that fewer
+  // harvesting rounds are necessary
+  if (LinearSweep and Entries.empty()) {
+    TraceScope Scope("linear sweep");
+    for (MetaAddress PC : sweepExecutableSegments(Binary, Decoder))
+      JumpTargets.registerJT(PC, JTReason::LinearSweep);
+  }
+
   std::tie(VirtualAddress, Entry) = JumpTargets.peek();
 
   std::vector<BasicBlock *> Blocks;
 
+  DebugStrings::Writer StringsWriter;
+  DebugStrings::Writer *Strings = nullptr;
+  if (not DebugStringsPath.empty())
+    Strings = &StringsWriter;
+
   InstructionTranslator Translator(Builder,
                                    Variables,
                                    JumpTargets,
                                    Blocks,
                                    Binary.architecture(),
                                    TargetArchitecture,
-                                   PCH.get());
+                                   PCH.get(),
+                                   Strings);
+
+  std::optional<TraceScope> LoopScope;
+  LoopScope.emplace("translation loop");
 
   while (Entry != nullptr) {
     Builder.SetInsertPoint(Entry);
@@ -1037,39 +1640,20 @@ void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
     Translator.reset();
 
     // TODO: rename this type
-    PTCInstructionListPtr InstructionList(new PTCInstructionList);
-    size_t ConsumedSize = 0;
-
-    PTCCodeType Type = PTC_CODE_REGULAR;
-
-    switch (VirtualAddress.type()) {
-    case MetaAddressType::Invalid:
-      revng_abort();
-
-    case MetaAddressType::Code_arm_thumb:
-      Type = PTC_CODE_ARM_THUMB;
-      break;
-
-    default:
-      Type = PTC_CODE_REGULAR;
-      break;
-    }
-
-    ConsumedSize = ptc.translate(VirtualAddress.address(),
-                                 Type,
-                                 InstructionList.get());
+    PTCDecoder::DecodedBlock Decoded = Decoder.decode(VirtualAddress);
+    PTCInstructionListPtr InstructionList = std::move(Decoded.Instructions);
+    size_t ConsumedSize = Decoded.ConsumedSize;
 
     // Check whether we ended up in an unmapped page
     MetaAddress AbortAt = MetaAddress::invalid();
     MetaAddress LastByte = VirtualAddress.toGeneric() + (ConsumedSize - 1);
     if (VirtualAddress.pageStart() != LastByte.pageStart()) {
       MetaAddress NextPage = VirtualAddress.nextPageStart();
-      if (NoMoreCodeBoundaries.count(NextPage) != 0)
+      if (NoMoreCodeBoundaries.contains(NextPage.address()))
         AbortAt = NextPage;
     }
 
-    SmallSet<unsigned, 1> ToIgnore;
-    ToIgnore = Translator.preprocess(InstructionList.get());
+    auto Boundaries = Translator.preprocess(InstructionList.get());
 
     if (PTCLog.isEnabled()) {
       std::stringstream Stream;
@@ -1093,14 +1677,7 @@ void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
     // Handle the first PTC_INSTRUCTION_op_debug_insn_start
     {
       PTCInstruction *NextInstruction = nullptr;
-      for (unsigned k = 1; k < InstructionCount; k++) {
-        PTCInstruction *I = &InstructionList->instructions[k];
-        if (I->opc == PTC_INSTRUCTION_op_debug_insn_start
-            && ToIgnore.count(k) == 0) {
-          NextInstruction = I;
-          break;
-        }
-      }
+      NextInstruction = Boundaries.nextInstruction(InstructionList.get(), j);
       PTCInstruction *Instruction = &InstructionList->instructions[j];
       std::tie(Result,
                MDOriginalInstr,
@@ -1116,7 +1693,7 @@ void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
 
     // TODO: shall we move this whole loop in InstructionTranslator?
     for (; j < InstructionCount && !StopTranslation; j++) {
-      if (ToIgnore.count(j) != 0)
+      if (Boundaries.isIgnored(j))
         continue;
 
       PTCInstruction Instruction = InstructionList->instructions[j];
@@ -1132,14 +1709,7 @@ void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
       case PTC_INSTRUCTION_op_debug_insn_start: {
         // Find next instruction, if there is one
         PTCInstruction *NextInstruction = nullptr;
-        for (unsigned k = j + 1; k < InstructionCount; k++) {
-          PTCInstruction *I = &InstructionList->instructions[k];
-          if (I->opc == PTC_INSTRUCTION_op_debug_insn_start
-              && ToIgnore.count(k) == 0) {
-            NextInstruction = I;
-            break;
-          }
-        }
+        NextInstruction = Boundaries.nextInstruction(InstructionList.get(), j);
 
         std::tie(Result,
                  MDOriginalInstr,
@@ -1191,8 +1761,14 @@ void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
         std::stringstream PTCStringStream;
         dumpInstruction(PTCStringStream, InstructionList.get(), j);
         std::string PTCString = PTCStringStream.str() + "\n";
-        MDString *MDPTCString = MDString::get(Context, PTCString);
-        MDPTCInstr = MDNode::getDistinct(Context, MDPTCString);
+        if (Strings != nullptr) {
+          uint64_t Identifier = Strings->add(PTCString);
+          Constant *MDIdentifier = Builder.getInt64(Identifier);
+          MDPTCInstr = MDNode::get(Context, QMD.get(MDIdentifier));
+        } else {
+          MDString *MDPTCString = MDString::get(Context, PTCString);
+          MDPTCInstr = MDNode::getDistinct(Context, MDPTCString);
+        }
       }
 
       // Set metadata for all the new instructions
@@ -1203,6 +1779,7 @@ void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
             I->setMetadata(OriginalInstrMDKind, MDOriginalInstr);
           if (MDPTCInstr != nullptr)
             I->setMetadata(PTCInstrMDKind, MDPTCInstr);
+          JumpTargets.setCSVAliasScopes(*I);
         }
       }
 
@@ -1222,10 +1799,23 @@ void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
 
     // Obtain a new program counter to translate
     std::tie(VirtualAddress, Entry) = JumpTargets.peek();
+
+    // Start decoding what's likely to come next
+    Decoder.prefetch(JumpTargets.upcoming(DecodeAhead));
   } // End translations loop
 
+  LoopScope.reset();
+
+  Cache.store(JumpTargets);
+
   OI.drop();
 
+  // A shard only contributes the jump targets it found
+  if (Shard != nullptr) {
+    Shard->finish(JumpTargets);
+    return;
+  }
+
   // Reorder basic blocks in RPOT
   {
     BasicBlock *Entry = &MainFunction->getEntryBlock();
@@ -1299,50 +1889,130 @@ void CodeGenerator::translate(Optional<uint64_t> RawVirtualAddress) {
 
   Variables.setDataLayout(&TheModule->getDataLayout());
 
-  Translator.finalizeNewPCMarkers(CoveragePath);
+  Translator.finalizeNewPCMarkers(CoveragePath, BinaryCoveragePath);
 
   // SROA must run before InstCombine because in this way InstCombine has many
   // more elementary operations to combine
-  legacy::PassManager PreInstCombinePM;
-  PreInstCombinePM.add(createSROAPass());
-  PreInstCombinePM.run(*TheModule);
+  {
+    TraceScope Scope("SROA");
+    TracedPassManager PreInstCombinePM;
+    PreInstCombinePM.add(createSROAPass());
+    PreInstCombinePM.run(*TheModule);
+  }
 
   // InstCombine must run before CPUStateAccessAnalysis (CSAA) because, if it
   // runs after it, it removes all the useful metadata attached by CSAA.
-  legacy::FunctionPassManager InstCombinePM(&*TheModule);
-  InstCombinePM.add(createInstructionCombiningPass());
-  InstCombinePM.doInitialization();
-  InstCombinePM.run(*MainFunction);
-  InstCombinePM.doFinalization();
-
-  legacy::PassManager PostInstCombinePM;
-  PostInstCombinePM.add(new CPUStateAccessAnalysisPass(&Variables, false));
-  PostInstCombinePM.add(createDeadCodeEliminationPass());
-  PostInstCombinePM.add(new PruneRetSuccessors);
-  PostInstCombinePM.run(*TheModule);
+  {
+    TraceScope Scope("InstCombine");
+    legacy::FunctionPassManager InstCombinePM(&*TheModule);
+    InstCombinePM.add(createInstructionCombiningPass());
+    InstCombinePM.doInitialization();
+    InstCombinePM.run(*MainFunction);
+    InstCombinePM.doFinalization();
+  }
+
+  {
+    TraceScope Scope("CSAA + DCE + PruneRetSuccessors");
+    TracedPassManager PostInstCombinePM;
+    PostInstCombinePM.add(new CPUStateAccessAnalysisPass(&Variables, false));
+    PostInstCombinePM.add(createDeadCodeEliminationPass());
+    PostInstCombinePM.add(new PruneRetSuccessors);
+    PostInstCombinePM.run(*TheModule);
+  }
 
   // Serialize an empty Model into TheModule
   model::Binary Model;
+  Model.PartialLifting = JumpTargets.isPartial();
   writeModel(Model, *TheModule);
 
+  // Export the ranges of memory read by the code for the downstream passes
+  {
+    std::string Buffer;
+    raw_string_ostream Stream(Buffer);
+    JumpTargets.readRange().serialize(Stream);
+    Stream.flush();
+
+    auto *ReadRangesMD = TheModule->getOrInsertNamedMetadata(ReadRangesMDName);
+    ReadRangesMD->addOperand(MDTuple::get(Context,
+                                          { MDString::get(Context, Buffer) }));
+  }
+
   JumpTargets.finalizeJumpTargets();
 
   EliminateUnreachableBlocks(*MainFunction, nullptr, false);
 
   JumpTargets.createJTReasonMD();
 
+  if (BlockCounters)
+    JumpTargets.createBlockCounters();
+
+  if (DirectSyscalls)
+    emitDirectSyscalls(*MainFunction, Binary.architecture(), *PCH);
+
+  std::vector<FastImport> FastImports;
+  if (not FastImportsPath.empty())
+    FastImports = loadFastImports(Binary.architecture(), FastImportsPath);
+
   ExternalJumpsHandler JumpOutHandler(Binary,
                                       JumpTargets.dispatcher(),
                                       *MainFunction,
-                                      PCH.get());
+                                      PCH.get(),
+                                      FastImports);
+  JumpOutHandler.bypassImportStubs(JumpTargets);
   JumpOutHandler.createExternalJumpsHandler();
 
+  if (not ProfilePath.empty())
+    JumpTargets.applyProfile(loadProfile(JumpTargets, ProfilePath));
+
+  // The dispatcher won't change anymore, we can now make it faster
+  if (DispatcherTable != 0) {
+    auto *Root = cast<SwitchInst>(JumpTargets.dispatcher()->getTerminator());
+    PCH->addTableToDispatcher(Root,
+                              DispatcherTable,
+                              BlockType::RootDispatcherHelperBlock);
+  }
+
+  if (LeanNewPC)
+    Translator.replaceNewPCMarkersWithMetadata();
+
+  // Drop the dead weight before finalizing the CSVs, so that the CSVs used
+  // only by dead helpers can go too
+  {
+    TraceScope Scope("Drop dead helpers and CSVs");
+    logModuleSize("Before dropping dead helpers and CSVs", *TheModule);
+
+    dropDeadHelpers(*TheModule);
+
+    // The ABI registers must be there even if the code never touches them
+    std::set<StringRef> ABICSVs;
+    for (const ABIRegister &Register : TargetArchitecture.abiRegisters())
+      ABICSVs.insert(Register.csvName());
+    ABICSVs.insert(TargetArchitecture.stackPointerRegister());
+    Variables.dropUnusedCSVs(ABICSVs);
+
+    logModuleSize("After dropping dead helpers and CSVs", *TheModule);
+  }
+
   Variables.finalize();
 
+  if (Strings != nullptr) {
+    std::error_code EC = Strings->write(DebugStringsPath);
+    revng_check(not EC, "Couldn't write the debug strings");
+    Debug->loadStrings(DebugStringsPath);
+  }
+
   Debug->generateDebugInfo();
 }
 
 void CodeGenerator::serialize() {
+  // Bitcode is much faster to write and to parse than textual LLVM IR
+  if (sys::path::extension(OutputPath) == ".bc") {
+    std::ofstream Output(OutputPath, std::ios::binary);
+    raw_os_ostream Stream(Output);
+    WriteBitcodeToFile(*TheModule, Stream);
+    return;
+  }
+
   // Ask the debug handler if it already has a good copy of the IR, if not dump
   // it
   if (!Debug->copySource()) {
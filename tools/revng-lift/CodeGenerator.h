@@ -5,11 +5,13 @@
 //
 
 #include <cstdint>
+#include <map>
 #include <memory>
 #include <string>
 
 #include "llvm/ADT/ArrayRef.h"
 
+#include "revng/ADT/IntervalSet.h"
 #include "revng/Support/revng.h"
 
 #include "BinaryFile.h"
@@ -32,6 +34,27 @@ class ObjectFile;
 }; // namespace llvm
 
 class DebugHelper;
+class ShardChannel;
+
+/// \brief Transform the QEMU helpers module so that it can be linked in the
+///        module produced by CodeGenerator
+///
+/// The result doesn't depend on the input binary, so it can be prepared once
+/// for each architecture and then loaded directly. Modules that have already
+/// been prepared are left untouched.
+///
+/// \param ExceptionIndexOffset offset of `exception_index` in the CPU state.
+void prepareHelpersModule(llvm::Module &Helpers, intptr_t ExceptionIndexOffset);
+
+/// \brief Parse the LLVM IR or bitcode file at \p Path, abort on failure
+std::unique_ptr<llvm::Module>
+loadModule(llvm::StringRef Path, llvm::LLVMContext &Context);
+
+/// \brief Load the QEMU helpers module at \p Path and prepare it
+///
+/// \note The PTC interface must have been initialized.
+std::unique_ptr<llvm::Module>
+loadHelpersModule(llvm::StringRef Path, llvm::LLVMContext &Context);
 
 /// Translator from binary code to LLVM IR.
 class CodeGenerator {
@@ -51,6 +74,18 @@ public:
                 std::string Helpers,
                 std::string EarlyLinked);
 
+  /// Create a new code generator employing modules that have already been
+  /// loaded in \p TheContext
+  ///
+  /// \param Helpers the QEMU helpers module, as produced by loadHelpersModule.
+  /// \param EarlyLinked the module to link before lifting.
+  CodeGenerator(BinaryFile &Binary,
+                Architecture &Target,
+                llvm::LLVMContext &TheContext,
+                std::string Output,
+                std::unique_ptr<llvm::Module> Helpers,
+                std::unique_ptr<llvm::Module> EarlyLinked);
+
   ~CodeGenerator();
 
   /// \brief Creates an LLVM function for the code in the specified memory area.
@@ -60,6 +95,39 @@ public:
   /// \param VirtualAddress the address from where the translation should start.
   void translate(llvm::Optional<uint64_t> RawVirtualAddress);
 
+  /// \brief Translate only the code reachable from the given entry points
+  ///
+  /// The jump targets beyond the limits are not translated, jumping there will
+  /// lead to the dispatcher and then to `unknownPC`.
+  ///
+  /// \param Entries the addresses of the entry points, execution starts from
+  ///        the first one. If empty, the whole binary is translated.
+  /// \param MaxDepth the maximum number of jump targets between an entry point
+  ///        and a jump target to translate.
+  /// \param Budget the maximum number of jump targets to translate, 0 for no
+  ///        limit.
+  void translate(llvm::ArrayRef<uint64_t> Entries,
+                 unsigned MaxDepth,
+                 unsigned Budget);
+
+  /// \brief Make translate explore only the jump targets in [\p Start,
+  ///        \p End), exchanging the others with the other shards through
+  ///        \p Channel
+  ///
+  /// translate stops as soon as the exploration is over, the module is
+  /// discarded. See exploreSharded.
+  void exploreShard(ShardChannel &Channel, uint64_t Start, uint64_t End) {
+    Shard = &Channel;
+    ShardStart = Start;
+    ShardEnd = End;
+  }
+
+  /// \brief Register \p JumpTargets, along with the bitmask of their reasons,
+  ///        before starting the translation
+  void seedJumpTargets(std::map<MetaAddress, uint32_t> JumpTargets) {
+    Seeds = std::move(JumpTargets);
+  }
+
   /// Serialize the generated LLVM IR to the specified output path.
   void serialize();
 
@@ -93,5 +161,11 @@ private:
 
   std::string FunctionListPath;
 
-  std::set<MetaAddress> NoMoreCodeBoundaries;
+  /// Addresses of the pages following the end of code, as one-byte intervals
+  IntervalSet NoMoreCodeBoundaries;
+
+  ShardChannel *Shard = nullptr;
+  uint64_t ShardStart = 0;
+  uint64_t ShardEnd = 0;
+  std::map<MetaAddress, uint32_t> Seeds;
 };
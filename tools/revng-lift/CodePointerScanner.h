@@ -0,0 +1,151 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/MathExtras.h"
+
+#include "revng/Support/Assert.h"
+#include "revng/Support/MetaAddress.h"
+
+/// \brief Find the pointer-sized values in global data that might point to code
+///
+/// The scan considers a value at each byte offset. Each block of offsets is
+/// first checked, without any branch, against the smallest interval including
+/// all the executable ranges, then the few survivors are checked against the
+/// actual ranges.
+///
+/// The scanner is stateless, therefore different portions of data can be
+/// scanned concurrently.
+///
+/// \note The result is a superset of the actual code pointers, e.g., on ARM a
+///       value is a candidate also if it's the address of Thumb code with the
+///       LSB set. Candidates still have to go through MetaAddress::fromPC.
+class CodePointerScanner {
+public:
+  using RangesVector = std::vector<std::pair<MetaAddress, MetaAddress>>;
+  /// Offset of a candidate and its value
+  using Candidate = std::pair<size_t, uint64_t>;
+
+private:
+  static constexpr size_t BlockSize = 64;
+
+private:
+  std::vector<std::pair<uint64_t, uint64_t>> Ranges;
+  uint64_t Min = 0;
+  uint64_t Span = 0;
+  unsigned PointerSize;
+  bool IsLittleEndian;
+
+public:
+  /// \param PointerSize the size of a pointer, in bytes
+  CodePointerScanner(const RangesVector &ExecutableRanges,
+                     unsigned PointerSize,
+                     bool IsLittleEndian) :
+    PointerSize(PointerSize), IsLittleEndian(IsLittleEndian) {
+    revng_assert(PointerSize == 4 or PointerSize == 8);
+
+    for (const auto &[Start, End] : ExecutableRanges)
+      Ranges.emplace_back(Start.address(), End.address());
+    std::sort(Ranges.begin(), Ranges.end());
+
+    if (not Ranges.empty()) {
+      Min = Ranges.front().first;
+      uint64_t Max = 0;
+      for (const auto &Range : Ranges)
+        Max = std::max(Max, Range.second);
+
+      // Include Max, which can be the end of a range with the LSB set
+      Span = Max - Min;
+    }
+  }
+
+public:
+  /// \return the number of offsets of \p Data to scan
+  size_t positions(llvm::ArrayRef<uint8_t> Data) const {
+    return Data.size() > PointerSize ? Data.size() - PointerSize : 0;
+  }
+
+  /// \brief Scan the offsets of \p Data in [\p Begin, \p End)
+  ///
+  /// \return the candidates, in increasing order of offset
+  std::vector<Candidate>
+  scan(llvm::ArrayRef<uint8_t> Data, size_t Begin, size_t End) const {
+    using namespace llvm::support;
+
+    revng_assert(Begin <= End and End <= positions(Data));
+
+    std::vector<Candidate> Result;
+    if (Ranges.empty())
+      return Result;
+
+    const uint8_t *Start = Data.data();
+    if (PointerSize == 8) {
+      if (IsLittleEndian)
+        scan<uint64_t, little>(Start, Begin, End, Result);
+      else
+        scan<uint64_t, big>(Start, Begin, End, Result);
+    } else {
+      if (IsLittleEndian)
+        scan<uint32_t, little>(Start, Begin, End, Result);
+      else
+        scan<uint32_t, big>(Start, Begin, End, Result);
+    }
+
+    return Result;
+  }
+
+private:
+  bool contains(uint64_t Value) const {
+    auto Compare = [](uint64_t Value, const std::pair<uint64_t, uint64_t> &R) {
+      return Value < R.first;
+    };
+    auto It = std::upper_bound(Ranges.begin(), Ranges.end(), Value, Compare);
+    if (It == Ranges.begin())
+      return false;
+
+    --It;
+    return Value < It->second;
+  }
+
+  bool isCandidate(uint64_t Value) const {
+    return contains(Value) or contains(Value & ~static_cast<uint64_t>(1));
+  }
+
+  template<typename T, llvm::support::endianness E>
+  void scan(const uint8_t *Data,
+            size_t Begin,
+            size_t End,
+            std::vector<Candidate> &Result) const {
+    using llvm::support::endian::read;
+
+    for (size_t Position = Begin; Position < End; Position += BlockSize) {
+      size_t Count = std::min(BlockSize, End - Position);
+      const uint8_t *Block = Data + Position;
+
+      // Branch-free, so that the compiler can vectorize it
+      uint64_t Mask = 0;
+      for (size_t I = 0; I < Count; ++I) {
+        uint64_t Value = read<T, E, 1>(Block + I);
+        Mask |= static_cast<uint64_t>(Value - Min <= Span) << I;
+      }
+
+      while (Mask != 0) {
+        unsigned I = llvm::countTrailingZeros(Mask);
+        Mask &= Mask - 1;
+
+        uint64_t Value = read<T, E, 1>(Block + I);
+        if (isCandidate(Value))
+          Result.emplace_back(Position + I, Value);
+      }
+    }
+  }
+};
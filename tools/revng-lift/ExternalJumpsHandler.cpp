@@ -24,6 +24,7 @@
 
 #include "BinaryFile.h"
 #include "ExternalJumpsHandler.h"
+#include "JumpTargetManager.h"
 
 using namespace llvm;
 using std::string;
@@ -93,7 +94,8 @@ BasicBlock *ExternalJumpsHandler::createReturnFromExternal() {
 ExternalJumpsHandler::ExternalJumpsHandler(BinaryFile &TheBinary,
                                            BasicBlock *Dispatcher,
                                            Function &TheFunction,
-                                           ProgramCounterHandler *PCH) :
+                                           ProgramCounterHandler *PCH,
+                                           ArrayRef<FastImport> FastImports) :
   Context(getContext(&TheFunction)),
   QMD(Context),
   TheModule(*TheFunction.getParent()),
@@ -101,7 +103,8 @@ ExternalJumpsHandler::ExternalJumpsHandler(BinaryFile &TheBinary,
   TheBinary(TheBinary),
   Arch(TheBinary.architecture()),
   Dispatcher(Dispatcher),
-  PCH(PCH) {
+  PCH(PCH),
+  FastImports(FastImports) {
 }
 
 BasicBlock *ExternalJumpsHandler::createSerializeAndJumpOut() {
@@ -226,6 +229,210 @@ void ExternalJumpsHandler::buildExecutableSegmentsList() {
                      "segments_count");
 }
 
+std::map<StringRef, std::set<uint64_t>>
+ExternalJumpsHandler::importSlots() const {
+  unsigned PointerSize = Arch.pointerSize() / 8;
+  std::map<StringRef, std::set<uint64_t>> Result;
+  for (auto &P : TheBinary.labels())
+    for (const Label *L : P.second)
+      if (L->isSymbolRelativeValue() and L->offset() == 0
+          and L->size() == PointerSize)
+        Result[L->symbolName()].insert(L->address().address());
+  return Result;
+}
+
+FunctionType *
+ExternalJumpsHandler::fastImportType(const FastImport &Import) const {
+  IntegerType *Int64 = Type::getInt64Ty(Context);
+  Type *ReturnType = Int64;
+  if (Import.ReturnValue == model::Register::Invalid)
+    ReturnType = Type::getVoidTy(Context);
+  SmallVector<Type *, 6> ArgumentsTypes(Import.Arguments.size(), Int64);
+  return FunctionType::get(ReturnType, ArgumentsTypes, false);
+}
+
+BasicBlock *ExternalJumpsHandler::createFastImportCall(const FastImport &Import,
+                                                       FunctionCallee Callee) {
+  using namespace model::Register;
+
+  BasicBlock *Result = BasicBlock::Create(Context,
+                                          "fast_import." + Import.Name,
+                                          &TheFunction);
+  IRBuilder<> Builder(Result);
+  IntegerType *Int64 = Builder.getInt64Ty();
+
+  // Load the arguments from the CSVs, the native calling convention will take
+  // care of putting them in the right registers
+  SmallVector<Value *, 6> Arguments;
+  for (Values Register : Import.Arguments) {
+    // A CSV that is never used is always zero
+    auto CSVName = ABIRegister::toCSVName(Register);
+    if (GlobalVariable *CSV = TheModule.getGlobalVariable(CSVName))
+      Arguments.push_back(Builder.CreateLoad(CSV));
+    else
+      Arguments.push_back(ConstantInt::get(Int64, 0));
+  }
+
+  CallInst *Call = Builder.CreateCall(Callee, Arguments);
+
+  if (Import.ReturnValue != Invalid) {
+    auto CSVName = ABIRegister::toCSVName(Import.ReturnValue);
+    if (GlobalVariable *CSV = TheModule.getGlobalVariable(CSVName))
+      Builder.CreateStore(Call, CSV);
+  }
+
+  // Pop the return address pushed by the caller and resume from there
+  auto *SP = TheModule.getGlobalVariable(Arch.stackPointerRegister());
+  revng_assert(SP != nullptr);
+  Value *SPValue = Builder.CreateLoad(SP);
+  Value *ReturnAddressPointer = Builder.CreateIntToPtr(SPValue,
+                                                       Int64->getPointerTo());
+  Value *ReturnAddress = Builder.CreateLoad(ReturnAddressPointer);
+  unsigned PointerSize = Arch.pointerSize() / 8;
+  Builder.CreateStore(Builder.CreateAdd(SPValue,
+                                        ConstantInt::get(Int64, PointerSize)),
+                      SP);
+  PCH->setPCFromValue(Builder, ReturnAddress);
+
+  Instruction *T = Builder.CreateBr(Dispatcher);
+  setBlockType(T, BlockType::ExternalJumpsHandlerBlock);
+
+  return Result;
+}
+
+BasicBlock *ExternalJumpsHandler::createFastImports(BasicBlock *SlowPath) {
+  if (FastImports.empty())
+    return SlowPath;
+
+  if (Arch.type() != Triple::x86_64) {
+    dbg << "Warning: fast imports are supported only on x86-64\n";
+    return SlowPath;
+  }
+
+  std::map<StringRef, std::set<uint64_t>> Slots = importSlots();
+
+  BasicBlock *Entry = BasicBlock::Create(Context,
+                                         "dispatcher.fast_imports",
+                                         &TheFunction);
+  IRBuilder<> Builder(Entry);
+  IntegerType *Int64 = Builder.getInt64Ty();
+  Value *PC = PCH->loadJumpablePC(Builder);
+
+  // Build a chain of comparisons against the GOT entries, which are filled in
+  // by the dynamic loader
+  for (const FastImport &Import : FastImports) {
+    auto It = Slots.find(Import.Name);
+    if (It == Slots.end())
+      continue;
+
+    FunctionType *CalleeType = fastImportType(Import);
+    Value *Callee = Builder.CreateIntToPtr(PC, CalleeType->getPointerTo());
+    BasicBlock *Call = createFastImportCall(Import, { CalleeType, Callee });
+    for (uint64_t Slot : It->second) {
+      auto *SlotPointer = ConstantExpr::getIntToPtr(ConstantInt::get(Int64,
+                                                                     Slot),
+                                                    Int64->getPointerTo());
+      Value *IsImport = Builder.CreateICmpEQ(PC,
+                                             Builder.CreateLoad(SlotPointer));
+      BasicBlock *Next = BasicBlock::Create(Context,
+                                            "dispatcher.fast_imports",
+                                            &TheFunction);
+      Instruction *T = Builder.CreateCondBr(IsImport, Call, Next);
+      setBlockType(T, BlockType::ExternalJumpsHandlerBlock);
+      Builder.SetInsertPoint(Next);
+    }
+  }
+
+  Instruction *T = Builder.CreateBr(SlowPath);
+  setBlockType(T, BlockType::ExternalJumpsHandlerBlock);
+
+  return Entry;
+}
+
+/// \return the address of the GOT entry used by the x86-64 PLT stub in \p Code,
+///         or 0 if \p Code is not a PLT stub
+static uint64_t getPLTStubSlot(uint64_t Address, ArrayRef<uint8_t> Code) {
+  const uint8_t EndBr64[] = { 0xf3, 0x0f, 0x1e, 0xfa };
+  const uint8_t BndPrefix = 0xf2;
+  const uint8_t JmpIndirectRIPRelative[] = { 0xff, 0x25 };
+
+  uint64_t Offset = 0;
+  auto Consume = [&Code, &Offset](ArrayRef<uint8_t> Expected) {
+    if (Code.size() < Offset + Expected.size()
+        or Code.slice(Offset, Expected.size()) != Expected)
+      return false;
+    Offset += Expected.size();
+    return true;
+  };
+
+  Consume(EndBr64);
+  Consume(BndPrefix);
+  if (not Consume(JmpIndirectRIPRelative) or Code.size() < Offset + 4)
+    return 0;
+
+  uint32_t RawDisplacement = 0;
+  for (unsigned I = 0; I < 4; ++I)
+    RawDisplacement |= static_cast<uint32_t>(Code[Offset + I]) << (I * 8);
+  auto Displacement = static_cast<int32_t>(RawDisplacement);
+
+  // The displacement is relative to the end of the instruction
+  return Address + Offset + 4 + Displacement;
+}
+
+void ExternalJumpsHandler::bypassImportStubs(const JumpTargetManager &JTM) {
+  if (FastImports.empty() or Arch.type() != Triple::x86_64)
+    return;
+
+  // Map each GOT entry to the fast import using it
+  std::map<StringRef, std::set<uint64_t>> Slots = importSlots();
+  std::map<uint64_t, const FastImport *> SlotToImport;
+  for (const FastImport &Import : FastImports) {
+    auto It = Slots.find(Import.Name);
+    if (It != Slots.end())
+      for (uint64_t Slot : It->second)
+        SlotToImport[Slot] = &Import;
+  }
+
+  if (SlotToImport.empty())
+    return;
+
+  std::map<const FastImport *, BasicBlock *> Calls;
+  bool Changed = false;
+  for (auto &[Address, JT] : JTM) {
+    auto Code = TheBinary.getAddressData(Address);
+    if (not Code)
+      continue;
+
+    uint64_t Slot = getPLTStubSlot(Address.address(), *Code);
+    auto It = SlotToImport.find(Slot);
+    if (Slot == 0 or It == SlotToImport.end())
+      continue;
+
+    // All the stubs of an import share the same call
+    const FastImport &Import = *It->second;
+    BasicBlock *&Call = Calls[&Import];
+    if (Call == nullptr) {
+      FunctionCallee Callee = TheModule.getOrInsertFunction(Import.Name,
+                                                            fastImportType(
+                                                              Import));
+      Call = createFastImportCall(Import, Callee);
+    }
+
+    // The stub is a single indirect jump: instead of going to the dispatcher
+    // with the content of the GOT entry, go to the call. The lifted load of
+    // the GOT entry becomes dead.
+    Instruction *T = JT.head()->getTerminator();
+    auto *NewT = BranchInst::Create(Call, T);
+    NewT->copyMetadata(*T);
+    T->eraseFromParent();
+    Changed = true;
+  }
+
+  // Drop the blocks that are no longer reachable
+  if (Changed)
+    EliminateUnreachableBlocks(TheFunction, nullptr, false);
+}
+
 void ExternalJumpsHandler::createExternalJumpsHandler() {
 
   if (not Arch.isJumpOutSupported()) {
@@ -248,7 +455,7 @@ void ExternalJumpsHandler::createExternalJumpsHandler() {
                                                        "dispatcher.external",
                                                        &TheFunction);
 
-  DispatcherFail->replaceAllUsesWith(ExternalJumpHandler);
+  DispatcherFail->replaceAllUsesWith(createFastImports(ExternalJumpHandler));
 
   {
     BasicBlock *IsExecutable = SetjmpBB;
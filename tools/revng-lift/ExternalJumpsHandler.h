@@ -4,18 +4,36 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <map>
+#include <set>
+#include <string>
 #include <vector>
 
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/Pass.h"
 
+#include "revng/Model/Register.h"
 #include "revng/Support/revng.h"
 
 #include "BinaryFile.h"
 
+class JumpTargetManager;
 class ProgramCounterHandler;
 
+/// \brief A function of a dynamic library that translated code can call
+///        directly
+///
+/// The function must take its arguments and return its result in registers
+/// only, and must not call back into translated code.
+struct FastImport {
+  std::string Name;
+  /// The registers holding the arguments, in the order mandated by the ABI
+  std::vector<model::Register::Values> Arguments;
+  /// The register holding the return value, Invalid if there's none
+  model::Register::Values ReturnValue = model::Register::Invalid;
+};
+
 /// \brief Inject code to support jumping in non-translated code and handling
 ///        the comeback.
 ///
@@ -31,6 +49,12 @@ class ProgramCounterHandler;
 /// If this is the case, we perform a longjmp to get back into the proper
 /// context, we restore the relevant registers from the data structures provided
 /// by the signal handler and then jump to the dispatcher to resume execution.
+///
+/// Jumps to the \ref FastImport functions skip all of this: they are turned
+/// into a regular call to the native function, marshalling only the registers
+/// of its prototype, followed by a return to the guest caller. PLT stubs
+/// jumping to a \ref FastImport are replaced altogether by a call to the host
+/// symbol, so that they don't even reach the dispatcher.
 class ExternalJumpsHandler {
 private:
   llvm::LLVMContext &Context;
@@ -42,18 +66,29 @@ private:
   const Architecture &Arch;
   llvm::BasicBlock *Dispatcher;
   ProgramCounterHandler *PCH;
+  llvm::ArrayRef<FastImport> FastImports;
 
 public:
   /// \param TheFunction the root function.
+  /// \param FastImports the dynamic functions to call directly.
   ExternalJumpsHandler(BinaryFile &TheBinary,
                        llvm::BasicBlock *Dispatcher,
                        llvm::Function &TheFunction,
-                       ProgramCounterHandler *PCH);
+                       ProgramCounterHandler *PCH,
+                       llvm::ArrayRef<FastImport> FastImports = {});
 
 public:
   /// \brief Creates the jump out and jump back in handling infrastructure.
   void createExternalJumpsHandler();
 
+  /// \brief Replace the PLT stubs of the fast imports with a direct call
+  ///
+  /// A jump target whose code is an x86-64 PLT stub (`jmp *SLOT(%rip)`,
+  /// possibly preceded by `endbr64` and/or a `bnd` prefix) with SLOT being the
+  /// GOT entry of a fast import is turned into a call to the homonymous host
+  /// symbol, which will be resolved when linking the translated binary.
+  void bypassImportStubs(const JumpTargetManager &JTM);
+
 private:
   /// \brief Create the basic blocks to handle jumping to external code.
   ///
@@ -90,4 +125,25 @@ private:
   /// The CPU state is restored from the mcontext_t field in the struct provided
   /// by the kernel to the signal handler.
   llvm::BasicBlock *createReturnFromExternal();
+
+  /// \brief Create the basic blocks calling directly the fast imports.
+  ///
+  /// The program counter is compared with the current content of the GOT
+  /// entries of each fast import. On a match, the native function is called
+  /// and the return address is popped from the stack, as the function would
+  /// have done, before going back to the dispatcher. Otherwise, execution
+  /// continues in \p SlowPath.
+  ///
+  /// \return the entry block, or \p SlowPath if there are no fast imports.
+  llvm::BasicBlock *createFastImports(llvm::BasicBlock *SlowPath);
+
+  /// \brief Collect the GOT entries of each imported symbol
+  std::map<llvm::StringRef, std::set<uint64_t>> importSlots() const;
+
+  /// \brief Get the native prototype of \p Import
+  llvm::FunctionType *fastImportType(const FastImport &Import) const;
+
+  /// \brief Create the basic block calling \p Import through \p Callee
+  llvm::BasicBlock *createFastImportCall(const FastImport &Import,
+                                         llvm::FunctionCallee Callee);
 };
@@ -20,6 +20,7 @@
 #include "llvm/Support/Casting.h"
 
 #include "revng/Support/Assert.h"
+#include "revng/Support/BinaryCoverage.h"
 #include "revng/Support/FunctionTags.h"
 #include "revng/Support/IRHelpers.h"
 #include "revng/Support/RandomAccessIterator.h"
@@ -28,6 +29,7 @@
 #include "InstructionTranslator.h"
 #include "PTCInterface.h"
 #include "VariableManager.h"
+#include "VectorHelpers.h"
 
 using namespace llvm;
 
@@ -465,7 +467,8 @@ IT::InstructionTranslator(IRBuilder<> &Builder,
                           std::vector<BasicBlock *> Blocks,
                           const Architecture &SourceArchitecture,
                           const Architecture &TargetArchitecture,
-                          ProgramCounterHandler *PCH) :
+                          ProgramCounterHandler *PCH,
+                          DebugStrings::Writer *Strings) :
   Builder(Builder),
   Variables(Variables),
   JumpTargets(JumpTargets),
@@ -477,7 +480,8 @@ IT::InstructionTranslator(IRBuilder<> &Builder,
   NewPCMarker(nullptr),
   LastPC(MetaAddress::invalid()),
   MetaAddressStruct(MetaAddress::getStruct(&TheModule)),
-  PCH(PCH) {
+  PCH(PCH),
+  Strings(Strings) {
 
   auto &Context = TheModule.getContext();
   using FT = FunctionType;
@@ -501,8 +505,11 @@ IT::InstructionTranslator(IRBuilder<> &Builder,
   FunctionTags::Marker.addTo(NewPCMarker);
 }
 
-void IT::finalizeNewPCMarkers(std::string &CoveragePath) {
+void IT::finalizeNewPCMarkers(std::string &CoveragePath,
+                              const std::string &BinaryCoveragePath) {
   std::ofstream Output(CoveragePath);
+  BinaryCoverage::Writer BinaryOutput;
+  bool EmitBinary = not BinaryCoveragePath.empty();
 
   Output << std::hex;
   size_t FixedArgCount = NewPCMarker->arg_size();
@@ -518,6 +525,8 @@ void IT::finalizeNewPCMarkers(std::string &CoveragePath) {
     bool IsJT = JumpTargets.isJumpTarget(PC);
     PC.dump(Output);
     Output << ",0x" << Size << "," << (IsJT ? "1" : "0") << "\n";
+    if (EmitBinary)
+      BinaryOutput.addInstruction(PC, Size, IsJT);
 
     // We already finished discovering new code to translate, so we can remove
     // the references to local variables as argument of the calls to newpc and
@@ -543,12 +552,46 @@ void IT::finalizeNewPCMarkers(std::string &CoveragePath) {
     Call->eraseFromParent();
 
   Output << std::dec;
+
+  if (EmitBinary) {
+    for (const SegmentInfo &Segment : JumpTargets.binary().segments())
+      if (Segment.IsExecutable)
+        BinaryOutput.addSegment(Segment.StartVirtualAddress, Segment.size());
+
+    std::error_code EC = BinaryOutput.write(BinaryCoveragePath);
+    revng_check(not EC, "Couldn't write the binary coverage file");
+  }
+}
+
+void IT::replaceNewPCMarkersWithMetadata() {
+  QuickMetadata QMD(TheModule.getContext());
+
+  std::vector<CallInst *> Calls;
+  for (User *U : NewPCMarker->users())
+    Calls.push_back(cast<CallInst>(U));
+
+  for (CallInst *Call : Calls) {
+    BasicBlock *BB = Call->getParent();
+    if (Call == BB->getFirstNonPHI()) {
+      auto Operand = [&QMD, Call](unsigned Index) {
+        return QMD.get(cast<Constant>(Call->getArgOperand(Index)));
+      };
+      auto *Tuple = QMD.tuple({ Operand(0), Operand(1), Operand(2) });
+      BB->getTerminator()->setMetadata(NewPCMDName, Tuple);
+    }
+
+    Call->eraseFromParent();
+  }
 }
 
-SmallSet<unsigned, 1> IT::preprocess(PTCInstructionList *InstructionList) {
-  SmallSet<unsigned, 1> Result;
+using IB = IT::InstructionBoundaries;
+IB IT::preprocess(PTCInstructionList *InstructionList) {
+  const unsigned InstructionCount = InstructionList->instruction_count;
+  InstructionBoundaries Result;
+  Result.Ignored.resize(InstructionCount);
+  Result.Next.resize(InstructionCount);
 
-  for (unsigned I = 0; I < InstructionList->instruction_count; I++) {
+  for (unsigned I = 0; I < InstructionCount; I++) {
     PTCInstruction &Instruction = InstructionList->instructions[I];
     switch (Instruction.opc) {
     case PTC_INSTRUCTION_op_movi_i32:
@@ -570,15 +613,27 @@ SmallSet<unsigned, 1> IT::preprocess(PTCInstructionList *InstructionList) {
     if (0 != strcmp("btarget", Temporary->name))
       continue;
 
-    for (unsigned J = I + 1; J < InstructionList->instruction_count; J++) {
+    for (unsigned J = I + 1; J < InstructionCount; J++) {
       unsigned Opcode = InstructionList->instructions[J].opc;
       if (Opcode == PTC_INSTRUCTION_op_debug_insn_start)
-        Result.insert(J);
+        Result.Ignored.set(J);
     }
 
     break;
   }
 
+  // Going backward, record the last boundary we met
+  unsigned NextBoundary = InstructionCount;
+  for (unsigned I = InstructionCount; I > 0; I--) {
+    unsigned Index = I - 1;
+    Result.Next[Index] = NextBoundary;
+
+    unsigned Opcode = InstructionList->instructions[Index].opc;
+    if (Opcode == PTC_INSTRUCTION_op_debug_insn_start
+        and not Result.Ignored[Index])
+      NextBoundary = Index;
+  }
+
   return Result;
 }
 
@@ -611,20 +666,32 @@ IT::newInstruction(PTCInstruction *Instr,
   MDNode *MDOriginalInstr = nullptr;
   Constant *String = nullptr;
   if (RecordASM) {
-    std::stringstream OriginalStringStream;
-    disassemble(OriginalStringStream, PC, NextPC - PC);
-    std::string OriginalString = OriginalStringStream.str();
-
-    // We don't deduplicate this string since performing a lookup each time is
-    // increasingly expensive and we should have relatively few collisions
-    std::string AddressName = JumpTargets.nameForAddress(PC);
-    String = buildStringPtr(&TheModule,
-                            OriginalString,
-                            Twine("disam_") + AddressName);
-
-    auto *MDOriginalString = ConstantAsMetadata::get(String);
+    auto [It, New] = Disassembled.try_emplace({ PC, NextPC - PC });
+    if (New) {
+      std::stringstream OriginalStringStream;
+      disassemble(OriginalStringStream, PC, NextPC - PC);
+      It->second = OriginalStringStream.str();
+    }
+    const std::string &OriginalString = It->second;
     auto *MDPC = ConstantAsMetadata::get(PC.toConstant(MetaAddressStruct));
-    MDOriginalInstr = MDNode::get(Context, { MDOriginalString, MDPC });
+
+    if (Strings != nullptr) {
+      // Keep only the identifier of the string in the side file
+      Constant *Identifier = Builder.getInt64(Strings->add(OriginalString));
+      auto *MDIdentifier = ConstantAsMetadata::get(Identifier);
+      MDOriginalInstr = MDNode::get(Context, { MDIdentifier, MDPC });
+      String = ConstantPointerNull::get(getStringPtrType(Context));
+    } else {
+      // We don't deduplicate this string since performing a lookup each time
+      // is increasingly expensive and we should have relatively few collisions
+      std::string AddressName = JumpTargets.nameForAddress(PC);
+      String = buildStringPtr(&TheModule,
+                              OriginalString,
+                              Twine("disam_") + AddressName);
+
+      auto *MDOriginalString = ConstantAsMetadata::get(String);
+      MDOriginalInstr = MDNode::get(Context, { MDOriginalString, MDPC });
+    }
   } else {
     String = ConstantPointerNull::get(getStringPtrType(Context));
   }
@@ -709,7 +776,14 @@ IT::TranslationResult IT::translateCall(PTCInstruction *Instr) {
                                        ArrayRef<Type *>(InArgsType),
                                        false);
 
-  std::string HelperName = "helper_" + TheCall.helperName();
+  // Prefer native vector instructions to helpers operating on packed lanes
+  std::string Name = TheCall.helperName();
+  if (Value *Result = emitVectorHelper(Builder, Name, ResultType, InArgs)) {
+    Builder.CreateStore(Result, ResultDestination);
+    return Success;
+  }
+
+  std::string HelperName = "helper_" + Name;
   FunctionCallee FDecl = TheModule.getOrInsertFunction(HelperName, CalleeType);
 
   FunctionTags::Helper.addTo(cast<Function>(skipCasts(FDecl.getCallee())));
@@ -726,7 +800,8 @@ IT::TranslationResult
 IT::translate(PTCInstruction *Instr, MetaAddress PC, MetaAddress NextPC) {
   const PTC::Instruction TheInstruction(Instr);
 
-  std::vector<Value *> InArgs;
+  // Keep the operands inline, PTC instructions rarely have more than four
+  SmallVector<Value *, 4> InArgs;
   for (uint64_t TemporaryId : TheInstruction.InArguments) {
     auto *Load = Variables.load(Builder, TemporaryId);
     if (Load == nullptr)
@@ -734,11 +809,10 @@ IT::translate(PTCInstruction *Instr, MetaAddress PC, MetaAddress NextPC) {
     InArgs.push_back(Load);
   }
 
-  auto ConstArgs = TheInstruction.ConstArguments;
+  auto ConstRange = TheInstruction.ConstArguments;
+  SmallVector<uint64_t, 4> ConstArgs(ConstRange.begin(), ConstRange.end());
   LastPC = PC;
-  auto Result = translateOpcode(TheInstruction.opcode(),
-                                ConstArgs.toVector(),
-                                InArgs);
+  auto Result = translateOpcode(TheInstruction.opcode(), ConstArgs, InArgs);
 
   // Check if there was an error while translating the instruction
   if (!Result)
@@ -786,10 +860,10 @@ void IT::registerDirectJumps() {
   ExitBlocks.clear();
 }
 
-ErrorOr<std::vector<Value *>>
+ErrorOr<IT::OutValues>
 IT::translateOpcode(PTCOpcode Opcode,
-                    std::vector<uint64_t> ConstArguments,
-                    std::vector<Value *> InArguments) {
+                    ArrayRef<uint64_t> ConstArguments,
+                    ArrayRef<Value *> InArguments) {
   LLVMContext &Context = TheModule.getContext();
   unsigned RegisterSize = getRegisterSize(Opcode);
   Type *RegisterType = nullptr;
@@ -800,7 +874,7 @@ IT::translateOpcode(PTCOpcode Opcode,
   else if (RegisterSize != 0)
     revng_unreachable("Unexpected register size");
 
-  using v = std::vector<Value *>;
+  using v = OutValues;
   switch (Opcode) {
   case PTC_INSTRUCTION_op_movi_i32:
   case PTC_INSTRUCTION_op_movi_i64:
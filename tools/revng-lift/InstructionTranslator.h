@@ -6,13 +6,18 @@
 
 #include <cstdint>
 #include <map>
+#include <string>
+#include <utility>
 #include <vector>
 
-#include "llvm/ADT/SmallSet.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/ErrorOr.h"
 
+#include "revng/Support/DebugStrings.h"
 #include "revng/Support/ProgramCounterHandler.h"
 #include "revng/Support/revng.h"
 
@@ -51,7 +56,30 @@ public:
                         std::vector<llvm::BasicBlock *> Blocks,
                         const Architecture &SourceArchitecture,
                         const Architecture &TargetArchitecture,
-                        ProgramCounterHandler *PCH);
+                        ProgramCounterHandler *PCH,
+                        DebugStrings::Writer *Strings);
+
+  /// \brief Instruction boundaries of a PTC translation
+  struct InstructionBoundaries {
+    /// Set for the PTC_INSTRUCTION_op_debug_insn_start instructions that have
+    /// to be ignored
+    llvm::BitVector Ignored;
+    /// For each instruction, index of the next non-ignored
+    /// PTC_INSTRUCTION_op_debug_insn_start, or the instruction count
+    std::vector<unsigned> Next;
+
+    bool isIgnored(unsigned Index) const { return Ignored[Index]; }
+
+    /// \return the next non-ignored PTC_INSTRUCTION_op_debug_insn_start
+    ///         after the instruction at \p Index, or nullptr if none.
+    PTCInstruction *
+    nextInstruction(PTCInstructionList *Instructions, unsigned Index) const {
+      unsigned NextIndex = Next[Index];
+      if (NextIndex == Instructions->instruction_count)
+        return nullptr;
+      return &Instructions->instructions[NextIndex];
+    }
+  };
 
   /// \brief Result status of the translation of a PTC opcode
   enum TranslationResult {
@@ -106,25 +134,41 @@ public:
   /// \brief Handle calls to `newPC` marker and emit coverage information
   ///
   /// \param CoveragePath path where the coverage information should be stored.
-  void finalizeNewPCMarkers(std::string &CoveragePath);
+  /// \param BinaryCoveragePath if not empty, path where the coverage
+  ///        information should be stored in the format described in
+  ///        revng/Support/BinaryCoverage.h.
+  void finalizeNewPCMarkers(std::string &CoveragePath,
+                            const std::string &BinaryCoveragePath);
+
+  /// \brief Replace the calls to `newpc` with metadata
+  ///
+  /// The call beginning each basic block is replaced by metadata attached to
+  /// its terminator (see NewPCMDName), the others are simply dropped.
+  ///
+  /// \note After this, only the mapping of basic blocks to PCs is available.
+  void replaceNewPCMarkersWithMetadata();
 
   /// \brief Notifies InstructionTranslator about a new PTC translation
   void reset() { LabeledBasicBlocks.clear(); }
 
   /// \brief Preprocess the translated instructions
   ///
-  /// Check if the translated code contains a delay slot and return a blacklist
-  /// of the PTC_INSTRUCTION_op_debug_insn_start instructions that have to be
-  /// ignored to merge the delay slot into the branch instruction.
-  llvm::SmallSet<unsigned, 1> preprocess(PTCInstructionList *Instructions);
+  /// Check if the translated code contains a delay slot and blacklist the
+  /// PTC_INSTRUCTION_op_debug_insn_start instructions that have to be ignored
+  /// to merge the delay slot into the branch instruction. Then, precompute the
+  /// position of the next instruction boundary for each PTC instruction.
+  InstructionBoundaries preprocess(PTCInstructionList *Instructions);
 
   void registerDirectJumps();
 
 private:
-  llvm::ErrorOr<std::vector<llvm::Value *>>
+  /// \brief Values produced by a PTC instruction, at most two
+  using OutValues = llvm::SmallVector<llvm::Value *, 2>;
+
+  llvm::ErrorOr<OutValues>
   translateOpcode(PTCOpcode Opcode,
-                  std::vector<uint64_t> ConstArguments,
-                  std::vector<llvm::Value *> InArguments);
+                  llvm::ArrayRef<uint64_t> ConstArguments,
+                  llvm::ArrayRef<llvm::Value *> InArguments);
 
 private:
   llvm::IRBuilder<> &Builder;
@@ -145,5 +189,13 @@ private:
   llvm::Type *MetaAddressStruct;
 
   ProgramCounterHandler *PCH;
+  /// If not nullptr, where the original assembly has to be recorded
+  DebugStrings::Writer *Strings;
+  /// \brief Original assembly of the instructions translated so far, indexed
+  ///        by address and size
+  ///
+  /// An instruction is translated again each time a new jump target splits
+  /// the code it belongs to, there's no need to disassemble it again.
+  std::map<std::pair<MetaAddress, uint64_t>, std::string> Disassembled;
   llvm::SmallVector<llvm::BasicBlock *, 4> ExitBlocks;
 };
@@ -8,10 +8,17 @@
 //
 
 #include <cstdint>
+#include <deque>
 #include <fstream>
+#include <functional>
+#include <limits>
 #include <queue>
 #include <sstream>
 
+extern "C" {
+#include <sys/resource.h>
+}
+
 #include "boost/icl/interval_set.hpp"
 #include "boost/icl/right_open_interval.hpp"
 #include "boost/type_traits/is_same.hpp"
@@ -25,6 +32,7 @@
 #include "llvm/IR/MDBuilder.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Transforms/InstCombine/InstCombine.h"
 #include "llvm/Transforms/Scalar.h"
 #include "llvm/Transforms/Scalar/EarlyCSE.h"
@@ -44,14 +52,18 @@
 #include "revng/Support/Debug.h"
 #include "revng/Support/FunctionTags.h"
 #include "revng/Support/IRHelpers.h"
+#include "revng/Support/MemoryUsage.h"
 #include "revng/Support/MetaAddress.h"
 #include "revng/Support/Statistics.h"
+#include "revng/Support/TracedPassManager.h"
+#include "revng/Support/Tracing.h"
 #include "revng/Support/revng.h"
 #include "revng/TypeShrinking/BitLiveness.h"
 #include "revng/TypeShrinking/TypeShrinking.h"
 
 #include "AdvancedValueInfoPass.h"
 #include "CPUStateAccessAnalysisPass.h"
+#include "CodePointerScanner.h"
 #include "DropHelperCallsPass.h"
 #include "JumpTargetManager.h"
 #include "SubGraph.h"
@@ -66,6 +78,7 @@ Logger<> RegisterJTLog("registerjt");
 
 CounterMap<std::string> HarvestingStats("harvesting");
 RunningStatistics BlocksAnalyzedByAVI("blocks-analyzed-by-avi");
+RunningStatistics HarvestRegionSize("harvest-region-size");
 
 RegisterPass<TranslateDirectBranchesPass> X("translate-db",
                                             "Translate Direct Branches"
@@ -75,6 +88,72 @@ RegisterPass<TranslateDirectBranchesPass> X("translate-db",
 
 } // namespace
 
+/// Reads further apart than this are too sparse to be worth prefetching
+static constexpr uint64_t MaxPrefetchStride = 64;
+
+/// Number of elements read at once when the reads follow a stride
+static constexpr unsigned PrefetchedReads = 32;
+
+static cl::opt<bool> IncrementalHarvest("incremental-harvest",
+                                        cl::desc("at each harvesting round, "
+                                                 "optimize and look for direct "
+                                                 "jumps only in the code "
+                                                 "translated since the "
+                                                 "previous round"),
+                                        cl::cat(MainCategory),
+                                        cl::init(false));
+
+static cl::opt<unsigned> InlineCacheSize("inline-cache-size",
+                                         cl::desc("indirect jumps with at most "
+                                                  "this many known targets "
+                                                  "compare the PC against "
+                                                  "each of them instead of "
+                                                  "going through a dispatcher"),
+                                         cl::value_desc("count"),
+                                         cl::cat(MainCategory),
+                                         cl::init(0));
+
+static cl::opt<unsigned> AVIThreads("avi-threads",
+                                    cl::desc("number of threads running the "
+                                             "AdvancedValueInfo queries of "
+                                             "each harvesting round"),
+                                    cl::value_desc("count"),
+                                    cl::cat(MainCategory),
+                                    cl::init(1));
+
+static cl::opt<unsigned> ScanThreads("code-pointers-threads",
+                                     cl::desc("number of threads scanning "
+                                              "the global data for code "
+                                              "pointers"),
+                                     cl::value_desc("count"),
+                                     cl::cat(MainCategory),
+                                     cl::init(1));
+
+static cl::opt<unsigned> MaxHarvestTime("max-harvest-time",
+                                        cl::desc("stop looking for new jump "
+                                                 "targets after this many "
+                                                 "seconds, 0 means no limit"),
+                                        cl::value_desc("seconds"),
+                                        cl::cat(MainCategory),
+                                        cl::init(0));
+
+static cl::opt<unsigned> MaxHarvestRounds("max-harvest-rounds",
+                                          cl::desc("stop looking for new jump "
+                                                   "targets after this many "
+                                                   "harvesting rounds, 0 "
+                                                   "means no limit"),
+                                          cl::value_desc("count"),
+                                          cl::cat(MainCategory),
+                                          cl::init(0));
+
+static cl::opt<unsigned> MaxRSS("max-rss",
+                                cl::desc("stop looking for new jump targets "
+                                         "once the resident set size reaches "
+                                         "this many MiB, 0 means no limit"),
+                                cl::value_desc("MiB"),
+                                cl::cat(MainCategory),
+                                cl::init(0));
+
 char TranslateDirectBranchesPass::ID = 0;
 
 void TranslateDirectBranchesPass::getAnalysisUsage(AnalysisUsage &AU) const {
@@ -93,10 +172,9 @@ void JumpTargetManager::assertNoUnreachable() const {
 
       MetaAddress PC = getBasicBlockPC(BB);
       if (PC.isValid()) {
-        auto It = JumpTargets.find(PC);
-        if (It != JumpTargets.end()) {
+        if (const JumpTarget *JT = findJT(PC)) {
           VerifyLog << ", reasons:";
-          for (const char *Reason : It->second.getReasonNames())
+          for (const char *Reason : JT->getReasonNames())
             VerifyLog << " " << Reason;
         }
       }
@@ -109,8 +187,9 @@ void JumpTargetManager::assertNoUnreachable() const {
 }
 
 /// \brief Purges everything is after a call to exitTB (except the call itself)
-static void exitTBCleanup(Instruction *ExitTBCall) {
+static void exitTBCleanup(JumpTargetManager *JTM, Instruction *ExitTBCall) {
   BasicBlock *BB = ExitTBCall->getParent();
+  JTM->recordRemovedEdges(BB);
 
   // Cleanup everything it's aftewards starting from the end
   Instruction *ToDelete = &*(--BB->end());
@@ -126,8 +205,9 @@ static void exitTBCleanup(Instruction *ExitTBCall) {
 
 using TDBP = TranslateDirectBranchesPass;
 
-TDBP::TranslateDirectBranchesPass(JumpTargetManager *J) :
-  ModulePass(ID), JTM(J), PCH(J->programCounterHandler()) {
+TDBP::TranslateDirectBranchesPass(JumpTargetManager *J,
+                                  const std::set<BasicBlock *> *Region) :
+  ModulePass(ID), JTM(J), PCH(J->programCounterHandler()), Region(Region) {
 }
 
 using DispatcherTargets = ProgramCounterHandler::DispatcherTargets;
@@ -148,20 +228,54 @@ void TDBP::pinExitTB(CallInst *ExitTBCall, DispatcherTargets &Destinations) {
   // TODO: we should also check the destinations are actually the same
 
   BasicBlock *BB = ExitTBCall->getParent();
+  constexpr auto IBDHB = BlockType::IndirectBranchDispatcherHelperBlock;
+
+  // Collect the checks of the inline cache we might have emitted in a previous
+  // round, they are chained through the false successor of each check
+  SmallVector<BasicBlock *, 2> OldChecks;
+  auto *Check = dyn_cast<BranchInst>(BB->getTerminator());
+  while (Check != nullptr and Check->isConditional()) {
+    BasicBlock *Next = Check->getSuccessor(1);
+    if (GeneratedCodeBasicInfo::getType(Next) != IBDHB)
+      break;
+    OldChecks.push_back(Next);
+    Check = dyn_cast<BranchInst>(Next->getTerminator());
+  }
 
   if (auto *Dispatcher = dyn_cast<SwitchInst>(BB->getTerminator()))
     PCH->destroyDispatcher(Dispatcher);
 
   // Kill everything is after the call to exitTB
-  exitTBCleanup(ExitTBCall);
+  exitTBCleanup(JTM, ExitTBCall);
+
+  // Each check is only reachable from the previous one
+  for (BasicBlock *OldCheck : OldChecks)
+    OldCheck->eraseFromParent();
 
   // Mark this call to exitTB as handled
   ExitTBCall->setArgOperand(0, ExitTBArg);
 
-  PCH->buildDispatcher(Destinations,
-                       BB,
-                       UnexpectedPC,
-                       BlockType::IndirectBranchDispatcherHelperBlock);
+  if (Destinations.size() <= InlineCacheSize) {
+    // Few targets: compare the PC against each of them, one after the other
+    IRBuilder<> Builder(BB);
+    Function *F = BB->getParent();
+    for (const auto &Destination : Destinations) {
+      bool IsLast = &Destination == &Destinations.back();
+      BasicBlock *Next = UnexpectedPC;
+      if (not IsLast)
+        Next = BasicBlock::Create(Context, BB->getName() + "_check", F);
+
+      PCH->buildHotPath(Builder, Destination, Next);
+
+      if (Builder.GetInsertBlock() != BB)
+        setBlockType(Builder.GetInsertBlock()->getTerminator(), IBDHB);
+
+      if (not IsLast)
+        Builder.SetInsertPoint(Next);
+    }
+  } else {
+    PCH->buildDispatcher(Destinations, BB, UnexpectedPC, IBDHB);
+  }
 
   // Move all the markers right before the branch instruction
   Instruction *Last = BB->getTerminator();
@@ -202,7 +316,7 @@ bool TDBP::pinAVIResults(Function &F) {
           Values.reserve(T->getNumOperands());
           for (const MDOperand &Operand : T->operands()) {
             auto *CMA = QMD.extract<Constant *>(Operand.get());
-            auto MA = MetaAddress::fromConstant(CMA);
+            auto MA = JTM->metaAddressConstants().fromConstant(CMA);
             Values.emplace_back(MA, JTM->getBlockAt(MA));
           }
 
@@ -223,6 +337,8 @@ void TDBP::pinConstantStoreInternal(MetaAddress Address, CallInst *ExitTBCall) {
   const Module *M = getModule(ExitTBCall);
   LLVMContext &Context = getContext(M);
 
+  JTM->recordRemovedEdges(ExitTBCall->getParent());
+
   // Remove unreachable right after the exit_tb
   BasicBlock::iterator CallIt(ExitTBCall);
   BasicBlock::iterator BlockEnd = ExitTBCall->getParent()->end();
@@ -261,6 +377,10 @@ bool TDBP::pinConstantStore(Function &F) {
     auto *Call = cast<CallInst>(ExitTBUse.getUser());
     revng_assert(Call->getCalledFunction() == ExitTB);
 
+    // If we've been asked to work on a region, ignore the rest
+    if (Region != nullptr and Region->count(Call->getParent()) == 0)
+      continue;
+
     // Look for the last write to the PC
     auto [Result, NextPC] = PCH->getUniqueJumpTarget(Call->getParent());
 
@@ -287,6 +407,26 @@ bool TDBP::pinConstantStore(Function &F) {
   return true;
 }
 
+/// \brief Return the only predecessor of \p BB, ignoring the dispatcher
+///
+/// The dispatcher can reach every jump target, but such edges are not something
+/// we recovered.
+static BasicBlock *getUniqueRecoveredPredecessor(BasicBlock *BB) {
+  using GCBI = GeneratedCodeBasicInfo;
+  BasicBlock *Result = nullptr;
+  for (BasicBlock *Predecessor : predecessors(BB)) {
+    if (GCBI::isPartOfRootDispatcher(Predecessor))
+      continue;
+
+    if (Result != nullptr and Result != Predecessor)
+      return nullptr;
+
+    Result = Predecessor;
+  }
+
+  return Result;
+}
+
 bool TDBP::forceFallthroughAfterHelper(CallInst *Call) {
   // If someone else already took care of the situation, quit
   if (getLimitedValue(Call->getArgOperand(0)) > 0)
@@ -315,7 +455,7 @@ bool TDBP::forceFallthroughAfterHelper(CallInst *Call) {
 
     if (!ForceFallthrough) {
       // Proceed only to unique predecessor, if present
-      if (auto *Pred = BB->getUniquePredecessor()) {
+      if (auto *Pred = getUniqueRecoveredPredecessor(BB)) {
         BB = Pred;
         It = BB->rbegin();
         EndIt = BB->rend();
@@ -326,7 +466,7 @@ bool TDBP::forceFallthroughAfterHelper(CallInst *Call) {
     }
   }
 
-  exitTBCleanup(Call);
+  exitTBCleanup(JTM, Call);
 
   IRBuilder<> Builder(Call->getParent());
   Call->setArgOperand(0, Builder.getInt32(1));
@@ -360,7 +500,6 @@ JumpTargetManager::readFromPointer(Constant *Pointer, BinaryFile::Endianess E) {
   Type *LoadedType = Pointer->getType()->getPointerElementType();
   const DataLayout &DL = TheModule.getDataLayout();
   unsigned LoadSize = DL.getTypeSizeInBits(LoadedType) / 8;
-  auto NewAPInt = [LoadSize](uint64_t V) { return APInt(LoadSize * 8, V); };
 
   Value *RealPointer = skipCasts(Pointer);
   uint64_t RawLoadAddress = 0;
@@ -369,6 +508,37 @@ JumpTargetManager::readFromPointer(Constant *Pointer, BinaryFile::Endianess E) {
   }
   auto LoadAddress = fromAbsolute(RawLoadAddress);
 
+  bool Strided = isStrided(LoadAddress, LoadSize, E);
+
+  auto [It, New] = StaticReads.try_emplace(staticReadKey(LoadAddress,
+                                                         LoadSize,
+                                                         E));
+  StaticRead &Read = It->second;
+  if (not New) {
+    if (Read.Prefetched) {
+      UnusedCodePointers.erase(LoadAddress);
+      registerReadRange(LoadAddress, LoadSize);
+      Read.Prefetched = false;
+    }
+
+    return Read.Value;
+  }
+
+  Read.Value = readStaticValue(LoadAddress, LoadSize, E);
+  MaterializedValue Result = Read.Value;
+
+  if (Strided)
+    prefetchStrided(LoadAddress, LoadSize, E);
+
+  return Result;
+}
+
+MaterializedValue
+JumpTargetManager::readStaticValue(MetaAddress LoadAddress,
+                                   unsigned LoadSize,
+                                   BinaryFile::Endianess E) {
+  auto NewAPInt = [LoadSize](uint64_t V) { return APInt(LoadSize * 8, V); };
+
   UnusedCodePointers.erase(LoadAddress);
   registerReadRange(LoadAddress, LoadSize);
 
@@ -424,6 +594,59 @@ JumpTargetManager::readFromPointer(Constant *Pointer, BinaryFile::Endianess E) {
     return {};
 }
 
+bool JumpTargetManager::isStrided(MetaAddress Address,
+                                  unsigned Size,
+                                  BinaryFile::Endianess E) {
+  StridedRead &Last = LastStaticRead;
+  uint64_t Stride = 0;
+  if (Last.Size == Size and Last.E == E
+      and Address.addressIsComparableWith(Last.Address)
+      and Address.addressGreaterThan(Last.Address)) {
+    Stride = Address - Last.Address;
+  }
+
+  bool Result = Stride != 0 and Stride == Last.Stride
+                and Stride <= MaxPrefetchStride;
+  Last = { Address, Size, E, Stride };
+  return Result;
+}
+
+void JumpTargetManager::prefetchStrided(MetaAddress Address,
+                                        unsigned Size,
+                                        BinaryFile::Endianess E) {
+  uint64_t Stride = LastStaticRead.Stride;
+  MetaAddress First = Address + Stride;
+  MetaAddress End = First + (Stride * (PrefetchedReads - 1) + Size);
+  if (not First.isValid() or not End.isValid()
+      or First.addressLowerThanOrEqual(Address) or End.addressLowerThan(First))
+    return;
+
+  // Labels take precedence over the raw values, leave them to readStaticValue
+  const auto &Labels = binary().labels();
+  if (Labels.find(interval::right_open(First, End)) != Labels.end())
+    return;
+
+  std::vector<MetaAddress> Addresses;
+  Addresses.reserve(PrefetchedReads);
+  for (unsigned I = 0; I < PrefetchedReads; ++I)
+    Addresses.push_back(First + Stride * I);
+
+  auto Values = Binary.readRawValues(Addresses, Size, E);
+  for (unsigned I = 0; I < PrefetchedReads; ++I) {
+    auto [It, New] = StaticReads.try_emplace(staticReadKey(Addresses[I],
+                                                           Size,
+                                                           E));
+    if (not New)
+      continue;
+
+    if (Values[I])
+      It->second.Value = { APInt(Size * 8, *Values[I]) };
+    It->second.Prefetched = true;
+  }
+
+  HarvestingStats.push("prefetched-reads", PrefetchedReads);
+}
+
 template<typename T>
 static cl::opt<T> *
 getOption(StringMap<cl::Option *> &Options, const char *Name) {
@@ -445,7 +668,9 @@ JumpTargetManager::JumpTargetManager(Function *TheFunction,
   Binary(Binary),
   CurrentCFGForm(CFGForm::UnknownForm),
   createCSAA(createCSAA),
-  PCH(PCH) {
+  PCH(PCH),
+  ExplorationStart(std::chrono::steady_clock::now()),
+  MAConstants(MetaAddress::getStruct(&TheModule)) {
 
   FunctionType *ExitTBTy = FunctionType::get(Type::getVoidTy(Context),
                                              { Type::getInt32Ty(Context) },
@@ -459,6 +684,9 @@ JumpTargetManager::JumpTargetManager(Function *TheFunction,
   for (auto &Segment : Binary.segments())
     Segment.insertExecutableRanges(std::back_inserter(ExecutableRanges));
 
+  InstructionStarts = AddressBitmap(ExecutableRanges);
+  JumpTargetStarts = AddressBitmap(ExecutableRanges);
+
   // Configure GlobalValueNumbering
   StringMap<cl::Option *> &Options(cl::getRegisteredOptions());
   getOption<bool>(Options, "enable-load-pre")->setInitialValue(false);
@@ -467,6 +695,98 @@ JumpTargetManager::JumpTargetManager(Function *TheFunction,
   // getOption<uint32_t>(Options, "max-recurse-depth")->setInitialValue(10);
 }
 
+void JumpTargetManager::createBlockCounters() {
+  auto *Int64 = Type::getInt64Ty(Context);
+  auto *CountersType = ArrayType::get(Int64, JumpTargets.size());
+  auto *Counters = new GlobalVariable(TheModule,
+                                      CountersType,
+                                      false,
+                                      GlobalValue::ExternalLinkage,
+                                      ConstantAggregateZero::get(CountersType),
+                                      "revng_block_counters");
+
+  std::vector<Constant *> PCs;
+  PCs.reserve(JumpTargets.size());
+  IRBuilder<> Builder(Context);
+  for (auto &[PC, JT] : JumpTargets) {
+    uint64_t Index = PCs.size();
+    PCs.push_back(Builder.getInt64(PC.address()));
+
+    // Increment the counter right after the call to newpc, which has to stay
+    // the first instruction
+    BasicBlock *BB = JT.head();
+    revng_assert(BB->getTerminator() != nullptr);
+    auto It = BB->begin();
+    if (getCallTo(&*It, "newpc") != nullptr)
+      ++It;
+    Builder.SetInsertPoint(BB, It);
+
+    Value *Counter = Builder.CreateConstInBoundsGEP2_64(CountersType,
+                                                        Counters,
+                                                        0,
+                                                        Index);
+    Value *Incremented = Builder.CreateAdd(Builder.CreateLoad(Counter),
+                                           Builder.getInt64(1));
+    Builder.CreateStore(Incremented, Counter);
+  }
+
+  new GlobalVariable(TheModule,
+                     CountersType,
+                     true,
+                     GlobalValue::ExternalLinkage,
+                     ConstantArray::get(CountersType, PCs),
+                     "revng_block_counters_pcs");
+  new GlobalVariable(TheModule,
+                     Int64,
+                     true,
+                     GlobalValue::ExternalLinkage,
+                     Builder.getInt64(PCs.size()),
+                     "revng_block_counters_count");
+}
+
+void JumpTargetManager::applyProfile(const ProfileCounts &Counts) {
+  auto Count = [&Counts](const MetaAddress &PC) -> uint64_t {
+    auto It = Counts.find(PC);
+    return It == Counts.end() ? 0 : It->second;
+  };
+
+  std::map<BasicBlock *, uint64_t> BlockCounts;
+  for (auto &[PC, JT] : JumpTargets)
+    BlockCounts[JT.head()] = Count(PC);
+
+  PCH->setDispatcherWeights(DispatcherSwitch, Count);
+
+  // Conditional branches between two jump targets, e.g., the translation of a
+  // conditional jump of the input program
+  MDBuilder MDB(Context);
+  for (BasicBlock &BB : *TheFunction) {
+    auto *Branch = dyn_cast<BranchInst>(BB.getTerminator());
+    if (Branch == nullptr or not Branch->isConditional())
+      continue;
+
+    auto TakenIt = BlockCounts.find(Branch->getSuccessor(0));
+    auto NotTakenIt = BlockCounts.find(Branch->getSuccessor(1));
+    if (TakenIt == BlockCounts.end() or NotTakenIt == BlockCounts.end())
+      continue;
+
+    uint64_t Taken = TakenIt->second;
+    uint64_t NotTaken = NotTakenIt->second;
+    if (Taken == 0 and NotTaken == 0)
+      continue;
+
+    // Branch weights are 32-bits wide
+    uint64_t Scale = std::max(Taken, NotTaken)
+                       / std::numeric_limits<uint32_t>::max()
+                     + 1;
+    Branch->setMetadata(LLVMContext::MD_prof,
+                        MDB.createBranchWeights(Taken / Scale,
+                                                NotTaken / Scale));
+  }
+
+  // The root function is entered exactly once
+  TheFunction->setEntryCount(Function::ProfileCount(1, Function::PCT_Real));
+}
+
 void JumpTargetManager::harvestGlobalData() {
   // Register symbols
   for (auto &P : Binary.labels())
@@ -482,60 +802,91 @@ void JumpTargetManager::harvestGlobalData() {
   for (MetaAddress CodePointer : Binary.codePointers())
     registerJT(CodePointer, JTReason::GlobalData);
 
+  size_t PointerSize = Binary.architecture().pointerSize() / 8;
+  std::vector<DataChunk> Chunks;
+  std::deque<SmallVector<uint8_t, 16>> StraddlingBuffers;
   for (auto &Segment : Binary.segments()) {
-    const Constant *Initializer = Segment.Variable->getInitializer();
-    if (isa<ConstantAggregateZero>(Initializer))
+    // Read straight from the input file instead of going through the
+    // initializer of the segment variable. Past the end of Data the segment is
+    // zero-filled.
+    ArrayRef<uint8_t> Data = Segment.Data.take_front(Segment.size());
+    if (all_of(Data, [](uint8_t Byte) { return Byte == 0; }))
       continue;
 
-    auto *Data = cast<ConstantDataArray>(Initializer);
-    MetaAddress StartVirtualAddress = Segment.StartVirtualAddress;
-    const unsigned char *DataStart = Data->getRawDataValues().bytes_begin();
-    const unsigned char *DataEnd = Data->getRawDataValues().bytes_end();
-
-    using endianness = support::endianness;
-    if (Binary.architecture().pointerSize() == 64) {
-      if (Binary.architecture().isLittleEndian())
-        findCodePointers<uint64_t, endianness::little>(StartVirtualAddress,
-                                                       DataStart,
-                                                       DataEnd);
-      else
-        findCodePointers<uint64_t, endianness::big>(StartVirtualAddress,
-                                                    DataStart,
-                                                    DataEnd);
-    } else if (Binary.architecture().pointerSize() == 32) {
-      if (Binary.architecture().isLittleEndian())
-        findCodePointers<uint32_t, endianness::little>(StartVirtualAddress,
-                                                       DataStart,
-                                                       DataEnd);
-      else
-        findCodePointers<uint32_t, endianness::big>(StartVirtualAddress,
-                                                    DataStart,
-                                                    DataEnd);
+    if (Data.size() > PointerSize)
+      Chunks.emplace_back(Segment.StartVirtualAddress, Data);
+
+    // Consider also the pointers straddling the zero-filled portion
+    size_t ZeroSize = std::min(Segment.size() - Data.size(), PointerSize);
+    ArrayRef<uint8_t> LastBytes = Data.take_back(PointerSize);
+    if (LastBytes.size() + ZeroSize > PointerSize) {
+      auto &Straddling = StraddlingBuffers.emplace_back(LastBytes.begin(),
+                                                        LastBytes.end());
+      Straddling.append(ZeroSize, 0);
+      MetaAddress Start = Segment.StartVirtualAddress
+                          + (Data.size() - LastBytes.size());
+      Chunks.emplace_back(Start, Straddling);
     }
   }
 
+  findCodePointers(Chunks);
+
   revng_log(JTCountLog,
             "JumpTargets found in global data: " << std::dec
                                                  << Unexplored.size());
 }
 
-template<typename value_type, unsigned endian>
-void JumpTargetManager::findCodePointers(MetaAddress StartVirtualAddress,
-                                         const unsigned char *Start,
-                                         const unsigned char *End) {
-  using support::endianness;
-  using support::endian::read;
-  for (auto Pos = Start; Pos < End - sizeof(value_type); Pos++) {
-    auto Read = read<value_type, static_cast<endianness>(endian), 1>;
-    uint64_t RawValue = Read(Pos);
-    MetaAddress Value = fromPC(RawValue);
-    if (Value.isInvalid())
-      continue;
+void JumpTargetManager::findCodePointers(ArrayRef<DataChunk> Chunks) {
+  CodePointerScanner Scanner(ExecutableRanges,
+                             Binary.architecture().pointerSize() / 8,
+                             Binary.architecture().isLittleEndian());
+
+  // Split large chunks in slices, so that a single large segment can be
+  // scanned by multiple threads
+  struct Slice {
+    size_t Chunk;
+    size_t Begin;
+    size_t End;
+    std::vector<CodePointerScanner::Candidate> Candidates;
+  };
 
-    BasicBlock *Result = registerJT(Value, JTReason::GlobalData);
+  static constexpr size_t SliceSize = 1 << 20;
+  std::vector<Slice> Slices;
+  for (size_t I = 0; I < Chunks.size(); ++I) {
+    size_t Positions = Scanner.positions(Chunks[I].second);
+    for (size_t Begin = 0; Begin < Positions; Begin += SliceSize) {
+      size_t End = std::min(Begin + SliceSize, Positions);
+      Slices.push_back({ I, Begin, End, {} });
+    }
+  }
 
-    if (Result != nullptr)
-      UnusedCodePointers.insert(StartVirtualAddress + (Pos - Start));
+  auto ScanSlice = [&Scanner, &Chunks](Slice &S) {
+    S.Candidates = Scanner.scan(Chunks[S.Chunk].second, S.Begin, S.End);
+  };
+
+  if (ScanThreads > 1 and Slices.size() > 1) {
+    ThreadPool Pool(hardware_concurrency(ScanThreads));
+    for (Slice &S : Slices)
+      Pool.async(ScanSlice, std::ref(S));
+    Pool.wait();
+  } else {
+    for (Slice &S : Slices)
+      ScanSlice(S);
+  }
+
+  // Register the candidates in order, from a single thread
+  for (const Slice &S : Slices) {
+    MetaAddress StartVirtualAddress = Chunks[S.Chunk].first;
+    for (const auto &[Offset, RawValue] : S.Candidates) {
+      MetaAddress Value = fromPC(RawValue);
+      if (Value.isInvalid())
+        continue;
+
+      BasicBlock *Result = registerJT(Value, JTReason::GlobalData);
+
+      if (Result != nullptr)
+        UnusedCodePointers.insert(StartVirtualAddress + Offset);
+    }
   }
 }
 
@@ -555,8 +906,7 @@ BasicBlock *JumpTargetManager::newPC(MetaAddress PC, bool &ShouldContinue) {
   revng_assert(PC.isValid());
 
   // Did we already meet this PC?
-  auto JTIt = JumpTargets.find(PC);
-  if (JTIt != JumpTargets.end()) {
+  if (JumpTarget *JT = findJT(PC)) {
     // If it was planned to explore it in the future, just to do it now
     for (auto UnexploredIt = Unexplored.begin();
          UnexploredIt != Unexplored.end();
@@ -570,6 +920,7 @@ BasicBlock *JumpTargetManager::newPC(MetaAddress PC, bool &ShouldContinue) {
         if (ShouldContinue) {
           // We don't, OK let's explore it next
           Unexplored.erase(UnexploredIt);
+          TranslatedSinceHarvest.insert(PC);
         } else {
           // We do, it will be purged at the next `peek`
           revng_assert(ToPurge.count(Result) != 0);
@@ -581,7 +932,7 @@ BasicBlock *JumpTargetManager::newPC(MetaAddress PC, bool &ShouldContinue) {
 
     // It wasn't planned to visit it, so we've already been there, just jump
     // there
-    BasicBlock *BB = JTIt->second.head();
+    BasicBlock *BB = JT->head();
     revng_assert(!BB->empty());
     ShouldContinue = false;
     return BB;
@@ -590,7 +941,7 @@ BasicBlock *JumpTargetManager::newPC(MetaAddress PC, bool &ShouldContinue) {
   // Check if we already translated this PC even if it's not associated to a
   // basic block (i.e., we have to split its basic block). This typically
   // happens with variable-length instruction encodings.
-  if (OriginalInstructionAddresses.count(PC) != 0) {
+  if (isInstructionStart(PC)) {
     ShouldContinue = false;
     return registerJT(PC, JTReason::AmbigousInstruction);
   }
@@ -605,65 +956,84 @@ void JumpTargetManager::registerInstruction(MetaAddress PC,
   revng_assert(PC.isValid());
 
   // Never save twice a PC
-  revng_assert(!OriginalInstructionAddresses.count(PC));
+  revng_assert(!isInstructionStart(PC));
   OriginalInstructionAddresses[PC] = Instruction;
+  InstructionStarts.set(PC);
+  forgetNewPCCalls(Instruction->getParent());
+}
+
+const JumpTargetManager::NewPCCallsVector &
+JumpTargetManager::newPCCalls(const BasicBlock *BB) const {
+  auto It = NewPCCallsCache.find(BB);
+  if (It != NewPCCallsCache.end())
+    return It->second;
+
+  NewPCCallsVector &Result = NewPCCallsCache[BB];
+  for (const Instruction &I : *BB) {
+    if (auto *Call = dyn_cast<CallInst>(&I)) {
+      // TODO: comparing strings is not very elegant
+      auto *Callee = Call->getCalledFunction();
+      if (Callee != nullptr && Callee->getName() == "newpc")
+        Result.push_back(const_cast<CallInst *>(Call));
+    }
+  }
+
+  return Result;
 }
 
 // TODO: this is a candidate for BFSVisit
 std::pair<MetaAddress, uint64_t>
 JumpTargetManager::getPC(Instruction *TheInstruction) const {
+  using GCBI = GeneratedCodeBasicInfo;
   CallInst *NewPCCall = nullptr;
   std::set<BasicBlock *> Visited;
-  std::queue<BasicBlock::reverse_iterator> WorkList;
-  if (TheInstruction->getIterator() == TheInstruction->getParent()->begin())
-    WorkList.push(--TheInstruction->getParent()->rend());
+  std::queue<BasicBlock *> WorkList;
+
+  auto EnqueuePredecessors = [&WorkList, &Visited](BasicBlock *BB) {
+    // Assert we didn't reach the almighty dispatcher
+    for (BasicBlock *Predecessor : predecessors(BB))
+      revng_assert(not GCBI::isPartOfRootDispatcher(Predecessor));
+
+    for (BasicBlock *Predecessor : predecessors(BB)) {
+      // Ignore already visited or empty BBs
+      if (!Predecessor->empty()
+          && Visited.find(Predecessor) == Visited.end()) {
+        WorkList.push(Predecessor);
+        Visited.insert(Predecessor);
+      }
+    }
+  };
+
+  // Look for the last call to newpc preceding the requested instruction in its
+  // own basic block
+  BasicBlock *BB = TheInstruction->getParent();
+  const NewPCCallsVector &Calls = newPCCalls(BB);
+  auto ComesBefore = [TheInstruction](CallInst *Call) {
+    return Call->comesBefore(TheInstruction);
+  };
+  auto It = llvm::partition_point(Calls, ComesBefore);
+  if (It != Calls.begin())
+    NewPCCall = *std::prev(It);
   else
-    WorkList.push(++TheInstruction->getReverseIterator());
+    EnqueuePredecessors(BB);
 
+  // Continue exploration backward, considering the last call to newpc of each
+  // predecessor
   while (!WorkList.empty()) {
-    auto I = WorkList.front();
+    BasicBlock *Predecessor = WorkList.front();
     WorkList.pop();
-    auto *BB = I->getParent();
-    auto End = BB->rend();
-
-    // Go through the instructions looking for calls to newpc
-    for (; I != End; I++) {
-      if (auto Marker = dyn_cast<CallInst>(&*I)) {
-        // TODO: comparing strings is not very elegant
-        auto *Callee = Marker->getCalledFunction();
-        if (Callee != nullptr && Callee->getName() == "newpc") {
 
-          // We found two distinct newpc leading to the requested instruction
-          if (NewPCCall != nullptr)
-            return { MetaAddress::invalid(), 0 };
+    const NewPCCallsVector &PredecessorCalls = newPCCalls(Predecessor);
+    if (not PredecessorCalls.empty()) {
+      // We found two distinct newpc leading to the requested instruction
+      if (NewPCCall != nullptr)
+        return { MetaAddress::invalid(), 0 };
 
-          NewPCCall = Marker;
-          break;
-        }
-      }
+      NewPCCall = PredecessorCalls.back();
     }
 
-    // If we haven't find a newpc call yet, continue exploration backward
-    if (NewPCCall == nullptr) {
-      // If one of the predecessors is the dispatcher, don't explore any further
-      for (BasicBlock *Predecessor : predecessors(BB)) {
-        // Assert we didn't reach the almighty dispatcher
-        using GCBI = GeneratedCodeBasicInfo;
-        revng_assert(not(NewPCCall == nullptr
-                         and GCBI::isPartOfRootDispatcher(Predecessor)));
-        if (GCBI::isPartOfRootDispatcher(Predecessor))
-          continue;
-      }
-
-      for (BasicBlock *Predecessor : predecessors(BB)) {
-        // Ignore already visited or empty BBs
-        if (!Predecessor->empty()
-            && Visited.find(Predecessor) == Visited.end()) {
-          WorkList.push(Predecessor->rbegin());
-          Visited.insert(Predecessor);
-        }
-      }
-    }
+    if (NewPCCall == nullptr)
+      EnqueuePredecessors(Predecessor);
   }
 
   // Couldn't find the current PC
@@ -763,6 +1133,10 @@ void JumpTargetManager::translateIndirectJumps() {
   if (ExitTB->use_empty())
     return;
 
+  // Since the harvesting, the function went through passes that might have
+  // moved code across basic blocks
+  PCH->forgetAllPCEvents();
+
   auto I = ExitTB->use_begin();
   while (I != ExitTB->use_end()) {
     Use &ExitTBUse = *I++;
@@ -776,7 +1150,7 @@ void JumpTargetManager::translateIndirectJumps() {
                     and "Direct jumps should not be handled here");
 
         if (getLimitedValue(Call->getArgOperand(0)) == 0) {
-          exitTBCleanup(Call);
+          exitTBCleanup(this, Call);
           BranchInst::Create(AnyPC, Call);
         }
 
@@ -793,8 +1167,13 @@ void JumpTargetManager::translateIndirectJumps() {
 JumpTargetManager::BlockWithAddress JumpTargetManager::peek() {
   // If we just harvested new branches, keep exploring
   do {
+    if (not Partial)
+      if (const char *Budget = exhaustedBudget())
+        stopExploration(Budget);
+
     harvest();
-  } while (Unexplored.empty() and NewBranches != 0);
+  } while (Unexplored.empty()
+           and (NewBranches != 0 or exchangeWithOtherShards()));
 
   // Purge all the partial translations we know might be wrong
   for (BasicBlock *BB : ToPurge)
@@ -803,20 +1182,114 @@ JumpTargetManager::BlockWithAddress JumpTargetManager::peek() {
 
   if (Unexplored.empty()) {
     revng_log(JTCountLog, "We're done looking for jump targets");
+    if (Scope or Shard)
+      dropOutOfScope();
     return NoMoreTargets;
   } else {
     BlockWithAddress Result = Unexplored.back();
     Unexplored.pop_back();
+    TranslatedSinceHarvest.insert(Result.first);
+
+    // The jump targets found from here on are one step further
+    if (Scope) {
+      auto It = Depths.find(Result.first);
+      NextDepth = (It != Depths.end() ? It->second : 0) + 1;
+    }
+
     return Result;
   }
 }
 
+bool JumpTargetManager::exchangeWithOtherShards() {
+  if (not Shard or Partial)
+    return false;
+
+  return ShardExchange();
+}
+
+void JumpTargetManager::dropOutOfScope() {
+  revng_log(JTCountLog,
+            OutOfScope.size() << " jump targets are out of scope");
+
+  for (auto &[PC, Placeholder] : OutOfScope) {
+    Placeholder->replaceAllUsesWith(Dispatcher);
+    Placeholder->eraseFromParent();
+  }
+
+  OutOfScope.clear();
+  Placeholders.clear();
+}
+
+const char *JumpTargetManager::exhaustedBudget() const {
+  if (MaxHarvestRounds != 0 and HarvestRounds >= MaxHarvestRounds)
+    return "harvest rounds";
+
+  if (MaxHarvestTime != 0) {
+    using namespace std::chrono;
+    auto Elapsed = steady_clock::now() - ExplorationStart;
+    if (duration_cast<seconds>(Elapsed).count() >= MaxHarvestTime)
+      return "harvest time";
+  }
+
+  if (MaxRSS != 0) {
+    // ru_maxrss is in KiB on Linux
+    rusage Usage;
+    if (getrusage(RUSAGE_SELF, &Usage) == 0
+        and static_cast<uint64_t>(Usage.ru_maxrss) >= MaxRSS * 1024ULL)
+      return "resident set size";
+  }
+
+  return nullptr;
+}
+
+void JumpTargetManager::stopExploration(const char *Reason) {
+  revng_log(JTCountLog,
+            "Out of " << Reason << " budget, giving up on "
+                      << Unexplored.size() << " jump targets");
+  dbg << "Warning: the exploration ran out of " << Reason
+      << " budget, the translation is partial\n";
+
+  Partial = true;
+  NewBranches = 0;
+
+  // The partial translations are kept, purging them would require translating
+  // them again
+  ToPurge.clear();
+
+  // Collect the jump targets that have not been translated at all
+  std::set<MetaAddress> Dropped;
+  std::vector<BasicBlock *> Empty;
+  for (auto &[PC, BB] : Unexplored) {
+    if (BB->empty() and Dropped.insert(PC).second)
+      Empty.push_back(BB);
+  }
+  Unexplored.clear();
+
+  // Take them out of the dispatcher before replacing them with it
+  JumpTargets.eraseIf([&Dropped](const MetaAddress &PC, const JumpTarget &) {
+    return Dropped.count(PC) != 0;
+  });
+  if (DispatcherSwitch != nullptr)
+    rebuildDispatcher(nullptr);
+
+  for (BasicBlock *BB : Empty) {
+    forgetNewPCCalls(BB);
+    BB->replaceAllUsesWith(Dispatcher);
+    BB->eraseFromParent();
+  }
+
+  updateNewPCIsJT(nullptr);
+}
+
 BasicBlock *JumpTargetManager::getBlockAt(MetaAddress PC) {
   revng_assert(PC.isValid());
 
-  auto TargetIt = JumpTargets.find(PC);
-  revng_assert(TargetIt != JumpTargets.end());
-  return TargetIt->second.head();
+  if (JumpTarget *JT = findJT(PC))
+    return JT->head();
+
+  auto It = OutOfScope.find(PC);
+  revng_assert(It != OutOfScope.end());
+  return It->second;
 }
 
 /// \brief Check if among \p BB's predecessors there's \p Target
@@ -838,7 +1311,8 @@ void JumpTargetManager::purgeTranslation(BasicBlock *Start) {
     Instruction *Terminator = BB->getTerminator();
     for (BasicBlock *Successor : successors(Terminator)) {
       if (isTranslatedBB(Successor) and not isJumpTarget(Successor)
-          and not hasRootDispatcherPredecessor(Successor)) {
+          and not hasRootDispatcherPredecessor(Successor)
+          and Placeholders.count(Successor) == 0) {
         Queue.insert(Successor);
       }
     }
@@ -846,6 +1320,8 @@ void JumpTargetManager::purgeTranslation(BasicBlock *Start) {
 
   // Erase all the visited basic blocks
   std::set<BasicBlock *> Visited = Queue.visited();
+  for (BasicBlock *BB : Visited)
+    forgetNewPCCalls(BB);
 
   // Build a subgraph, so that we can visit it in post order, and purge the
   // content of each basic block
@@ -857,7 +1333,7 @@ void JumpTargetManager::purgeTranslation(BasicBlock *Start) {
 
       if (CallInst *Call = getCallTo(I, "newpc")) {
         auto *Address = Call->getArgOperand(0);
-        OriginalInstructionAddresses.erase(MetaAddress::fromConstant(Address));
+        OriginalInstructionAddresses.erase(MAConstants.fromConstant(Address));
       }
       eraseInstruction(I);
     }
@@ -872,6 +1348,7 @@ void JumpTargetManager::purgeTranslation(BasicBlock *Start) {
     while (pred_begin(BB) != pred_end(BB)) {
       BasicBlock *Predecessor = *pred_begin(BB);
       revng_assert(pred_empty(Predecessor));
+      forgetNewPCCalls(Predecessor);
       Predecessor->eraseFromParent();
     }
 
@@ -893,18 +1370,20 @@ JumpTargetManager::registerJT(MetaAddress PC, JTReason::Values Reason) {
                               << JTReason::getName(Reason));
 
   // Do we already have a BasicBlock for this PC?
-  BlockMap::iterator TargetIt = JumpTargets.find(PC);
-  if (TargetIt != JumpTargets.end()) {
+  if (JumpTarget *JT = findJT(PC)) {
     // Case 1: there's already a BasicBlock for that address, return it
-    BasicBlock *BB = TargetIt->second.head();
-    TargetIt->second.setReason(Reason);
+    BasicBlock *BB = JT->head();
+    JT->setReason(Reason);
     return BB;
   }
 
   // Did we already meet this PC (i.e. do we know what's the associated
   // instruction)?
   BasicBlock *NewBlock = nullptr;
-  InstructionMap::iterator InstrIt = OriginalInstructionAddresses.find(PC);
+  auto InstrIt = OriginalInstructionAddresses.end();
+  if (InstructionStarts.mayContain(PC))
+    InstrIt = OriginalInstructionAddresses.find(PC);
+  auto OutOfScopeIt = OutOfScope.find(PC);
   if (InstrIt != OriginalInstructionAddresses.end()) {
     // Case 2: the address has already been met, but needs to be promoted to
     //         BasicBlock level.
@@ -915,6 +1394,7 @@ JumpTargetManager::registerJT(MetaAddress PC, JTReason::Values Reason) {
     } else {
       revng_assert(I != nullptr && I->getIterator() != ContainingBlock->end());
       NewBlock = ContainingBlock->splitBasicBlock(I);
+      forgetNewPCCalls(ContainingBlock);
     }
 
     // Register the basic block and all of its descendants to be purged so that
@@ -922,6 +1402,43 @@ JumpTargetManager::registerJT(MetaAddress PC, JTReason::Values Reason) {
     // TODO: this might create a problem if QEMU generates control flow that
     //       crosses an instruction boundary
     ToPurge.insert(NewBlock);
+    PromotedSinceHarvest.insert(PC);
+
+    // The translation is already there, the placeholder is no longer needed
+    if (OutOfScopeIt != OutOfScope.end()) {
+      BasicBlock *Placeholder = OutOfScopeIt->second;
+      Placeholder->replaceAllUsesWith(NewBlock);
+      Placeholder->eraseFromParent();
+      Placeholders.erase(Placeholder);
+      OutOfScope.erase(OutOfScopeIt);
+    }
+
+  } else if (OutOfScopeIt != OutOfScope.end()) {
+    // Case 4: the address has been met, but it was out of the scope of the
+    //         exploration
+    if (not isInScope(PC)) {
+      if (Shard and not Shard->contains(PC.address()))
+        OutOfShard[PC] |= static_cast<uint32_t>(Reason);
+      return OutOfScopeIt->second;
+    }
+
+    // It's in scope now, turn the placeholder in a block to translate
+    NewBlock = OutOfScopeIt->second;
+    NewBlock->getTerminator()->eraseFromParent();
+    Placeholders.erase(NewBlock);
+    OutOfScope.erase(OutOfScopeIt);
+
+  } else if (not isInScope(PC)) {
+    // Case 5: the address has never been met and it's out of the scope of the
+    //         exploration, create a placeholder jumping to the dispatcher
+    if (Shard and not Shard->contains(PC.address()))
+      OutOfShard[PC] |= static_cast<uint32_t>(Reason);
+    NewBlock = BasicBlock::Create(Context, "", TheFunction);
+    BranchInst::Create(Dispatcher, NewBlock);
+    NewBlock->setName("outofscope." + nameForAddress(PC));
+    OutOfScope[PC] = NewBlock;
+    Placeholders.insert(NewBlock);
+    return NewBlock;
 
   } else {
     // Case 3: the address has never been met, create a temporary one, register
@@ -929,6 +1446,9 @@ JumpTargetManager::registerJT(MetaAddress PC, JTReason::Values Reason) {
     NewBlock = BasicBlock::Create(Context, "", TheFunction);
   }
 
+  if (Scope)
+    Depths.try_emplace(PC, NextDepth);
+
   Unexplored.push_back(BlockWithAddress(PC, NewBlock));
 
   std::stringstream Name;
@@ -944,7 +1464,8 @@ JumpTargetManager::registerJT(MetaAddress PC, JTReason::Values Reason) {
   }
 
   // Associate the PC with the chosen basic block
-  JumpTargets[PC] = JumpTarget(NewBlock, Reason);
+  JumpTargets.insert(PC, JumpTarget(NewBlock, Reason));
+  JumpTargetStarts.set(PC);
 
   // PC was not a jump target, record it as new
   AVIPCWhiteList.insert(PC);
@@ -953,8 +1474,28 @@ JumpTargetManager::registerJT(MetaAddress PC, JTReason::Values Reason) {
 }
 
 void JumpTargetManager::registerReadRange(MetaAddress Address, uint64_t Size) {
-  using interval = boost::icl::interval<MetaAddress, compareAddress>;
-  ReadIntervalSet += interval::right_open(Address, Address + Size);
+  // Jump tables are read in order: extend the pending range as long as the
+  // reads are contiguous, and only then merge it in ReadIntervalSet
+  MetaAddress End = Address + Size;
+  auto &[PendingStart, PendingEnd] = PendingReadRange;
+  if (Address.addressIsComparableWith(PendingStart)
+      and End.addressIsComparableWith(PendingEnd)
+      and Address.addressGreaterThanOrEqual(PendingStart)
+      and Address.addressLowerThanOrEqual(PendingEnd)) {
+    if (End.addressGreaterThan(PendingEnd))
+      PendingEnd = End;
+    return;
+  }
+
+  flushReadRange();
+  PendingReadRange = { Address, End };
+}
+
+void JumpTargetManager::flushReadRange() {
+  auto &[PendingStart, PendingEnd] = PendingReadRange;
+  if (PendingStart.isValid())
+    ReadIntervalSet.insert(PendingStart.address(), PendingEnd.address());
+  PendingReadRange = { MetaAddress::invalid(), MetaAddress::invalid() };
 }
 
 void JumpTargetManager::prepareDispatcher() {
@@ -1015,6 +1556,58 @@ std::set<BasicBlock *> JumpTargetManager::computeUnreachable() const {
   return Unreachable;
 }
 
+void JumpTargetManager::eraseUnreachable() {
+  BasicBlock *Entry = &TheFunction->getEntryBlock();
+
+  // The root dispatcher goes to all the jump targets
+  auto IsSurelyReachable = [this, Entry](BasicBlock *BB) {
+    return BB == Entry or not isTranslatedBB(BB)
+           or hasRootDispatcherPredecessor(BB);
+  };
+
+  std::set<BasicBlock *> Unreachable;
+  while (not MaybeUnreachable.empty()) {
+    Value *V = MaybeUnreachable.back();
+    MaybeUnreachable.pop_back();
+    auto *BB = cast_or_null<BasicBlock>(V);
+    if (BB == nullptr or Unreachable.count(BB) != 0)
+      continue;
+
+    // Proceed backward looking for a basic block we know is reachable. If we
+    // can't find one, all the visited basic blocks are unreachable, since none
+    // of them has a predecessor outside of the visited set.
+    df_iterator_default_set<BasicBlock *> Visited;
+    bool Reachable = false;
+    for (BasicBlock *Predecessor : inverse_depth_first_ext(BB, Visited)) {
+      if (IsSurelyReachable(Predecessor)) {
+        Reachable = true;
+        break;
+      }
+    }
+
+    if (Reachable)
+      continue;
+
+    // The successors of what we're erasing might be unreachable too
+    for (BasicBlock *Dead : Visited) {
+      Unreachable.insert(Dead);
+      recordRemovedEdges(Dead);
+    }
+  }
+
+  if (Unreachable.size() != 0) {
+    // Safely erase all unreachable blocks
+    for (BasicBlock *BB : Unreachable)
+      BB->dropAllReferences();
+    for (BasicBlock *BB : Unreachable)
+      BB->eraseFromParent();
+    NewPCCallsCache.clear();
+  }
+
+  if (VerifyLog.isEnabled())
+    assertNoUnreachable();
+}
+
 void JumpTargetManager::setCFGForm(CFGForm::Values NewForm,
                                    MetaAddressSet *JumpTargetsWhitelist) {
   revng_assert(CurrentCFGForm != NewForm);
@@ -1094,9 +1687,11 @@ void JumpTargetManager::setCFGForm(CFGForm::Values NewForm,
   }
 }
 
-void JumpTargetManager::rebuildDispatcher(MetaAddressSet *Whitelist) {
+void JumpTargetManager::rebuildDispatcher(MetaAddressSet *Whitelist,
+                                          bool FromScratch) {
+  bool Update = DispatcherSwitch != nullptr and not FromScratch;
 
-  if (DispatcherSwitch != nullptr) {
+  if (DispatcherSwitch != nullptr and not Update) {
     revng_assert(DispatcherSwitch->getParent() == Dispatcher);
 
     // Purge the old dispatcher
@@ -1119,14 +1714,37 @@ void JumpTargetManager::rebuildDispatcher(MetaAddressSet *Whitelist) {
   }
 
   constexpr auto RDHB = BlockType::RootDispatcherHelperBlock;
-  const auto &DispatcherInfo = PCH->buildDispatcher(Targets,
-                                                    Dispatcher,
-                                                    DispatcherFail,
-                                                    RDHB);
-  DispatcherSwitch = DispatcherInfo.Switch;
+  if (Update) {
+    revng_assert(DispatcherSwitch->getParent() == Dispatcher);
+
+    // Targets is sorted, since JumpTargets is. Drop all the cases that are not
+    // in Targets, and take note of those that are already there.
+    auto Compare = [](const ProgramCounterHandler::DispatcherTarget &Target,
+                      const MetaAddress &PC) { return Target.first < PC; };
+    std::vector<bool> Present(Targets.size(), false);
+    auto Keep = [&](const ProgramCounterHandler::DispatcherTarget &Case) {
+      auto It = llvm::lower_bound(Targets, Case.first, Compare);
+      if (It == Targets.end() or *It != Case)
+        return false;
+
+      Present[It - Targets.begin()] = true;
+      return true;
+    };
+    PCH->pruneDispatcher(DispatcherSwitch, Keep);
 
-  // The switch is the terminator of the dispatcher basic block
-  setBlockType(DispatcherSwitch, BlockType::RootDispatcherBlock);
+    for (unsigned I = 0; I < Targets.size(); I++)
+      if (not Present[I])
+        PCH->addCaseToDispatcher(DispatcherSwitch, Targets[I], RDHB);
+  } else {
+    const auto &DispatcherInfo = PCH->buildDispatcher(Targets,
+                                                      Dispatcher,
+                                                      DispatcherFail,
+                                                      RDHB);
+    DispatcherSwitch = DispatcherInfo.Switch;
+
+    // The switch is the terminator of the dispatcher basic block
+    setBlockType(DispatcherSwitch, BlockType::RootDispatcherBlock);
+  }
 
   //
   // Make sure every generated basic block is reachable
@@ -1162,6 +1780,68 @@ void JumpTargetManager::rebuildDispatcher(MetaAddressSet *Whitelist) {
   }
 }
 
+void JumpTargetManager::restrictToRecovered(Function *Clone,
+                                            ValueToValueMapTy &OldToNew,
+                                            const MetaAddressSet &Whitelist) {
+  revng_assert(Clone != TheFunction);
+
+  auto Map = [&OldToNew](BasicBlock *BB) {
+    return cast<BasicBlock>(OldToNew[BB]);
+  };
+  BasicBlock *CloneAnyPC = Map(AnyPC);
+  BasicBlock *CloneUnexpectedPC = Map(UnexpectedPC);
+  BasicBlock *CloneDispatcher = Map(Dispatcher);
+  BasicBlock *CloneDispatcherFail = Map(DispatcherFail);
+  auto *CloneSwitch = cast<SwitchInst>(CloneDispatcher->getTerminator());
+
+  // Jumps to any PC and to an unexpected PC lead nowhere
+  purge(CloneAnyPC);
+  setBlockType(new UnreachableInst(Context, CloneAnyPC),
+               BlockType::AnyPCBlock);
+  purge(CloneUnexpectedPC);
+  setBlockType(new UnreachableInst(Context, CloneUnexpectedPC),
+               BlockType::UnexpectedPCBlock);
+
+  // Same as isTranslatedBB, but on the copy
+  auto IsTranslated = [&](BasicBlock *BB) {
+    return BB != CloneAnyPC and BB != CloneUnexpectedPC
+           and BB != CloneDispatcher and BB != CloneDispatcherFail;
+  };
+
+  // Keep in the dispatcher only the whitelisted jump targets with no other
+  // predecessor
+  auto Keep = [&](const ProgramCounterHandler::DispatcherTarget &Case) {
+    return Whitelist.count(Case.first) != 0
+           and llvm::none_of(predecessors(Case.second), IsTranslated);
+  };
+  PCH->pruneDispatcher(CloneSwitch, Keep);
+
+  // Add back the unreachable jump targets whose reason is not just direct jump
+  OnceQueue<BasicBlock *> WorkList;
+  for (BasicBlock *Successor : successors(CloneSwitch))
+    WorkList.insert(Successor);
+
+  while (not WorkList.empty()) {
+    BasicBlock *BB = WorkList.pop();
+    for (BasicBlock *Successor : successors(BB))
+      WorkList.insert(Successor);
+  }
+
+  std::set<BasicBlock *> Reachable = WorkList.visited();
+  for (const auto &[PC, JT] : JumpTargets) {
+    BasicBlock *BB = Map(JT.head());
+    if (Reachable.count(BB) == 0 and Whitelist.count(PC) != 0
+        and not JT.isOnlyReason(JTReason::DirectJump)) {
+      PCH->addCaseToDispatcher(CloneSwitch,
+                               { PC, BB },
+                               BlockType::RootDispatcherHelperBlock);
+    }
+  }
+
+  // Drop whatever can no longer be reached
+  removeUnreachableBlocks(*Clone);
+}
+
 bool JumpTargetManager::hasPredecessors(BasicBlock *BB) const {
   for (BasicBlock *Pred : predecessors(BB))
     if (isTranslatedBB(Pred))
@@ -1227,87 +1907,67 @@ public:
   }
 };
 
-void JumpTargetManager::aliasAnalysis() {
-  unsigned AliasScopeMDKindID = TheModule.getMDKindID("alias.scope");
-  unsigned NoAliasMDKindID = TheModule.getMDKindID("noalias");
+bool JumpTargetManager::isCSV(const Value *V) {
+  auto *Global = dyn_cast<GlobalVariable>(V);
+  if (Global == nullptr)
+    return false;
 
-  LLVMContext &Context = TheModule.getContext();
-  QuickMetadata QMD(Context);
-  MDBuilder MDB(Context);
-  MDNode *CSVDomain = MDB.createAliasScopeDomain("CSVAliasDomain");
+  // Collect the CSVs again only if the list has been rebuilt in the meantime
+  const MDNode *List = nullptr;
+  if (NamedMDNode *NamedMD = TheModule.getNamedMetadata("revng.csv"))
+    if (NamedMD->getNumOperands() != 0)
+      List = NamedMD->getOperand(0);
+
+  if (not CSVList or *CSVList != List) {
+    CSVs.clear();
+    QuickMetadata QMD(TheModule.getContext());
+    if (List != nullptr)
+      for (const MDOperand &Operand : List->operands()) {
+        auto *CSV = QMD.extract<Constant *>(Operand.get());
+        CSVs.insert(cast<GlobalVariable>(CSV));
+      }
 
-  struct CSVAliasInfo {
-    MDNode *AliasScope;
-    MDNode *AliasSet;
-    MDNode *NoAliasSet;
-  };
-  std::map<const GlobalVariable *, CSVAliasInfo> CSVAliasInfoMap;
+    for (GlobalVariable *PCCSV : PCH->pcCSVs())
+      CSVs.insert(PCCSV);
 
-  std::set<GlobalVariable *> CSVs;
-  NamedMDNode *NamedMD = TheModule.getOrInsertNamedMetadata("revng.csv");
-  auto *Tuple = cast<MDTuple>(NamedMD->getOperand(0));
-  for (const MDOperand &Operand : Tuple->operands()) {
-    auto *CSV = cast<GlobalVariable>(QMD.extract<Constant *>(Operand.get()));
-    CSVs.insert(CSV);
-  }
-
-  for (GlobalVariable *PCCSV : PCH->pcCSVs())
-    CSVs.insert(PCCSV);
-
-  // Build alias scopes
-  std::vector<Metadata *> AllCSVScopes;
-  for (const GlobalVariable *CSV : CSVs) {
-    CSVAliasInfo &AliasInfo = CSVAliasInfoMap[CSV];
-
-    std::string Name = CSV->getName().str();
-    MDNode *CSVScope = MDB.createAliasScope(Name, CSVDomain);
-    AliasInfo.AliasScope = CSVScope;
-    AllCSVScopes.push_back(CSVScope);
-    MDNode *CSVAliasSet = MDNode::get(Context,
-                                      ArrayRef<Metadata *>({ CSVScope }));
-    AliasInfo.AliasSet = CSVAliasSet;
-  }
-  MDNode *MemoryAliasSet = MDNode::get(Context, AllCSVScopes);
-
-  // Build noalias sets
-  for (const GlobalVariable *CSV : CSVs) {
-    CSVAliasInfo &AliasInfo = CSVAliasInfoMap[CSV];
-    std::vector<Metadata *> OtherCSVScopes;
-    for (const auto &Q : CSVAliasInfoMap)
-      if (Q.first != CSV)
-        OtherCSVScopes.push_back(Q.second.AliasScope);
-
-    MDNode *CSVNoAliasSet = MDNode::get(Context, OtherCSVScopes);
-    AliasInfo.NoAliasSet = CSVNoAliasSet;
-  }
-
-  // Decorate the IR with alias information
-  for (Function &F : TheModule) {
-    for (BasicBlock &BB : F) {
-      for (Instruction &I : BB) {
-        Value *Ptr = nullptr;
-
-        if (auto *L = dyn_cast<LoadInst>(&I))
-          Ptr = L->getPointerOperand();
-        else if (auto *S = dyn_cast<StoreInst>(&I))
-          Ptr = S->getPointerOperand();
-        else
-          continue;
+    CSVList = List;
+  }
 
-        // Check if the pointer is a CSV
-        if (auto *GV = dyn_cast<GlobalVariable>(Ptr)) {
-          auto It = CSVAliasInfoMap.find(GV);
-          if (It != CSVAliasInfoMap.end()) {
-            // Set alias.scope and noalias metadata
-            I.setMetadata(AliasScopeMDKindID, It->second.AliasSet);
-            I.setMetadata(NoAliasMDKindID, It->second.NoAliasSet);
-            continue;
-          }
-        }
+  return CSVs.count(Global) != 0;
+}
 
-        // It's not a CSV memory access, set noalias info
-        I.setMetadata(NoAliasMDKindID, MemoryAliasSet);
-      }
+void JumpTargetManager::setCSVAliasScopes(Instruction &I) {
+  Value *Ptr = nullptr;
+  if (auto *L = dyn_cast<LoadInst>(&I))
+    Ptr = L->getPointerOperand();
+  else if (auto *S = dyn_cast<StoreInst>(&I))
+    Ptr = S->getPointerOperand();
+  else
+    return;
+
+  // The scope is created once per module and shared by all the accesses
+  if (CSVScope == nullptr) {
+    LLVMContext &Context = TheModule.getContext();
+    MDBuilder MDB(Context);
+    MDNode *CSVDomain = MDB.createAliasScopeDomain("CSVAliasDomain");
+    MDNode *Scope = MDB.createAliasScope("CSVs", CSVDomain);
+    CSVScope = MDNode::get(Context, ArrayRef<Metadata *>({ Scope }));
+  }
+
+  if (isCSV(Ptr))
+    I.setMetadata(LLVMContext::MD_alias_scope, CSVScope);
+  else
+    I.setMetadata(LLVMContext::MD_noalias, CSVScope);
+}
+
+void JumpTargetManager::aliasAnalysis(Function &F) {
+  for (BasicBlock &BB : F) {
+    for (Instruction &I : BB) {
+      if (I.hasMetadata(LLVMContext::MD_alias_scope)
+          or I.hasMetadata(LLVMContext::MD_noalias))
+        continue;
+
+      setCSVAliasScopes(I);
     }
   }
 }
@@ -1364,10 +2024,14 @@ private:
   std::vector<TrackedValue> TrackedValues;
   QuickMetadata QMD;
   llvm::Function *AVIMarker;
+  llvm::StructType *MetaAddressStruct;
   IRBuilder<> Builder;
 
 public:
-  AnalysisRegistry(Module *M) : QMD(getContext(M)), Builder(getContext(M)) {
+  AnalysisRegistry(Module *M) :
+    QMD(getContext(M)),
+    MetaAddressStruct(MetaAddress::getStruct(M)),
+    Builder(getContext(M)) {
     AVIMarker = AdvancedValueInfoPass::createMarker(M);
   }
 
@@ -1389,11 +2053,15 @@ public:
     // identifier. This is necessary since the instruction itself could be
     // deleted, duplicated and what not. Later on, we will use TrackedValues
     // to now the values that have been identified to which value in the
-    // original function did they belong to
+    // original function did they belong to. The third argument is the
+    // address of the instruction, AdvancedValueInfoPass uses it to look up
+    // the results of the previous rounds
     uint32_t AVIID = TrackedValues.size();
     Builder.SetInsertPoint(InstructionToTrack->getNextNode());
     Builder.CreateCall(AVIMarker,
-                       { InstructionToTrack, Builder.getInt32(AVIID) });
+                       { InstructionToTrack,
+                         Builder.getInt32(AVIID),
+                         Address.toConstant(MetaAddressStruct) });
     TrackedValue NewTV{ Address,
                         Type,
                         cast_or_null<Instruction>(OriginalValue) };
@@ -1440,15 +2108,18 @@ JumpTargetManager::MetaAddressSet JumpTargetManager::inflateAVIWhitelist() {
   return Result;
 }
 
-void JumpTargetManager::harvestWithAVI() {
+void JumpTargetManager::harvestWithAVI(const std::set<BasicBlock *> *Region) {
   Module *M = TheFunction->getParent();
 
   //
   // Update CPUStateAccessAnalysisPass
   //
-  legacy::PassManager PM;
+  TracedPassManager PM;
   PM.add(createCSAA());
-  PM.add(new FunctionCallIdentification);
+  if (Region != nullptr)
+    PM.add(new FunctionCallIdentification(*Region, FCIState));
+  else
+    PM.add(new FunctionCallIdentification);
   PM.run(TheModule);
 
   //
@@ -1494,14 +2165,6 @@ void JumpTargetManager::harvestWithAVI() {
     // Compute AVIJumpTargetWhitelist
     auto AVIJumpTargetWhitelist = inflateAVIWhitelist();
 
-    // Prune the dispatcher
-    setCFGForm(CFGForm::RecoveredOnly, &AVIJumpTargetWhitelist);
-
-    // Detach all the unreachable basic blocks, so they don't get copied
-    std::set<BasicBlock *> UnreachableBBs = computeUnreachable();
-    for (BasicBlock *UnreachableBB : UnreachableBBs)
-      UnreachableBB->removeFromParent();
-
     // Clone the function
     OptimizedFunction = CloneFunction(TheFunction, OldToNew);
 
@@ -1509,18 +2172,13 @@ void JumpTargetManager::harvestWithAVI() {
     for (auto [U, BB] : Undo)
       U->set(BB);
 
+    // Prune the dispatcher of the copy only, the root function is left as is
+    restrictToRecovered(OptimizedFunction, OldToNew, AVIJumpTargetWhitelist);
+
     // Record the size of OptimizedFunction
     size_t BlocksCount = OptimizedFunction->getBasicBlockList().size();
     BlocksAnalyzedByAVI.push(BlocksCount);
 
-    // Reattach the unreachable basic blocks to the original root function
-    for (BasicBlock *UnreachableBB : UnreachableBBs)
-      UnreachableBB->insertInto(TheFunction);
-
-    // Restore the dispatcher in the original function
-    setCFGForm(CFGForm::SemanticPreserving);
-    revng_assert(computeUnreachable().size() == 0);
-
     // Clear the whitelist
     AVIPCWhiteList.clear();
   }
@@ -1534,8 +2192,9 @@ void JumpTargetManager::harvestWithAVI() {
     if (auto *Call = dyn_cast<CallInst>(U)) {
       BasicBlock *BB = Call->getParent();
       if (BB->getParent() == TheFunction) {
+        // Ignore calls that have not been cloned or that have been pruned
         auto It = OldToNew.find(Call);
-        if (It == OldToNew.end())
+        if (It == OldToNew.end() or It->second == nullptr)
           continue;
         Builder.SetInsertPoint(cast<CallInst>(&*It->second));
         Instruction *ComposedIntegerPC = PCH->composeIntegerPC(Builder);
@@ -1662,9 +2321,9 @@ void JumpTargetManager::harvestWithAVI() {
     Call->eraseFromParent();
 
   //
-  // Update alias analysis
+  // Update alias analysis, the translated code is already decorated
   //
-  aliasAnalysis();
+  aliasAnalysis(*OptimizedFunction);
 
   //
   // Optimize the hell out of it and collect the possible values of indirect
@@ -1708,7 +2367,7 @@ void JumpTargetManager::harvestWithAVI() {
     FPM.addPass(InstCombinePass(true));
     FPM.addPass(EarlyCSEPass(true));
     FPM.addPass(DropRangeMetadataPass());
-    FPM.addPass(AdvancedValueInfoPass(this));
+    FPM.addPass(AdvancedValueInfoPass(this, AVIThreads));
 
     FunctionAnalysisManager FAM;
     FAM.registerPass([]() { return TypeShrinking::BitLivenessPass(); });
@@ -1841,6 +2500,7 @@ void JumpTargetManager::harvestWithAVI() {
   // Drop the optimized function
   //
   OptimizedFunction->eraseFromParent();
+  NewPCCallsCache.clear();
 
   // Drop temporary functions
   SCB.cleanup();
@@ -1854,11 +2514,15 @@ void JumpTargetManager::harvestWithAVI() {
 // translate we proceed as long as we are able to create new edges on the CFG
 // (not considering the dispatcher).
 void JumpTargetManager::harvest() {
+  if (Partial)
+    return;
 
   HarvestingStats.push("harvest 0");
+  TraceScope HarvestScope("harvest");
 
   if (empty()) {
     HarvestingStats.push("harvest 1: SimpleLiterals");
+    TraceScope Scope("harvest 1: SimpleLiterals");
     revng_log(JTCountLog, "Collecting simple literals");
     for (MetaAddress PC : SimpleLiterals)
       registerJT(PC, JTReason::SimpleLiteral);
@@ -1867,32 +2531,25 @@ void JumpTargetManager::harvest() {
 
   if (empty()) {
     HarvestingStats.push("harvest 2: SROA + InstCombine + TBDP");
-
-    // Safely erase all unreachable blocks
-    std::set<BasicBlock *> Unreachable = computeUnreachable();
-    for (BasicBlock *BB : Unreachable)
-      BB->dropAllReferences();
-    for (BasicBlock *BB : Unreachable)
-      BB->eraseFromParent();
+    TraceScope Scope("harvest 2: SROA + InstCombine + TBDP");
+    HarvestRounds++;
+
+    eraseUnreachable();
+
+    // In incremental mode, restrict the work to what changed since the last
+    // round
+    std::set<BasicBlock *> Region;
+    const std::set<BasicBlock *> *RegionPointer = nullptr;
+    if (IncrementalHarvest) {
+      Region = harvestRegion();
+      RegionPointer = &Region;
+      HarvestRegionSize.push(Region.size());
+    }
 
     // TODO: move me to a commit function
-
-    // Update the third argument of newpc calls (isJT, i.e., is this instruction
-    // a jump target?)
-    IRBuilder<> Builder(Context);
-    Function *NewPCFunction = TheModule.getFunction("newpc");
-    if (NewPCFunction != nullptr) {
-      for (User *U : NewPCFunction->users()) {
-        auto *Call = cast<CallInst>(U);
-        if (Call->getParent() != nullptr) {
-          // Report the instruction on the coverage CSV
-          auto PC = MetaAddress::fromConstant(Call->getArgOperand(0));
-
-          bool IsJT = isJumpTarget(PC);
-          Call->setArgOperand(2, Builder.getInt32(static_cast<uint32_t>(IsJT)));
-        }
-      }
-    }
+    updateNewPCIsJT(RegionPointer);
+    TranslatedSinceHarvest.clear();
+    PromotedSinceHarvest.clear();
 
     if (VerifyLog.isEnabled())
       revng_assert(not verifyModule(TheModule, &dbgs()));
@@ -1900,40 +2557,131 @@ void JumpTargetManager::harvest() {
     revng_log(JTCountLog, "Preliminary harvesting");
 
     HarvestingStats.push("InstCombine");
-    legacy::FunctionPassManager OptimizingPM(&TheModule);
-    OptimizingPM.add(createSROAPass());
-    OptimizingPM.add(createInstSimplifyLegacyPass());
-    OptimizingPM.doInitialization();
-    OptimizingPM.run(*TheFunction);
-    OptimizingPM.doFinalization();
+    {
+      TraceScope OptimizeScope("SROA + InstSimplify");
+      legacy::FunctionPassManager OptimizingPM(&TheModule);
+      OptimizingPM.add(createSROAPass());
+      if (not IncrementalHarvest)
+        OptimizingPM.add(createInstSimplifyLegacyPass());
+      OptimizingPM.doInitialization();
+      OptimizingPM.run(*TheFunction);
+      OptimizingPM.doFinalization();
+
+      // SROA only considers the allocas in the entry block, simplify the rest
+      // only where something changed
+      if (IncrementalHarvest)
+        for (BasicBlock *BB : Region)
+          SimplifyInstructionsInBlock(BB);
+    }
 
-    legacy::PassManager PreliminaryBranchesPM;
-    PreliminaryBranchesPM.add(new TranslateDirectBranchesPass(this));
-    PreliminaryBranchesPM.run(TheModule);
+    {
+      TraceScope BranchesScope("TranslateDirectBranches (preliminary)");
+      TracedPassManager PreliminaryBranchesPM;
+      PreliminaryBranchesPM.add(new TranslateDirectBranchesPass(this,
+                                                                RegionPointer));
+      PreliminaryBranchesPM.run(TheModule);
+    }
 
     if (empty()) {
       HarvestingStats.push("harvest 3: harvestWithAVI");
+      TraceScope AVIScope("harvest 3: harvestWithAVI");
       revng_log(JTCountLog, "Harvesting with Advanced Value Info");
-      harvestWithAVI();
+      harvestWithAVI(RegionPointer);
     }
 
-    // TODO: eventually, `setCFGForm` should be replaced by using a CustomCFG
-    // To improve the quality of our analysis, keep in the CFG only the edges we
-    // where able to recover (e.g., no jumps to the dispatcher)
-    setCFGForm(CFGForm::RecoveredOnly);
-
+    // The CFG is left in its SemanticPreserving form: the analyses ignore the
+    // edges coming from the dispatcher, considering only those we were able to
+    // recover
     NewBranches = 0;
-    legacy::PassManager AnalysisPM;
-    AnalysisPM.add(new TranslateDirectBranchesPass(this));
-    AnalysisPM.run(TheModule);
-
-    // Restore the CFG
-    setCFGForm(CFGForm::SemanticPreserving);
+    {
+      TraceScope BranchesScope("TranslateDirectBranches");
+      TracedPassManager AnalysisPM;
+      AnalysisPM.add(new TranslateDirectBranchesPass(this, RegionPointer));
+      AnalysisPM.run(TheModule);
+    }
 
     if (JTCountLog.isEnabled()) {
       JTCountLog << std::dec << Unexplored.size() << " new jump targets and "
                  << NewBranches << " new branches were found" << DoLog;
     }
+
+    // The analyses of this round are gone
+    releaseFreedMemory();
+  }
+}
+
+std::set<BasicBlock *> JumpTargetManager::harvestRegion() {
+  OnceQueue<BasicBlock *> Queue;
+  for (MetaAddress PC : TranslatedSinceHarvest) {
+    if (JumpTarget *JT = findJT(PC))
+      Queue.insert(JT->head());
+  }
+
+  // Collect all the blocks emitted by each translation, stopping at jump
+  // targets, as purgeTranslation does
+  while (!Queue.empty()) {
+    BasicBlock *BB = Queue.pop();
+    Instruction *Terminator = BB->getTerminator();
+    if (Terminator == nullptr)
+      continue;
+
+    for (BasicBlock *Successor : successors(Terminator))
+      if (isTranslatedBB(Successor) and not isJumpTarget(Successor))
+        Queue.insert(Successor);
+  }
+
+  // Include the immediate neighbors, whose instructions might be simplified
+  // thanks to the new code
+  std::set<BasicBlock *> Result = Queue.visited();
+  std::set<BasicBlock *> Neighbors;
+  for (BasicBlock *BB : Result) {
+    for (BasicBlock *Predecessor : predecessors(BB))
+      if (isTranslatedBB(Predecessor))
+        Neighbors.insert(Predecessor);
+
+    if (BB->getTerminator() != nullptr)
+      for (BasicBlock *Successor : successors(BB))
+        if (isTranslatedBB(Successor))
+          Neighbors.insert(Successor);
+  }
+  Result.insert(Neighbors.begin(), Neighbors.end());
+
+  return Result;
+}
+
+void JumpTargetManager::updateNewPCIsJT(const std::set<BasicBlock *> *Region) {
+  IRBuilder<> Builder(Context);
+  Function *NewPCFunction = TheModule.getFunction("newpc");
+  if (NewPCFunction == nullptr)
+    return;
+
+  auto Update = [this, &Builder](CallInst *Call) {
+    auto PC = MAConstants.fromConstant(Call->getArgOperand(0));
+    bool IsJT = isJumpTarget(PC);
+    Call->setArgOperand(2, Builder.getInt32(static_cast<uint32_t>(IsJT)));
+  };
+
+  if (Region == nullptr) {
+    for (User *U : NewPCFunction->users()) {
+      auto *Call = cast<CallInst>(U);
+      if (Call->getParent() != nullptr)
+        Update(Call);
+    }
+    return;
+  }
+
+  // A call to newpc can only change its isJT value when it's emitted or when
+  // its instruction gets promoted to jump target
+  for (BasicBlock *BB : *Region)
+    for (Instruction &I : *BB)
+      if (CallInst *Call = getCallTo(&I, "newpc"))
+        Update(Call);
+
+  for (MetaAddress PC : PromotedSinceHarvest) {
+    BasicBlock *BB = getBlockAt(PC);
+    if (not BB->empty())
+      if (CallInst *Call = getCallTo(&*BB->begin(), "newpc"))
+        Update(Call);
   }
 }
 
@@ -4,7 +4,9 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <chrono>
 #include <cstdint>
+#include <functional>
 #include <map>
 #include <set>
 #include <vector>
@@ -13,14 +15,25 @@
 #include "boost/icl/interval_set.hpp"
 #include "boost/type_traits/is_same.hpp"
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/Optional.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/CFG.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/ValueHandle.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
 
+#include "revng/ADT/IntervalSet.h"
 #include "revng/BasicAnalyses/MaterializedValue.h"
+#include "revng/FunctionCallIdentification/FunctionCallIdentification.h"
 #include "revng/Support/IRHelpers.h"
+#include "revng/Support/MetaAddressConstants.h"
 #include "revng/Support/ProgramCounterHandler.h"
 #include "revng/Support/revng.h"
 
+#include "AVIResultsCache.h"
+#include "AddressIndex.h"
 #include "BinaryFile.h"
 
 // Forward declarations
@@ -67,9 +80,12 @@ typename Map::iterator containing(Map &m, typename Map::key_type const &k) {
 class TranslateDirectBranchesPass : public llvm::ModulePass {
 public:
   TranslateDirectBranchesPass() :
-    llvm::ModulePass(ID), JTM(nullptr), PCH(nullptr) {}
+    llvm::ModulePass(ID), JTM(nullptr), PCH(nullptr), Region(nullptr) {}
 
-  TranslateDirectBranchesPass(JumpTargetManager *JTM);
+  /// \param Region if not null, only the calls to `ExitTB` in these basic
+  ///        blocks are considered by `pinConstantStore`.
+  TranslateDirectBranchesPass(JumpTargetManager *JTM,
+                              const std::set<llvm::BasicBlock *> *Region);
 
   void getAnalysisUsage(llvm::AnalysisUsage &AU) const override;
 
@@ -101,6 +117,7 @@ public:
 private:
   JumpTargetManager *JTM;
   ProgramCounterHandler *PCH;
+  const std::set<llvm::BasicBlock *> *Region;
 };
 
 namespace CFGForm {
@@ -149,7 +166,6 @@ class CPUStateAccessAnalysisPass;
 
 class JumpTargetManager {
 private:
-  using interval_set = boost::icl::interval_set<MetaAddress, compareAddress>;
   using interval = boost::icl::interval<MetaAddress, compareAddress>;
   using MetaAddressSet = std::set<MetaAddress>;
 
@@ -207,7 +223,7 @@ public:
   };
 
 public:
-  using BlockMap = std::map<MetaAddress, JumpTarget>;
+  using BlockMap = FlatAddressMap<JumpTarget>;
   using RangesVector = std::vector<std::pair<MetaAddress, MetaAddress>>;
   using CSAAFactory = std::function<CPUStateAccessAnalysisPass *(void)>;
 
@@ -232,6 +248,42 @@ public:
   /// \brief Collect jump targets from the program's segments
   void harvestGlobalData();
 
+  /// \brief Limit the exploration to the surroundings of the jump targets
+  ///        registered before the first call to peek
+  ///
+  /// New jump targets beyond the limits are not translated. Until they are
+  /// found to be within the limits, they are represented by a placeholder
+  /// jumping to the dispatcher. Once the exploration is over, the placeholders
+  /// are replaced by the dispatcher itself, which will take the execution to
+  /// `unknownPC`.
+  ///
+  /// \param MaxDepth the maximum number of jump targets between an entry point
+  ///        and a jump target to translate.
+  /// \param Budget the maximum number of jump targets to translate, 0 for no
+  ///        limit.
+  void restrictExploration(unsigned MaxDepth, unsigned Budget) {
+    Scope = ExplorationScope{ MaxDepth, Budget };
+  }
+
+  /// \brief Translate only the jump targets in [\p Start, \p End)
+  ///
+  /// The jump targets out of the shard are handled as those beyond the limits
+  /// of the exploration, and they are collected along with their reasons, see
+  /// `outOfShard`. Each time there's nothing left to explore, \p Exchange is
+  /// invoked: it can register new jump targets of the shard, and it returns
+  /// true if it did so, in which case the exploration goes on.
+  void restrictToShard(uint64_t Start,
+                       uint64_t End,
+                       std::function<bool()> Exchange) {
+    Shard = AddressRange{ Start, End };
+    ShardExchange = std::move(Exchange);
+  }
+
+  /// \brief The jump targets out of the shard met so far, with their reasons
+  const std::map<MetaAddress, uint32_t> &outOfShard() const {
+    return OutOfShard;
+  }
+
   /// Handle a new program counter. We might already have a basic block for that
   /// program counter, or we could even have a translation for it. Return one
   /// of these, if appropriate.
@@ -255,6 +307,9 @@ public:
   /// performed.
   llvm::Function *exitTB() { return ExitTB; }
 
+  /// \brief Cached conversions between MetaAddress and llvm::Constant
+  MetaAddressConstants &metaAddressConstants() { return MAConstants; }
+
   /// \brief Pop from the list of program counters to explore
   ///
   /// \return a pair containing the PC and the initial block to use, or
@@ -264,6 +319,22 @@ public:
   /// \brief Return true if no unexplored jump targets are available
   bool empty() { return Unexplored.empty(); }
 
+  /// \brief Return true if the exploration has been stopped since it ran out
+  ///        of budget, i.e., there might be code that has not been translated
+  bool isPartial() const { return Partial; }
+
+  /// \brief Return up to \p Count program counters, in the order `peek` would
+  ///        return them if no new jump targets were registered
+  llvm::SmallVector<MetaAddress, 16> upcoming(size_t Count) const {
+    llvm::SmallVector<MetaAddress, 16> Result;
+    for (auto It = Unexplored.rbegin();
+         It != Unexplored.rend() and Result.size() < Count;
+         ++It) {
+      Result.push_back(It->first);
+    }
+    return Result;
+  }
+
   /// \brief Return true if the whole [\p Start,\p End) range is in an
   ///        executable segment
   bool isExecutableRange(MetaAddress Start, MetaAddress End) const {
@@ -290,7 +361,7 @@ public:
   /// \brief Return true if the given PC is a jump target
   bool isJumpTarget(MetaAddress PC) const {
     revng_assert(PC.isValid());
-    return JumpTargets.count(PC);
+    return findJT(PC) != nullptr;
   }
 
   /// \brief Return true if the given basic block corresponds to a jump target
@@ -338,9 +409,17 @@ public:
   ///         valid or another error occurred.
   llvm::BasicBlock *registerJT(MetaAddress PC, JTReason::Values Reason);
 
+  /// \brief Register \p PC for each of the reasons in the \p Reasons bitmask
+  void registerJTWithReasons(MetaAddress PC, uint32_t Reasons) {
+    uint32_t LastReason = static_cast<uint32_t>(JTReason::LastReason);
+    for (uint32_t Reason = 1; Reason <= LastReason; Reason <<= 1)
+      if ((Reasons & Reason) != 0)
+        registerJT(PC, static_cast<JTReason::Values>(Reason));
+  }
+
   bool hasJT(MetaAddress PC) {
     revng_assert(PC.isValid());
-    return JumpTargets.count(PC) != 0;
+    return findJT(PC) != nullptr;
   }
 
   BlockMap::const_iterator begin() const { return JumpTargets.begin(); }
@@ -384,6 +463,9 @@ public:
   // TODO: can this be replaced by the corresponding method in
   // GeneratedCodeBasicInfo?
   /// \brief Get the PC associated and the size of the original instruction
+  ///
+  /// Only the calls to `newpc` of the basic blocks leading to
+  /// \p TheInstruction are considered, not all of their instructions.
   std::pair<MetaAddress, uint64_t>
   getPC(llvm::Instruction *TheInstruction) const;
 
@@ -394,6 +476,12 @@ public:
     return Pair.first + Pair.second;
   }
 
+  /// \brief Read the value \p Pointer points to from the static memory
+  ///
+  /// The results are memoized: the content of the segments and the labels
+  /// never change. When the reads follow a constant stride, as it happens
+  /// when AVI enumerates a jump table, the next elements are prefetched in
+  /// bulk.
   MaterializedValue
   readFromPointer(llvm::Constant *Pointer, BinaryFile::Endianess E);
 
@@ -403,6 +491,15 @@ public:
     NewBranches += Count;
   }
 
+  /// \brief Take note that the outgoing edges of \p Source are being removed
+  ///
+  /// Call this before dropping or replacing the terminator of \p Source: its
+  /// successors will be checked for reachability at the next harvest.
+  void recordRemovedEdges(llvm::BasicBlock *Source) {
+    for (llvm::BasicBlock *Successor : llvm::successors(Source))
+      MaybeUnreachable.emplace_back(Successor);
+  }
+
   /// \brief Finalizes information about the jump targets
   ///
   /// Call this function once no more jump targets can be discovered.  It will
@@ -418,10 +515,12 @@ public:
     translateIndirectJumps();
 
     unsigned ReadSize = Binary.architecture().pointerSize() / 8;
-    for (MetaAddress MemoryAddress : UnusedCodePointers) {
-      // Read using the original endianess, we want the correct address
-      uint64_t RawPC = *Binary.readRawValue(MemoryAddress, ReadSize);
-      auto PC = fromPC(RawPC);
+    std::vector<MetaAddress> Addresses(UnusedCodePointers.begin(),
+                                       UnusedCodePointers.end());
+    // Read using the original endianess, we want the correct address
+    auto RawPCs = Binary.readRawValues(Addresses, ReadSize);
+    for (const llvm::Optional<uint64_t> &RawPC : RawPCs) {
+      auto PC = fromPC(*RawPC);
 
       // Set as reason UnusedGlobalData and ensure it's not empty
       llvm::BasicBlock *BB = registerJT(PC, JTReason::UnusedGlobalData);
@@ -434,6 +533,10 @@ public:
 
     // We no longer need this information
     freeContainer(UnusedCodePointers);
+
+    // During harvesting the dispatcher has been updated incrementally, give it
+    // its final, sorted, form
+    rebuildDispatcher(nullptr, true);
   }
 
   MetaAddress fromPC(uint64_t PC) const { return Binary.fromPC(PC); }
@@ -465,7 +568,7 @@ public:
 
     // Tag each jump target with its reasons
     for (auto &P : JumpTargets) {
-      JumpTarget &JT = P.second;
+      const JumpTarget &JT = P.second;
       Instruction *T = JT.head()->getTerminator();
       revng_assert(T != nullptr);
 
@@ -477,6 +580,24 @@ public:
     }
   }
 
+  /// \brief Count how many times each jump target is executed
+  ///
+  /// Each jump target increments its own entry of `revng_block_counters`, the
+  /// corresponding address is in `revng_block_counters_pcs` and the number of
+  /// counters in `revng_block_counters_count`. The support module in the
+  /// profile configuration dumps them when the program ends.
+  void createBlockCounters();
+
+  /// How many times each jump target has been executed
+  using ProfileCounts = std::map<MetaAddress, uint64_t>;
+
+  /// \brief Attach the execution counts in \p Counts to the root function
+  ///
+  /// The root dispatcher and the conditional branches between jump targets get
+  /// branch weights, so that hot targets are tested first and cold code is
+  /// laid out of line.
+  void applyProfile(const ProfileCounts &Counts);
+
   unsigned delaySlotSize() const {
     return Binary.architecture().delaySlotSize();
   }
@@ -485,7 +606,14 @@ public:
 
   void registerReadRange(MetaAddress Address, uint64_t Size);
 
-  const interval_set &readRange() const { return ReadIntervalSet; }
+  /// \brief Ranges of memory read by the code, as generic addresses
+  const IntervalSet &readRange() {
+    flushReadRange();
+    return ReadIntervalSet;
+  }
+
+  /// \brief Results of AdvancedValueInfo from the previous harvesting round
+  AVIResultsCache &aviCache() { return AVICache; }
 
   std::string nameForAddress(MetaAddress Address, uint64_t Size = 1) const {
     return Binary.nameForAddress(Address, Size);
@@ -507,16 +635,49 @@ public:
 
   ProgramCounterHandler *programCounterHandler() { return PCH; }
 
+  /// \brief Decorate \p I, if it's a load or a store, with information about
+  ///        CSV aliasing
+  ///
+  /// The accesses to a CSV are in the scope of all the CSVs, while all the
+  /// other accesses are declared not to alias it. Distinct CSVs are told apart
+  /// by BasicAA anyway.
+  void setCSVAliasScopes(llvm::Instruction &I);
+
 private:
   void fixPostHelperPC();
 
   std::set<llvm::BasicBlock *> computeUnreachable() const;
 
+  /// \brief Erase the basic blocks that became unreachable since the last call
+  ///
+  /// Only the basic blocks registered through recordRemovedEdges (and, in
+  /// turn, the successors of those we erase) are considered.
+  void eraseUnreachable();
+
   void assertNoUnreachable() const;
 
   /// \brief Translate the non-constant jumps into jumps to the dispatcher
   void translateIndirectJumps();
 
+  /// \brief Return the jump target at \p PC, or nullptr
+  JumpTarget *findJT(MetaAddress PC) {
+    if (not JumpTargetStarts.mayContain(PC))
+      return nullptr;
+    return JumpTargets.find(PC);
+  }
+
+  const JumpTarget *findJT(MetaAddress PC) const {
+    if (not JumpTargetStarts.mayContain(PC))
+      return nullptr;
+    return JumpTargets.find(PC);
+  }
+
+  /// \brief Return true if \p PC is the start of a translated instruction
+  bool isInstructionStart(MetaAddress PC) const {
+    return InstructionStarts.mayContain(PC)
+           and OriginalInstructionAddresses.count(PC) != 0;
+  }
+
   /// \brief Helper function to check if an instruction is a call to `newpc`
   ///
   /// \return 0 if \p I is not a call to `newpc`, otherwise the PC address of
@@ -538,39 +699,182 @@ private:
     revng_assert(I->use_empty());
 
     MetaAddress PC = getPCFromNewPCCall(I);
-    if (PC.isValid())
+    if (PC.isValid()) {
       OriginalInstructionAddresses.erase(PC);
+      forgetNewPCCalls(I->getParent());
+    }
     I->eraseFromParent();
   }
 
+  using NewPCCallsVector = llvm::SmallVector<llvm::CallInst *, 4>;
+
+  /// \brief Return the calls to `newpc` in \p BB, in order
+  ///
+  /// The result is cached, the cache entry of a basic block must be dropped
+  /// through forgetNewPCCalls whenever a call to `newpc` is added to it or
+  /// removed from it, or the basic block is split or erased.
+  const NewPCCallsVector &newPCCalls(const llvm::BasicBlock *BB) const;
+
+  /// \note This also drops the ProgramCounterHandler cache for \p BB
+  void forgetNewPCCalls(const llvm::BasicBlock *BB) const {
+    NewPCCallsCache.erase(BB);
+    PCH->forgetPCEvents(BB);
+  }
+
   /// \brief Drop \p Start and all the descendants, stopping when a JT is met
   void purgeTranslation(llvm::BasicBlock *Start);
 
   /// \brief Check if \p BB has at least a predecessor, excluding the dispatcher
   bool hasPredecessors(llvm::BasicBlock *BB) const;
 
+  /// \brief Turn \p Clone, a copy of the root function, in RecoveredOnly form
+  ///
+  /// This is equivalent to switching to the RecoveredOnly CFG form, cloning
+  /// and switching back, without touching the root function.
+  ///
+  /// \param OldToNew the mapping produced while cloning the root function.
+  /// \param Whitelist the jump targets the dispatcher can still go to.
+  void restrictToRecovered(llvm::Function *Clone,
+                           llvm::ValueToValueMapTy &OldToNew,
+                           const MetaAddressSet &Whitelist);
+
   /// \brief Rebuild the dispatcher switch
   ///
   /// Depending on the CFG form we're currently adopting the dispatcher might go
   /// to all the jump targets or only to those who have no other predecessor.
-  void rebuildDispatcher(MetaAddressSet *Whitelist);
+  ///
+  /// \param FromScratch if false and a dispatcher already exists, it's updated
+  ///        in place, only dropping the cases not needed anymore and adding the
+  ///        missing ones.
+  void rebuildDispatcher(MetaAddressSet *Whitelist, bool FromScratch = false);
 
   void prepareDispatcher();
 
-  template<typename value_type, unsigned endian>
-  void findCodePointers(MetaAddress StartVirtualAddress,
-                        const unsigned char *Start,
-                        const unsigned char *End);
+  /// \brief Data of the input program, along with the address it's loaded at
+  using DataChunk = std::pair<MetaAddress, llvm::ArrayRef<uint8_t>>;
+
+  /// \brief Look for code pointers in \p Chunks, according to the input
+  ///        architecture, and register them as jump targets
+  void findCodePointers(llvm::ArrayRef<DataChunk> Chunks);
 
-  void harvestWithAVI();
+  /// \param Region if not null, function calls are only looked for in these
+  ///        basic blocks.
+  void harvestWithAVI(const std::set<llvm::BasicBlock *> *Region);
 
   void harvest();
 
-  /// \brief Decorate memory accesses with information about CSV aliasing
-  void aliasAnalysis();
+  /// \brief Collect the basic blocks affected by the translations performed
+  ///        since the last harvesting round
+  ///
+  /// The result contains the blocks translated starting from the program
+  /// counters in TranslatedSinceHarvest, plus their immediate predecessors and
+  /// successors.
+  std::set<llvm::BasicBlock *> harvestRegion();
+
+  /// \brief Update the isJT argument of the calls to `newpc`
+  ///
+  /// \param Region if not null, only the calls in these basic blocks and
+  ///        those of the jump targets promoted since the last harvesting
+  ///        round are updated.
+  void updateNewPCIsJT(const std::set<llvm::BasicBlock *> *Region);
+
+  /// \brief Decorate the memory accesses of \p F which have not been decorated
+  ///        while translating with information about CSV aliasing
+  void aliasAnalysis(llvm::Function &F);
+
+  /// \brief Is \p V a CSV?
+  bool isCSV(const llvm::Value *V);
 
   MetaAddressSet inflateAVIWhitelist();
 
+  /// \brief Can the jump target \p PC, registered now, be translated?
+  bool isInScope(MetaAddress PC) const {
+    if (Shard and not Shard->contains(PC.address()))
+      return false;
+
+    if (not Scope)
+      return true;
+
+    return (NextDepth <= Scope->MaxDepth
+            and (Scope->Budget == 0 or Depths.size() < Scope->Budget));
+  }
+
+  /// \brief Hand the jump targets out of the shard over to the other shards,
+  ///        and obtain theirs
+  ///
+  /// \return true if new jump targets have been registered.
+  bool exchangeWithOtherShards();
+
+  /// \brief Replace the placeholders of the jump targets out of scope with
+  ///        the dispatcher
+  void dropOutOfScope();
+
+  /// \return the name of the first budget of the exploration that has been
+  ///         exhausted, or nullptr if there's still room
+  const char *exhaustedBudget() const;
+
+  /// \brief Give up on all the jump targets that have not been translated yet
+  ///
+  /// They are removed from the dispatcher and replaced by it, the partial
+  /// translations that were going to be purged are kept as they are.
+  void stopExploration(const char *Reason);
+
+private:
+  /// \brief A value read from the static memory
+  struct StaticRead {
+    MaterializedValue Value;
+    /// The value has been prefetched and never requested: its read range has
+    /// not been registered yet
+    bool Prefetched = false;
+  };
+
+  /// Address, then size and endianness packed as `Size * 4 + E`
+  using StaticReadKey = std::pair<MetaAddress, unsigned>;
+
+  static StaticReadKey
+  staticReadKey(MetaAddress Address, unsigned Size, BinaryFile::Endianess E) {
+    return { Address, Size * 4 + E };
+  }
+
+  /// \brief The last read from the static memory and its distance from the
+  ///        previous one of the same size
+  struct StridedRead {
+    MetaAddress Address = MetaAddress::invalid();
+    unsigned Size = 0;
+    BinaryFile::Endianess E = BinaryFile::OriginalEndianess;
+    uint64_t Stride = 0;
+  };
+
+  MaterializedValue
+  readStaticValue(MetaAddress Address, unsigned Size, BinaryFile::Endianess E);
+
+  /// \brief Record a read and check if it follows the stride of the previous
+  ///        ones
+  bool isStrided(MetaAddress Address, unsigned Size, BinaryFile::Endianess E);
+
+  /// \brief Read the elements following \p Address at the current stride
+  void prefetchStrided(MetaAddress Address,
+                       unsigned Size,
+                       BinaryFile::Endianess E);
+
+  /// \brief Move the pending read range into ReadIntervalSet
+  void flushReadRange();
+
+private:
+  struct ExplorationScope {
+    unsigned MaxDepth;
+    unsigned Budget;
+  };
+
+  struct AddressRange {
+    uint64_t Start;
+    uint64_t End;
+
+    bool contains(uint64_t Address) const {
+      return Start <= Address and Address < End;
+    }
+  };
+
 private:
   using InstructionMap = std::map<MetaAddress, llvm::Instruction *>;
 
@@ -582,6 +886,13 @@ private:
   InstructionMap OriginalInstructionAddresses;
   /// Holds the association between a PC and a BasicBlock.
   BlockMap JumpTargets;
+  /// Filter for the lookups in OriginalInstructionAddresses
+  AddressBitmap InstructionStarts;
+  /// Filter for the lookups in JumpTargets
+  AddressBitmap JumpTargetStarts;
+  /// Cache of the calls to `newpc` in each basic block, used by getPC
+  mutable llvm::DenseMap<const llvm::BasicBlock *, NewPCCallsVector>
+    NewPCCallsCache;
   /// Queue of program counters we still have to translate.
   std::vector<BlockWithAddress> Unexplored;
 
@@ -599,7 +910,14 @@ private:
   unsigned NewBranches = 0;
 
   std::set<MetaAddress> UnusedCodePointers;
-  interval_set ReadIntervalSet;
+  IntervalSet ReadIntervalSet;
+  /// Contiguous reads not yet in ReadIntervalSet, as [first, second)
+  std::pair<MetaAddress, MetaAddress> PendingReadRange = {
+    MetaAddress::invalid(), MetaAddress::invalid()
+  };
+  llvm::DenseMap<StaticReadKey, StaticRead> StaticReads;
+  StridedRead LastStaticRead;
+  AVIResultsCache AVICache;
 
   CFGForm::Values CurrentCFGForm;
   std::set<llvm::BasicBlock *> ToPurge;
@@ -609,6 +927,51 @@ private:
   ProgramCounterHandler *PCH;
 
   MetaAddressSet AVIPCWhiteList;
+
+  /// Program counters whose translation started since the last harvesting
+  /// round
+  MetaAddressSet TranslatedSinceHarvest;
+  /// Program counters promoted to jump target, without being retranslated yet,
+  /// since the last harvesting round
+  MetaAddressSet PromotedSinceHarvest;
+  /// State of FunctionCallIdentification across incremental harvesting rounds
+  FunctionCallIdentification::IncrementalState FCIState;
+
+  /// Limits of the exploration, if any
+  llvm::Optional<ExplorationScope> Scope;
+  /// Number of jump targets between the closest entry point and each jump
+  /// target, populated only if the exploration is limited
+  std::map<MetaAddress, unsigned> Depths;
+  /// Depth of the jump targets registered while translating the current one
+  unsigned NextDepth = 0;
+  /// Placeholders of the jump targets beyond the limits of the exploration
+  std::map<MetaAddress, llvm::BasicBlock *> OutOfScope;
+  std::set<llvm::BasicBlock *> Placeholders;
+
+  /// Range of addresses to translate, if the exploration is sharded
+  llvm::Optional<AddressRange> Shard;
+  /// Invoked when there's nothing left to explore in the shard
+  std::function<bool()> ShardExchange;
+  /// Reasons of the jump targets met so far out of the shard
+  std::map<MetaAddress, uint32_t> OutOfShard;
+
+  /// Basic blocks that lost a predecessor since the last harvest
+  std::vector<llvm::WeakVH> MaybeUnreachable;
+
+  /// Time when the exploration started, for the time budget
+  std::chrono::steady_clock::time_point ExplorationStart;
+
+  MetaAddressConstants MAConstants;
+  /// The `revng.csv` tuple CSVs has been collected from, if any
+  llvm::Optional<const llvm::MDNode *> CSVList;
+  /// The CSVs in CSVList, plus those affecting the PC
+  llvm::SmallPtrSet<const llvm::GlobalVariable *, 32> CSVs;
+  /// The alias scope of all the accesses to the CSVs
+  llvm::MDNode *CSVScope = nullptr;
+  /// Number of harvesting rounds performed so far
+  unsigned HarvestRounds = 0;
+  /// Whether the exploration has been stopped before completion
+  bool Partial = false;
 };
 
 template<>
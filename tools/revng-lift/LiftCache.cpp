@@ -0,0 +1,138 @@
+/// \file LiftCache.cpp
+/// \brief This file implements the on-disk cache of the jump targets discovered
+///        by revng-lift.
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <fstream>
+#include <string>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Support/Assert.h"
+#include "revng/Support/Debug.h"
+
+#include "BinaryFile.h"
+#include "JumpTargetManager.h"
+#include "LiftCache.h"
+
+using namespace llvm;
+
+static Logger<> LiftCacheLog("lift-cache");
+
+/// Bump this each time the format of the entries, or the way jump targets are
+/// discovered, changes in an incompatible way
+static const char *CacheVersion = "revng-lift-cache 1";
+
+static void hashString(SHA1 &Hasher, StringRef String) {
+  static const uint8_t Terminator = 0;
+  Hasher.update(String);
+  // Terminate each string, so that concatenations don't collide
+  Hasher.update(ArrayRef<uint8_t>(Terminator));
+}
+
+LiftCache::LiftCache(StringRef Directory,
+                     const BinaryFile &Binary,
+                     StringRef Options) {
+  if (Directory.empty())
+    return;
+
+  SHA1 Hasher;
+  hashString(Hasher, CacheVersion);
+  hashString(Hasher, Binary.architecture().name());
+  hashString(Hasher, Binary.entryPoint().toString());
+  hashString(Hasher, Options);
+
+  for (const SegmentInfo &Segment : Binary.segments()) {
+    hashString(Hasher, Segment.StartVirtualAddress.toString());
+    hashString(Hasher, Segment.EndVirtualAddress.toString());
+    std::string Flags;
+    Flags += Segment.IsReadable ? "r" : "-";
+    Flags += Segment.IsWriteable ? "w" : "-";
+    Flags += Segment.IsExecutable ? "x" : "-";
+    hashString(Hasher, Flags);
+    Hasher.update(Segment.Data);
+  }
+
+  std::error_code EC = sys::fs::create_directories(Directory);
+  revng_check(not EC, "Couldn't create the lift cache directory");
+
+  SmallString<128> Path(Directory);
+  sys::path::append(Path, toHex(Hasher.final(), true) + ".csv");
+  EntryPath = std::string(Path.str());
+
+  revng_log(LiftCacheLog, "Cache entry: " << EntryPath);
+}
+
+LiftCache::JumpTargetsMap LiftCache::load() const {
+  JumpTargetsMap Result;
+
+  if (not enabled())
+    return Result;
+
+  std::ifstream Input(EntryPath);
+  if (not Input.good()) {
+    revng_log(LiftCacheLog, "Cache miss");
+    return Result;
+  }
+
+  std::string Line;
+  std::getline(Input, Line);
+  if (Line != CacheVersion) {
+    revng_log(LiftCacheLog, "Ignoring entry with unexpected version");
+    return Result;
+  }
+
+  while (std::getline(Input, Line)) {
+    auto [AddressString, ReasonsString] = StringRef(Line).split(',');
+    MetaAddress Address = MetaAddress::fromString(AddressString);
+    uint32_t Reasons = 0;
+    if (not Address.isValid() or ReasonsString.getAsInteger(10, Reasons)) {
+      revng_log(LiftCacheLog, "Ignoring malformed entry");
+      return JumpTargetsMap();
+    }
+
+    Result[Address] = Reasons;
+  }
+
+  revng_log(LiftCacheLog, "Cache hit: " << Result.size() << " jump targets");
+
+  return Result;
+}
+
+void LiftCache::store(const JumpTargetManager &JTM) const {
+  if (not enabled())
+    return;
+
+  // Write to a temporary file and then move it in place, so that concurrent
+  // runs never see a partial entry
+  int FD = -1;
+  SmallString<128> TemporaryPath;
+  std::error_code EC = sys::fs::createUniqueFile(EntryPath + ".%%%%%%%%",
+                                                 FD,
+                                                 TemporaryPath);
+  if (EC) {
+    revng_log(LiftCacheLog, "Couldn't create a temporary file");
+    return;
+  }
+
+  {
+    raw_fd_ostream Output(FD, true);
+    Output << CacheVersion << "\n";
+    for (const auto &[PC, JT] : JTM)
+      Output << PC.toString() << "," << JT.getReasons() << "\n";
+  }
+
+  EC = sys::fs::rename(TemporaryPath, EntryPath);
+  if (EC) {
+    revng_log(LiftCacheLog, "Couldn't store the cache entry");
+    sys::fs::remove(TemporaryPath);
+  }
+}
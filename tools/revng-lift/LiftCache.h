@@ -0,0 +1,53 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include "llvm/ADT/StringRef.h"
+
+#include "revng/Support/MetaAddress.h"
+
+class BinaryFile;
+class JumpTargetManager;
+
+/// \brief Content-addressed cache of the jump targets discovered by revng-lift
+///
+/// Each entry of the cache directory is named after a hash of the contents of
+/// the segments of the input binary, its architecture and entry point, plus a
+/// string describing the options affecting the lifting process. An entry lists
+/// all the jump targets found by a previous run, along with their reasons.
+/// Seeding JumpTargetManager with them lets the translation proceed without
+/// waiting for most of the harvesting rounds.
+class LiftCache {
+public:
+  using JumpTargetsMap = std::map<MetaAddress, uint32_t>;
+
+public:
+  /// \param Directory path of the cache directory. If empty, the cache is
+  ///        disabled.
+  /// \param Options a string describing the options that might affect the
+  ///        set of discovered jump targets.
+  LiftCache(llvm::StringRef Directory,
+            const BinaryFile &Binary,
+            llvm::StringRef Options);
+
+public:
+  bool enabled() const { return not EntryPath.empty(); }
+
+  /// \brief Load the jump targets (and their reasons) of the cache entry
+  ///
+  /// \return an empty map if the cache is disabled or there's no entry for the
+  ///         current binary.
+  JumpTargetsMap load() const;
+
+  /// \brief Record all the jump targets currently known to \p JTM
+  void store(const JumpTargetManager &JTM) const;
+
+private:
+  std::string EntryPath;
+};
@@ -0,0 +1,222 @@
+/// \file LinearSweep.cpp
+/// \brief This file implements the linear sweep of the executable segments
+///        looking for function entries.
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/Triple.h"
+
+#include "revng/Support/Debug.h"
+#include "revng/Support/Statistics.h"
+
+#include "BinaryFile.h"
+#include "LinearSweep.h"
+#include "PTCDecoder.h"
+#include "PTCInterface.h"
+
+using namespace llvm;
+
+static Logger<> Log("linear-sweep");
+
+static CounterMap<std::string> SweepStats("linear-sweep");
+
+/// \brief Bytes that typically start a function
+///
+/// Only the bits set in Mask are compared.
+struct ProloguePattern {
+  StringRef Bytes;
+  StringRef Mask;
+};
+
+template<size_t N>
+static ProloguePattern pattern(const char (&Bytes)[N], const char (&Mask)[N]) {
+  return { StringRef(Bytes, N - 1), StringRef(Mask, N - 1) };
+}
+
+static std::vector<ProloguePattern> prologuePatterns(Triple::ArchType Type) {
+  switch (Type) {
+  case Triple::x86:
+    return {
+      // endbr32
+      pattern("\xf3\x0f\x1e\xfb", "\xff\xff\xff\xff"),
+      // push %ebp; mov %esp, %ebp
+      pattern("\x55\x89\xe5", "\xff\xff\xff"),
+      pattern("\x55\x8b\xec", "\xff\xff\xff"),
+    };
+
+  case Triple::x86_64:
+    return {
+      // endbr64
+      pattern("\xf3\x0f\x1e\xfa", "\xff\xff\xff\xff"),
+      // push %rbp; mov %rsp, %rbp
+      pattern("\x55\x48\x89\xe5", "\xff\xff\xff\xff"),
+    };
+
+  case Triple::arm:
+    return {
+      // push {..., lr}
+      pattern("\x00\x40\x2d\xe9", "\x00\x40\xff\xff"),
+    };
+
+  case Triple::aarch64:
+    return {
+      // stp x29, x30, [sp, #-N]!
+      pattern("\xfd\x7b\x80\xa9", "\xff\x7f\xc0\xff"),
+      // paciasp
+      pattern("\x3f\x23\x03\xd5", "\xff\xff\xff\xff"),
+    };
+
+  case Triple::mips:
+    return {
+      // addiu $sp, $sp, -N
+      pattern("\x27\xbd\x80\x00", "\xff\xff\x80\x00"),
+    };
+
+  case Triple::mipsel:
+    return {
+      // addiu $sp, $sp, -N
+      pattern("\x00\x80\xbd\x27", "\x00\x80\xff\xff"),
+    };
+
+  case Triple::systemz:
+    return {
+      // stmg %rX, %rY, N(%r15)
+      pattern("\xeb\x00\xf0\x00\x00\x24", "\xff\x00\xf0\x00\x00\xff"),
+    };
+
+  default:
+    return {};
+  }
+}
+
+static bool matches(ArrayRef<uint8_t> Data, const ProloguePattern &Pattern) {
+  if (Data.size() < Pattern.Bytes.size())
+    return false;
+
+  for (size_t I = 0; I < Pattern.Bytes.size(); ++I) {
+    auto Mask = static_cast<uint8_t>(Pattern.Mask[I]);
+    auto Expected = static_cast<uint8_t>(Pattern.Bytes[I]);
+    if ((Data[I] & Mask) != Expected)
+      return false;
+  }
+
+  return true;
+}
+
+/// Does \p Name identify a helper raising an exception?
+static bool isExceptionHelper(StringRef Name) {
+  return Name.startswith("raise_exception") or Name == "raise_interrupt"
+         or Name.startswith("exception_");
+}
+
+/// \brief Can \p PC be decoded by PTC, without its first instruction raising
+///        an exception?
+static bool decodesCleanly(PTCDecoder &Decoder, MetaAddress PC) {
+  PTCDecoder::DecodedBlock Decoded = Decoder.decode(PC);
+  if (Decoded.ConsumedSize == 0)
+    return false;
+
+  PTCInstructionList *Instructions = Decoded.Instructions.get();
+  unsigned InstructionStarts = 0;
+  for (unsigned Index = 0; Index < Instructions->instruction_count; Index++) {
+    PTCInstruction *Instruction = &Instructions->instructions[Index];
+    PTCOpcode Opcode = Instruction->opc;
+
+    // Stop at the second guest instruction
+    if (Opcode == PTC_INSTRUCTION_op_debug_insn_start) {
+      if (++InstructionStarts > 1)
+        break;
+      continue;
+    }
+
+    if (Opcode != PTC_INSTRUCTION_op_call)
+      continue;
+
+    uint64_t HelperIndex = ptc_call_instruction_const_arg(&ptc, Instruction, 0);
+    PTCHelperDef *Helper = ptc_find_helper(&ptc, HelperIndex);
+    if (Helper != nullptr and Helper->name != nullptr
+        and isExceptionHelper(Helper->name))
+      return false;
+  }
+
+  return InstructionStarts != 0;
+}
+
+std::vector<MetaAddress> sweepExecutableSegments(const BinaryFile &Binary,
+                                                 PTCDecoder &Decoder) {
+  const Architecture &Arch = Binary.architecture();
+  std::vector<ProloguePattern> Patterns = prologuePatterns(Arch.type());
+  uint32_t Alignment = std::max<uint32_t>(Arch.instructionAlignment(), 1);
+
+  std::vector<MetaAddress> Candidates;
+  auto IsExecutable = [&Binary](MetaAddress Address) {
+    for (const SegmentInfo &Segment : Binary.segments())
+      if (Segment.IsExecutable and Segment.contains(Address))
+        return true;
+    return false;
+  };
+
+  // The start of each FDE is the start of a function
+  for (const MetaAddress &Start : Binary.fdeStarts()) {
+    MetaAddress PC = Binary.fromPC(Start.address());
+    if (PC.isValid() and IsExecutable(PC))
+      Candidates.push_back(PC);
+  }
+  SweepStats.push("fde", Candidates.size());
+
+  // Look for the typical prologues, only in the initialized part of the
+  // segments
+  for (const SegmentInfo &Segment : Binary.segments()) {
+    if (not Segment.IsExecutable or Patterns.empty())
+      continue;
+
+    uint64_t Start = Segment.StartVirtualAddress.address();
+    ArrayRef<uint8_t> Data = Segment.Data;
+    for (size_t Offset = (Alignment - Start % Alignment) % Alignment;
+         Offset < Data.size();
+         Offset += Alignment) {
+      ArrayRef<uint8_t> Tail = Data.drop_front(Offset);
+      auto Matches = [&Tail](const ProloguePattern &Pattern) {
+        return matches(Tail, Pattern);
+      };
+      if (not llvm::any_of(Patterns, Matches))
+        continue;
+
+      MetaAddress PC = Binary.fromPC(Start + Offset);
+      if (PC.isValid()) {
+        SweepStats.push("prologue");
+        Candidates.push_back(PC);
+      }
+    }
+  }
+
+  llvm::sort(Candidates);
+  Candidates.erase(std::unique(Candidates.begin(), Candidates.end()),
+                   Candidates.end());
+
+  // Drop what PTC cannot decode
+  auto IsInvalid = [&Decoder](const MetaAddress &PC) {
+    bool Result = not decodesCleanly(Decoder, PC);
+    if (Result)
+      SweepStats.push("invalid");
+    return Result;
+  };
+  Candidates.erase(std::remove_if(Candidates.begin(),
+                                  Candidates.end(),
+                                  IsInvalid),
+                   Candidates.end());
+
+  revng_log(Log, "Found " << Candidates.size() << " candidates");
+
+  return Candidates;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <vector>
+
+#include "revng/Support/MetaAddress.h"
+
+class BinaryFile;
+class PTCDecoder;
+
+/// \brief Find likely function entries sweeping the executable segments
+///
+/// The recursive exploration of JumpTargetManager only reaches code through
+/// the entry point, the symbols and the constants it meets. On stripped
+/// binaries, the code reached only through indirect branches is found one
+/// harvesting round at a time.
+///
+/// This function collects the start of the FDEs in `.eh_frame` and the
+/// addresses of the executable segments matching the typical function
+/// prologues of the input architecture, e.g., `push %rbp; mov %rsp, %rbp` on
+/// x86-64 or `stp x29, x30, [sp, #-N]!` on AArch64. A candidate is kept only
+/// if PTC can decode it and its first instruction does not raise an exception,
+/// which is the case of invalid opcodes.
+///
+/// \return the candidates, sorted by address, to register as jump targets.
+std::vector<MetaAddress> sweepExecutableSegments(const BinaryFile &Binary,
+                                                 PTCDecoder &Decoder);
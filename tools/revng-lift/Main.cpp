@@ -10,18 +10,31 @@
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <map>
 #include <memory>
+#include <optional>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <type_traits>
 #include <vector>
 
+#include <sys/wait.h>
+#include <unistd.h>
+
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/Optional.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IRReader/IRReader.h"
 #include "llvm/Object/Binary.h"
 #include "llvm/Object/ELF.h"
+#include "llvm/Object/ObjectFile.h"
 #include "llvm/Support/Signals.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/ToolOutputFile.h"
 
 #include "revng/Support/CommandLine.h"
 #include "revng/Support/Debug.h"
@@ -32,8 +45,11 @@
 #include "BinaryFile.h"
 #include "CodeGenerator.h"
 #include "PTCInterface.h"
+#include "ShardedLift.h"
 
 PTCInterface ptc = {}; ///< The interface with the PTC library.
+std::mutex PTCLock;
+PTCInstructionListPool PTCListPool;
 
 using namespace llvm::cl;
 
@@ -54,6 +70,48 @@ alias A1("e",
          aliasopt(EntryPointAddress),
          cat(MainCategory));
 
+#define DESCRIPTION                                                         \
+  desc("translate only the code reachable from these addresses, execution " \
+       "starts from -entry, if specified, or from the first one")
+list<unsigned long long> EntryPointAddresses("entries",
+                                             DESCRIPTION,
+                                             value_desc("addresses"),
+                                             CommaSeparated,
+                                             cat(MainCategory));
+#undef DESCRIPTION
+
+#define DESCRIPTION                                                      \
+  desc("when translating from the given entry points, do not translate " \
+       "jump targets farther than this many jump targets from them")
+opt<unsigned> ExplorationDepth("exploration-depth",
+                               DESCRIPTION,
+                               value_desc("count"),
+                               cat(MainCategory),
+                               init(std::numeric_limits<unsigned>::max()));
+#undef DESCRIPTION
+
+#define DESCRIPTION                                                           \
+  desc("when translating from the given entry points, stop discovering new " \
+       "jump targets after this many, 0 means no limit")
+opt<unsigned> ExplorationBudget("exploration-budget",
+                                DESCRIPTION,
+                                value_desc("count"),
+                                cat(MainCategory),
+                                init(0));
+#undef DESCRIPTION
+
+#define DESCRIPTION                                                        \
+  desc("explore the jump targets with this many processes, each one "      \
+       "translating a range of addresses and handing the jump targets out " \
+       "of its range over to the others, then translate the whole binary "  \
+       "starting from all the jump targets they found")
+opt<unsigned> ExplorationShards("exploration-shards",
+                                DESCRIPTION,
+                                value_desc("count"),
+                                cat(MainCategory),
+                                init(1));
+#undef DESCRIPTION
+
 #define DESCRIPTION desc("base address where dynamic objects should be loaded")
 opt<unsigned long long> BaseAddress("base",
                                     DESCRIPTION,
@@ -66,8 +124,28 @@ opt<unsigned long long> BaseAddress("base",
 alias A2("B", DESCRIPTION, aliasopt(BaseAddress), cat(MainCategory));
 #undef DESCRIPTION
 
-opt<string> InputPath(Positional, Required, desc("<input path>"));
-opt<string> OutputPath(Positional, Required, desc("<output path>"));
+opt<string> InputPath(Positional, desc("<input path>"));
+opt<string> OutputPath(Positional, desc("<output path>"));
+
+#define DESCRIPTION                                                        \
+  desc("instead of <input path> and <output path>, lift all the binaries " \
+       "listed in the given manifest, one \"<input path> <output path>\" " \
+       "pair per line. Options concerning a specific output path should " \
+       "not be used.")
+opt<string> BatchManifest("batch",
+                          DESCRIPTION,
+                          value_desc("path"),
+                          cat(MainCategory));
+#undef DESCRIPTION
+
+#define DESCRIPTION \
+  desc("number of binaries to lift concurrently in batch mode")
+opt<unsigned> BatchJobs("batch-jobs",
+                        DESCRIPTION,
+                        value_desc("count"),
+                        cat(MainCategory),
+                        init(1));
+#undef DESCRIPTION
 
 #define DESCRIPTION desc("target architecture name")
 opt<string> TargetArchName("target",
@@ -77,6 +155,15 @@ opt<string> TargetArchName("target",
                            init("x86_64"));
 #undef DESCRIPTION
 
+#define DESCRIPTION                                                     \
+  desc("instead of lifting, prepare the helpers module in <input path>, " \
+       "for the given source architecture, and write it in <output path>")
+opt<string> PrepareHelpersArch("prepare-helpers",
+                               DESCRIPTION,
+                               value_desc("arch"),
+                               cat(MainCategory));
+#undef DESCRIPTION
+
 } // namespace
 
 static std::string LibTinycodePath;
@@ -107,7 +194,13 @@ static void findFiles(const char *SourceArchitecture, const char *TargetArchitec
   LibTinycodePath = OptionalLibtinycode.value();
 
   std::string LibHelpersName = "/lib/libtinycode-helpers-" + SourceArchName + "-" + TargetArchName + ".bc";
-  auto OptionalHelpers = ResourceFinder.findFile(LibHelpersName);
+
+  // Prefer the helpers module prepared at build time, if available
+  std::string ArchSuffix = SourceArchName + "-" + TargetArchName;
+  std::string PreparedHelpersName = "/share/revng/helpers-" + ArchSuffix;
+  auto OptionalHelpers = ResourceFinder.findFile(PreparedHelpersName + ".bc");
+  if (not OptionalHelpers.has_value())
+    OptionalHelpers = ResourceFinder.findFile(LibHelpersName);
   revng_assert(OptionalHelpers.has_value(), (std::string("Cannot find tinycode helpers (") + LibHelpersName + ")").c_str());
   LibHelpersPath = OptionalHelpers.value();
 
@@ -157,6 +250,203 @@ static int loadPTCLibrary(LibraryPointer &PTCLibrary) {
   return EXIT_SUCCESS;
 }
 
+/// Prepare the helpers module in InputPath and write it as bitcode in
+/// OutputPath, so that revng-lift can load it without further processing
+static int prepareHelpers() {
+  findFiles(PrepareHelpersArch.c_str(), TargetArchName.c_str());
+
+  LibraryPointer PTCLibrary;
+  if (loadPTCLibrary(PTCLibrary) != EXIT_SUCCESS)
+    return EXIT_FAILURE;
+
+  llvm::LLVMContext Context;
+  llvm::SMDiagnostic Errors;
+  std::unique_ptr<llvm::Module> Helpers = llvm::parseIRFile(InputPath,
+                                                            Errors,
+                                                            Context);
+  if (Helpers.get() == nullptr) {
+    Errors.print("revng", llvm::dbgs());
+    return EXIT_FAILURE;
+  }
+
+  prepareHelpersModule(*Helpers, ptc.exception_index);
+
+  std::error_code EC;
+  llvm::ToolOutputFile Output(OutputPath, EC, llvm::sys::fs::OF_None);
+  if (EC) {
+    fprintf(stderr, "Couldn't open %s: %s\n",
+            OutputPath.c_str(),
+            EC.message().c_str());
+    return EXIT_FAILURE;
+  }
+
+  llvm::WriteBitcodeToFile(*Helpers, Output.os());
+  Output.keep();
+
+  return EXIT_SUCCESS;
+}
+
+/// \brief Identify the architecture of \p Path without parsing the whole
+///        binary
+///
+/// \return the name of the architecture, or `None` if \p Path cannot be
+///         opened.
+static llvm::Optional<std::string>
+identifyArchitecture(const std::string &Path) {
+  using namespace llvm;
+
+  auto MaybeObject = object::ObjectFile::createObjectFile(Path);
+  if (not MaybeObject) {
+    consumeError(MaybeObject.takeError());
+    return None;
+  }
+
+  auto Arch = MaybeObject->getBinary()->getArch();
+  return Triple::getArchTypeName(Arch).str();
+}
+
+/// \brief What can be shared by all the binaries of a batch with the same
+///        source architecture
+struct ArchitectureResources {
+  LibraryPointer PTCLibrary;
+  PTCInterface Interface = {};
+  std::unique_ptr<llvm::LLVMContext> Context;
+  std::unique_ptr<llvm::Module> Helpers;
+  std::unique_ptr<llvm::Module> EarlyLinked;
+};
+
+/// Load libtinycode, the prepared helpers module and the early-linked module
+/// for \p SourceArchitecture, and make the PTC interface point to it
+static bool loadResources(const std::string &SourceArchitecture,
+                          ArchitectureResources &Resources) {
+  findFiles(SourceArchitecture.c_str(), TargetArchName.c_str());
+
+  ptc = {};
+  if (loadPTCLibrary(Resources.PTCLibrary) != EXIT_SUCCESS)
+    return false;
+  Resources.Interface = ptc;
+
+  Resources.Context = std::make_unique<llvm::LLVMContext>();
+  Resources.Helpers = loadHelpersModule(LibHelpersPath, *Resources.Context);
+  Resources.EarlyLinked = loadModule(EarlyLinkedPath, *Resources.Context);
+
+  return true;
+}
+
+/// Lift \p Input to \p Output in a new process, which employs a copy of
+/// \p Resources
+///
+/// \return the process identifier of the new process, or -1 on failure
+static pid_t liftInChild(const std::string &Input,
+                         const std::string &Output,
+                         ArchitectureResources &Resources) {
+  pid_t Child = fork();
+  if (Child != 0)
+    return Child;
+
+  // The helpers module is consumed by the lifting, this is fine since the
+  // parent has its own copy
+  ptc = Resources.Interface;
+  BinaryFile TheBinary(Input, BaseAddress);
+  Architecture TargetArchitecture;
+  CodeGenerator Generator(TheBinary,
+                          TargetArchitecture,
+                          *Resources.Context,
+                          Output,
+                          std::move(Resources.Helpers),
+                          std::move(Resources.EarlyLinked));
+  Generator.translate(llvm::None);
+  Generator.serialize();
+
+  std::exit(EXIT_SUCCESS);
+}
+
+/// Lift all the binaries listed in BatchManifest
+///
+/// libtinycode has global state that cannot be reset, therefore each binary is
+/// lifted in a forked process. The parts that do not depend on the input
+/// binary (loading libtinycode, preparing the helpers module and parsing the
+/// command line) are performed only once for each architecture by the parent
+/// process, before forking.
+static int liftBatch() {
+  using namespace llvm;
+
+  std::ifstream Manifest(BatchManifest);
+  if (not Manifest) {
+    fprintf(stderr, "Couldn't open %s\n", BatchManifest.c_str());
+    return EXIT_FAILURE;
+  }
+
+  std::vector<std::pair<std::string, std::string>> Entries;
+  std::string Line;
+  while (std::getline(Manifest, Line)) {
+    std::istringstream Fields(Line);
+    std::string Input;
+    std::string Output;
+    std::string Extra;
+    if (not(Fields >> Input) or Input[0] == '#')
+      continue;
+
+    if (not(Fields >> Output) or Fields >> Extra) {
+      fprintf(stderr, "Invalid manifest line: %s\n", Line.c_str());
+      return EXIT_FAILURE;
+    }
+
+    Entries.emplace_back(Input, Output);
+  }
+
+  std::map<std::string, ArchitectureResources> Resources;
+  std::map<pid_t, const std::string *> Running;
+  unsigned Failures = 0;
+
+  auto WaitOne = [&Running, &Failures]() {
+    int Status = 0;
+    pid_t Child = wait(&Status);
+    revng_assert(Child != -1);
+
+    auto It = Running.find(Child);
+    revng_assert(It != Running.end());
+    if (not WIFEXITED(Status) or WEXITSTATUS(Status) != EXIT_SUCCESS) {
+      fprintf(stderr, "Couldn't lift %s\n", It->second->c_str());
+      ++Failures;
+    }
+    Running.erase(It);
+  };
+
+  for (const auto &[Input, Output] : Entries) {
+    auto MaybeArchName = identifyArchitecture(Input);
+    if (not MaybeArchName) {
+      fprintf(stderr, "Couldn't open %s\n", Input.c_str());
+      ++Failures;
+      continue;
+    }
+    const std::string &ArchName = *MaybeArchName;
+
+    auto It = Resources.find(ArchName);
+    if (It == Resources.end()) {
+      It = Resources.emplace(ArchName, ArchitectureResources()).first;
+      if (not loadResources(ArchName, It->second))
+        return EXIT_FAILURE;
+    }
+
+    while (Running.size() >= std::max(1U, unsigned(BatchJobs)))
+      WaitOne();
+
+    pid_t Child = liftInChild(Input, Output, It->second);
+    if (Child == -1) {
+      fprintf(stderr, "Couldn't fork to lift %s\n", Input.c_str());
+      ++Failures;
+      continue;
+    }
+    Running[Child] = &Input;
+  }
+
+  while (not Running.empty())
+    WaitOne();
+
+  return Failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 int main(int argc, const char *argv[]) {
   // Enable LLVM stack trace
   llvm::sys::PrintStackTraceOnErrorSignal(argv[0]);
@@ -167,29 +457,92 @@ int main(int argc, const char *argv[]) {
 
   revng_check(BaseAddress % 4096 == 0, "Base address is not page aligned");
 
-  BinaryFile TheBinary(InputPath, BaseAddress);
+  if (not BatchManifest.empty()) {
+    revng_check(PrepareHelpersArch.empty() and InputPath.empty(),
+                "-batch expects no other input");
+    revng_check(EntryPointAddress.getNumOccurrences() == 0
+                  and EntryPointAddresses.empty(),
+                "-entry and -entries cannot be used in batch mode");
+    return liftBatch();
+  }
+
+  if (InputPath.empty() or OutputPath.empty()) {
+    fprintf(stderr, "An input path and an output path are required\n");
+    return EXIT_FAILURE;
+  }
+
+  if (not PrepareHelpersArch.empty())
+    return prepareHelpers();
+
+  auto MaybeArchName = identifyArchitecture(InputPath);
+  if (not MaybeArchName) {
+    fprintf(stderr, "Couldn't open %s\n", InputPath.c_str());
+    return EXIT_FAILURE;
+  }
 
-  findFiles(TheBinary.architecture().name(), std::string(TargetArchName).c_str());
+  // Parsing the binary (segments, relocations, .eh_frame...) doesn't depend on
+  // PTC nor on the helpers, overlap it with their loading
+  std::optional<BinaryFile> ParsedBinary;
+  std::thread Parser([&ParsedBinary]() {
+    ParsedBinary.emplace(InputPath, BaseAddress);
+  });
+
+  findFiles(MaybeArchName->c_str(), std::string(TargetArchName).c_str());
 
   // Load the appropriate libtyncode version
   LibraryPointer PTCLibrary;
-  if (loadPTCLibrary(PTCLibrary) != EXIT_SUCCESS)
+  if (loadPTCLibrary(PTCLibrary) != EXIT_SUCCESS) {
+    Parser.join();
     return EXIT_FAILURE;
+  }
 
-  // Translate everything
+  // Load and prepare the helpers, along with the early-linked module
   llvm::LLVMContext Context;
+  auto Helpers = loadHelpersModule(LibHelpersPath, Context);
+  auto EarlyLinked = loadModule(EarlyLinkedPath, Context);
+
+  Parser.join();
+  BinaryFile &TheBinary = *ParsedBinary;
+  revng_check(*MaybeArchName == TheBinary.architecture().name());
+
+  // Translate everything
   Architecture TargetArchitecture;
   CodeGenerator Generator(TheBinary,
                           TargetArchitecture,
                           Context,
                           std::string(OutputPath),
-                          LibHelpersPath,
-                          EarlyLinkedPath);
+                          std::move(Helpers),
+                          std::move(EarlyLinked));
 
-  llvm::Optional<uint64_t> EntryPointAddressOptional;
+  std::vector<uint64_t> Entries;
   if (EntryPointAddress.getNumOccurrences() != 0)
-    EntryPointAddressOptional = EntryPointAddress;
-  Generator.translate(EntryPointAddressOptional);
+    Entries.push_back(EntryPointAddress);
+  for (unsigned long long Address : EntryPointAddresses)
+    if (Entries.empty() or Address != Entries.front())
+      Entries.push_back(Address);
+
+  bool Limited = (ExplorationDepth.getNumOccurrences() != 0
+                  or ExplorationBudget.getNumOccurrences() != 0);
+  revng_check(not Limited or not Entries.empty(),
+              "Limiting the exploration requires -entry or -entries");
+
+  // Each shard explores its range in a copy of Generator, ours is untouched
+  if (ExplorationShards > 1) {
+    revng_check(Entries.empty(),
+                "-exploration-shards cannot be used with -entry or -entries");
+
+    auto Explore = [&Generator](ShardChannel &Channel,
+                                uint64_t Start,
+                                uint64_t End) {
+      Generator.exploreShard(Channel, Start, End);
+      Generator.translate(llvm::None);
+    };
+    auto JumpTargets = exploreSharded(TheBinary, ExplorationShards, Explore);
+    revng_check(JumpTargets.hasValue(), "The exploration of a shard failed");
+    Generator.seedJumpTargets(std::move(*JumpTargets));
+  }
+
+  Generator.translate(Entries, ExplorationDepth, ExplorationBudget);
   Generator.serialize();
 
   return EXIT_SUCCESS;
@@ -0,0 +1,144 @@
+/// \file PTCDecoder.cpp
+/// \brief This file implements the decoding of input code to PTC in a
+///        background thread.
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+#include <string>
+
+#include "llvm/ADT/STLExtras.h"
+
+#include "revng/Support/Assert.h"
+#include "revng/Support/Statistics.h"
+
+#include "PTCDecoder.h"
+
+static CounterMap<std::string> DecoderStats("ptc-decoder");
+
+PTCDecoder::PTCDecoder(unsigned MaxAhead) :
+  MaxAhead(MaxAhead), InProgress(MetaAddress::invalid()), Quit(false) {
+  if (MaxAhead != 0)
+    Worker = std::thread([this]() { work(); });
+}
+
+PTCDecoder::~PTCDecoder() {
+  if (not Worker.joinable())
+    return;
+
+  {
+    std::lock_guard<std::mutex> Guard(Lock);
+    Quit = true;
+  }
+  Changed.notify_all();
+  Worker.join();
+}
+
+PTCDecoder::DecodedBlock PTCDecoder::decodeNow(MetaAddress Address) {
+  revng_assert(Address.isValid());
+
+  PTCCodeType Type = PTC_CODE_REGULAR;
+  switch (Address.type()) {
+  case MetaAddressType::Invalid:
+    revng_abort();
+
+  case MetaAddressType::Code_arm_thumb:
+    Type = PTC_CODE_ARM_THUMB;
+    break;
+
+  default:
+    Type = PTC_CODE_REGULAR;
+    break;
+  }
+
+  DecodedBlock Result;
+  Result.Instructions = newPTCInstructionList();
+
+  std::lock_guard<std::mutex> Guard(PTCLock);
+  Result.ConsumedSize = ptc.translate(Address.address(),
+                                      Type,
+                                      Result.Instructions.get());
+  return Result;
+}
+
+void PTCDecoder::prefetch(llvm::ArrayRef<MetaAddress> Upcoming) {
+  if (MaxAhead == 0)
+    return;
+
+  Upcoming = Upcoming.take_front(MaxAhead);
+  auto IsUpcoming = [&Upcoming](const MetaAddress &Address) {
+    return llvm::is_contained(Upcoming, Address);
+  };
+
+  {
+    std::lock_guard<std::mutex> Guard(Lock);
+
+    // Drop the decoded blocks nobody's going to ask for
+    for (auto It = Ready.begin(); It != Ready.end();) {
+      if (IsUpcoming(It->first)) {
+        ++It;
+      } else {
+        DecoderStats.push("discarded");
+        It = Ready.erase(It);
+      }
+    }
+
+    // Enqueue, in order, what's neither decoded nor being decoded
+    Pending.clear();
+    for (const MetaAddress &Address : Upcoming)
+      if (Address != InProgress and Ready.count(Address) == 0)
+        Pending.push_back(Address);
+  }
+
+  Changed.notify_all();
+}
+
+PTCDecoder::DecodedBlock PTCDecoder::decode(MetaAddress Address) {
+  if (MaxAhead == 0)
+    return decodeNow(Address);
+
+  {
+    std::unique_lock<std::mutex> Guard(Lock);
+
+    // If the worker is taking care of Address, wait for it to be done
+    Changed.wait(Guard, [this, &Address]() { return InProgress != Address; });
+
+    auto It = Ready.find(Address);
+    if (It != Ready.end()) {
+      DecoderStats.push("prefetched");
+      DecodedBlock Result = std::move(It->second);
+      Ready.erase(It);
+      return Result;
+    }
+
+    // We're going to decode Address ourselves, make sure the worker won't
+    auto NewEnd = std::remove(Pending.begin(), Pending.end(), Address);
+    Pending.erase(NewEnd, Pending.end());
+  }
+
+  DecoderStats.push("synchronous");
+  return decodeNow(Address);
+}
+
+void PTCDecoder::work() {
+  std::unique_lock<std::mutex> Guard(Lock);
+  while (true) {
+    Changed.wait(Guard, [this]() { return Quit or not Pending.empty(); });
+    if (Quit)
+      return;
+
+    MetaAddress Address = Pending.front();
+    Pending.pop_front();
+    InProgress = Address;
+
+    Guard.unlock();
+    DecodedBlock Result = decodeNow(Address);
+    Guard.lock();
+
+    InProgress = MetaAddress::invalid();
+    Ready[Address] = std::move(Result);
+    Changed.notify_all();
+  }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include "llvm/ADT/ArrayRef.h"
+
+#include "revng/Support/MetaAddress.h"
+
+#include "PTCInterface.h"
+
+/// \brief Decodes input code to PTC, possibly ahead of time
+///
+/// libtinycode is not reentrant, therefore a single worker thread performs all
+/// the background calls to `ptc.translate`. The worker consumes the list of
+/// addresses that are going to be translated soon (typically, the next entries
+/// of the JumpTargetManager worklist) and keeps the resulting instruction lists
+/// until they are requested through `decode`. This way, the decoding of the
+/// upcoming translation blocks overlaps with the emission of the LLVM IR for
+/// the current one, which stays serialized.
+///
+/// Decoding an address always produces the same instruction list, therefore
+/// the generated IR does not depend on whether an address has been prefetched
+/// or not.
+class PTCDecoder {
+public:
+  struct DecodedBlock {
+    PTCInstructionListPtr Instructions;
+    size_t ConsumedSize = 0;
+  };
+
+public:
+  /// \param MaxAhead maximum number of addresses to decode in advance. If zero,
+  ///        no worker thread is created and `decode` always invokes
+  ///        libtinycode synchronously.
+  PTCDecoder(unsigned MaxAhead);
+  ~PTCDecoder();
+
+public:
+  /// \brief Replace the list of addresses to decode in background
+  ///
+  /// Pending requests and already decoded blocks for addresses not in
+  /// \p Upcoming are discarded. Only the first MaxAhead addresses are
+  /// considered.
+  void prefetch(llvm::ArrayRef<MetaAddress> Upcoming);
+
+  /// \brief Obtain the PTC of the code starting at \p Address
+  ///
+  /// If \p Address has been prefetched, wait for its decoding to complete (if
+  /// necessary), otherwise decode it synchronously.
+  DecodedBlock decode(MetaAddress Address);
+
+private:
+  static DecodedBlock decodeNow(MetaAddress Address);
+  void work();
+
+private:
+  const unsigned MaxAhead;
+  std::mutex Lock;
+  std::condition_variable Changed;
+  std::deque<MetaAddress> Pending;
+  std::map<MetaAddress, DecodedBlock> Ready;
+  MetaAddress InProgress;
+  bool Quit;
+  std::thread Worker;
+};
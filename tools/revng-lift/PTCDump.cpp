@@ -254,7 +254,10 @@ void disassemble(std::ostream &Result,
 
   // Using SIZE_MAX is not very nice but the code should disassemble only a
   // single instruction nonetheless.
-  ptc.disassemble(MemoryStream, PC.asPC(), MaxBytes, InstructionCount);
+  {
+    std::lock_guard<std::mutex> Guard(PTCLock);
+    ptc.disassemble(MemoryStream, PC.asPC(), MaxBytes, InstructionCount);
+  }
   fflush(MemoryStream);
 
   revng_assert(BufferPtr != nullptr);
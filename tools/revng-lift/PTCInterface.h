@@ -5,7 +5,9 @@
 //
 
 #include <memory>
+#include <mutex>
 #include <type_traits>
+#include <vector>
 
 #include "revng/Support/revng.h"
 
@@ -15,9 +17,46 @@
 template<void (*T)(PTCInstructionList *)>
 using PTCDestructorWrapper = std::integral_constant<decltype(T), T>;
 
+/// \brief Recycles PTCInstructionList objects across translation blocks
+///
+/// The content of a list is allocated by libtinycode and it's released as soon
+/// as the list is destroyed, but the list itself is kept here to be handed out
+/// again, instead of going back to the heap.
+class PTCInstructionListPool {
+private:
+  static constexpr size_t MaxSize = 64;
+
+private:
+  std::mutex Lock;
+  std::vector<std::unique_ptr<PTCInstructionList>> Free;
+
+public:
+  PTCInstructionList *acquire() {
+    std::lock_guard<std::mutex> Guard(Lock);
+    if (Free.empty())
+      return new PTCInstructionList;
+
+    PTCInstructionList *Result = Free.back().release();
+    Free.pop_back();
+    return Result;
+  }
+
+  void release(PTCInstructionList *List) {
+    ptc_instruction_list_free(List);
+    *List = PTCInstructionList{};
+
+    std::lock_guard<std::mutex> Guard(Lock);
+    if (Free.size() < MaxSize)
+      Free.emplace_back(List);
+    else
+      delete List;
+  }
+};
+
+extern PTCInstructionListPool PTCListPool;
+
 inline void PTCInstructionListDestructor(PTCInstructionList *This) {
-  ptc_instruction_list_free(This);
-  delete This;
+  PTCListPool.release(This);
 }
 
 using PTCDestructor = PTCDestructorWrapper<&PTCInstructionListDestructor>;
@@ -25,4 +64,15 @@ using PTCDestructor = PTCDestructorWrapper<&PTCInstructionListDestructor>;
 using PTCInstructionListPtr = std::unique_ptr<PTCInstructionList,
                                               PTCDestructor>;
 
+/// \brief Obtain an empty PTCInstructionList, possibly a recycled one
+inline PTCInstructionListPtr newPTCInstructionList() {
+  return PTCInstructionListPtr(PTCListPool.acquire());
+}
+
 extern PTCInterface ptc;
+
+/// \brief Lock to hold while invoking the stateful parts of libtinycode
+///
+/// The accessors for the content of a PTCInstructionList can be used freely,
+/// but translation and disassembly must never run concurrently.
+extern std::mutex PTCLock;
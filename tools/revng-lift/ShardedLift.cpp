@@ -0,0 +1,353 @@
+/// \file ShardedLift.cpp
+/// \brief This file implements the exploration of the jump targets split among
+///        several processes.
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+
+#include "revng/Support/Assert.h"
+#include "revng/Support/Debug.h"
+
+#include "BinaryFile.h"
+#include "JumpTargetManager.h"
+#include "ShardedLift.h"
+
+using namespace llvm;
+
+static Logger<> Log("sharded-lift");
+
+static std::string formatJT(char Kind, MetaAddress PC, uint32_t Reasons) {
+  return std::string(1, Kind) + " " + PC.toString() + " "
+         + std::to_string(Reasons) + "\n";
+}
+
+/// Parse a `<kind> <pc> <reasons>` message
+static bool parseJT(StringRef Message, MetaAddress &PC, uint32_t &Reasons) {
+  SmallVector<StringRef, 3> Fields;
+  Message.split(Fields, ' ');
+  if (Fields.size() != 3)
+    return false;
+
+  PC = MetaAddress::fromString(Fields[1]);
+  return PC.isValid() and not Fields[2].getAsInteger(10, Reasons);
+}
+
+ShardChannel::ShardChannel(int InputFD, int OutputFD) :
+  Input(fdopen(InputFD, "r")), Output(fdopen(OutputFD, "w")) {
+  revng_check(Input != nullptr and Output != nullptr);
+}
+
+ShardChannel::~ShardChannel() {
+  fclose(Input);
+  fclose(Output);
+}
+
+bool ShardChannel::exchange(JumpTargetManager &JTM) {
+  // Send the jump targets that are new, or have new reasons
+  for (const auto &[PC, Reasons] : JTM.outOfShard()) {
+    uint32_t &SentReasons = Sent[PC];
+    if ((SentReasons | Reasons) != SentReasons) {
+      SentReasons |= Reasons;
+      fputs(formatJT('T', PC, SentReasons).c_str(), Output);
+    }
+  }
+  fputs("I\n", Output);
+  fflush(Output);
+
+  bool Registered = false;
+  char Line[256];
+  while (fgets(Line, sizeof(Line), Input) != nullptr) {
+    StringRef Message = StringRef(Line).rtrim();
+    if (Message == "G")
+      return Registered;
+    else if (Message == "D")
+      return false;
+
+    MetaAddress PC = MetaAddress::invalid();
+    uint32_t Reasons = 0;
+    revng_check(Message.startswith("T ") and parseJT(Message, PC, Reasons),
+                "Unexpected message from the coordinator");
+    JTM.registerJTWithReasons(PC, Reasons);
+    Registered = true;
+  }
+
+  revng_abort("The coordinator went away");
+}
+
+void ShardChannel::finish(const JumpTargetManager &JTM) {
+  for (const auto &[PC, JT] : JTM)
+    fputs(formatJT('J', PC, JT.getReasons()).c_str(), Output);
+  for (const auto &[PC, Reasons] : JTM.outOfShard())
+    fputs(formatJT('J', PC, Reasons).c_str(), Output);
+  fputs("E\n", Output);
+  fflush(Output);
+}
+
+namespace {
+
+/// \brief The coordinator's view of a shard
+struct Shard {
+  pid_t Process = -1;
+  int ToShard = -1;
+  int FromShard = -1;
+
+  /// Data received but not yet handled, i.e., an incomplete line
+  std::string Buffer;
+
+  /// The shard is waiting for new jump targets
+  bool Idle = false;
+
+  /// The shard sent its last message
+  bool Done = false;
+
+  /// Jump targets to send when the shard is idle, with their reasons
+  std::map<MetaAddress, uint32_t> Pending;
+
+  /// Jump targets sent (or to send) to the shard, with their reasons
+  std::map<MetaAddress, uint32_t> Sent;
+};
+
+} // namespace
+
+/// \brief Split the address space in \p Count ranges with the same amount of
+///        executable code
+///
+/// \return the boundaries of the ranges, there might be less than \p Count
+///         ranges if there's little code.
+static std::vector<uint64_t>
+splitAddressSpace(const BinaryFile &Binary, unsigned Count) {
+  std::vector<std::pair<uint64_t, uint64_t>> Code;
+  uint64_t Total = 0;
+  for (const SegmentInfo &Segment : Binary.segments()) {
+    if (not Segment.IsExecutable)
+      continue;
+
+    uint64_t Start = Segment.StartVirtualAddress.address();
+    uint64_t End = Segment.EndVirtualAddress.address();
+    Code.emplace_back(Start, End);
+    Total += End - Start;
+  }
+  std::sort(Code.begin(), Code.end());
+
+  std::vector<uint64_t> Result = { 0 };
+  uint64_t Share = std::max<uint64_t>((Total + Count - 1) / Count, 1);
+  uint64_t Accumulated = 0;
+  for (const auto &[Start, End] : Code) {
+    while (Result.size() < Count
+           and Accumulated + (End - Start) > Share * Result.size()) {
+      uint64_t Cut = Start + (Share * Result.size() - Accumulated);
+      if (Cut <= Result.back())
+        break;
+      Result.push_back(Cut);
+    }
+    Accumulated += End - Start;
+  }
+  Result.push_back(std::numeric_limits<uint64_t>::max());
+
+  return Result;
+}
+
+static bool writeAll(int FD, StringRef Data) {
+  while (not Data.empty()) {
+    ssize_t Written = write(FD, Data.data(), Data.size());
+    if (Written < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    Data = Data.drop_front(Written);
+  }
+  return true;
+}
+
+Optional<std::map<MetaAddress, uint32_t>>
+exploreSharded(const BinaryFile &Binary, unsigned Count, ExploreShard Explore) {
+  std::vector<uint64_t> Boundaries = splitAddressSpace(Binary, Count);
+  std::vector<Shard> Shards(Boundaries.size() - 1);
+  revng_log(Log, "Exploring with " << Shards.size() << " shards");
+
+  auto OwnerOf = [&Boundaries, &Shards](MetaAddress PC) -> Shard & {
+    auto It = std::upper_bound(Boundaries.begin(),
+                               Boundaries.end(),
+                               PC.address());
+    return Shards[It - Boundaries.begin() - 1];
+  };
+
+  // A shard might exit while we're writing to it, we'll notice anyway
+  signal(SIGPIPE, SIG_IGN);
+
+  // Don't let the shards print again what's still buffered
+  fflush(nullptr);
+
+  for (unsigned I = 0; I < Shards.size(); ++I) {
+    int ToShard[2];
+    int FromShard[2];
+    revng_check(pipe(ToShard) == 0 and pipe(FromShard) == 0,
+                "Couldn't create the pipes for a shard");
+
+    pid_t Process = fork();
+    revng_check(Process != -1, "Couldn't fork a shard");
+    if (Process == 0) {
+      for (unsigned J = 0; J < I; ++J) {
+        close(Shards[J].ToShard);
+        close(Shards[J].FromShard);
+      }
+      close(ToShard[1]);
+      close(FromShard[0]);
+
+      {
+        ShardChannel Channel(ToShard[0], FromShard[1]);
+        Explore(Channel, Boundaries[I], Boundaries[I + 1]);
+      }
+
+      std::exit(EXIT_SUCCESS);
+    }
+
+    close(ToShard[0]);
+    close(FromShard[1]);
+    Shards[I].Process = Process;
+    Shards[I].ToShard = ToShard[1];
+    Shards[I].FromShard = FromShard[0];
+  }
+
+  std::map<MetaAddress, uint32_t> Result;
+  bool Failed = false;
+  bool Finishing = false;
+  unsigned Running = Shards.size();
+  unsigned Routed = 0;
+
+  auto Handle = [&](Shard &Sender, StringRef Message) {
+    MetaAddress PC = MetaAddress::invalid();
+    uint32_t Reasons = 0;
+    if (Message == "I") {
+      Sender.Idle = true;
+    } else if (Message == "E") {
+      Sender.Done = true;
+      --Running;
+    } else if (Message.startswith("T ") and parseJT(Message, PC, Reasons)) {
+      // Route the jump target to its owner, unless it already knows it
+      Shard &Owner = OwnerOf(PC);
+      uint32_t &Known = Owner.Sent[PC];
+      if ((Known | Reasons) != Known) {
+        Known |= Reasons;
+        Owner.Pending[PC] = Known;
+        ++Routed;
+      }
+    } else if (Message.startswith("J ") and parseJT(Message, PC, Reasons)) {
+      Result[PC] |= Reasons;
+    } else {
+      return false;
+    }
+    return true;
+  };
+
+  while (Running != 0 and not Failed) {
+    // Resume the idle shards that have new jump targets to explore
+    bool AllIdle = true;
+    for (Shard &S : Shards) {
+      if (Finishing)
+        break;
+
+      if (S.Idle and not S.Pending.empty()) {
+        std::string Messages;
+        for (const auto &[PC, Reasons] : S.Pending)
+          Messages += formatJT('T', PC, Reasons);
+        Messages += "G\n";
+        S.Pending.clear();
+        S.Idle = false;
+        Failed = Failed or not writeAll(S.ToShard, Messages);
+      }
+
+      AllIdle = AllIdle and S.Idle;
+    }
+
+    // All the shards are waiting and there's nothing left to route
+    if (AllIdle and not Finishing) {
+      revng_log(Log, "Exploration over, " << Routed << " jump targets routed");
+      Finishing = true;
+      for (Shard &S : Shards)
+        Failed = Failed or not writeAll(S.ToShard, "D\n");
+    }
+
+    std::vector<pollfd> Descriptors;
+    std::vector<Shard *> Polled;
+    for (Shard &S : Shards) {
+      if (not S.Done) {
+        Descriptors.push_back({ S.FromShard, POLLIN, 0 });
+        Polled.push_back(&S);
+      }
+    }
+
+    if (Failed or Descriptors.empty())
+      break;
+
+    if (poll(Descriptors.data(), Descriptors.size(), -1) < 0) {
+      Failed = errno != EINTR;
+      continue;
+    }
+
+    for (size_t I = 0; I < Descriptors.size() and not Failed; ++I) {
+      if (Descriptors[I].revents == 0)
+        continue;
+
+      Shard &S = *Polled[I];
+      char Buffer[4096];
+      ssize_t Size = read(S.FromShard, Buffer, sizeof(Buffer));
+      if (Size < 0 and errno == EINTR)
+        continue;
+
+      // The shard went away before its last message
+      if (Size <= 0) {
+        Failed = true;
+        break;
+      }
+
+      S.Buffer.append(Buffer, Size);
+      size_t NewLine = 0;
+      while ((NewLine = S.Buffer.find('\n')) != std::string::npos) {
+        std::string Message = S.Buffer.substr(0, NewLine);
+        S.Buffer.erase(0, NewLine + 1);
+        if (not Handle(S, Message)) {
+          Failed = true;
+          break;
+        }
+      }
+    }
+  }
+
+  for (Shard &S : Shards) {
+    if (Failed and not S.Done)
+      kill(S.Process, SIGKILL);
+
+    close(S.ToShard);
+    close(S.FromShard);
+
+    int Status = 0;
+    if (waitpid(S.Process, &Status, 0) == -1 or not WIFEXITED(Status)
+        or WEXITSTATUS(Status) != EXIT_SUCCESS)
+      Failed = true;
+  }
+
+  if (Failed)
+    return None;
+
+  revng_log(Log, "The shards found " << Result.size() << " jump targets");
+
+  return Result;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/STLExtras.h"
+
+#include "revng/Support/MetaAddress.h"
+
+class BinaryFile;
+class JumpTargetManager;
+
+/// \brief The end of the channel between a shard and the coordinator owned by
+///        the shard
+///
+/// The shard and the coordinator exchange lines of text through a pair of
+/// pipes:
+///
+/// * `T <pc> <reasons>`: a jump target, along with the bitmask of its reasons.
+///   From the shard: a jump target it met out of its range. From the
+///   coordinator: a jump target met by another shard within this one's range.
+/// * `I`: from the shard, it has nothing left to explore.
+/// * `G`: from the coordinator, new jump targets have been sent, go on.
+/// * `D`: from the coordinator, all the shards are done.
+/// * `J <pc> <reasons>`: from the shard, a jump target it found, once done.
+/// * `E`: from the shard, the last message.
+class ShardChannel {
+private:
+  FILE *Input;
+  FILE *Output;
+
+  /// The jump targets handed over to the coordinator, with their reasons
+  std::map<MetaAddress, uint32_t> Sent;
+
+public:
+  ShardChannel(int InputFD, int OutputFD);
+  ~ShardChannel();
+
+public:
+  /// \brief Hand the jump targets out of the shard over to the coordinator and
+  ///        register those it sends back
+  ///
+  /// \return true if new jump targets have been registered, false if the
+  ///         exploration is over.
+  bool exchange(JumpTargetManager &JTM);
+
+  /// \brief Report all the jump targets known to \p JTM to the coordinator
+  void finish(const JumpTargetManager &JTM);
+};
+
+/// \brief Function exploring the shard [Start, End) of the input binary
+using ExploreShard = llvm::function_ref<void(ShardChannel &Channel,
+                                             uint64_t Start,
+                                             uint64_t End)>;
+
+/// \brief Explore the jump targets of \p Binary with \p Count processes
+///
+/// The address space is split in ranges covering the same amount of
+/// executable code, and each one is explored by \p Explore in a forked
+/// process. The jump targets a shard meets out of its range are routed to the
+/// shard owning them, which resumes its exploration. Once all the shards have
+/// nothing left to explore, each one reports the jump targets it found.
+///
+/// libtinycode has global state, each shard gets a copy of it by forking.
+///
+/// \return all the jump targets found by the shards, along with their reasons,
+///         or `None` if a shard failed.
+llvm::Optional<std::map<MetaAddress, uint32_t>>
+exploreSharded(const BinaryFile &Binary, unsigned Count, ExploreShard Explore);
@@ -7,6 +7,7 @@
 //
 
 #include <cstdint>
+#include <map>
 #include <set>
 #include <sstream>
 #include <stack>
@@ -42,6 +43,12 @@ static cl::alias A1("E",
                     cl::aliasopt(External),
                     cl::cat(MainCategory));
 
+static cl::opt<bool> ThreadLocalCSVs("thread-local-csvs",
+                                     cl::desc("make the CSVs and the other "
+                                              "variables describing the CPU "
+                                              "state thread-local"),
+                                     cl::cat(MainCategory));
+
 class OffsetValueStack {
 
 private:
@@ -242,6 +249,9 @@ VariableManager::VariableManager(Module &M, Architecture &TargetArchitecture) :
       }
     }
   }
+
+  // Each offset in the CPU state can be the start of a CSV
+  CPUStateGlobals.resize(ModuleLayout->getTypeAllocSize(CPUStateType));
 }
 
 Optional<StoreInst *>
@@ -422,20 +432,62 @@ void VariableManager::rebuildCSVList() {
   QuickMetadata QMD(Context);
   NamedMDNode *NamedMD = TheModule.getOrInsertNamedMetadata("revng.csv");
   std::vector<Metadata *> CSVsMD;
-  for (auto &P : CPUStateGlobals)
-    CSVsMD.push_back(QMD.get(P.second));
+  forEachCSV([&](intptr_t, GlobalVariable *CSV) {
+    CSVsMD.push_back(QMD.get(CSV));
+  });
   NamedMD->clearOperands();
   NamedMD->addOperand(QMD.tuple(CSVsMD));
 }
 
+unsigned VariableManager::dropUnusedCSVs(const std::set<StringRef> &Keep) {
+  unsigned Dropped = 0;
+  for (GlobalVariable *&CSV : CPUStateGlobals) {
+    if (CSV == nullptr)
+      continue;
+
+    CSV->removeDeadConstantUsers();
+    if (not CSV->use_empty() or Keep.count(CSV->getName()) != 0)
+      continue;
+
+    CSV->eraseFromParent();
+    CSV = nullptr;
+    ++Dropped;
+  }
+
+  if (Dropped != 0)
+    rebuildCSVList();
+
+  return Dropped;
+}
+
 void VariableManager::finalize() {
   LLVMContext &Context = getContext(&TheModule);
 
   if (not External) {
-    for (auto &P : CPUStateGlobals)
-      P.second->setLinkage(GlobalValue::InternalLinkage);
-    for (auto &P : OtherGlobals)
-      P.second->setLinkage(GlobalValue::InternalLinkage);
+    forEachCSV([](intptr_t, GlobalVariable *CSV) {
+      CSV->setLinkage(GlobalValue::InternalLinkage);
+    });
+    for (GlobalVariable *Global : OtherGlobals)
+      if (Global != nullptr)
+        Global->setLinkage(GlobalValue::InternalLinkage);
+  }
+
+  if (ThreadLocalCSVs) {
+    // Each thread has its own CPU state
+    auto MakeThreadLocal = [](GlobalVariable *Global) {
+      Global->setThreadLocalMode(GlobalValue::InitialExecTLSModel);
+    };
+
+    forEachCSV([&](intptr_t, GlobalVariable *CSV) { MakeThreadLocal(CSV); });
+    for (GlobalVariable *Global : OtherGlobals)
+      if (Global != nullptr)
+        MakeThreadLocal(Global);
+
+    if (Env != nullptr)
+      MakeThreadLocal(Env);
+
+    if (auto *Exiting = TheModule.getGlobalVariable("cpu_loop_exiting"))
+      MakeThreadLocal(Exiting);
   }
 
   IRBuilder<> Builder(Context);
@@ -474,23 +526,21 @@ void VariableManager::finalize() {
 
   // Create the switch statement
   Builder.SetInsertPoint(EntryBB);
-  auto *Switch = Builder.CreateSwitch(RegisterID,
-                                      DefaultBB,
-                                      CPUStateGlobals.size());
-  for (auto &P : CPUStateGlobals) {
-    Type *CSVTy = P.second->getType();
+  auto *Switch = Builder.CreateSwitch(RegisterID, DefaultBB);
+  forEachCSV([&](intptr_t Offset, GlobalVariable *CSV) {
+    Type *CSVTy = CSV->getType();
     auto *CSVIntTy = cast<IntegerType>(CSVTy->getPointerElementType());
     if (CSVIntTy->getBitWidth() <= 64) {
       // Set the value of the CSV
       auto *SetRegisterBB = BasicBlock::Create(Context, "", SetRegister);
       Builder.SetInsertPoint(SetRegisterBB);
-      Builder.CreateStore(Builder.CreateTrunc(NewValue, CSVIntTy), P.second);
+      Builder.CreateStore(Builder.CreateTrunc(NewValue, CSVIntTy), CSV);
       Builder.CreateBr(ReturnBB);
 
       // Add the case to the switch
-      Switch->addCase(Builder.getInt32(P.first), SetRegisterBB);
+      Switch->addCase(Builder.getInt32(Offset), SetRegisterBB);
     }
-  }
+  });
 
   // Finally, populate the return basic block
   Builder.SetInsertPoint(ReturnBB);
@@ -541,11 +591,10 @@ VariableManager::getByCPUStateOffset(intptr_t Offset, std::string Name) {
 std::pair<GlobalVariable *, unsigned>
 VariableManager::getByCPUStateOffsetInternal(intptr_t Offset,
                                              std::string Name) {
-  GlobalsMap::iterator it = CPUStateGlobals.find(Offset);
+  GlobalVariable *Existing = csvAt(Offset);
   static const char *UnknownCSVPref = "state_0x";
-  if (it == CPUStateGlobals.end()
-      || (Name.size() != 0
-          && it->second->getName().startswith(UnknownCSVPref))) {
+  if (Existing == nullptr
+      || (Name.size() != 0 && Existing->getName().startswith(UnknownCSVPref))) {
     Type *VariableType;
     unsigned Remaining;
     std::tie(VariableType,
@@ -557,9 +606,8 @@ VariableManager::getByCPUStateOffsetInternal(intptr_t Offset,
 
     // Check we're not trying to go inside an existing variable
     if (Remaining != 0) {
-      GlobalsMap::iterator it = CPUStateGlobals.find(Offset - Remaining);
-      if (it != CPUStateGlobals.end())
-        return { it->second, Remaining };
+      if (GlobalVariable *Container = csvAt(Offset - Remaining))
+        return { Container, Remaining };
     }
 
     if (Name.size() == 0) {
@@ -580,18 +628,20 @@ VariableManager::getByCPUStateOffsetInternal(intptr_t Offset,
                                            Name);
     revng_assert(NewVariable != nullptr);
 
-    if (it != CPUStateGlobals.end()) {
-      it->second->replaceAllUsesWith(NewVariable);
-      it->second->eraseFromParent();
+    if (Existing != nullptr) {
+      Existing->replaceAllUsesWith(NewVariable);
+      Existing->eraseFromParent();
     }
 
+    revng_assert(Offset >= 0
+                 and static_cast<size_t>(Offset) < CPUStateGlobals.size());
     CPUStateGlobals[Offset] = NewVariable;
 
     rebuildCSVList();
 
     return { NewVariable, Remaining };
   } else {
-    return { it->second, 0 };
+    return { Existing, 0 };
   }
 }
 
@@ -612,9 +662,11 @@ VariableManager::getOrCreate(unsigned TemporaryId, bool Reading) {
       revng_assert(Result != nullptr);
       return { false, Result };
     } else {
-      GlobalsMap::iterator it = OtherGlobals.find(TemporaryId);
-      if (it != OtherGlobals.end()) {
-        return { false, it->second };
+      if (TemporaryId >= OtherGlobals.size())
+        OtherGlobals.resize(TemporaryId + 1, nullptr);
+
+      if (GlobalVariable *Existing = OtherGlobals[TemporaryId]) {
+        return { false, Existing };
       } else {
         // TODO: what do we have here, apart from env?
         auto InitialValue = ConstantInt::get(VariableType, 0);
@@ -638,18 +690,16 @@ VariableManager::getOrCreate(unsigned TemporaryId, bool Reading) {
       }
     }
   } else if (Temporary->temp_local) {
-    auto it = LocalTemporaries.find(TemporaryId);
-    if (it != LocalTemporaries.end()) {
-      return { false, it->second };
+    if (AllocaInst *Existing = LocalTemporaries.get(TemporaryId)) {
+      return { false, Existing };
     } else {
       AllocaInst *NewTemporary = AllocaBuilder.CreateAlloca(VariableType);
-      LocalTemporaries[TemporaryId] = NewTemporary;
+      LocalTemporaries.set(TemporaryId, NewTemporary);
       return { true, NewTemporary };
     }
   } else {
-    auto it = Temporaries.find(TemporaryId);
-    if (it != Temporaries.end()) {
-      return { false, it->second };
+    if (AllocaInst *Existing = Temporaries.get(TemporaryId)) {
+      return { false, Existing };
     } else {
       // Can't read a temporary if it has never been written, we're probably
       // translating rubbish
@@ -657,7 +707,7 @@ VariableManager::getOrCreate(unsigned TemporaryId, bool Reading) {
         return { false, nullptr };
 
       AllocaInst *NewTemporary = AllocaBuilder.CreateAlloca(VariableType);
-      Temporaries[TemporaryId] = NewTemporary;
+      Temporaries.set(TemporaryId, NewTemporary);
       return { true, NewTemporary };
     }
   }
@@ -5,8 +5,9 @@
 //
 
 #include <cstdint>
-#include <map>
+#include <set>
 #include <string>
+#include <vector>
 
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/Pass.h"
@@ -29,6 +30,54 @@ class Value;
 
 class VariableManager;
 
+/// \brief Dense map from PTC temporary indices to their allocas
+///
+/// Entries are tagged with the generation they have been created in, so that
+/// clearing the table only requires bumping the current generation.
+class TemporariesTable {
+private:
+  struct Entry {
+    unsigned Generation = 0;
+    llvm::AllocaInst *Alloca = nullptr;
+  };
+
+private:
+  std::vector<Entry> Entries;
+  unsigned Generation = 1;
+
+public:
+  llvm::AllocaInst *get(unsigned Index) const {
+    if (Index >= Entries.size() or Entries[Index].Generation != Generation)
+      return nullptr;
+    return Entries[Index].Alloca;
+  }
+
+  void set(unsigned Index, llvm::AllocaInst *Alloca) {
+    if (Index >= Entries.size())
+      Entries.resize(Index + 1);
+    Entries[Index] = { Generation, Alloca };
+  }
+
+  void clear() {
+    ++Generation;
+
+    // Upon wrap around, stale entries could become valid again
+    if (Generation == 0) {
+      Entries.clear();
+      Generation = 1;
+    }
+  }
+
+  /// \brief Collect all the entries of the current generation, sorted by index
+  std::vector<llvm::AllocaInst *> values() const {
+    std::vector<llvm::AllocaInst *> Result;
+    for (const Entry &E : Entries)
+      if (E.Generation == Generation)
+        Result.push_back(E.Alloca);
+    return Result;
+  }
+};
+
 // TODO: rename
 extern llvm::cl::opt<bool> External;
 
@@ -114,12 +163,7 @@ public:
     ModuleLayout = NewLayout;
   }
 
-  std::vector<llvm::AllocaInst *> locals() {
-    std::vector<llvm::AllocaInst *> Locals;
-    for (auto Pair : LocalTemporaries)
-      Locals.push_back(Pair.second);
-    return Locals;
-  }
+  std::vector<llvm::AllocaInst *> locals() { return LocalTemporaries.values(); }
 
   llvm::Value *loadFromEnvOffset(llvm::IRBuilder<> &Builder,
                                  unsigned LoadSize,
@@ -140,6 +184,13 @@ public:
                          unsigned Offset,
                          bool EnvIsSrc);
 
+  /// \brief Erase the CSVs without uses, except those named in \p Keep
+  ///
+  /// Must be called before finalize, which makes set_register use all of them.
+  ///
+  /// \return the number of erased CSVs.
+  unsigned dropUnusedCSVs(const std::set<llvm::StringRef> &Keep);
+
   /// \brief Perform finalization steps on variables
   void finalize();
 
@@ -174,15 +225,30 @@ private:
   std::pair<llvm::GlobalVariable *, unsigned>
   getByCPUStateOffsetInternal(intptr_t Offset, std::string Name = "");
 
+  /// \brief Return the CSV starting at \p Offset, if any
+  llvm::GlobalVariable *csvAt(intptr_t Offset) const {
+    if (Offset < 0 or static_cast<size_t>(Offset) >= CPUStateGlobals.size())
+      return nullptr;
+    return CPUStateGlobals[Offset];
+  }
+
+  /// \brief Call \p F on each CSV and its offset, in increasing offset order
+  template<typename F>
+  void forEachCSV(F &&Function) const {
+    for (size_t Offset = 0; Offset < CPUStateGlobals.size(); ++Offset)
+      if (llvm::GlobalVariable *CSV = CPUStateGlobals[Offset])
+        Function(Offset, CSV);
+  }
+
 private:
   llvm::Module &TheModule;
   llvm::IRBuilder<> AllocaBuilder;
-  using TemporariesMap = std::map<unsigned int, llvm::AllocaInst *>;
-  using GlobalsMap = std::map<intptr_t, llvm::GlobalVariable *>;
-  GlobalsMap CPUStateGlobals;
-  GlobalsMap OtherGlobals;
-  TemporariesMap Temporaries;
-  TemporariesMap LocalTemporaries;
+  /// CSVs indexed by their offset in the CPU state, sized after its layout
+  std::vector<llvm::GlobalVariable *> CPUStateGlobals;
+  /// Global PTC temporaries other than CSVs, indexed by temporary index
+  std::vector<llvm::GlobalVariable *> OtherGlobals;
+  TemporariesTable Temporaries;
+  TemporariesTable LocalTemporaries;
   PTCInstructionList *Instructions;
 
   llvm::StructType *CPUStateType;
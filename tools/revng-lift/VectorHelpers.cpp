@@ -0,0 +1,259 @@
+/// \file VectorHelpers.cpp
+/// \brief Replaces calls to QEMU SIMD helpers with LLVM vector IR
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Module.h"
+
+#include "revng/Support/Assert.h"
+#include "revng/Support/CommandLine.h"
+
+#include "VectorHelpers.h"
+
+using namespace llvm;
+
+static cl::opt<bool> NoVectorHelpers("no-vector-helpers",
+                                     cl::desc("keep calls to the QEMU SIMD "
+                                              "helpers instead of emitting "
+                                              "LLVM vector instructions"),
+                                     cl::cat(MainCategory));
+
+namespace {
+
+enum class Operation {
+  Add,
+  Sub,
+  Mul,
+  Equal,
+  SignedGreater,
+  UnsignedGreater,
+  SignedGreaterEqual,
+  UnsignedGreaterEqual,
+  SignedMin,
+  UnsignedMin,
+  SignedMax,
+  UnsignedMax,
+  Narrow,
+  SignedWiden,
+  UnsignedWiden
+};
+
+/// A helper applying Op to each lane of LaneBits bits of its arguments
+struct VectorHelper {
+  Operation Op;
+  unsigned LaneBits;
+};
+
+} // namespace
+
+static const StringMap<VectorHelper> &vectorHelpers() {
+  using O = Operation;
+  static const StringMap<VectorHelper> Helpers = {
+    { "neon_add_u8", { O::Add, 8 } },
+    { "neon_add_u16", { O::Add, 16 } },
+    { "neon_sub_u8", { O::Sub, 8 } },
+    { "neon_sub_u16", { O::Sub, 16 } },
+    { "neon_mul_u8", { O::Mul, 8 } },
+    { "neon_mul_u16", { O::Mul, 16 } },
+    { "neon_ceq_u8", { O::Equal, 8 } },
+    { "neon_ceq_u16", { O::Equal, 16 } },
+    { "neon_ceq_u32", { O::Equal, 32 } },
+    { "neon_cgt_s8", { O::SignedGreater, 8 } },
+    { "neon_cgt_u8", { O::UnsignedGreater, 8 } },
+    { "neon_cgt_s16", { O::SignedGreater, 16 } },
+    { "neon_cgt_u16", { O::UnsignedGreater, 16 } },
+    { "neon_cgt_s32", { O::SignedGreater, 32 } },
+    { "neon_cgt_u32", { O::UnsignedGreater, 32 } },
+    { "neon_cge_s8", { O::SignedGreaterEqual, 8 } },
+    { "neon_cge_u8", { O::UnsignedGreaterEqual, 8 } },
+    { "neon_cge_s16", { O::SignedGreaterEqual, 16 } },
+    { "neon_cge_u16", { O::UnsignedGreaterEqual, 16 } },
+    { "neon_cge_s32", { O::SignedGreaterEqual, 32 } },
+    { "neon_cge_u32", { O::UnsignedGreaterEqual, 32 } },
+    { "neon_min_s8", { O::SignedMin, 8 } },
+    { "neon_min_u8", { O::UnsignedMin, 8 } },
+    { "neon_min_s16", { O::SignedMin, 16 } },
+    { "neon_min_u16", { O::UnsignedMin, 16 } },
+    { "neon_max_s8", { O::SignedMax, 8 } },
+    { "neon_max_u8", { O::UnsignedMax, 8 } },
+    { "neon_max_s16", { O::SignedMax, 16 } },
+    { "neon_max_u16", { O::UnsignedMax, 16 } },
+    { "neon_narrow_u8", { O::Narrow, 16 } },
+    { "neon_narrow_u16", { O::Narrow, 32 } },
+    { "neon_widen_s8", { O::SignedWiden, 8 } },
+    { "neon_widen_u8", { O::UnsignedWiden, 8 } },
+    { "neon_widen_s16", { O::SignedWiden, 16 } },
+    { "neon_widen_u16", { O::UnsignedWiden, 16 } }
+  };
+  return Helpers;
+}
+
+static bool isUnary(Operation Op) {
+  switch (Op) {
+  case Operation::Narrow:
+  case Operation::SignedWiden:
+  case Operation::UnsignedWiden:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/// \return the vector type splitting \p T in lanes of \p LaneBits bits, or
+///         nullptr if \p T is not an integer type made of such lanes
+static FixedVectorType *toVectorType(Type *T, unsigned LaneBits) {
+  auto *Integer = dyn_cast<IntegerType>(T);
+  if (Integer == nullptr)
+    return nullptr;
+
+  unsigned Bits = Integer->getBitWidth();
+  if (Bits < LaneBits or Bits % LaneBits != 0)
+    return nullptr;
+
+  auto *Lane = IntegerType::get(T->getContext(), LaneBits);
+  return FixedVectorType::get(Lane, Bits / LaneBits);
+}
+
+static Value *emitUnary(IRBuilder<> &Builder,
+                        Operation Op,
+                        FixedVectorType *VectorType,
+                        Type *ResultType,
+                        Value *Argument) {
+  unsigned Lanes = VectorType->getNumElements();
+  unsigned LaneBits = VectorType->getScalarSizeInBits();
+  unsigned ResultLaneBits = Op == Operation::Narrow ? LaneBits / 2 :
+                                                      LaneBits * 2;
+  if (ResultType->getIntegerBitWidth() != Lanes * ResultLaneBits)
+    return nullptr;
+
+  auto *ResultLane = Builder.getIntNTy(ResultLaneBits);
+  auto *ResultVectorType = FixedVectorType::get(ResultLane, Lanes);
+
+  Value *Vector = Builder.CreateBitCast(Argument, VectorType);
+  Value *Result = nullptr;
+  switch (Op) {
+  case Operation::Narrow:
+    Result = Builder.CreateTrunc(Vector, ResultVectorType);
+    break;
+  case Operation::SignedWiden:
+    Result = Builder.CreateSExt(Vector, ResultVectorType);
+    break;
+  case Operation::UnsignedWiden:
+    Result = Builder.CreateZExt(Vector, ResultVectorType);
+    break;
+  default:
+    revng_abort();
+  }
+
+  return Builder.CreateBitCast(Result, ResultType);
+}
+
+static Value *emitBinary(IRBuilder<> &Builder,
+                         Operation Op,
+                         FixedVectorType *VectorType,
+                         Value *LHS,
+                         Value *RHS) {
+  Type *ResultType = LHS->getType();
+  LHS = Builder.CreateBitCast(LHS, VectorType);
+  RHS = Builder.CreateBitCast(RHS, VectorType);
+
+  // Comparisons set all the bits of the lanes satisfying them
+  auto Compare = [&](CmpInst::Predicate Predicate) {
+    return Builder.CreateSExt(Builder.CreateICmp(Predicate, LHS, RHS),
+                              VectorType);
+  };
+
+  auto Select = [&](CmpInst::Predicate Predicate) {
+    return Builder.CreateSelect(Builder.CreateICmp(Predicate, LHS, RHS),
+                                LHS,
+                                RHS);
+  };
+
+  Value *Result = nullptr;
+  switch (Op) {
+  case Operation::Add:
+    Result = Builder.CreateAdd(LHS, RHS);
+    break;
+  case Operation::Sub:
+    Result = Builder.CreateSub(LHS, RHS);
+    break;
+  case Operation::Mul:
+    Result = Builder.CreateMul(LHS, RHS);
+    break;
+  case Operation::Equal:
+    Result = Compare(CmpInst::ICMP_EQ);
+    break;
+  case Operation::SignedGreater:
+    Result = Compare(CmpInst::ICMP_SGT);
+    break;
+  case Operation::UnsignedGreater:
+    Result = Compare(CmpInst::ICMP_UGT);
+    break;
+  case Operation::SignedGreaterEqual:
+    Result = Compare(CmpInst::ICMP_SGE);
+    break;
+  case Operation::UnsignedGreaterEqual:
+    Result = Compare(CmpInst::ICMP_UGE);
+    break;
+  case Operation::SignedMin:
+    Result = Select(CmpInst::ICMP_SLT);
+    break;
+  case Operation::UnsignedMin:
+    Result = Select(CmpInst::ICMP_ULT);
+    break;
+  case Operation::SignedMax:
+    Result = Select(CmpInst::ICMP_SGT);
+    break;
+  case Operation::UnsignedMax:
+    Result = Select(CmpInst::ICMP_UGT);
+    break;
+  default:
+    revng_abort();
+  }
+
+  return Builder.CreateBitCast(Result, ResultType);
+}
+
+Value *emitVectorHelper(IRBuilder<> &Builder,
+                        StringRef Name,
+                        Type *ResultType,
+                        ArrayRef<Value *> Arguments) {
+  if (NoVectorHelpers)
+    return nullptr;
+
+  const auto &Helpers = vectorHelpers();
+  auto It = Helpers.find(Name);
+  if (It == Helpers.end())
+    return nullptr;
+
+  // Lanes are mapped onto the bits of the integers through bitcasts, which
+  // match the layout QEMU expects on little endian hosts only
+  const Module *M = Builder.GetInsertBlock()->getModule();
+  if (not M->getDataLayout().isLittleEndian())
+    return nullptr;
+
+  auto [Op, LaneBits] = It->second;
+  if (not ResultType->isIntegerTy() or Arguments.size() == 0)
+    return nullptr;
+
+  auto *VectorType = toVectorType(Arguments[0]->getType(), LaneBits);
+  if (VectorType == nullptr)
+    return nullptr;
+
+  if (isUnary(Op)) {
+    if (Arguments.size() != 1)
+      return nullptr;
+
+    return emitUnary(Builder, Op, VectorType, ResultType, Arguments[0]);
+  } else {
+    if (Arguments.size() != 2 or Arguments[0]->getType() != ResultType
+        or Arguments[1]->getType() != ResultType)
+      return nullptr;
+
+    return emitBinary(Builder, Op, VectorType, Arguments[0], Arguments[1]);
+  }
+}
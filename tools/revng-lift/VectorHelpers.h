@@ -0,0 +1,25 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/IRBuilder.h"
+
+/// \brief Emit LLVM vector IR equivalent to a call to a QEMU SIMD helper
+///
+/// Only the helpers operating on lanes packed in their integer arguments and
+/// return value, such as `neon_add_u8`, are handled. Those operating on the CPU
+/// state through `env` are left alone, since their operands are identified by
+/// CPUStateAccessAnalysis afterwards.
+///
+/// \param Name the name of the helper, without the `helper_` prefix.
+///
+/// \return the value computed by the helper, or `nullptr` if the helper is not
+///         known or its prototype is not the expected one.
+llvm::Value *emitVectorHelper(llvm::IRBuilder<> &Builder,
+                              llvm::StringRef Name,
+                              llvm::Type *ResultType,
+                              llvm::ArrayRef<llvm::Value *> Arguments);
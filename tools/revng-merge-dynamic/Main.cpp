@@ -0,0 +1,984 @@
+/// \file Main.cpp
+/// \brief This file implements revng-merge-dynamic, which extends the dynamic
+///        portion of a translated ELF with the one of the original ELF, so
+///        that the dynamic loader takes care of the symbols, relocations and
+///        libraries of both
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/BinaryFormat/ELF.h"
+#include "llvm/Object/ELF.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/ToolOutputFile.h"
+
+#include "revng/Support/Assert.h"
+#include "revng/Support/CommandLine.h"
+#include "revng/Support/Debug.h"
+
+using namespace llvm::cl;
+
+using llvm::ArrayRef;
+using llvm::StringRef;
+
+namespace ELF = llvm::ELF;
+namespace object = llvm::object;
+
+namespace {
+
+#define DESCRIPTION desc("the ELF to extend")
+opt<std::string> ToExtendPath(Positional,
+                              Required,
+                              DESCRIPTION,
+                              cat(MainCategory));
+#undef DESCRIPTION
+
+#define DESCRIPTION desc("the original ELF")
+opt<std::string> SourcePath(Positional,
+                            Required,
+                            DESCRIPTION,
+                            cat(MainCategory));
+#undef DESCRIPTION
+
+#define DESCRIPTION desc("the output ELF")
+opt<std::string> OutputPath(Positional,
+                            DESCRIPTION,
+                            init("-"),
+                            cat(MainCategory));
+#undef DESCRIPTION
+
+#define DESCRIPTION desc("the base address where dynamic objects have been " \
+                         "loaded")
+opt<std::string> Base("base",
+                      DESCRIPTION,
+                      value_desc("address"),
+                      init("0x400000"),
+                      cat(MainCategory));
+#undef DESCRIPTION
+
+#define DESCRIPTION desc("merge the LOADed segments of the original ELF into " \
+                         "the output ELF")
+opt<bool> MergeLoadSegments("merge-load-segments",
+                            DESCRIPTION,
+                            cat(MainCategory),
+                            init(false));
+#undef DESCRIPTION
+
+#define DESCRIPTION desc("print debug information and warnings")
+opt<bool> Verbose("verbose", DESCRIPTION, cat(MainCategory), init(false));
+#undef DESCRIPTION
+
+} // namespace
+
+static constexpr uint64_t PageSize = 0x1000;
+
+template<typename T>
+static T unwrap(llvm::Expected<T> Value) {
+  if (not Value) {
+    logAllUnhandledErrors(Value.takeError(), llvm::errs(), "");
+    revng_abort();
+  }
+  return std::move(*Value);
+}
+
+template<typename T>
+static T readAt(ArrayRef<uint8_t> Data, uint64_t Offset) {
+  revng_check(Offset + sizeof(T) <= Data.size(), "Read out of the file");
+  T Result;
+  std::memcpy(&Result, Data.data() + Offset, sizeof(T));
+  return Result;
+}
+
+template<typename T>
+static std::vector<T> readArray(ArrayRef<uint8_t> Data) {
+  revng_check(Data.size() % sizeof(T) == 0, "Truncated table");
+  std::vector<T> Result(Data.size() / sizeof(T));
+  if (not Data.empty())
+    std::memcpy(Result.data(), Data.data(), Data.size());
+  return Result;
+}
+
+template<typename T>
+static void appendEntry(std::vector<uint8_t> &Buffer, const T &Value) {
+  auto *Start = reinterpret_cast<const uint8_t *>(&Value);
+  Buffer.insert(Buffer.end(), Start, Start + sizeof(T));
+}
+
+static void append(std::vector<uint8_t> &Buffer, ArrayRef<uint8_t> Data) {
+  Buffer.insert(Buffer.end(), Data.begin(), Data.end());
+}
+
+/// A REL or RELA relocation, independently from its on-disk format
+struct Relocation {
+  uint64_t Offset;
+  uint32_t Symbol;
+  uint32_t Type;
+  int64_t Addend;
+};
+
+static llvm::Optional<uint32_t> relativeRelocation(unsigned Machine) {
+  switch (Machine) {
+  case ELF::EM_X86_64:
+    return ELF::R_X86_64_RELATIVE;
+  case ELF::EM_ARM:
+    return ELF::R_ARM_RELATIVE;
+  case ELF::EM_386:
+    return ELF::R_386_RELATIVE;
+  case ELF::EM_MIPS:
+    // TODO: check
+    return 0xffffffff;
+  case ELF::EM_S390:
+    return ELF::R_390_RELATIVE;
+  default:
+    return llvm::None;
+  }
+}
+
+/// The dynamic portion of an ELF, as seen by the dynamic loader
+template<typename ELFT>
+class ParsedELF {
+public:
+  LLVM_ELF_IMPORT_TYPES_ELFT(ELFT)
+
+  struct Verneed {
+    Elf_Verneed Header;
+    llvm::SmallVector<Elf_Vernaux, 4> Auxiliaries;
+  };
+
+public:
+  ArrayRef<uint8_t> Data;
+  object::ELFFile<ELFT> TheELF;
+  bool IsMips64EL = false;
+
+  ArrayRef<Elf_Phdr> Segments;
+  ArrayRef<Elf_Shdr> Sections;
+
+  const Elf_Phdr *Dynamic = nullptr;
+  /// The dynamic tags, DT_NULL included
+  std::vector<Elf_Dyn> DynamicTags;
+
+  bool IsRela = false;
+  ArrayRef<uint8_t> DynStr;
+  ArrayRef<uint8_t> RelDyn;
+  std::vector<Relocation> RelDynRelocations;
+  std::vector<Relocation> RelPltRelocations;
+  ArrayRef<uint8_t> DynSym;
+  std::vector<Elf_Sym> Symbols;
+  ArrayRef<uint8_t> GNUVersion;
+  std::vector<uint16_t> VersionIndices;
+  std::vector<Verneed> Verneeds;
+
+public:
+  ParsedELF(StringRef Buffer) :
+    Data(reinterpret_cast<const uint8_t *>(Buffer.data()), Buffer.size()),
+    TheELF(unwrap(object::ELFFile<ELFT>::create(Buffer))) {
+    IsMips64EL = TheELF.isMips64EL();
+    Segments = unwrap(TheELF.program_headers());
+    Sections = unwrap(TheELF.sections());
+
+    for (const Elf_Phdr &Segment : Segments)
+      if (Segment.p_type == ELF::PT_DYNAMIC)
+        Dynamic = &Segment;
+
+    if (Dynamic == nullptr)
+      return;
+
+    revng_check(Dynamic->p_offset + Dynamic->p_filesz <= Data.size());
+    auto Content = Data.slice(Dynamic->p_offset, Dynamic->p_filesz);
+    for (uint64_t Offset = 0; Offset < Content.size();
+         Offset += sizeof(Elf_Dyn)) {
+      DynamicTags.push_back(readAt<Elf_Dyn>(Content, Offset));
+      if (DynamicTags.back().getTag() == ELF::DT_NULL)
+        break;
+    }
+    revng_check(not DynamicTags.empty()
+                  and DynamicTags.back().getTag() == ELF::DT_NULL,
+                "The dynamic segment is not terminated by DT_NULL");
+
+    auto PLTRel = tag(ELF::DT_PLTREL);
+    IsRela = (PLTRel and *PLTRel == ELF::DT_RELA) or tag(ELF::DT_RELA);
+
+    DynStr = readTable(ELF::DT_STRTAB, ELF::DT_STRSZ);
+    if (IsRela)
+      RelDyn = readTable(ELF::DT_RELA, ELF::DT_RELASZ);
+    else
+      RelDyn = readTable(ELF::DT_REL, ELF::DT_RELSZ);
+    RelDynRelocations = parseRelocations(RelDyn);
+    RelPltRelocations = parseRelocations(readTable(ELF::DT_JMPREL,
+                                                   ELF::DT_PLTRELSZ));
+
+    // There's no way to know the size of the dynamic symbol table, consider
+    // all the symbols up to the last one used by a relocation
+    uint64_t SymbolsCount = 0;
+    for (const auto *Relocations : { &RelDynRelocations, &RelPltRelocations })
+      for (const Relocation &R : *Relocations)
+        SymbolsCount = std::max<uint64_t>(SymbolsCount, R.Symbol + 1);
+
+    DynSym = readTable(ELF::DT_SYMTAB, ELF::DT_SYMENT, SymbolsCount);
+    Symbols = readArray<Elf_Sym>(DynSym);
+
+    if (auto Address = tag(ELF::DT_VERSYM))
+      GNUVersion = read(*Address, SymbolsCount * sizeof(Elf_Versym));
+    for (const Elf_Versym &Version : readArray<Elf_Versym>(GNUVersion))
+      VersionIndices.push_back(Version.vs_index);
+
+    if (auto Address = tag(ELF::DT_VERNEED)) {
+      auto Count = tag(ELF::DT_VERNEEDNUM);
+      revng_check(Count, "DT_VERNEED without DT_VERNEEDNUM");
+
+      uint64_t Position = offsetOf(*Address, sizeof(Elf_Verneed));
+      for (uint64_t I = 0; I < *Count; ++I) {
+        Verneed &New = Verneeds.emplace_back();
+        New.Header = readAt<Elf_Verneed>(Data, Position);
+
+        uint64_t AuxiliaryPosition = Position + New.Header.vn_aux;
+        for (unsigned J = 0; J < New.Header.vn_cnt; ++J) {
+          auto Auxiliary = readAt<Elf_Vernaux>(Data, AuxiliaryPosition);
+          New.Auxiliaries.push_back(Auxiliary);
+          AuxiliaryPosition += Auxiliary.vna_next;
+        }
+
+        Position += New.Header.vn_next;
+      }
+    }
+  }
+
+  bool isDynamic() const { return Dynamic != nullptr; }
+
+  llvm::Optional<uint64_t> tag(int64_t Tag) const {
+    llvm::Optional<uint64_t> Result;
+    for (const Elf_Dyn &Entry : DynamicTags) {
+      if (Entry.getTag() == Tag) {
+        revng_check(not Result, "Duplicate dynamic tag");
+        Result = Entry.getVal();
+      }
+    }
+    return Result;
+  }
+
+  /// \brief Offset in the file of the \p Size bytes at \p Address
+  uint64_t offsetOf(uint64_t Address, uint64_t Size) const {
+    llvm::Optional<uint64_t> Result;
+    for (const Elf_Phdr &Segment : Segments) {
+      if (Segment.p_type != ELF::PT_LOAD)
+        continue;
+
+      uint64_t Start = Segment.p_vaddr;
+      if (Start <= Address and Address + Size <= Start + Segment.p_filesz) {
+        revng_check(not Result, "Address mapped by multiple segments");
+        Result = Address - Start + Segment.p_offset;
+      }
+    }
+
+    revng_check(Result, "Address not mapped by any segment");
+    revng_check(*Result + Size <= Data.size(), "Address out of the file");
+    return *Result;
+  }
+
+  ArrayRef<uint8_t> read(uint64_t Address, uint64_t Size) const {
+    if (Size == 0)
+      return {};
+    return Data.slice(offsetOf(Address, Size), Size);
+  }
+
+  /// \brief Read the table at the address in \p AddressTag, whose size is the
+  ///        value of \p SizeTag times \p Scale
+  ArrayRef<uint8_t>
+  readTable(int64_t AddressTag, int64_t SizeTag, uint64_t Scale = 1) const {
+    auto Address = tag(AddressTag);
+    auto Size = tag(SizeTag);
+    if (not Address or not Size)
+      return {};
+    return read(*Address, *Size * Scale);
+  }
+
+  std::vector<Relocation> parseRelocations(ArrayRef<uint8_t> Table) const {
+    if (IsRela)
+      return parseRelocations<Elf_Rela>(Table);
+    else
+      return parseRelocations<Elf_Rel>(Table);
+  }
+
+  std::vector<uint8_t>
+  serializeRelocations(ArrayRef<Relocation> Relocations) const {
+    if (IsRela)
+      return serializeRelocations<Elf_Rela>(Relocations);
+    else
+      return serializeRelocations<Elf_Rel>(Relocations);
+  }
+
+  /// \brief Lay out \p List as in .gnu.version_r: the Elf_Vernaux of each
+  ///        entry follow vn_aux and vna_next, the entries follow vn_next
+  static std::vector<uint8_t> serializeVerneeds(ArrayRef<Verneed> List) {
+    std::vector<uint8_t> Result;
+    auto WriteAt = [&Result](uint64_t Position, const auto &Value) {
+      if (Result.size() < Position + sizeof(Value))
+        Result.resize(Position + sizeof(Value));
+      std::memcpy(&Result[Position], &Value, sizeof(Value));
+    };
+
+    uint64_t Position = 0;
+    for (const Verneed &Entry : List) {
+      WriteAt(Position, Entry.Header);
+
+      uint64_t AuxiliaryPosition = Position + Entry.Header.vn_aux;
+      for (const Elf_Vernaux &Auxiliary : Entry.Auxiliaries) {
+        WriteAt(AuxiliaryPosition, Auxiliary);
+        AuxiliaryPosition += Auxiliary.vna_next;
+      }
+
+      Position += Entry.Header.vn_next;
+    }
+
+    return Result;
+  }
+
+  /// \brief Find a PT_LOAD segment overlapping [Address, Address + Size]
+  const Elf_Phdr *segmentByRange(uint64_t Address, uint64_t Size) const {
+    for (const Elf_Phdr &Segment : Segments) {
+      if (Segment.p_type != ELF::PT_LOAD)
+        continue;
+
+      uint64_t Start = Segment.p_vaddr;
+      if (Address + Size >= Start and Start + Segment.p_memsz >= Address)
+        return &Segment;
+    }
+
+    return nullptr;
+  }
+
+  /// \brief An upper bound of the size of the dynamic portion of the ELF
+  uint64_t dynamicSize() const {
+    return (DynSym.size() + DynStr.size() + GNUVersion.size() + RelDyn.size()
+            + Dynamic->p_memsz + Segments.size() * sizeof(Elf_Phdr)
+            + Sections.size() * sizeof(Elf_Shdr));
+  }
+
+private:
+  template<typename T>
+  std::vector<Relocation> parseRelocations(ArrayRef<uint8_t> Table) const {
+    std::vector<Relocation> Result;
+    for (const T &Entry : readArray<T>(Table)) {
+      Relocation &New = Result.emplace_back();
+      New.Offset = Entry.r_offset;
+      New.Symbol = Entry.getSymbol(IsMips64EL);
+      New.Type = Entry.getType(IsMips64EL);
+      New.Addend = 0;
+      if constexpr (std::is_same_v<T, Elf_Rela>)
+        New.Addend = Entry.r_addend;
+    }
+    return Result;
+  }
+
+  template<typename T>
+  std::vector<uint8_t>
+  serializeRelocations(ArrayRef<Relocation> Relocations) const {
+    std::vector<uint8_t> Result;
+    Result.reserve(Relocations.size() * sizeof(T));
+    for (const Relocation &R : Relocations) {
+      T Entry;
+      Entry.r_offset = R.Offset;
+      Entry.setSymbolAndType(R.Symbol, R.Type, IsMips64EL);
+      if constexpr (std::is_same_v<T, Elf_Rela>)
+        Entry.r_addend = R.Addend;
+      appendEntry(Result, Entry);
+    }
+    return Result;
+  }
+};
+
+/// \brief Build an old-style (non-GNU) hash table with a single bucket
+///
+/// The bucket points to the first defined symbol, whose chain points to the
+/// second one and so on, up to the last one, whose chain is 0 and stops the
+/// search: in practice, a hash lookup becomes a linear search.
+///
+/// \todo Build an actual hash table, possibly GNU
+template<typename ELFT>
+static std::vector<uint8_t> buildDummyHashTable(uint32_t SymbolsCount,
+                                                ArrayRef<uint32_t> Defined) {
+  using Elf_Word = typename ELFT::Word;
+  std::vector<Elf_Word> Chain(SymbolsCount);
+  for (Elf_Word &Entry : Chain)
+    Entry = 0;
+  for (size_t I = 0; I + 1 < Defined.size(); ++I)
+    Chain[Defined[I]] = Defined[I + 1];
+
+  std::vector<uint8_t> Result;
+  Result.reserve((3 + Chain.size()) * sizeof(Elf_Word));
+  auto Append = [&Result](uint32_t Value) {
+    Elf_Word Word;
+    Word = Value;
+    appendEntry(Result, Word);
+  };
+
+  // nbucket, nchain, the only bucket and the chains
+  Append(1);
+  Append(SymbolsCount);
+  Append(Defined.empty() ? 0 : Defined[0]);
+  for (const Elf_Word &Entry : Chain)
+    appendEntry(Result, Entry);
+
+  return Result;
+}
+
+template<typename Phdr>
+static std::pair<unsigned, uint64_t> segmentsSortKey(const Phdr &Segment) {
+  unsigned Kind = 4;
+  switch (Segment.p_type) {
+  case ELF::PT_PHDR:
+    Kind = 1;
+    break;
+  case ELF::PT_INTERP:
+    Kind = 2;
+    break;
+  case ELF::PT_LOAD:
+    Kind = 3;
+    break;
+  }
+
+  return { Kind, Segment.p_vaddr };
+}
+
+/// \brief Write to \p Output a copy of \p ToExtendBuffer whose dynamic portion
+///        is extended with the one of \p SourceBuffer
+///
+/// The new dynamic tables are appended in a new PT_LOAD segment, after the
+/// end of the original file and at an address not overlapping any of the
+/// segments of the two ELFs. The section and program headers are moved there
+/// too.
+template<typename ELFT>
+static bool merge(StringRef ToExtendBuffer,
+                  StringRef SourceBuffer,
+                  uint64_t Base,
+                  llvm::raw_ostream &Output) {
+  using Elf_Ehdr = typename ELFT::Ehdr;
+  using Elf_Shdr = typename ELFT::Shdr;
+  using Elf_Phdr = typename ELFT::Phdr;
+  using Elf_Sym = typename ELFT::Sym;
+  using Elf_Dyn = typename ELFT::Dyn;
+  using Elf_Versym = typename ELFT::Versym;
+  using Elf_Vernaux = typename ELFT::Vernaux;
+  using Verneed = typename ParsedELF<ELFT>::Verneed;
+
+  ParsedELF<ELFT> ToExtend(ToExtendBuffer);
+  ParsedELF<ELFT> Source(SourceBuffer);
+  revng_assert(Source.isDynamic());
+  revng_check(ToExtend.isDynamic(), "The ELF to extend is not dynamic");
+
+  const Elf_Ehdr &ToExtendHeader = ToExtend.TheELF.getHeader();
+  const Elf_Ehdr &SourceHeader = Source.TheELF.getHeader();
+  revng_check(ToExtendHeader.e_machine == SourceHeader.e_machine,
+              "The two ELFs have different architectures");
+
+  auto RelativeRelocation = relativeRelocation(ToExtendHeader.e_machine);
+  if (not RelativeRelocation) {
+    dbg << "Unsupported machine: " << ToExtendHeader.e_machine << "\n";
+    return false;
+  }
+
+  uint64_t RelocationOffset = 0;
+  if (SourceHeader.e_type == ELF::ET_DYN)
+    RelocationOffset = Base;
+
+  //
+  // Choose where to place the new segment
+  //
+  uint64_t ToExtendSize = ToExtend.Data.size();
+  uint64_t BaseAddress = std::numeric_limits<uint64_t>::max();
+  for (const Elf_Phdr &Segment : ToExtend.Segments)
+    if (Segment.p_type == ELF::PT_LOAD)
+      BaseAddress = std::min<uint64_t>(BaseAddress, Segment.p_vaddr);
+  revng_check(BaseAddress != std::numeric_limits<uint64_t>::max(),
+              "The ELF to extend has no PT_LOAD segment");
+
+  uint64_t EstimatedSize = llvm::alignTo(ToExtend.dynamicSize()
+                                           + Source.dynamicSize(),
+                                         PageSize);
+  uint64_t StartAddress = llvm::alignTo(BaseAddress + ToExtendSize, PageSize);
+  auto Overlapping = [&]() {
+    const Elf_Phdr *Result = ToExtend.segmentByRange(StartAddress,
+                                                     EstimatedSize);
+    if (Result == nullptr)
+      Result = Source.segmentByRange(StartAddress, EstimatedSize);
+    return Result;
+  };
+
+  while (const Elf_Phdr *Segment = Overlapping()) {
+    if (Verbose) {
+      dbg << "Discarding 0x" << std::hex << StartAddress
+          << " since it overlaps the segment at 0x" << Segment->p_vaddr
+          << std::dec << "\n";
+    }
+    StartAddress = llvm::alignTo(Segment->p_vaddr + Segment->p_memsz,
+                                 PageSize);
+  }
+
+  uint64_t Padding = StartAddress - BaseAddress - ToExtendSize;
+  uint64_t NewDynStrOffset = ToExtendSize + Padding;
+  auto ToAddress = [&](uint64_t Offset) {
+    return StartAddress + Offset - NewDynStrOffset;
+  };
+
+  //
+  // .dynstr
+  //
+  std::vector<uint8_t> NewDynStr(ToExtend.DynStr.begin(),
+                                 ToExtend.DynStr.end());
+  uint64_t ToExtendDynStrSize = NewDynStr.size();
+  revng_check(not NewDynStr.empty() and NewDynStr.back() == 0,
+              ".dynstr of the ELF to extend is not NULL terminated");
+  append(NewDynStr, Source.DynStr);
+
+  // TODO: many sections have alignment requirements. Aligning .dynstr aligns
+  //       all the following sections, since they are tables of entries of a
+  //       fixed size, but we should ensure each of them is aligned explicitly
+  NewDynStr.resize(llvm::alignTo(NewDynStr.size(), 4), 0);
+
+  //
+  // .dynsym
+  //
+  revng_check(not ToExtend.Symbols.empty(),
+              "The ELF to extend has no dynamic symbols");
+  uint32_t SymbolOffset = ToExtend.Symbols.size() - 1;
+  std::vector<uint32_t> DefinedSymbols;
+  for (uint32_t I = 0; I < ToExtend.Symbols.size(); ++I)
+    if (ToExtend.Symbols[I].st_shndx != ELF::SHN_UNDEF)
+      DefinedSymbols.push_back(I);
+
+  // Skip the null symbol of the source
+  ArrayRef<Elf_Sym> NewSymbols = Source.Symbols;
+  NewSymbols = NewSymbols.drop_front(std::min<size_t>(1, NewSymbols.size()));
+
+  std::vector<uint8_t> NewDynSym(ToExtend.DynSym.begin(),
+                                 ToExtend.DynSym.end());
+  NewDynSym.reserve(NewDynSym.size() + NewSymbols.size() * sizeof(Elf_Sym));
+  for (uint32_t I = 0; I < NewSymbols.size(); ++I) {
+    Elf_Sym Symbol = NewSymbols[I];
+    Symbol.st_name = Symbol.st_name + ToExtendDynStrSize;
+    if (Symbol.st_value != 0)
+      Symbol.st_value = Symbol.st_value + RelocationOffset;
+    if (Symbol.st_shndx != ELF::SHN_UNDEF)
+      DefinedSymbols.push_back(I + SymbolOffset + 1);
+    appendEntry(NewDynSym, Symbol);
+  }
+  uint64_t NewDynSymOffset = NewDynStrOffset + NewDynStr.size();
+
+  //
+  // .rel.dyn
+  //
+  std::vector<Relocation> NewRelocations = Source.RelPltRelocations;
+  llvm::append_range(NewRelocations, Source.RelDynRelocations);
+  for (Relocation &R : NewRelocations) {
+    if (R.Symbol != 0)
+      R.Symbol += SymbolOffset;
+    if (R.Type == *RelativeRelocation)
+      R.Addend += RelocationOffset;
+    R.Offset += RelocationOffset;
+  }
+
+  std::vector<uint8_t> NewRelDyn(ToExtend.RelDyn.begin(),
+                                 ToExtend.RelDyn.end());
+  append(NewRelDyn, Source.serializeRelocations(NewRelocations));
+  uint64_t NewRelDynOffset = NewDynSymOffset + NewDynSym.size();
+
+  //
+  // .gnu.version
+  //
+
+  // The version indices of the source, except for 0 (local) and 1 (global),
+  // follow the highest one of the ELF to extend
+  int64_t VersionIndexOffset = 0;
+  for (const Verneed &Entry : ToExtend.Verneeds)
+    for (const Elf_Vernaux &Auxiliary : Entry.Auxiliaries)
+      VersionIndexOffset = std::max<int64_t>(VersionIndexOffset,
+                                             Auxiliary.vna_other);
+  VersionIndexOffset -= 1;
+
+  std::vector<uint8_t> NewGNUVersion(ToExtend.GNUVersion.begin(),
+                                     ToExtend.GNUVersion.end());
+  for (size_t I = 1; I < Source.VersionIndices.size(); ++I) {
+    int64_t Index = Source.VersionIndices[I];
+    if (Index != 0 and Index != 1)
+      Index += VersionIndexOffset;
+
+    Elf_Versym Version;
+    Version.vs_index = Index;
+    appendEntry(NewGNUVersion, Version);
+  }
+  uint64_t NewGNUVersionOffset = NewRelDynOffset + NewRelDyn.size();
+
+  //
+  // .gnu.version_r
+  //
+  std::vector<Verneed> NewVerneeds = ToExtend.Verneeds;
+  if (not NewVerneeds.empty()) {
+    // Make the last entry point to the end of the existing ones
+    uint64_t LastPosition = 0;
+    for (const Verneed &Entry : NewVerneeds)
+      LastPosition += Entry.Header.vn_next;
+    uint64_t Size = ParsedELF<ELFT>::serializeVerneeds(NewVerneeds).size();
+    NewVerneeds.back().Header.vn_next = Size - LastPosition;
+  }
+
+  for (Verneed Entry : Source.Verneeds) {
+    Entry.Header.vn_file = Entry.Header.vn_file + ToExtendDynStrSize;
+    for (Elf_Vernaux &Auxiliary : Entry.Auxiliaries) {
+      Auxiliary.vna_name = Auxiliary.vna_name + ToExtendDynStrSize;
+      Auxiliary.vna_other = Auxiliary.vna_other + VersionIndexOffset;
+    }
+    NewVerneeds.push_back(Entry);
+  }
+
+  // Explicitly mark the last entry as such
+  if (not NewVerneeds.empty())
+    NewVerneeds.back().Header.vn_next = 0;
+
+  auto NewGNUVersionR = ParsedELF<ELFT>::serializeVerneeds(NewVerneeds);
+  uint64_t NewGNUVersionROffset = NewGNUVersionOffset + NewGNUVersion.size();
+
+  //
+  // .hash
+  //
+  uint32_t SymbolsCount = SymbolOffset + NewSymbols.size() + 1;
+  auto NewHash = buildDummyHashTable<ELFT>(SymbolsCount, DefinedSymbols);
+  uint64_t NewHashOffset = NewGNUVersionROffset + NewGNUVersionR.size();
+
+  //
+  // .dynamic
+  //
+  std::vector<Elf_Dyn> NewDynamicTags = ToExtend.DynamicTags;
+  for (Elf_Dyn &Entry : NewDynamicTags) {
+    switch (Entry.getTag()) {
+    case ELF::DT_STRTAB:
+      Entry.d_un.d_val = ToAddress(NewDynStrOffset);
+      break;
+    case ELF::DT_STRSZ:
+      Entry.d_un.d_val = NewDynStr.size();
+      break;
+    case ELF::DT_REL:
+    case ELF::DT_RELA:
+      Entry.d_un.d_val = ToAddress(NewRelDynOffset);
+      break;
+    case ELF::DT_RELSZ:
+    case ELF::DT_RELASZ:
+      Entry.d_un.d_val = NewRelDyn.size();
+      break;
+    case ELF::DT_SYMTAB:
+      Entry.d_un.d_val = ToAddress(NewDynSymOffset);
+      break;
+    case ELF::DT_VERNEED:
+      Entry.d_un.d_val = ToAddress(NewGNUVersionROffset);
+      break;
+    case ELF::DT_VERNEEDNUM:
+      Entry.d_un.d_val = NewVerneeds.size();
+      break;
+    case ELF::DT_VERSYM:
+      Entry.d_un.d_val = ToAddress(NewGNUVersionOffset);
+      break;
+    case ELF::DT_GNU_HASH:
+      Entry.d_tag = ELF::DT_HASH;
+      Entry.d_un.d_val = ToAddress(NewHashOffset);
+      break;
+    }
+  }
+
+  // DT_NEEDED entries of the source are added at link-time
+
+  std::vector<uint8_t> NewDynamic;
+  for (const Elf_Dyn &Entry : NewDynamicTags)
+    appendEntry(NewDynamic, Entry);
+  uint64_t NewDynamicOffset = NewHashOffset + NewHash.size();
+
+  //
+  // Section headers
+  //
+  uint64_t NewSectionHeadersOffset = NewDynamicOffset + NewDynamic.size();
+  std::vector<Elf_Shdr> NewSections(ToExtend.Sections.begin(),
+                                    ToExtend.Sections.end());
+  for (Elf_Shdr &Section : NewSections) {
+    auto Name = ToExtend.TheELF.getSectionName(Section);
+    if (not Name) {
+      consumeError(Name.takeError());
+      continue;
+    }
+
+    auto Relocate = [&](uint64_t Offset, uint64_t Size) {
+      Section.sh_addr = ToAddress(Offset);
+      Section.sh_offset = Offset;
+      Section.sh_size = Size;
+    };
+
+    if (*Name == ".dynstr") {
+      Relocate(NewDynStrOffset, NewDynStr.size());
+    } else if (*Name == ".dynsym") {
+      Relocate(NewDynSymOffset, NewDynSym.size());
+    } else if (*Name == ".rela.dyn" or *Name == ".rel.dyn") {
+      Relocate(NewRelDynOffset, NewRelDyn.size());
+    } else if (*Name == ".dynamic") {
+      Relocate(NewDynamicOffset, NewDynamic.size());
+    } else if (*Name == ".gnu.version") {
+      Relocate(NewGNUVersionOffset, NewGNUVersion.size());
+    } else if (*Name == ".gnu.version_r") {
+      Relocate(NewGNUVersionROffset, NewGNUVersionR.size());
+      Section.sh_info = NewVerneeds.size();
+    }
+  }
+
+  //
+  // Program headers
+  //
+  uint64_t NewProgramHeadersOffset = (NewSectionHeadersOffset
+                                      + NewSections.size() * sizeof(Elf_Shdr));
+  std::vector<Elf_Phdr> NewSegments(ToExtend.Segments.begin(),
+                                    ToExtend.Segments.end());
+
+  struct AdditionalSegment {
+    uint64_t Offset;
+    ArrayRef<uint8_t> Content;
+  };
+  std::vector<AdditionalSegment> AdditionalSegments;
+  auto IsLoad = [](const Elf_Phdr &Segment) {
+    return Segment.p_type == ELF::PT_LOAD;
+  };
+  // Make room for the new PT_LOAD and the merged ones
+  size_t SegmentsCount = NewSegments.size() + 1;
+  if (MergeLoadSegments)
+    SegmentsCount += llvm::count_if(Source.Segments, IsLoad);
+  uint64_t NewProgramHeadersSize = SegmentsCount * sizeof(Elf_Phdr);
+
+  if (MergeLoadSegments) {
+    // TODO: this assumes the new LOAD segments have 0x1000 alignment
+    uint64_t Offset = llvm::alignTo(NewProgramHeadersOffset
+                                      + NewProgramHeadersSize,
+                                    PageSize);
+    for (const Elf_Phdr &Segment : llvm::make_filter_range(Source.Segments,
+                                                            IsLoad)) {
+      Elf_Phdr New = Segment;
+      uint64_t Size = Segment.p_filesz;
+      uint64_t Alignment = Segment.p_align;
+      uint64_t RequiredPadding = 0;
+      if (Alignment != 0)
+        RequiredPadding = Segment.p_offset % Alignment;
+
+      New.p_offset = Offset + RequiredPadding;
+      AdditionalSegments.push_back({ New.p_offset,
+                                     Source.read(Segment.p_vaddr, Size) });
+      NewSegments.push_back(New);
+
+      Offset = llvm::alignTo(Offset + RequiredPadding + Size, PageSize);
+    }
+  }
+
+  for (Elf_Phdr &Segment : NewSegments) {
+    auto Relocate = [&](uint64_t Offset, uint64_t Size) {
+      Segment.p_filesz = Size;
+      Segment.p_memsz = Size;
+      Segment.p_paddr = ToAddress(Offset);
+      Segment.p_vaddr = ToAddress(Offset);
+      Segment.p_offset = Offset;
+    };
+
+    if (Segment.p_type == ELF::PT_DYNAMIC)
+      Relocate(NewDynamicOffset, NewDynamic.size());
+    else if (Segment.p_type == ELF::PT_PHDR)
+      Relocate(NewProgramHeadersOffset, NewProgramHeadersSize);
+  }
+
+  uint64_t NewSegmentSize = (NewProgramHeadersOffset + NewProgramHeadersSize
+                             - NewDynStrOffset);
+  if (Verbose and NewSegmentSize > EstimatedSize) {
+    dbg << "Warning: the new segment for dynamic sections is larger than "
+        << "expected:\n"
+        << "  Expected: " << EstimatedSize << "\n"
+        << "  Actual: " << NewSegmentSize << "\n";
+  }
+
+  Elf_Phdr NewSegment;
+  std::memset(&NewSegment, 0, sizeof(NewSegment));
+  NewSegment.p_type = ELF::PT_LOAD;
+  NewSegment.p_offset = NewDynStrOffset;
+  NewSegment.p_flags = ELF::PF_R | ELF::PF_W;
+  NewSegment.p_vaddr = StartAddress;
+  NewSegment.p_paddr = StartAddress;
+  NewSegment.p_memsz = NewSegmentSize;
+  NewSegment.p_filesz = NewSegmentSize;
+  NewSegment.p_align = PageSize;
+  NewSegments.push_back(NewSegment);
+
+  // Sort the PT_LOAD entries in ascending order
+  std::stable_sort(NewSegments.begin(),
+                   NewSegments.end(),
+                   [](const Elf_Phdr &LHS, const Elf_Phdr &RHS) {
+                     return segmentsSortKey(LHS) < segmentsSortKey(RHS);
+                   });
+
+  // TODO: prepare a new PT_PHDR mapping the new PT_DYNAMIC
+
+  //
+  // ELF header
+  //
+  Elf_Ehdr NewHeader = ToExtendHeader;
+  NewHeader.e_phnum = NewSegments.size();
+  NewHeader.e_phoff = NewProgramHeadersOffset;
+  NewHeader.e_shnum = NewSections.size();
+  NewHeader.e_shoff = NewSectionHeadersOffset;
+
+  //
+  // Write the output
+  //
+  auto Write = [&Output](uint64_t ExpectedOffset, const auto &Buffer) {
+    revng_assert(Output.tell() == ExpectedOffset);
+    Output.write(reinterpret_cast<const char *>(Buffer.data()),
+                 Buffer.size() * sizeof(Buffer[0]));
+  };
+
+  Output.write(reinterpret_cast<const char *>(&NewHeader), sizeof(NewHeader));
+  Output << ToExtendBuffer.drop_front(sizeof(NewHeader));
+
+  // Align to page
+  Output.write_zeros(Padding);
+
+  Write(NewDynStrOffset, NewDynStr);
+  Write(NewDynSymOffset, NewDynSym);
+  Write(NewRelDynOffset, NewRelDyn);
+  Write(NewGNUVersionOffset, NewGNUVersion);
+  Write(NewGNUVersionROffset, NewGNUVersionR);
+  Write(NewHashOffset, NewHash);
+  Write(NewDynamicOffset, NewDynamic);
+  Write(NewSectionHeadersOffset, NewSections);
+  Write(NewProgramHeadersOffset, NewSegments);
+
+  for (const AdditionalSegment &Segment : AdditionalSegments) {
+    revng_assert(Segment.Offset >= Output.tell());
+    Output.write_zeros(Segment.Offset - Output.tell());
+    Write(Segment.Offset, Segment.Content);
+  }
+
+  return true;
+}
+
+template<typename ELFT>
+static bool isDynamic(StringRef Buffer) {
+  object::ELFFile<ELFT> TheELF = unwrap(object::ELFFile<ELFT>::create(Buffer));
+  for (const auto &Segment : unwrap(TheELF.program_headers()))
+    if (Segment.p_type == ELF::PT_DYNAMIC)
+      return true;
+  return false;
+}
+
+/// \brief Invoke \p Function with an instance of the ELFType of \p Buffer
+template<typename F>
+static auto withELFType(StringRef Buffer, F &&Function) {
+  revng_check(Buffer.startswith(ELF::ElfMagic), "Not an ELF");
+  auto [Class, Encoding] = object::getElfArchType(Buffer);
+  revng_check(Class == ELF::ELFCLASS32 or Class == ELF::ELFCLASS64,
+              "Unknown ELF class");
+  revng_check(Encoding == ELF::ELFDATA2LSB or Encoding == ELF::ELFDATA2MSB,
+              "Unknown ELF data encoding");
+
+  bool Is64 = Class == ELF::ELFCLASS64;
+  bool IsLittleEndian = Encoding == ELF::ELFDATA2LSB;
+  if (Is64 and IsLittleEndian)
+    return Function(object::ELF64LE());
+  else if (Is64)
+    return Function(object::ELF64BE());
+  else if (IsLittleEndian)
+    return Function(object::ELF32LE());
+  else
+    return Function(object::ELF32BE());
+}
+
+static std::unique_ptr<llvm::MemoryBuffer> readFile(StringRef Path) {
+  auto Result = llvm::MemoryBuffer::getFile(Path);
+  if (not Result) {
+    dbg << "Couldn't open " << Path.str() << ": "
+        << Result.getError().message() << "\n";
+    return nullptr;
+  }
+  return std::move(*Result);
+}
+
+int main(int argc, const char *argv[]) {
+  // Enable LLVM stack trace
+  llvm::sys::PrintStackTraceOnErrorSignal(argv[0]);
+
+  HideUnrelatedOptions({ &MainCategory });
+  ParseCommandLineOptions(argc,
+                          argv,
+                          "Merge the dynamic portions of the translated ELF "
+                          "with the one of the original ELF.\n");
+
+  uint64_t BaseAddress = 0;
+  if (StringRef(Base).getAsInteger(0, BaseAddress)) {
+    dbg << "Invalid base address: " << Base << "\n";
+    return EXIT_FAILURE;
+  }
+
+  auto ToExtend = readFile(ToExtendPath);
+  auto Source = readFile(SourcePath);
+  if (not ToExtend or not Source)
+    return EXIT_FAILURE;
+
+  std::error_code EC;
+  llvm::ToolOutputFile Output(OutputPath, EC, llvm::sys::fs::OF_None);
+  if (EC) {
+    dbg << "Couldn't open " << OutputPath << ": " << EC.message() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  StringRef ToExtendBuffer = ToExtend->getBuffer();
+  StringRef SourceBuffer = Source->getBuffer();
+  bool SourceIsDynamic = withELFType(SourceBuffer, [&](auto Type) {
+    return isDynamic<decltype(Type)>(SourceBuffer);
+  });
+
+  if (not SourceIsDynamic) {
+    // If the original ELF is not dynamic, there's nothing to merge
+    Output.os() << ToExtendBuffer;
+  } else {
+    revng_check(object::getElfArchType(ToExtendBuffer)
+                  == object::getElfArchType(SourceBuffer),
+                "The two ELFs have different class or data encoding");
+    bool Success = withELFType(ToExtendBuffer, [&](auto Type) {
+      return merge<decltype(Type)>(ToExtendBuffer,
+                                   SourceBuffer,
+                                   BaseAddress,
+                                   Output.os());
+    });
+    if (not Success)
+      return EXIT_FAILURE;
+  }
+
+  Output.keep();
+
+  if (OutputPath != "-") {
+    using namespace llvm::sys::fs;
+    auto Permissions = getPermissions(OutputPath);
+    if (not Permissions
+        or setPermissions(OutputPath, *Permissions | all_exe)) {
+      dbg << "Couldn't make " << OutputPath << " executable\n";
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
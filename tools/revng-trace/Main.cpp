@@ -0,0 +1,492 @@
+/// \file Main.cpp
+/// \brief This file implements revng-trace, which turns the execution traces
+///        produced by the trace support module into coverage and profiles
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/ToolOutputFile.h"
+
+#include "revng/Support/Assert.h"
+#include "revng/Support/BinaryCoverage.h"
+#include "revng/Support/CommandLine.h"
+#include "revng/Support/Debug.h"
+
+using namespace llvm::cl;
+
+using llvm::ArrayRef;
+using llvm::StringRef;
+
+static opt<std::string> TracePath(Positional,
+                                  Required,
+                                  desc("the trace, either in raw or compact "
+                                       "format"),
+                                  value_desc("TRACE"),
+                                  cat(MainCategory));
+
+static opt<std::string> LiftedCoveragePath("lifted-coverage",
+                                           desc("the translated instructions "
+                                                "in the binary coverage "
+                                                "format, as produced by "
+                                                "revng-lift "
+                                                "-binary-coverage-path"),
+                                           value_desc("path"),
+                                           cat(MainCategory));
+
+static opt<std::string> CoveragePath("coverage",
+                                     desc("destination path for the executed "
+                                          "instructions in the binary "
+                                          "coverage format. Requires "
+                                          "-lifted-coverage."),
+                                     value_desc("path"),
+                                     cat(MainCategory));
+
+static opt<std::string> ProfilePath("profile",
+                                    desc("destination path for the execution "
+                                         "counts of the jump targets, in the "
+                                         "format consumed by revng-lift "
+                                         "-profile"),
+                                    value_desc("path"),
+                                    cat(MainCategory));
+
+static opt<std::string> EdgesPath("edges",
+                                  desc("destination path for the execution "
+                                       "counts of the control flow transfers, "
+                                       "one source,destination,count line "
+                                       "each. Requires a trace in the blocks "
+                                       "format or -lifted-coverage."),
+                                  value_desc("path"),
+                                  cat(MainCategory));
+
+static opt<unsigned> Jobs("jobs",
+                          desc("number of threads processing the trace, 0 for "
+                               "one per core"),
+                          value_desc("threads"),
+                          cat(MainCategory),
+                          init(0));
+
+/// "RVNGTRC" followed by a NUL character
+static const char TraceMagic[8] = "RVNGTRC";
+static const uint32_t TraceVersion = 1;
+static const uint32_t TraceFlagBlocks = 1;
+static const size_t TraceHeaderSize = 16;
+
+/// Minimum size of a chunk, smaller traces are not worth splitting
+static const size_t MinimumChunkSize = 1024 * 1024;
+
+namespace {
+
+/// \brief A trace, as described by the trace support module
+struct Trace {
+  /// Program counters are zigzag and LEB128 encoded differences from the
+  /// previous one, rather than 64-bit little endian integers
+  bool Compact = false;
+
+  /// Only the first instruction after a change in the control flow is recorded
+  bool Blocks = false;
+
+  /// The records, without the header
+  ArrayRef<uint8_t> Data;
+};
+
+using Edge = std::pair<uint64_t, uint64_t>;
+
+struct EdgeHash {
+  size_t operator()(const Edge &E) const {
+    return llvm::hash_combine(E.first, E.second);
+  }
+};
+
+using CountsMap = std::unordered_map<uint64_t, uint64_t>;
+using EdgesMap = std::unordered_map<Edge, uint64_t, EdgeHash>;
+
+/// \brief What's been found in a portion of the trace
+struct ChunkResult {
+  /// The trace ends in the middle of a record
+  bool Truncated = false;
+
+  /// First and last program counter of the chunk, if any
+  llvm::Optional<uint64_t> First;
+  uint64_t Last = 0;
+
+  /// Execution count of each program counter
+  CountsMap Counts;
+
+  /// Execution count of each control flow transfer within the chunk
+  EdgesMap Edges;
+};
+
+} // namespace
+
+/// \brief Parse the header of \p Buffer, if any
+static llvm::Optional<Trace> parseTrace(const llvm::MemoryBuffer &Buffer) {
+  auto *Start = reinterpret_cast<const uint8_t *>(Buffer.getBufferStart());
+  ArrayRef<uint8_t> Data(Start, Buffer.getBufferSize());
+
+  // Raw traces have no header
+  Trace Result;
+  if (Data.size() < sizeof(TraceMagic)
+      or memcmp(Data.data(), TraceMagic, sizeof(TraceMagic)) != 0) {
+    Result.Data = Data;
+    return Result;
+  }
+
+  if (Data.size() < TraceHeaderSize) {
+    dbg << "Couldn't read the trace header\n";
+    return llvm::None;
+  }
+
+  using namespace llvm::support;
+  uint32_t Version = endian::read32le(Data.data() + sizeof(TraceMagic));
+  uint32_t Flags = endian::read32le(Data.data() + sizeof(TraceMagic) + 4);
+  if (Version != TraceVersion) {
+    dbg << "Unsupported trace version " << Version << "\n";
+    return llvm::None;
+  }
+
+  Result.Compact = true;
+  Result.Blocks = (Flags & TraceFlagBlocks) != 0;
+  Result.Data = Data.drop_front(TraceHeaderSize);
+  return Result;
+}
+
+/// \brief Split \p TheTrace in at most \p Count chunks, each one starting at
+///        the beginning of a record
+static std::vector<ArrayRef<uint8_t>> split(const Trace &TheTrace,
+                                            unsigned Count) {
+  ArrayRef<uint8_t> Data = TheTrace.Data;
+  size_t ChunkSize = std::max((Data.size() + Count - 1) / Count,
+                              MinimumChunkSize);
+
+  std::vector<ArrayRef<uint8_t>> Result;
+  while (not Data.empty()) {
+    size_t Size = std::min(ChunkSize, Data.size());
+    if (TheTrace.Compact) {
+      // Move forward to the end of the record
+      while (Size < Data.size() and (Data[Size - 1] & 0x80) != 0)
+        ++Size;
+    } else {
+      Size = std::max<size_t>(Size - Size % sizeof(uint64_t),
+                              std::min(Data.size(), sizeof(uint64_t)));
+    }
+
+    Result.push_back(Data.take_front(Size));
+    Data = Data.drop_front(Size);
+  }
+
+  return Result;
+}
+
+/// \brief Call \p Visit on each program counter recorded in \p Chunk
+///
+/// In compact traces, the first program counter is relative to \p Base.
+///
+/// \return true if \p Chunk ends in the middle of a record.
+template<typename T>
+static bool
+decode(ArrayRef<uint8_t> Chunk, bool Compact, uint64_t Base, T &&Visit) {
+  if (not Compact) {
+    using namespace llvm::support;
+    size_t Records = Chunk.size() / sizeof(uint64_t);
+    for (size_t I = 0; I < Records; ++I)
+      Visit(endian::read64le(Chunk.data() + I * sizeof(uint64_t)));
+    return Chunk.size() % sizeof(uint64_t) != 0;
+  }
+
+  uint64_t PC = Base;
+  uint64_t Value = 0;
+  unsigned Shift = 0;
+  for (uint8_t Byte : Chunk) {
+    if (Shift < 64)
+      Value |= static_cast<uint64_t>(Byte & 0x7f) << Shift;
+
+    if ((Byte & 0x80) != 0) {
+      Shift += 7;
+      continue;
+    }
+
+    // Undo the zigzag encoding and apply the delta
+    PC += (Value >> 1) ^ -(Value & 1);
+    Visit(PC);
+    Value = 0;
+    Shift = 0;
+  }
+
+  return Shift != 0;
+}
+
+/// \brief Run \p Body on each element of \p Items, on \p ThreadsCount threads
+template<typename T, typename F>
+static void parallelForEach(std::vector<T> &Items,
+                            unsigned ThreadsCount,
+                            F &&Body) {
+  std::atomic<size_t> Next(0);
+  auto Worker = [&Items, &Next, &Body]() {
+    for (size_t I = Next++; I < Items.size(); I = Next++)
+      Body(I, Items[I]);
+  };
+
+  ThreadsCount = std::min<size_t>(ThreadsCount, Items.size());
+  std::vector<std::thread> Pool;
+  for (unsigned I = 0; I < ThreadsCount; I++)
+    Pool.emplace_back(Worker);
+
+  for (std::thread &Thread : Pool)
+    Thread.join();
+}
+
+/// \brief Write \p Lines, sorted, to \p Path
+template<typename T, typename F>
+static bool writeSorted(StringRef Path, std::vector<T> &Lines, F &&Print) {
+  llvm::sort(Lines);
+
+  std::error_code EC;
+  llvm::ToolOutputFile Output(Path, EC, llvm::sys::fs::OF_Text);
+  if (EC) {
+    dbg << "Couldn't open " << Path.str() << ": " << EC.message() << "\n";
+    return false;
+  }
+
+  for (const T &Line : Lines)
+    Print(Output.os(), Line);
+
+  Output.keep();
+  return true;
+}
+
+static void writeHex(llvm::raw_ostream &Output, uint64_t Value) {
+  Output << "0x";
+  Output.write_hex(Value);
+}
+
+int main(int argc, const char *argv[]) {
+  // Enable LLVM stack trace
+  llvm::sys::PrintStackTraceOnErrorSignal(argv[0]);
+
+  HideUnrelatedOptions({ &MainCategory });
+  ParseCommandLineOptions(argc,
+                          argv,
+                          "Compute coverage and profiles from an execution "
+                          "trace produced by a program translated with the "
+                          "trace support module.\n");
+
+  bool NeedsCounts = CoveragePath.getNumOccurrences() != 0
+                     or ProfilePath.getNumOccurrences() != 0;
+  bool NeedsEdges = EdgesPath.getNumOccurrences() != 0;
+  bool HasLiftedCoverage = LiftedCoveragePath.getNumOccurrences() != 0;
+
+  if (CoveragePath.getNumOccurrences() != 0 and not HasLiftedCoverage) {
+    dbg << "-coverage requires -lifted-coverage\n";
+    return EXIT_FAILURE;
+  }
+
+  // The trace can be several GB: map it, rather than reading it
+  auto MaybeBuffer = llvm::MemoryBuffer::getFile(TracePath, -1, false);
+  if (not MaybeBuffer) {
+    dbg << "Couldn't open " << TracePath << ": "
+        << MaybeBuffer.getError().message() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  llvm::Optional<Trace> MaybeTrace = parseTrace(**MaybeBuffer);
+  if (not MaybeTrace)
+    return EXIT_FAILURE;
+  const Trace &TheTrace = *MaybeTrace;
+
+  if (NeedsEdges and not TheTrace.Blocks and not HasLiftedCoverage) {
+    dbg << "-edges requires a trace in the blocks format or "
+           "-lifted-coverage\n";
+    return EXIT_FAILURE;
+  }
+
+  // Index the translated instructions by address
+  llvm::Optional<BinaryCoverage::Reader> Lifted;
+  std::unordered_map<uint64_t, size_t> LiftedIndex;
+  if (HasLiftedCoverage) {
+    auto MaybeReader = BinaryCoverage::Reader::open(LiftedCoveragePath);
+    if (not MaybeReader) {
+      dbg << "Couldn't open " << LiftedCoveragePath << ": "
+          << MaybeReader.getError().message() << "\n";
+      return EXIT_FAILURE;
+    }
+
+    Lifted = std::move(*MaybeReader);
+    LiftedIndex.reserve(Lifted->size());
+    for (size_t I = 0; I < Lifted->size(); ++I)
+      LiftedIndex.emplace((*Lifted)[I].Address.address(), I);
+  }
+
+  // Without the blocks format, the size of the instructions tells if the
+  // control flow changed
+  std::unordered_map<uint64_t, uint64_t> Sizes;
+  if (NeedsEdges and not TheTrace.Blocks) {
+    Sizes.reserve(LiftedIndex.size());
+    for (const auto &[Address, Index] : LiftedIndex)
+      Sizes.emplace(Address, (*Lifted)[Index].Size);
+  }
+
+  // Is going from From to To a change in the control flow?
+  auto IsTransfer = [&TheTrace, &Sizes](uint64_t From, uint64_t To) {
+    if (TheTrace.Blocks)
+      return true;
+
+    auto It = Sizes.find(From);
+    return It == Sizes.end() or From + It->second != To;
+  };
+
+  unsigned ThreadsCount = Jobs;
+  if (ThreadsCount == 0)
+    ThreadsCount = std::max(std::thread::hardware_concurrency(), 1U);
+
+  std::vector<ArrayRef<uint8_t>> Chunks = split(TheTrace, ThreadsCount);
+
+  // In compact traces, each program counter is relative to the previous one:
+  // compute where each chunk starts from, first
+  std::vector<uint64_t> Bases(Chunks.size(), 0);
+  if (TheTrace.Compact) {
+    std::vector<uint64_t> Deltas(Chunks.size(), 0);
+    parallelForEach(Chunks, ThreadsCount, [&Deltas](size_t I, auto &Chunk) {
+      decode(Chunk, true, 0, [&Deltas, I](uint64_t PC) { Deltas[I] = PC; });
+    });
+
+    for (size_t I = 1; I < Chunks.size(); ++I)
+      Bases[I] = Bases[I - 1] + Deltas[I - 1];
+  }
+
+  // Process each chunk on its own
+  std::vector<ChunkResult> Results(Chunks.size());
+  parallelForEach(Chunks, ThreadsCount, [&](size_t I, auto &Chunk) {
+    ChunkResult &Result = Results[I];
+    auto Visit = [&](uint64_t PC) {
+      if (NeedsCounts)
+        ++Result.Counts[PC];
+
+      if (not Result.First)
+        Result.First = PC;
+      else if (NeedsEdges and IsTransfer(Result.Last, PC))
+        ++Result.Edges[{ Result.Last, PC }];
+
+      Result.Last = PC;
+    };
+    Result.Truncated = decode(Chunk, TheTrace.Compact, Bases[I], Visit);
+  });
+
+  // Merge the results, including the edges across chunks
+  CountsMap Counts;
+  EdgesMap Edges;
+  llvm::Optional<uint64_t> Previous;
+  for (ChunkResult &Result : Results) {
+    if (Result.First) {
+      if (NeedsEdges and Previous and IsTransfer(*Previous, *Result.First))
+        ++Edges[{ *Previous, *Result.First }];
+      Previous = Result.Last;
+    }
+
+    for (const auto &[PC, Count] : Result.Counts)
+      Counts[PC] += Count;
+
+    for (const auto &[TheEdge, Count] : Result.Edges)
+      Edges[TheEdge] += Count;
+
+    // Release the memory as soon as possible
+    Result = ChunkResult();
+  }
+
+  if (not Results.empty() and Results.back().Truncated)
+    dbg << "Warning: the trace is truncated\n";
+
+  if (TheTrace.Blocks and NeedsCounts)
+    dbg << "Note: only the first instruction of each block is recorded\n";
+
+  if (CoveragePath.getNumOccurrences() != 0) {
+    BinaryCoverage::Writer Writer;
+    unsigned Unknown = 0;
+    for (const auto &[PC, Count] : Counts) {
+      auto It = LiftedIndex.find(PC);
+      if (It == LiftedIndex.end()) {
+        ++Unknown;
+        continue;
+      }
+
+      BinaryCoverage::Instruction Instruction = (*Lifted)[It->second];
+      Writer.addInstruction(Instruction.Address,
+                            Instruction.Size,
+                            Instruction.IsJumpTarget);
+    }
+
+    for (size_t I = 0; I < Lifted->bitmapsCount(); ++I) {
+      auto [Start, Size] = Lifted->bitmapRange(I);
+      Writer.addSegment(Start, Size);
+    }
+
+    if (Unknown != 0)
+      dbg << "Warning: " << Unknown << " executed addresses have not been "
+          << "translated\n";
+
+    std::error_code EC = Writer.write(CoveragePath);
+    if (EC) {
+      dbg << "Couldn't write " << CoveragePath << ": " << EC.message() << "\n";
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (ProfilePath.getNumOccurrences() != 0) {
+    // If we know which instructions are jump targets, emit only those
+    std::vector<std::pair<uint64_t, uint64_t>> Lines;
+    for (const auto &[PC, Count] : Counts) {
+      if (Lifted) {
+        auto It = LiftedIndex.find(PC);
+        if (It == LiftedIndex.end())
+          continue;
+
+        BinaryCoverage::Instruction Instruction = (*Lifted)[It->second];
+        if (not Instruction.IsJumpTarget)
+          continue;
+      }
+
+      Lines.emplace_back(PC, Count);
+    }
+
+    auto Print = [](llvm::raw_ostream &Output, const auto &Line) {
+      writeHex(Output, Line.first);
+      Output << "," << Line.second << "\n";
+    };
+    if (not writeSorted(ProfilePath, Lines, Print))
+      return EXIT_FAILURE;
+  }
+
+  if (NeedsEdges) {
+    std::vector<std::pair<Edge, uint64_t>> Lines(Edges.begin(), Edges.end());
+    auto Print = [](llvm::raw_ostream &Output, const auto &Line) {
+      writeHex(Output, Line.first.first);
+      Output << ",";
+      writeHex(Output, Line.first.second);
+      Output << "," << Line.second << "\n";
+    };
+    if (not writeSorted(EdgesPath, Lines, Print))
+      return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,510 @@
+/// \file Main.cpp
+/// \brief This file implements revng-translate, which turns a lifted module
+///        into an object file without leaving the process: function isolation,
+///        linking with the support module, optimization and code generation
+///        all work on the same in-memory module
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/CodeGen/ParallelCG.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/TargetRegistry.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/ToolOutputFile.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetOptions.h"
+
+#include "revng/FunctionIsolation/FormSuperblocks.h"
+#include "revng/FunctionIsolation/InvokeIsolatedFunctions.h"
+#include "revng/FunctionIsolation/IsolateFunctions.h"
+#include "revng/FunctionIsolation/MergeIdenticalFunctions.h"
+#include "revng/FunctionIsolation/OutlineRegions.h"
+#include "revng/FunctionIsolation/PromoteRootCSVs.h"
+#include "revng/FunctionIsolation/RemoveDeadFlags.h"
+#include "revng/FunctionIsolation/ShardModule.h"
+#include "revng/Model/SerializeModelPass.h"
+#include "revng/StackAnalysis/ABIDetectionPass.h"
+#include "revng/Support/CommandLine.h"
+#include "revng/Support/Debug.h"
+#include "revng/Support/Statistics.h"
+#include "revng/Support/TracedPassManager.h"
+
+using namespace llvm::cl;
+
+using llvm::Module;
+using llvm::StringRef;
+
+namespace {
+
+#define DESCRIPTION desc("the lifted module, as produced by revng-lift")
+opt<std::string> InputPath(Positional,
+                           Required,
+                           DESCRIPTION,
+                           cat(MainCategory));
+#undef DESCRIPTION
+
+#define DESCRIPTION desc("the support module to link with the lifted module")
+opt<std::string> SupportPath(Positional,
+                             Required,
+                             DESCRIPTION,
+                             cat(MainCategory));
+#undef DESCRIPTION
+
+opt<std::string> OutputPath("o",
+                            desc("destination of the object file"),
+                            value_desc("path"),
+                            Required,
+                            cat(MainCategory));
+
+#define DESCRIPTION desc("0: no optimization, 1: optimize during code "        \
+                         "generation only, 2: also run the -O2 pipeline")
+opt<unsigned> OptimizationLevel("O",
+                                DESCRIPTION,
+                                Prefix,
+                                value_desc("level"),
+                                cat(MainCategory),
+                                init(0));
+#undef DESCRIPTION
+
+#define DESCRIPTION desc("detect the ABI and isolate functions before linking")
+opt<bool> Isolate("isolate", DESCRIPTION, cat(MainCategory), init(false));
+#undef DESCRIPTION
+
+#define DESCRIPTION desc("after isolating functions, remove the stores to "    \
+                         "the x86 flags that are never read")
+opt<bool> RemoveDeadFlags("remove-dead-flags",
+                          DESCRIPTION,
+                          cat(MainCategory),
+                          init(false));
+#undef DESCRIPTION
+
+#define DESCRIPTION desc("after isolating functions, keep a single copy of "   \
+                         "the functions with identical code")
+opt<bool> MergeFunctions("merge-functions",
+                         DESCRIPTION,
+                         cat(MainCategory),
+                         init(false));
+#undef DESCRIPTION
+
+#define DESCRIPTION desc("without -isolate, move the translated code of root " \
+                         "into functions of bounded size, so that code "       \
+                         "generation scales and can be split in partitions")
+opt<bool> OutlineRegions("outline-regions",
+                         DESCRIPTION,
+                         cat(MainCategory),
+                         init(false));
+#undef DESCRIPTION
+
+#define DESCRIPTION desc("copy the hot join points of the translated code "    \
+                         "in their hot predecessor, according to the branch "  \
+                         "weights of revng-lift -profile")
+opt<bool> Superblocks("superblocks",
+                      DESCRIPTION,
+                      cat(MainCategory),
+                      init(false));
+#undef DESCRIPTION
+
+#define DESCRIPTION desc("without -isolate, keep the CSVs of root in SSA "     \
+                         "registers within single-entry regions")
+opt<bool> PromoteRootCSVs("promote-root-csvs",
+                          DESCRIPTION,
+                          cat(MainCategory),
+                          init(false));
+#undef DESCRIPTION
+
+#define DESCRIPTION desc("dump the module after function isolation")
+opt<std::string> DumpIsolatedPath("dump-isolated",
+                                  DESCRIPTION,
+                                  value_desc("path"),
+                                  cat(MainCategory));
+#undef DESCRIPTION
+
+#define DESCRIPTION desc("dump the module after linking with the support")
+opt<std::string> DumpLinkedPath("dump-linked",
+                                DESCRIPTION,
+                                value_desc("path"),
+                                cat(MainCategory));
+#undef DESCRIPTION
+
+#define DESCRIPTION desc("dump the module after the -O2 pipeline")
+opt<std::string> DumpOptimizedPath("dump-optimized",
+                                   DESCRIPTION,
+                                   value_desc("path"),
+                                   cat(MainCategory));
+#undef DESCRIPTION
+
+#define DESCRIPTION desc("split the module in this many partitions and "       \
+                         "generate code for them in parallel. Partition i "    \
+                         "is emitted in the output path with the extension "   \
+                         "replaced by i.o")
+opt<unsigned> CodeGenPartitions("codegen-partitions",
+                                DESCRIPTION,
+                                value_desc("count"),
+                                cat(MainCategory),
+                                init(1));
+#undef DESCRIPTION
+
+#define DESCRIPTION desc("split the module in this many shards, grouping "     \
+                         "functions calling each other, then optimize and "    \
+                         "generate code for them in parallel. Shards are "     \
+                         "emitted as partitions of -codegen-partitions")
+opt<unsigned> Shards("shards",
+                     DESCRIPTION,
+                     value_desc("count"),
+                     cat(MainCategory),
+                     init(1));
+#undef DESCRIPTION
+
+} // namespace
+
+template<typename T>
+static opt<T> *
+getOption(llvm::StringMap<Option *> &Options, const char *Name) {
+  return static_cast<opt<T> *>(Options[Name]);
+}
+
+static std::unique_ptr<Module>
+parseModule(StringRef Path, llvm::LLVMContext &Context) {
+  llvm::SMDiagnostic Errors;
+  std::unique_ptr<Module> Result = llvm::parseIRFile(Path, Errors, Context);
+  if (Result.get() == nullptr)
+    Errors.print("revng-translate", llvm::dbgs());
+  return Result;
+}
+
+/// Write \p M to \p Path, as textual IR if the extension is .ll, as bitcode
+/// otherwise. Does nothing if \p Path is empty.
+static bool dumpModule(const Module &M, StringRef Path) {
+  if (Path.empty())
+    return true;
+
+  std::error_code EC;
+  llvm::ToolOutputFile Output(Path, EC, llvm::sys::fs::OF_None);
+  if (EC) {
+    dbg << "Couldn't open " << Path.str() << ": " << EC.message() << "\n";
+    return false;
+  }
+
+  if (llvm::sys::path::extension(Path) == ".ll")
+    M.print(Output.os(), nullptr);
+  else
+    llvm::WriteBitcodeToFile(M, Output.os());
+  Output.keep();
+
+  return true;
+}
+
+static void isolate(Module &M) {
+  TracedPassManager PM;
+  PM.add(new StackAnalysis::ABIDetectionPass());
+  PM.add(new IsolateFunctions());
+  PM.add(new InvokeIsolatedFunctionsPass());
+  if (RemoveDeadFlags)
+    PM.add(new RemoveDeadFlagsPass());
+  if (MergeFunctions) {
+    PM.add(new MergeIdenticalFunctionsPass());
+    PM.add(new SerializeModelWrapperPass());
+  }
+  if (Superblocks)
+    PM.add(new FormSuperblocksPass());
+  PM.run(M);
+}
+
+/// Transformations of root, for the non-isolated translation
+static void transformRoot(Module &M) {
+  TracedPassManager PM;
+  if (Superblocks)
+    PM.add(new FormSuperblocksPass());
+  if (PromoteRootCSVs)
+    PM.add(new PromoteRootCSVsPass());
+  if (OutlineRegions)
+    PM.add(new OutlineRegionsPass());
+  PM.run(M);
+}
+
+static void optimize(Module &M, llvm::TargetMachine *TM) {
+  using namespace llvm;
+
+  PassBuilder PB(TM);
+  LoopAnalysisManager LAM;
+  FunctionAnalysisManager FAM;
+  CGSCCAnalysisManager CGAM;
+  ModuleAnalysisManager MAM;
+
+  FAM.registerPass([&] { return PB.buildDefaultAAPipeline(); });
+  PB.registerModuleAnalyses(MAM);
+  PB.registerCGSCCAnalyses(CGAM);
+  PB.registerFunctionAnalyses(FAM);
+  PB.registerLoopAnalyses(LAM);
+  PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+  auto Level = PassBuilder::OptimizationLevel::O2;
+  ModulePassManager MPM = PB.buildPerModuleDefaultPipeline(Level);
+  MPM.run(M, MAM);
+}
+
+static bool emitObject(Module &M, llvm::TargetMachine &TM, StringRef Path) {
+  using namespace llvm;
+
+  std::error_code EC;
+  ToolOutputFile Output(Path, EC, sys::fs::OF_None);
+  if (EC) {
+    dbg << "Couldn't open " << Path.str() << ": " << EC.message() << "\n";
+    return false;
+  }
+
+  legacy::PassManager PM;
+  TargetLibraryInfoImpl TLII(Triple(M.getTargetTriple()));
+  PM.add(new TargetLibraryInfoWrapperPass(TLII));
+  auto FileType = CGFT_ObjectFile;
+  if (TM.addPassesToEmitFile(PM, Output.os(), nullptr, FileType)) {
+    dbg << "The target doesn't support emitting object files\n";
+    return false;
+  }
+
+  PM.run(M);
+  Output.keep();
+
+  return true;
+}
+
+/// Path of the object file for partition \p Index: foo.o becomes foo.Index.o
+static std::string partitionPath(StringRef Path, unsigned Index) {
+  llvm::SmallString<128> Result(Path);
+  llvm::sys::path::replace_extension(Result, llvm::Twine(Index) + ".o");
+  return std::string(Result.str());
+}
+
+using TargetMachinePointer = std::unique_ptr<llvm::TargetMachine>;
+using TargetMachineFactory = std::function<TargetMachinePointer()>;
+
+/// Split \p M in \p Partitions modules and emit them in parallel
+///
+/// All the local symbols referenced across partitions are promoted to external
+/// linkage, so that the resulting objects can be linked together.
+static bool emitObjects(std::unique_ptr<Module> M,
+                        const TargetMachineFactory &CreateTargetMachine,
+                        StringRef Path,
+                        unsigned Partitions) {
+  using namespace llvm;
+
+  std::vector<std::unique_ptr<ToolOutputFile>> Outputs;
+  SmallVector<raw_pwrite_stream *, 16> Streams;
+  for (unsigned I = 0; I < Partitions; ++I) {
+    std::string PartitionPath = partitionPath(Path, I);
+    std::error_code EC;
+    auto Output = std::make_unique<ToolOutputFile>(PartitionPath,
+                                                   EC,
+                                                   sys::fs::OF_None);
+    if (EC) {
+      dbg << "Couldn't open " << PartitionPath << ": " << EC.message() << "\n";
+      return false;
+    }
+
+    Streams.push_back(&Output->os());
+    Outputs.push_back(std::move(Output));
+  }
+
+  splitCodeGen(std::move(M), Streams, {}, CreateTargetMachine);
+
+  for (std::unique_ptr<ToolOutputFile> &Output : Outputs)
+    Output->keep();
+
+  return true;
+}
+
+/// Split \p M in \p Count shards, optimize them and emit them in parallel
+///
+/// Each shard is handled in its own LLVMContext, therefore shards are handed
+/// over to their threads as bitcode.
+static bool emitShards(std::unique_ptr<Module> M,
+                       const TargetMachineFactory &CreateTargetMachine,
+                       StringRef Path,
+                       unsigned Count) {
+  using namespace llvm;
+
+  std::vector<SmallString<0>> Bitcodes;
+  shardModule(*M, Count, [&Bitcodes](std::unique_ptr<Module> Shard) {
+    Bitcodes.emplace_back();
+    raw_svector_ostream Stream(Bitcodes.back());
+    WriteBitcodeToFile(*Shard, Stream);
+  });
+  M.reset();
+
+  std::atomic<bool> Failed(false);
+  auto Worker = [&](unsigned Index) {
+    LLVMContext Context;
+    MemoryBufferRef Buffer(Bitcodes[Index].str(), "shard");
+    Expected<std::unique_ptr<Module>> Shard = parseBitcodeFile(Buffer, Context);
+    if (not Shard) {
+      consumeError(Shard.takeError());
+      Failed = true;
+      return;
+    }
+
+    TargetMachinePointer TM = CreateTargetMachine();
+    if (OptimizationLevel == 2)
+      optimize(**Shard, TM.get());
+
+    if (not emitObject(**Shard, *TM, partitionPath(Path, Index)))
+      Failed = true;
+  };
+
+  std::vector<std::thread> Threads;
+  for (unsigned I = 0; I < Count; ++I)
+    Threads.emplace_back(Worker, I);
+
+  for (std::thread &Thread : Threads)
+    Thread.join();
+
+  return not Failed;
+}
+
+int main(int argc, const char *argv[]) {
+  // Enable LLVM stack trace
+  llvm::sys::PrintStackTraceOnErrorSignal(argv[0]);
+
+  llvm::InitializeAllTargetInfos();
+  llvm::InitializeAllTargets();
+  llvm::InitializeAllTargetMCs();
+  llvm::InitializeAllAsmPrinters();
+
+  // Same settings scripts/revng used to pass to opt and llc
+  llvm::StringMap<Option *> &Options(getRegisteredOptions());
+  getOption<bool>(Options, "enable-pre")->setInitialValue(false);
+  getOption<bool>(Options, "enable-load-pre")->setInitialValue(false);
+  getOption<bool>(Options, "disable-machine-licm")->setInitialValue(true);
+
+  HideUnrelatedOptions({ &MainCategory });
+  ParseCommandLineOptions(argc, argv);
+  installStatistics();
+
+  revng_check(OptimizationLevel <= 2, "Unsupported optimization level");
+  revng_check(CodeGenPartitions > 0, "At least one partition is required");
+  revng_check(Shards > 0, "At least one shard is required");
+  revng_check(Shards == 1 or CodeGenPartitions == 1,
+              "-shards and -codegen-partitions are mutually exclusive");
+  revng_check(Shards == 1 or DumpOptimizedPath.empty(),
+              "-dump-optimized is not supported with -shards");
+  revng_check(Isolate or not MergeFunctions,
+              "-merge-functions requires -isolate");
+  revng_check(not(Isolate and OutlineRegions),
+              "-outline-regions is meant for the non-isolated translation");
+  revng_check(not(Isolate and PromoteRootCSVs),
+              "-promote-root-csvs is meant for the non-isolated translation");
+
+  llvm::LLVMContext Context;
+  std::unique_ptr<Module> M = parseModule(InputPath, Context);
+  if (M.get() == nullptr)
+    return EXIT_FAILURE;
+
+  if (Isolate) {
+    isolate(*M);
+    if (not dumpModule(*M, DumpIsolatedPath))
+      return EXIT_FAILURE;
+  }
+
+  if (not Isolate and (Superblocks or PromoteRootCSVs or OutlineRegions))
+    transformRoot(*M);
+
+  // Link the support module in
+  std::unique_ptr<Module> Support = parseModule(SupportPath, Context);
+  if (Support.get() == nullptr)
+    return EXIT_FAILURE;
+
+  if (llvm::Linker::linkModules(*M, std::move(Support)))
+    return EXIT_FAILURE;
+
+  revng_check(not llvm::verifyModule(*M, &llvm::dbgs()));
+
+  if (not dumpModule(*M, DumpLinkedPath))
+    return EXIT_FAILURE;
+
+  // Create the target machine
+  llvm::Triple TheTriple(M->getTargetTriple());
+  std::string Error;
+  const llvm::Target *TheTarget = nullptr;
+  TheTarget = llvm::TargetRegistry::lookupTarget(TheTriple.getTriple(), Error);
+  if (TheTarget == nullptr) {
+    dbg << Error << "\n";
+    return EXIT_FAILURE;
+  }
+
+  auto CodeGenLevel = llvm::CodeGenOpt::None;
+  if (OptimizationLevel > 0)
+    CodeGenLevel = llvm::CodeGenOpt::Default;
+
+  std::string TripleName = TheTriple.getTriple();
+  auto CreateTargetMachine = [&]() {
+    llvm::TargetOptions TargetOptions;
+    llvm::TargetMachine *Result = nullptr;
+    Result = TheTarget->createTargetMachine(TripleName,
+                                            "",
+                                            "",
+                                            TargetOptions,
+                                            llvm::None,
+                                            llvm::None,
+                                            CodeGenLevel);
+    return TargetMachinePointer(Result);
+  };
+
+  TargetMachinePointer TM = CreateTargetMachine();
+  if (M->getDataLayout().isDefault())
+    M->setDataLayout(TM->createDataLayout());
+
+  if (Shards > 1) {
+    TM.reset();
+    if (not emitShards(std::move(M), CreateTargetMachine, OutputPath, Shards))
+      return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+  }
+
+  if (OptimizationLevel == 2) {
+    optimize(*M, TM.get());
+    if (not dumpModule(*M, DumpOptimizedPath))
+      return EXIT_FAILURE;
+  }
+
+  if (CodeGenPartitions == 1) {
+    if (not emitObject(*M, *TM, OutputPath))
+      return EXIT_FAILURE;
+  } else {
+    TM.reset();
+    if (not emitObjects(std::move(M),
+                        CreateTargetMachine,
+                        OutputPath,
+                        CodeGenPartitions)) {
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}